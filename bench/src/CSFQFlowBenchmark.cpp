@@ -0,0 +1,193 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "CSFQFlowBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include "../../space/src/CSFQFlowTable.hpp"
+
+namespace Sirikata {
+
+namespace {
+
+// Match the constants used by CSFQODPFlowScheduler
+const double FLOW_RATE_K = 10.0;
+const Duration IDLE_FLOW_TIMEOUT = Duration::milliseconds((int64)30000);
+
+// The flow map CSFQODPFlowScheduler used before CSFQFlowTable
+struct ObjectPair {
+    ObjectPair(const UUID& s, const UUID& d)
+     : source(s), dest(d)
+    {}
+
+    bool operator==(const ObjectPair& rhs) const {
+        return (source == rhs.source && dest == rhs.dest);
+    }
+
+    class Hasher {
+    public:
+        size_t operator() (const ObjectPair& op) const {
+            return *(uint32*)op.source.getArray().data() ^ *(uint32*)op.dest.getArray().data();
+        }
+    };
+
+    UUID source;
+    UUID dest;
+};
+
+struct FlowInfo {
+    FlowInfo(double w, const Time& start)
+     : rate(0.0, start),
+       weight(w)
+    {}
+
+    RateEstimator rate;
+    double weight;
+};
+
+typedef std::tr1::unordered_map<ObjectPair, FlowInfo, ObjectPair::Hasher> FlowMap;
+
+}
+
+CSFQFlowBenchmark::CSFQFlowBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false)
+{
+    OptionValue* objects;
+    OptionValue* flows;
+    OptionValue* packets;
+    OptionValue* churn;
+    OptionValue* packet_rate;
+    Sirikata::InitializeClassOptions ico("CSFQFlowBenchmark",this,
+        objects=new OptionValue("objects","5000",Sirikata::OptionValueType<uint32>(),"Number of objects sending and receiving"),
+        flows=new OptionValue("flows","200000",Sirikata::OptionValueType<uint32>(),"Number of object pairs with traffic at any time"),
+        packets=new OptionValue("packets","10000000",Sirikata::OptionValueType<uint32>(),"Total number of packets to account for"),
+        churn=new OptionValue("churn","2",Sirikata::OptionValueType<uint32>(),"Percentage of packets which start a new flow, replacing an existing one"),
+        packet_rate=new OptionValue("packet-rate","100000",Sirikata::OptionValueType<uint32>(),"Packets per second of simulated time"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("CSFQFlowBenchmark",this);
+    optionsSet->parse(param);
+
+    mObjects = std::max(objects->as<uint32>(), (uint32)1);
+    mFlows = std::max(flows->as<uint32>(), (uint32)1);
+    mPackets = packets->as<uint32>();
+    mChurn = std::min(churn->as<uint32>(), (uint32)100);
+    mPacketRate = std::max(packet_rate->as<uint32>(), (uint32)1);
+}
+
+CSFQFlowBenchmark::~CSFQFlowBenchmark() {
+}
+
+String CSFQFlowBenchmark::name() {
+    return "csfq-flows";
+}
+
+Duration CSFQFlowBenchmark::runUnorderedMap(const std::vector<UUID>& ids, const std::vector<Packet>& packets, uint32* flows_out) {
+    FlowMap flows;
+    Time t = Timer::now();
+    Duration packet_spacing = Duration::microseconds((int64)(1000000 / mPacketRate));
+
+    // Keep the result live so updates can't be optimized away
+    double sum = 0;
+    Time start_time = Timer::now();
+    for(uint32 i = 0; i < packets.size() && !mForceStop; i++) {
+        t += packet_spacing;
+        ObjectPair op(ids[packets[i].source], ids[packets[i].dest]);
+        FlowMap::iterator where = flows.find(op);
+        if (where == flows.end())
+            where = flows.insert(FlowMap::value_type(op, FlowInfo(1.0, t))).first;
+        sum += where->second.rate.estimate_rate(t, 100, FLOW_RATE_K);
+    }
+    Duration dur = Timer::now() - start_time;
+
+    if (sum == 0)
+        SILOG(benchmark,insane,"No traffic");
+    *flows_out = flows.size();
+
+    if (mForceStop)
+        return Duration::zero();
+    return dur;
+}
+
+Duration CSFQFlowBenchmark::runFlowTable(const std::vector<UUID>& ids, const std::vector<Packet>& packets, uint32* flows_out) {
+    CSFQFlowTable flows;
+    Time t = Timer::now();
+    Time last_sweep = t;
+    Duration packet_spacing = Duration::microseconds((int64)(1000000 / mPacketRate));
+
+    double sum = 0;
+    Time start_time = Timer::now();
+    for(uint32 i = 0; i < packets.size() && !mForceStop; i++) {
+        t += packet_spacing;
+        if (t - last_sweep > IDLE_FLOW_TIMEOUT) {
+            CSFQFlowTable::Removed removed;
+            flows.removeIdle(t - IDLE_FLOW_TIMEOUT, &removed);
+            last_sweep = t;
+        }
+        bool added = false;
+        CSFQFlowTable::Flow* flow = flows.insert(ids[packets[i].source], ids[packets[i].dest], t, &added);
+        if (added)
+            flow->weight = 1.0;
+        flow->lastActive = t;
+        sum += flow->rate.estimate_rate_approx(t, 100, FLOW_RATE_K);
+    }
+    Duration dur = Timer::now() - start_time;
+
+    if (sum == 0)
+        SILOG(benchmark,insane,"No traffic");
+    *flows_out = flows.size();
+
+    if (mForceStop)
+        return Duration::zero();
+    return dur;
+}
+
+void CSFQFlowBenchmark::start() {
+    mForceStop = false;
+
+    std::vector<UUID> ids;
+    for(uint32 i = 0; i < mObjects; i++)
+        ids.push_back(UUID::random());
+
+    // Packets are spread over a fixed number of active flows, some of which
+    // are replaced by new pairs as we go. The same packets are used for both
+    // runs.
+    std::vector<Packet> active(mFlows);
+    for(uint32 i = 0; i < mFlows; i++) {
+        active[i].source = rand() % mObjects;
+        active[i].dest = rand() % mObjects;
+    }
+    std::vector<Packet> packets;
+    packets.reserve(mPackets);
+    for(uint32 i = 0; i < mPackets; i++) {
+        Packet& flow = active[rand() % mFlows];
+        if ((uint32)(rand() % 100) < mChurn) {
+            flow.source = rand() % mObjects;
+            flow.dest = rand() % mObjects;
+        }
+        packets.push_back(flow);
+    }
+
+    uint32 map_flows = 0, table_flows = 0;
+    Duration map_dur = runUnorderedMap(ids, packets, &map_flows);
+    if (mForceStop) return;
+    Duration table_dur = runFlowTable(ids, packets, &table_flows);
+    if (mForceStop) return;
+
+    float64 npackets = packets.size();
+    SILOG(benchmark,info,
+        mObjects << " objects, " << mFlows << " active flows, " << npackets << " packets, " << mChurn << "% churn: " <<
+        "unordered_map " << (npackets / map_dur.toSeconds()) << " packets/s (" << map_flows << " flows kept), " <<
+        "CSFQFlowTable " << (npackets / table_dur.toSeconds()) << " packets/s (" << table_flows << " flows kept)"
+    );
+
+    notifyFinished();
+}
+
+void CSFQFlowBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
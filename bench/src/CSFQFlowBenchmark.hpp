@@ -0,0 +1,54 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_CSFQ_FLOW_BENCHMARK_HPP_
+#define _SIRIKATA_CSFQ_FLOW_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+#include <sirikata/core/util/UUID.hpp>
+
+namespace Sirikata {
+
+/** CSFQFlowBenchmark measures the per-packet flow bookkeeping done by the CSFQ
+ *  ODP flow scheduler: finding or adding the packet's (source, dest) flow and
+ *  updating its rate estimate. It compares the previous unordered_map of flows
+ *  against CSFQFlowTable, which also ages out idle flows.
+ */
+class CSFQFlowBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new CSFQFlowBenchmark(finished_cb, param);
+    }
+
+    CSFQFlowBenchmark(const FinishedCallback& finished_cb, const String& param);
+    virtual ~CSFQFlowBenchmark();
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    struct Packet {
+        uint32 source;
+        uint32 dest;
+    };
+
+    // Returns the time taken to account for all packets, or zero if stopped
+    Duration runUnorderedMap(const std::vector<UUID>& ids, const std::vector<Packet>& packets, uint32* flows_out);
+    Duration runFlowTable(const std::vector<UUID>& ids, const std::vector<Packet>& packets, uint32* flows_out);
+
+    bool mForceStop;
+    uint32 mObjects;
+    uint32 mFlows;
+    uint32 mPackets;
+    uint32 mChurn;
+    uint32 mPacketRate;
+}; // class CSFQFlowBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_CSFQ_FLOW_BENCHMARK_HPP_
@@ -0,0 +1,558 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "JSSerializeBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include "JS_JSMessage.pbj.hpp"
+#include "../../liboh/plugins/js/JSBinaryCodec.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace Sirikata {
+
+namespace {
+
+using namespace Sirikata::JS;
+
+struct Obj;
+
+// A JS value, as seen by JSSerializer.
+struct Val {
+    enum Type { UNDEFINED, NULLVAL, BOOL, INT32, DOUBLE, STRING, OBJECT };
+
+    Val() : type(UNDEFINED), b(false), i(0), d(0), o(NULL) {}
+
+    static Val Bool(bool v) { Val r; r.type = BOOL; r.b = v; return r; }
+    static Val Int(int32 v) { Val r; r.type = INT32; r.i = v; return r; }
+    static Val Double(float64 v) { Val r; r.type = DOUBLE; r.d = v; return r; }
+    static Val Str(const String& v) { Val r; r.type = STRING; r.s = v; return r; }
+    static Val Object(Obj* v) { Val r; r.type = OBJECT; r.o = v; return r; }
+
+    Type type;
+    bool b;
+    int32 i;
+    float64 d;
+    String s;
+    Obj* o;
+};
+
+struct Obj {
+    Obj(bool array_, bool root_) : array(array_), root(root_) {}
+
+    void set(const String& name, const Val& val) {
+        fields.push_back(std::make_pair(name, val));
+    }
+
+    bool array;
+    // Object.prototype
+    bool root;
+    std::vector<std::pair<String, Val> > fields;
+};
+
+// Owns all the objects in a message.
+class Graph {
+public:
+    Graph() : mObjectProto(NULL), mArrayProto(NULL) {}
+    ~Graph() { clear(); }
+
+    void clear() {
+        for(uint32 i = 0; i < mObjects.size(); i++)
+            delete mObjects[i];
+        mObjects.clear();
+        mObjectProto = mArrayProto = NULL;
+        value = Val();
+    }
+
+    Obj* create(bool array, bool root) {
+        mObjects.push_back(new Obj(array, root));
+        return mObjects.back();
+    }
+
+    // Objects and arrays as JSSerializer sees them, with their prototype as
+    // the last field. Fields should be added to these before calling
+    // finish().
+    Obj* object() { return create(false, false); }
+    Obj* array() { return create(true, false); }
+    void finish(Obj* obj) {
+        if (mObjectProto == NULL) {
+            mObjectProto = create(false, true);
+            mArrayProto = create(false, false);
+            mArrayProto->set("this", Val::Object(mObjectProto));
+        }
+        obj->set("this", Val::Object(obj->array ? mArrayProto : mObjectProto));
+    }
+
+    Val value;
+
+private:
+    std::vector<Obj*> mObjects;
+    Obj* mObjectProto;
+    Obj* mArrayProto;
+};
+
+
+bool equal(const Val& a, const Val& b, std::map<const Obj*, const Obj*>& seen) {
+    if (a.type != b.type) return false;
+    switch(a.type) {
+      case Val::UNDEFINED:
+      case Val::NULLVAL:
+        return true;
+      case Val::BOOL: return a.b == b.b;
+      case Val::INT32: return a.i == b.i;
+      case Val::DOUBLE: return a.d == b.d;
+      case Val::STRING: return a.s == b.s;
+      case Val::OBJECT:
+        {
+            std::map<const Obj*, const Obj*>::iterator it = seen.find(a.o);
+            if (it != seen.end()) return it->second == b.o;
+            seen[a.o] = b.o;
+            if (a.o->array != b.o->array || a.o->root != b.o->root ||
+                a.o->fields.size() != b.o->fields.size())
+                return false;
+            for(uint32 i = 0; i < a.o->fields.size(); i++) {
+                if (a.o->fields[i].first != b.o->fields[i].first ||
+                    !equal(a.o->fields[i].second, b.o->fields[i].second, seen))
+                    return false;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Message shapes
+void buildSmall(Graph& g) {
+    Obj* msg = g.object();
+    msg->set("type", Val::Str("move"));
+    msg->set("seq", Val::Int(1234));
+    msg->set("x", Val::Double(1.5));
+    msg->set("y", Val::Double(-2.25));
+    msg->set("z", Val::Double(100.125));
+    msg->set("moving", Val::Bool(true));
+    g.finish(msg);
+    g.value = Val::Object(msg);
+}
+
+Obj* buildTree(Graph& g, uint32 depth, uint32& id) {
+    Obj* node = g.object();
+    node->set("name", Val::Str("node" + boost::lexical_cast<String>(id)));
+    node->set("id", Val::Int(id));
+    node->set("weight", Val::Double(id * 0.5));
+    id++;
+    Obj* children = g.array();
+    for(uint32 i = 0; depth > 0 && i < 3; i++)
+        children->set(boost::lexical_cast<String>(i), Val::Object(buildTree(g, depth-1, id)));
+    g.finish(children);
+    node->set("children", Val::Object(children));
+    g.finish(node);
+    return node;
+}
+
+void buildNested(Graph& g) {
+    uint32 id = 0;
+    g.value = Val::Object(buildTree(g, 4, id));
+}
+
+void buildArray(Graph& g) {
+    Obj* arr = g.array();
+    for(uint32 i = 0; i < 1000; i++) {
+        String idx = boost::lexical_cast<String>(i);
+        arr->set(idx, (i % 2 == 0) ? Val::Int(i * 7) : Val::Double(i * 0.25));
+    }
+    g.finish(arr);
+    g.value = Val::Object(arr);
+}
+
+void buildRecords(Graph& g) {
+    Obj* arr = g.array();
+    for(uint32 i = 0; i < 100; i++) {
+        Obj* rec = g.object();
+        rec->set("id", Val::Int(i));
+        rec->set("name", Val::Str("object-" + boost::lexical_cast<String>(i)));
+        Obj* pos = g.object();
+        pos->set("x", Val::Double(i * 1.5));
+        pos->set("y", Val::Double(i * -0.75));
+        pos->set("z", Val::Double(10.0 + i));
+        g.finish(pos);
+        rec->set("pos", Val::Object(pos));
+        rec->set("visible", Val::Bool(i % 3 != 0));
+        Obj* tags = g.array();
+        tags->set("0", Val::Str("avatar"));
+        tags->set("1", Val::Str("static"));
+        g.finish(tags);
+        rec->set("tags", Val::Object(tags));
+        g.finish(rec);
+        arr->set(boost::lexical_cast<String>(i), Val::Object(rec));
+    }
+    g.finish(arr);
+    g.value = Val::Object(arr);
+}
+
+void buildCyclic(Graph& g) {
+    const uint32 count = 100;
+    std::vector<Obj*> nodes;
+    for(uint32 i = 0; i < count; i++)
+        nodes.push_back(g.object());
+    for(uint32 i = 0; i < count; i++) {
+        nodes[i]->set("id", Val::Int(i));
+        nodes[i]->set("next", Val::Object(nodes[(i+1) % count]));
+        nodes[i]->set("prev", Val::Object(nodes[(i+count-1) % count]));
+        nodes[i]->set("head", Val::Object(nodes[0]));
+        g.finish(nodes[i]);
+    }
+    g.value = Val::Object(nodes[0]);
+}
+
+bool buildShape(const String& shape, Graph& g) {
+    if (shape == "small") buildSmall(g);
+    else if (shape == "nested") buildNested(g);
+    else if (shape == "array") buildArray(g);
+    else if (shape == "records") buildRecords(g);
+    else if (shape == "cyclic") buildCyclic(g);
+    else return false;
+    return true;
+}
+
+
+// PBJ encoding, laid out the same way JSSerializer used to lay out messages.
+class PBJEncoder {
+public:
+    PBJEncoder() : mNextID(0) {}
+
+    void encode(const Val& val, String* buf) {
+        Sirikata::JS::Protocol::JSFieldValue jsfield;
+        writeValue(jsfield, val);
+        jsfield.SerializeToString(buf);
+    }
+
+private:
+    void writeValue(Sirikata::JS::Protocol::IJSFieldValue& jsf_value, const Val& val) {
+        switch(val.type) {
+          case Val::UNDEFINED: jsf_value.set_undefined_value(true); break;
+          case Val::NULLVAL: jsf_value.set_null_value(true); break;
+          case Val::BOOL: jsf_value.set_b_value(val.b); break;
+          case Val::INT32: jsf_value.set_i_value(val.i); break;
+          case Val::DOUBLE: jsf_value.set_d_value(val.d); break;
+          case Val::STRING: jsf_value.set_s_value(val.s); break;
+          case Val::OBJECT:
+            {
+                IDMap::iterator it = mIDs.find(val.o);
+                if (it != mIDs.end()) {
+                    jsf_value.set_loop_pointer(it->second);
+                    break;
+                }
+                if (val.o->root) {
+                    Sirikata::JS::Protocol::IJSMessage ijs_m = jsf_value.mutable_root_object();
+                    writeObject(ijs_m, val.o);
+                }
+                else if (val.o->array) {
+                    Sirikata::JS::Protocol::IJSMessage ijs_m = jsf_value.mutable_a_value();
+                    writeObject(ijs_m, val.o);
+                }
+                else {
+                    Sirikata::JS::Protocol::IJSMessage ijs_m = jsf_value.mutable_o_value();
+                    writeObject(ijs_m, val.o);
+                }
+            }
+            break;
+        }
+    }
+
+    void writeObject(Sirikata::JS::Protocol::IJSMessage& jsmessage, const Obj* obj) {
+        mIDs[obj] = mNextID;
+        jsmessage.set_msg_id(mNextID++);
+        for(uint32 i = 0; i < obj->fields.size(); i++) {
+            Sirikata::JS::Protocol::IJSField jsf = jsmessage.add_fields();
+            jsf.set_name(obj->fields[i].first);
+            Sirikata::JS::Protocol::IJSFieldValue jsf_value = jsf.mutable_value();
+            writeValue(jsf_value, obj->fields[i].second);
+        }
+    }
+
+    typedef std::tr1::unordered_map<const Obj*, int32> IDMap;
+    IDMap mIDs;
+    int32 mNextID;
+};
+
+class PBJDecoder {
+public:
+    PBJDecoder(Graph& g) : mGraph(g) {}
+
+    bool decode(const String& buf) {
+        Sirikata::JS::Protocol::JSFieldValue jsfield;
+        if (!jsfield.ParseFromString(buf)) return false;
+
+        // Holds the top level value so it can be fixed up like any other
+        Obj* holder = mGraph.create(false, false);
+        holder->set("", Val());
+        readValue(jsfield, holder, 0);
+
+        for(uint32 i = 0; i < mFixups.size(); i++) {
+            std::map<int32, Obj*>::iterator it = mLabeled.find(mFixups[i].label);
+            if (it == mLabeled.end()) return false;
+            mFixups[i].parent->fields[mFixups[i].field].second = Val::Object(it->second);
+        }
+        mGraph.value = holder->fields[0].second;
+        return true;
+    }
+
+private:
+    void readValue(const Sirikata::JS::Protocol::JSFieldValue& jsvalue, Obj* parent, uint32 field) {
+        Val val;
+        if (jsvalue.has_s_value())
+            val = Val::Str(jsvalue.s_value());
+        else if (jsvalue.has_i_value())
+            val = Val::Int(jsvalue.i_value());
+        else if (jsvalue.has_undefined_value())
+            val = Val();
+        else if (jsvalue.has_null_value())
+            val.type = Val::NULLVAL;
+        else if (jsvalue.has_o_value())
+            val = Val::Object(readObject(jsvalue.o_value(), false, false));
+        else if (jsvalue.has_a_value())
+            val = Val::Object(readObject(jsvalue.a_value(), true, false));
+        else if (jsvalue.has_d_value())
+            val = Val::Double(jsvalue.d_value());
+        else if (jsvalue.has_b_value())
+            val = Val::Bool(jsvalue.b_value());
+        else if (jsvalue.has_root_object())
+            val = Val::Object(readObject(jsvalue.root_object(), false, true));
+        else if (jsvalue.has_loop_pointer()) {
+            Fixup fixup = { parent, field, jsvalue.loop_pointer() };
+            mFixups.push_back(fixup);
+        }
+        parent->fields[field].second = val;
+    }
+
+    Obj* readObject(const Sirikata::JS::Protocol::JSMessage& jsmessage, bool array, bool root) {
+        Obj* obj = mGraph.create(array, root);
+        mLabeled[jsmessage.msg_id()] = obj;
+        for(int i = 0; i < jsmessage.fields_size(); i++) {
+            Sirikata::JS::Protocol::JSField jsf = jsmessage.fields(i);
+            obj->set(jsf.name(), Val());
+            readValue(jsf.value(), obj, obj->fields.size()-1);
+        }
+        return obj;
+    }
+
+    struct Fixup {
+        Obj* parent;
+        uint32 field;
+        int32 label;
+    };
+
+    Graph& mGraph;
+    std::map<int32, Obj*> mLabeled;
+    std::vector<Fixup> mFixups;
+};
+
+
+// Binary encoding, the same way JSSerializer writes v8 values.
+class BinaryEncoder {
+public:
+    BinaryEncoder(String& buf) : mWriter(buf) {}
+
+    void writeValue(const Val& val) {
+        switch(val.type) {
+          case Val::UNDEFINED: mWriter.writeTag(JSBinary::TAG_UNDEFINED); break;
+          case Val::NULLVAL: mWriter.writeTag(JSBinary::TAG_NULL); break;
+          case Val::BOOL: mWriter.writeTag(val.b ? JSBinary::TAG_TRUE : JSBinary::TAG_FALSE); break;
+          case Val::INT32:
+            mWriter.writeTag(JSBinary::TAG_INT32);
+            mWriter.writeInt32(val.i);
+            break;
+          case Val::DOUBLE:
+            mWriter.writeTag(JSBinary::TAG_DOUBLE);
+            mWriter.writeDouble(val.d);
+            break;
+          case Val::STRING:
+            mWriter.writeTag(JSBinary::TAG_STRING);
+            mWriter.writeString(val.s);
+            break;
+          case Val::OBJECT:
+            {
+                IDMap::iterator it = mIDs.find(val.o);
+                if (it != mIDs.end()) {
+                    mWriter.writeBackref(it->second);
+                    break;
+                }
+                JSBinary::Tag tag = val.o->root ? JSBinary::TAG_ROOT_OBJECT :
+                    (val.o->array ? JSBinary::TAG_ARRAY : JSBinary::TAG_OBJECT);
+                mIDs[val.o] = mWriter.beginObject(tag);
+                for(uint32 i = 0; i < val.o->fields.size(); i++) {
+                    mWriter.writeName(val.o->fields[i].first);
+                    writeValue(val.o->fields[i].second);
+                }
+                mWriter.endFields();
+            }
+            break;
+        }
+    }
+
+private:
+    typedef std::tr1::unordered_map<const Obj*, uint32> IDMap;
+    JSBinary::Writer mWriter;
+    IDMap mIDs;
+};
+
+class BinaryDecoder {
+public:
+    BinaryDecoder(Graph& g, const String& buf) : mGraph(g), mReader(buf) {}
+
+    bool decode() {
+        return mReader.valid() && readValue(&mGraph.value) && mReader.done();
+    }
+
+private:
+    bool readValue(Val* val) {
+        JSBinary::Tag tag;
+        if (!mReader.readTag(&tag)) return false;
+        switch(tag) {
+          case JSBinary::TAG_UNDEFINED: *val = Val(); return true;
+          case JSBinary::TAG_NULL: val->type = Val::NULLVAL; return true;
+          case JSBinary::TAG_TRUE: *val = Val::Bool(true); return true;
+          case JSBinary::TAG_FALSE: *val = Val::Bool(false); return true;
+          case JSBinary::TAG_INT32: val->type = Val::INT32; return mReader.readInt32(&val->i);
+          case JSBinary::TAG_DOUBLE: val->type = Val::DOUBLE; return mReader.readDouble(&val->d);
+          case JSBinary::TAG_STRING: val->type = Val::STRING; return mReader.readString(&val->s);
+          case JSBinary::TAG_OBJECT:
+          case JSBinary::TAG_ARRAY:
+          case JSBinary::TAG_ROOT_OBJECT:
+            {
+                Obj* obj = mGraph.create(tag == JSBinary::TAG_ARRAY, tag == JSBinary::TAG_ROOT_OBJECT);
+                mObjects.push_back(obj);
+                *val = Val::Object(obj);
+                String name;
+                bool end = false;
+                while(true) {
+                    if (!mReader.readName(&name, &end)) return false;
+                    if (end) return true;
+                    obj->set(name, Val());
+                    if (!readValue(&obj->fields.back().second)) return false;
+                }
+            }
+          case JSBinary::TAG_BACKREF:
+            {
+                uint32 idx;
+                if (!mReader.readBackref(&idx) || idx >= mObjects.size()) return false;
+                *val = Val::Object(mObjects[idx]);
+                return true;
+            }
+          default:
+            // Not generated by any of the shapes
+            return false;
+        }
+    }
+
+    Graph& mGraph;
+    JSBinary::Reader mReader;
+    std::vector<Obj*> mObjects;
+};
+
+} // namespace
+
+
+JSSerializeBenchmark::JSSerializeBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false)
+{
+    OptionValue* shapes;
+    OptionValue* iterations;
+    Sirikata::InitializeClassOptions ico("JSSerializeBenchmark",this,
+        shapes=new OptionValue("shapes","small,nested,array,records,cyclic",Sirikata::OptionValueType<String>(),"Comma separated list of message shapes to test: small, nested, array, records, cyclic"),
+        iterations=new OptionValue("iterations","2000",Sirikata::OptionValueType<uint32>(),"Number of times to encode and decode each message in each format"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("JSSerializeBenchmark",this);
+    optionsSet->parse(param);
+
+    String shape_list = shapes->as<String>();
+    boost::split(mShapes, shape_list, boost::is_any_of(","));
+    mIterations = std::max(iterations->as<uint32>(), (uint32)1);
+}
+
+String JSSerializeBenchmark::name() {
+    return "js-serialize";
+}
+
+void JSSerializeBenchmark::benchmarkShape(const String& shape) {
+    Graph msg;
+    if (!buildShape(shape, msg)) {
+        SILOG(benchmark,error,"Unknown message shape " << shape);
+        return;
+    }
+
+    // Encoded forms, also used to check both formats round trip the message
+    String pbj_data, binary_data;
+    PBJEncoder().encode(msg.value, &pbj_data);
+    BinaryEncoder(binary_data).writeValue(msg.value);
+    {
+        Graph pbj_decoded, binary_decoded;
+        std::map<const Obj*, const Obj*> pbj_seen, binary_seen;
+        if (!PBJDecoder(pbj_decoded).decode(pbj_data) ||
+            !equal(msg.value, pbj_decoded.value, pbj_seen) ||
+            !BinaryDecoder(binary_decoded, binary_data).decode() ||
+            !equal(msg.value, binary_decoded.value, binary_seen)) {
+            SILOG(benchmark,error,"Message shape " << shape << " didn't round trip");
+            return;
+        }
+    }
+
+    String buf;
+    Time start_time = Timer::now();
+    for(uint32 i = 0; i < mIterations && !mForceStop; i++)
+        PBJEncoder().encode(msg.value, &buf);
+    Duration pbj_encode = (Timer::now() - start_time) / mIterations;
+
+    start_time = Timer::now();
+    for(uint32 i = 0; i < mIterations && !mForceStop; i++) {
+        Graph decoded;
+        PBJDecoder(decoded).decode(pbj_data);
+    }
+    Duration pbj_decode = (Timer::now() - start_time) / mIterations;
+
+    // The binary encoder reuses the same buffer, like a sender would
+    start_time = Timer::now();
+    for(uint32 i = 0; i < mIterations && !mForceStop; i++)
+        BinaryEncoder(buf).writeValue(msg.value);
+    Duration binary_encode = (Timer::now() - start_time) / mIterations;
+
+    start_time = Timer::now();
+    for(uint32 i = 0; i < mIterations && !mForceStop; i++) {
+        Graph decoded;
+        BinaryDecoder(decoded, binary_data).decode();
+    }
+    Duration binary_decode = (Timer::now() - start_time) / mIterations;
+
+    if (mForceStop) return;
+
+    SILOG(benchmark,info,
+        shape << ": " <<
+        "pbj " << pbj_data.size() << " bytes, " << pbj_encode << "/encode, " << pbj_decode << "/decode; " <<
+        "binary " << binary_data.size() << " bytes, " << binary_encode << "/encode, " << binary_decode << "/decode; " <<
+        "speedup " << (binary_encode.toSeconds() > 0 ? pbj_encode.toSeconds() / binary_encode.toSeconds() : 0) << "x encode, " <<
+        (binary_decode.toSeconds() > 0 ? pbj_decode.toSeconds() / binary_decode.toSeconds() : 0) << "x decode"
+    );
+}
+
+void JSSerializeBenchmark::start() {
+    mForceStop = false;
+
+    for(uint32 i = 0; i < mShapes.size() && !mForceStop; i++)
+        benchmarkShape(mShapes[i]);
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void JSSerializeBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
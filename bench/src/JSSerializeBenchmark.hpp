@@ -0,0 +1,45 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_JS_SERIALIZE_BENCHMARK_HPP_
+#define _SIRIKATA_JS_SERIALIZE_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** JSSerializeBenchmark compares the PBJ-based encoding of Emerson messages
+ *  with the binary encoding used by the JS plugin's JSSerializer. v8 isn't
+ *  available here, so each message shape is built as a simple object graph
+ *  with the same structure JSSerializer produces for it (including prototype
+ *  references) and is encoded and decoded directly with both formats. For
+ *  each shape it reports the encoded size and the average encode and decode
+ *  time.
+ */
+class JSSerializeBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new JSSerializeBenchmark(finished_cb, param);
+    }
+
+    JSSerializeBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    void benchmarkShape(const String& shape);
+
+    bool mForceStop;
+    std::vector<String> mShapes;
+    uint32 mIterations;
+}; // class JSSerializeBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_JS_SERIALIZE_BENCHMARK_HPP_
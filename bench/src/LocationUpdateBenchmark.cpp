@@ -0,0 +1,180 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "LocationUpdateBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/space/LocationService.hpp>
+#include "../../libspace/plugins/standard/LocationTable.hpp"
+
+#include <boost/lexical_cast.hpp>
+
+namespace Sirikata {
+
+namespace {
+
+// The listeners a space server normally has attached to its location service.
+const uint32 NUM_LISTENERS = 4;
+
+// Stands in for one of those listeners, each of which keeps its own copy of
+// the state it cares about for every object.
+class BenchmarkListener : public LocationServiceListener {
+public:
+    BenchmarkListener(const LocationTable* table, bool batched)
+     : mTable(table),
+       mBatched(batched)
+    {}
+
+    void addObject(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient) {
+        mLocations[uuid] = loc;
+        mOrientations[uuid] = orient;
+    }
+
+    virtual bool batchedUpdates() const { return mBatched; }
+
+    virtual void localLocationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval) {
+        mLocations[uuid] = newval;
+    }
+    virtual void localOrientationUpdated(const UUID& uuid, bool agg, const TimedMotionQuaternion& newval) {
+        mOrientations[uuid] = newval;
+    }
+
+    virtual void locationUpdateBatch(const LocationUpdateBatchEntry* begin, const LocationUpdateBatchEntry* end) {
+        for(const LocationUpdateBatchEntry* entry = begin; entry != end; entry++) {
+            LocationTable::Slot slot = mTable->find(entry->uuid);
+            if (entry->fields & LocationUpdateBatchEntry::LOCATION)
+                mLocations[entry->uuid] = mTable->location(slot);
+            if (entry->fields & LocationUpdateBatchEntry::ORIENTATION)
+                mOrientations[entry->uuid] = mTable->orientation(slot);
+        }
+    }
+
+private:
+    const LocationTable* mTable;
+    bool mBatched;
+    std::tr1::unordered_map<UUID, TimedMotionVector3f, UUID::Hasher> mLocations;
+    std::tr1::unordered_map<UUID, TimedMotionQuaternion, UUID::Hasher> mOrientations;
+};
+
+}
+
+LocationUpdateBenchmark::LocationUpdateBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false)
+{
+    OptionValue* objects;
+    OptionValue* updates;
+    OptionValue* tick_updates;
+    Sirikata::InitializeClassOptions ico("LocationUpdateBenchmark",this,
+        objects=new OptionValue("objects","10000",Sirikata::OptionValueType<uint32>(),"Number of objects in the location service"),
+        updates=new OptionValue("updates","2000000",Sirikata::OptionValueType<uint32>(),"Total number of location updates to apply"),
+        tick_updates=new OptionValue("tick-updates","5000",Sirikata::OptionValueType<uint32>(),"Number of updates between location service ticks"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("LocationUpdateBenchmark",this);
+    optionsSet->parse(param);
+
+    mObjects = std::max(objects->as<uint32>(), (uint32)1);
+    mUpdates = updates->as<uint32>();
+    mTickUpdates = std::max(tick_updates->as<uint32>(), (uint32)1);
+}
+
+LocationUpdateBenchmark::~LocationUpdateBenchmark() {
+}
+
+String LocationUpdateBenchmark::name() {
+    return "location-update";
+}
+
+Duration LocationUpdateBenchmark::run(bool batched, const std::vector<uint32>& updates) {
+    Time t = Timer::now();
+    TimedMotionQuaternion orient(t, MotionQuaternion(Quaternion::identity(), Quaternion::identity()));
+    BoundingSphere3f bounds(Vector3f::zero(), 1.f);
+
+    LocationTable table;
+    std::vector<UUID> ids;
+    BenchmarkListener* listeners[NUM_LISTENERS];
+    for(uint32 li = 0; li < NUM_LISTENERS; li++)
+        listeners[li] = new BenchmarkListener(&table, batched);
+    for(uint32 i = 0; i < mObjects; i++) {
+        ids.push_back(UUID::random());
+        TimedMotionVector3f loc(t, MotionVector3f(Vector3f(i, 0, 0), Vector3f::zero()));
+        // Most objects share a handful of meshes
+        table.insert(ids.back(), LocationTable::LOCAL, loc, orient, bounds, "meerkat:///test/mesh" + boost::lexical_cast<String>(i % 16) + ".dae", "");
+        for(uint32 li = 0; li < NUM_LISTENERS; li++)
+            listeners[li]->addObject(ids.back(), loc, orient);
+    }
+
+    LocationUpdateBatcher batcher;
+    LocationUpdateBatcher::Batch batch;
+
+    Time start_time = Timer::now();
+    for(uint32 i = 0; i < updates.size() && !mForceStop; i++) {
+        const UUID& uuid = ids[updates[i]];
+        TimedMotionVector3f newloc(t + Duration::milliseconds((int64)i), MotionVector3f(Vector3f(i, 0, 0), Vector3f(1, 0, 0)));
+        TimedMotionQuaternion neworient(t + Duration::milliseconds((int64)i), MotionQuaternion(Quaternion::identity(), Quaternion::identity()));
+
+        LocationTable::Slot slot = table.find(uuid);
+        table.setLocation(slot, newloc, i);
+        table.setOrientation(slot, neworient, i);
+
+        if (batched) {
+            batcher.add(uuid, true, false, LocationUpdateBatchEntry::LOCATION);
+            batcher.add(uuid, true, false, LocationUpdateBatchEntry::ORIENTATION);
+        }
+        else {
+            for(uint32 li = 0; li < NUM_LISTENERS; li++) {
+                LocationServiceListener* listener = listeners[li];
+                listener->localLocationUpdated(uuid, false, table.location(slot));
+                listener->localOrientationUpdated(uuid, false, table.orientation(slot));
+            }
+        }
+
+        if (batched && ((i+1) % mTickUpdates == 0 || i+1 == updates.size())) {
+            size_t num = batcher.take(&batch);
+            for(uint32 li = 0; li < NUM_LISTENERS && num > 0; li++) {
+                LocationServiceListener* listener = listeners[li];
+                listener->locationUpdateBatch(&batch[0], &batch[0] + num);
+            }
+        }
+    }
+    Duration dur = Timer::now() - start_time;
+
+    for(uint32 li = 0; li < NUM_LISTENERS; li++)
+        delete listeners[li];
+
+    if (mForceStop)
+        return Duration::zero();
+    return dur;
+}
+
+void LocationUpdateBenchmark::start() {
+    mForceStop = false;
+
+    // The same random sequence of objects is updated in both runs.
+    std::vector<uint32> updates;
+    for(uint32 i = 0; i < mUpdates; i++)
+        updates.push_back(rand() % mObjects);
+
+    Duration per_call = run(false, updates);
+    if (mForceStop) return;
+    Duration batched = run(true, updates);
+    if (mForceStop) return;
+
+    float64 nupdates = updates.size();
+    SILOG(benchmark,info,
+        mObjects << " objects, " << NUM_LISTENERS << " listeners, " <<
+        nupdates << " updates, " << mTickUpdates << " per tick: " <<
+        "per-call " << (nupdates / per_call.toSeconds()) << " updates/s, " <<
+        "batched " << (nupdates / batched.toSeconds()) << " updates/s"
+    );
+
+    notifyFinished();
+}
+
+void LocationUpdateBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
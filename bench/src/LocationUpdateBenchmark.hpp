@@ -0,0 +1,46 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_LOCATION_UPDATE_BENCHMARK_HPP_
+#define _SIRIKATA_LOCATION_UPDATE_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** LocationUpdateBenchmark measures how many object location updates per
+ *  second the standard location service's storage can absorb while keeping a
+ *  space server's usual set of listeners (proximity, aggregates, migration
+ *  monitor and update policy) informed. It reports the rate with listeners
+ *  called for every update and with them taking one batch per tick.
+ */
+class LocationUpdateBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new LocationUpdateBenchmark(finished_cb, param);
+    }
+
+    LocationUpdateBenchmark(const FinishedCallback& finished_cb, const String& param);
+    virtual ~LocationUpdateBenchmark();
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    // Returns the time taken to apply all updates, or zero if stopped
+    Duration run(bool batched, const std::vector<uint32>& updates);
+
+    bool mForceStop;
+    uint32 mObjects;
+    uint32 mUpdates;
+    uint32 mTickUpdates;
+}; // class LocationUpdateBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_LOCATION_UPDATE_BENCHMARK_HPP_
@@ -0,0 +1,149 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "MeshFormatBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/core/util/PluginManager.hpp>
+#include <sirikata/mesh/ModelsSystemFactory.hpp>
+#include <sirikata/mesh/Meshdata.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <fstream>
+#include <sstream>
+
+#if SIRIKATA_PLATFORM != SIRIKATA_PLATFORM_WINDOWS
+#include <sys/resource.h>
+#endif
+
+namespace Sirikata {
+
+namespace {
+// Peak resident set size in KB, or 0 if we can't determine it.
+uint64 peakRSS() {
+#if SIRIKATA_PLATFORM != SIRIKATA_PLATFORM_WINDOWS
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss;
+#endif
+    return 0;
+}
+}
+
+MeshFormatBenchmark::MeshFormatBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mPlugins(NULL),
+          mCollada(NULL),
+          mBinary(NULL)
+{
+    OptionValue* assets;
+    OptionValue* iterations;
+    Sirikata::InitializeClassOptions ico("MeshFormatBenchmark",this,
+        assets=new OptionValue("assets","../../cdn/fake_root/test/dice.dae,../../cdn/fake_root/test/sphere.dae,../../cdn/fake_root/test/multimtl.dae,../../cdn/fake_root/test/sevenListo2.dae",Sirikata::OptionValueType<String>(),"Comma separated list of COLLADA files to test with"),
+        iterations=new OptionValue("iterations","20",Sirikata::OptionValueType<uint32>(),"Number of times to parse each asset in each format"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("MeshFormatBenchmark",this);
+    optionsSet->parse(param);
+
+    String asset_list = assets->as<String>();
+    boost::split(mAssets, asset_list, boost::is_any_of(","));
+    mIterations = std::max(iterations->as<uint32>(), (uint32)1);
+}
+
+MeshFormatBenchmark::~MeshFormatBenchmark() {
+    delete mCollada;
+    delete mBinary;
+    delete mPlugins;
+}
+
+String MeshFormatBenchmark::name() {
+    return "mesh-format";
+}
+
+Transfer::DenseDataPtr MeshFormatBenchmark::readFile(const String& filename) {
+    std::ifstream fin(filename.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!fin) return Transfer::DenseDataPtr();
+    std::stringstream contents;
+    contents << fin.rdbuf();
+    return Transfer::DenseDataPtr(new Transfer::DenseData(contents.str()));
+}
+
+Duration MeshFormatBenchmark::timeParse(ModelsSystem* system, Transfer::DenseDataPtr data) {
+    Time start_time = Timer::now();
+    for(uint32 i = 0; i < mIterations && !mForceStop; i++) {
+        Mesh::VisualPtr vis = system->load(data);
+        if (!vis) return Duration::zero();
+    }
+    Time end_time = Timer::now();
+    return (end_time - start_time) / mIterations;
+}
+
+void MeshFormatBenchmark::benchmarkAsset(const String& filename) {
+    Transfer::DenseDataPtr collada_data = readFile(filename);
+    if (!collada_data || !mCollada->canLoad(collada_data)) {
+        SILOG(benchmark,error,"Couldn't load COLLADA asset " << filename);
+        return;
+    }
+
+    Mesh::VisualPtr vis = mCollada->load(collada_data);
+    if (!vis) {
+        SILOG(benchmark,error,"Couldn't parse COLLADA asset " << filename);
+        return;
+    }
+    std::stringstream binary_stream;
+    if (!mBinary->convertVisual(vis, "binarymodels", binary_stream)) {
+        SILOG(benchmark,error,"Couldn't convert " << filename << " to binary format");
+        return;
+    }
+    Transfer::DenseDataPtr binary_data(new Transfer::DenseData(binary_stream.str()));
+    vis.reset();
+
+    // Binary first: peak RSS is monotonic, so the larger COLLADA parse would
+    // otherwise mask the binary parser's memory use.
+    uint64 rss_before = peakRSS();
+    Duration binary_time = timeParse(mBinary, binary_data);
+    uint64 rss_binary = peakRSS();
+    Duration collada_time = timeParse(mCollada, collada_data);
+    uint64 rss_collada = peakRSS();
+
+    if (mForceStop) return;
+
+    SILOG(benchmark,info,
+        filename << ": " <<
+        "collada " << collada_data->length() << " bytes, " << collada_time << "/parse, +" << (rss_collada - rss_binary) << "KB peak RSS; " <<
+        "binary " << binary_data->length() << " bytes, " << binary_time << "/parse, +" << (rss_binary - rss_before) << "KB peak RSS; " <<
+        "speedup " << (binary_time.toSeconds() > 0 ? collada_time.toSeconds() / binary_time.toSeconds() : 0) << "x"
+    );
+}
+
+void MeshFormatBenchmark::start() {
+    mForceStop = false;
+
+    mPlugins = new PluginManager();
+    mPlugins->loadList("colladamodels,mesh-binary");
+    if (!ModelsSystemFactory::getSingleton().hasConstructor("colladamodels") ||
+        !ModelsSystemFactory::getSingleton().hasConstructor("binarymodels")) {
+        SILOG(benchmark,error,"Mesh format benchmark requires the colladamodels and mesh-binary plugins");
+        notifyFinished();
+        return;
+    }
+    mCollada = ModelsSystemFactory::getSingleton().getConstructor("colladamodels")("");
+    mBinary = ModelsSystemFactory::getSingleton().getConstructor("binarymodels")("");
+
+    for(uint32 i = 0; i < mAssets.size() && !mForceStop; i++)
+        benchmarkAsset(mAssets[i]);
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void MeshFormatBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,55 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_MESH_FORMAT_BENCHMARK_HPP_
+#define _SIRIKATA_MESH_FORMAT_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+#include <sirikata/core/transfer/TransferData.hpp>
+
+namespace Sirikata {
+
+class ModelsSystem;
+class PluginManager;
+
+/** MeshFormatBenchmark compares the cost of parsing meshes stored as COLLADA
+ *  with the cost of parsing the same meshes stored in the binary Meshdata
+ *  format. For each asset it reports the encoded size, average parse time
+ *  and the growth in peak resident memory caused by parsing.
+ */
+class MeshFormatBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new MeshFormatBenchmark(finished_cb, param);
+    }
+
+    MeshFormatBenchmark(const FinishedCallback& finished_cb, const String& param);
+    virtual ~MeshFormatBenchmark();
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    Transfer::DenseDataPtr readFile(const String& filename);
+    // Parses data iterations times with the given ModelsSystem, returning the
+    // average parse time or Duration::zero() on failure.
+    Duration timeParse(ModelsSystem* system, Transfer::DenseDataPtr data);
+    void benchmarkAsset(const String& filename);
+
+    bool mForceStop;
+    std::vector<String> mAssets;
+    uint32 mIterations;
+
+    PluginManager* mPlugins;
+    ModelsSystem* mCollada;
+    ModelsSystem* mBinary;
+}; // class MeshFormatBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_MESH_FORMAT_BENCHMARK_HPP_
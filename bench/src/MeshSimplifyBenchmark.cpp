@@ -0,0 +1,170 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "MeshSimplifyBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/util/Thread.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/core/util/PluginManager.hpp>
+#include <sirikata/mesh/ModelsSystemFactory.hpp>
+#include <sirikata/mesh/MeshSimplifier.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <fstream>
+#include <sstream>
+
+namespace Sirikata {
+
+namespace {
+// Count faces over all instanced geometry, the same measure the simplifier
+// uses for its budget.
+int32 countInstancedFaces(Mesh::MeshdataPtr md) {
+    int32 count = 0;
+    uint32 geoinst_idx;
+    Matrix4x4f geoinst_pos_xform;
+    Mesh::Meshdata::GeometryInstanceIterator geoinst_it = md->getGeometryInstanceIterator();
+    while( geoinst_it.next(&geoinst_idx, &geoinst_pos_xform) ) {
+        const Mesh::SubMeshGeometry& geo = md->geometry[ md->instances[geoinst_idx].geometryIndex ];
+        for(uint32 i = 0; i < geo.primitives.size(); i++)
+            count += geo.primitives[i].indices.size() / 3;
+    }
+    return count;
+}
+}
+
+MeshSimplifyBenchmark::MeshSimplifyBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mPlugins(NULL),
+          mCollada(NULL)
+{
+    OptionValue* assets;
+    OptionValue* targets;
+    OptionValue* threads;
+    OptionValue* iterations;
+    Sirikata::InitializeClassOptions ico("MeshSimplifyBenchmark",this,
+        assets=new OptionValue("assets","../../cdn/fake_root/test/duck.dae,../../cdn/fake_root/test/sphere.dae,../../cdn/fake_root/test/multimtl.dae,../../cdn/fake_root/test/sevenListo2.dae",Sirikata::OptionValueType<String>(),"Comma separated list of COLLADA files to test with"),
+        targets=new OptionValue("targets","0.5,0.25,0.1",Sirikata::OptionValueType<String>(),"Comma separated list of target face counts, as fractions of the original face count"),
+        threads=new OptionValue("threads","0",Sirikata::OptionValueType<uint32>(),"Number of threads for the parallel runs, 0 for one per hardware thread"),
+        iterations=new OptionValue("iterations","5",Sirikata::OptionValueType<uint32>(),"Number of times to simplify each asset in each configuration"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("MeshSimplifyBenchmark",this);
+    optionsSet->parse(param);
+
+    String asset_list = assets->as<String>();
+    boost::split(mAssets, asset_list, boost::is_any_of(","));
+
+    std::vector<String> target_strs;
+    String target_list = targets->as<String>();
+    boost::split(target_strs, target_list, boost::is_any_of(","));
+    for(uint32 i = 0; i < target_strs.size(); i++)
+        mTargets.push_back(boost::lexical_cast<float64>(target_strs[i]));
+
+    mThreads = threads->as<uint32>();
+    if (mThreads == 0) mThreads = Thread::hardware_concurrency();
+    mIterations = std::max(iterations->as<uint32>(), (uint32)1);
+}
+
+MeshSimplifyBenchmark::~MeshSimplifyBenchmark() {
+    delete mCollada;
+    delete mPlugins;
+}
+
+String MeshSimplifyBenchmark::name() {
+    return "mesh-simplify";
+}
+
+Mesh::MeshdataPtr MeshSimplifyBenchmark::loadAsset(const String& filename) {
+    std::ifstream fin(filename.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!fin) return Mesh::MeshdataPtr();
+    std::stringstream contents;
+    contents << fin.rdbuf();
+    Transfer::DenseDataPtr data(new Transfer::DenseData(contents.str()));
+    if (!mCollada->canLoad(data)) return Mesh::MeshdataPtr();
+    return std::tr1::dynamic_pointer_cast<Mesh::Meshdata>(mCollada->load(data));
+}
+
+void MeshSimplifyBenchmark::benchmarkAsset(const String& filename) {
+    Mesh::MeshdataPtr orig = loadAsset(filename);
+    if (!orig) {
+        SILOG(benchmark,error,"Couldn't load COLLADA asset " << filename);
+        return;
+    }
+
+    int32 orig_faces = countInstancedFaces(orig);
+    std::vector<int32> targets;
+    for(uint32 i = 0; i < mTargets.size(); i++)
+        targets.push_back((int32)(orig_faces * mTargets[i]));
+    int32 min_target = *std::min_element(targets.begin(), targets.end());
+
+    Mesh::MeshSimplifier single(1);
+    Mesh::MeshSimplifier parallel(mThreads);
+
+    // Single target, one thread vs. many
+    Duration single_time = Duration::zero(), parallel_time = Duration::zero();
+    int32 result_faces = 0;
+    for(uint32 it = 0; it < mIterations && !mForceStop; it++) {
+        Mesh::MeshdataPtr md(new Mesh::Meshdata(*orig));
+        Time start_time = Timer::now();
+        single.simplify(md, min_target);
+        single_time += Timer::now() - start_time;
+
+        md.reset(new Mesh::Meshdata(*orig));
+        start_time = Timer::now();
+        parallel.simplify(md, min_target);
+        parallel_time += Timer::now() - start_time;
+        result_faces = countInstancedFaces(md);
+    }
+
+    // All targets from one pass
+    Duration lods_time = Duration::zero();
+    std::vector<Mesh::MeshdataPtr> lods;
+    for(uint32 it = 0; it < mIterations && !mForceStop; it++) {
+        Time start_time = Timer::now();
+        parallel.simplify(orig, targets, &lods);
+        lods_time += Timer::now() - start_time;
+    }
+
+    if (mForceStop) return;
+
+    std::stringstream lod_faces;
+    for(uint32 i = 0; i < lods.size(); i++)
+        lod_faces << (i > 0 ? "," : "") << countInstancedFaces(lods[i]);
+
+    SILOG(benchmark,info,
+        filename << ": " << orig_faces << " faces -> " << result_faces << ", " <<
+        "1 thread " << (single_time / mIterations) << ", " <<
+        mThreads << " threads " << (parallel_time / mIterations) << "; " <<
+        lods.size() << " LODs (" << lod_faces.str() << ") " << (lods_time / mIterations)
+    );
+}
+
+void MeshSimplifyBenchmark::start() {
+    mForceStop = false;
+
+    mPlugins = new PluginManager();
+    mPlugins->loadList("colladamodels");
+    if (!ModelsSystemFactory::getSingleton().hasConstructor("colladamodels")) {
+        SILOG(benchmark,error,"Mesh simplification benchmark requires the colladamodels plugin");
+        notifyFinished();
+        return;
+    }
+    mCollada = ModelsSystemFactory::getSingleton().getConstructor("colladamodels")("");
+
+    for(uint32 i = 0; i < mAssets.size() && !mForceStop; i++)
+        benchmarkAsset(mAssets[i]);
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void MeshSimplifyBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,54 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_MESH_SIMPLIFY_BENCHMARK_HPP_
+#define _SIRIKATA_MESH_SIMPLIFY_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+#include <sirikata/mesh/Meshdata.hpp>
+
+namespace Sirikata {
+
+class ModelsSystem;
+class PluginManager;
+
+/** MeshSimplifyBenchmark measures the time MeshSimplifier takes to reduce each
+ *  test asset to a set of fractions of its original face count. For each asset
+ *  it times simplifying to the smallest target with one thread and with the
+ *  configured number of threads, and generating all targets as levels of
+ *  detail from a single pass.
+ */
+class MeshSimplifyBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new MeshSimplifyBenchmark(finished_cb, param);
+    }
+
+    MeshSimplifyBenchmark(const FinishedCallback& finished_cb, const String& param);
+    virtual ~MeshSimplifyBenchmark();
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    Mesh::MeshdataPtr loadAsset(const String& filename);
+    void benchmarkAsset(const String& filename);
+
+    bool mForceStop;
+    std::vector<String> mAssets;
+    std::vector<float64> mTargets;
+    uint32 mThreads;
+    uint32 mIterations;
+
+    PluginManager* mPlugins;
+    ModelsSystem* mCollada;
+}; // class MeshSimplifyBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_MESH_SIMPLIFY_BENCHMARK_HPP_
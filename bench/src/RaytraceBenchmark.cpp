@@ -0,0 +1,156 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "RaytraceBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/mesh/Raytrace.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace Sirikata {
+
+namespace {
+// Generates a unit sphere with roughly the requested number of triangles.
+Mesh::MeshdataPtr generateSphere(uint32 triangles) {
+    uint32 rings = std::max((uint32)sqrt(triangles / 4.f), (uint32)2);
+    uint32 segments = std::max(triangles / (2 * rings), (uint32)3);
+
+    Mesh::SubMeshGeometry geo;
+    geo.name = "sphere";
+    for(uint32 r = 0; r <= rings; r++) {
+        float32 phi = 3.14159265f * r / rings;
+        for(uint32 s = 0; s <= segments; s++) {
+            float32 theta = 2.f * 3.14159265f * s / segments;
+            geo.positions.push_back(Vector3f(sin(phi)*cos(theta), cos(phi), sin(phi)*sin(theta)));
+        }
+    }
+
+    Mesh::SubMeshGeometry::Primitive prim;
+    prim.primitiveType = Mesh::SubMeshGeometry::Primitive::TRIANGLES;
+    prim.materialId = 0;
+    for(uint32 r = 0; r < rings; r++) {
+        for(uint32 s = 0; s < segments; s++) {
+            uint32 a = r * (segments+1) + s, b = a + 1, c = a + segments + 1, d = c + 1;
+            prim.indices.push_back(a); prim.indices.push_back(b); prim.indices.push_back(d);
+            prim.indices.push_back(a); prim.indices.push_back(d); prim.indices.push_back(c);
+        }
+    }
+    geo.primitives.push_back(prim);
+    geo.recomputeBounds();
+
+    Mesh::MeshdataPtr md(new Mesh::Meshdata());
+    md->geometry.push_back(geo);
+    md->globalTransform = Matrix4x4f::identity();
+    md->nodes.push_back(Mesh::Node(Matrix4x4f::identity()));
+    md->rootNodes.push_back(0);
+    Mesh::GeometryInstance geoinst;
+    geoinst.geometryIndex = 0;
+    geoinst.parentNode = 0;
+    md->instances.push_back(geoinst);
+    return md;
+}
+}
+
+RaytraceBenchmark::RaytraceBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false)
+{
+    OptionValue* sizes;
+    OptionValue* rays;
+    Sirikata::InitializeClassOptions ico("RaytraceBenchmark",this,
+        sizes=new OptionValue("sizes","1000,10000,100000,1000000",Sirikata::OptionValueType<String>(),"Comma separated list of mesh sizes, in triangles"),
+        rays=new OptionValue("rays","65536",Sirikata::OptionValueType<uint32>(),"Number of rays to trace against each mesh"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("RaytraceBenchmark",this);
+    optionsSet->parse(param);
+
+    std::vector<String> size_strs;
+    String size_list = sizes->as<String>();
+    boost::split(size_strs, size_list, boost::is_any_of(","));
+    for(uint32 i = 0; i < size_strs.size(); i++)
+        mSizes.push_back(boost::lexical_cast<uint32>(size_strs[i]));
+
+    mRays = std::max(rays->as<uint32>(), (uint32)1);
+}
+
+RaytraceBenchmark::~RaytraceBenchmark() {
+}
+
+String RaytraceBenchmark::name() {
+    return "raytrace";
+}
+
+void RaytraceBenchmark::benchmarkMesh(uint32 triangles) {
+    Mesh::MeshdataPtr md = generateSphere(triangles);
+    // Place the mesh somewhere other than the origin so rays go through the
+    // transform.
+    Matrix4x4f xform = Matrix4x4f::translate(Vector3f(10.f, 0.f, 0.f)) * Matrix4x4f::scale(2.f);
+
+    Time start_time = Timer::now();
+    Mesh::MeshBVHPtr bvh = md->getBVH();
+    Duration build_time = Timer::now() - start_time;
+
+    // A square grid of rays from a single viewpoint, covering the sphere and
+    // some empty space around it.
+    uint32 side = std::max((uint32)sqrt((float32)mRays), (uint32)1);
+    Vector3f eye(10.f, 0.f, 10.f);
+    std::vector<Vector3f> starts, dirs;
+    for(uint32 y = 0; y < side; y++) {
+        for(uint32 x = 0; x < side; x++) {
+            Vector3f target(10.f + 5.f * (x / (float32)side - .5f), 5.f * (y / (float32)side - .5f), 0.f);
+            starts.push_back(eye);
+            dirs.push_back(target - eye);
+        }
+    }
+
+    uint32 single_hits = 0;
+    start_time = Timer::now();
+    for(uint32 i = 0; i < starts.size() && !mForceStop; i++) {
+        float32 t;
+        if (Mesh::Raytrace(md, xform, starts[i], dirs[i], &t, NULL))
+            single_hits++;
+    }
+    Duration single_time = Timer::now() - start_time;
+
+    std::vector<float32> ts;
+    std::vector<bool> hits;
+    start_time = Timer::now();
+    uint32 batch_hits = Mesh::Raytrace(md, xform, starts, dirs, &ts, &hits);
+    Duration batch_time = Timer::now() - start_time;
+
+    if (mForceStop) return;
+
+    if (single_hits != batch_hits)
+        SILOG(benchmark,error,"Single and batched raytracing disagree: " << single_hits << " vs. " << batch_hits << " hits");
+
+    float64 nrays = starts.size();
+    SILOG(benchmark,info,
+        bvh->numTriangles() << " triangles: " <<
+        "BVH build " << build_time << " (" << bvh->numNodes() << " nodes), " <<
+        nrays << " rays, " << batch_hits << " hits, " <<
+        "single " << (nrays / single_time.toSeconds()) << " rays/s, " <<
+        "batched " << (nrays / batch_time.toSeconds()) << " rays/s"
+    );
+}
+
+void RaytraceBenchmark::start() {
+    mForceStop = false;
+
+    for(uint32 i = 0; i < mSizes.size() && !mForceStop; i++)
+        benchmarkMesh(mSizes[i]);
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void RaytraceBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
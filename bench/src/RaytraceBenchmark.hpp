@@ -0,0 +1,44 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_RAYTRACE_BENCHMARK_HPP_
+#define _SIRIKATA_RAYTRACE_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+#include <sirikata/mesh/Meshdata.hpp>
+
+namespace Sirikata {
+
+/** RaytraceBenchmark measures Mesh::Raytrace against generated meshes of
+ *  increasing size. For each mesh it reports the time to build the mesh's BVH
+ *  and the throughput of tracing a grid of rays one at a time and as a single
+ *  batch.
+ */
+class RaytraceBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new RaytraceBenchmark(finished_cb, param);
+    }
+
+    RaytraceBenchmark(const FinishedCallback& finished_cb, const String& param);
+    virtual ~RaytraceBenchmark();
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    void benchmarkMesh(uint32 triangles);
+
+    bool mForceStop;
+    std::vector<uint32> mSizes;
+    uint32 mRays;
+}; // class RaytraceBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_RAYTRACE_BENCHMARK_HPP_
@@ -68,6 +68,8 @@ SSTBenchmark::SSTBenchmark(const FinishedCallback& finished_cb, const String&par
     OptionValue*listenOptions;
     OptionValue*whichPlugin;
     OptionValue*numPings;
+    OptionValue*framing;
+    OptionValue*compression;
     mIOService = new Sirikata::Network::IOService("SSTBenchmark");
     mIOStrand = mIOService->createStrand("SSTBenchmark Main");
     Sirikata::InitializeClassOptions ico("SSTBenchmark",this,
@@ -80,6 +82,8 @@ SSTBenchmark::SSTBenchmark(const FinishedCallback& finished_cb, const String&par
                                          streamOptions=new OptionValue("stream-options","--send-buffer-size=32768",Sirikata::OptionValueType<String>(),"options passed to tcpsst"),
                                          whichPlugin=new OptionValue("stream-plugin","tcpsst",Sirikata::OptionValueType<String>(),"which plugin to load for sst functionality"),
                                          numPings=new OptionValue("num-pings","1000",Sirikata::OptionValueType<size_t>(),"How many pings to "),
+                                         framing=new OptionValue("framing","rfc6455",Sirikata::OptionValueType<String>(),"Framing used by the connecting stream: rfc6455 (binary WebSocket frames) or length-delim (the older websocket-draft-76 framing)"),
+                                         compression=new OptionValue("compression","none",Sirikata::OptionValueType<String>(),"Compression used by both ends of the stream: none or deflate (rfc6455 framing only)"),
                                          NULL);
 
     OptionSet* optionsSet = OptionSet::getOptions("SSTBenchmark",this);
@@ -92,6 +96,18 @@ SSTBenchmark::SSTBenchmark(const FinishedCallback& finished_cb, const String&par
     mPingRate=Duration::seconds(pr?1./pr:0);
     mListenOptions=listenOptions->as<String>();
     mStreamOptions=streamOptions->as<String>();
+    mFraming=framing->as<String>();
+    if (mFraming=="length-delim") {
+        mStreamOptions+=" --websocket-draft-76=true";
+    }else {
+        if (mFraming!="rfc6455")
+            SILOG(benchmark,error,"Unknown framing "<<mFraming<<", using rfc6455");
+        mFraming="rfc6455";
+        mStreamOptions+=" --websocket-draft-76=false";
+    }
+    mCompression=compression->as<String>();
+    mStreamOptions+=" --compression="+mCompression;
+    mListenOptions+=" --compression="+mCompression;
     mStreamPlugin=whichPlugin->as<String>();
     mOrdered=ordered->as<bool>();
     mPingFunction=std::tr1::bind(&SSTBenchmark::pingPoller,this);
@@ -183,9 +199,15 @@ void SSTBenchmark::computePingTime(Sirikata::Network::Chunk&chk, const Sirikata:
             avg+=mPingResponses[i];
         }
         avg/=(double)mPingResponses.size();
+        SILOG(benchmark,info,"Framing: "<<mFraming);
         SILOG(benchmark,info,"Test Time: "<<cur-mStartTime);
         SILOG(benchmark,info,"Ping Average "<<avg);
         SILOG(benchmark,info,"Transfer Rate "<<2*mNumPings*(double)chk.size()/(cur-mStartTime).toSeconds());
+        SILOG(benchmark,info,"Compression: "<<mCompression);
+        SILOG(benchmark,info,"Compression Ratio "<<mStream->sendCompressionRatio());
+        SILOG(benchmark,info,"Compression Time "<<mStream->averageSendCompressionTime());
+        SILOG(benchmark,info,"Packets Per Write "<<mStream->averageSendBatchPackets());
+        SILOG(benchmark,info,"Bytes Per Write "<<mStream->averageSendBatchBytes());
         stop();
     }else
     if (mPingRate.toSeconds()==0) {
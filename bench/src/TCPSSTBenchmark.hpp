@@ -76,6 +76,8 @@ class SSTBenchmark : public Benchmark {
     size_t mNumPings; // Number of pings to collect before exiting and printing
                       // stats
 
+    String mFraming; // Framing requested by the connecting side
+    String mCompression; // Compression requested by both sides
     String mStreamOptions;
     String mListenOptions;
 
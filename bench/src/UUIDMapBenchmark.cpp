@@ -0,0 +1,104 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "UUIDMapBenchmark.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/core/util/UUIDFlatMap.hpp>
+
+namespace Sirikata {
+
+UUIDMapBenchmark::UUIDMapBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false)
+{
+    OptionValue* objects;
+    OptionValue* ops;
+    OptionValue* churn;
+    Sirikata::InitializeClassOptions ico("UUIDMapBenchmark",this,
+        objects=new OptionValue("objects","100000",Sirikata::OptionValueType<uint32>(),"Number of objects in the map"),
+        ops=new OptionValue("ops","10000000",Sirikata::OptionValueType<uint32>(),"Total number of map operations"),
+        churn=new OptionValue("churn","5",Sirikata::OptionValueType<uint32>(),"Percentage of operations which remove and re-add an object instead of looking it up"),
+        NULL);
+
+    OptionSet* optionsSet = OptionSet::getOptions("UUIDMapBenchmark",this);
+    optionsSet->parse(param);
+
+    mObjects = std::max(objects->as<uint32>(), (uint32)1);
+    mOps = ops->as<uint32>();
+    mChurn = std::min(churn->as<uint32>(), (uint32)100);
+}
+
+UUIDMapBenchmark::~UUIDMapBenchmark() {
+}
+
+String UUIDMapBenchmark::name() {
+    return "uuid-map";
+}
+
+template<typename MapType>
+Duration UUIDMapBenchmark::run(const std::vector<UUID>& ids, const std::vector<uint32>& ops) {
+    MapType objects;
+    for(uint32 i = 0; i < ids.size(); i++)
+        objects[ids[i]] = i;
+
+    // Keep the result live so lookups can't be optimized away
+    uint64 sum = 0;
+    Time start_time = Timer::now();
+    for(uint32 i = 0; i < ops.size() && !mForceStop; i++) {
+        uint32 idx = ops[i] >> 1;
+        const UUID& uuid = ids[idx];
+        if (ops[i] & 1) {
+            objects.erase(uuid);
+            objects.insert(typename MapType::value_type(uuid, idx));
+        }
+        else {
+            typename MapType::iterator it = objects.find(uuid);
+            if (it != objects.end())
+                sum += it->second;
+        }
+    }
+    Duration dur = Timer::now() - start_time;
+
+    if (sum == 0)
+        SILOG(benchmark,insane,"Empty lookups");
+
+    if (mForceStop)
+        return Duration::zero();
+    return dur;
+}
+
+void UUIDMapBenchmark::start() {
+    mForceStop = false;
+
+    std::vector<UUID> ids;
+    for(uint32 i = 0; i < mObjects; i++)
+        ids.push_back(UUID::random());
+    // Low bit selects churn vs. lookup, the rest is the object index. The same
+    // sequence is used for both maps.
+    std::vector<uint32> ops;
+    for(uint32 i = 0; i < mOps; i++)
+        ops.push_back( ((rand() % mObjects) << 1) | ((uint32)(rand() % 100) < mChurn ? 1 : 0) );
+
+    typedef std::tr1::unordered_map<UUID, uint32, UUID::Hasher> StdMap;
+    Duration std_dur = run<StdMap>(ids, ops);
+    if (mForceStop) return;
+    Duration flat_dur = run< UUIDFlatMap<uint32> >(ids, ops);
+    if (mForceStop) return;
+
+    float64 nops = ops.size();
+    SILOG(benchmark,info,
+        mObjects << " objects, " << nops << " ops, " << mChurn << "% churn: " <<
+        "unordered_map " << (nops / std_dur.toSeconds()) << " ops/s, " <<
+        "UUIDFlatMap " << (nops / flat_dur.toSeconds()) << " ops/s"
+    );
+
+    notifyFinished();
+}
+
+void UUIDMapBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,46 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_UUID_MAP_BENCHMARK_HPP_
+#define _SIRIKATA_UUID_MAP_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+#include <sirikata/core/util/UUID.hpp>
+
+namespace Sirikata {
+
+/** UUIDMapBenchmark compares std::tr1::unordered_map keyed by UUID against
+ *  UUIDFlatMap with the mix of lookups, inserts and erases the space server's
+ *  per-object tables see, reporting operations per second for each.
+ */
+class UUIDMapBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new UUIDMapBenchmark(finished_cb, param);
+    }
+
+    UUIDMapBenchmark(const FinishedCallback& finished_cb, const String& param);
+    virtual ~UUIDMapBenchmark();
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    // Returns the time taken to apply all operations, or zero if stopped
+    template<typename MapType>
+    Duration run(const std::vector<UUID>& ids, const std::vector<uint32>& ops);
+
+    bool mForceStop;
+    uint32 mObjects;
+    uint32 mOps;
+    uint32 mChurn;
+}; // class UUIDMapBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_UUID_MAP_BENCHMARK_HPP_
@@ -36,6 +36,13 @@
 #include "TimerJitterBenchmark.hpp"
 #include "TimerMonotonicityBenchmark.hpp"
 #include "TCPSSTBenchmark.hpp"
+#include "MeshFormatBenchmark.hpp"
+#include "MeshSimplifyBenchmark.hpp"
+#include "RaytraceBenchmark.hpp"
+#include "JSSerializeBenchmark.hpp"
+#include "LocationUpdateBenchmark.hpp"
+#include "UUIDMapBenchmark.hpp"
+#include "CSFQFlowBenchmark.hpp"
 
 #include <sirikata/core/util/DynamicLibrary.hpp>
 
@@ -67,6 +74,16 @@ int main(int argc, char** argv) {
     ADD_BENCHMARK(timer-monotonicity, TimerMonotonicityBenchmark::create);
 
     ADD_BENCHMARK(ping, SSTBenchmark::create);
+
+    ADD_BENCHMARK(mesh-format, MeshFormatBenchmark::create);
+    ADD_BENCHMARK(mesh-simplify, MeshSimplifyBenchmark::create);
+    ADD_BENCHMARK(raytrace, RaytraceBenchmark::create);
+
+    ADD_BENCHMARK(js-serialize, JSSerializeBenchmark::create);
+
+    ADD_BENCHMARK(location-update, LocationUpdateBenchmark::create);
+    ADD_BENCHMARK(uuid-map, UUIDMapBenchmark::create);
+    ADD_BENCHMARK(csfq-flows, CSFQFlowBenchmark::create);
     BenchmarkRunner runner(factory, Duration::seconds(30.f));
 
 
@@ -34,6 +34,7 @@
 
 #include "IODefs.hpp"
 #include "IOService.hpp"
+#include <sirikata/core/util/AtomicTypes.hpp>
 
 namespace Sirikata {
 
@@ -43,10 +44,22 @@ namespace Network {
 
 /** IOServicePool creates a pool of IOService threads for handling
  *  IO events.
+ *
+ *  By default all the threads run a single shared IOService. With
+ *  ReactorPerThread each thread instead runs its own IOService, so events
+ *  for objects created on one of those services never contend with other
+ *  threads for the reactor. Users spread work over the reactors with
+ *  nextService() and must keep everything touching a given object (e.g. a
+ *  socket and its strand) on the same service to benefit.
  */
 class SIRIKATA_EXPORT IOServicePool {
   public:
-    IOServicePool(const String& name, uint32 nthreads);
+    enum ReactorMode {
+        SharedReactor,
+        ReactorPerThread
+    };
+
+    IOServicePool(const String& name, uint32 nthreads, ReactorMode mode = SharedReactor);
     ~IOServicePool();
 
     /** Run the thread pool. */
@@ -70,12 +83,26 @@ class SIRIKATA_EXPORT IOServicePool {
      *  \param thr the index of the thread to retrieve the IOService for
      */
     IOService* service();
+    IOService* service(uint32 thr);
+
+    /** Get the number of independent IOServices in the pool: 1 for
+     *  SharedReactor, the number of threads for ReactorPerThread.
+     */
+    uint32 size() const { return (uint32)mServices.size(); }
+
+    /** Get the next IOService in round-robin order. Safe to call from any
+     *  thread.
+     */
+    IOService* nextService();
 
   private:
-    IOService* mIO;
+    typedef std::vector<IOService*> ServiceList;
+    ServiceList mServices;
     typedef std::vector<Thread*> ThreadList;
     ThreadList mThreads;
-    IOWork* mWork;
+    typedef std::vector<IOWork*> WorkList;
+    WorkList mWork;
+    AtomicValue<uint32> mNextService;
 };
 
 } // namespace Network
@@ -80,6 +80,13 @@ public:
     };
 }; // class ObjectMessage
 
+/** The serialized bytes an ObjectMessage was parsed from. Routing code carries
+ *  these alongside the parsed message so that a message which is only being
+ *  passed along can be sent on without serializing it again. NULL for
+ *  messages built locally, which have to be serialized.
+ */
+typedef std::tr1::shared_ptr<const std::string> ObjectMessageBytesPtr;
+
 // FIXME get rid of this
 SIRIKATA_FUNCTION_EXPORT void createObjectHostMessage(ObjectHostID source_server, const SpaceObjectReference& sporef_src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, const std::string& payload, ObjectMessage* result);
 
@@ -305,6 +305,35 @@ public:
         return Duration::zero();
     }
 
+    /** Get the ratio of bytes put on the wire to bytes sent by the user, for
+     *  streams which compress data before sending it.  Returns 1 if the stream
+     *  doesn't compress.
+     */
+    virtual float64 sendCompressionRatio() const {
+        return 1.0;
+    }
+
+    /** Get the average time spent compressing each outgoing packet, for
+     *  streams which compress data before sending it.
+     */
+    virtual Duration averageSendCompressionTime() const {
+        return Duration::zero();
+    }
+
+    /** Get the average number of packets handed to the underlying network
+     *  library in each write, for streams which batch outgoing packets.
+     */
+    virtual float64 averageSendBatchPackets() const {
+        return 1.0;
+    }
+
+    /** Get the average number of bytes handed to the underlying network
+     *  library in each write.  Returns 0 if the stream doesn't track it.
+     */
+    virtual float64 averageSendBatchBytes() const {
+        return 0.0;
+    }
+
 };
 } // namespace Network
 } // namespace Sirikata
@@ -76,6 +76,7 @@ struct Drops {
 #define MigrationBeginTag 11
 #define MigrationAckTag 12
 #define MigrationRoundTripTag 18
+#define MigrationPauseTag 35
 
 #define ServerLocationTag 13
 #define ServerObjectEventTag 14
@@ -43,7 +43,8 @@ template<typename ValType>
 class EWA {
 public:
     EWA(float alpha)
-     : mAlpha(alpha)
+     : mAlpha(alpha),
+       mEWA()
     {}
 
     void sample(const ValType& _s) {
@@ -91,6 +91,19 @@ public:
     bool operator==(const UUID &other)const {return mData == other.mData;}
     bool isNull()const{return mData==Data::null();}
     size_t hash() const;
+    /** A 64 bit hash of the UUID. Most UUIDs are random already, so this only
+     *  folds the two halves together and spreads any structure in them.
+     */
+    uint64 hash64() const {
+        uint64 lo, hi;
+        std::memcpy(&lo, mData.data(), 8);
+        std::memcpy(&hi, mData.data() + 8, 8);
+        uint64 h = lo ^ (hi * 0x9e3779b97f4a7c15ULL);
+        h ^= h >> 32;
+        h *= 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+        return h;
+    }
     class Hasher{public:
         size_t operator() (const UUID&uuid) const {
             return uuid.hash();
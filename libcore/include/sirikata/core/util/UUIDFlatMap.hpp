@@ -0,0 +1,374 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_UUID_FLAT_MAP_HPP_
+#define _SIRIKATA_UUID_FLAT_MAP_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/UUID.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIRIKATA_UUID_FLAT_MAP_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Sirikata {
+
+namespace UUIDFlatMapDetail {
+
+/** Each slot has a control byte: empty, deleted, or the low 7 bits of the
+ *  key's hash if it's in use. Control bytes are scanned a group at a time, so
+ *  a lookup usually checks 16 candidate slots with a couple of instructions
+ *  and only compares keys whose hash bits match.
+ */
+enum {
+    GROUP_SIZE = 16
+};
+const int8 CTRL_EMPTY = -128;
+const int8 CTRL_DELETED = -2;
+
+// Bit i is set if control byte i in the group matches
+typedef uint32 GroupMask;
+
+inline GroupMask matchByte(const int8* group, int8 val) {
+#ifdef SIRIKATA_UUID_FLAT_MAP_SSE2
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (GroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(val)));
+#else
+    GroupMask result = 0;
+    for(int i = 0; i < GROUP_SIZE; i++)
+        if (group[i] == val) result |= (1u << i);
+    return result;
+#endif
+}
+
+// Empty and deleted are the only negative control bytes
+inline GroupMask matchEmptyOrDeleted(const int8* group) {
+#ifdef SIRIKATA_UUID_FLAT_MAP_SSE2
+    return (GroupMask)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+    GroupMask result = 0;
+    for(int i = 0; i < GROUP_SIZE; i++)
+        if (group[i] < 0) result |= (1u << i);
+    return result;
+#endif
+}
+
+inline uint32 lowestBit(GroupMask mask) {
+#if defined(__GNUC__)
+    return (uint32)__builtin_ctz(mask);
+#elif defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return (uint32)idx;
+#else
+    uint32 idx = 0;
+    while(!(mask & 1)) { mask >>= 1; idx++; }
+    return idx;
+#endif
+}
+
+} // namespace UUIDFlatMapDetail
+
+/** A hash map from UUIDs to V, for the places which look up objects by ID on
+ *  every message or update. Entries are stored inline in one array using open
+ *  addressing, with probing done a group of slots at a time, so a lookup
+ *  normally touches one run of control bytes and one slot, and there is no
+ *  per-entry allocation. The hash is UUID::hash64(), which is cheap since
+ *  UUIDs are mostly random already.
+ *
+ *  The interface follows std::tr1::unordered_map, with one important
+ *  difference: inserting can move every entry, which invalidates all
+ *  iterators, pointers and references into the map. Erasing doesn't move
+ *  anything, so erase(it++) while iterating works. Store pointers as values if
+ *  you need stable addresses.
+ */
+template<typename V>
+class UUIDFlatMap {
+public:
+    typedef UUID key_type;
+    typedef V mapped_type;
+    typedef std::pair<const UUID, V> value_type;
+    typedef size_t size_type;
+
+    template<typename ValueT>
+    class Iter {
+    public:
+        Iter() : mCtrl(NULL), mSlots(NULL), mIdx(0), mCapacity(0) {}
+        // Allows iterator -> const_iterator
+        template<typename OtherT>
+        Iter(const Iter<OtherT>& rhs)
+         : mCtrl(rhs.mCtrl), mSlots(rhs.mSlots), mIdx(rhs.mIdx), mCapacity(rhs.mCapacity)
+        {}
+
+        ValueT& operator*() const { return mSlots[mIdx]; }
+        ValueT* operator->() const { return &mSlots[mIdx]; }
+
+        Iter& operator++() {
+            mIdx++;
+            skipUnused();
+            return *this;
+        }
+        Iter operator++(int) {
+            Iter retval(*this);
+            ++(*this);
+            return retval;
+        }
+
+        bool operator==(const Iter& rhs) const { return mIdx == rhs.mIdx && mSlots == rhs.mSlots; }
+        bool operator!=(const Iter& rhs) const { return !(*this == rhs); }
+
+    private:
+        friend class UUIDFlatMap;
+        template<typename OtherT> friend class Iter;
+
+        Iter(const int8* ctrl, ValueT* slots, size_t idx, size_t capacity)
+         : mCtrl(ctrl), mSlots(slots), mIdx(idx), mCapacity(capacity)
+        {}
+
+        void skipUnused() {
+            while(mIdx < mCapacity && mCtrl[mIdx] < 0)
+                mIdx++;
+        }
+
+        const int8* mCtrl;
+        ValueT* mSlots;
+        size_t mIdx;
+        size_t mCapacity;
+    };
+    typedef Iter<value_type> iterator;
+    typedef Iter<const value_type> const_iterator;
+
+    UUIDFlatMap()
+     : mCtrl(NULL),
+       mSlots(NULL),
+       mCapacity(0),
+       mSize(0),
+       mDeleted(0)
+    {}
+
+    UUIDFlatMap(const UUIDFlatMap& rhs)
+     : mCtrl(NULL),
+       mSlots(NULL),
+       mCapacity(0),
+       mSize(0),
+       mDeleted(0)
+    {
+        reserve(rhs.size());
+        for(const_iterator it = rhs.begin(); it != rhs.end(); it++)
+            insert(*it);
+    }
+
+    UUIDFlatMap& operator=(const UUIDFlatMap& rhs) {
+        UUIDFlatMap copy(rhs);
+        swap(copy);
+        return *this;
+    }
+
+    ~UUIDFlatMap() {
+        destroyAll();
+        deallocate(mCtrl, mSlots);
+    }
+
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    iterator begin() {
+        iterator it(mCtrl, mSlots, 0, mCapacity);
+        it.skipUnused();
+        return it;
+    }
+    iterator end() { return iterator(mCtrl, mSlots, mCapacity, mCapacity); }
+    const_iterator begin() const {
+        const_iterator it(mCtrl, mSlots, 0, mCapacity);
+        it.skipUnused();
+        return it;
+    }
+    const_iterator end() const { return const_iterator(mCtrl, mSlots, mCapacity, mCapacity); }
+
+    iterator find(const UUID& key) {
+        size_t idx = findIndex(key);
+        return (idx == mCapacity) ? end() : iterator(mCtrl, mSlots, idx, mCapacity);
+    }
+    const_iterator find(const UUID& key) const {
+        size_t idx = findIndex(key);
+        return (idx == mCapacity) ? end() : const_iterator(mCtrl, mSlots, idx, mCapacity);
+    }
+    size_t count(const UUID& key) const {
+        return (findIndex(key) == mCapacity) ? 0 : 1;
+    }
+
+    std::pair<iterator, bool> insert(const value_type& val) {
+        size_t idx = findIndex(val.first);
+        if (idx != mCapacity)
+            return std::make_pair(iterator(mCtrl, mSlots, idx, mCapacity), false);
+        idx = insertNew(val.first, val.second);
+        return std::make_pair(iterator(mCtrl, mSlots, idx, mCapacity), true);
+    }
+
+    V& operator[](const UUID& key) {
+        size_t idx = findIndex(key);
+        if (idx == mCapacity)
+            idx = insertNew(key, V());
+        return mSlots[idx].second;
+    }
+
+    void erase(iterator it) {
+        eraseIndex(it.mIdx);
+    }
+    size_t erase(const UUID& key) {
+        size_t idx = findIndex(key);
+        if (idx == mCapacity)
+            return 0;
+        eraseIndex(idx);
+        return 1;
+    }
+
+    void clear() {
+        destroyAll();
+        if (mCapacity > 0)
+            std::memset(mCtrl, UUIDFlatMapDetail::CTRL_EMPTY, mCapacity);
+        mSize = 0;
+        mDeleted = 0;
+    }
+
+    /** Make room for n entries without further rehashing. */
+    void reserve(size_t n) {
+        size_t needed = UUIDFlatMapDetail::GROUP_SIZE;
+        while(needed * 7 / 8 < n)
+            needed *= 2;
+        if (needed > mCapacity)
+            rehash(needed);
+    }
+
+    void swap(UUIDFlatMap& rhs) {
+        std::swap(mCtrl, rhs.mCtrl);
+        std::swap(mSlots, rhs.mSlots);
+        std::swap(mCapacity, rhs.mCapacity);
+        std::swap(mSize, rhs.mSize);
+        std::swap(mDeleted, rhs.mDeleted);
+    }
+
+private:
+    // Position of the first group to probe, and the control byte for the key
+    static size_t groupHash(uint64 h) { return (size_t)(h >> 7); }
+    static int8 ctrlHash(uint64 h) { return (int8)(h & 0x7f); }
+
+    size_t numGroups() const { return mCapacity / UUIDFlatMapDetail::GROUP_SIZE; }
+
+    // Returns mCapacity if not found
+    size_t findIndex(const UUID& key) const {
+        using namespace UUIDFlatMapDetail;
+        if (mSize == 0)
+            return mCapacity;
+
+        uint64 h = key.hash64();
+        int8 h2 = ctrlHash(h);
+        size_t group_mask = numGroups() - 1;
+        size_t group = groupHash(h) & group_mask;
+        // Triangular probing visits every group once when the number of
+        // groups is a power of two.
+        for(size_t probe = 1; probe <= numGroups(); probe++) {
+            const int8* ctrl = mCtrl + group * GROUP_SIZE;
+            for(GroupMask m = matchByte(ctrl, h2); m != 0; m &= m - 1) {
+                size_t idx = group * GROUP_SIZE + lowestBit(m);
+                if (mSlots[idx].first == key)
+                    return idx;
+            }
+            // An empty slot means the key would have been placed here.
+            if (matchByte(ctrl, CTRL_EMPTY) != 0)
+                return mCapacity;
+            group = (group + probe) & group_mask;
+        }
+        return mCapacity;
+    }
+
+    // First empty or deleted slot along key's probe sequence. There must be one.
+    size_t findInsertIndex(uint64 h) const {
+        using namespace UUIDFlatMapDetail;
+        size_t group_mask = numGroups() - 1;
+        size_t group = groupHash(h) & group_mask;
+        for(size_t probe = 1; ; probe++) {
+            GroupMask m = matchEmptyOrDeleted(mCtrl + group * GROUP_SIZE);
+            if (m != 0)
+                return group * GROUP_SIZE + lowestBit(m);
+            group = (group + probe) & group_mask;
+        }
+    }
+
+    // Inserts a key known not to be present, returning its index
+    size_t insertNew(const UUID& key, const V& val) {
+        // Keep at least 1/8 of slots empty so probes terminate quickly.
+        if ((mSize + mDeleted + 1) * 8 > mCapacity * 7) {
+            // Mostly tombstones: clean up in place instead of growing
+            if (mCapacity > 0 && (mSize + 1) * 2 <= mCapacity * 7 / 8)
+                rehash(mCapacity);
+            else
+                rehash(mCapacity == 0 ? (size_t)UUIDFlatMapDetail::GROUP_SIZE : mCapacity * 2);
+        }
+
+        uint64 h = key.hash64();
+        size_t idx = findInsertIndex(h);
+        if (mCtrl[idx] == UUIDFlatMapDetail::CTRL_DELETED)
+            mDeleted--;
+        new (&mSlots[idx]) value_type(key, val);
+        mCtrl[idx] = ctrlHash(h);
+        mSize++;
+        return idx;
+    }
+
+    void eraseIndex(size_t idx) {
+        assert(idx < mCapacity && mCtrl[idx] >= 0);
+        mSlots[idx].~value_type();
+        mCtrl[idx] = UUIDFlatMapDetail::CTRL_DELETED;
+        mSize--;
+        mDeleted++;
+    }
+
+    void rehash(size_t new_capacity) {
+        int8* old_ctrl = mCtrl;
+        value_type* old_slots = mSlots;
+        size_t old_capacity = mCapacity;
+
+        mCtrl = new int8[new_capacity];
+        std::memset(mCtrl, UUIDFlatMapDetail::CTRL_EMPTY, new_capacity);
+        mSlots = static_cast<value_type*>(::operator new(new_capacity * sizeof(value_type)));
+        mCapacity = new_capacity;
+        mDeleted = 0;
+
+        for(size_t i = 0; i < old_capacity; i++) {
+            if (old_ctrl[i] < 0) continue;
+            uint64 h = old_slots[i].first.hash64();
+            size_t idx = findInsertIndex(h);
+            new (&mSlots[idx]) value_type(old_slots[i]);
+            mCtrl[idx] = ctrlHash(h);
+            old_slots[i].~value_type();
+        }
+        deallocate(old_ctrl, old_slots);
+    }
+
+    void destroyAll() {
+        for(size_t i = 0; i < mCapacity; i++)
+            if (mCtrl[i] >= 0)
+                mSlots[i].~value_type();
+    }
+
+    static void deallocate(int8* ctrl, value_type* slots) {
+        delete[] ctrl;
+        ::operator delete(slots);
+    }
+
+    int8* mCtrl;
+    value_type* mSlots;
+    size_t mCapacity; // Always 0 or a power of two multiple of GROUP_SIZE
+    size_t mSize;
+    size_t mDeleted;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_UUID_FLAT_MAP_HPP_
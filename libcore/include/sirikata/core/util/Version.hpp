@@ -0,0 +1,56 @@
+/*  Sirikata
+ *  Version.hpp
+ *
+ *  Copyright (c) 2010, Ewen Cheslack-Postava
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SIRIKATA_CORE_VERSION_HPP_
+#define _SIRIKATA_CORE_VERSION_HPP_
+
+
+// Version numbers
+#define SIRIKATA_VERSION_MAJOR 0
+#define SIRIKATA_VERSION_MINOR 0
+#define SIRIKATA_VERSION_REVISION 24
+
+// Version number strings
+#define SIRIKATA_VERSION_MAJOR_STRING "0"
+#define SIRIKATA_VERSION_MINOR_STRING "0"
+#define SIRIKATA_VERSION_REVISION_STRING "24"
+
+#define SIRIKATA_SOVERSION 0
+#define SIRIKATA_SOVERSION_STRING "0"
+
+#define SIRIKATA_GIT_REVISION "8e72387adf65ebf6022dad965b1fd365b9651dc1"
+
+// The full version can only be presented as a string
+#define SIRIKATA_VERSION "0.0.24"
+
+
+#endif
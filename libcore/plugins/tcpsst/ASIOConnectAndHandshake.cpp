@@ -70,6 +70,13 @@ using namespace boost::asio::ip;
             if (mFinishedCheckCount>=1) {
                 boost::asio::ip::tcp::no_delay option(noDelay);
                 connection->getASIOSocketWrapper(whichSocket).getSocket().set_option(option);
+                if (connection->getStreamType()==Sirikata::Network::TCPStream::RFC_6455 &&
+                    connection->getCompressionSettings().enabled) {
+                    // Only compress if the listener echoed the extension back
+                    std::string responseHeader((const char*)buffer->begin(),whereHeaderEnds);
+                    if (responseHeader.find(CompressionSettings::extensionName())!=std::string::npos)
+                        connection->getASIOSocketWrapper(whichSocket).enableCompression(connection->getCompressionSettings());
+                }
                 mFinishedCheckCount--;
                 if (mFinishedCheckCount==0) {
                     connection->connectedCallback();
@@ -40,6 +40,7 @@
 #include "MultiplexedSocket.hpp"
 #include "ASIOReadBuffer.hpp"
 #include "VariableLength.hpp"
+#include "WebSocketFrame.hpp"
 namespace Sirikata { namespace Network {
 
 struct ASIOReadBufferUtil {
@@ -100,16 +101,21 @@ void ASIOReadBuffer::processError(MultiplexedSocket*parentSocket, const boost::s
     delete this;
 }
 ASIOReadBuffer::ReceivedResponse ASIOReadBuffer::processFullChunk(const MultiplexedSocketPtr &parentSocket, unsigned int whichSocket, const Stream::StreamID&id, Chunk&newChunk, const Stream::PauseReceiveCallback& pauseReceive){
-    if (*(int*)mDataMask) {
-        for (unsigned int i = 0; i < newChunk.size(); i++) {
-            newChunk[i] ^= mDataMask[i & 3];
-        }
-    }
+    // The payload was already unmasked as it was copied or read into newChunk.
     *(int*)mDataMask = 0; // Mask no longer applies after one packet.
     if (mLastFrame) {
+        // Inflate into a separate chunk so that newChunk stays intact if the
+        // user pauses and we have to deliver it again later.
+        Chunk inflated;
+        if (mCompressedMessage && !mDecompressor.inflatePayload(newChunk, &inflated)) {
+            SILOG(tcpsst,warning,"Dropping compressed packet for stream "<<id.read()<<" which failed to inflate");
+            mNewChunk.resize(0);
+            mChunkBufferPos=0;
+            return StreamNotPaused;
+        }
         bool user_paused_stream = false;
         parentSocket->receiveFullChunk(
-            whichSocket,id,newChunk,
+            whichSocket,id,mCompressedMessage ? inflated : newChunk,
             std::tr1::bind(ASIOReadBufferUtil::_mark_pause_bool_true, &user_paused_stream, pauseReceive)
             );
         if (!user_paused_stream) {
@@ -121,83 +127,6 @@ ASIOReadBuffer::ReceivedResponse ASIOReadBuffer::processFullChunk(const Multiple
         return StreamNotPaused;
     }
 }
-static signed char WHITE_SPACE_ENC = -5; // Indicates white space in encoding
-static signed char EQUALS_SIGN_ENC = -1; // Indicates equals sign in encoding
-static int decode4to3(const signed char source[4],Chunk& destination, int destOffset) {
-    uint32 outBuf=((source[0]<<18)|(source[1]<<12));
-    destination[destOffset]=(uint8)(outBuf/65536);
-    if (source[2]==EQUALS_SIGN_ENC) {
-        return 1;
-    }
-    outBuf|=(source[2]<<6);
-    destination[destOffset+1]=(uint8)((outBuf/256)&255);
-    if (source[3]==EQUALS_SIGN_ENC) {
-            return 2;
-    }
-    outBuf|=source[3];
-    destination[destOffset+2]=(uint8)(outBuf&255);
-    return 3;
-}
-
-static signed char DECODABET [] = {
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,                 // Decimal  0 -  8
-        -5,-5,                                      // Whitespace: Tab and Linefeed
-        -9,-9,                                      // Decimal 11 - 12
-        -5,                                         // Whitespace: Carriage Return
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,     // Decimal 14 - 26
-        -9,-9,-9,-9,-9,                             // Decimal 27 - 31
-        -5,                                         // Whitespace: Space
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,-9,              // Decimal 33 - 42
-        62,                                         // Plus sign at decimal 43
-        -9,-9,-9,                                   // Decimal 44 - 46
-        63,                                         // Slash at decimal 47
-        52,53,54,55,56,57,58,59,60,61,              // Numbers zero through nine
-        -9,-9,-9,                                   // Decimal 58 - 60
-        -1,                                         // Equals sign at decimal 61
-        -9,-9,-9,                                      // Decimal 62 - 64
-        0,1,2,3,4,5,6,7,8,9,10,11,12,13,            // Letters 'A' through 'N'
-        14,15,16,17,18,19,20,21,22,23,24,25,        // Letters 'O' through 'Z'
-        -9,-9,-9,-9,-9,-9,                          // Decimal 91 - 96
-        26,27,28,29,30,31,32,33,34,35,36,37,38,     // Letters 'a' through 'm'
-        39,40,41,42,43,44,45,46,47,48,49,50,51,     // Letters 'n' through 'z'
-        -9,-9,-9,-9,-9                                 // Decimal 123 - 126
-};
-static signed char URLSAFEDECODABET [] = {
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,                 // Decimal  0 -  8
-        -5,-5,                                      // Whitespace: Tab and Linefeed
-        -9,-9,                                      // Decimal 11 - 12
-        -5,                                         // Whitespace: Carriage Return
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,-9,     // Decimal 14 - 26
-        -9,-9,-9,-9,-9,                             // Decimal 27 - 31
-        -5,                                         // Whitespace: Space
-        -9,-9,-9,-9,-9,-9,-9,-9,-9,-9,              // Decimal 33 - 42
-        62,                                         // Plus sign at decimal 43
-        -9,62,-9,                                   // Decimal 44 - 46
-        63,                                         // Slash at decimal 47
-        52,53,54,55,56,57,58,59,60,61,              // Numbers zero through nine
-        -9,-9,-9,                                   // Decimal 58 - 60
-        -1,                                         // Equals sign at decimal 61
-        -9,-9,-9,                                      // Decimal 62 - 64
-        0,1,2,3,4,5,6,7,8,9,10,11,12,13,            // Letters 'A' through 'N'
-        14,15,16,17,18,19,20,21,22,23,24,25,        // Letters 'O' through 'Z'
-        -9,-9,-9,-9,63,-9,                          // Decimal 91 - 94 underscore 95
-        26,27,28,29,30,31,32,33,34,35,36,37,38,     // Letters 'a' through 'm'
-        39,40,41,42,43,44,45,46,47,48,49,50,51,     // Letters 'n' through 'z'
-        -9,-9,-9,-9,-9                                 // Decimal 123 - 127
-};
-static Stream::StreamID parseId(Chunk&newChunk,int&outBuffPosn) {
-    Stream::StreamID id;
-    unsigned int headerLength=outBuffPosn;
-    id.unserialize(&*newChunk.begin(),headerLength);
-    if ((int)headerLength!=outBuffPosn) {
-        std::memmove(&*newChunk.begin(),&*(newChunk.begin()+headerLength),outBuffPosn-headerLength);//move the rest of the packet out
-    }
-    outBuffPosn-=headerLength;
-    return id;
-}
-
-
-
 void ASIOReadBuffer::readIntoFixedBuffer(const MultiplexedSocketPtr &parentSocket){
     mReadStatus=READING_FIXED_BUFFER;
 
@@ -282,8 +211,14 @@ void ASIOReadBuffer::processPartialChunk(uint8* dataBuffer, uint32 packetLength,
         numHeaderBytesFromThisPacket = 0;
     }
     currentChunk.resize(mChunkBufferPos + packetLength - numHeaderBytesFromThisPacket);
+    mFrameStart = mChunkBufferPos;
     if (packetLength>numHeaderBytesFromThisPacket) {
-        std::memcpy(&*currentChunk.begin() + mChunkBufferPos, dataBuffer + numHeaderBytesFromThisPacket, bufferReceived);
+        // The mask was rotated past the header above, so the payload starts
+        // at phase 0. Unmask while copying rather than in a second pass.
+        if (WebSocketFrame::hasMask(mDataMask))
+            WebSocketFrame::applyMask(&*currentChunk.begin() + mChunkBufferPos, dataBuffer + numHeaderBytesFromThisPacket, bufferReceived, mDataMask);
+        else
+            std::memcpy(&*currentChunk.begin() + mChunkBufferPos, dataBuffer + numHeaderBytesFromThisPacket, bufferReceived);
     }
 }
 void ASIOReadBuffer::translateFixedBuffer(const MultiplexedSocketPtr &thus) {
@@ -304,6 +239,8 @@ void ASIOReadBuffer::translateFixedBuffer(const MultiplexedSocketPtr &thus) {
             // 0x00 is a continuation frame.
             mFirstFrame = (type != 0x00);
             mLastFrame = fin;
+            if (mFirstFrame && type < 0x08)
+                mCompressedMessage = (flags & WebSocketFrame::RSV1_FLAG) ? true : false;
 
             length = mBuffer[currentFixedBufferPos + 1];
             bool masked = (length & 0x80) ? true: false;
@@ -456,6 +393,10 @@ void ASIOReadBuffer::asioReadIntoChunk(const ErrorCode&error,std::size_t bytes_r
     if (bytes_read)
         BufferPrint(this, ".rcc", &*mNewChunk.begin()+mChunkBufferPos, bytes_read);
     TCPSSTLOG(this,"rcv",&mNewChunk[mChunkBufferPos],bytes_read,error);
+    if (bytes_read && WebSocketFrame::hasMask(mDataMask)) {
+        uint8* readData = &*mNewChunk.begin() + mChunkBufferPos;
+        WebSocketFrame::applyMask(readData, readData, bytes_read, mDataMask, mChunkBufferPos - mFrameStart);
+    }
     mChunkBufferPos+=bytes_read;
     MultiplexedSocketPtr thus(mParentSocket.lock());
 
@@ -514,7 +455,9 @@ ASIOReadBuffer::ASIOReadBuffer(const MultiplexedSocketPtr &parentSocket,unsigned
     mReadStatus=READING_FIXED_BUFFER;
     mFixedBufferPos=0;
     mChunkBufferPos=0;
+    mFrameStart=0;
     mFirstFrame = mLastFrame = false;
+    mCompressedMessage = false;
     mWhichBuffer=whichSocket;
     mCachedRejectedChunk=NULL;
     mStreamType = type;
@@ -79,6 +79,8 @@ private:
     std::vector<uint8> mPartialStreamId;
     bool mFirstFrame; ///< First frame in a series of continuations (has stream id)
     bool mLastFrame; ///< Last frame in a series of continuations (we actually process)
+    bool mCompressedMessage; ///< The first frame of this message had RSV1 set, so its data is deflated
+    FrameDecompressor mDecompressor;
 
     ///Which actual low level tcp socket from the mParentSocket is used for communication
     unsigned int mWhichBuffer;
@@ -89,6 +91,8 @@ private:
     Stream::StreamID mNewChunkID;
     /// WebSocket permits packets to be XORed by a repeating 32-bit value. We need to store it after reading a partial packet.
     uint8 mDataMask[4];
+    /// Offset in mNewChunk where the payload of the frame currently being read starts, so data read straight into mNewChunk can be unmasked with the right phase.
+    unsigned int mFrameStart;
     /// Local copy of the stream type to avoid locking.
     TCPStream::StreamType mStreamType;
     ///The shared structure responsible for holding state about the associated TCPStream that this class reads and interprets data from
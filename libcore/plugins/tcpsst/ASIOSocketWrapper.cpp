@@ -177,6 +177,16 @@ void ASIOSocketWrapper::finishedSendingChunk(const TimestampedChunk& tc) {
     mAverageSendLatency.sample( tc.sinceCreation() );
 }
 
+void ASIOSocketWrapper::compressChunk(TimestampedChunk& toSend) {
+    if (mCompressor)
+        mCompressor->compressFrame(toSend.chunk);
+}
+
+void ASIOSocketWrapper::enableCompression(const CompressionSettings& settings) {
+    if (mCompressor == NULL)
+        mCompressor = new FrameCompressor(settings);
+}
+
 void ASIOSocketWrapper::unpauseSendStreams(const MultiplexedSocketPtr&parentMultiSocket) {
     std::vector<Stream::StreamID> toUnpause;
     toUnpause.swap(mPausedSendStreams);
@@ -241,6 +251,9 @@ void ASIOSocketWrapper::sendManyDequeItems(const std::tr1::weak_ptr<MultiplexedS
 
 void ASIOSocketWrapper::sendToWire(const MultiplexedSocketPtr&parentMultiSocket, TimestampedChunk toSend) {
     //sending a single chunk is a straightforward call directly to asio
+    compressChunk(toSend);
+    mAverageBatchPackets.sample(1);
+    mAverageBatchBytes.sample(toSend.size());
     mToSend.resize(0);
     mToSend.push_back(toSend);
     BufferPrint(this,".buw",&*toSend.chunk->begin(),toSend.size());
@@ -265,16 +278,41 @@ void ASIOSocketWrapper::bindFunctions(const MultiplexedSocketPtr&parent) {
         );
 }
 void ASIOSocketWrapper::sendToWire(const MultiplexedSocketPtr&parentMultiSocket, std::deque<TimestampedChunk>&input_toSend){
+    //size the coalescing buffer up front so pointers into it stay valid while we fill it
+    size_t coalesce_size=0;
+    for (std::deque<TimestampedChunk>::iterator i=input_toSend.begin(),ie=input_toSend.end();i!=ie;++i) {
+        compressChunk(*i);
+        size_t cursize=i->chunk->size();
+        if (cursize<=SEND_COALESCE_MAX_CHUNK&&coalesce_size+cursize<=SEND_COALESCE_BUDGET)
+            coalesce_size+=cursize;
+    }
+    mCoalesceBuffer.resize(coalesce_size);
+
     std::vector<boost::asio::mutable_buffer> bufs;
     size_t total_size=0;
-    for (std::deque<TimestampedChunk>::const_iterator i=input_toSend.begin(),ie=input_toSend.end();i!=ie;++i) {
+    size_t coalesce_pos=0;
+    size_t run_start=0;//start of the run of coalesced chunks not yet added to bufs
+    for (std::deque<TimestampedChunk>::iterator i=input_toSend.begin(),ie=input_toSend.end();i!=ie;++i) {
         size_t cursize=i->chunk->size();
-        bufs.push_back(boost::asio::buffer(&*i->chunk->begin(),cursize));
         total_size+=cursize;
-        if( cursize) {
-            BufferPrint(this,".buw",&*i->chunk->begin(),cursize);
+        if (cursize==0)
+            continue;
+        BufferPrint(this,".buw",&*i->chunk->begin(),cursize);
+        if (cursize<=SEND_COALESCE_MAX_CHUNK&&coalesce_pos+cursize<=coalesce_size) {
+            std::memcpy(&mCoalesceBuffer[coalesce_pos],&*i->chunk->begin(),cursize);
+            coalesce_pos+=cursize;
+        }else {
+            if (coalesce_pos!=run_start) {
+                bufs.push_back(boost::asio::buffer(&mCoalesceBuffer[run_start],coalesce_pos-run_start));
+                run_start=coalesce_pos;
+            }
+            bufs.push_back(boost::asio::buffer(&*i->chunk->begin(),cursize));
         }
     }
+    if (coalesce_pos!=run_start)
+        bufs.push_back(boost::asio::buffer(&mCoalesceBuffer[run_start],coalesce_pos-run_start));
+    mAverageBatchPackets.sample(input_toSend.size());
+    mAverageBatchBytes.sample(total_size);
     mToSend.swap(input_toSend);
     mOutstandingDataParent=parentMultiSocket;//keep parent alive until send finishes
     boost::asio::async_write(*mSocket,
@@ -497,6 +535,8 @@ void ASIOSocketWrapper::sendServerProtocolHeader(const MultiplexedSocketPtr& thu
         header << "Location: ws://" << host << resource_name << "\r\n";
         header << "Sec-WebSocket-Accept: " << response << "\r\n";
         header << "Sec-WebSocket-Protocol: " << subprotocol << "\r\n";
+        if (thus->getCompressionSettings().enabled)
+            header << "Sec-WebSocket-Extensions: " << CompressionSettings::extensionName() << "\r\n";
         header << "\r\n";
     } else {
         header << "Sec-WebSocket-Origin: " << origin << "\r\n";
@@ -539,6 +579,10 @@ void ASIOSocketWrapper::sendProtocolHeader(const MultiplexedSocketPtr&parentMult
         header << "Sec-WebSocket-Protocol: "
                << (parentMultiSocket->getStreamType()==TCPStream::BASE64_ZERODELIM?"wssst":"sst")
                << numConnections << "\r\n";
+        if (parentMultiSocket->getStreamType()==TCPStream::RFC_6455 &&
+            parentMultiSocket->getCompressionSettings().enabled) {
+            header << "Sec-WebSocket-Extensions: " << CompressionSettings::extensionName() << "\r\n";
+        }
         header << "\r\n";
         if (parentMultiSocket->getStreamType()!= TCPStream::RFC_6455) {
             header << "abcdefgh";
@@ -589,4 +633,24 @@ Duration ASIOSocketWrapper::averageReceiveLatency() const {
     return Duration::zero();
 }
 
+uint64 ASIOSocketWrapper::sendOriginalBytes() const {
+    return mCompressor ? mCompressor->originalBytes() : 0;
+}
+
+uint64 ASIOSocketWrapper::sendWireBytes() const {
+    return mCompressor ? mCompressor->wireBytes() : 0;
+}
+
+Duration ASIOSocketWrapper::averageSendCompressionTime() const {
+    return mCompressor ? mCompressor->averageCompressionTime() : Duration::zero();
+}
+
+float64 ASIOSocketWrapper::averageSendBatchPackets() const {
+    return mAverageBatchPackets.value();
+}
+
+float64 ASIOSocketWrapper::averageSendBatchBytes() const {
+    return mAverageBatchBytes.value();
+}
+
 } }
@@ -34,8 +34,14 @@
 #include <sirikata/core/util/Time.hpp>
 #include <sirikata/core/util/EWA.hpp>
 #include <sirikata/core/network/IOStrand.hpp>
+#include "FrameCompression.hpp"
 
 #define SEND_LATENCY_EWA_ALPHA .10f
+#define SEND_BATCH_EWA_ALPHA .10f
+///Chunks up to this size are copied into the per-socket coalescing buffer rather than handed to asio as separate buffers
+#define SEND_COALESCE_MAX_CHUNK 1024
+///Maximum number of bytes copied into the coalescing buffer for a single write
+#define SEND_COALESCE_BUDGET (64*1024)
 
 namespace Sirikata { namespace Network {
 class ASIOSocketWrapper;
@@ -86,6 +92,13 @@ class ASIOSocketWrapper {
 
 	};
     EWA<Duration> mAverageSendLatency;
+    ///Deflates outgoing data frames once compression was negotiated, NULL otherwise
+    FrameCompressor* mCompressor;
+    ///Runs of small chunks are copied back to back in here so they go out as one buffer; only touched by the sending thread
+    Chunk mCoalesceBuffer;
+    ///Packets and bytes handed to each async_write
+    EWA<float64> mAverageBatchPackets;
+    EWA<float64> mAverageBatchBytes;
 
     std::vector<Stream::StreamID> mPausedSendStreams;
     std::deque<TimestampedChunk> mToSend;
@@ -93,6 +106,8 @@ class ASIOSocketWrapper {
     std::tr1::shared_ptr<MultiplexedSocket>mOutstandingDataParent;
     /** Call this any time a chunk finishes being sent so statistics can be collected. */
     void finishedSendingChunk(const TimestampedChunk& tc);
+    /** Compresses toSend in place if compression is enabled.  Only called by the thread holding the ASYNCHRONOUS_SEND_FLAG. */
+    void compressChunk(TimestampedChunk& toSend);
 
 
     typedef boost::system::error_code ErrorCode;
@@ -118,7 +133,9 @@ class ASIOSocketWrapper {
 
 /**
  *  This function sends a while queue of packets to the network
- * The function sends each item using a vector of asio::buffers made from the passed in deque
+ * The function sends each item using a vector of asio::buffers made from the passed in deque.
+ * Consecutive small packets are first copied together into mCoalesceBuffer so that bursts of
+ * tiny messages become a handful of large buffers instead of one iovec each.
  */
     void sendToWire(const MultiplexedSocketPtr&parentMultiSocket, std::deque<TimestampedChunk>&const_toSend);
 
@@ -141,6 +158,9 @@ public:
        mSendingStatus(0),
        mSendQueue(SizedResourceMonitor(queuedBufferSize)),
        mAverageSendLatency(SEND_LATENCY_EWA_ALPHA),
+       mCompressor(NULL),
+       mAverageBatchPackets(SEND_BATCH_EWA_ALPHA),
+       mAverageBatchBytes(SEND_BATCH_EWA_ALPHA),
        mParent(parent)
     {
         //mPacketLogger.reserve(268435456);
@@ -152,7 +172,10 @@ public:
        mReadBuffer(NULL),
        mSendingStatus(0),
        mSendQueue(socket.getResourceMonitor()),
-       mAverageSendLatency(SEND_LATENCY_EWA_ALPHA)
+       mAverageSendLatency(SEND_LATENCY_EWA_ALPHA),
+       mCompressor(NULL),
+       mAverageBatchPackets(SEND_BATCH_EWA_ALPHA),
+       mAverageBatchBytes(SEND_BATCH_EWA_ALPHA)
     {
         MultiplexedSocketPtr parent(socket.mParent.lock());
         mParent=parent;
@@ -165,6 +188,9 @@ public:
        mSendingStatus(0),
        mSendQueue(SizedResourceMonitor(queuedBufferSize)),
        mAverageSendLatency(SEND_LATENCY_EWA_ALPHA),
+       mCompressor(NULL),
+       mAverageBatchPackets(SEND_BATCH_EWA_ALPHA),
+       mAverageBatchBytes(SEND_BATCH_EWA_ALPHA),
        mParent(parent)
     {
         bindFunctions(parent);
@@ -175,6 +201,7 @@ public:
             SILOG(tcpsst,error,"Outstanding data left on socket that is being deleted. mOutstandingDataParent is "<<(size_t)mOutstandingDataParent.get());
         }
         assert(mToSend.size()==0);
+        delete mCompressor;
     }
 
     ASIOSocketWrapper&operator=(const ASIOSocketWrapper& socket){
@@ -215,6 +242,11 @@ public:
      */
     bool rawSend(const MultiplexedSocketPtr&parentMultiSocket, Chunk * chunk, bool force);
     bool canSend(size_t dataSize)const;
+    /**
+     * Starts compressing outgoing data frames. Called once the handshake has
+     * established that both sides support compression.
+     */
+    void enableCompression(const CompressionSettings& settings);
     static Chunk*constructControlPacket(const MultiplexedSocketPtr&parentMultiSocket, TCPStream::TCPStreamControlCodes code,const Stream::StreamID&sid);
     /**
      * Sends a WebSocket ping/pong with the passed data.
@@ -241,6 +273,12 @@ public:
     // -- Statistics
     Duration averageSendLatency() const;
     Duration averageReceiveLatency() const;
+    ///Payload bytes handed to the compressor and put on the wire, both 0 if compression is off
+    uint64 sendOriginalBytes() const;
+    uint64 sendWireBytes() const;
+    Duration averageSendCompressionTime() const;
+    float64 averageSendBatchPackets() const;
+    float64 averageSendBatchBytes() const;
     //converts 3 arrays into a contiguous array of base64 numbers, delimited with a '\0' at the end.
     static Chunk* toBase64ZeroDelim(const MemoryReference&a, const MemoryReference&b, const MemoryReference&c, const MemoryReference *bytesToPrependUnencoded=NULL);
     ///makes sure the UUID only consists of unicode-allowed characters and has no null values inside
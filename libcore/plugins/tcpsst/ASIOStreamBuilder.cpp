@@ -54,9 +54,17 @@ typedef Array<uint8,TCPStream::MaxWebSocketHeaderSize> TcpSstHeaderArray;
 
 class IncompleteStreamState {
 public:
+    IncompleteStreamState()
+     : mNumSockets(0),
+       mStrand(NULL)
+    {}
+
     int mNumSockets;
     std::vector<TCPSocket*>mSockets;
     std::map<TCPSocket*, std::string> mWebSocketResponses;
+    // Strand the finished stream runs on, chosen when its first socket was
+    // accepted
+    IOStrand* mStrand;
 
     // Destroys the sockets associated with this IncompleteStreamState and
     // clears out the data. Only use this for failed connections.
@@ -122,6 +130,7 @@ void handleBuildStreamTimeout(UUID context) {
 void buildStream(TcpSstHeaderArray *buffer,
                  TCPSocket *socket,
                  std::tr1::shared_ptr<TCPStreamListener::Data> data,
+                 IOStrand *strand,
                  const boost::system::error_code &error,
                  std::size_t bytes_transferred)
 {
@@ -271,6 +280,13 @@ void buildStream(TcpSstHeaderArray *buffer,
         delete socket;
         return;
     }
+    // The client asks for compression with an extension header; we only
+    // agree to it if it is enabled on this listener as well.
+    bool compress = false;
+    if (streamType == TCPStream::RFC_6455 && data->mCompression.enabled) {
+        std::map<std::string, std::string>::const_iterator ext = headers.find("sec-websocket-extensions");
+        compress = (ext != headers.end() && ext->second.find(CompressionSettings::extensionName()) != std::string::npos);
+    }
     boost::asio::ip::tcp::no_delay option(data->mNoDelay);
     socket->set_option(option);
     IncompleteStreamMap::iterator where=sIncompleteStreams.find(context);
@@ -297,6 +313,7 @@ void buildStream(TcpSstHeaderArray *buffer,
 
     if (where==sIncompleteStreams.end()){
         sIncompleteStreams[context].mNumSockets=numConnections;
+        sIncompleteStreams[context].mStrand=strand;
         where=sIncompleteStreams.find(context);
         assert(where!=sIncompleteStreams.end());
         // Setup a timer to clean up the sockets if we don't complete it in time
@@ -314,7 +331,9 @@ void buildStream(TcpSstHeaderArray *buffer,
         where->second.mWebSocketResponses[socket] = reply_str;
         if (numConnections==(unsigned int)where->second.mSockets.size()) {
             MultiplexedSocketPtr shared_socket(
-                MultiplexedSocket::construct<MultiplexedSocket>(data->strand,context,data->cb,streamType));
+                MultiplexedSocket::construct<MultiplexedSocket>(where->second.mStrand,context,data->cb,streamType));
+            if (compress)
+                shared_socket->setCompressionSettings(data->mCompression);
             shared_socket->initFromSockets(where->second.mSockets,data->mSendBufferSize);
             std::string port=shared_socket->getASIOSocketWrapper(0).getLocalEndpoint().getService();
             std::string resource_name='/'+context.toString();
@@ -337,14 +356,14 @@ void buildStream(TcpSstHeaderArray *buffer,
     }
 }
 
-void beginNewStream(TCPSocket*socket, std::tr1::shared_ptr<TCPStreamListener::Data> data) {
+void beginNewStream(TCPSocket*socket, std::tr1::shared_ptr<TCPStreamListener::Data> data, IOStrand* strand) {
 
     TcpSstHeaderArray *buffer = new TcpSstHeaderArray;
 
     boost::asio::async_read(*socket,
                             boost::asio::buffer(buffer->begin(),(int)TCPStream::MaxWebSocketHeaderSize>(int)ASIOReadBuffer::sBufferLength?(int)ASIOReadBuffer::sBufferLength:(int)TCPStream::MaxWebSocketHeaderSize),
                             CheckWebSocketHeader (buffer,false),
-        data->strand->wrap( std::tr1::bind(&ASIOStreamBuilder::buildStream,buffer,socket,data,_1,_2) )
+        data->strand->wrap( std::tr1::bind(&ASIOStreamBuilder::buildStream,buffer,socket,data,strand,_1,_2) )
         );
 }
 
@@ -37,8 +37,10 @@ namespace ASIOStreamBuilder {
 /**
  * Begins a new stream based on a TCPSocket connection acception with the following substream callback for stream creation
  * Only creates the stream if the handshake is complete and it has all the resources (udp, tcp sockets, etc) necessary at the time
+ * The handshake itself is handled on the listener's strand; if this socket is the first of its stream, the finished
+ * stream runs on strand, usually one on the IOService the socket was accepted onto.
  */
-void beginNewStream(TCPSocket* socket, std::tr1::shared_ptr<TCPStreamListener::Data> data);
+void beginNewStream(TCPSocket* socket, std::tr1::shared_ptr<TCPStreamListener::Data> data, IOStrand* strand);
 
 } // namespace Sirikata
 } // namespace Network
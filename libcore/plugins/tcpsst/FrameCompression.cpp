@@ -0,0 +1,230 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include "FrameCompression.hpp"
+#include "WebSocketFrame.hpp"
+#include <zlib.h>
+
+#define COMPRESSION_TIME_EWA_ALPHA .10f
+
+namespace Sirikata { namespace Network {
+
+namespace {
+// Raw deflate streams: the frame header already delimits the data, so the
+// zlib header and checksum would only add bytes.
+const int RAW_DEFLATE_WINDOW_BITS = -15;
+// Upper bound on a single inflated payload, protecting the receiver from
+// tiny frames which expand into huge ones.
+const size_t MAX_INFLATED_SIZE = 64*1024*1024;
+// A stream which fails to shrink n times in a row skips compressing its next
+// 2^n frames, up to 2^MAX_BACKOFF_SHIFT.
+const uint32 MAX_BACKOFF_SHIFT = 8;
+// Bound on the number of streams we remember backoff state for.
+const size_t MAX_BACKOFF_STREAMS = 4096;
+}
+
+CompressionSettings CompressionSettings::fromOptions(OptionSet* options) {
+    CompressionSettings retval;
+    OptionValue* compression = options->referenceOption("compression");
+    OptionValue* level = options->referenceOption("compression-level");
+    OptionValue* minSize = options->referenceOption("compression-min-size");
+
+    String mode = compression->as<String>();
+    if (mode == "deflate") {
+        retval.enabled = true;
+    }
+    else if (mode != "none") {
+        SILOG(tcpsst,error,"Unknown compression mode " << mode << ", compression disabled");
+    }
+    retval.level = std::max(1, std::min(9, level->as<int>()));
+    retval.minSize = minSize->as<unsigned int>();
+    return retval;
+}
+
+
+FrameCompressor::FrameCompressor(const CompressionSettings& settings)
+ : mSettings(settings),
+   mStream(new z_stream),
+   mOriginalBytes(0),
+   mWireBytes(0),
+   mAverageCompressionTime(COMPRESSION_TIME_EWA_ALPHA)
+{
+    std::memset(mStream, 0, sizeof(z_stream));
+    int err = deflateInit2(mStream, mSettings.level, Z_DEFLATED, RAW_DEFLATE_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY);
+    if (err != Z_OK) {
+        SILOG(tcpsst,error,"Unable to initialize deflate, sending frames uncompressed: " << err);
+        delete mStream;
+        mStream = NULL;
+    }
+}
+
+FrameCompressor::~FrameCompressor() {
+    if (mStream != NULL) {
+        deflateEnd(mStream);
+        delete mStream;
+    }
+}
+
+bool FrameCompressor::deflatePayload(const uint8* payload, size_t size, Chunk* output, size_t outputOffset) {
+    deflateReset(mStream);
+    mStream->next_in = (Bytef*)payload;
+    mStream->avail_in = (uInt)size;
+    // Leave room for the output to be a little smaller than the input and no
+    // more: anything larger isn't worth sending compressed.
+    size_t limit = size - size / 8;
+    output->resize(outputOffset + limit);
+    mStream->next_out = (Bytef*)&(*output)[outputOffset];
+    mStream->avail_out = (uInt)limit;
+    int err = deflate(mStream, Z_FINISH);
+    if (err != Z_STREAM_END)
+        return false;
+    output->resize(outputOffset + (limit - mStream->avail_out));
+    return true;
+}
+
+bool FrameCompressor::compressFrame(Chunk* frame) {
+    if (mStream == NULL || frame->size() < 2)
+        return false;
+
+    // Only unfragmented, unmasked binary frames as built by TCPStream::send;
+    // control frames, fragments and handshake data go out untouched.
+    const uint8* data = &(*frame)[0];
+    if (data[0] != (WebSocketFrame::FIN_FLAG | WebSocketFrame::OPCODE_BINARY) || (data[1] & 0x80))
+        return false;
+    size_t headerLength = 2;
+    uint64 payloadLength = data[1] & 0x7f;
+    if (payloadLength == 126) {
+        if (frame->size() < 4) return false;
+        payloadLength = ((uint64)data[2] << 8) | data[3];
+        headerLength = 4;
+    }
+    else if (payloadLength == 127) {
+        if (frame->size() < 10) return false;
+        payloadLength = 0;
+        for (int i = 0; i < 8; ++i)
+            payloadLength = (payloadLength << 8) | data[2 + i];
+        headerLength = 10;
+    }
+    if (headerLength + payloadLength != frame->size())
+        return false;
+
+    Stream::StreamID id;
+    unsigned int idLength = (unsigned int)payloadLength;
+    if (!id.unserialize(data + headerLength, idLength) || id == Stream::StreamID())
+        return false;
+
+    size_t dataLength = (size_t)payloadLength - idLength;
+    mOriginalBytes += payloadLength;
+    if (dataLength < mSettings.minSize || dataLength < 16) {
+        mWireBytes += payloadLength;
+        return false;
+    }
+
+    BackoffMap::iterator backoff = mBackoff.find(id);
+    if (backoff != mBackoff.end() && backoff->second.skip > 0) {
+        --backoff->second.skip;
+        mWireBytes += payloadLength;
+        return false;
+    }
+
+    Time start = Time::local();
+    Chunk compressed;
+    // The new header can only be the same size or shorter, so reserve the
+    // old header's worth of space and shift the result down afterwards.
+    bool worthwhile = deflatePayload(data + headerLength + idLength, dataLength, &compressed, headerLength + idLength);
+    mAverageCompressionTime.sample(Time::local() - start);
+
+    if (!worthwhile) {
+        if (backoff == mBackoff.end()) {
+            if (mBackoff.size() >= MAX_BACKOFF_STREAMS)
+                mBackoff.clear();
+            backoff = mBackoff.insert(BackoffMap::value_type(id, Backoff())).first;
+        }
+        backoff->second.failures++;
+        backoff->second.skip = 1u << std::min(backoff->second.failures, MAX_BACKOFF_SHIFT);
+        mWireBytes += payloadLength;
+        return false;
+    }
+    if (backoff != mBackoff.end())
+        mBackoff.erase(backoff);
+
+    size_t newPayloadLength = compressed.size() - headerLength;
+    uint8 header[WebSocketFrame::MAX_HEADER_LENGTH];
+    unsigned int newHeaderLength = WebSocketFrame::writeHeader(header, WebSocketFrame::OPCODE_BINARY, true, newPayloadLength);
+    header[0] |= WebSocketFrame::RSV1_FLAG;
+    assert(newHeaderLength <= headerLength);
+    size_t shift = headerLength - newHeaderLength;
+    std::memcpy(&compressed[shift], header, newHeaderLength);
+    std::memcpy(&compressed[headerLength], data + headerLength, idLength);
+    if (shift)
+        compressed.erase(compressed.begin(), compressed.begin() + shift);
+    frame->swap(compressed);
+
+    mWireBytes += newPayloadLength;
+    return true;
+}
+
+float64 FrameCompressor::compressionRatio() const {
+    if (mOriginalBytes == 0)
+        return 1.0;
+    return (float64)mWireBytes / (float64)mOriginalBytes;
+}
+
+Duration FrameCompressor::averageCompressionTime() const {
+    return mAverageCompressionTime.value();
+}
+
+
+FrameDecompressor::FrameDecompressor()
+ : mStream(NULL)
+{
+}
+
+FrameDecompressor::~FrameDecompressor() {
+    if (mStream != NULL) {
+        inflateEnd(mStream);
+        delete mStream;
+    }
+}
+
+bool FrameDecompressor::inflatePayload(const Chunk& compressed, Chunk* output) {
+    if (mStream == NULL) {
+        mStream = new z_stream;
+        std::memset(mStream, 0, sizeof(z_stream));
+        if (inflateInit2(mStream, RAW_DEFLATE_WINDOW_BITS) != Z_OK) {
+            delete mStream;
+            mStream = NULL;
+            return false;
+        }
+    }
+    else {
+        inflateReset(mStream);
+    }
+
+    output->resize(std::max((size_t)256, compressed.size() * 4));
+    mStream->next_in = compressed.empty() ? NULL : (Bytef*)&compressed[0];
+    mStream->avail_in = (uInt)compressed.size();
+    size_t produced = 0;
+    while(true) {
+        mStream->next_out = (Bytef*)&(*output)[produced];
+        mStream->avail_out = (uInt)(output->size() - produced);
+        int err = inflate(mStream, Z_NO_FLUSH);
+        produced = output->size() - mStream->avail_out;
+        if (err == Z_STREAM_END)
+            break;
+        if (err != Z_OK && err != Z_BUF_ERROR)
+            return false;
+        if (mStream->avail_out != 0) // Ran out of input before the end of the stream
+            return false;
+        if (output->size() >= MAX_INFLATED_SIZE)
+            return false;
+        output->resize(std::min(output->size() * 2, MAX_INFLATED_SIZE));
+    }
+    output->resize(produced);
+    return true;
+}
+
+} }
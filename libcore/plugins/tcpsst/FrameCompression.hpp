@@ -0,0 +1,129 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _TCPSST_FRAME_COMPRESSION_HPP_
+#define _TCPSST_FRAME_COMPRESSION_HPP_
+
+#include <sirikata/core/network/Stream.hpp>
+#include <sirikata/core/util/EWA.hpp>
+
+struct z_stream_s;
+
+namespace Sirikata {
+class OptionSet;
+namespace Network {
+
+/**
+ * Settings for the optional deflate compression of RFC 6455 data frames. The
+ * connecting side asks for it with a Sec-WebSocket-Extensions header and only
+ * compresses once the listening side echoes the extension back, so either side
+ * may have it turned off. Compressed frames carry the RSV1 bit, the same way
+ * permessage-deflate marks them, so every frame can independently be sent
+ * compressed or not.
+ */
+struct CompressionSettings {
+    CompressionSettings()
+     : enabled(false),
+       level(1),
+       minSize(256)
+    {}
+
+    /// Read the compression, compression-level and compression-min-size tcpsst options.
+    static CompressionSettings fromOptions(OptionSet* options);
+
+    /// The extension token used to negotiate compression.
+    static const char* extensionName() {
+        return "x-sirikata-deflate";
+    }
+
+    bool enabled;
+    /// zlib compression level, 1 (fastest) to 9 (smallest)
+    int level;
+    /// Payloads smaller than this are never compressed.
+    uint32 minSize;
+};
+
+/**
+ * Compresses the payload of outgoing frames. Each frame is deflated on its own
+ * so the receiver can handle frames from any of the parallel sockets in any
+ * order. Only the data following the StreamID is compressed, which lets the
+ * read side keep parsing the StreamID as bytes arrive.
+ *
+ * Small payloads are sent as is. Payloads which don't shrink by at least an
+ * eighth are also sent as is, and their stream backs off from compression for
+ * an exponentially growing number of frames before trying again, so streams
+ * carrying already compressed data stop costing CPU time.
+ *
+ * Not thread safe; ASIOSocketWrapper only calls it from the thread which
+ * currently holds the right to send.
+ */
+class FrameCompressor {
+  public:
+    FrameCompressor(const CompressionSettings& settings);
+    ~FrameCompressor();
+
+    /**
+     * Compresses the payload of frame if frame is a single, unfragmented
+     * binary frame and compression seems worthwhile, replacing its contents
+     * with the compressed frame.
+     * \returns true if frame was replaced by a compressed version
+     */
+    bool compressFrame(Chunk* frame);
+
+    /// Bytes on the wire divided by bytes handed to compressFrame, counting
+    /// only frame payloads.
+    float64 compressionRatio() const;
+    /// Average time spent in each deflate call.
+    Duration averageCompressionTime() const;
+
+    uint64 originalBytes() const { return mOriginalBytes; }
+    uint64 wireBytes() const { return mWireBytes; }
+
+  private:
+    FrameCompressor(const FrameCompressor&);
+    FrameCompressor& operator=(const FrameCompressor&);
+
+    struct Backoff {
+        Backoff() : skip(0), failures(0) {}
+        uint32 skip;
+        uint32 failures;
+    };
+    typedef std::tr1::unordered_map<Stream::StreamID, Backoff, Stream::StreamID::Hasher> BackoffMap;
+
+    bool deflatePayload(const uint8* payload, size_t size, Chunk* output, size_t outputOffset);
+
+    CompressionSettings mSettings;
+    z_stream_s* mStream;
+    BackoffMap mBackoff;
+    uint64 mOriginalBytes;
+    uint64 mWireBytes;
+    EWA<Duration> mAverageCompressionTime;
+};
+
+/**
+ * Inflates payloads of frames received with the RSV1 bit set.
+ */
+class FrameDecompressor {
+  public:
+    FrameDecompressor();
+    ~FrameDecompressor();
+
+    /**
+     * Inflates compressed into output, replacing output's contents.
+     * \returns false if compressed isn't a valid deflate stream or expands
+     *          beyond the largest packet we are willing to accept
+     */
+    bool inflatePayload(const Chunk& compressed, Chunk* output);
+
+  private:
+    FrameDecompressor(const FrameDecompressor&);
+    FrameDecompressor& operator=(const FrameDecompressor&);
+
+    z_stream_s* mStream;
+};
+
+} // namespace Network
+} // namespace Sirikata
+
+#endif //_TCPSST_FRAME_COMPRESSION_HPP_
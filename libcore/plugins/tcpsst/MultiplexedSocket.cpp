@@ -292,6 +292,8 @@ void MultiplexedSocket::sendAllProtocolHeaders(const MultiplexedSocketPtr& thus,
     unsigned int numSockets=(unsigned int)thus->mSockets.size();
     for (std::vector<ASIOSocketWrapper>::iterator i=thus->mSockets.begin(),ie=thus->mSockets.end();i!=ie;++i) {
         i->sendServerProtocolHeader(thus,origin,host,port,resource_name,subprotocol,responses.find(&(i->getSocket()))->second);
+        if (thus->mCompression.enabled)
+            i->enableCompression(thus->mCompression);
     }
     boost::lock_guard<boost::mutex> connectingMutex(sConnectingMutex);
     thus->mSocketConnectionPhase=CONNECTED;
@@ -543,5 +545,51 @@ Duration MultiplexedSocket::averageReceiveLatency() const {
     return avg / (float)nsockets;
 }
 
+float64 MultiplexedSocket::sendCompressionRatio() const {
+    uint64 original = 0, wire = 0;
+
+    uint32 nsockets = (uint32)mSockets.size();
+    for(uint32 ii = 0; ii < nsockets; ++ii) {
+        original += mSockets[ii].sendOriginalBytes();
+        wire += mSockets[ii].sendWireBytes();
+    }
+
+    if (original == 0) return 1.0;
+    return (float64)wire / (float64)original;
+}
+
+Duration MultiplexedSocket::averageSendCompressionTime() const {
+    Duration avg(Duration::zero());
+
+    uint32 nsockets = (uint32)mSockets.size();
+    for(uint32 ii = 0; ii < nsockets; ++ii) {
+        avg += mSockets[ii].averageSendCompressionTime();
+    }
+
+    return avg / (float)nsockets;
+}
+
+float64 MultiplexedSocket::averageSendBatchPackets() const {
+    float64 avg = 0;
+
+    uint32 nsockets = (uint32)mSockets.size();
+    for(uint32 ii = 0; ii < nsockets; ++ii) {
+        avg += mSockets[ii].averageSendBatchPackets();
+    }
+
+    return avg / nsockets;
+}
+
+float64 MultiplexedSocket::averageSendBatchBytes() const {
+    float64 avg = 0;
+
+    uint32 nsockets = (uint32)mSockets.size();
+    for(uint32 ii = 0; ii < nsockets; ++ii) {
+        avg += mSockets[ii].averageSendBatchBytes();
+    }
+
+    return avg / nsockets;
+}
+
 } // namespace Network
 } // namespace Sirikata
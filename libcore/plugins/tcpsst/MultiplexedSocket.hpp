@@ -99,6 +99,8 @@ private:
     CallbackMap mCallbacks;
     ///Whether the streams are zero delimited and in a base64 encoding (useful for interaction with web sockets)
     TCPStream::StreamType mStreamType;
+    ///Compression requested by (when connecting) or accepted for (when listening) this connection
+    CompressionSettings mCompression;
     ///a map from StreamID to count of number of acked close requests--to avoid any unordered packets coming in
     std::tr1::unordered_map<Stream::StreamID,unsigned int,Stream::StreamID::Hasher>mAckedClosingStreams;
     ///a set of StreamIDs to hold the streams that were requested closed but have not been acknowledged, to prevent received packets triggering NewStream callbacks as if a new ID were received
@@ -149,6 +151,13 @@ public:
     TCPStream::StreamType getStreamType() const {
         return mStreamType;
     }
+    const CompressionSettings& getCompressionSettings() const {
+        return mCompression;
+    }
+    ///must be called before the protocol headers are sent
+    void setCompressionSettings(const CompressionSettings& compression) {
+        mCompression = compression;
+    }
     ///public io service accessor for new stream construction
     IOStrand* getStrand() {return mIO;}
 
@@ -313,6 +322,10 @@ public:
     // -- Statistics
     Duration averageSendLatency() const;
     Duration averageReceiveLatency() const;
+    float64 sendCompressionRatio() const;
+    Duration averageSendCompressionTime() const;
+    float64 averageSendBatchPackets() const;
+    float64 averageSendBatchBytes() const;
 };
 
 } // namespace Network
@@ -42,6 +42,7 @@
 #include <sirikata/core/network/IOStrand.hpp>
 #include <sirikata/core/options/Options.hpp>
 #include "VariableLength.hpp"
+#include "WebSocketFrame.hpp"
 #include <boost/thread.hpp>
 namespace Sirikata { namespace Network {
 int TCPStream::sFragmentPackets=0;
@@ -60,6 +61,7 @@ TCPStream::TCPStream(const MultiplexedSocketPtr&shared_socket,const Stream::Stre
     shared_socket->getASIOSocketWrapper(0).getSocket().get_option(optionND);
     mNoDelay=optionND.value();
     mStreamType=shared_socket->getStreamType();
+    mCompression=shared_socket->getCompressionSettings();
 }
 
 Duration TCPStream::averageSendLatency() const {
@@ -70,6 +72,22 @@ Duration TCPStream::averageReceiveLatency() const {
     return mSocket->averageReceiveLatency();
 }
 
+float64 TCPStream::sendCompressionRatio() const {
+    return mSocket->sendCompressionRatio();
+}
+
+Duration TCPStream::averageSendCompressionTime() const {
+    return mSocket->averageSendCompressionTime();
+}
+
+float64 TCPStream::averageSendBatchPackets() const {
+    return mSocket->averageSendBatchPackets();
+}
+
+float64 TCPStream::averageSendBatchBytes() const {
+    return mSocket->averageSendBatchBytes();
+}
+
 void TCPStream::readyRead() {
     MultiplexedSocketPtr socket_copy = mSocket;
     if (socket_copy.get() == NULL) {
@@ -180,33 +198,13 @@ bool TCPStream::send(MemoryReference firstChunk, MemoryReference secondChunk, St
         size_t bytes_copied=0;
         for (size_t frag=0;frag<numFragments;++frag) {
             size_t frag_size = totalSize/numFragments;
-            uint8 packetHeader[12];
-            unsigned int packetHeaderLength = 2;
-            packetHeader[0] = (frag==0?0x02:0x0) ; // Flags = FIN/Unfragmented, Opcode = 2: binary data
-            if (frag+1==numFragments) {
-                packetHeader[0]|=0x80;
-                frag_size = totalSize-(totalSize/numFragments)*(numFragments-1);//the remainder        
-            }
-            if (frag_size <= 125) {
-                packetHeader[1] = frag_size;
-            } else if (frag_size <= 65535) {
-                packetHeader[1] = 126;
-                packetHeader[2] = (frag_size >> 8);
-                packetHeader[3] = (frag_size & 0xff);
-                packetHeaderLength += 2;
-            } else {
-                // why do they jump from 16-bit to 64-bit
-                packetHeader[1] = 127;
-                packetHeader[2] = 0;
-                packetHeader[3] = 0;
-                packetHeader[4] = 0;
-                packetHeader[5] = 0;
-                packetHeader[6] = (frag_size >> 24);
-                packetHeader[7] = ((frag_size >> 16) & 0xff);
-                packetHeader[8] = ((frag_size >> 8) & 0xff);
-                packetHeader[9] = (frag_size & 0xff);
-                packetHeaderLength += 8;
-            }
+            bool lastFrag = (frag+1==numFragments);
+            if (lastFrag)
+                frag_size = totalSize-(totalSize/numFragments)*(numFragments-1);//the remainder
+            uint8 packetHeader[WebSocketFrame::MAX_HEADER_LENGTH];
+            unsigned int packetHeaderLength = WebSocketFrame::writeHeader(packetHeader,
+                frag==0 ? WebSocketFrame::OPCODE_BINARY : WebSocketFrame::OPCODE_CONTINUATION,
+                lastFrag, frag_size);
             toBeSent.data->resize(offset+frag_size+packetHeaderLength);
             uint8 *outputBuffer=&(*toBeSent.data)[offset];
             std::copy(packetHeader,packetHeader+packetHeaderLength,toBeSent.data->begin()+offset);
@@ -222,29 +220,8 @@ bool TCPStream::send(MemoryReference firstChunk, MemoryReference secondChunk, St
         streamIdLength=successLengthNeeded;
         size_t totalSize=firstChunk.size()+secondChunk.size();
         totalSize+=streamIdLength;
-        uint8 packetHeader[12];
-        unsigned int packetHeaderLength = 2;
-        packetHeader[0] = 0x80 | 0x02 ; // Flags = FIN/Unfragmented, Opcode = 2: binary data
-        if (totalSize <= 125) {
-          packetHeader[1] = totalSize;
-        } else if (totalSize <= 65535) {
-          packetHeader[1] = 126;
-          packetHeader[2] = (totalSize >> 8);
-          packetHeader[3] = (totalSize & 0xff);
-          packetHeaderLength += 2;
-        } else {
-          // why do they jump from 16-bit to 64-bit
-          packetHeader[1] = 127;
-          packetHeader[2] = 0;
-          packetHeader[3] = 0;
-          packetHeader[4] = 0;
-          packetHeader[5] = 0;
-          packetHeader[6] = (totalSize >> 24);
-          packetHeader[7] = ((totalSize >> 16) & 0xff);
-          packetHeader[8] = ((totalSize >> 8) & 0xff);
-          packetHeader[9] = (totalSize & 0xff);
-          packetHeaderLength += 8;
-        }
+        uint8 packetHeader[WebSocketFrame::MAX_HEADER_LENGTH];
+        unsigned int packetHeaderLength = WebSocketFrame::writeHeader(packetHeader, WebSocketFrame::OPCODE_BINARY, true, totalSize);
         //allocate a packet long enough to take both the length of the packet and the stream id as well as the packet data. totalSize = size of streamID + size of data and
         //packetHeaderLength = the length of the length component of the packet
         toBeSent.data=new Chunk(totalSize+packetHeaderLength);
@@ -374,9 +351,14 @@ TCPStream::TCPStream(IOStrand* io,OptionSet*options):mSendStatus(new AtomicValue
     mKernelReceiveBufferSize=kernelReceiveBufferSize->as<unsigned int>();
     mNoDelay=noDelay->as<bool>();
     mStreamType=oldLengthDelim->as<bool>() ? TCPStream::LENGTH_DELIM : TCPStream::RFC_6455;
+    mCompression=CompressionSettings::fromOptions(options);
+    if (mCompression.enabled && mStreamType!=TCPStream::RFC_6455) {
+        SILOG(tcpsst,warning,"Compression is only supported with RFC 6455 framing, disabling it");
+        mCompression.enabled=false;
+    }
 }
 
-TCPStream::TCPStream(IOStrand* io,unsigned char numSimultSockets,unsigned int sendBufferSize,bool noDelay, StreamType streamType, unsigned int kernelSendBufferSize,unsigned int kernelReceiveBufferSize):mSendStatus(new AtomicValue<int>(0)) {
+TCPStream::TCPStream(IOStrand* io,unsigned char numSimultSockets,unsigned int sendBufferSize,bool noDelay, StreamType streamType, unsigned int kernelSendBufferSize,unsigned int kernelReceiveBufferSize, const CompressionSettings& compression):mSendStatus(new AtomicValue<int>(0)) {
     mIOStrand = io;
     mNumSimultaneousSockets=(unsigned char)numSimultSockets;
     assert(mNumSimultaneousSockets);
@@ -385,6 +367,7 @@ TCPStream::TCPStream(IOStrand* io,unsigned char numSimultSockets,unsigned int se
     mKernelSendBufferSize=kernelSendBufferSize;
     mKernelReceiveBufferSize=kernelReceiveBufferSize;
     mStreamType = streamType;
+    mCompression = compression;
 }
 
 void TCPStream::connect(const Address&addy,
@@ -394,6 +377,7 @@ void TCPStream::connect(const Address&addy,
                         const ReadySendCallback&readySendCallback) {
     MultiplexedSocketPtr socket = MultiplexedSocket::construct<MultiplexedSocket>(
         mIOStrand,substreamCallback,mStreamType);
+    socket->setCompressionSettings(mCompression);
     mSocket = socket;
     *mSendStatus=0;
     mID=StreamID(MultiplexedSocket::getFirstStreamID(true));
@@ -405,7 +389,7 @@ void TCPStream::connect(const Address&addy,
 }
 
 Stream*TCPStream::factory(){
-    return new TCPStream(mIOStrand,mNumSimultaneousSockets,mSendBufferSize,mNoDelay,mStreamType,mKernelSendBufferSize,mKernelReceiveBufferSize);
+    return new TCPStream(mIOStrand,mNumSimultaneousSockets,mSendBufferSize,mNoDelay,mStreamType,mKernelSendBufferSize,mKernelReceiveBufferSize,mCompression);
 }
 Stream* TCPStream::clone(const SubstreamCallback &cloneCallback) {
     MultiplexedSocketPtr socket_copy = mSocket;
@@ -413,7 +397,7 @@ Stream* TCPStream::clone(const SubstreamCallback &cloneCallback) {
         return NULL;
     }
 
-    TCPStream *retval=new TCPStream(mIOStrand,mNumSimultaneousSockets,mSendBufferSize,mNoDelay,mStreamType, mKernelSendBufferSize,mKernelReceiveBufferSize);
+    TCPStream *retval=new TCPStream(mIOStrand,mNumSimultaneousSockets,mSendBufferSize,mNoDelay,mStreamType, mKernelSendBufferSize,mKernelReceiveBufferSize,mCompression);
     retval->mSocket = socket_copy;
 
     StreamID newID = socket_copy->getNewID();
@@ -431,7 +415,7 @@ Stream* TCPStream::clone(const ConnectionCallback &connectionCallback,
         return NULL;
     }
 
-    TCPStream *retval=new TCPStream(mIOStrand,mNumSimultaneousSockets,mSendBufferSize,mNoDelay,mStreamType, mKernelSendBufferSize,mKernelReceiveBufferSize);
+    TCPStream *retval=new TCPStream(mIOStrand,mNumSimultaneousSockets,mSendBufferSize,mNoDelay,mStreamType, mKernelSendBufferSize,mKernelReceiveBufferSize,mCompression);
     retval->mSocket = socket_copy;
 
     StreamID newID = socket_copy->getNewID();
@@ -35,6 +35,7 @@
 #include <sirikata/core/network/Stream.hpp>
 #include <sirikata/core/util/AtomicTypes.hpp>
 #include "TCPSSTDecls.hpp"
+#include "FrameCompression.hpp"
 
 namespace Sirikata {
 namespace Network {
@@ -136,9 +137,11 @@ private:
     unsigned int mSendBufferSize;
     unsigned int mKernelSendBufferSize;
     unsigned int mKernelReceiveBufferSize;
+    ///Compression requested for new connections
+    CompressionSettings mCompression;
 
     ///Constructor which leaves socket in a disconnection state, prepared for a connect() or a clone() called internally from factory
-    TCPStream(IOStrand*,unsigned char mNumSimultaneousSockets, unsigned int mSendBufferSize, bool noDelay, StreamType streamType, unsigned int kernelSendBufferSize, unsigned int kernelReceiveBufferSize);
+    TCPStream(IOStrand*,unsigned char mNumSimultaneousSockets, unsigned int mSendBufferSize, bool noDelay, StreamType streamType, unsigned int kernelSendBufferSize, unsigned int kernelReceiveBufferSize, const CompressionSettings& compression);
 
 
 public:
@@ -215,6 +218,10 @@ public:
 
     virtual Duration averageSendLatency() const;
     virtual Duration averageReceiveLatency() const;
+    virtual float64 sendCompressionRatio() const;
+    virtual Duration averageSendCompressionTime() const;
+    virtual float64 averageSendBatchPackets() const;
+    virtual float64 averageSendBatchBytes() const;
 };
 
 } // namespace Network
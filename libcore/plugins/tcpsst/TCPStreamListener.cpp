@@ -35,6 +35,7 @@
 #include <sirikata/core/network/IOStrand.hpp>
 #include <sirikata/core/network/IOStrandImpl.hpp>
 #include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOServicePool.hpp>
 #include "TCPStream.hpp"
 #include "TCPStreamListener.hpp"
 #include "ASIOStreamBuilder.hpp"
@@ -45,6 +46,31 @@ namespace Network {
 
 using namespace boost::asio::ip;
 
+namespace {
+// Reactors are shared by all listeners in the process and outlive them, since
+// the streams they accept keep running after the listener is closed.
+boost::mutex sReactorMutex;
+IOServicePool* sReactorPool = NULL;
+typedef std::map<IOService*, IOStrand*> ReactorStrandMap;
+ReactorStrandMap sReactorStrands;
+
+// Get the strand for the next connection, starting nreactors reactors if
+// none are running yet.
+IOStrand* nextReactorStrand(uint32 nreactors) {
+    boost::lock_guard<boost::mutex> lck(sReactorMutex);
+    if (sReactorPool == NULL) {
+        sReactorPool = new IOServicePool("TCPStreamListener Reactor", nreactors, IOServicePool::ReactorPerThread);
+        for(uint32 i = 0; i < sReactorPool->size(); i++) {
+            IOService* ios = sReactorPool->service(i);
+            sReactorStrands[ios] = ios->createStrand(ios->name() + " Strand");
+        }
+        sReactorPool->startWork();
+        sReactorPool->run();
+    }
+    return sReactorStrands[sReactorPool->nextService()];
+}
+}
+
 TCPStreamListener::Data::Data(IOStrand* io,
                               uint8 maxSimultaneousSockets,
                               uint32 sendBufferSize,
@@ -59,7 +85,9 @@ TCPStreamListener::Data::Data(IOStrand* io,
      mNoDelay(noDelay),
      mSendBufferSize(sendBufferSize),
      mKernelSendBufferSize(kernelSendBufferSize),
-     mKernelReceiveBufferSize(kernelReceiveBufferSize)
+     mKernelReceiveBufferSize(kernelReceiveBufferSize),
+     mReactors(0),
+     acceptStrand(NULL)
 {
 }
 
@@ -80,7 +108,12 @@ void TCPStreamListener::Data::start(DataPtr shared_this) {
 // All the real work happens here in these methods
 void TCPStreamListener::Data::startAccept(DataPtr& data) {
     assert(data->socket == NULL);
-    data->socket = new TCPSocket(data->strand->service());
+    // Each connection gets pinned to one reactor by creating its socket there;
+    // only the handshake comes back through our strand.
+    data->acceptStrand = data->strand;
+    if (data->mReactors)
+        data->acceptStrand = nextReactorStrand(data->mReactors);
+    data->socket = new TCPSocket(data->acceptStrand->service());
     if (data->mKernelReceiveBufferSize) {
         boost::asio::socket_base::receive_buffer_size option(data->mKernelReceiveBufferSize);
         data->socket->set_option(option);
@@ -113,7 +146,7 @@ void TCPStreamListener::Data::handleAccept(DataPtr& data, const boost::system::e
     data->socket = NULL;
 
     // Hand off the new connection for sessions initiation
-    ASIOStreamBuilder::beginNewStream(newSocket, data);
+    ASIOStreamBuilder::beginNewStream(newSocket, data, data->acceptStrand);
 
     // Continue listening
     startAccept(data);
@@ -127,6 +160,7 @@ TCPStreamListener::TCPStreamListener(IOStrand* io, OptionSet*options)
     OptionValue *noDelay=options->referenceOption("no-delay");
     OptionValue *kernelSendBufferSize=options->referenceOption("ksend-buffer-size");
     OptionValue *kernelReceiveBufferSize=options->referenceOption("kreceive-buffer-size");
+    OptionValue *ioReactors=options->referenceOption("io-reactors");
     OptionValue *fragmentPackets=options->referenceOption("test-fragment-packet-level");
     if (fragmentPackets->as<int>()!=-1) {
         TCPStream::sFragmentPackets = fragmentPackets->as<int>();
@@ -139,6 +173,8 @@ TCPStreamListener::TCPStreamListener(IOStrand* io, OptionSet*options)
                            noDelay->as<bool>(),
                            kernelSendBufferSize->as<unsigned int>(),
                            kernelReceiveBufferSize->as<unsigned int>()));
+    data->mCompression=CompressionSettings::fromOptions(options);
+    data->mReactors=ioReactors->as<unsigned int>();
     mData=data;
 }
 
@@ -170,6 +206,20 @@ Address TCPStreamListener::listenAddress() const {
                    port.str());
 }
 
+void TCPStreamListener::shutdownReactors() {
+    boost::lock_guard<boost::mutex> lck(sReactorMutex);
+    if (sReactorPool == NULL) return;
+
+    for(uint32 i = 0; i < sReactorPool->size(); i++)
+        sReactorPool->service(i)->stop();
+    sReactorPool->join();
+    for(ReactorStrandMap::iterator it = sReactorStrands.begin(); it != sReactorStrands.end(); it++)
+        delete it->second;
+    sReactorStrands.clear();
+    delete sReactorPool;
+    sReactorPool = NULL;
+}
+
 void TCPStreamListener::close(){
     if (mData->acceptor != NULL) {
 
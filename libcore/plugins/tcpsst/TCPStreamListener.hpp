@@ -35,6 +35,7 @@
 
 #include <sirikata/core/network/IODefs.hpp>
 #include <sirikata/core/network/StreamListener.hpp>
+#include "FrameCompression.hpp"
 
 namespace Sirikata {
 namespace Network {
@@ -57,6 +58,11 @@ public:
     virtual Address listenAddress()const;
     virtual void close();
 
+    /** Stops and destroys the reactors started by listeners with the
+     *  io-reactors option. Only safe once every stream they accepted is gone.
+     */
+    static void shutdownReactors();
+
     struct Data{ // Data which may be needed in callbacks, so is stored separately in shared_ptr
     private:
         static void startAccept(std::tr1::shared_ptr<Data>& data);
@@ -80,6 +86,13 @@ public:
         uint32 mSendBufferSize;
         uint32 mKernelSendBufferSize;
         uint32 mKernelReceiveBufferSize;
+        ///Compression offered to connecting streams which ask for it
+        CompressionSettings mCompression;
+        ///Number of independent reactors accepted connections are spread
+        ///across, 0 to keep them on strand
+        uint32 mReactors;
+        ///Strand for the connection currently being accepted into socket
+        IOStrand* acceptStrand;
     };
     typedef std::tr1::shared_ptr<Data> DataPtr;
     DataPtr mData;
@@ -50,6 +50,10 @@ static OptionSet*optionParser(const String&str) {
     OptionValue *noDelay=new OptionValue("no-delay","false",OptionValueType<bool>(),"Whether the no-delay option is set on the socket");
     OptionValue *zeroDelim=new OptionValue("base64","false",OptionValueType<bool>(),"True if the stream should be base64 (eg javascript compat)");
     OptionValue *oldWebsocket=new OptionValue("websocket-draft-76","false",OptionValueType<bool>(),"True if the stream should be websocket draft-76. False for RFC 6455");
+    OptionValue *compression=new OptionValue("compression","none",OptionValueType<String>(),"Compression of RFC 6455 data frames: none or deflate. Connecting streams request it and listeners accept it only if both sides enable it.");
+    OptionValue *compressionLevel=new OptionValue("compression-level","1",OptionValueType<int>(),"zlib compression level used when compression is enabled, 1 (fastest) to 9 (smallest)");
+    OptionValue *compressionMinSize=new OptionValue("compression-min-size","256",OptionValueType<unsigned int>(),"Packets smaller than this many bytes are never compressed");
+    OptionValue *ioReactors=new OptionValue("io-reactors","0",OptionValueType<unsigned int>(),"Listeners only: number of independent IO reactors, each with its own thread, that accepted connections are spread across. Every accepted connection stays on one reactor. 0 handles all connections on the listener's own IOService.");
     OptionValue *testFragmentPackets=new OptionValue("test-fragment-packet-level","-1",OptionValueType<int>(),"1 if packets should be fragmented at regular intervals in order to test the browser fragmentation. 2 if packets should be aggressively fragmented. 0 to explicitly disable fragmentation of packets. Option affects option globally for the duration of the run.");
 
     InitializeClassOptions("tcpsstoptions",numSockets,
@@ -62,6 +66,10 @@ static OptionSet*optionParser(const String&str) {
                      kSendBufferSize,
                      kReceiveBufferSize,
                      testFragmentPackets,
+                     compression,
+                     compressionLevel,
+                     compressionMinSize,
+                     ioReactors,
                      NULL);
     OptionSet*retval=OptionSet::getOptions("tcpsstoptions",numSockets);
     retval->parse(str);
@@ -101,6 +109,7 @@ SIRIKATA_PLUGIN_EXPORT_C void destroy() {
     if (core_plugin_refcount==0) {
         Sirikata::Network::StreamListenerFactory::getSingleton().unregisterConstructor("tcpsst");
         Sirikata::Network::StreamFactory::getSingleton().unregisterConstructor("tcpsst");
+        Sirikata::Network::TCPStreamListener::shutdownReactors();
     }
 }
 
@@ -0,0 +1,91 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _TCPSST_WEBSOCKET_FRAME_HPP_
+#define _TCPSST_WEBSOCKET_FRAME_HPP_
+
+#include <cstring>
+
+namespace Sirikata { namespace Network {
+
+/** Helpers for RFC 6455 framing, shared by the send path in TCPStream and
+ *  the frame parser in ASIOReadBuffer.
+ */
+namespace WebSocketFrame {
+
+enum {
+    OPCODE_CONTINUATION=0x00,
+    OPCODE_BINARY=0x02,
+    OPCODE_PING=0x09,
+    OPCODE_PONG=0x0a,
+    FIN_FLAG=0x80,
+    /// Marks frames whose payload (after the StreamID) is deflated
+    RSV1_FLAG=0x40,
+    /// 2 bytes of flags and length, 8 bytes of extended length and 4 of mask
+    MAX_HEADER_LENGTH=14
+};
+
+/**
+ * Writes the header of an unmasked frame carrying payloadLength bytes into
+ * header, which must hold at least MAX_HEADER_LENGTH bytes.
+ * \returns the number of header bytes written
+ */
+inline unsigned int writeHeader(uint8* header, uint8 opcode, bool fin, uint64 payloadLength) {
+    header[0] = (fin ? FIN_FLAG : 0) | opcode;
+    if (payloadLength <= 125) {
+        header[1] = (uint8)payloadLength;
+        return 2;
+    }
+    if (payloadLength <= 65535) {
+        header[1] = 126;
+        header[2] = (uint8)(payloadLength >> 8);
+        header[3] = (uint8)(payloadLength & 0xff);
+        return 4;
+    }
+    header[1] = 127;
+    for (int i = 0; i < 8; ++i)
+        header[2 + i] = (uint8)((payloadLength >> (8 * (7 - i))) & 0xff);
+    return 10;
+}
+
+/**
+ * XORs len bytes of data with the repeating 4 byte mask, starting phase bytes
+ * into the mask. Works on 8 bytes at a time (which compilers will happily
+ * vectorize further), with byte-at-a-time handling of the ends.
+ * \param src bytes to unmask, may be the same as dst
+ * \param dst where to write the unmasked bytes
+ */
+inline void applyMask(uint8* dst, const uint8* src, size_t len, const uint8 mask[4], unsigned int phase=0) {
+    size_t i = 0;
+    // Bring dst up to 8 byte alignment so the wide loop does aligned stores.
+    while (i < len && ((size_t)(dst + i) & 7)) {
+        dst[i] = src[i] ^ mask[(i + phase) & 3];
+        ++i;
+    }
+    if (len - i >= 8) {
+        uint8 rotated[8];
+        for (int j = 0; j < 8; ++j)
+            rotated[j] = mask[(i + phase + j) & 3];
+        uint64 wideMask;
+        std::memcpy(&wideMask, rotated, 8);
+        for (; len - i >= 8; i += 8) {
+            uint64 word;
+            std::memcpy(&word, src + i, 8);
+            word ^= wideMask;
+            std::memcpy(dst + i, &word, 8);
+        }
+    }
+    for (; i < len; ++i)
+        dst[i] = src[i] ^ mask[(i + phase) & 3];
+}
+
+inline bool hasMask(const uint8 mask[4]) {
+    return (mask[0] | mask[1] | mask[2] | mask[3]) != 0;
+}
+
+} // namespace WebSocketFrame
+
+} }
+
+#endif //_TCPSST_WEBSOCKET_FRAME_HPP_
@@ -39,18 +39,28 @@
 namespace Sirikata {
 namespace Network {
 
-IOServicePool::IOServicePool(const String& name, uint32 nthreads)
- : mIO(new IOService(name)),
-   mThreads(nthreads, NULL),
-   mWork(NULL)
+IOServicePool::IOServicePool(const String& name, uint32 nthreads, ReactorMode mode)
+ : mThreads(nthreads, NULL),
+   mNextService(0)
 {
+    if (mode == ReactorPerThread && nthreads > 1) {
+        for(uint32 i = 0; i < nthreads; i++) {
+            std::stringstream service_name;
+            service_name << name << " " << i;
+            mServices.push_back(new IOService(service_name.str()));
+        }
+    }
+    else {
+        mServices.push_back(new IOService(name));
+    }
 }
 
 IOServicePool::~IOServicePool() {
-    if (mWork) stopWork();
+    stopWork();
     for(ThreadList::iterator it = mThreads.begin(); it != mThreads.end(); it++)
         delete *it;
-    delete mIO;
+    for(ServiceList::iterator it = mServices.begin(); it != mServices.end(); it++)
+        delete *it;
 }
 
 namespace {
@@ -59,11 +69,14 @@ void runWrapper(IOService* ios) {
 }
 }
 void IOServicePool::reset() {
-    mIO->reset();
+    for(ServiceList::iterator it = mServices.begin(); it != mServices.end(); it++)
+        (*it)->reset();
 }
 void IOServicePool::run() {
-    for(ThreadList::iterator it = mThreads.begin(); it != mThreads.end(); it++)
-        (*it) = new Thread( mIO->name() + " Worker", std::tr1::bind(runWrapper, mIO) );
+    for(uint32 i = 0; i < mThreads.size(); i++) {
+        IOService* ios = mServices[i % mServices.size()];
+        mThreads[i] = new Thread( ios->name() + " Worker", std::tr1::bind(runWrapper, ios) );
+    }
 }
 
 void IOServicePool::join() {
@@ -75,20 +88,30 @@ void IOServicePool::join() {
 }
 
 void IOServicePool::startWork() {
-    if (mWork) return;
-    mWork = new IOWork(*mIO);
+    if (!mWork.empty()) return;
+    for(ServiceList::iterator it = mServices.begin(); it != mServices.end(); it++)
+        mWork.push_back(new IOWork(**it));
 }
 
 void IOServicePool::stopWork() {
-    if (!mWork) return;
-
-    delete mWork;
-    mWork = NULL;
+    for(WorkList::iterator it = mWork.begin(); it != mWork.end(); it++)
+        delete *it;
+    mWork.clear();
 }
 
 
 IOService* IOServicePool::service() {
-    return mIO;
+    return mServices[0];
+}
+
+IOService* IOServicePool::service(uint32 thr) {
+    return mServices[thr % mServices.size()];
+}
+
+IOService* IOServicePool::nextService() {
+    if (mServices.size() == 1)
+        return mServices[0];
+    return mServices[ mNextService++ % mServices.size() ];
 }
 
 } // namespace Network
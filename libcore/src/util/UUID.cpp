@@ -33,7 +33,6 @@
 #include <sirikata/core/util/Standard.hh>
 #include <sirikata/core/util/UUID.hpp>
 #include "boost_uuid.hpp"
-#include <boost/functional/hash.hpp>
 
 BOOST_STATIC_ASSERT(Sirikata::UUID::static_size==sizeof(boost_::uuid));
 
@@ -99,11 +98,7 @@ std::string UUID::rawHexData()const{
     return retval;
 }
 size_t UUID::hash() const {
-    uint64* dat = (uint64*)getArray().data();
-    size_t seed = 0;
-    boost::hash_combine(seed, dat[0]);
-    boost::hash_combine(seed, dat[1]);
-    return seed;
+    return (size_t)hash64();
 }
 
 std::ostream& operator << (std::ostream &os, const Sirikata::UUID& output) {
@@ -0,0 +1,180 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_MESH_GEOMETRY_BUFFERS_HPP_
+#define _SIRIKATA_MESH_GEOMETRY_BUFFERS_HPP_
+
+#include <sirikata/mesh/Platform.hpp>
+
+namespace Sirikata {
+namespace Mesh {
+
+/** A list of vertex indices which adapts its storage width to its
+ *  contents. Indices are stored as 16-bit values until one that doesn't fit is
+ *  added, at which point the whole list is widened to 32-bits. This keeps the
+ *  common case compact (and directly usable as a 16-bit hardware index buffer)
+ *  without forcing large submeshes, e.g. aggregates, to be split at 65,535
+ *  vertices.
+ *
+ *  Element access returns indices by value. Use set() to modify an element. For
+ *  tight loops, use data16()/data32() according to is32Bit() to get a plain
+ *  array (see ForEachIndexWidth for a helper).
+ */
+class SIRIKATA_MESH_EXPORT IndexList {
+public:
+    enum Width {
+        Index16 = 2,
+        Index32 = 4
+    };
+
+    IndexList()
+     : mWidth(Index16)
+    {}
+
+    size_t size() const {
+        return (mWidth == Index16) ? m16.size() : m32.size();
+    }
+    bool empty() const { return size() == 0; }
+
+    Width width() const { return mWidth; }
+    bool is32Bit() const { return mWidth == Index32; }
+
+    uint32 operator[](size_t i) const {
+        return (mWidth == Index16) ? (uint32)m16[i] : m32[i];
+    }
+    uint32 at(size_t i) const {
+        return (mWidth == Index16) ? (uint32)m16.at(i) : m32.at(i);
+    }
+
+    void set(size_t i, uint32 idx) {
+        if (mWidth == Index16 && idx > 0xFFFF) widen();
+        if (mWidth == Index16)
+            m16[i] = (uint16)idx;
+        else
+            m32[i] = idx;
+    }
+
+    void push_back(uint32 idx) {
+        if (mWidth == Index16 && idx > 0xFFFF) widen();
+        if (mWidth == Index16)
+            m16.push_back((uint16)idx);
+        else
+            m32.push_back(idx);
+    }
+
+    void resize(size_t n) {
+        if (mWidth == Index16)
+            m16.resize(n, 0);
+        else
+            m32.resize(n, 0);
+    }
+
+    void reserve(size_t n) {
+        if (mWidth == Index16)
+            m16.reserve(n);
+        else
+            m32.reserve(n);
+    }
+
+    void clear() {
+        m16.clear();
+        m32.clear();
+        mWidth = Index16;
+    }
+
+    /** Append all indices from rhs, adding offset to each. Widens the list if
+     *  the result requires it.
+     */
+    void append(const IndexList& rhs, uint32 offset = 0);
+
+    /** Convert storage to 32-bit indices. */
+    void widen();
+    /** Convert storage back to 16-bit indices if all indices fit. Returns true
+     *  if the list is 16-bit after the call.
+     */
+    bool narrow();
+
+    /** Get the largest index in the list, or 0 if it is empty. */
+    uint32 maxIndex() const;
+
+    // Raw access. Only the accessor matching width() is valid.
+    const uint16* data16() const { return m16.empty() ? NULL : &m16[0]; }
+    uint16* data16() { return m16.empty() ? NULL : &m16[0]; }
+    const uint32* data32() const { return m32.empty() ? NULL : &m32[0]; }
+    uint32* data32() { return m32.empty() ? NULL : &m32[0]; }
+    const void* data() const {
+        return (mWidth == Index16) ? (const void*)data16() : (const void*)data32();
+    }
+    size_t byteSize() const { return size() * (size_t)mWidth; }
+
+    // Direct access to the backing storage, for bulk loading. Only the one
+    // matching width() is used.
+    std::vector<uint16>& storage16() { return m16; }
+    std::vector<uint32>& storage32() { return m32; }
+    const std::vector<uint16>& storage16() const { return m16; }
+    const std::vector<uint32>& storage32() const { return m32; }
+    /** Switch to the given width, discarding any current contents. Used
+     *  together with storage16()/storage32() to bulk load indices.
+     */
+    void reset(Width w) {
+        clear();
+        mWidth = w;
+    }
+
+    bool operator==(const IndexList& rhs) const;
+    bool operator!=(const IndexList& rhs) const { return !(*this == rhs); }
+
+private:
+    std::vector<uint16> m16;
+    std::vector<uint32> m32;
+    Width mWidth;
+};
+
+/** Invokes op(const IndexType* indices, size_t count) with the raw index array
+ *  of the appropriate width. Op should be a functor with a templated
+ *  operator(), which lets the compiler generate a tight loop for each width
+ *  instead of checking the width for every element.
+ */
+template<typename Op>
+void ForEachIndexWidth(const IndexList& indices, Op& op) {
+    if (indices.is32Bit())
+        op(indices.data32(), indices.size());
+    else
+        op(indices.data16(), indices.size());
+}
+
+
+/** Tightly packed structure-of-arrays copy of a set of vertex positions. Each
+ *  component is stored contiguously so bulk operations (transforms, bounds)
+ *  are straight loops over floats which the compiler can vectorize.
+ */
+struct SIRIKATA_MESH_EXPORT PositionArrays {
+    std::vector<float32> x;
+    std::vector<float32> y;
+    std::vector<float32> z;
+
+    size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+    void clear() { x.clear(); y.clear(); z.clear(); }
+
+    /** Fill with all of the given positions. */
+    void assign(const std::vector<Vector3f>& positions);
+    /** Fill with the positions referenced by the given mask. */
+    void assign(const std::vector<Vector3f>& positions, const std::vector<bool>& mask);
+
+    Vector3f get(size_t i) const { return Vector3f(x[i], y[i], z[i]); }
+
+    /** Apply an affine transformation to all positions. */
+    void transform(const Matrix4x4f& xform);
+
+    /** Compute the bounding box and the radius (maximum distance from the
+     *  origin) of the positions. If empty, bounds are null and radius is 0.
+     */
+    void computeBounds(BoundingBox3f3f* bounds_out, double* radius_out) const;
+};
+
+} // namespace Mesh
+} // namespace Sirikata
+
+#endif //_SIRIKATA_MESH_GEOMETRY_BUFFERS_HPP_
@@ -0,0 +1,83 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_MESH_MESH_BVH_HPP_
+#define _SIRIKATA_MESH_MESH_BVH_HPP_
+
+#include <sirikata/mesh/Platform.hpp>
+
+namespace Sirikata {
+namespace Mesh {
+
+struct Meshdata;
+
+/** A bounding volume hierarchy over all the instanced triangles of a Meshdata,
+ *  in mesh space (i.e. with geometry instance transforms applied, but nothing
+ *  else). Splits are chosen with a binned surface area heuristic. Triangles are
+ *  stored in leaf order as separate coordinate arrays, so leaves are tested
+ *  with straight loops over floats, and batches of rays are traced together as
+ *  packets which share a single traversal.
+ *
+ *  Don't construct these directly for raytracing Meshdata, use
+ *  Meshdata::getBVH() so the structure is built once and shared.
+ */
+class SIRIKATA_MESH_EXPORT MeshBVH {
+public:
+    MeshBVH(const Meshdata& md);
+
+    uint32 numTriangles() const { return mV0x.size(); }
+    uint32 numNodes() const { return mNodes.size(); }
+    /** Bounds of all triangles. Null if there are no triangles. */
+    BoundingBox3f3f bounds() const;
+
+    /** Find the closest intersection of the ray with the mesh.
+     *  \param ray_start the starting position of the ray to trace
+     *  \param ray_dir the direction of the ray to trace
+     *  \param t_inout on input, the maximum parametric distance to look for
+     *  hits; if a hit is found it is updated to the hit's distance.
+     *  \returns true if a hit closer than the initial t_inout was found
+     */
+    bool intersect(const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_inout) const;
+
+    /** Trace a batch of rays. Each ray is handled as in the single ray version,
+     *  using t_inout[i] and setting hit_out[i]. Rays are traced in packets of
+     *  consecutive rays, so batches of similar rays (e.g. a grid of rays from
+     *  one viewpoint) are cheapest.
+     */
+    void intersect(uint32 count, const Vector3f* ray_starts, const Vector3f* ray_dirs, float32* t_inout, bool* hit_out) const;
+
+    // Maximum number of rays traced together.
+    static const uint32 PacketSize = 8;
+
+private:
+    // Interior nodes (count == 0) have children at first and first+1. Leaves
+    // cover triangles [first, first+count).
+    struct Node {
+        float32 min[3];
+        uint32 first;
+        float32 max[3];
+        uint32 count;
+    };
+
+    struct BuildTriangle;
+
+    void build(std::vector<BuildTriangle>& tris, uint32 node_idx, uint32 start, uint32 end, uint32 depth);
+    bool intersectSubtree(uint32 root, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_inout) const;
+    void intersectPacket(uint32 count, const Vector3f* ray_starts, const Vector3f* ray_dirs, float32* t_inout, bool* hit_out) const;
+
+    std::vector<Node> mNodes;
+
+    // Triangles as a vertex and two edges, which is what the intersection
+    // test needs.
+    std::vector<float32> mV0x, mV0y, mV0z;
+    std::vector<float32> mE1x, mE1y, mE1z;
+    std::vector<float32> mE2x, mE2y, mE2z;
+};
+
+typedef std::tr1::shared_ptr<MeshBVH> MeshBVHPtr;
+
+} // namespace Mesh
+} // namespace Sirikata
+
+#endif //_SIRIKATA_MESH_MESH_BVH_HPP_
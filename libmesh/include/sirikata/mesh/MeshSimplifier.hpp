@@ -43,42 +43,48 @@
 namespace Sirikata {
 namespace Mesh {
 
+/** Simplifies meshes using quadric error metrics, collapsing edges until the
+ *  mesh has at most a target number of faces. The budget is counted over
+ *  instanced geometry, i.e. a submesh instanced three times contributes three
+ *  times its face count.
+ *
+ *  Each submesh is simplified independently (and in parallel, if the
+ *  simplifier is configured with more than one thread) into a sequence of
+ *  collapses. These are then merged by cost to choose how far to simplify each
+ *  submesh, which also allows a whole sequence of levels of detail to be
+ *  extracted from a single pass.
+ */
 class SIRIKATA_MESH_EXPORT MeshSimplifier {
-private:
-
-  double invert(Matrix4x4f& inv, const Matrix4x4f& orig);
-
-  typedef struct QSlimStruct {
-    double mCost;
-    int mGeomIdx, mIdx1, mIdx2;
-
-
-    Vector3f mReplacementVector;
-
-    QSlimStruct() {
-      mCost = 1e-15;
-    }
-
-    QSlimStruct(float cost, int i, int idx1, int idx2, Vector3f v) {
-      mCost = cost;
-      mGeomIdx = i;
-      mIdx1 = idx1;
-      mIdx2 = idx2;
-      mReplacementVector = v;
-    }
-
-    bool operator < (const QSlimStruct& qs) const {
-      return mCost > qs.mCost;
-    }
-
-  } QSlimStruct;
-
-
 public:
-
+  /** \param num_threads the number of threads used to process submeshes in
+   *  parallel. 0 uses one thread per hardware thread. The calling thread
+   *  counts as one of them; the rest are started here and reused by every
+   *  call until the simplifier is destroyed.
+   */
+  MeshSimplifier(uint32 num_threads = 0);
+  ~MeshSimplifier();
+
+  void setNumThreads(uint32 num_threads);
+  uint32 numThreads() const { return mNumThreads; }
+
+  /** Simplify agg_mesh in place so it has at most numFacesLeft faces. */
   void simplify(Mesh::MeshdataPtr agg_mesh, int32 numFacesLeft);
 
+  /** Generate a set of progressively simpler versions of agg_mesh from one
+   *  simplification pass. lods_out is filled with one copy of agg_mesh per
+   *  entry in numFacesLeft, in the same order, each simplified to that budget.
+   *  agg_mesh itself is not modified.
+   */
+  void simplify(Mesh::MeshdataPtr agg_mesh, const std::vector<int32>& numFacesLeft, std::vector<Mesh::MeshdataPtr>* lods_out);
+
+private:
+  class WorkerPool;
+
+  MeshSimplifier(const MeshSimplifier&);
+  MeshSimplifier& operator=(const MeshSimplifier&);
 
+  uint32 mNumThreads;
+  WorkerPool* mWorkers;
 };
 
 }
@@ -35,9 +35,12 @@
 
 #include <sirikata/mesh/Platform.hpp>
 #include <sirikata/mesh/Visual.hpp>
+#include <sirikata/mesh/GeometryBuffers.hpp>
+#include <sirikata/mesh/MeshBVH.hpp>
 #include <sirikata/core/transfer/RemoteFileMetadata.hpp>
 #include "LightInfo.hpp"
 #include <stack>
+#include <boost/thread/mutex.hpp>
 
 namespace Sirikata {
 namespace Mesh {
@@ -94,7 +97,8 @@ struct SIRIKATA_MESH_EXPORT SubMeshGeometry {
     };
     std::vector<TextureSet>texUVs;
     struct Primitive {
-        std::vector<unsigned short> indices;
+        // Adapts between 16 and 32-bit storage, see IndexList.
+        IndexList indices;
 
         enum PrimitiveType {
             TRIANGLES,
@@ -113,6 +117,12 @@ struct SIRIKATA_MESH_EXPORT SubMeshGeometry {
     double radius;
     void recomputeBounds();
 
+    /** Get a mask of the vertices referenced by any primitive. Bulk operations
+     *  which should ignore unreferenced vertices can use this to extract a
+     *  PositionArrays.
+     */
+    void getReferencedVertices(std::vector<bool>* mask_out) const;
+
     SkinControllerList skinControllers;
 
 
@@ -351,8 +361,32 @@ struct SIRIKATA_MESH_EXPORT Meshdata : public Visual {
     // If this mesh is in progressive format, stores progressive information
     ProgressiveDataPtr progressiveData;
 
+    /** Get the bounding volume hierarchy used to raytrace this mesh. It is
+     *  built the first time it's requested and shared afterwards, so if you
+     *  modify geometry, instances or nodes after that, call invalidateBVH().
+     */
+    MeshBVHPtr getBVH() const;
+    /** Discard the cached BVH, e.g. because the mesh was modified. */
+    void invalidateBVH();
+
   private:
 
+    // Lazily built BVH. Copies start out empty since they are usually made in
+    // order to be modified.
+    struct BVHCache {
+        BVHCache() {}
+        BVHCache(const BVHCache&) {}
+        BVHCache& operator=(const BVHCache&) {
+            boost::mutex::scoped_lock lock(mutex);
+            bvh.reset();
+            return *this;
+        }
+
+        MeshBVHPtr bvh;
+        boost::mutex mutex;
+    };
+    mutable BVHCache mBVHCache;
+
     // A stack of NodeState is used to track the current traversal state for
     // instance iterators
     struct SIRIKATA_MESH_EXPORT NodeState {
@@ -58,6 +58,23 @@ SIRIKATA_MESH_FUNCTION_EXPORT bool Raytrace(VisualPtr vis, const Matrix4x4f& vis
 SIRIKATA_MESH_FUNCTION_EXPORT bool RaytraceType(MeshdataPtr vis, const Matrix4x4f& vis_xform, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_out, Vector3f* hit_out);
 SIRIKATA_MESH_FUNCTION_EXPORT bool RaytraceType(BillboardPtr vis, const Matrix4x4f& vis_xform, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_out, Vector3f* hit_out);
 
+/** Traces a batch of rays against the same visual. The result for each ray is
+ *  the same as calling Raytrace for it individually, but meshes trace
+ *  consecutive rays together, so this is much faster for large numbers of
+ *  similar rays, e.g. a grid of rays cast from one viewpoint.
+ *
+ *  \param vis the mesh to test the rays against
+ *  \param vis_xform transformation to apply to the mesh
+ *  \param ray_starts the starting positions of the rays to trace
+ *  \param ray_dirs the directions of the rays to trace
+ *  \param t_out the parametric value of each ray's collision. Only valid for
+ *  rays which hit.
+ *  \param hits_out whether each ray hit the mesh
+ *  \returns the number of rays which hit the mesh
+ */
+SIRIKATA_MESH_FUNCTION_EXPORT uint32 Raytrace(VisualPtr vis, const Matrix4x4f& vis_xform, const std::vector<Vector3f>& ray_starts, const std::vector<Vector3f>& ray_dirs, std::vector<float32>* t_out, std::vector<bool>* hits_out);
+SIRIKATA_MESH_FUNCTION_EXPORT uint32 RaytraceType(MeshdataPtr vis, const Matrix4x4f& vis_xform, const std::vector<Vector3f>& ray_starts, const std::vector<Vector3f>& ray_dirs, std::vector<float32>* t_out, std::vector<bool>* hits_out);
+
 } // namespace Mesh
 } // namespace Sirikata
 
@@ -0,0 +1,65 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "BinarySystem.hpp"
+#include "MeshdataSerialization.hpp"
+
+#include <fstream>
+
+namespace Sirikata {
+
+ModelsSystem* BinarySystem::create(const String& args) {
+    return new BinarySystem();
+}
+
+
+BinarySystem::BinarySystem() {
+}
+
+BinarySystem::~BinarySystem() {
+}
+
+bool BinarySystem::canLoad(Transfer::DenseDataPtr data) {
+    if (!data) return false;
+    return Mesh::Binary::isBinaryMeshdata(data->begin(), data->length());
+}
+
+Mesh::VisualPtr BinarySystem::load(const Transfer::RemoteFileMetadata& metadata, const Transfer::Fingerprint& fp,
+    Transfer::DenseDataPtr data) {
+    if (!data) return Mesh::VisualPtr();
+    Mesh::MeshdataPtr result = Mesh::Binary::parseMeshdata(data->begin(), data->length());
+    if (!result) return Mesh::VisualPtr();
+    // The stored uri and hash refer to the source the mesh was encoded from,
+    // but like the other loaders we report where we actually loaded it from.
+    result->uri = metadata.getURI().toString();
+    result->hash = fp;
+    return result;
+}
+
+Mesh::VisualPtr BinarySystem::load(Transfer::DenseDataPtr data) {
+    if (!data) return Mesh::VisualPtr();
+    return Mesh::Binary::parseMeshdata(data->begin(), data->length());
+}
+
+
+bool BinarySystem::convertVisual(const Mesh::VisualPtr& visual, const String& format, std::ostream& vout) {
+    Mesh::MeshdataPtr meshdata(std::tr1::dynamic_pointer_cast<Mesh::Meshdata>(visual));
+    if (!meshdata) return false;
+
+    // format is ignored, we only know one format
+    String encoded;
+    Mesh::Binary::serializeMeshdata(*meshdata, &encoded);
+    vout.write(encoded.data(), encoded.size());
+    return !vout.fail();
+}
+
+bool BinarySystem::convertVisual(const Mesh::VisualPtr& visual, const String& format, const String& filename) {
+    std::ofstream vout(filename.c_str(), std::ofstream::out | std::ofstream::binary);
+    if (!vout) return false;
+    bool converted = convertVisual(visual, format, vout);
+    vout.close();
+    return converted;
+}
+
+} // namespace Sirikata
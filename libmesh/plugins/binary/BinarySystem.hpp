@@ -0,0 +1,36 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_MESH_BINARY_SYSTEM_HPP_
+#define _SIRIKATA_MESH_BINARY_SYSTEM_HPP_
+
+#include <sirikata/mesh/ModelsSystem.hpp>
+
+namespace Sirikata {
+
+/** BinarySystem loads and saves Meshdata in a compact, versioned binary
+ *  format (see MeshdataSerialization.hpp). It is much cheaper to parse than
+ *  COLLADA, so it is useful for caching meshes that have already been
+ *  processed, e.g. aggregates.
+ */
+class BinarySystem : public ModelsSystem {
+public:
+    static ModelsSystem* create(const String& args);
+
+    BinarySystem();
+    virtual ~BinarySystem();
+
+    // ModelsSystem Interface
+    virtual bool canLoad(Transfer::DenseDataPtr data);
+    virtual Mesh::VisualPtr load(const Transfer::RemoteFileMetadata& metadata, const Transfer::Fingerprint& fp,
+        Transfer::DenseDataPtr data);
+    virtual Mesh::VisualPtr load(Transfer::DenseDataPtr data) ;
+
+    virtual bool convertVisual(const Mesh::VisualPtr& visual, const String& format, std::ostream& vout);
+    virtual bool convertVisual(const Mesh::VisualPtr& visual, const String& format, const String& filename);
+};
+
+} // namespace Sirikata
+
+#endif // _SIRIKATA_MESH_BINARY_SYSTEM_HPP_
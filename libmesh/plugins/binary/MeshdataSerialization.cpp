@@ -0,0 +1,608 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "MeshdataSerialization.hpp"
+
+#define BINMESH_LOG(lvl,msg) SILOG(binarymesh, lvl, msg)
+
+namespace Sirikata {
+namespace Mesh {
+namespace Binary {
+
+namespace {
+
+class Writer {
+public:
+    Writer(String* out)
+     : mOut(out),
+       mStart(out->size())
+    {}
+
+    void raw(const void* data, size_t len) {
+        if (len == 0) return;
+        mOut->append((const char*)data, len);
+    }
+
+    template<typename T>
+    void pod(const T& val) {
+        raw(&val, sizeof(T));
+    }
+
+    void u8(uint8 v) { pod(v); }
+    void u32(uint32 v) { pod(v); }
+    void i32(int32 v) { pod(v); }
+    void f32(float32 v) { pod(v); }
+    void f64(float64 v) { pod(v); }
+
+    void str(const String& s) {
+        u32(s.size());
+        raw(s.data(), s.size());
+    }
+
+    void align() {
+        size_t pos = mOut->size() - mStart;
+        size_t pad = (FormatArrayAlignment - (pos % FormatArrayAlignment)) % FormatArrayAlignment;
+        mOut->append(pad, '\0');
+    }
+
+    // Bulk arrays: count, element size, padding, raw data.
+    template<typename T>
+    void array(const std::vector<T>& v) {
+        u32(v.size());
+        u32(sizeof(T));
+        align();
+        if (!v.empty())
+            raw(&v[0], v.size() * sizeof(T));
+    }
+
+    // Index lists are written with their current width so 16-bit lists stay
+    // compact and both widths decode with a single copy.
+    void indices(const IndexList& l) {
+        if (l.is32Bit())
+            array(l.storage32());
+        else
+            array(l.storage16());
+    }
+
+    void vec3(const Vector3f& v) { pod(v); }
+    void vec4(const Vector4f& v) { pod(v); }
+    void mat4(const Matrix4x4f& m) { pod(m); }
+    void bbox(const BoundingBox3f3f& bb) {
+        vec3(bb.min());
+        vec3(bb.max());
+    }
+    void sha(const SHA256& h) {
+        raw(h.rawData().data(), SHA256::static_size);
+    }
+
+    size_t size() const { return mOut->size() - mStart; }
+    void patchU64(size_t offset, uint64 v) {
+        memcpy(&(*mOut)[mStart + offset], &v, sizeof(v));
+    }
+
+private:
+    String* mOut;
+    size_t mStart;
+};
+
+class Reader {
+public:
+    Reader(const uint8* data, size_t len)
+     : mData(data),
+       mLen(len),
+       mPos(0),
+       mFailed(false)
+    {}
+
+    bool failed() const { return mFailed; }
+
+    bool raw(void* out, size_t len) {
+        if (mFailed || len > mLen - mPos) {
+            mFailed = true;
+            return false;
+        }
+        if (len > 0)
+            memcpy(out, mData + mPos, len);
+        mPos += len;
+        return true;
+    }
+
+    template<typename T>
+    T pod() {
+        T val = T();
+        raw(&val, sizeof(T));
+        return val;
+    }
+
+    uint8 u8() { return pod<uint8>(); }
+    uint32 u32() { return pod<uint32>(); }
+    int32 i32() { return pod<int32>(); }
+    float32 f32() { return pod<float32>(); }
+    float64 f64() { return pod<float64>(); }
+
+    String str() {
+        uint32 len = u32();
+        if (mFailed || len > mLen - mPos) {
+            mFailed = true;
+            return String();
+        }
+        String result((const char*)(mData + mPos), len);
+        mPos += len;
+        return result;
+    }
+
+    void align() {
+        size_t pad = (FormatArrayAlignment - (mPos % FormatArrayAlignment)) % FormatArrayAlignment;
+        if (pad > mLen - mPos) {
+            mFailed = true;
+            return;
+        }
+        mPos += pad;
+    }
+
+    template<typename T>
+    void array(std::vector<T>* v) {
+        uint32 count = u32();
+        uint32 elem_size = u32();
+        if (mFailed) return;
+        if (elem_size != sizeof(T)) {
+            BINMESH_LOG(error, "Element size mismatch: expected " << sizeof(T) << ", got " << elem_size);
+            mFailed = true;
+            return;
+        }
+        arrayData(count, elem_size, v);
+    }
+
+    void indices(IndexList* l) {
+        uint32 count = u32();
+        uint32 elem_size = u32();
+        if (mFailed) return;
+        if (elem_size == IndexList::Index16) {
+            l->reset(IndexList::Index16);
+            arrayData(count, elem_size, &l->storage16());
+        }
+        else if (elem_size == IndexList::Index32) {
+            l->reset(IndexList::Index32);
+            arrayData(count, elem_size, &l->storage32());
+        }
+        else {
+            BINMESH_LOG(error, "Invalid index size " << elem_size);
+            mFailed = true;
+        }
+    }
+
+    template<typename T>
+    void arrayData(uint32 count, uint32 elem_size, std::vector<T>* v) {
+        align();
+        if (mFailed || (uint64)count * elem_size > mLen - mPos) {
+            mFailed = true;
+            return;
+        }
+        v->resize(count);
+        if (count > 0)
+            raw(&(*v)[0], (size_t)count * elem_size);
+    }
+
+    // Reads a count for a non-bulk list, sanity checking it against the
+    // remaining data so a corrupt count can't trigger a huge allocation.
+    uint32 count() {
+        uint32 c = u32();
+        if (!mFailed && c > mLen - mPos) {
+            mFailed = true;
+            return 0;
+        }
+        return c;
+    }
+
+    Vector3f vec3() { return pod<Vector3f>(); }
+    Vector4f vec4() { return pod<Vector4f>(); }
+    Matrix4x4f mat4() { return pod<Matrix4x4f>(); }
+    BoundingBox3f3f bbox() {
+        Vector3f bmin = vec3();
+        Vector3f bmax = vec3();
+        return BoundingBox3f3f(bmin, bmax);
+    }
+    SHA256 sha() {
+        uint8 buf[SHA256::static_size];
+        raw(buf, SHA256::static_size);
+        return SHA256::convertFromBinary(buf);
+    }
+
+private:
+    const uint8* mData;
+    size_t mLen;
+    size_t mPos;
+    bool mFailed;
+};
+
+
+void writeSkinController(Writer& w, const SkinController& sc) {
+    w.array(sc.joints);
+    w.mat4(sc.bindShapeMatrix);
+    w.array(sc.weightStartIndices);
+    w.array(sc.weights);
+    w.array(sc.jointIndices);
+    w.array(sc.inverseBindMatrices);
+}
+
+void readSkinController(Reader& r, SkinController* sc) {
+    r.array(&sc->joints);
+    sc->bindShapeMatrix = r.mat4();
+    r.array(&sc->weightStartIndices);
+    r.array(&sc->weights);
+    r.array(&sc->jointIndices);
+    r.array(&sc->inverseBindMatrices);
+}
+
+void writeSubMeshGeometry(Writer& w, const SubMeshGeometry& smg) {
+    w.str(smg.name);
+    w.array(smg.positions);
+    w.array(smg.normals);
+    w.array(smg.tangents);
+    w.array(smg.colors);
+    w.u32(smg.texUVs.size());
+    for(uint32 i = 0; i < smg.texUVs.size(); i++) {
+        w.u32(smg.texUVs[i].stride);
+        w.array(smg.texUVs[i].uvs);
+    }
+    w.u32(smg.primitives.size());
+    for(uint32 i = 0; i < smg.primitives.size(); i++) {
+        const SubMeshGeometry::Primitive& prim = smg.primitives[i];
+        w.u32((uint32)prim.primitiveType);
+        w.u32((uint32)prim.materialId);
+        w.indices(prim.indices);
+    }
+    w.bbox(smg.aabb);
+    w.f64(smg.radius);
+    w.u32(smg.skinControllers.size());
+    for(uint32 i = 0; i < smg.skinControllers.size(); i++)
+        writeSkinController(w, smg.skinControllers[i]);
+}
+
+void readSubMeshGeometry(Reader& r, SubMeshGeometry* smg) {
+    smg->name = r.str();
+    r.array(&smg->positions);
+    r.array(&smg->normals);
+    r.array(&smg->tangents);
+    r.array(&smg->colors);
+    uint32 ntexsets = r.count();
+    smg->texUVs.resize(ntexsets);
+    for(uint32 i = 0; i < ntexsets && !r.failed(); i++) {
+        smg->texUVs[i].stride = r.u32();
+        r.array(&smg->texUVs[i].uvs);
+    }
+    uint32 nprims = r.count();
+    smg->primitives.resize(nprims);
+    for(uint32 i = 0; i < nprims && !r.failed(); i++) {
+        SubMeshGeometry::Primitive& prim = smg->primitives[i];
+        prim.primitiveType = (SubMeshGeometry::Primitive::PrimitiveType)r.u32();
+        prim.materialId = r.u32();
+        r.indices(&prim.indices);
+    }
+    smg->aabb = r.bbox();
+    smg->radius = r.f64();
+    uint32 nskins = r.count();
+    smg->skinControllers.resize(nskins);
+    for(uint32 i = 0; i < nskins && !r.failed(); i++)
+        readSkinController(r, &smg->skinControllers[i]);
+}
+
+void writeLightInfo(Writer& w, const LightInfo& li) {
+    w.i32(li.mWhichFields);
+    w.vec3(li.mDiffuseColor);
+    w.vec3(li.mSpecularColor);
+    w.f32(li.mPower);
+    w.vec3(li.mAmbientColor);
+    w.vec3(li.mShadowColor);
+    w.f64(li.mLightRange);
+    w.f32(li.mConstantFalloff);
+    w.f32(li.mLinearFalloff);
+    w.f32(li.mQuadraticFalloff);
+    w.f32(li.mConeInnerRadians);
+    w.f32(li.mConeOuterRadians);
+    w.f32(li.mConeFalloff);
+    w.u32((uint32)li.mType);
+    w.u8(li.mCastsShadow ? 1 : 0);
+}
+
+void readLightInfo(Reader& r, LightInfo* li) {
+    // Note that we set fields directly instead of using the setters or
+    // operator= since those only copy the fields marked in mWhichFields.
+    li->mWhichFields = r.i32();
+    li->mDiffuseColor = r.vec3();
+    li->mSpecularColor = r.vec3();
+    li->mPower = r.f32();
+    li->mAmbientColor = r.vec3();
+    li->mShadowColor = r.vec3();
+    li->mLightRange = r.f64();
+    li->mConstantFalloff = r.f32();
+    li->mLinearFalloff = r.f32();
+    li->mQuadraticFalloff = r.f32();
+    li->mConeInnerRadians = r.f32();
+    li->mConeOuterRadians = r.f32();
+    li->mConeFalloff = r.f32();
+    li->mType = (LightInfo::LightTypes)r.u32();
+    li->mCastsShadow = (r.u8() != 0);
+}
+
+void writeMaterial(Writer& w, const MaterialEffectInfo& mat) {
+    w.u32(mat.textures.size());
+    for(uint32 i = 0; i < mat.textures.size(); i++) {
+        const MaterialEffectInfo::Texture& tex = mat.textures[i];
+        w.str(tex.uri);
+        w.vec4(tex.color);
+        w.u32(tex.texCoord);
+        w.u32((uint32)tex.affecting);
+        w.u32((uint32)tex.samplerType);
+        w.u32((uint32)tex.minFilter);
+        w.u32((uint32)tex.magFilter);
+        w.u32((uint32)tex.wrapS);
+        w.u32((uint32)tex.wrapT);
+        w.u32((uint32)tex.wrapU);
+        w.u32(tex.maxMipLevel);
+        w.f32(tex.mipBias);
+    }
+    w.f32(mat.shininess);
+    w.f32(mat.reflectivity);
+}
+
+void readMaterial(Reader& r, MaterialEffectInfo* mat) {
+    uint32 ntex = r.count();
+    mat->textures.resize(ntex);
+    for(uint32 i = 0; i < ntex && !r.failed(); i++) {
+        MaterialEffectInfo::Texture& tex = mat->textures[i];
+        tex.uri = r.str();
+        tex.color = r.vec4();
+        tex.texCoord = r.u32();
+        tex.affecting = (MaterialEffectInfo::Texture::Affecting)r.u32();
+        tex.samplerType = (MaterialEffectInfo::Texture::SamplerType)r.u32();
+        tex.minFilter = (MaterialEffectInfo::Texture::SamplerFilter)r.u32();
+        tex.magFilter = (MaterialEffectInfo::Texture::SamplerFilter)r.u32();
+        tex.wrapS = (MaterialEffectInfo::Texture::WrapMode)r.u32();
+        tex.wrapT = (MaterialEffectInfo::Texture::WrapMode)r.u32();
+        tex.wrapU = (MaterialEffectInfo::Texture::WrapMode)r.u32();
+        tex.maxMipLevel = r.u32();
+        tex.mipBias = r.f32();
+    }
+    mat->shininess = r.f32();
+    mat->reflectivity = r.f32();
+}
+
+void writeNode(Writer& w, const Node& node) {
+    w.u8(node.containsInstanceController ? 1 : 0);
+    w.i32(node.parent);
+    w.mat4(node.transform);
+    w.array(node.children);
+    w.array(node.instanceChildren);
+    w.u32(node.animations.size());
+    for(Node::AnimationMap::const_iterator it = node.animations.begin(); it != node.animations.end(); it++) {
+        w.str(it->first);
+        w.array(it->second.inputs);
+        w.array(it->second.outputs);
+    }
+}
+
+void readNode(Reader& r, Node* node) {
+    node->containsInstanceController = (r.u8() != 0);
+    node->parent = r.i32();
+    node->transform = r.mat4();
+    r.array(&node->children);
+    r.array(&node->instanceChildren);
+    uint32 nanims = r.count();
+    for(uint32 i = 0; i < nanims && !r.failed(); i++) {
+        String anim_name = r.str();
+        TransformationKeyFrames& kf = node->animations[anim_name];
+        r.array(&kf.inputs);
+        r.array(&kf.outputs);
+    }
+}
+
+void writeProgressiveData(Writer& w, const ProgressiveData& pd) {
+    w.sha(pd.progressiveHash);
+    w.u32(pd.numProgressiveTriangles);
+    w.u32(pd.mipmaps.size());
+    for(ProgressiveMipmapMap::const_iterator it = pd.mipmaps.begin(); it != pd.mipmaps.end(); it++) {
+        const ProgressiveMipmapArchive& archive = it->second;
+        w.str(it->first);
+        w.str(archive.name);
+        w.sha(archive.archiveHash);
+        w.u32(archive.mipmaps.size());
+        for(ProgressiveMipmaps::const_iterator lit = archive.mipmaps.begin(); lit != archive.mipmaps.end(); lit++) {
+            w.u32(lit->first);
+            w.u32(lit->second.offset);
+            w.u32(lit->second.length);
+            w.u32(lit->second.width);
+            w.u32(lit->second.height);
+        }
+    }
+}
+
+void readProgressiveData(Reader& r, ProgressiveData* pd) {
+    pd->progressiveHash = r.sha();
+    pd->numProgressiveTriangles = r.u32();
+    uint32 narchives = r.count();
+    for(uint32 i = 0; i < narchives && !r.failed(); i++) {
+        String key = r.str();
+        ProgressiveMipmapArchive& archive = pd->mipmaps[key];
+        archive.name = r.str();
+        archive.archiveHash = r.sha();
+        uint32 nlevels = r.count();
+        for(uint32 l = 0; l < nlevels && !r.failed(); l++) {
+            uint32 level = r.u32();
+            ProgressiveMipmapLevel& lvl = archive.mipmaps[level];
+            lvl.offset = r.u32();
+            lvl.length = r.u32();
+            lvl.width = r.u32();
+            lvl.height = r.u32();
+        }
+    }
+}
+
+} // namespace
+
+
+bool isBinaryMeshdata(const uint8* data, size_t len) {
+    if (data == NULL || len < FormatHeaderSize) return false;
+    if (memcmp(data, FormatMagic, sizeof(FormatMagic)) != 0) return false;
+    uint32 version;
+    memcpy(&version, data + sizeof(FormatMagic), sizeof(version));
+    return (version == FormatVersion);
+}
+
+void serializeMeshdata(const Meshdata& md, String* out) {
+    Writer w(out);
+
+    // Header. The total size is patched in at the end.
+    w.raw(FormatMagic, sizeof(FormatMagic));
+    w.u32(FormatVersion);
+    w.u32(FormatByteOrderMarker);
+    w.pod((uint64)0);
+    w.pod((uint64)0);
+
+    w.str(md.uri);
+    w.sha(md.hash);
+    w.pod((int64)md.id);
+    w.u8(md.hasAnimations ? 1 : 0);
+    w.mat4(md.globalTransform);
+
+    w.u32(md.geometry.size());
+    for(uint32 i = 0; i < md.geometry.size(); i++)
+        writeSubMeshGeometry(w, md.geometry[i]);
+
+    w.u32(md.textures.size());
+    for(uint32 i = 0; i < md.textures.size(); i++)
+        w.str(md.textures[i]);
+
+    w.u32(md.lights.size());
+    for(uint32 i = 0; i < md.lights.size(); i++)
+        writeLightInfo(w, md.lights[i]);
+
+    w.u32(md.materials.size());
+    for(uint32 i = 0; i < md.materials.size(); i++)
+        writeMaterial(w, md.materials[i]);
+
+    w.u32(md.instances.size());
+    for(uint32 i = 0; i < md.instances.size(); i++) {
+        const GeometryInstance& gi = md.instances[i];
+        w.u32(gi.geometryIndex);
+        w.i32(gi.parentNode);
+        w.u32(gi.materialBindingMap.size());
+        for(GeometryInstance::MaterialBindingMap::const_iterator it = gi.materialBindingMap.begin(); it != gi.materialBindingMap.end(); it++) {
+            w.u32((uint32)it->first);
+            w.u32((uint32)it->second);
+        }
+    }
+
+    w.u32(md.lightInstances.size());
+    for(uint32 i = 0; i < md.lightInstances.size(); i++) {
+        w.i32(md.lightInstances[i].lightIndex);
+        w.i32(md.lightInstances[i].parentNode);
+    }
+
+    w.u32(md.nodes.size());
+    for(uint32 i = 0; i < md.nodes.size(); i++)
+        writeNode(w, md.nodes[i]);
+    w.array(md.rootNodes);
+    w.array(md.mInstanceControllerTransformList);
+    w.array(md.joints);
+
+    w.u8(md.progressiveData ? 1 : 0);
+    if (md.progressiveData)
+        writeProgressiveData(w, *md.progressiveData);
+
+    w.patchU64(16, (uint64)w.size());
+}
+
+MeshdataPtr parseMeshdata(const uint8* data, size_t len) {
+    if (!isBinaryMeshdata(data, len)) {
+        BINMESH_LOG(error, "Data doesn't have a valid binary mesh header");
+        return MeshdataPtr();
+    }
+
+    Reader r(data, len);
+    char magic[sizeof(FormatMagic)];
+    r.raw(magic, sizeof(magic));
+    r.u32(); // version, checked by isBinaryMeshdata
+    if (r.u32() != FormatByteOrderMarker) {
+        BINMESH_LOG(error, "Binary mesh was encoded with a different byte order");
+        return MeshdataPtr();
+    }
+    uint64 total_size = r.pod<uint64>();
+    r.pod<uint64>(); // reserved
+    if (total_size > len) {
+        BINMESH_LOG(error, "Binary mesh is truncated: expected " << total_size << " bytes, got " << len);
+        return MeshdataPtr();
+    }
+
+    MeshdataPtr md(new Meshdata());
+    md->uri = r.str();
+    md->hash = r.sha();
+    md->id = (long)r.pod<int64>();
+    md->hasAnimations = (r.u8() != 0);
+    md->globalTransform = r.mat4();
+
+    uint32 ngeo = r.count();
+    md->geometry.resize(ngeo);
+    for(uint32 i = 0; i < ngeo && !r.failed(); i++)
+        readSubMeshGeometry(r, &md->geometry[i]);
+
+    uint32 ntextures = r.count();
+    md->textures.resize(ntextures);
+    for(uint32 i = 0; i < ntextures && !r.failed(); i++)
+        md->textures[i] = r.str();
+
+    uint32 nlights = r.count();
+    md->lights.resize(nlights);
+    for(uint32 i = 0; i < nlights && !r.failed(); i++)
+        readLightInfo(r, &md->lights[i]);
+
+    uint32 nmaterials = r.count();
+    md->materials.resize(nmaterials);
+    for(uint32 i = 0; i < nmaterials && !r.failed(); i++)
+        readMaterial(r, &md->materials[i]);
+
+    uint32 ninstances = r.count();
+    md->instances.resize(ninstances);
+    for(uint32 i = 0; i < ninstances && !r.failed(); i++) {
+        GeometryInstance& gi = md->instances[i];
+        gi.geometryIndex = r.u32();
+        gi.parentNode = r.i32();
+        uint32 nbindings = r.count();
+        for(uint32 b = 0; b < nbindings && !r.failed(); b++) {
+            uint32 mat_id = r.u32();
+            gi.materialBindingMap[mat_id] = r.u32();
+        }
+    }
+
+    uint32 nlightinstances = r.count();
+    md->lightInstances.resize(nlightinstances);
+    for(uint32 i = 0; i < nlightinstances && !r.failed(); i++) {
+        md->lightInstances[i].lightIndex = r.i32();
+        md->lightInstances[i].parentNode = r.i32();
+    }
+
+    uint32 nnodes = r.count();
+    md->nodes.resize(nnodes);
+    for(uint32 i = 0; i < nnodes && !r.failed(); i++)
+        readNode(r, &md->nodes[i]);
+    r.array(&md->rootNodes);
+    r.array(&md->mInstanceControllerTransformList);
+    r.array(&md->joints);
+
+    if (r.u8() != 0) {
+        md->progressiveData = ProgressiveDataPtr(new ProgressiveData());
+        readProgressiveData(r, md->progressiveData.get());
+    }
+
+    if (r.failed()) {
+        BINMESH_LOG(error, "Failed to decode binary mesh, data is corrupt or truncated");
+        return MeshdataPtr();
+    }
+
+    return md;
+}
+
+} // namespace Binary
+} // namespace Mesh
+} // namespace Sirikata
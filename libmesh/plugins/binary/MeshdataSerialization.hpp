@@ -0,0 +1,58 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_MESH_BINARY_MESHDATA_SERIALIZATION_HPP_
+#define _SIRIKATA_MESH_BINARY_MESHDATA_SERIALIZATION_HPP_
+
+#include <sirikata/mesh/Meshdata.hpp>
+
+namespace Sirikata {
+namespace Mesh {
+namespace Binary {
+
+/** The binary Meshdata format is a versioned, little-endian dump of the
+ *  Meshdata structure. It starts with a fixed size header:
+ *
+ *    8 bytes  magic, "SIRIMESH"
+ *    4 bytes  format version (FormatVersion)
+ *    4 bytes  byte order marker, 0x01020304 as written by the encoder
+ *    8 bytes  total size of the encoded data, including the header
+ *    8 bytes  reserved, 0
+ *
+ *  followed by the body. Scalars and strings are written inline. Bulk arrays
+ *  (positions, normals, uvs, indices, weights, matrices) are written as a
+ *  32-bit element count and 32-bit element size, followed by padding up to a
+ *  16 byte boundary (relative to the start of the data) and then the raw
+ *  elements. Because the raw element layout matches the in-memory layout of
+ *  the vectors in SubMeshGeometry, decoding is a single copy per array, and
+ *  the arrays can be used directly from an mmap'd file.
+ */
+static const char FormatMagic[8] = { 'S', 'I', 'R', 'I', 'M', 'E', 'S', 'H' };
+static const uint32 FormatVersion = 1;
+static const uint32 FormatByteOrderMarker = 0x01020304;
+static const uint32 FormatHeaderSize = 32;
+static const uint32 FormatArrayAlignment = 16;
+
+/** Check if the data starts with a binary Meshdata header this decoder
+ *  understands.
+ */
+bool isBinaryMeshdata(const uint8* data, size_t len);
+
+/** Encode the Meshdata into out. The output is appended, but alignment is
+ *  computed relative to the start of out, so it should be empty if the result
+ *  is to be mmap'd.
+ */
+void serializeMeshdata(const Meshdata& md, String* out);
+
+/** Decode a Meshdata from the given data. Returns an empty MeshdataPtr if the
+ *  data is truncated, has the wrong version, or was written with a different
+ *  byte order or element layout.
+ */
+MeshdataPtr parseMeshdata(const uint8* data, size_t len);
+
+} // namespace Binary
+} // namespace Mesh
+} // namespace Sirikata
+
+#endif //_SIRIKATA_MESH_BINARY_MESHDATA_SERIALIZATION_HPP_
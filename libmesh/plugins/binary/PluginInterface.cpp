@@ -0,0 +1,58 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/mesh/ModelsSystemFactory.hpp>
+#include "BinarySystem.hpp"
+
+static int binary_plugin_refcount = 0;
+
+SIRIKATA_PLUGIN_EXPORT_C void init ()
+{
+    using namespace Sirikata;
+    using namespace Sirikata::Mesh;
+    if ( binary_plugin_refcount == 0 ) {
+        ModelsSystemFactory::getSingleton ().registerConstructor
+            ( "binarymodels" , &BinarySystem::create );
+    }
+
+    ++binary_plugin_refcount;
+}
+
+SIRIKATA_PLUGIN_EXPORT_C int increfcount ()
+{
+    return ++binary_plugin_refcount;
+}
+
+SIRIKATA_PLUGIN_EXPORT_C int decrefcount ()
+{
+    assert ( binary_plugin_refcount > 0 );
+    return --binary_plugin_refcount;
+}
+
+SIRIKATA_PLUGIN_EXPORT_C void destroy ()
+{
+    using namespace Sirikata;
+    using namespace Sirikata::Mesh;
+
+    if ( binary_plugin_refcount > 0 )
+    {
+        --binary_plugin_refcount;
+
+        assert ( binary_plugin_refcount == 0 );
+
+        if ( binary_plugin_refcount == 0 ) {
+            ModelsSystemFactory::getSingleton ().unregisterConstructor ( "binarymodels" );
+        }
+    }
+}
+
+SIRIKATA_PLUGIN_EXPORT_C char const* name ()
+{
+    return "binarymodels";
+}
+
+SIRIKATA_PLUGIN_EXPORT_C int refcount ()
+{
+    return binary_plugin_refcount;
+}
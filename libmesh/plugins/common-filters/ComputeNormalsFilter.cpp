@@ -9,6 +9,37 @@
 namespace Sirikata {
 namespace Mesh {
 
+namespace {
+// Computes triangle normals and adds them to each of the triangle's
+// vertices. Templated on index type so each index width gets its own loop.
+struct AccumulateFaceNormalsOp {
+    AccumulateFaceNormalsOp(const std::vector<Vector3f>& pos, std::vector<Vector3f>& nrms)
+     : positions(pos), normals(nrms)
+    {}
+
+    template<typename IndexType>
+    void operator()(const IndexType* indices, size_t count) {
+        const Vector3f* pos = &positions[0];
+        Vector3f* nrm_out = &normals[0];
+        for(size_t tri_idx = 0; tri_idx < count/3; tri_idx++) {
+            const IndexType i0 = indices[tri_idx*3+0], i1 = indices[tri_idx*3+1], i2 = indices[tri_idx*3+2];
+            Vector3f leg_a = pos[i1] - pos[i0];
+            Vector3f leg_b = pos[i2] - pos[i0];
+
+            Vector3f nrm = leg_a.cross(leg_b).normal();
+
+            // Add the normal to each of three vertices
+            nrm_out[i0] += nrm;
+            nrm_out[i1] += nrm;
+            nrm_out[i2] += nrm;
+        }
+    }
+
+    const std::vector<Vector3f>& positions;
+    std::vector<Vector3f>& normals;
+};
+}
+
 Filter* ComputeNormalsFilter::create(const String& args) {
     return new ComputeNormalsFilter();
 }
@@ -47,17 +78,9 @@ FilterDataPtr ComputeNormalsFilter::apply(FilterDataPtr input) {
                     }
 
                     // Compute triangle normals, add to each vertex
-                    for(uint32 tri_idx = 0; tri_idx != prim_it->indices.size()/3; tri_idx++) {
-                        Vector3f leg_a = submesh.positions[prim_it->indices[tri_idx*3+1]] - submesh.positions[prim_it->indices[tri_idx*3+0]];
-                        Vector3f leg_b = submesh.positions[prim_it->indices[tri_idx*3+2]] - submesh.positions[prim_it->indices[tri_idx*3+0]];
-
-                        Vector3f nrm = leg_a.cross(leg_b).normal();
-
-                        // Add the normal to each of three vertices
-                        submesh.normals[prim_it->indices[tri_idx*3+0]] += nrm;
-                        submesh.normals[prim_it->indices[tri_idx*3+1]] += nrm;
-                        submesh.normals[prim_it->indices[tri_idx*3+2]] += nrm;
-                    }
+                    if (prim_it->indices.empty()) continue;
+                    AccumulateFaceNormalsOp accumulate(submesh.positions, submesh.normals);
+                    ForEachIndexWidth(prim_it->indices, accumulate);
                 }
 
                 // Normalize each normal
@@ -70,13 +70,13 @@ void copySubset(const SubMeshGeometry& orig, const std::vector<int>& prims, SubM
     // Iterate through all copied prims, marking indices as used
     for(std::vector<int>::const_iterator prim_it = prims.begin(); prim_it != prims.end(); prim_it++) {
         const SubMeshGeometry::Primitive& prim = orig.primitives[*prim_it];
-        for(std::vector<unsigned short>::const_iterator ind_it = prim.indices.begin(); ind_it != prim.indices.end(); ind_it++)
-            referenced_indices[*ind_it] = true;
+        for(uint32 ind = 0; ind < prim.indices.size(); ind++)
+            referenced_indices[ prim.indices[ind] ] = true;
     }
 
     // With them all marked, form a map to translate from old indices -> new
     // indices. Copy data over as we go.
-    std::map<unsigned short, unsigned short> index_map;
+    std::map<uint32, uint32> index_map;
     uint32 new_index_source = 0;
     for(int orig_index = 0; orig_index < (int)referenced_indices.size(); orig_index++) {
         if (referenced_indices[orig_index] == false) continue;
@@ -108,9 +108,9 @@ void copySubset(const SubMeshGeometry& orig, const std::vector<int>& prims, SubM
         // should only be one material so they all get mapped to 0.
         new_prim.materialId = 0;
         // Resize appropriately and copy new indices
-        new_prim.indices.resize(orig_prim.indices.size());
+        new_prim.indices.reserve(orig_prim.indices.size());
         for(int ind = 0; ind < (int)orig_prim.indices.size(); ind++)
-            new_prim.indices[ind] = index_map[ orig_prim.indices[ind] ];
+            new_prim.indices.push_back( index_map[ orig_prim.indices[ind] ] );
     }
 
     // Copy animations
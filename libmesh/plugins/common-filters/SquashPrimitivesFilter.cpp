@@ -111,7 +111,7 @@ FilterDataPtr SquashPrimitivesFilter::apply(FilterDataPtr input) {
         combined_primitive.primitiveType = combined_type;
         for(uint32 prim_idx = 0; prim_idx < submesh.primitives.size(); prim_idx++) {
             SubMeshGeometry::Primitive& prim = submesh.primitives[prim_idx];
-            combined_primitive.indices.insert(combined_primitive.indices.end(), prim.indices.begin(), prim.indices.end());
+            combined_primitive.indices.append(prim.indices);
         }
         submesh.primitives.clear();
         submesh.primitives.push_back(combined_primitive);
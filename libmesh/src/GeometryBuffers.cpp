@@ -0,0 +1,175 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/mesh/GeometryBuffers.hpp>
+
+namespace Sirikata {
+namespace Mesh {
+
+namespace {
+template<typename SrcType, typename DstType>
+void copyOffsetIndices(const SrcType* src, DstType* dst, size_t n, uint32 offset) {
+    for(size_t i = 0; i < n; i++)
+        dst[i] = (DstType)(src[i] + offset);
+}
+
+struct MaxIndexOp {
+    MaxIndexOp() : result(0) {}
+    template<typename IndexType>
+    void operator()(const IndexType* indices, size_t count) {
+        IndexType mx = 0;
+        for(size_t i = 0; i < count; i++)
+            mx = std::max(mx, indices[i]);
+        result = mx;
+    }
+    uint32 result;
+};
+}
+
+void IndexList::append(const IndexList& rhs, uint32 offset) {
+    if (rhs.empty()) return;
+
+    if (mWidth == Index16 && (rhs.maxIndex() + (uint64)offset) > 0xFFFF)
+        widen();
+
+    size_t start = size();
+    size_t n = rhs.size();
+    resize(start + n);
+    if (mWidth == Index16) {
+        if (rhs.is32Bit())
+            copyOffsetIndices(rhs.data32(), data16() + start, n, offset);
+        else
+            copyOffsetIndices(rhs.data16(), data16() + start, n, offset);
+    }
+    else {
+        if (rhs.is32Bit())
+            copyOffsetIndices(rhs.data32(), data32() + start, n, offset);
+        else
+            copyOffsetIndices(rhs.data16(), data32() + start, n, offset);
+    }
+}
+
+void IndexList::widen() {
+    if (mWidth == Index32) return;
+    m32.assign(m16.begin(), m16.end());
+    std::vector<uint16>().swap(m16);
+    mWidth = Index32;
+}
+
+bool IndexList::narrow() {
+    if (mWidth == Index16) return true;
+    if (maxIndex() > 0xFFFF) return false;
+    m16.assign(m32.begin(), m32.end());
+    std::vector<uint32>().swap(m32);
+    mWidth = Index16;
+    return true;
+}
+
+uint32 IndexList::maxIndex() const {
+    MaxIndexOp op;
+    ForEachIndexWidth(*this, op);
+    return op.result;
+}
+
+bool IndexList::operator==(const IndexList& rhs) const {
+    if (size() != rhs.size()) return false;
+    if (mWidth == rhs.mWidth)
+        return (mWidth == Index16) ? (m16 == rhs.m16) : (m32 == rhs.m32);
+    for(size_t i = 0; i < size(); i++)
+        if ((*this)[i] != rhs[i]) return false;
+    return true;
+}
+
+
+
+void PositionArrays::assign(const std::vector<Vector3f>& positions) {
+    size_t n = positions.size();
+    x.resize(n); y.resize(n); z.resize(n);
+    for(size_t i = 0; i < n; i++) {
+        x[i] = positions[i].x;
+        y[i] = positions[i].y;
+        z[i] = positions[i].z;
+    }
+}
+
+void PositionArrays::assign(const std::vector<Vector3f>& positions, const std::vector<bool>& mask) {
+    clear();
+    size_t n = std::min(positions.size(), mask.size());
+    size_t count = 0;
+    for(size_t i = 0; i < n; i++)
+        if (mask[i]) count++;
+    x.resize(count); y.resize(count); z.resize(count);
+    size_t out = 0;
+    for(size_t i = 0; i < n; i++) {
+        if (!mask[i]) continue;
+        x[out] = positions[i].x;
+        y[out] = positions[i].y;
+        z[out] = positions[i].z;
+        out++;
+    }
+}
+
+void PositionArrays::transform(const Matrix4x4f& xform) {
+    const float32
+        m00 = xform(0,0), m01 = xform(0,1), m02 = xform(0,2), m03 = xform(0,3),
+        m10 = xform(1,0), m11 = xform(1,1), m12 = xform(1,2), m13 = xform(1,3),
+        m20 = xform(2,0), m21 = xform(2,1), m22 = xform(2,2), m23 = xform(2,3),
+        m30 = xform(3,0), m31 = xform(3,1), m32 = xform(3,2), m33 = xform(3,3);
+
+    size_t n = size();
+    float32* px = n ? &x[0] : NULL;
+    float32* py = n ? &y[0] : NULL;
+    float32* pz = n ? &z[0] : NULL;
+
+    // The common case is affine, which lets us skip the divide.
+    if (m30 == 0.f && m31 == 0.f && m32 == 0.f && m33 == 1.f) {
+        for(size_t i = 0; i < n; i++) {
+            float32 vx = px[i], vy = py[i], vz = pz[i];
+            px[i] = m00*vx + m01*vy + m02*vz + m03;
+            py[i] = m10*vx + m11*vy + m12*vz + m13;
+            pz[i] = m20*vx + m21*vy + m22*vz + m23;
+        }
+    }
+    else {
+        for(size_t i = 0; i < n; i++) {
+            float32 vx = px[i], vy = py[i], vz = pz[i];
+            float32 inv_w = 1.f / (m30*vx + m31*vy + m32*vz + m33);
+            px[i] = (m00*vx + m01*vy + m02*vz + m03) * inv_w;
+            py[i] = (m10*vx + m11*vy + m12*vz + m13) * inv_w;
+            pz[i] = (m20*vx + m21*vy + m22*vz + m23) * inv_w;
+        }
+    }
+}
+
+void PositionArrays::computeBounds(BoundingBox3f3f* bounds_out, double* radius_out) const {
+    size_t n = size();
+    if (n == 0) {
+        if (bounds_out != NULL) *bounds_out = BoundingBox3f3f::null();
+        if (radius_out != NULL) *radius_out = 0.;
+        return;
+    }
+
+    const float32* px = &x[0];
+    const float32* py = &y[0];
+    const float32* pz = &z[0];
+
+    // Each of these is a simple reduction over a contiguous array.
+    float32 min_x = px[0], min_y = py[0], min_z = pz[0];
+    float32 max_x = px[0], max_y = py[0], max_z = pz[0];
+    float32 max_len2 = 0.f;
+    for(size_t i = 0; i < n; i++) {
+        min_x = std::min(min_x, px[i]); max_x = std::max(max_x, px[i]);
+        min_y = std::min(min_y, py[i]); max_y = std::max(max_y, py[i]);
+        min_z = std::min(min_z, pz[i]); max_z = std::max(max_z, pz[i]);
+        max_len2 = std::max(max_len2, px[i]*px[i] + py[i]*py[i] + pz[i]*pz[i]);
+    }
+
+    if (bounds_out != NULL)
+        *bounds_out = BoundingBox3f3f(Vector3f(min_x, min_y, min_z), Vector3f(max_x, max_y, max_z));
+    if (radius_out != NULL)
+        *radius_out = sqrt((double)max_len2);
+}
+
+} // namespace Mesh
+} // namespace Sirikata
@@ -0,0 +1,503 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/mesh/MeshBVH.hpp>
+#include <sirikata/mesh/Meshdata.hpp>
+
+namespace Sirikata {
+namespace Mesh {
+
+namespace {
+
+// Nodes with this many triangles or fewer are always leaves.
+const uint32 MinLeafTriangles = 2;
+// Nodes with more triangles than this are always split, even if the SAH says
+// it isn't worth it.
+const uint32 MaxLeafTriangles = 16;
+const uint32 NumBins = 16;
+// Keeps the traversal stacks below bounded.
+const uint32 MaxDepth = 48;
+const uint32 TraversalStackSize = MaxDepth + 2;
+
+const float32 TriangleEpsilon = 1e-20f;
+
+float32 halfArea(const float32* mn, const float32* mx) {
+    float32 dx = mx[0] - mn[0], dy = mx[1] - mn[1], dz = mx[2] - mn[2];
+    return dx*dy + dy*dz + dz*dx;
+}
+
+// Tests the ray against the box, returning true if it overlaps the box
+// somewhere in [0, tmax]. Entry distance is returned in tentry. Slab distances
+// are ordered by the sign of the direction so that the NaNs produced when the
+// ray lies exactly in a slab's plane (0 * inf) are dropped by the min/max.
+bool rayBox(const float32* mn, const float32* mx,
+    float32 ox, float32 oy, float32 oz,
+    float32 ix, float32 iy, float32 iz,
+    float32 tmax, float32* tentry)
+{
+    float32 t0 = 0.f, t1 = tmax;
+    t0 = std::max(t0, ((ix >= 0.f ? mn[0] : mx[0]) - ox) * ix);
+    t1 = std::min(t1, ((ix >= 0.f ? mx[0] : mn[0]) - ox) * ix);
+    t0 = std::max(t0, ((iy >= 0.f ? mn[1] : mx[1]) - oy) * iy);
+    t1 = std::min(t1, ((iy >= 0.f ? mx[1] : mn[1]) - oy) * iy);
+    t0 = std::max(t0, ((iz >= 0.f ? mn[2] : mx[2]) - oz) * iz);
+    t1 = std::min(t1, ((iz >= 0.f ? mx[2] : mn[2]) - oz) * iz);
+    *tentry = t0;
+    return t0 <= t1;
+}
+
+} // namespace
+
+struct MeshBVH::BuildTriangle {
+    Vector3f v[3];
+    float32 min[3], max[3];
+    float32 centroid[3];
+};
+
+namespace {
+// Partition predicate: whether a triangle's centroid falls in the left bins.
+struct InLeftBins {
+    InLeftBins(int a, float32 mn, float32 s, uint32 split)
+     : axis(a), cmin(mn), scale(s), splitBin(split)
+    {}
+
+    template<typename Tri>
+    bool operator()(const Tri& tri) const {
+        uint32 bin = std::min(NumBins-1, (uint32)((tri.centroid[axis] - cmin) * scale));
+        return bin <= splitBin;
+    }
+
+    int axis;
+    float32 cmin, scale;
+    uint32 splitBin;
+};
+
+struct CentroidLess {
+    CentroidLess(int a) : axis(a) {}
+
+    template<typename Tri>
+    bool operator()(const Tri& lhs, const Tri& rhs) const {
+        return lhs.centroid[axis] < rhs.centroid[axis];
+    }
+
+    int axis;
+};
+} // namespace
+
+MeshBVH::MeshBVH(const Meshdata& md) {
+    std::vector<BuildTriangle> tris;
+
+    // Collect all the triangles in mesh space. Lines and points can't be hit,
+    // so they're ignored.
+    PositionArrays pos;
+    uint32 geoinst_idx;
+    Matrix4x4f geoinst_xform;
+    Meshdata::GeometryInstanceIterator geoinst_it = md.getGeometryInstanceIterator();
+    while(geoinst_it.next(&geoinst_idx, &geoinst_xform)) {
+        const SubMeshGeometry& geo = md.geometry[ md.instances[geoinst_idx].geometryIndex ];
+        pos.clear();
+
+        for(uint32 pi = 0; pi < geo.primitives.size(); pi++) {
+            const SubMeshGeometry::Primitive& prim = geo.primitives[pi];
+            if (prim.primitiveType == SubMeshGeometry::Primitive::LINES ||
+                prim.primitiveType == SubMeshGeometry::Primitive::POINTS ||
+                prim.primitiveType == SubMeshGeometry::Primitive::LINESTRIPS)
+                continue;
+
+            if (pos.empty()) {
+                pos.assign(geo.positions);
+                pos.transform(geoinst_xform);
+            }
+
+            uint32 ntris = 0;
+            switch(prim.primitiveType) {
+              case SubMeshGeometry::Primitive::TRIANGLES:
+                ntris = prim.indices.size() / 3; break;
+              case SubMeshGeometry::Primitive::TRISTRIPS:
+              case SubMeshGeometry::Primitive::TRIFANS:
+                ntris = (prim.indices.size() > 2) ? prim.indices.size() - 2 : 0; break;
+              default:
+                break;
+            }
+
+            for(uint32 ii = 0; ii < ntris; ii++) {
+                uint32 i1, i2, i3;
+                if (prim.primitiveType == SubMeshGeometry::Primitive::TRIANGLES) {
+                    i1 = prim.indices[3*ii]; i2 = prim.indices[3*ii+1]; i3 = prim.indices[3*ii+2];
+                }
+                else if (prim.primitiveType == SubMeshGeometry::Primitive::TRISTRIPS) {
+                    i1 = prim.indices[(ii % 2 == 0) ? ii : ii+1];
+                    i2 = prim.indices[(ii % 2 == 0) ? ii+1 : ii];
+                    i3 = prim.indices[ii+2];
+                }
+                else {
+                    i1 = prim.indices[0]; i2 = prim.indices[ii+1]; i3 = prim.indices[ii+2];
+                }
+                if (i1 >= pos.size() || i2 >= pos.size() || i3 >= pos.size()) continue;
+
+                BuildTriangle tri;
+                tri.v[0] = pos.get(i1); tri.v[1] = pos.get(i2); tri.v[2] = pos.get(i3);
+                for(int a = 0; a < 3; a++) {
+                    tri.min[a] = std::min(tri.v[0][a], std::min(tri.v[1][a], tri.v[2][a]));
+                    tri.max[a] = std::max(tri.v[0][a], std::max(tri.v[1][a], tri.v[2][a]));
+                    tri.centroid[a] = (tri.v[0][a] + tri.v[1][a] + tri.v[2][a]) / 3.f;
+                }
+                tris.push_back(tri);
+            }
+        }
+    }
+
+    if (tris.empty()) return;
+
+    mNodes.reserve(2 * (tris.size() / MinLeafTriangles + 1));
+    mNodes.push_back(Node());
+    build(tris, 0, 0, tris.size(), 0);
+
+    // Store triangles in leaf order.
+    uint32 ntris = tris.size();
+    mV0x.resize(ntris); mV0y.resize(ntris); mV0z.resize(ntris);
+    mE1x.resize(ntris); mE1y.resize(ntris); mE1z.resize(ntris);
+    mE2x.resize(ntris); mE2y.resize(ntris); mE2z.resize(ntris);
+    for(uint32 i = 0; i < ntris; i++) {
+        const BuildTriangle& tri = tris[i];
+        mV0x[i] = tri.v[0].x; mV0y[i] = tri.v[0].y; mV0z[i] = tri.v[0].z;
+        mE1x[i] = tri.v[1].x - tri.v[0].x; mE1y[i] = tri.v[1].y - tri.v[0].y; mE1z[i] = tri.v[1].z - tri.v[0].z;
+        mE2x[i] = tri.v[2].x - tri.v[0].x; mE2y[i] = tri.v[2].y - tri.v[0].y; mE2z[i] = tri.v[2].z - tri.v[0].z;
+    }
+}
+
+void MeshBVH::build(std::vector<BuildTriangle>& tris, uint32 node_idx, uint32 start, uint32 end, uint32 depth) {
+    float32 bmin[3], bmax[3], cmin[3], cmax[3];
+    for(int a = 0; a < 3; a++) {
+        bmin[a] = cmin[a] = std::numeric_limits<float32>::max();
+        bmax[a] = cmax[a] = -std::numeric_limits<float32>::max();
+    }
+    for(uint32 i = start; i < end; i++) {
+        const BuildTriangle& tri = tris[i];
+        for(int a = 0; a < 3; a++) {
+            bmin[a] = std::min(bmin[a], tri.min[a]); bmax[a] = std::max(bmax[a], tri.max[a]);
+            cmin[a] = std::min(cmin[a], tri.centroid[a]); cmax[a] = std::max(cmax[a], tri.centroid[a]);
+        }
+    }
+
+    Node& node = mNodes[node_idx];
+    for(int a = 0; a < 3; a++) {
+        node.min[a] = bmin[a];
+        node.max[a] = bmax[a];
+    }
+    node.first = start;
+    node.count = end - start;
+
+    uint32 count = end - start;
+    if (count <= MinLeafTriangles || depth >= MaxDepth) return;
+
+    // Split along the axis with the largest centroid extent.
+    int axis = 0;
+    for(int a = 1; a < 3; a++)
+        if (cmax[a] - cmin[a] > cmax[axis] - cmin[axis]) axis = a;
+    float32 extent = cmax[axis] - cmin[axis];
+    // All centroids coincide, nothing useful to split on.
+    if (extent <= 0) return;
+
+    // Bin centroids and evaluate the SAH at each bin boundary.
+    struct Bin {
+        uint32 count;
+        float32 min[3], max[3];
+    } bins[NumBins];
+    for(uint32 b = 0; b < NumBins; b++) {
+        bins[b].count = 0;
+        for(int a = 0; a < 3; a++) {
+            bins[b].min[a] = std::numeric_limits<float32>::max();
+            bins[b].max[a] = -std::numeric_limits<float32>::max();
+        }
+    }
+    float32 scale = NumBins / extent;
+    for(uint32 i = start; i < end; i++) {
+        const BuildTriangle& tri = tris[i];
+        uint32 b = std::min(NumBins-1, (uint32)((tri.centroid[axis] - cmin[axis]) * scale));
+        bins[b].count++;
+        for(int a = 0; a < 3; a++) {
+            bins[b].min[a] = std::min(bins[b].min[a], tri.min[a]);
+            bins[b].max[a] = std::max(bins[b].max[a], tri.max[a]);
+        }
+    }
+
+    float32 right_cost[NumBins];
+    {
+        float32 mn[3], mx[3];
+        uint32 right_count = 0;
+        for(int a = 0; a < 3; a++) {
+            mn[a] = std::numeric_limits<float32>::max();
+            mx[a] = -std::numeric_limits<float32>::max();
+        }
+        for(uint32 b = NumBins-1; b > 0; b--) {
+            right_count += bins[b].count;
+            for(int a = 0; a < 3; a++) {
+                mn[a] = std::min(mn[a], bins[b].min[a]);
+                mx[a] = std::max(mx[a], bins[b].max[a]);
+            }
+            right_cost[b-1] = right_count ? right_count * halfArea(mn, mx) : 0;
+        }
+    }
+
+    float32 best_cost = std::numeric_limits<float32>::max();
+    uint32 best_split = NumBins;
+    {
+        float32 mn[3], mx[3];
+        uint32 left_count = 0;
+        for(int a = 0; a < 3; a++) {
+            mn[a] = std::numeric_limits<float32>::max();
+            mx[a] = -std::numeric_limits<float32>::max();
+        }
+        for(uint32 b = 0; b < NumBins-1; b++) {
+            left_count += bins[b].count;
+            for(int a = 0; a < 3; a++) {
+                mn[a] = std::min(mn[a], bins[b].min[a]);
+                mx[a] = std::max(mx[a], bins[b].max[a]);
+            }
+            if (left_count == 0 || left_count == count) continue;
+            float32 cost = left_count * halfArea(mn, mx) + right_cost[b];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_split = b;
+            }
+        }
+    }
+
+    // Compare against intersecting everything in this node, with traversal
+    // costing about as much as one triangle test.
+    float32 leaf_cost = (count - 1) * halfArea(bmin, bmax);
+    if (best_cost >= leaf_cost && count <= MaxLeafTriangles) return;
+
+    uint32 mid;
+    if (best_split < NumBins) {
+        mid = std::partition(tris.begin() + start, tris.begin() + end,
+            InLeftBins(axis, cmin[axis], scale, best_split)) - tris.begin();
+    }
+    else {
+        // Couldn't find a useful split, fall back to the median.
+        mid = start + count / 2;
+        std::nth_element(tris.begin() + start, tris.begin() + mid, tris.begin() + end, CentroidLess(axis));
+    }
+
+    uint32 left = mNodes.size();
+    mNodes.push_back(Node());
+    mNodes.push_back(Node());
+    // node may have been invalidated by push_back
+    mNodes[node_idx].first = left;
+    mNodes[node_idx].count = 0;
+
+    build(tris, left, start, mid, depth+1);
+    build(tris, left+1, mid, end, depth+1);
+}
+
+BoundingBox3f3f MeshBVH::bounds() const {
+    if (mNodes.empty()) return BoundingBox3f3f::null();
+    const Node& root = mNodes[0];
+    return BoundingBox3f3f(
+        Vector3f(root.min[0], root.min[1], root.min[2]),
+        Vector3f(root.max[0], root.max[1], root.max[2])
+    );
+}
+
+bool MeshBVH::intersect(const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_inout) const {
+    if (mNodes.empty()) return false;
+    return intersectSubtree(0, ray_start, ray_dir, t_inout);
+}
+
+bool MeshBVH::intersectSubtree(uint32 root, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_inout) const {
+
+    const float32 ox = ray_start.x, oy = ray_start.y, oz = ray_start.z;
+    const float32 dx = ray_dir.x, dy = ray_dir.y, dz = ray_dir.z;
+    const float32 ix = 1.f / dx, iy = 1.f / dy, iz = 1.f / dz;
+    float32 t = *t_inout;
+    bool hit = false;
+
+    uint32 stack[TraversalStackSize];
+    uint32 sp = 0;
+    float32 tentry;
+    if (!rayBox(mNodes[root].min, mNodes[root].max, ox, oy, oz, ix, iy, iz, t, &tentry))
+        return false;
+    stack[sp++] = root;
+
+    while(sp > 0) {
+        const Node& node = mNodes[stack[--sp]];
+
+        if (node.count > 0) {
+            for(uint32 i = node.first; i < node.first + node.count; i++) {
+                float32 px = dy*mE2z[i] - dz*mE2y[i];
+                float32 py = dz*mE2x[i] - dx*mE2z[i];
+                float32 pz = dx*mE2y[i] - dy*mE2x[i];
+                float32 det = mE1x[i]*px + mE1y[i]*py + mE1z[i]*pz;
+                if (fabs(det) < TriangleEpsilon) continue;
+                float32 inv_det = 1.f / det;
+
+                float32 tx = ox - mV0x[i], ty = oy - mV0y[i], tz = oz - mV0z[i];
+                float32 u = (tx*px + ty*py + tz*pz) * inv_det;
+                if (u < 0.f || u > 1.f) continue;
+
+                float32 qx = ty*mE1z[i] - tz*mE1y[i];
+                float32 qy = tz*mE1x[i] - tx*mE1z[i];
+                float32 qz = tx*mE1y[i] - ty*mE1x[i];
+                float32 v = (dx*qx + dy*qy + dz*qz) * inv_det;
+                if (v < 0.f || u + v > 1.f) continue;
+
+                float32 tt = (mE2x[i]*qx + mE2y[i]*qy + mE2z[i]*qz) * inv_det;
+                if (tt < 0.f || tt > t) continue;
+                t = tt;
+                hit = true;
+            }
+            continue;
+        }
+
+        // Visit the nearer child first so the farther one can often be
+        // culled by the hit it finds.
+        const Node& left = mNodes[node.first];
+        const Node& right = mNodes[node.first+1];
+        float32 tleft, tright;
+        bool hit_left = rayBox(left.min, left.max, ox, oy, oz, ix, iy, iz, t, &tleft);
+        bool hit_right = rayBox(right.min, right.max, ox, oy, oz, ix, iy, iz, t, &tright);
+        if (hit_left && hit_right) {
+            if (tleft <= tright) {
+                stack[sp++] = node.first+1;
+                stack[sp++] = node.first;
+            }
+            else {
+                stack[sp++] = node.first;
+                stack[sp++] = node.first+1;
+            }
+        }
+        else if (hit_left) {
+            stack[sp++] = node.first;
+        }
+        else if (hit_right) {
+            stack[sp++] = node.first+1;
+        }
+    }
+
+    if (hit) *t_inout = t;
+    return hit;
+}
+
+void MeshBVH::intersect(uint32 count, const Vector3f* ray_starts, const Vector3f* ray_dirs, float32* t_inout, bool* hit_out) const {
+    for(uint32 i = 0; i < count; i += PacketSize) {
+        uint32 n = (count - i < PacketSize) ? count - i : PacketSize;
+        if (n == 1) {
+            hit_out[i] = intersect(ray_starts[i], ray_dirs[i], &t_inout[i]);
+            continue;
+        }
+        intersectPacket(n, ray_starts + i, ray_dirs + i, t_inout + i, hit_out + i);
+    }
+}
+
+void MeshBVH::intersectPacket(uint32 n, const Vector3f* ray_starts, const Vector3f* ray_dirs, float32* t_inout, bool* hit_out) const {
+    for(uint32 r = 0; r < n; r++)
+        hit_out[r] = false;
+    if (mNodes.empty()) return;
+
+    // Rays in structure-of-arrays form so each step below is a loop over the
+    // packet.
+    float32 ox[PacketSize], oy[PacketSize], oz[PacketSize];
+    float32 dx[PacketSize], dy[PacketSize], dz[PacketSize];
+    float32 ix[PacketSize], iy[PacketSize], iz[PacketSize];
+    float32 t[PacketSize];
+    bool hit[PacketSize];
+    for(uint32 r = 0; r < n; r++) {
+        ox[r] = ray_starts[r].x; oy[r] = ray_starts[r].y; oz[r] = ray_starts[r].z;
+        dx[r] = ray_dirs[r].x; dy[r] = ray_dirs[r].y; dz[r] = ray_dirs[r].z;
+        ix[r] = 1.f / dx[r]; iy[r] = 1.f / dy[r]; iz[r] = 1.f / dz[r];
+        t[r] = t_inout[r];
+        hit[r] = false;
+    }
+
+    // Each stack entry carries the set of rays that reached its parent, so
+    // rays which already missed are never tested again further down.
+    uint32 stack[TraversalStackSize];
+    uint32 stack_mask[TraversalStackSize];
+    uint32 sp = 0;
+    stack[sp] = 0;
+    stack_mask[sp] = (1u << n) - 1;
+    sp++;
+
+    while(sp > 0) {
+        sp--;
+        const Node& node = mNodes[stack[sp]];
+        const uint32 parent_mask = stack_mask[sp];
+
+        // The packet visits a node if any of its rays do. Leaves only test the
+        // rays which reached them.
+        uint32 active[PacketSize];
+        uint32 nactive = 0;
+        uint32 mask = 0;
+        for(uint32 r = 0; r < n; r++) {
+            if (!(parent_mask & (1u << r))) continue;
+            float32 tentry;
+            bool in = rayBox(node.min, node.max, ox[r], oy[r], oz[r], ix[r], iy[r], iz[r], t[r], &tentry);
+            active[nactive] = r;
+            nactive += in ? 1 : 0;
+            mask |= (in ? 1u : 0u) << r;
+        }
+        if (nactive == 0) continue;
+
+        // Once the packet has diverged to a single ray, the single ray
+        // traversal is cheaper.
+        if (nactive == 1 && node.count == 0) {
+            const uint32 r = active[0];
+            hit[r] = intersectSubtree(stack[sp], ray_starts[r], ray_dirs[r], &t[r]) || hit[r];
+            continue;
+        }
+
+        if (node.count == 0) {
+            // Rays in a packet are assumed to be similar, so order children
+            // by one ray's direction to visit the nearer one first.
+            const uint32 r = active[0];
+            const Node& left = mNodes[node.first];
+            const Node& right = mNodes[node.first+1];
+            float32 along =
+                (left.min[0] + left.max[0] - right.min[0] - right.max[0]) * dx[r] +
+                (left.min[1] + left.max[1] - right.min[1] - right.max[1]) * dy[r] +
+                (left.min[2] + left.max[2] - right.min[2] - right.max[2]) * dz[r];
+            uint32 near_child = (along <= 0.f) ? node.first : node.first+1;
+            uint32 far_child = (along <= 0.f) ? node.first+1 : node.first;
+            stack[sp] = far_child; stack_mask[sp] = mask; sp++;
+            stack[sp] = near_child; stack_mask[sp] = mask; sp++;
+            continue;
+        }
+
+        for(uint32 i = node.first; i < node.first + node.count; i++) {
+            const float32 v0x = mV0x[i], v0y = mV0y[i], v0z = mV0z[i];
+            const float32 e1x = mE1x[i], e1y = mE1y[i], e1z = mE1z[i];
+            const float32 e2x = mE2x[i], e2y = mE2y[i], e2z = mE2z[i];
+            // Branch free so the compiler can evaluate several rays at once.
+            for(uint32 a = 0; a < nactive; a++) {
+                const uint32 r = active[a];
+                float32 px = dy[r]*e2z - dz[r]*e2y;
+                float32 py = dz[r]*e2x - dx[r]*e2z;
+                float32 pz = dx[r]*e2y - dy[r]*e2x;
+                float32 det = e1x*px + e1y*py + e1z*pz;
+                float32 inv_det = 1.f / det;
+                float32 tx = ox[r] - v0x, ty = oy[r] - v0y, tz = oz[r] - v0z;
+                float32 u = (tx*px + ty*py + tz*pz) * inv_det;
+                float32 qx = ty*e1z - tz*e1y;
+                float32 qy = tz*e1x - tx*e1z;
+                float32 qz = tx*e1y - ty*e1x;
+                float32 v = (dx[r]*qx + dy[r]*qy + dz[r]*qz) * inv_det;
+                float32 tt = (e2x*qx + e2y*qy + e2z*qz) * inv_det;
+                bool ok =
+                    (fabs(det) >= TriangleEpsilon) & (u >= 0.f) & (v >= 0.f) &
+                    (u + v <= 1.f) & (tt >= 0.f) & (tt <= t[r]);
+                t[r] = ok ? tt : t[r];
+                hit[r] = hit[r] | ok;
+            }
+        }
+    }
+
+    for(uint32 r = 0; r < n; r++) {
+        if (hit[r]) t_inout[r] = t[r];
+        hit_out[r] = hit[r];
+    }
+}
+
+} // namespace Mesh
+} // namespace Sirikata
@@ -35,12 +35,9 @@
 #include <boost/functional/hash.hpp>
 
 #include <sirikata/core/util/Timer.hpp>
-#ifdef _WIN32
-#include <float.h>
-#else
+#include <sirikata/core/util/Thread.hpp>
 #include <cmath>
-#endif
-#include <math.h>
+#include <queue>
 
 #define SIMPLIFY_LOG(lvl, msg) SILOG(simplify, lvl, msg)
 
@@ -48,800 +45,872 @@ namespace Sirikata {
 
 namespace Mesh {
 
-#define SIMPLIFIER_INVALID_VECTOR Vector3f(-1000000,-1000000,-1000000)
+namespace {
 
-class IndexedFaceContainer {
-public:
-
-  bool valid;
-  uint32 idx1;
-  uint32 idx2;
-  uint32 idx3;
-
-  IndexedFaceContainer(uint32 i, uint32 j, uint32 k) :
-    valid(true), idx1(i), idx2(j), idx3(k)
-  {
-  }
-
-};
+const uint32 InvalidIndex = 0xFFFFFFFF;
 
-class FaceContainer {
-public:
-  Vector3f v1;
-  Vector3f v2;
-  Vector3f v3;
+/** A symmetric 4x4 quadric error matrix, stored as its upper triangle. Keeping
+ *  it as a flat array (rather than a Matrix4x4d) makes accumulation and
+ *  evaluation straight-line arithmetic the compiler can schedule well.
+ */
+struct Quadric {
+    // a00 a01 a02 a03 a11 a12 a13 a22 a23 a33
+    double a[10];
 
-  FaceContainer(Vector3f& v1, Vector3f& v2, Vector3f& v3) {
-    this->v1 = v1;
-    this->v2 = v2;
-    this->v3 = v3;
-  }
+    Quadric() {
+        for(int i = 0; i < 10; i++) a[i] = 0;
+    }
 
-  FaceContainer() {
-  }
+    // Adds w * p p^T for the plane p = (A,B,C,D).
+    void addPlane(double A, double B, double C, double D, double w) {
+        a[0] += w*A*A; a[1] += w*A*B; a[2] += w*A*C; a[3] += w*A*D;
+        a[4] += w*B*B; a[5] += w*B*C; a[6] += w*B*D;
+        a[7] += w*C*C; a[8] += w*C*D;
+        a[9] += w*D*D;
+    }
 
-  size_t hash() const {
-      size_t seed = 0;
+    Quadric& operator+=(const Quadric& rhs) {
+        for(int i = 0; i < 10; i++) a[i] += rhs.a[i];
+        return *this;
+    }
 
-      size_t pos1Hash = v1.hash();
-      size_t pos2Hash = v2.hash();
-      size_t pos3Hash = v3.hash();
+    // Evaluates v^T Q v for v = (x,y,z,1).
+    double evaluate(double x, double y, double z) const {
+        return
+            a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + 2*a[3]*x +
+            a[4]*y*y + 2*a[5]*y*z + 2*a[6]*y +
+            a[7]*z*z + 2*a[8]*z +
+            a[9];
+    }
+};
 
-      std::vector<size_t> facevecs;      
-      facevecs.push_back(pos1Hash);facevecs.push_back(pos2Hash);facevecs.push_back(pos3Hash);
-      sort(facevecs.begin(), facevecs.end());      
+/** Binary min-heap of ids keyed by cost. Tracks the position of each id so
+ *  entries can be updated or removed in O(log n), which lets edge costs be
+ *  adjusted in place instead of erasing and reinserting them in a std::set.
+ */
+class IndexedHeap {
+public:
+    void reset(uint32 n) {
+        mHeap.clear();
+        mHeap.reserve(n);
+        mPos.assign(n, InvalidIndex);
+        mKey.assign(n, 0);
+    }
 
-      seed = 0;
-      boost::hash_combine(seed, facevecs[0]);
-      boost::hash_combine(seed, facevecs[1]);
-      boost::hash_combine(seed, facevecs[2]);
+    bool empty() const { return mHeap.empty(); }
+    bool contains(uint32 id) const { return mPos[id] != InvalidIndex; }
+    double key(uint32 id) const { return mKey[id]; }
 
-      return seed;
-  }
+    void push(uint32 id, double key) {
+        mKey[id] = key;
+        mPos[id] = mHeap.size();
+        mHeap.push_back(id);
+        siftUp(mPos[id]);
+    }
 
-  bool operator==(const FaceContainer&other)const {
-    if (v1+v2+v3 != other.v1+other.v2+other.v3) return false;
+    uint32 pop() {
+        uint32 top = mHeap[0];
+        remove(top);
+        return top;
+    }
 
-    //There is a more elegant way to do this, but this is
-    //easier to code and faster.
-    if (v1 == other.v1) {
-       if ((v2==other.v2 && v3==other.v3) ||
-           (v2==other.v3 && v3==other.v2))
-          return true;
+    void update(uint32 id, double key) {
+        if (!contains(id)) {
+            push(id, key);
+            return;
+        }
+        double old_key = mKey[id];
+        mKey[id] = key;
+        if (key < old_key)
+            siftUp(mPos[id]);
+        else
+            siftDown(mPos[id]);
     }
 
-    if (v1 == other.v2) {
-      if ((v2==other.v1 && v3==other.v3) ||
-          (v2==other.v3 && v3==other.v1))
-        return true;
+    void remove(uint32 id) {
+        uint32 pos = mPos[id];
+        if (pos == InvalidIndex) return;
+        uint32 last = mHeap.back();
+        mHeap.pop_back();
+        mPos[id] = InvalidIndex;
+        if (last == id) return;
+        place(pos, last);
+        siftUp(pos);
+        siftDown(mPos[last]);
     }
 
-    if (v1 == other.v3) {
-     if ((v2==other.v1 && v3==other.v2) ||
-         (v2==other.v2 && v3==other.v1))
-       return true;
+private:
+    // Ties are broken by id so results don't depend on heap history.
+    bool less(uint32 lhs, uint32 rhs) const {
+        if (mKey[lhs] != mKey[rhs]) return mKey[lhs] < mKey[rhs];
+        return lhs < rhs;
     }
 
-    return false;
-  }
+    void place(uint32 pos, uint32 id) {
+        mHeap[pos] = id;
+        mPos[id] = pos;
+    }
 
-  class Hasher{
-  public:
-        size_t operator() (const FaceContainer& g) const {
-            return g.hash();
+    void siftUp(uint32 pos) {
+        uint32 id = mHeap[pos];
+        while(pos > 0) {
+            uint32 parent = (pos - 1) / 2;
+            if (!less(id, mHeap[parent])) break;
+            place(pos, mHeap[parent]);
+            pos = parent;
         }
-  };
-
-};
-
+        place(pos, id);
+    }
 
-class GeomContainer {
-public:
-  uint32 geomIdx;
-  uint32 vertexIdx;
-
-  GeomContainer(int g, int v) {
-    geomIdx = g;
-    vertexIdx = v;
-  }
-
-  GeomContainer() {
-    geomIdx = vertexIdx = 0;
-  }
-
-  size_t hash() const {
-      size_t seed = 0;
-      boost::hash_combine(seed, geomIdx);
-      boost::hash_combine(seed, vertexIdx);
-
-      return seed;
-  }
-
-  bool operator==(const GeomContainer&other)const {
-        return geomIdx==other.geomIdx && vertexIdx==other.vertexIdx;
-  }
-
-  class Hasher{
-  public:
-        size_t operator() (const GeomContainer& g) const {
-            return g.hash();
+    void siftDown(uint32 pos) {
+        uint32 id = mHeap[pos];
+        uint32 n = mHeap.size();
+        while(true) {
+            uint32 child = 2*pos + 1;
+            if (child >= n) break;
+            if (child+1 < n && less(mHeap[child+1], mHeap[child])) child++;
+            if (!less(mHeap[child], id)) break;
+            place(pos, mHeap[child]);
+            pos = child;
         }
-  };
+        place(pos, id);
+    }
 
+    std::vector<uint32> mHeap;
+    std::vector<uint32> mPos;
+    std::vector<double> mKey;
 };
 
-class GeomPairContainer {
-public:
-  uint32 mGeomIdx;
-  uint32 mVertexIdx1;
-  uint32 mVertexIdx2;
-
-  float64 mCost;
-  Vector3f mReplacementVector;
-
-  void init(uint32 g, uint32 v1, uint32 v2) {
-    mGeomIdx = g;
-    mVertexIdx1 = v1;
-    mVertexIdx2 = v2;
+// Order independent key for a triangle, used to find duplicate faces.
+struct FaceKey {
+    uint32 v[3];
 
-    if (mVertexIdx1 > mVertexIdx2) {
-      uint32 temp = mVertexIdx1;
-      mVertexIdx1 = mVertexIdx2;
-      mVertexIdx2 = temp;
+    FaceKey(uint32 a, uint32 b, uint32 c) {
+        v[0] = a; v[1] = b; v[2] = c;
+        if (v[0] > v[1]) std::swap(v[0], v[1]);
+        if (v[1] > v[2]) std::swap(v[1], v[2]);
+        if (v[0] > v[1]) std::swap(v[0], v[1]);
     }
 
-    mCost = 0;
-  }
-
-  GeomPairContainer(uint32 g, uint32 v1, uint32 v2) {
-    init(g,v1,v2);
-  }
-
-  GeomPairContainer(uint32 g, uint32 v1, uint32 v2, float64 cost)  {
-    init(g,v1,v2);
-    mCost = cost;
-  }
-
-  GeomPairContainer() {
-    mGeomIdx = mVertexIdx1 = mVertexIdx2 = 0;
-    mCost = 0;
-  }
-
-  size_t hash() const {
-      size_t seed = 0;
-      boost::hash_combine(seed, mGeomIdx);
-      boost::hash_combine(seed, mVertexIdx1);
-      boost::hash_combine(seed, mVertexIdx2);
-
-      return seed;
-  }
-
-  bool operator==(const GeomPairContainer&other)const {
-    return mGeomIdx==other.mGeomIdx && mVertexIdx1==other.mVertexIdx1 && mVertexIdx2==other.mVertexIdx2;
-  }
-
-  bool operator<(const GeomPairContainer&other) const {
-
-    if (*this == other) return false;
-
-    if (mCost == other.mCost) {
-      if (mGeomIdx == other.mGeomIdx) {
-        if (mVertexIdx1 == other.mVertexIdx1) {
-          assert(mVertexIdx2 != other.mVertexIdx2);
-          return mVertexIdx2 < other.mVertexIdx2;
-        }
-
-        return mVertexIdx1 < other.mVertexIdx1;
-      }
-
-      return mGeomIdx < other.mGeomIdx;
+    bool operator==(const FaceKey& rhs) const {
+        return v[0] == rhs.v[0] && v[1] == rhs.v[1] && v[2] == rhs.v[2];
     }
 
-    return mCost < other.mCost;
-  }
-
-  class Hasher{
-  public:
-        size_t operator() (const GeomPairContainer& g) const {
-            return g.hash();
+    class Hasher {
+    public:
+        size_t operator() (const FaceKey& k) const {
+            size_t seed = 0;
+            boost::hash_combine(seed, k.v[0]);
+            boost::hash_combine(seed, k.v[1]);
+            boost::hash_combine(seed, k.v[2]);
+            return seed;
         }
-  };
-
+    };
 };
-bool custom_isnan (double data) {
-#ifdef _WIN32
-    return _isnan(data);
-#else
-    return std::isnan(data);
-#endif
-}
-
-void computeCosts(Mesh::MeshdataPtr agg_mesh,
-                  std::tr1::unordered_map<uint32, std::tr1::unordered_map<Vector3f, Matrix4x4d, Vector3f::Hasher> >& submeshPositionQs,
-                  std::set<GeomPairContainer>& vertexPairs,
-                  std::tr1::unordered_map<GeomPairContainer, float64, GeomPairContainer::Hasher>& pairPriorities,
-                  std::tr1::unordered_map<uint32, std::tr1::unordered_map<uint32, std::tr1::unordered_set<uint32> > >& submeshNeighborVertices,
-                  std::tr1::unordered_map<uint32, std::tr1::unordered_map<uint32, std::vector<uint32> > >& vertexToFacesMap
-                 )
-{  
-  for (uint32 i = 0;  i < agg_mesh->geometry.size(); i++) {
 
-    SubMeshGeometry& curGeometry = agg_mesh->geometry[i];
-    std::tr1::unordered_map<Vector3f, Matrix4x4d, Vector3f::Hasher>& positionQs = submeshPositionQs[i];
-    std::tr1::unordered_map<uint32, std::tr1::unordered_set<uint32> >& neighborVertices = submeshNeighborVertices[i];
-    std::tr1::unordered_map<uint32, std::vector<uint32> >& submeshVertexToFacesMap = vertexToFacesMap[i];
+// A single edge collapse, moving source onto target.
+struct Collapse {
+    Collapse(uint32 s, uint32 t, double c, uint32 removed)
+     : source(s), target(t), cost(c), facesRemoved(removed)
+    {}
 
-    for (uint32 j = 0; j < curGeometry.positions.size(); j++) {
-      
-      if (neighborVertices.find(j) == neighborVertices.end()) continue;
+    uint32 source;
+    uint32 target;
+    double cost;
+    uint32 facesRemoved;
+};
 
-      bool j_edgeVertex = (submeshVertexToFacesMap[j].size() == 1);
+/** Simplification state for one SubMeshGeometry. Analysis only reads the
+ *  Meshdata and writes to its own SubMeshSimplification, so submeshes can be
+ *  processed on separate threads.
+ */
+struct SubMeshSimplification {
+    SubMeshSimplification()
+     : changed(false)
+    {}
+
+    // Transforms of every instance of this submesh, collected up front.
+    std::vector<Matrix4x4d> instanceTransforms;
+
+    // Maps each vertex to the first vertex with the same position, so vertices
+    // split only by their attributes are simplified as one.
+    std::vector<uint32> weld;
+    // Welded, non-degenerate, unique triangles (3 indices each), and the
+    // primitive each came from.
+    std::vector<uint32> faces;
+    std::vector<uint32> facePrimitive;
+    // Whether welding or removing duplicate faces changed the geometry, in
+    // which case it must be rebuilt even if no collapses are applied.
+    bool changed;
+
+    // The full collapse sequence for this submesh, in the order performed.
+    std::vector<Collapse> collapses;
+};
 
-      const Vector3f& position = curGeometry.positions[j];
+void weldSubMesh(const SubMeshGeometry& geo, SubMeshSimplification* sms) {
+    uint32 nverts = geo.positions.size();
 
-      Matrix4x4d Q = positionQs[position];      
+    sms->weld.resize(nverts);
+    std::tr1::unordered_map<Vector3f, uint32, Vector3f::Hasher> firstPosition;
+    for(uint32 j = 0; j < nverts; j++)
+        sms->weld[j] = firstPosition.insert(std::make_pair(geo.positions[j], j)).first->second;
 
-      std::tr1::unordered_set<uint32>& neighbors = neighborVertices[j];
+    std::tr1::unordered_set<FaceKey, FaceKey::Hasher> seenFaces;
+    for(uint32 p = 0; p < geo.primitives.size(); p++) {
+        const SubMeshGeometry::Primitive& prim = geo.primitives[p];
+        if (prim.primitiveType != SubMeshGeometry::Primitive::TRIANGLES) continue;
 
-      for (std::tr1::unordered_set<uint32>::iterator neighbor_it = neighbors.begin(); neighbor_it != neighbors.end(); neighbor_it++) {
-        uint32 neighbor = *neighbor_it;
+        for(uint32 k = 0; k+2 < prim.indices.size(); k+=3) {
+            uint32 idx = prim.indices[k], idx2 = prim.indices[k+1], idx3 = prim.indices[k+2];
+            if (idx >= nverts || idx2 >= nverts || idx3 >= nverts) {
+                sms->changed = true;
+                continue;
+            }
 
-        bool neighbor_edgeVertex = (submeshVertexToFacesMap[neighbor].size() == 1);
+            uint32 v1 = sms->weld[idx], v2 = sms->weld[idx2], v3 = sms->weld[idx3];
+            if (v1 != idx || v2 != idx2 || v3 != idx3)
+                sms->changed = true;
 
-        float64 cost = 0;
-        if (false/*j_edgeVertex || neighbor_edgeVertex*/) {
-          cost = 1e15;
-        }
-        else {
-          const Vector3f& neighborPosition = curGeometry.positions[neighbor];
-          Matrix4x4d Q = positionQs[position] + positionQs[neighborPosition];
-          Vector4d vbar4f (neighborPosition.x, neighborPosition.y, neighborPosition.z, 1);
-          cost = (cost < 0.0) ? -cost : cost;          
-        }
+            if (v1 == v2 || v1 == v3 || v2 == v3 ||
+                !seenFaces.insert(FaceKey(v1, v2, v3)).second)
+            {
+                sms->changed = true;
+                continue;
+            }
 
-        GeomPairContainer gpc(i, j, neighbor);
-
-        //Insert this cost as the cost of the edge if the edge hasnt been inserted 
-        //before or if this cost is less than the previously computed cost.
-        if (pairPriorities[gpc] == -1 || (pairPriorities[gpc] != -1 && cost < pairPriorities[gpc]) ) { 
-          gpc.mCost = pairPriorities[gpc];
-          vertexPairs.erase(gpc);
-          
-          gpc.mCost = cost;
-          pairPriorities[gpc] = gpc.mCost;
-          vertexPairs.insert(gpc);
+            sms->faces.push_back(v1);
+            sms->faces.push_back(v2);
+            sms->faces.push_back(v3);
+            sms->facePrimitive.push_back(p);
         }
-      }
     }
-  }
 }
 
-inline uint32  findMappedVertex(std::tr1::unordered_map<int, int>& vertexMapping, uint32 idx) {
-  uint32 startIdx = idx;
-
-  int countIter = 0;
-  while (vertexMapping.find(idx) != vertexMapping.end()) {
-    countIter++;
-    if ((int)idx == vertexMapping[idx]) {
-      break;
+/** Runs edge collapses on a single submesh until no edges remain, recording
+ *  the sequence. Adjacency is kept in flat per-vertex lists of face and edge
+ *  indices and candidate edges live in an IndexedHeap.
+ */
+class SubMeshCollapser {
+public:
+    SubMeshCollapser(const SubMeshGeometry& geo, SubMeshSimplification* sms)
+     : mPositions(geo.positions),
+       mSMS(sms),
+       mFaces(sms->faces),
+       mFaceValid(sms->faces.size() / 3, true),
+       mQuadrics(geo.positions.size()),
+       mVertexFaces(geo.positions.size()),
+       mVertexEdges(geo.positions.size()),
+       mNeighborEdge(geo.positions.size(), InvalidIndex)
+    {}
+
+    void run() {
+        if (mFaceValid.empty() || mSMS->instanceTransforms.empty()) return;
+
+        computeQuadrics();
+        buildAdjacency();
+
+        mHeap.reset(mEdges.size());
+        for(uint32 eid = 0; eid < mEdges.size(); eid++)
+            mHeap.push(eid, evaluate(eid));
+
+        while(!mHeap.empty()) {
+            uint32 eid = mHeap.pop();
+            Edge& edge = mEdges[eid];
+            edge.alive = false;
+            uint32 target = edge.target;
+            uint32 source = other(edge, target);
+            uint32 removed = collapse(source, target);
+            mSMS->collapses.push_back(Collapse(source, target, mHeap.key(eid), removed));
+        }
     }
-    idx = vertexMapping[idx];
-  }
-
-  if (countIter > 1) {
-    vertexMapping[startIdx] = idx;
-  }
 
-  return idx;
-}
-
-void computeCosts(Mesh::MeshdataPtr agg_mesh, uint32 geomIdx, uint32 sourcePositionIdx, uint32 targetPositionIdx,
-                  std::tr1::unordered_map<int, int>& vertexMapping,
-                  std::tr1::unordered_map<uint32, std::tr1::unordered_map<Vector3f, Matrix4x4d, Vector3f::Hasher> >& submeshPositionQs,
-                  std::set<GeomPairContainer>& vertexPairs,
-                  std::tr1::unordered_map<GeomPairContainer, float64, GeomPairContainer::Hasher>& pairPriorities,
-                  std::tr1::unordered_map<uint32, std::tr1::unordered_map<uint32, std::tr1::unordered_set<uint32> > >& submeshNeighborVertices,
-                  std::tr1::unordered_map<uint32, std::tr1::unordered_map<uint32, std::vector<uint32> > >& vertexToFacesMap)
-{
-  SubMeshGeometry& curGeometry = agg_mesh->geometry[geomIdx];
-  std::tr1::unordered_map<Vector3f, Matrix4x4d, Vector3f::Hasher>& positionQs = submeshPositionQs[geomIdx];
-  std::tr1::unordered_map<uint32, std::tr1::unordered_set<uint32> >& neighborVertices = submeshNeighborVertices[geomIdx];
-  std::tr1::unordered_map<uint32, std::vector<uint32> >& submeshVertexToFacesMap = vertexToFacesMap[geomIdx];
-
-  targetPositionIdx = findMappedVertex(vertexMapping, targetPositionIdx);
-
-  const Vector3f& position = curGeometry.positions[targetPositionIdx];
-
-  std::tr1::unordered_set<uint32>& neighbors = neighborVertices[targetPositionIdx];
-
-  bool is_edgeVertex = (submeshVertexToFacesMap[geomIdx].size() == 1);
-
-  for (std::tr1::unordered_set<uint32>::iterator neighbor_it = neighbors.begin(); neighbor_it != neighbors.end(); neighbor_it++) {   
-    uint32 neighborIdx = *neighbor_it;    
-
-    neighborIdx = findMappedVertex(vertexMapping, neighborIdx);
-
-    if (neighborIdx == targetPositionIdx) continue;
-
-    uint32 idx1 = targetPositionIdx;
-    uint32 idx2 = neighborIdx;
-
-    bool neighbor_edgeVertex = (submeshVertexToFacesMap[neighborIdx].size() == 1);
-
-    float64 cost = 0;    
-    
-    const Vector3f& neighborPosition = curGeometry.positions[neighborIdx];
-
-    Matrix4x4d Q = positionQs[position] + positionQs[neighborPosition];    
-    
-    Vector4d vbar4f (neighborPosition.x, neighborPosition.y, neighborPosition.z, 1);
-    float64 cost1 = (vbar4f.dot(  Q * vbar4f )) ;
-    cost1 = (cost1 < 0.0) ? -cost1 : cost1;
-
-    vbar4f = Vector4d (position.x, position.y, position.z, 1);
-    float64 cost2 = (vbar4f.dot(  Q * vbar4f )) ;
-    cost2 = (cost2 < 0.0) ? -cost2 : cost2;
-
-    //Use the lower cost to determine the order of the pair (the second
-    //vertex in the pair will be the target vertex for the edge collapse).
-    cost = (cost1 < cost2) ? cost1 : cost2;    
-    if (cost == cost2) {
-      //If the second cost is lower, 
-      //switch neighborIdx and targetPositionIdx
-      uint32 tempIdx = idx1;
-      idx1 = idx2;
-      idx2 = tempIdx;
-    }
-      
-    if (cost == 0) {                
-      /*Deal properly with the case where all faces adjacent to a vertex are coplanar.
-        While this face may have coplanar vertices in this instance, these vertices
-        might connect with other faces in other instances. */
-    }
-
-    //Remove the previous vertex pair that existed before one vertex collapsed.
-    GeomPairContainer gpc(geomIdx, sourcePositionIdx, neighborIdx);
-    gpc.mCost = pairPriorities[gpc];
-    vertexPairs.erase(gpc);
-    
-    //Insert this vertex pair with the new cost.
-    gpc = GeomPairContainer(geomIdx, idx1, idx2);
-    gpc.mCost = pairPriorities[gpc];
-    vertexPairs.erase(gpc);                 
-    
-    gpc.mCost = cost;    
-    pairPriorities[gpc] = gpc.mCost;
-    vertexPairs.insert(gpc);    
-  }
-}
-
-void MeshSimplifier::simplify(Mesh::MeshdataPtr agg_mesh, int32 numFacesLeft) {
-  std::tr1::unordered_map<uint32, uint32> submeshInstanceCount;
-
-  int countFaces = 0;
-  uint32 geoinst_idx;
-  Matrix4x4f geoinst_pos_xform;
-  Meshdata::GeometryInstanceIterator geoinst_it = agg_mesh->getGeometryInstanceIterator();
-
-  std::set<GeomPairContainer> vertexPairs;
-  std::tr1::unordered_map<GeomPairContainer, float64, GeomPairContainer::Hasher> pairPriorities;
-
-  std::tr1::unordered_map<uint32, std::tr1::unordered_map<Vector3f, Matrix4x4d, Vector3f::Hasher> > submeshPositionQs;
-
-  std::tr1::unordered_map<uint32, std::tr1::unordered_map<uint32, std::tr1::unordered_set<uint32> > > submeshNeighborVertices;
+private:
+    struct Edge {
+        Edge(uint32 a, uint32 b)
+         : v1(a), v2(b), target(a), alive(true)
+        {}
 
-  bool meshChangedDuringPreprocess = false;
+        uint32 v1, v2;
+        // The endpoint whose position is kept by collapsing this edge.
+        uint32 target;
+        bool alive;
+    };
 
-  /* Make every index in prims specification point to the earliest occurrence of the corresponding position vector */
-  for (uint32 i = 0; i < agg_mesh->geometry.size(); i++) {
-    SubMeshGeometry& curGeometry = agg_mesh->geometry[i];
-
-    std::tr1::unordered_map<Vector3f, uint32, Vector3f::Hasher> firstPositionMap;
+    static uint32 other(const Edge& e, uint32 v) {
+        return (e.v1 == v) ? e.v2 : e.v1;
+    }
 
-    std::tr1::unordered_set<uint32> deletedIndices;
-    for (uint32 j = 0; j < curGeometry.primitives.size(); j++) {
-      SubMeshGeometry::Primitive& primitive = curGeometry.primitives[j];
+    // Accumulates face quadrics over all instances. Planes are computed in
+    // each instance's coordinate space so scaled instances are weighted
+    // correctly, then brought back to mesh space: with p' = T^T p,
+    // T^T (p p^T) T = p' p'^T.
+    void computeQuadrics() {
+        uint32 nfaces = mFaceValid.size();
+        for(uint32 ti = 0; ti < mSMS->instanceTransforms.size(); ti++) {
+            const Matrix4x4d& T = mSMS->instanceTransforms[ti];
+            for(uint32 f = 0; f < nfaces; f++) {
+                const uint32* fv = &mFaces[3*f];
+                const Vector3f& o1 = mPositions[fv[0]];
+                const Vector3f& o2 = mPositions[fv[1]];
+                const Vector3f& o3 = mPositions[fv[2]];
+                Vector3d pos1 = T * Vector3d(o1.x, o1.y, o1.z);
+                Vector3d pos2 = T * Vector3d(o2.x, o2.y, o2.z);
+                Vector3d pos3 = T * Vector3d(o3.x, o3.y, o3.z);
+
+                Vector3d normal = (pos2 - pos1).cross(pos3 - pos1);
+                double len = normal.length();
+                if (len == 0) continue;
+                double face_area = len * 0.5;
+                normal /= len;
+                double D = -(normal.dot(pos1));
+
+                double A = T(0,0)*normal.x + T(1,0)*normal.y + T(2,0)*normal.z + T(3,0)*D;
+                double B = T(0,1)*normal.x + T(1,1)*normal.y + T(2,1)*normal.z + T(3,1)*D;
+                double C = T(0,2)*normal.x + T(1,2)*normal.y + T(2,2)*normal.z + T(3,2)*D;
+                double Dp = T(0,3)*normal.x + T(1,3)*normal.y + T(2,3)*normal.z + T(3,3)*D;
+
+                for(int c = 0; c < 3; c++)
+                    mQuadrics[fv[c]].addPlane(A, B, C, Dp, face_area);
+            }
+        }
+    }
 
-      for (uint32 k = 0; k+2 < primitive.indices.size(); k+=3) {
-        unsigned short idx = primitive.indices[k];
-        unsigned short idx2 = primitive.indices[k+1];
-        unsigned short idx3 = primitive.indices[k+2];
+    void addEdge(uint32 a, uint32 b) {
+        std::vector<uint32>& edges_a = mVertexEdges[a];
+        for(uint32 i = 0; i < edges_a.size(); i++)
+            if (other(mEdges[edges_a[i]], a) == b) return;
 
-        Vector3f& pos1 = curGeometry.positions[idx];
-        Vector3f& pos2 = curGeometry.positions[idx2];
-        Vector3f& pos3 = curGeometry.positions[idx3];
+        uint32 eid = mEdges.size();
+        mEdges.push_back(Edge(a, b));
+        edges_a.push_back(eid);
+        mVertexEdges[b].push_back(eid);
+    }
 
-        if (firstPositionMap.find(pos1) == firstPositionMap.end()) {
-          firstPositionMap[pos1] = idx;
+    void buildAdjacency() {
+        for(uint32 f = 0; f < mFaceValid.size(); f++) {
+            const uint32* fv = &mFaces[3*f];
+            for(int c = 0; c < 3; c++)
+                mVertexFaces[fv[c]].push_back(f);
+            addEdge(fv[0], fv[1]);
+            addEdge(fv[1], fv[2]);
+            addEdge(fv[0], fv[2]);
         }
-        else {
-          if (idx != firstPositionMap[pos1]) {
-            primitive.indices[k] = firstPositionMap[pos1];
-            deletedIndices.insert(idx);
-          }
+    }
+
+    // Computes the cost of collapsing the edge and chooses the endpoint to
+    // keep, which is whichever has the lower error under the combined quadric.
+    double evaluate(uint32 eid) {
+        Edge& edge = mEdges[eid];
+        Quadric q = mQuadrics[edge.v1];
+        q += mQuadrics[edge.v2];
+        const Vector3f& p1 = mPositions[edge.v1];
+        const Vector3f& p2 = mPositions[edge.v2];
+        double cost1 = fabs(q.evaluate(p1.x, p1.y, p1.z));
+        double cost2 = fabs(q.evaluate(p2.x, p2.y, p2.z));
+        if (cost1 <= cost2) {
+            edge.target = edge.v1;
+            return cost1;
         }
+        edge.target = edge.v2;
+        return cost2;
+    }
 
-        if (firstPositionMap.find(pos2) == firstPositionMap.end()) {
-          firstPositionMap[pos2] = idx2;
+    // Collapses source onto target, returning the number of faces which
+    // became degenerate.
+    uint32 collapse(uint32 source, uint32 target) {
+        uint32 removed = 0;
+
+        // Faces: those using both vertices disappear, the rest move to target.
+        std::vector<uint32>& source_faces = mVertexFaces[source];
+        std::vector<uint32>& target_faces = mVertexFaces[target];
+        for(uint32 i = 0; i < source_faces.size(); i++) {
+            uint32 f = source_faces[i];
+            if (!mFaceValid[f]) continue;
+            uint32* fv = &mFaces[3*f];
+            if (fv[0] == target || fv[1] == target || fv[2] == target) {
+                mFaceValid[f] = false;
+                removed++;
+                continue;
+            }
+            for(int c = 0; c < 3; c++)
+                if (fv[c] == source) fv[c] = target;
+            target_faces.push_back(f);
         }
-        else {
-           if (idx2 != firstPositionMap[pos2]) {
-             primitive.indices[k+1] = firstPositionMap[pos2];
-             deletedIndices.insert(idx2);
-           }
+        std::vector<uint32>().swap(source_faces);
+        uint32 nfaces = 0;
+        for(uint32 i = 0; i < target_faces.size(); i++)
+            if (mFaceValid[target_faces[i]]) target_faces[nfaces++] = target_faces[i];
+        target_faces.resize(nfaces);
+
+        mQuadrics[target] += mQuadrics[source];
+
+        // Edges: move source's edges to target, dropping any which would
+        // duplicate an existing edge of target.
+        std::vector<uint32>& source_edges = mVertexEdges[source];
+        std::vector<uint32>& target_edges = mVertexEdges[target];
+        for(uint32 i = 0; i < target_edges.size(); i++) {
+            const Edge& edge = mEdges[target_edges[i]];
+            if (edge.alive) mNeighborEdge[other(edge, target)] = target_edges[i];
         }
-
-        if (firstPositionMap.find(pos3) == firstPositionMap.end()) {
-          firstPositionMap[pos3] = idx3;
+        for(uint32 i = 0; i < source_edges.size(); i++) {
+            uint32 eid = source_edges[i];
+            Edge& edge = mEdges[eid];
+            if (!edge.alive) continue;
+            uint32 neighbor = other(edge, source);
+            if (neighbor == target || mNeighborEdge[neighbor] != InvalidIndex) {
+                edge.alive = false;
+                mHeap.remove(eid);
+                continue;
+            }
+            if (edge.v1 == source) edge.v1 = target;
+            else edge.v2 = target;
+            target_edges.push_back(eid);
+            mNeighborEdge[neighbor] = eid;
         }
-        else {
-          if (idx3 != firstPositionMap[pos3]) {
-            primitive.indices[k+2] = firstPositionMap[pos3];
-            deletedIndices.insert(idx3);
-          }
+        std::vector<uint32>().swap(source_edges);
+
+        // The target's quadric changed, so all its edges need new costs.
+        uint32 nedges = 0;
+        for(uint32 i = 0; i < target_edges.size(); i++) {
+            uint32 eid = target_edges[i];
+            if (!mEdges[eid].alive) continue;
+            target_edges[nedges++] = eid;
+            mNeighborEdge[other(mEdges[eid], target)] = InvalidIndex;
+            mHeap.update(eid, evaluate(eid));
         }
-      }
-    }
+        target_edges.resize(nedges);
 
-    for (std::tr1::unordered_set<uint32>::iterator it = deletedIndices.begin();
-          it != deletedIndices.end(); it++)
-    {
-      curGeometry.positions[*it] = SIMPLIFIER_INVALID_VECTOR;
+        return removed;
     }
-		
-    if (deletedIndices.size() > 0) {
-	meshChangedDuringPreprocess = true;
-    }
-  }
-
-  std::tr1::unordered_map<uint32, std::vector<IndexedFaceContainer> > geomFacesList;
-  std::tr1::unordered_map<uint32, std::tr1::unordered_map<uint32, std::vector<uint32> > > vertexToFacesMap;
-
-  /* Identify the non-unique faces in the geometry. Insert the vertex pairs */
-  for (uint32 i = 0; i < agg_mesh->geometry.size(); i++) {
-    SubMeshGeometry& curGeometry = agg_mesh->geometry[i];
-
-    std::tr1::unordered_map<uint32, std::tr1::unordered_set<uint32> >& neighborVertices = submeshNeighborVertices[i];
-    std::tr1::unordered_map<uint32, std::vector<uint32> >& geomsVertexToFacesMap = vertexToFacesMap[i];
-    std::vector<IndexedFaceContainer>& facesList = geomFacesList[i];
-
-    std::tr1::unordered_map<Vector3f, Matrix4x4d, Vector3f::Hasher>& positionQs = submeshPositionQs[i];
 
-    std::tr1::unordered_set<FaceContainer, FaceContainer::Hasher> duplicateFaces;
-    for (uint32 j = 0; j < curGeometry.primitives.size(); j++) {
-        SubMeshGeometry::Primitive& primitive = curGeometry.primitives[j];
-
-        for (uint32 k = 0; k+2 < primitive.indices.size(); k+=3) {
-          unsigned short idx = primitive.indices[k];
-          unsigned short idx2 = primitive.indices[k+1];
-          unsigned short idx3 = primitive.indices[k+2];
-
-          if (idx == idx2 || idx == idx3 || idx2 == idx3)
-            continue;
-
-          Vector3f& pos1 = curGeometry.positions[idx];
-          Vector3f& pos2 = curGeometry.positions[idx2];
-          Vector3f& pos3 = curGeometry.positions[idx3];
-
-          FaceContainer origface(pos1, pos2, pos3);
-
-          if (duplicateFaces.find(origface) != duplicateFaces.end()) {
-            primitive.indices[k] = USHRT_MAX;
-            primitive.indices[k+1] = USHRT_MAX;
-            primitive.indices[k+2] = USHRT_MAX;
+    const std::vector<Vector3f>& mPositions;
+    SubMeshSimplification* mSMS;
+
+    std::vector<uint32> mFaces;
+    std::vector<bool> mFaceValid;
+    std::vector<Quadric> mQuadrics;
+    std::vector< std::vector<uint32> > mVertexFaces;
+    std::vector<Edge> mEdges;
+    std::vector< std::vector<uint32> > mVertexEdges;
+    // Scratch space for collapse(), mapping target's neighbors to their edges.
+    std::vector<uint32> mNeighborEdge;
+    IndexedHeap mHeap;
+};
 
-            continue;
-          }
+typedef std::tr1::function<void(uint32)> IndexedTask;
+// Runs task(i) for each i in [0, count), possibly in parallel.
+typedef std::tr1::function<void(uint32 count, const IndexedTask& task)> ParallelFor;
 
-          GeomPairContainer gpc1(i, idx, idx2, -1);
-          GeomPairContainer gpc2(i, idx2, idx3, -1);
-          GeomPairContainer gpc3(i, idx, idx3, -1);
+void weldSubMeshTask(const Meshdata* md, std::vector<SubMeshSimplification>* subs, uint32 geo_idx) {
+    weldSubMesh(md->geometry[geo_idx], &(*subs)[geo_idx]);
+}
 
-          neighborVertices[idx].insert(idx2);
-          neighborVertices[idx].insert(idx3);
-          neighborVertices[idx2].insert(idx);
-          neighborVertices[idx2].insert(idx3);
-          neighborVertices[idx3].insert(idx);
-          neighborVertices[idx3].insert(idx2);
+void collapseSubMeshTask(const Meshdata* md, std::vector<SubMeshSimplification>* subs, const std::vector<uint32>* order, uint32 i) {
+    uint32 geo_idx = (*order)[i];
+    SubMeshCollapser(md->geometry[geo_idx], &(*subs)[geo_idx]).run();
+}
 
-          
-          vertexPairs.insert(gpc1);
-          pairPriorities[gpc1] = -1;
+// Collects instances and welds every submesh. Returns the number of instanced
+// faces.
+int64 prepareMesh(const Meshdata& md, const ParallelFor& parallel_for, std::vector<SubMeshSimplification>* subs) {
+    subs->clear();
+    subs->resize(md.geometry.size());
+
+    uint32 geoinst_idx;
+    Matrix4x4f geoinst_pos_xform;
+    Meshdata::GeometryInstanceIterator geoinst_it = md.getGeometryInstanceIterator();
+    while( geoinst_it.next(&geoinst_idx, &geoinst_pos_xform) ) {
+        uint32 geo_idx = md.instances[geoinst_idx].geometryIndex;
+        Matrix4x4d transform;
+        for (int row=0; row<4; row++)
+            for (int col=0; col<4; col++)
+                transform(row,col) = geoinst_pos_xform(row,col);
+        (*subs)[geo_idx].instanceTransforms.push_back(transform);
+    }
 
-          vertexPairs.insert(gpc2);
-          pairPriorities[gpc2] = -1;
+    parallel_for(
+        md.geometry.size(),
+        std::tr1::bind(&weldSubMeshTask, &md, subs, std::tr1::placeholders::_1)
+    );
 
-          vertexPairs.insert(gpc3);
-          pairPriorities[gpc3] = -1;
+    int64 countFaces = 0;
+    for(uint32 i = 0; i < subs->size(); i++)
+        countFaces += (int64)((*subs)[i].faces.size() / 3) * (*subs)[i].instanceTransforms.size();
+    return countFaces;
+}
 
-          duplicateFaces.insert(origface);
+// Computes the full collapse sequence for every submesh prepared by
+// prepareMesh.
+void collapseMesh(const Meshdata& md, const ParallelFor& parallel_for, std::vector<SubMeshSimplification>* subs) {
+    // Handle the largest submeshes first so they don't end up running alone
+    // at the end.
+    std::vector< std::pair<size_t, uint32> > by_size;
+    for(uint32 i = 0; i < subs->size(); i++)
+        by_size.push_back(std::make_pair((*subs)[i].faces.size(), i));
+    std::sort(by_size.rbegin(), by_size.rend());
+    std::vector<uint32> order;
+    for(uint32 i = 0; i < by_size.size(); i++)
+        order.push_back(by_size[i].second);
+
+    parallel_for(
+        order.size(),
+        std::tr1::bind(&collapseSubMeshTask, &md, subs, &order, std::tr1::placeholders::_1)
+    );
+}
 
-          IndexedFaceContainer ifc(idx, idx2, idx3);
-          uint32 faceIndex = facesList.size();
-          facesList.push_back(ifc);
+// Whether welding changed any submesh, so it needs rebuilding even without
+// collapses.
+bool anyChanged(const std::vector<SubMeshSimplification>& subs) {
+    for(uint32 i = 0; i < subs.size(); i++)
+        if (subs[i].changed) return true;
+    return false;
+}
 
-          geomsVertexToFacesMap[idx].push_back(faceIndex);
-          geomsVertexToFacesMap[idx2].push_back(faceIndex);
-          geomsVertexToFacesMap[idx3].push_back(faceIndex);
+/** Merges the per-submesh collapse sequences by cost and works out how many
+ *  collapses to apply to each submesh to meet each target. Costs within a
+ *  sequence aren't strictly increasing, so each is clamped to the maximum seen
+ *  so far in its sequence, which keeps every sequence's order intact.
+ */
+void chooseCollapses(const std::vector<SubMeshSimplification>& subs, int64 countFaces,
+    const std::vector<int32>& targets, std::vector< std::vector<uint32> >* counts_out)
+{
+    // Visit the targets from largest to smallest, since each one only
+    // continues the merge where the previous one stopped.
+    std::vector< std::pair<int32, uint32> > target_order;
+    for(uint32 i = 0; i < targets.size(); i++)
+        target_order.push_back(std::make_pair(targets[i], i));
+    std::sort(target_order.rbegin(), target_order.rend());
+
+    typedef std::pair<double, uint32> QueueEntry;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > queue;
+    std::vector<uint32> next(subs.size(), 0);
+    std::vector<double> lastCost(subs.size(), 0);
+    for(uint32 g = 0; g < subs.size(); g++)
+        if (!subs[g].collapses.empty())
+            queue.push(QueueEntry(subs[g].collapses[0].cost, g));
+
+    counts_out->resize(targets.size());
+    for(uint32 ti = 0; ti < target_order.size(); ti++) {
+        while(countFaces > target_order[ti].first && !queue.empty()) {
+            QueueEntry top = queue.top();
+            queue.pop();
+            uint32 g = top.second;
+            const SubMeshSimplification& sms = subs[g];
+            countFaces -= (int64)sms.collapses[next[g]].facesRemoved * sms.instanceTransforms.size();
+            lastCost[g] = top.first;
+            next[g]++;
+            if (next[g] < sms.collapses.size())
+                queue.push(QueueEntry(std::max(lastCost[g], sms.collapses[next[g]].cost), g));
         }
+        (*counts_out)[target_order[ti].second] = next;
     }
-  }
-
+}
 
-  //Find the list of instances associated with each submesh
-  countFaces = 0;
-  
-  while( geoinst_it.next(&geoinst_idx, &geoinst_pos_xform) ) {
-    const GeometryInstance& geomInstance = agg_mesh->instances[geoinst_idx];
-    Matrix4x4f geoinst_pos_xform_transpose = geoinst_pos_xform.transpose();
-    Matrix4x4d transform;
-    for (int row=0; row<4; row++) {
-      for (int col=0; col<4; col++) {
-        transform(row,col) = geoinst_pos_xform(row,col);        
-      }
+// Rebuilds a submesh with the first ncollapses collapses of its sequence
+// applied, dropping degenerate faces and unreferenced vertices. out may be the
+// same as orig.
+void rebuildSubMesh(const SubMeshGeometry& orig, const SubMeshSimplification& sms, uint32 ncollapses, SubMeshGeometry* out) {
+    uint32 nverts = orig.positions.size();
+
+    // Resolve where each vertex ended up.
+    std::vector<uint32> collapsedTo(nverts);
+    for(uint32 j = 0; j < nverts; j++)
+        collapsedTo[j] = j;
+    for(uint32 c = 0; c < ncollapses; c++)
+        collapsedTo[sms.collapses[c].source] = sms.collapses[c].target;
+    std::vector<uint32> mapped(nverts);
+    for(uint32 j = 0; j < nverts; j++) {
+        uint32 root = sms.weld[j];
+        while(collapsedTo[root] != root) root = collapsedTo[root];
+        // Path compression, so later lookups are short
+        uint32 v = sms.weld[j];
+        while(collapsedTo[v] != root) {
+            uint32 nxt = collapsedTo[v];
+            collapsedTo[v] = root;
+            v = nxt;
+        }
+        mapped[j] = root;
     }
-    
-
-    int geomIdx = geomInstance.geometryIndex;
-    submeshInstanceCount[geomIdx]++;
 
-    SubMeshGeometry& curGeometry = agg_mesh->geometry[geomIdx];
-    std::tr1::unordered_map<Vector3f, Matrix4x4d, Vector3f::Hasher>& positionQs = submeshPositionQs[geomIdx];
-
-    for (uint32 j = 0; j < curGeometry.primitives.size(); j++) {
-      SubMeshGeometry::Primitive& primitive = curGeometry.primitives[j];
-
-      for (uint32 k = 0; k+2 < primitive.indices.size(); k+=3) {
-        unsigned short idx = primitive.indices[k];
-        unsigned short idx2 = primitive.indices[k+1];
-        unsigned short idx3 = primitive.indices[k+2];
-
-        if (idx == USHRT_MAX && idx2 == USHRT_MAX && idx3 == USHRT_MAX) {
-          continue;
+    std::vector< std::vector<uint32> > prim_indices(orig.primitives.size());
+    std::vector<bool> used(nverts, false);
+    for(uint32 f = 0; f < sms.facePrimitive.size(); f++) {
+        uint32 v1 = mapped[sms.faces[3*f]], v2 = mapped[sms.faces[3*f+1]], v3 = mapped[sms.faces[3*f+2]];
+        if (v1 == v2 || v1 == v3 || v2 == v3) continue;
+        std::vector<uint32>& indices = prim_indices[sms.facePrimitive[f]];
+        indices.push_back(v1); indices.push_back(v2); indices.push_back(v3);
+        used[v1] = used[v2] = used[v3] = true;
+    }
+    // Other primitive types aren't simplified, but still need their indices
+    // remapped.
+    for(uint32 p = 0; p < orig.primitives.size(); p++) {
+        const SubMeshGeometry::Primitive& prim = orig.primitives[p];
+        if (prim.primitiveType == SubMeshGeometry::Primitive::TRIANGLES) continue;
+        for(uint32 k = 0; k < prim.indices.size(); k++) {
+            if (prim.indices[k] >= nverts) continue;
+            uint32 v = mapped[prim.indices[k]];
+            prim_indices[p].push_back(v);
+            used[v] = true;
         }
+    }
 
-        if (idx == idx2 || idx == idx3 || idx2 == idx3) continue;
-
-        Vector3d orig_pos1 (curGeometry.positions[idx].x, curGeometry.positions[idx].y,
-                           curGeometry.positions[idx].z);
-        Vector3d orig_pos2 (curGeometry.positions[idx2].x, curGeometry.positions[idx2].y,
-                            curGeometry.positions[idx2].z);
-        Vector3d orig_pos3 (curGeometry.positions[idx3].x, curGeometry.positions[idx3].y,
-                            curGeometry.positions[idx3].z);                
-
-        Vector3d pos1 = transform * orig_pos1;
-        Vector3d pos2 = transform * orig_pos2;
-        Vector3d pos3 = transform * orig_pos3;
-        
-    
-        Vector3d normal = (pos2 - pos1).cross(pos3-pos1);
-        normal = normal.normal();
-        float64 A = normal[0];
-        float64 B = normal[1];
-        float64 C = normal[2];
-        float64 D = -(normal.dot(pos1));
-
-        Matrix4x4d Qmat ( Vector4d(A*A, A*B, A*C, A*D),
-                          Vector4d(A*B, B*B, B*C, B*D),
-                          Vector4d(A*C, B*C, C*C, C*D),
-                          Vector4d(A*D, B*D, C*D, D*D), Matrix4x4d::ROWS() );         
-        
-        Qmat = transform.transpose() * Qmat * transform;
-
-        float64 face_area = (pos1-pos2).cross(pos1-pos3).length() * 0.5;
-        Qmat *= face_area;
-
-        positionQs[curGeometry.positions[idx]] += Qmat;
-        positionQs[curGeometry.positions[idx2]] += Qmat;
-        positionQs[curGeometry.positions[idx3]] += Qmat;        
-
-        countFaces++;
-      }
-    }
-  }
-
-  SIMPLIFY_LOG(detailed, "countFaces = " << countFaces);
-  SIMPLIFY_LOG(detailed, "numFacesLeft = " << numFacesLeft);
-  if (numFacesLeft < countFaces) {
-      SIMPLIFY_LOG(detailed, "numFacesLeft < countFaces: Simplification needed");
-      computeCosts(agg_mesh, submeshPositionQs, vertexPairs, pairPriorities, submeshNeighborVertices, vertexToFacesMap);
-  }
-  else if (!meshChangedDuringPreprocess) {
-    return;
-  }
-
-  std::tr1::unordered_map<int, std::tr1::unordered_map<int,int>  > vertexMapping1;
-
-  //Do the actual edge collapses.
-  while (countFaces > numFacesLeft && vertexPairs.size() > 0) {
-
-    GeomPairContainer top = *(vertexPairs.begin());
-
-    int i = top.mGeomIdx;
-    
-    uint32 targetIdx = top.mVertexIdx1;
-    uint32 sourceIdx = top.mVertexIdx2;
-
-    SubMeshGeometry& curGeometry = agg_mesh->geometry[i];
-    std::tr1::unordered_map<int, int>& vertexMapping = vertexMapping1[i];
-
-    targetIdx = findMappedVertex(vertexMapping, targetIdx);
-    sourceIdx = findMappedVertex(vertexMapping, sourceIdx);
-
-    Vector3f& pos1 = curGeometry.positions[targetIdx];
-    Vector3f& pos2 = curGeometry.positions[sourceIdx];
-
-    //Collapse vertex at sourceIdx into targetIdx.
-    if (targetIdx != sourceIdx && pos1 != pos2) {
-      vertexMapping[sourceIdx] = targetIdx;
-      
-      // FIXME: Can add a boundary edge check here by checking if countfaces reduced by 1 or more than 1.
-      // If 1, its a boundary edge.
-
-      std::tr1::unordered_map<uint32, std::vector<uint32> >& geomsVertexToFacesMap = vertexToFacesMap[i];
-      std::vector<uint32>& ifcVector = geomsVertexToFacesMap[sourceIdx];
-      std::vector<IndexedFaceContainer>& facesList = geomFacesList[i];
-
-      //count how many faces get invalidated and degenerate because of this edge collapse.
-      for (uint32 ifcVectorIdx = 0; ifcVectorIdx < ifcVector.size(); ifcVectorIdx++) {
-        uint32 faceIndex = ifcVector[ifcVectorIdx];
-        IndexedFaceContainer& ifc = facesList[faceIndex];
-
-        if (!ifc.valid) continue;
-
-        unsigned short vidx = ifc.idx1;
-        unsigned short vidx2 = ifc.idx2;
-        unsigned short vidx3 = ifc.idx3;
-
-        vidx = findMappedVertex(vertexMapping, vidx);
-        vidx2 = findMappedVertex(vertexMapping, vidx2);
-        vidx3 = findMappedVertex(vertexMapping, vidx3);
-
-        if (vidx == vidx2 || vidx2 == vidx3 || vidx == vidx3) {
-          //degenerate face; invalidate it.
-          countFaces -= submeshInstanceCount[i];
-          ifc.valid = false;
+    // Compact the remaining vertices, keeping their original order.
+    std::vector<uint32> newIndex(nverts, InvalidIndex);
+    std::vector<Vector3f> positions, normals, tangents;
+    std::vector<Vector4f> colors;
+    std::vector<SubMeshGeometry::TextureSet> texUVs(orig.texUVs.size());
+    for(uint32 k = 0; k < orig.texUVs.size(); k++)
+        texUVs[k].stride = orig.texUVs[k].stride;
+
+    for(uint32 j = 0; j < nverts; j++) {
+        if (!used[j]) continue;
+        newIndex[j] = positions.size();
+        positions.push_back(orig.positions[j]);
+        if (j < orig.normals.size())
+            normals.push_back(orig.normals[j]);
+        if (j < orig.tangents.size())
+            tangents.push_back(orig.tangents[j]);
+        if (j < orig.colors.size())
+            colors.push_back(orig.colors[j]);
+        for(uint32 k = 0; k < orig.texUVs.size(); k++) {
+            uint32 stride = orig.texUVs[k].stride;
+            if (stride*j+stride <= orig.texUVs[k].uvs.size())
+                texUVs[k].uvs.insert(texUVs[k].uvs.end(),
+                    orig.texUVs[k].uvs.begin() + stride*j, orig.texUVs[k].uvs.begin() + stride*j + stride);
         }
-        else {
-          //add this face to the neighbors of the target vertex.
-          geomsVertexToFacesMap[targetIdx].push_back(faceIndex);
-        }
-      }
-      //done invalidating degenerate faces.
-
-      //Now update the neighbors of the target vertex and its quadric matrix.
-      std::tr1::unordered_set<uint32>& neighborVertices2 =  submeshNeighborVertices[i][sourceIdx];
-      std::tr1::unordered_set<uint32>& neighborVertices1 =  submeshNeighborVertices[i][targetIdx];
-      std::tr1::unordered_map<Vector3f, Matrix4x4d, Vector3f::Hasher>& positionQs = submeshPositionQs[i];
-      for (std::tr1::unordered_set<uint32>::iterator neighbor_it = neighborVertices2.begin();
-           neighbor_it != neighborVertices2.end(); neighbor_it++)
-      {
-        uint32 neighborIdx = *neighbor_it;
-
-        if (neighborIdx != targetIdx) {
-          neighborVertices1.insert(neighborIdx);
-        }
-      }
-
-      positionQs[ pos1 ] += positionQs[pos2];
-
-      //Finally recompute the costs of the neighbors.
-      computeCosts(agg_mesh, i, sourceIdx, targetIdx, vertexMapping,
-                   submeshPositionQs, vertexPairs, pairPriorities, submeshNeighborVertices,
-                   vertexToFacesMap);
     }
 
-    vertexPairs.erase(top);
-    pairPriorities.erase(top);
-  }
-
+    if (out != &orig)
+        *out = orig;
+    out->positions.swap(positions);
+    out->normals.swap(normals);
+    out->tangents.swap(tangents);
+    out->colors.swap(colors);
+    out->texUVs.swap(texUVs);
+    for(uint32 p = 0; p < out->primitives.size(); p++) {
+        IndexList indices;
+        indices.reserve(prim_indices[p].size());
+        for(uint32 k = 0; k < prim_indices[p].size(); k++)
+            indices.push_back(newIndex[ prim_indices[p][k] ]);
+        out->primitives[p].indices = indices;
+    }
+}
 
-  //remove unused vertices; get new mapping from previous vertex indices to new vertex indices in vertexMapping2;
-  std::tr1::unordered_map<int, std::tr1::unordered_map<int,int> > vertexMapping2;
+void rebuildSubMeshTask(const Meshdata* orig, const std::vector<SubMeshSimplification>* subs,
+    const std::vector<uint32>* counts, Meshdata* out, uint32 geo_idx)
+{
+    const SubMeshSimplification& sms = (*subs)[geo_idx];
+    uint32 ncollapses = (*counts)[geo_idx];
+    if (ncollapses == 0 && !sms.changed) return;
+    rebuildSubMesh(orig->geometry[geo_idx], sms, ncollapses, &out->geometry[geo_idx]);
+}
 
-  //Remove vertices no longer used in the simplified mesh.
-  for (uint32 i = 0; i < agg_mesh->geometry.size(); i++) {
-    SubMeshGeometry& curGeometry = agg_mesh->geometry[i];
-    std::tr1::unordered_map<int, int>& vertexMapping = vertexMapping1[i];
-    std::tr1::unordered_map<int, int>& oldToNewMap = vertexMapping2[i];
+// Applies the chosen number of collapses to each submesh of orig, writing the
+// result into out. out must be orig or a copy of it.
+void rebuildMesh(const Meshdata& orig, const std::vector<SubMeshSimplification>& subs,
+    const std::vector<uint32>& counts, const ParallelFor& parallel_for, Meshdata* out)
+{
+    parallel_for(
+        orig.geometry.size(),
+        std::tr1::bind(&rebuildSubMeshTask, &orig, &subs, &counts, out, std::tr1::placeholders::_1)
+    );
+}
 
-    std::vector<Sirikata::Vector3f> positions;
-    std::vector<Sirikata::Vector3f> normals;
-    std::vector<SubMeshGeometry::TextureSet>texUVs;
+} // namespace
 
-    for (uint32 j = 0; j < curGeometry.texUVs.size(); j++) {
-      SubMeshGeometry::TextureSet ts;
-      ts.stride = curGeometry.texUVs[j].stride;
-      texUVs.push_back(ts);
+/** Threads that MeshSimplifier hands submeshes to. The calling thread always
+ *  works alongside them, so a pool for n threads starts n-1 of them.
+ */
+class MeshSimplifier::WorkerPool {
+public:
+    WorkerPool(uint32 num_threads)
+     : mTask(NULL),
+       mCount(0),
+       mNext(0),
+       mActive(0),
+       mGeneration(0),
+       mQuit(false)
+    {
+        for(uint32 t = 1; t < num_threads; t++)
+            mThreads.push_back(new Thread("MeshSimplifier Worker", std::tr1::bind(&WorkerPool::workerMain, this)));
     }
 
-    std::tr1::unordered_map<Vector3f, uint32, Vector3f::Hasher> vector3fSet;
-
-    for (uint32 j = 0 ; j < curGeometry.positions.size() ; j++) {
-      if (vertexMapping.find(j) == vertexMapping.end()) {
-
-        if (curGeometry.positions[j] == SIMPLIFIER_INVALID_VECTOR) {
-          continue;
+    ~WorkerPool() {
+        {
+            boost::mutex::scoped_lock lock(mMutex);
+            mQuit = true;
+        }
+        mWorkAvailable.notify_all();
+        for(uint32 t = 0; t < mThreads.size(); t++) {
+            mThreads[t]->join();
+            delete mThreads[t];
         }
+    }
 
-        if (vector3fSet.find(curGeometry.positions[j]) != vector3fSet.end()) {
-          oldToNewMap[j] = vector3fSet[ curGeometry.positions[j] ];
-          continue;
+    void parallelFor(uint32 count, const IndexedTask& task) {
+        // The pool only runs one loop at a time. If another thread is already
+        // using it, this one just does its own work rather than waiting.
+        boost::mutex::scoped_try_lock run_lock(mRunMutex);
+        if (count <= 1 || mThreads.empty() || !run_lock.owns_lock()) {
+            for(uint32 i = 0; i < count; i++)
+                task(i);
+            return;
         }
 
-        oldToNewMap[j] = positions.size();
+        {
+            boost::mutex::scoped_lock lock(mMutex);
+            mTask = &task;
+            mCount = count;
+            mNext = 0;
+            mActive = mThreads.size();
+            mGeneration++;
+        }
+        mWorkAvailable.notify_all();
 
-        vector3fSet[ curGeometry.positions[j] ] = positions.size();
+        runTasks();
 
-        positions.push_back(curGeometry.positions[j]);
+        boost::mutex::scoped_lock lock(mMutex);
+        while(mActive > 0)
+            mWorkDone.wait(lock);
+        mTask = NULL;
+    }
 
-        if (j < curGeometry.normals.size())
-          normals.push_back(curGeometry.normals[j]);
+private:
+    void workerMain() {
+        uint32 seen = 0;
+        while(true) {
+            {
+                boost::mutex::scoped_lock lock(mMutex);
+                while(!mQuit && mGeneration == seen)
+                    mWorkAvailable.wait(lock);
+                if (mQuit) return;
+                seen = mGeneration;
+            }
+            runTasks();
+            {
+                boost::mutex::scoped_lock lock(mMutex);
+                if (--mActive == 0)
+                    mWorkDone.notify_one();
+            }
+        }
+    }
 
-        for (uint32 k = 0; k < curGeometry.texUVs.size(); k++) {
-          unsigned int stride = curGeometry.texUVs[k].stride;
-          if (stride*j < curGeometry.texUVs[k].uvs.size()) {
-            uint32 idx = stride * j;
-            while ( idx < stride*j+stride){
-              texUVs[k].uvs.push_back(curGeometry.texUVs[k].uvs[idx]);
-              idx++;
+    void runTasks() {
+        while(true) {
+            uint32 i;
+            {
+                boost::mutex::scoped_lock lock(mMutex);
+                if (mNext >= mCount) return;
+                i = mNext++;
             }
-          }
+            (*mTask)(i);
         }
-      }
     }
 
-    curGeometry.positions = positions;
-    curGeometry.normals = normals;
-    curGeometry.texUVs = texUVs;
-  }
+    std::vector<Thread*> mThreads;
+    // Held by the thread currently running a loop on the pool
+    boost::mutex mRunMutex;
+
+    // Protects everything below
+    boost::mutex mMutex;
+    boost::condition_variable mWorkAvailable;
+    boost::condition_variable mWorkDone;
+    const IndexedTask* mTask;
+    uint32 mCount;
+    uint32 mNext;
+    // Workers which haven't finished the current loop
+    uint32 mActive;
+    // Incremented for each loop so workers can tell a new one has started
+    uint32 mGeneration;
+    bool mQuit;
+};
 
-  //Now adjust the primitives to point to the new indexes of the submesh geometry vertices.
-  std::tr1::unordered_map<uint32, std::tr1::unordered_map<uint32, std::vector<unsigned short> > > newIndices;
+MeshSimplifier::MeshSimplifier(uint32 num_threads)
+ : mNumThreads(0),
+   mWorkers(NULL)
+{
+    setNumThreads(num_threads);
+}
 
-  //First create new indices from all the non-degenerate faces.
-  for (uint32 i = 0; i < agg_mesh->geometry.size(); i++) {
-    SubMeshGeometry& curGeometry = agg_mesh->geometry[i];
+MeshSimplifier::~MeshSimplifier() {
+    delete mWorkers;
+}
 
-    std::tr1::unordered_map<int, int>& vertexMapping = vertexMapping1[i];
-    std::tr1::unordered_map<int, int>& oldToNewMap = vertexMapping2[i];
+void MeshSimplifier::setNumThreads(uint32 num_threads) {
+    if (num_threads == 0)
+        num_threads = Thread::hardware_concurrency();
+    num_threads = std::max(num_threads, (uint32)1);
+    if (num_threads == mNumThreads)
+        return;
+
+    mNumThreads = num_threads;
+    delete mWorkers;
+    mWorkers = NULL;
+    if (mNumThreads > 1)
+        mWorkers = new WorkerPool(mNumThreads);
+}
 
-    for (uint32 j = 0; j < curGeometry.primitives.size(); j++) {
-      if (curGeometry.primitives[j].primitiveType != SubMeshGeometry::Primitive::TRIANGLES) continue;
+namespace {
+void runSequentially(uint32 count, const IndexedTask& task) {
+    for(uint32 i = 0; i < count; i++)
+        task(i);
+}
+}
 
-      std::vector<unsigned short>& indices = newIndices[i][j];
+void MeshSimplifier::simplify(Mesh::MeshdataPtr agg_mesh, int32 numFacesLeft) {
+    ParallelFor parallel_for = &runSequentially;
+    if (mWorkers != NULL && agg_mesh->geometry.size() > 1)
+        parallel_for = std::tr1::bind(&WorkerPool::parallelFor, mWorkers, std::tr1::placeholders::_1, std::tr1::placeholders::_2);
 
-      for (uint32 k = 0; k+2 < curGeometry.primitives[j].indices.size(); k+=3) {
+    std::vector<SubMeshSimplification> subs;
+    int64 countFaces = prepareMesh(*agg_mesh, parallel_for, &subs);
 
-        unsigned short idx = curGeometry.primitives[j].indices[k];
-        unsigned short idx2 = curGeometry.primitives[j].indices[k+1];
-        unsigned short idx3 = curGeometry.primitives[j].indices[k+2];
+    SIMPLIFY_LOG(detailed, "countFaces = " << countFaces);
+    SIMPLIFY_LOG(detailed, "numFacesLeft = " << numFacesLeft);
 
-        if (idx == USHRT_MAX && idx2 == USHRT_MAX && idx3 == USHRT_MAX) {
-          continue;
-        }
+    std::vector< std::vector<uint32> > counts;
+    if (numFacesLeft < countFaces) {
+        SIMPLIFY_LOG(detailed, "numFacesLeft < countFaces: Simplification needed");
+        collapseMesh(*agg_mesh, parallel_for, &subs);
+        chooseCollapses(subs, countFaces, std::vector<int32>(1, numFacesLeft), &counts);
+    }
+    else if (!anyChanged(subs)) {
+        return;
+    }
+    else {
+        counts.push_back(std::vector<uint32>(subs.size(), 0));
+    }
 
-        idx = findMappedVertex(vertexMapping, idx);
-        idx2 = findMappedVertex(vertexMapping, idx2);
-        idx3 = findMappedVertex(vertexMapping, idx3);
+    rebuildMesh(*agg_mesh, subs, counts[0], parallel_for, agg_mesh.get());
+    agg_mesh->invalidateBVH();
+}
 
-        if (idx != idx2 && idx2 != idx3 && idx != idx3) {
-          indices.push_back(oldToNewMap[idx]);
-          indices.push_back(oldToNewMap[idx2]);
-          indices.push_back(oldToNewMap[idx3]);
-        }
-      }
-    }
-  }
+void MeshSimplifier::simplify(Mesh::MeshdataPtr agg_mesh, const std::vector<int32>& numFacesLeft, std::vector<Mesh::MeshdataPtr>* lods_out) {
+    ParallelFor parallel_for = &runSequentially;
+    if (mWorkers != NULL && agg_mesh->geometry.size() > 1)
+        parallel_for = std::tr1::bind(&WorkerPool::parallelFor, mWorkers, std::tr1::placeholders::_1, std::tr1::placeholders::_2);
+
+    std::vector<SubMeshSimplification> subs;
+    int64 countFaces = prepareMesh(*agg_mesh, parallel_for, &subs);
+
+    SIMPLIFY_LOG(detailed, "countFaces = " << countFaces << ", generating " << numFacesLeft.size() << " levels of detail");
+
+    // Collapses are only needed if some level is smaller than the input.
+    bool needCollapses = false;
+    for(uint32 i = 0; i < numFacesLeft.size(); i++)
+        needCollapses = needCollapses || (numFacesLeft[i] < countFaces);
+    if (needCollapses)
+        collapseMesh(*agg_mesh, parallel_for, &subs);
 
-  //Now set the new indices.
-  for (uint32 i = 0; i < agg_mesh->geometry.size(); i++) {
-    SubMeshGeometry& curGeometry = agg_mesh->geometry[i];
+    std::vector< std::vector<uint32> > counts;
+    chooseCollapses(subs, countFaces, numFacesLeft, &counts);
 
-    for (uint32 j = 0 ; j < curGeometry.primitives.size() ; j++) {
-      curGeometry.primitives[j].indices = newIndices[i][j];
+    lods_out->clear();
+    for(uint32 i = 0; i < numFacesLeft.size(); i++) {
+        MeshdataPtr lod(new Meshdata(*agg_mesh));
+        rebuildMesh(*agg_mesh, subs, counts[i], parallel_for, lod.get());
+        lods_out->push_back(lod);
     }
-  }
 }
 
 }
@@ -125,23 +125,38 @@ void SubMeshGeometry::append(const SubMeshGeometry& rhs, const Matrix4x4f& xform
         prim.primitiveType = orig_prim.primitiveType;
         prim.materialId = orig_prim.materialId;
 
-        prim.indices.resize( orig_prim.indices.size() );
-        for(uint32 ii = 0; ii < orig_prim.indices.size(); ii++)
-            prim.indices[ii] = orig_prim.indices[ii] + index_offset;
+        // Widens to 32-bit indices if the combined geometry needs it
+        prim.indices.append(orig_prim.indices, index_offset);
     }
 }
 
-void SubMeshGeometry::recomputeBounds() {
-    aabb = BoundingBox3f3f::null();
-    radius = 0.;
-    for(uint32 pi = 0; pi < primitives.size(); pi++) {
-        const Primitive& prim = primitives[pi];
-        for(uint32 ii = 0; ii < prim.indices.size(); ii++) {
-            aabb = (aabb == BoundingBox3f3f::null()) ? BoundingBox3f3f(positions[prim.indices[ii]], positions[prim.indices[ii]]) : aabb.merge(positions[prim.indices[ii]]);
-            double l = sqrt(positions[prim.indices[ii]].lengthSquared());
-            radius = std::max(radius, l);
-        }
+namespace {
+struct MarkReferencedOp {
+    MarkReferencedOp(std::vector<bool>& mask_) : mask(mask_) {}
+    template<typename IndexType>
+    void operator()(const IndexType* indices, size_t count) {
+        for(size_t ii = 0; ii < count; ii++)
+            mask[indices[ii]] = true;
     }
+    std::vector<bool>& mask;
+};
+}
+
+void SubMeshGeometry::getReferencedVertices(std::vector<bool>* mask_out) const {
+    mask_out->assign(positions.size(), false);
+    MarkReferencedOp op(*mask_out);
+    for(uint32 pi = 0; pi < primitives.size(); pi++)
+        ForEachIndexWidth(primitives[pi].indices, op);
+}
+
+void SubMeshGeometry::recomputeBounds() {
+    // Only referenced vertices count, so we extract those into packed arrays
+    // and then compute bounds in one pass over them.
+    std::vector<bool> referenced;
+    getReferencedVertices(&referenced);
+    PositionArrays verts;
+    verts.assign(positions, referenced);
+    verts.computeBounds(&aabb, &radius);
 }
 
 void GeometryInstance::computeTransformedBounds(MeshdataPtr parent, const Matrix4x4f& xform, BoundingBox3f3f* bounds_out, double* radius_out) const {
@@ -151,21 +166,14 @@ void GeometryInstance::computeTransformedBounds(MeshdataPtr parent, const Matrix
 void GeometryInstance::computeTransformedBounds(const Meshdata& parent, const Matrix4x4f& xform, BoundingBox3f3f* bounds_out, double* radius_out) const {
     const SubMeshGeometry& geo = parent.geometry[ geometryIndex ];
 
-    if (bounds_out != NULL)
-        *bounds_out = BoundingBox3f3f::null();
-    if (radius_out != NULL)
-        *radius_out = 0.;
-
-    for(uint32 pi = 0; pi < geo.primitives.size(); pi++) {
-        const SubMeshGeometry::Primitive& prim = geo.primitives[pi];
-        for(uint32 ii = 0; ii < prim.indices.size(); ii++) {
-            Vector3f xpos = xform * geo.positions[ prim.indices[ii] ];
-            if (bounds_out != NULL)
-                *bounds_out = (*bounds_out == BoundingBox3f3f::null()) ? BoundingBox3f3f(xpos, xpos) : bounds_out->merge(xpos);
-            if (radius_out != NULL && (((*radius_out)*(*radius_out))<xpos.lengthSquared()))
-                *radius_out = sqrt(xpos.lengthSquared());
-        }
-    }
+    // Transform each referenced vertex once (rather than once per index
+    // referring to it) in packed arrays, then reduce them to bounds.
+    std::vector<bool> referenced;
+    geo.getReferencedVertices(&referenced);
+    PositionArrays verts;
+    verts.assign(geo.positions, referenced);
+    verts.transform(xform);
+    verts.computeBounds(bounds_out, radius_out);
 }
 
 BoundingBox3f3f GeometryInstance::computeTransformedBounds(const Meshdata& parent, const Matrix4x4f& xform) const {
@@ -235,6 +243,18 @@ Matrix4x4f Meshdata::getTransform(NodeIndex index) const {
     return globalTransform * xform;
 }
 
+MeshBVHPtr Meshdata::getBVH() const {
+    boost::mutex::scoped_lock lock(mBVHCache.mutex);
+    if (!mBVHCache.bvh)
+        mBVHCache.bvh = MeshBVHPtr(new MeshBVH(*this));
+    return mBVHCache.bvh;
+}
+
+void Meshdata::invalidateBVH() {
+    boost::mutex::scoped_lock lock(mBVHCache.mutex);
+    mBVHCache.bvh.reset();
+}
+
 Meshdata::GeometryInstanceIterator Meshdata::getGeometryInstanceIterator() const {
     return GeometryInstanceIterator(this);
 }
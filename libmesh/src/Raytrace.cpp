@@ -308,94 +308,30 @@ bool SIRIKATA_MESH_FUNCTION_EXPORT Raytrace(VisualPtr vis, const Matrix4x4f& vis
     return false;
 }
 
-bool SIRIKATA_MESH_FUNCTION_EXPORT RaytraceType(MeshdataPtr mesh, const Matrix4x4f& vis_xform, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_out, Vector3f* hit_out) {
-    bool found_hit = false;
+namespace {
 
-    bool have_hit = false;
-    float32 t = 1000000.0;
+// Rays are traced against a mesh's BVH in mesh space, so they're brought into
+// that space instead of transforming the mesh. The mapping is affine, so
+// parametric distances along the ray are unchanged.
+Vector3f transformDirection(const Matrix4x4f& xform, const Vector3f& dir) {
+    return Vector3f(
+        xform(0,0)*dir.x + xform(0,1)*dir.y + xform(0,2)*dir.z,
+        xform(1,0)*dir.x + xform(1,1)*dir.y + xform(1,2)*dir.z,
+        xform(2,0)*dir.x + xform(2,1)*dir.y + xform(2,2)*dir.z
+    );
+}
 
-    // For each instanced geometry
-    Meshdata::GeometryInstanceIterator geoIter = mesh->getGeometryInstanceIterator();
-    uint32 indexInstance; Matrix4x4f transformInstance;
-    while(geoIter.next(&indexInstance, &transformInstance)) {
-        GeometryInstance& geoInst = mesh->instances[indexInstance];
-        const SubMeshGeometry& geo = mesh->geometry[ geoInst.geometryIndex ];
-
-        // We would transform all vertex data up front, but if we only have line
-        // or point data there's no point. Do it on demand, but transform
-        // everything at once when we know we need it.
-        // FIXME its probably better to invert transformInstance and transform
-        // the ray instead of the triangles.
-        std::vector<Vector3f> pos;
-
-        // Check each primitive in this geometry
-        for(uint32 pi = 0; pi < geo.primitives.size(); pi++) {
-            const SubMeshGeometry::Primitive& prim = geo.primitives[pi];
-            if (prim.primitiveType == SubMeshGeometry::Primitive::LINES ||
-                prim.primitiveType == SubMeshGeometry::Primitive::POINTS ||
-                prim.primitiveType == SubMeshGeometry::Primitive::LINESTRIPS)
-                continue;
-
-            // Transform all the positions on demand the first time we encounter
-            // a real need for them.
-            if (pos.empty()) {
-                pos.resize(geo.positions.size());
-                for(uint32 i = 0; i < geo.positions.size(); i++)
-                    pos[i] = vis_xform * transformInstance * geo.positions[i];
-            }
-
-            // Now we actually perform checks against transformed
-            // triangles. Each of these will just generate a list of triangle
-            // and defer to a helper to check for intersection and update the
-            // state.
-            switch(prim.primitiveType) {
-              case SubMeshGeometry::Primitive::TRIANGLES:
-                for(uint32 ii = 0; ii < prim.indices.size()/3; ii++) {
-                    have_hit = have_hit ||
-                        RaytraceTriangle(
-                            pos[prim.indices[3*ii]],
-                            pos[prim.indices[3*ii+1]],
-                            pos[prim.indices[3*ii+2]],
-                            ray_start, ray_dir,
-                            &t
-                        );
-                }
-                break;
-              case SubMeshGeometry::Primitive::TRISTRIPS:
-                for(uint32 ii = 0; ii < prim.indices.size()-2; ii++) {
-                    uint32 i1 = (ii % 2 == 0) ? ii : ii+1;
-                    uint32 i2 = (ii % 2 == 0) ? ii+1 : ii;
-                    uint32 i3 = ii+2;
-                    have_hit = have_hit ||
-                        RaytraceTriangle(
-                            pos[prim.indices[i1]],
-                            pos[prim.indices[i2]],
-                            pos[prim.indices[i3]],
-                            ray_start, ray_dir,
-                            &t
-                        );
-                }
-                break;
-              case SubMeshGeometry::Primitive::TRIFANS:
-                for(uint32 ii = 1; ii < prim.indices.size()-1; ii++) {
-                    have_hit = have_hit ||
-                        RaytraceTriangle(
-                            pos[prim.indices[0]],
-                            pos[prim.indices[ii]],
-                            pos[prim.indices[ii+1]],
-                            ray_start, ray_dir,
-                            &t
-                        );
-                }
-                break;
-              case SubMeshGeometry::Primitive::LINES:
-              case SubMeshGeometry::Primitive::POINTS:
-              case SubMeshGeometry::Primitive::LINESTRIPS:
-                assert(false && "Shouldn't reach these cases since they were handled earlier.");
-                break;
-            }
-        }
-    }
+const float32 MaxRaytraceDistance = 1000000.0;
+
+}
+
+bool SIRIKATA_MESH_FUNCTION_EXPORT RaytraceType(MeshdataPtr mesh, const Matrix4x4f& vis_xform, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_out, Vector3f* hit_out) {
+    Matrix4x4f inv_xform;
+    if (vis_xform.invert(inv_xform) == 0) return false;
+
+    MeshBVHPtr bvh = mesh->getBVH();
+    float32 t = MaxRaytraceDistance;
+    bool have_hit = bvh->intersect(inv_xform * ray_start, transformDirection(inv_xform, ray_dir), &t);
 
     // Provide output
     if (have_hit) {
@@ -405,6 +341,56 @@ bool SIRIKATA_MESH_FUNCTION_EXPORT RaytraceType(MeshdataPtr mesh, const Matrix4x
     return have_hit;
 }
 
+uint32 SIRIKATA_MESH_FUNCTION_EXPORT Raytrace(VisualPtr vis, const Matrix4x4f& vis_xform, const std::vector<Vector3f>& ray_starts, const std::vector<Vector3f>& ray_dirs, std::vector<float32>* t_out, std::vector<bool>* hits_out) {
+    MeshdataPtr md(std::tr1::dynamic_pointer_cast<Meshdata>(vis));
+    if (md) return RaytraceType(md, vis_xform, ray_starts, ray_dirs, t_out, hits_out);
+
+    uint32 count = std::min(ray_starts.size(), ray_dirs.size());
+    if (t_out != NULL) t_out->assign(count, MaxRaytraceDistance);
+    if (hits_out != NULL) hits_out->assign(count, false);
+    uint32 nhits = 0;
+    for(uint32 i = 0; i < count; i++) {
+        float32 t;
+        if (!Raytrace(vis, vis_xform, ray_starts[i], ray_dirs[i], &t, NULL)) continue;
+        nhits++;
+        if (t_out != NULL) (*t_out)[i] = t;
+        if (hits_out != NULL) (*hits_out)[i] = true;
+    }
+    return nhits;
+}
+
+uint32 SIRIKATA_MESH_FUNCTION_EXPORT RaytraceType(MeshdataPtr mesh, const Matrix4x4f& vis_xform, const std::vector<Vector3f>& ray_starts, const std::vector<Vector3f>& ray_dirs, std::vector<float32>* t_out, std::vector<bool>* hits_out) {
+    uint32 count = std::min(ray_starts.size(), ray_dirs.size());
+    if (t_out != NULL) t_out->assign(count, MaxRaytraceDistance);
+    if (hits_out != NULL) hits_out->assign(count, false);
+
+    Matrix4x4f inv_xform;
+    if (count == 0 || vis_xform.invert(inv_xform) == 0) return 0;
+
+    MeshBVHPtr bvh = mesh->getBVH();
+    uint32 nhits = 0;
+    // Convert and trace a packet at a time so the temporaries stay small.
+    Vector3f starts[MeshBVH::PacketSize], dirs[MeshBVH::PacketSize];
+    float32 ts[MeshBVH::PacketSize];
+    bool hits[MeshBVH::PacketSize];
+    for(uint32 base = 0; base < count; base += MeshBVH::PacketSize) {
+        uint32 n = std::min(count - base, (uint32)MeshBVH::PacketSize);
+        for(uint32 r = 0; r < n; r++) {
+            starts[r] = inv_xform * ray_starts[base+r];
+            dirs[r] = transformDirection(inv_xform, ray_dirs[base+r]);
+            ts[r] = MaxRaytraceDistance;
+        }
+        bvh->intersect(n, starts, dirs, ts, hits);
+        for(uint32 r = 0; r < n; r++) {
+            if (!hits[r]) continue;
+            nhits++;
+            if (t_out != NULL) (*t_out)[base+r] = ts[r];
+            if (hits_out != NULL) (*hits_out)[base+r] = true;
+        }
+    }
+    return nhits;
+}
+
 bool SIRIKATA_MESH_FUNCTION_EXPORT RaytraceType(BillboardPtr bboard, const Matrix4x4f& vis_xform, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_out, Vector3f* hit_out) {
     bool found_hit = false;
 
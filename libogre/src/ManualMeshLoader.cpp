@@ -357,17 +357,33 @@ void ManualMeshLoader::traverseNodes(Ogre::Resource* r, const bool useSharedBuff
             HardwareBuffer::Usage indexBufferUsage= HardwareBuffer::HBU_STATIC_WRITE_ONLY;
             bool indexShadowBuffer = false;
 
+            // 16-bit index buffers are preferred, but large submeshes (and
+            // shared buffers, which offset indices) may need 32-bit indices.
+            bool use32BitIndices = prim.indices.is32Bit() ||
+                (useSharedBuffer && totalVertexCount > 0xFFFF);
+
             osubmesh->indexData->indexBuffer = HardwareBufferManager::getSingleton().
-                createIndexBuffer(HardwareIndexBuffer::IT_16BIT,
+                createIndexBuffer(use32BitIndices ? HardwareIndexBuffer::IT_32BIT : HardwareIndexBuffer::IT_16BIT,
                     indexcount, indexBufferUsage, indexShadowBuffer);
-            unsigned short * iData = (unsigned short*)osubmesh->indexData->indexBuffer->lock(HardwareBuffer::HBL_DISCARD);
+            void* iBuffer = osubmesh->indexData->indexBuffer->lock(HardwareBuffer::HBL_DISCARD);
             if (useSharedBuffer) {
-                for (unsigned int i=0;i<indexcount;++i) {
-                    iData[i]=prim.indices[i]+sharedVertexOffset;
-                    assert(iData[i]<totalVertexCount);
+                if (use32BitIndices) {
+                    uint32* iData = (uint32*)iBuffer;
+                    for (unsigned int i=0;i<indexcount;++i) {
+                        iData[i]=prim.indices[i]+sharedVertexOffset;
+                        assert(iData[i]<totalVertexCount);
+                    }
                 }
-            }else {
-                memcpy(iData,&prim.indices[0],indexcount*sizeof(unsigned short));
+                else {
+                    unsigned short* iData = (unsigned short*)iBuffer;
+                    for (unsigned int i=0;i<indexcount;++i) {
+                        iData[i]=prim.indices[i]+sharedVertexOffset;
+                        assert(iData[i]<totalVertexCount);
+                    }
+                }
+            }else if (indexcount > 0) {
+                // Storage width matches the index buffer type here
+                memcpy(iBuffer,prim.indices.data(),prim.indices.byteSize());
             }
             osubmesh->indexData->indexBuffer->unlock();
             switch (prim.primitiveType) {
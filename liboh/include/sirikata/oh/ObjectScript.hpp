@@ -60,6 +60,23 @@ class SIRIKATA_OH_EXPORT ObjectScript : public Service {
     virtual void  notifyProximateGone(std::tr1::shared_ptr<ProxyObject> p, const SpaceObjectReference&){}
     virtual void  notifyProximate(std::tr1::shared_ptr<ProxyObject> p, const SpaceObjectReference&){ }
 
+    /** Notifies the script of all the additions and removals from a single
+     *  proximity update for querier. Additions are delivered before
+     *  removals. Scripts that can handle a whole update at once (e.g. with a
+     *  single entry into their interpreter) should override this; by default
+     *  it just calls notifyProximate and notifyProximateGone for each object.
+     */
+    virtual void notifyProximateBatch(
+        const std::vector<ProxyObjectPtr>& added,
+        const std::vector<ProxyObjectPtr>& removed,
+        const SpaceObjectReference& querier)
+    {
+        for(std::vector<ProxyObjectPtr>::const_iterator it = added.begin(); it != added.end(); it++)
+            notifyProximate(*it, querier);
+        for(std::vector<ProxyObjectPtr>::const_iterator it = removed.begin(); it != removed.end(); it++)
+            notifyProximateGone(*it, querier);
+    }
+
     /*
       Returns true if decoded payload as a scripting communication message,
       false otherwise.  Also processes the message it receives if can decode it.
@@ -0,0 +1,116 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "EmersonCompileCache.hpp"
+#include <sirikata/core/command/Commander.hpp>
+
+AUTO_SINGLETON_INSTANCE(Sirikata::JS::EmersonCompileCache);
+
+namespace Sirikata {
+namespace JS {
+
+namespace {
+// Default maximum size of the cache in bytes
+const uint64 DEFAULT_CAPACITY = 64*1024*1024;
+}
+
+uint64 EmersonCompileCache::Entry::size() const {
+    // Strings plus a rough estimate of the map's per-node overhead
+    return sizeof(Entry) + js.size() + preparseData.size() +
+        lineMap.size() * (sizeof(EmersonLineMap::value_type) + 4*sizeof(void*));
+}
+
+EmersonCompileCache::EmersonCompileCache()
+ : mCapacity(DEFAULT_CAPACITY),
+   mSize(0),
+   mHits(0),
+   mMisses(0),
+   mEvictions(0)
+{
+}
+
+EmersonCompileCache& EmersonCompileCache::getSingleton() {
+    return AutoSingleton<EmersonCompileCache>::getSingleton();
+}
+
+void EmersonCompileCache::destroy() {
+    AutoSingleton<EmersonCompileCache>::destroy();
+}
+
+void EmersonCompileCache::setCapacity(uint64 capacity) {
+    boost::mutex::scoped_lock lock(mMutex);
+    mCapacity = capacity;
+    evict(mCapacity);
+}
+
+EmersonCompileCache::EntryPtr EmersonCompileCache::get(const String& em_source) {
+    Key key = Key::computeDigest(em_source);
+
+    boost::mutex::scoped_lock lock(mMutex);
+    EntryMap::iterator it = mEntries.find(key);
+    if (it == mEntries.end()) {
+        mMisses++;
+        return EntryPtr();
+    }
+
+    mHits++;
+    mLRU.splice(mLRU.begin(), mLRU, it->second.lruIt);
+    return it->second.entry;
+}
+
+void EmersonCompileCache::put(const String& em_source, EntryPtr entry) {
+    Key key = Key::computeDigest(em_source);
+    uint64 entry_size = entry->size();
+
+    boost::mutex::scoped_lock lock(mMutex);
+    // Entries bigger than the cache would just flush everything else
+    if (entry_size > mCapacity) return;
+
+    EntryMap::iterator it = mEntries.find(key);
+    if (it != mEntries.end()) {
+        // Someone else compiled the same thing at the same time, just refresh
+        // it.
+        mLRU.splice(mLRU.begin(), mLRU, it->second.lruIt);
+        return;
+    }
+
+    evict(mCapacity - entry_size);
+
+    mLRU.push_front(key);
+    CachedEntry& cached = mEntries[key];
+    cached.entry = entry;
+    cached.size = entry_size;
+    cached.lruIt = mLRU.begin();
+    mSize += entry_size;
+}
+
+void EmersonCompileCache::evict(uint64 capacity) {
+    while(mSize > capacity && !mLRU.empty()) {
+        EntryMap::iterator it = mEntries.find(mLRU.back());
+        assert(it != mEntries.end());
+        mSize -= it->second.size;
+        mEntries.erase(it);
+        mLRU.pop_back();
+        mEvictions++;
+    }
+}
+
+void EmersonCompileCache::commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    Command::Result result = Command::EmptyResult();
+
+    boost::mutex::scoped_lock lock(mMutex);
+    uint64 lookups = mHits + mMisses;
+    result.put("entries", (uint32)mEntries.size());
+    result.put("size", mSize);
+    result.put("capacity", mCapacity);
+    result.put("hits", mHits);
+    result.put("misses", mMisses);
+    result.put("evictions", mEvictions);
+    result.put("hit_rate", lookups > 0 ? ((double)mHits / lookups) : 0.0);
+
+    cmdr->result(cmdid, result);
+}
+
+} // namespace JS
+} // namespace Sirikata
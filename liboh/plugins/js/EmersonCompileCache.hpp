@@ -0,0 +1,88 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_JS_EMERSON_COMPILE_CACHE_HPP_
+#define _SIRIKATA_JS_EMERSON_COMPILE_CACHE_HPP_
+
+#include "Platform.hpp"
+#include "emerson/EmersonUtil.h"
+#include <sirikata/core/util/Singleton.hpp>
+#include <sirikata/core/util/Sha256.hpp>
+#include <sirikata/core/command/Command.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Sirikata {
+namespace JS {
+
+/** Process-wide cache of Emerson compilation results, keyed by a hash of the
+ *  Emerson source. Objects created from the same script and imports of the
+ *  same library files only run the Emerson compiler once, as long as the
+ *  result stays in the cache. Along with the generated JS, entries hold the
+ *  line map for error reporting and v8 preparse data for the generated JS,
+ *  which speeds up compiling it in each script.
+ *
+ *  The cache is bounded by the (approximate) size of the entries it holds,
+ *  evicting the least recently used entries first. It is safe to use from
+ *  any thread.
+ */
+class EmersonCompileCache : public AutoSingleton<EmersonCompileCache> {
+public:
+    struct Entry {
+        String js;
+        EmersonLineMap lineMap;
+        // Output of v8::ScriptData::PreCompile for js, if available
+        String preparseData;
+
+        uint64 size() const;
+    };
+    typedef std::tr1::shared_ptr<const Entry> EntryPtr;
+
+    EmersonCompileCache();
+
+    static EmersonCompileCache& getSingleton();
+    static void destroy();
+
+    /** Set the maximum size of the cache in bytes, evicting entries if
+     *  necessary. A capacity of 0 disables caching.
+     */
+    void setCapacity(uint64 capacity);
+
+    /** Look up the compiled version of the Emerson source em_source, returning
+     *  an empty pointer if it isn't cached.
+     */
+    EntryPtr get(const String& em_source);
+    /** Add the result of compiling em_source to the cache. */
+    void put(const String& em_source, EntryPtr entry);
+
+    void commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
+
+private:
+    typedef SHA256 Key;
+    typedef std::list<Key> LRUList;
+    struct CachedEntry {
+        EntryPtr entry;
+        uint64 size;
+        LRUList::iterator lruIt;
+    };
+    typedef std::tr1::unordered_map<Key, CachedEntry, Key::Hasher> EntryMap;
+
+    // Must be called with mMutex held
+    void evict(uint64 capacity);
+
+    boost::mutex mMutex;
+    uint64 mCapacity;
+    uint64 mSize;
+    EntryMap mEntries;
+    // Front is most recently used
+    LRUList mLRU;
+
+    uint64 mHits;
+    uint64 mMisses;
+    uint64 mEvictions;
+};
+
+} // namespace JS
+} // namespace Sirikata
+
+#endif //_SIRIKATA_JS_EMERSON_COMPILE_CACHE_HPP_
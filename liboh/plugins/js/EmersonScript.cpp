@@ -157,6 +157,7 @@ void EmersonScript::resetScript()
     mResetting = false;
     mPresences.clear();
     mImportedFiles.clear();
+    clearVisiblePools();
     mContext->struct_rootReset();
 
     //replay all prox sets to each presence
@@ -447,6 +448,181 @@ void  EmersonScript::iNotifyProximate(
 }
 
 
+//Called by HostedObject with all the changes to querier's result set from a
+//single proximity update. Posts a single task so that the whole update is
+//handled with one entry into the isolate.
+void EmersonScript::notifyProximateBatch(
+    const std::vector<ProxyObjectPtr>& added,
+    const std::vector<ProxyObjectPtr>& removed,
+    const SpaceObjectReference& querier)
+{
+    if (JSObjectScript::mCtx->stopped())
+    {
+        JSLOG(warn, "Ignoring proximity update callback after shutdown request.");
+        return;
+    }
+
+    SporefVec added_refs, removed_refs;
+    added_refs.reserve(added.size());
+    for(std::vector<ProxyObjectPtr>::const_iterator it = added.begin(); it != added.end(); it++)
+        added_refs.push_back((*it)->getObjectReference());
+    removed_refs.reserve(removed.size());
+    for(std::vector<ProxyObjectPtr>::const_iterator it = removed.begin(); it != removed.end(); it++)
+        removed_refs.push_back((*it)->getObjectReference());
+
+    JSObjectScript::mCtx->objStrand->post(
+        std::tr1::bind(&EmersonScript::iNotifyProximateBatch,this,
+            added_refs,removed_refs,querier,Liveness::livenessToken()),
+        "EmersonScript::iNotifyProximateBatch"
+    );
+}
+
+void EmersonScript::iNotifyProximateBatch(
+    const SporefVec& added, const SporefVec& removed,
+    const SpaceObjectReference& querier, Liveness::Token alive)
+{
+    if (!alive) return;
+    Liveness::Lock locked(alive);
+    if (!locked) return;
+
+    EMERSCRIPT_SERIAL_CHECK();
+    while(!JSObjectScript::mCtx->initialized())
+    {}
+
+    v8::Locker locker (mCtx->mIsolate);
+    v8::Isolate::Scope iscope(JSObjectScript::mCtx->mIsolate);
+    if (JSObjectScript::mCtx->stopped())
+    {
+        JSLOG(warn, "Ignoring proximity update callback after shutdown request.");
+        return;
+    }
+
+    std::map<uint32, JSContextStruct*>::iterator contIter;
+    for (contIter  =  mContStructMap.begin(); contIter != mContStructMap.end();
+         ++contIter)
+    {
+        contIter->second->proximateBatchEvent(querier, added, removed);
+    }
+}
+
+//called from JSContextStruct. Should be called from inside objStrand
+void EmersonScript::fireProxBatchEvent(const SpaceObjectReference& localPresSporef,
+    const SporefVec& added, const SporefVec& removed, JSContextStruct* jscont)
+{
+    EMERSCRIPT_SERIAL_CHECK();
+
+    if (mEvalContextStack.empty())
+        assert(false);
+
+    EvalContext& ctx = mEvalContextStack.top();
+    EvalContext new_ctx(ctx,jscont);
+    ScopedEvalContext sec(this,new_ctx);
+    v8::HandleScope handle_scope;
+    v8::Context::Scope context_scope(jscont->mContext);
+
+    String sporefVisTo = localPresSporef.toString();
+    v8::Local<v8::String> sporefVisToStr = v8::String::New(sporefVisTo.c_str(), sporefVisTo.size());
+
+    deliverProxBatch(jscont, added, false, sporefVisToStr);
+    // A handler for the additions may have cleared the context.
+    if (!jscont->getIsCleared())
+        deliverProxBatch(jscont, removed, true, sporefVisToStr);
+
+    postCallbackChecks();
+}
+
+void EmersonScript::deliverProxBatch(JSContextStruct* jscont,
+    const SporefVec& refs, bool isGone, v8::Handle<v8::String> sporefVisTo)
+{
+    if (refs.empty()) return;
+
+    v8::Persistent<v8::Function>& batchFunc =
+        isGone ? jscont->proxRemovedBatchFunc : jscont->proxAddedBatchFunc;
+    v8::Persistent<v8::Function>& func =
+        isGone ? jscont->proxRemovedFunc : jscont->proxAddedFunc;
+
+    TryCatch try_catch;
+    if (!batchFunc.IsEmpty())
+    {
+        v8::Local<v8::Array> visibles = v8::Array::New(refs.size());
+        for (uint32 i = 0; i < refs.size(); ++i)
+            visibles->Set(i, getPooledVisible(jscont, refs[i], isGone));
+
+        v8::Handle<v8::Value> argv[2] = { visibles, sporefVisTo };
+        JSLOG(detailed,"Issuing batched user callback for " << refs.size() << " proximity " << (isGone ? "removals" : "additions"));
+        invokeCallback(jscont,batchFunc,2,argv);
+        if (try_catch.HasCaught())
+            printException(try_catch);
+        return;
+    }
+
+    if (func.IsEmpty())
+        return;
+
+    for (SporefVec::const_iterator it = refs.begin(); it != refs.end(); ++it)
+    {
+        v8::Handle<v8::Value> argv[2] = {
+            getPooledVisible(jscont, *it, isGone), sporefVisTo };
+        invokeCallback(jscont,func,2,argv);
+        if (try_catch.HasCaught())
+        {
+            printException(try_catch);
+            try_catch.Reset();
+        }
+        if (jscont->getIsCleared())
+            break;
+    }
+}
+
+//should already be in jscont's context by the time this is called
+v8::Local<v8::Object> EmersonScript::getPooledVisible(JSContextStruct* jscont,
+    const SpaceObjectReference& ref, bool isGone)
+{
+    VisiblePool& pool = mVisiblePools[jscont];
+    VisiblePool::iterator it = pool.find(ref);
+    if (it == pool.end())
+    {
+        v8::Local<v8::Object> vis =
+            createVisibleWeakPersistent(jsVisMan.createVisStruct(this, ref));
+        // A removal of something we never saw added doesn't need to be kept
+        // around.
+        if (!isGone)
+        {
+            PooledVisible& pooled = pool[ref];
+            pooled.wrapper = v8::Persistent<v8::Object>::New(vis);
+            pooled.refs = 1;
+        }
+        return vis;
+    }
+
+    v8::Local<v8::Object> vis = v8::Local<v8::Object>::New(it->second.wrapper);
+    if (!isGone)
+        it->second.refs++;
+    else if (--(it->second.refs) == 0)
+    {
+        it->second.wrapper.Dispose();
+        pool.erase(it);
+    }
+    return vis;
+}
+
+void EmersonScript::clearVisiblePool(JSContextStruct* jscont)
+{
+    VisiblePoolMap::iterator poolIt = mVisiblePools.find(jscont);
+    if (poolIt == mVisiblePools.end())
+        return;
+
+    for (VisiblePool::iterator it = poolIt->second.begin(); it != poolIt->second.end(); ++it)
+        it->second.wrapper.Dispose();
+    mVisiblePools.erase(poolIt);
+}
+
+void EmersonScript::clearVisiblePools()
+{
+    while (!mVisiblePools.empty())
+        clearVisiblePool(mVisiblePools.begin()->first);
+}
+
 void EmersonScript::iResetProximateHelper(
     JSVisibleStruct* proxVis,const SpaceObjectReference& proxTo)
 {
@@ -788,6 +964,8 @@ void EmersonScript::iStop(Liveness::Token alive, bool letDie)
     for (PresenceMap::const_iterator it = mPresences.begin(); it != mPresences.end(); it++)
         unsubscribePresenceEvents(it->first);
 
+    clearVisiblePools();
+
     JSObjectScript::iStop(alive, letDie);
 
     mParent->removeListener((SessionEventListener*)this);
@@ -978,6 +1156,7 @@ void EmersonScript::finishContextClear(JSContextStruct* jscont)
 
     //tell it to finish clearing itself.
     jscont->finishClear();
+    clearVisiblePool(jscont);
 
     //also remove it from my list of sandboxes/contexts
     for (std::map<uint32, JSContextStruct*>::iterator findContIter = mContStructMap.begin();
@@ -1024,25 +1203,6 @@ void EmersonScript::iHandleScriptCommRead(
         return;
 
 
-    Sirikata::JS::Protocol::JSMessage jsMsg;
-    Sirikata::JS::Protocol::JSFieldValue jsFieldVal;
-    bool isJSMsg   = jsMsg.ParseFromString(payload);
-    if (! isJSMsg)
-        isJSMsg = jsMsg.ParseFromArray(payload.data(),payload.size());
-
-    bool isJSField = false;
-    if (!isJSMsg)
-    {
-        isJSField = jsFieldVal.ParseFromString(payload);
-        if (!isJSField)
-            isJSField = jsFieldVal.ParseFromArray(payload.data(), payload.size());
-    }
-
-    //if can't decode the payload as a jsmessage or
-    //a jsfieldval, then return false;
-    if (!(isJSMsg || isJSField))
-        return;
-
     if (isStopped()) {
         JSLOG(warn, "Ignoring message after shutdown request.");
         // Regardless of whether we can or not, just say we can't decode it.
@@ -1092,19 +1252,8 @@ void EmersonScript::iHandleScriptCommRead(
 
             std::vector< v8::Persistent<v8::Object> > visiblesToMakeWeak;
 
-            v8::Handle<v8::Value> msgVal;
-            if (isJSMsg)
-            {
-                //try to decode as object.
-                msgVal = JSSerializer::deserializeObject( this, jsMsg,
-                    deserializeWorks);
-            }
-            else
-            {
-                //try to decode as a value.
-                msgVal = JSSerializer::deserializeMessage(this,jsFieldVal,
-                    deserializeWorks);
-            }
+            v8::Handle<v8::Value> msgVal =
+                JSSerializer::deserialize(this, payload, deserializeWorks);
             if (! deserializeWorks)
             {
                 JSLOG(error, "Deserialization Failed!!");
@@ -1246,49 +1395,14 @@ void EmersonScript::processSandboxMessage(
 
 
 
-    ////Try to decode the message
-    Sirikata::JS::Protocol::JSMessage jsMsg;
-    Sirikata::JS::Protocol::JSFieldValue jsFieldVal;
-
-    bool isJSMsg   = jsMsg.ParseFromString(payload);
-    if (! isJSMsg)
-        isJSMsg = jsMsg.ParseFromArray(payload.data(),payload.size());
-
-    bool isJSField = false;
-    if (!isJSMsg)
-    {
-        isJSField = jsFieldVal.ParseFromString(payload);
-        if (!isJSField)
-            isJSField = jsFieldVal.ParseFromArray(payload.data(), payload.size());
-    }
-
-    //if can't decode the payload as a jsmessage or
-    //a jsfieldval, then return false;
-    if (!(isJSMsg || isJSField))
-        return;
-
-
-
-    //Above: Message has decoded to be complete
-    //Below: Try to turn the message into an Emerson object
+    //Try to turn the message into an Emerson object
     mEvalContextStack.push(EvalContext(receiver));
     v8::HandleScope handle_scope;
     v8::Context::Scope context_scope (receiver->mContext);
 
     bool deserializeWorks = false;
-    v8::Handle<v8::Value> msgVal;
-    if (isJSMsg)
-    {
-        //try to decode as object.
-        msgVal = JSSerializer::deserializeObject( this, jsMsg,
-            deserializeWorks);        
-    }
-    else
-    {
-        //try to decode as a value.
-        msgVal = JSSerializer::deserializeMessage(this,jsFieldVal,
-            deserializeWorks);
-    }
+    v8::Handle<v8::Value> msgVal =
+        JSSerializer::deserialize(this, payload, deserializeWorks);
 
     if (! deserializeWorks)
     {
@@ -96,6 +96,10 @@ public:
 
     virtual void  notifyProximateGone(ProxyObjectPtr proximateObject, const SpaceObjectReference& querier);
     virtual void  notifyProximate(ProxyObjectPtr proximateObject, const SpaceObjectReference& querier);
+    virtual void notifyProximateBatch(
+        const std::vector<ProxyObjectPtr>& added,
+        const std::vector<ProxyObjectPtr>& removed,
+        const SpaceObjectReference& querier);
 
 
     /*
@@ -152,6 +156,18 @@ public:
     void fireProxEvent(const SpaceObjectReference& localPresSporef,
         JSVisibleStruct* jsvis, JSContextStruct* jscont, bool isGone);
 
+    typedef std::vector<SpaceObjectReference> SporefVec;
+    /**
+       Called by JSContextStruct::proximateBatchEvent. Enters jscont's context
+       once and delivers all of added, then all of removed. If the context
+       registered a batch handler, it is called once with an array of
+       visibles, otherwise the regular per-object handler is called for each
+       one.
+     */
+    void fireProxBatchEvent(const SpaceObjectReference& localPresSporef,
+        const SporefVec& added, const SporefVec& removed,
+        JSContextStruct* jscont);
+
 
 
 
@@ -371,6 +387,32 @@ private:
      */
     void finishContextClear(JSContextStruct* jscont);
 
+    /**
+       Visible wrappers handed to proximity handlers are pooled per context so
+       an object that stays in a result set keeps a single wrapper instead of
+       getting a new one (and a new JSVisibleStruct) for every event. refs
+       counts how many result sets the object is in, i.e. additions minus
+       removals, and the wrapper is released when it drops to zero. Holding
+       wrapper only keeps the object alive; it still has the usual weak handle
+       that cleans up its JSVisibleStruct once the script drops it too.
+     */
+    struct PooledVisible {
+        v8::Persistent<v8::Object> wrapper;
+        uint32 refs;
+    };
+    typedef std::map<SpaceObjectReference, PooledVisible> VisiblePool;
+    typedef std::map<JSContextStruct*, VisiblePool> VisiblePoolMap;
+    VisiblePoolMap mVisiblePools;
+
+    // Returns the pooled wrapper for ref in jscont, creating it for additions,
+    // and updates its reference count. Must be inside jscont's context.
+    v8::Local<v8::Object> getPooledVisible(JSContextStruct* jscont,
+        const SpaceObjectReference& ref, bool isGone);
+    void deliverProxBatch(JSContextStruct* jscont, const SporefVec& refs,
+        bool isGone, v8::Handle<v8::String> sporefVisTo);
+    void clearVisiblePool(JSContextStruct* jscont);
+    void clearVisiblePools();
+
 
     //looks through all previously connected presneces (located in mPresences).
     //returns the corresponding jspresencestruct that has a spaceobjectreference
@@ -447,6 +489,10 @@ private:
         ProxyObjectPtr proximateObject, const SpaceObjectReference& querier,
         Liveness::Token alive);
 
+    void iNotifyProximateBatch(
+        const SporefVec& added, const SporefVec& removed,
+        const SpaceObjectReference& querier, Liveness::Token alive);
+
     void iOnConnected(SessionEventProviderPtr from,
         const SpaceObjectReference& name, HostedObject::PresenceToken token,
         bool duringInit,Liveness::Token alive);
@@ -0,0 +1,183 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "JSBinaryCodec.hpp"
+#include <cstring>
+
+namespace Sirikata {
+namespace JS {
+namespace JSBinary {
+
+namespace {
+// Leading 0 byte, a tag and the format version
+const char HEADER[] = { '\0', 'E', 'J', 'S', '\1' };
+const size_t HEADER_SIZE = sizeof(HEADER);
+
+// Field name markers. 0 ends the list of fields, odd values are references to
+// previously seen names and other even values are new names with length
+// (marker >> 1) - 1.
+const uint64 NAME_END = 0;
+}
+
+bool isBinary(const String& payload) {
+    return payload.size() >= HEADER_SIZE &&
+        std::memcmp(payload.data(), HEADER, HEADER_SIZE) == 0;
+}
+
+
+Writer::Writer(String& buf)
+ : mBuf(buf),
+   mObjectCount(0)
+{
+    mBuf.clear();
+    mBuf.append(HEADER, HEADER_SIZE);
+}
+
+void Writer::writeVarint(uint64 val) {
+    while(val >= 0x80) {
+        mBuf.push_back((char)((val & 0x7F) | 0x80));
+        val >>= 7;
+    }
+    mBuf.push_back((char)val);
+}
+
+void Writer::writeInt32(int32 val) {
+    // zigzag so small negative numbers stay small
+    writeVarint( ((uint32)val << 1) ^ (uint32)(val >> 31) );
+}
+
+void Writer::writeDouble(float64 val) {
+    uint64 bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    char bytes[8];
+    for(int i = 0; i < 8; i++)
+        bytes[i] = (char)((bits >> (8*i)) & 0xFF);
+    mBuf.append(bytes, 8);
+}
+
+void Writer::writeString(const char* data, size_t len) {
+    writeVarint(len);
+    mBuf.append(data, len);
+}
+
+uint32 Writer::beginObject(Tag tag) {
+    writeTag(tag);
+    return mObjectCount++;
+}
+
+void Writer::writeBackref(uint32 idx) {
+    writeTag(TAG_BACKREF);
+    writeVarint(idx);
+}
+
+void Writer::writeName(const String& name) {
+    NameMap::iterator it = mNames.find(name);
+    if (it != mNames.end()) {
+        writeVarint(((uint64)it->second << 1) | 1);
+        return;
+    }
+
+    uint32 idx = mNames.size();
+    mNames.insert(NameMap::value_type(name, idx));
+    writeVarint(((uint64)name.size() + 1) << 1);
+    mBuf.append(name);
+}
+
+
+
+Reader::Reader(const String& payload)
+ : mPos(payload.data()),
+   mEnd(payload.data() + payload.size()),
+   mValid(isBinary(payload))
+{
+    if (mValid)
+        mPos += HEADER_SIZE;
+}
+
+bool Reader::readTag(Tag* tag) {
+    if (mPos == mEnd) return false;
+    uint8 val = (uint8)*mPos;
+    if (val >= NUM_TAGS) return false;
+    *tag = (Tag)val;
+    mPos++;
+    return true;
+}
+
+bool Reader::readVarint(uint64* val) {
+    uint64 result = 0;
+    for(int shift = 0; shift < 64; shift += 7) {
+        if (mPos == mEnd) return false;
+        uint8 byte = (uint8)*mPos++;
+        result |= (uint64)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *val = result;
+            return true;
+        }
+    }
+    // Too many continuation bytes
+    return false;
+}
+
+bool Reader::readInt32(int32* val) {
+    uint64 encoded;
+    if (!readVarint(&encoded) || encoded > 0xFFFFFFFFULL) return false;
+    uint32 zz = (uint32)encoded;
+    *val = (int32)((zz >> 1) ^ (~(zz & 1) + 1));
+    return true;
+}
+
+bool Reader::readUint32(uint32* val) {
+    uint64 encoded;
+    if (!readVarint(&encoded) || encoded > 0xFFFFFFFFULL) return false;
+    *val = (uint32)encoded;
+    return true;
+}
+
+bool Reader::readDouble(float64* val) {
+    if (mEnd - mPos < 8) return false;
+    uint64 bits = 0;
+    for(int i = 0; i < 8; i++)
+        bits |= (uint64)(uint8)mPos[i] << (8*i);
+    mPos += 8;
+    std::memcpy(val, &bits, sizeof(bits));
+    return true;
+}
+
+bool Reader::readString(String* str) {
+    uint64 len;
+    if (!readVarint(&len) || len > (uint64)(mEnd - mPos)) return false;
+    str->assign(mPos, (size_t)len);
+    mPos += len;
+    return true;
+}
+
+bool Reader::readBackref(uint32* idx) {
+    return readUint32(idx);
+}
+
+bool Reader::readName(String* name, bool* end) {
+    uint64 marker;
+    if (!readVarint(&marker)) return false;
+
+    *end = (marker == NAME_END);
+    if (*end) return true;
+
+    if (marker & 1) {
+        uint64 idx = marker >> 1;
+        if (idx >= mNames.size()) return false;
+        *name = mNames[idx];
+        return true;
+    }
+
+    uint64 len = (marker >> 1) - 1;
+    if (len > (uint64)(mEnd - mPos)) return false;
+    name->assign(mPos, (size_t)len);
+    mPos += len;
+    mNames.push_back(*name);
+    return true;
+}
+
+} // namespace JSBinary
+} // namespace JS
+} // namespace Sirikata
@@ -0,0 +1,146 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_JS_BINARY_CODEC_HPP_
+#define _SIRIKATA_JS_BINARY_CODEC_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <vector>
+
+namespace Sirikata {
+namespace JS {
+
+/** Low level pieces of the binary encoding of Emerson values used by
+ *  JSSerializer. They don't depend on v8, so they can be used (and
+ *  benchmarked) on their own.
+ *
+ *  A message is a header followed by a single value. Each value starts with a
+ *  one byte Tag. Integers and lengths are varints, int32s are zigzag
+ *  encoded, doubles are 8 bytes little endian and strings are a length
+ *  followed by the UTF-8 bytes. Object-like values (objects, arrays,
+ *  functions, the root object, visibles and systems) are numbered in the
+ *  order they are written so later references to the same object are just a
+ *  TAG_BACKREF and that number, which is how cycles are encoded. Objects,
+ *  arrays, functions and the root object are followed by a list of
+ *  name/value pairs terminated by an empty name marker. Property names are
+ *  interned: the first time a name appears it is written out and afterwards
+ *  only its index in the name table is written.
+ *
+ *  The header starts with a 0 byte, which can't start a valid protocol
+ *  buffer, so binary messages can be told apart from the older PBJ-based
+ *  ones.
+ */
+namespace JSBinary {
+
+enum Tag {
+    TAG_UNDEFINED = 0,
+    TAG_NULL = 1,
+    TAG_TRUE = 2,
+    TAG_FALSE = 3,
+    TAG_INT32 = 4,
+    TAG_UINT32 = 5,
+    TAG_DOUBLE = 6,
+    TAG_STRING = 7,
+    TAG_OBJECT = 8,
+    TAG_ARRAY = 9,
+    // Followed by the function text, then fields
+    TAG_FUNCTION = 10,
+    // Object.prototype of the sender
+    TAG_ROOT_OBJECT = 11,
+    TAG_BACKREF = 12,
+    // Visibles and presences, followed by the SpaceObjectReference string
+    TAG_VISIBLE = 13,
+    TAG_SYSTEM = 14,
+
+    NUM_TAGS
+};
+
+/** Returns true if payload starts with the header of a binary message. */
+bool isBinary(const String& payload);
+
+/** Writes values into a caller provided buffer. The buffer is cleared when
+ *  the writer is constructed, but keeps its capacity, so reusing the same
+ *  String for many messages avoids reallocating it.
+ */
+class Writer {
+public:
+    explicit Writer(String& buf);
+
+    void writeTag(Tag tag) {
+        mBuf.push_back((char)tag);
+    }
+    void writeVarint(uint64 val);
+    void writeInt32(int32 val);
+    void writeUint32(uint32 val) {
+        writeVarint(val);
+    }
+    void writeDouble(float64 val);
+    void writeString(const char* data, size_t len);
+    void writeString(const String& str) {
+        writeString(str.data(), str.size());
+    }
+
+    /** Writes the tag of an object-like value and returns the number later
+     *  back references to it should use.
+     */
+    uint32 beginObject(Tag tag);
+    void writeBackref(uint32 idx);
+
+    // Fields of an object
+    void writeName(const String& name);
+    void endFields() {
+        mBuf.push_back((char)0);
+    }
+
+    uint32 objectCount() const { return mObjectCount; }
+
+private:
+    typedef std::tr1::unordered_map<String, uint32> NameMap;
+
+    String& mBuf;
+    NameMap mNames;
+    uint32 mObjectCount;
+};
+
+/** Reads values written by a Writer. All methods return false if the input
+ *  is malformed or truncated, after which the reader shouldn't be used
+ *  anymore.
+ */
+class Reader {
+public:
+    /** Starts reading payload, which must outlive the reader. valid() returns
+     *  false if payload doesn't have a binary message header.
+     */
+    explicit Reader(const String& payload);
+
+    bool valid() const { return mValid; }
+    // True when all the input has been consumed
+    bool done() const { return mPos == mEnd; }
+
+    bool readTag(Tag* tag);
+    bool readVarint(uint64* val);
+    bool readInt32(int32* val);
+    bool readUint32(uint32* val);
+    bool readDouble(float64* val);
+    bool readString(String* str);
+    bool readBackref(uint32* idx);
+
+    /** Reads the next field name of an object. Sets end to true, leaving name
+     *  untouched, if the object has no more fields.
+     */
+    bool readName(String* name, bool* end);
+
+private:
+    const char* mPos;
+    const char* mEnd;
+    bool mValid;
+    std::vector<String> mNames;
+};
+
+} // namespace JSBinary
+
+} // namespace JS
+} // namespace Sirikata
+
+#endif //_SIRIKATA_JS_BINARY_CODEC_HPP_
@@ -1,4 +1,5 @@
 #include "JSCtx.hpp"
+#include "JSIsolatePool.hpp"
 
 
 namespace Sirikata
@@ -15,6 +16,33 @@ JSCtx::JSCtx(
    mainStrand(ctx->mainStrand),
    mIsolate(is),
    internalContext(ctx),
+   mParent(NULL),
+   mPool(NULL),
+   isStopped(false),
+   isInitialized(false),
+   mCheck()
+{
+}
+
+JSCtx::JSCtx(JSCtx* parent, JSIsolatePool* pool)
+ : objStrand(parent->objStrand),
+   visManStrand(parent->visManStrand),
+   mainStrand(parent->mainStrand),
+   mIsolate(parent->mIsolate),
+   mVisibleTemplate(parent->mVisibleTemplate),
+   mPresenceTemplate(parent->mPresenceTemplate),
+   mContextTemplate(parent->mContextTemplate),
+   mUtilTemplate(parent->mUtilTemplate),
+   mInvokableObjectTemplate(parent->mInvokableObjectTemplate),
+   mSystemTemplate(parent->mSystemTemplate),
+   mTimerTemplate(parent->mTimerTemplate),
+   mContextGlobalTemplate(parent->mContextGlobalTemplate),
+   mVec3Template(parent->mVec3Template),
+   mQuaternionTemplate(parent->mQuaternionTemplate),
+   mPatternTemplate(parent->mPatternTemplate),
+   internalContext(parent->internalContext),
+   mParent(parent),
+   mPool(pool),
    isStopped(false),
    isInitialized(false),
    mCheck()
@@ -23,6 +51,14 @@ JSCtx::JSCtx(
 
 JSCtx::~JSCtx()
 {
+    // Shared templates and isolate belong to the parent, just hand the slot
+    // back.
+    if (mParent != NULL) {
+        if (mPool != NULL)
+            mPool->release(this);
+        return;
+    }
+
     mVisibleTemplate.Dispose();
     mPresenceTemplate.Dispose();
     mContextTemplate.Dispose();
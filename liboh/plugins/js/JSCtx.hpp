@@ -15,12 +15,25 @@ namespace JS
    Note: trace, epoch, and simlen
  */
 
+class JSIsolatePool;
+
 class JSCtx 
 {
 public:    
+    /**
+       Creates a context which owns is and the templates stored in it, and
+       disposes of them when destroyed.
+     */
     JSCtx(
         Context* ctx,Network::IOStrandPtr oStrand,
         Network::IOStrandPtr vmStrand,v8::Isolate* is);
+
+    /**
+       Creates a context for a script that shares the isolate, strands and
+       templates of parent, which must outlive it. When destroyed, the
+       context is returned to pool.
+     */
+    JSCtx(JSCtx* parent, JSIsolatePool* pool);
     
     ~JSCtx();
     
@@ -53,8 +66,14 @@ public:
     v8::Persistent<v8::FunctionTemplate> mPatternTemplate;
     
     
+    // The context whose isolate and templates are shared, or NULL if this
+    // context owns them.
+    JSCtx* parent() const { return mParent; }
+
 private:
     Context* internalContext;
+    JSCtx* mParent;
+    JSIsolatePool* mPool;
     bool isStopped;
     bool isInitialized;
     Sirikata::SerializationCheck mCheck;
@@ -0,0 +1,198 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "JSIsolatePool.hpp"
+#include "JSCtx.hpp"
+#include "JSLogging.hpp"
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/command/Commander.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace Sirikata {
+namespace JS {
+
+JSIsolatePool::PooledIsolate::PooledIsolate(uint32 id_, JSCtx* root_, bool dedicated_)
+ : id(id_),
+   root(root_),
+   dedicated(dedicated_),
+   created(Timer::now()),
+   scripts(0),
+   totalScripts(0),
+   gcCount(0),
+   gcTime(Duration::zero()),
+   gcMax(Duration::zero()),
+   gcStart(Time::null()),
+   heapUsed(0),
+   heapTotal(0)
+{
+}
+
+JSIsolatePool::JSIsolatePool(Context* ctx, uint32 size, TemplateInitializer init)
+ : mContext(ctx),
+   mSize(size),
+   mInitTemplates(init),
+   mNextID(0),
+   mIsolatesCreated(0)
+{
+}
+
+JSIsolatePool::~JSIsolatePool() {
+    boost::mutex::scoped_lock lock(mMutex);
+    for(IsolateMap::iterator it = mIsolates.begin(); it != mIsolates.end(); it++) {
+        if (it->second->scripts > 0)
+            JSLOG(warn, "Destroying isolate " << it->second->id << " which is still used by " << it->second->scripts << " scripts");
+        destroyIsolate(it->second);
+    }
+    mIsolates.clear();
+}
+
+JSCtx* JSIsolatePool::acquire(const String& name) {
+    boost::mutex::scoped_lock lock(mMutex);
+
+    PooledIsolate* pi = NULL;
+    if (mSize == 0)
+        pi = createIsolate(name, true);
+    else if (mIsolates.size() < mSize)
+        pi = createIsolate("isolate " + boost::lexical_cast<String>(mNextID), false);
+    else
+        pi = leastLoaded();
+
+    pi->scripts++;
+    pi->totalScripts++;
+    return new JSCtx(pi->root, this);
+}
+
+void JSIsolatePool::release(JSCtx* ctx) {
+    boost::mutex::scoped_lock lock(mMutex);
+
+    IsolateMap::iterator it = mIsolates.find(ctx->parent());
+    if (it == mIsolates.end()) {
+        JSLOG(error, "Released a JSCtx which doesn't belong to any isolate in the pool");
+        return;
+    }
+
+    PooledIsolate* pi = it->second;
+    assert(pi->scripts > 0);
+    pi->scripts--;
+    // Shared isolates stick around, even when empty, so their templates can be
+    // reused.
+    if (pi->dedicated && pi->scripts == 0) {
+        mIsolates.erase(it);
+        destroyIsolate(pi);
+    }
+}
+
+JSIsolatePool::PooledIsolate* JSIsolatePool::createIsolate(const String& name, bool dedicated) {
+    v8::Isolate* isolate = v8::Isolate::New();
+    JSCtx* root =
+        new JSCtx(mContext,
+            Network::IOStrandPtr(mContext->ioService->createStrand("EmersonScript " + name)),
+            Network::IOStrandPtr(mContext->ioService->createStrand("VisManager " + name)),
+            isolate);
+    PooledIsolate* pi = new PooledIsolate(mNextID++, root, dedicated);
+    mIsolatesCreated++;
+
+    {
+        v8::Locker locker(isolate);
+        v8::Isolate::Scope iscope(isolate);
+        isolate->SetData(pi);
+        // GC callbacks are registered with the current isolate
+        v8::V8::AddGCPrologueCallback(&JSIsolatePool::gcPrologue);
+        v8::V8::AddGCEpilogueCallback(&JSIsolatePool::gcEpilogue);
+
+        v8::HandleScope handle_scope;
+        mInitTemplates(root);
+    }
+
+    mIsolates[root] = pi;
+    if (!dedicated)
+        JSLOG(detailed, "Created shared isolate " << pi->id << " (" << mIsolates.size() << " of " << mSize << ")");
+    return pi;
+}
+
+JSIsolatePool::PooledIsolate* JSIsolatePool::leastLoaded() {
+    PooledIsolate* best = NULL;
+    for(IsolateMap::iterator it = mIsolates.begin(); it != mIsolates.end(); it++) {
+        if (best == NULL || it->second->scripts < best->scripts)
+            best = it->second;
+    }
+    return best;
+}
+
+void JSIsolatePool::destroyIsolate(PooledIsolate* pi) {
+    // The root owns the isolate and templates
+    delete pi->root;
+    delete pi;
+}
+
+void JSIsolatePool::gcPrologue(v8::GCType type, v8::GCCallbackFlags flags) {
+    PooledIsolate* pi = static_cast<PooledIsolate*>(v8::Isolate::GetCurrent()->GetData());
+    if (pi == NULL) return;
+    boost::mutex::scoped_lock lock(pi->statsMutex);
+    pi->gcStart = Timer::now();
+}
+
+void JSIsolatePool::gcEpilogue(v8::GCType type, v8::GCCallbackFlags flags) {
+    PooledIsolate* pi = static_cast<PooledIsolate*>(v8::Isolate::GetCurrent()->GetData());
+    if (pi == NULL) return;
+
+    v8::HeapStatistics heap_stats;
+    v8::V8::GetHeapStatistics(&heap_stats);
+
+    boost::mutex::scoped_lock lock(pi->statsMutex);
+    Duration gc_time = Timer::now() - pi->gcStart;
+    pi->gcCount++;
+    pi->gcTime += gc_time;
+    if (gc_time > pi->gcMax) pi->gcMax = gc_time;
+    pi->heapUsed = heap_stats.used_heap_size();
+    pi->heapTotal = heap_stats.total_heap_size();
+}
+
+void JSIsolatePool::commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    Command::Result result = Command::EmptyResult();
+    result.put("isolates", Command::Array());
+    Command::Array& isolates_ary = result.getArray("isolates");
+
+    boost::mutex::scoped_lock lock(mMutex);
+
+    uint32 total_scripts = 0;
+    uint64 total_heap_used = 0, total_heap_size = 0;
+    Time now = Timer::now();
+    for(IsolateMap::iterator it = mIsolates.begin(); it != mIsolates.end(); it++) {
+        PooledIsolate* pi = it->second;
+        total_scripts += pi->scripts;
+
+        boost::mutex::scoped_lock stats_lock(pi->statsMutex);
+        total_heap_used += pi->heapUsed;
+        total_heap_size += pi->heapTotal;
+
+        isolates_ary.push_back(Command::Object());
+        isolates_ary.back().put("id", pi->id);
+        isolates_ary.back().put("dedicated", pi->dedicated);
+        isolates_ary.back().put("age", (now - pi->created).toSeconds());
+        isolates_ary.back().put("scripts", pi->scripts);
+        isolates_ary.back().put("total_scripts", pi->totalScripts);
+        isolates_ary.back().put("heap.used", pi->heapUsed);
+        isolates_ary.back().put("heap.total", pi->heapTotal);
+        isolates_ary.back().put("gc.count", pi->gcCount);
+        isolates_ary.back().put("gc.time.total", pi->gcTime.toMilliseconds());
+        isolates_ary.back().put("gc.time.max", pi->gcMax.toMilliseconds());
+        isolates_ary.back().put("gc.time.avg", pi->gcCount > 0 ? (pi->gcTime.toMilliseconds() / pi->gcCount) : 0);
+    }
+
+    result.put("stats.size", mSize);
+    result.put("stats.isolates", (uint32)mIsolates.size());
+    result.put("stats.created", mIsolatesCreated);
+    result.put("stats.scripts", total_scripts);
+    // Heap sizes are as of each isolate's last GC
+    result.put("stats.heap.used", total_heap_used);
+    result.put("stats.heap.total", total_heap_size);
+
+    cmdr->result(cmdid, result);
+}
+
+} // namespace JS
+} // namespace Sirikata
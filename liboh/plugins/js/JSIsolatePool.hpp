@@ -0,0 +1,97 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_JS_ISOLATE_POOL_HPP_
+#define _SIRIKATA_JS_ISOLATE_POOL_HPP_
+
+#include "Platform.hpp"
+#include <sirikata/core/service/Context.hpp>
+#include <sirikata/core/command/Command.hpp>
+#include <boost/thread/mutex.hpp>
+#include <v8.h>
+
+namespace Sirikata {
+namespace JS {
+
+class JSCtx;
+
+/** Hands out JSCtxs for scripts, sharing v8 isolates between them.
+ *
+ *  Creating an isolate and building all the templates scripts need is by far
+ *  the most expensive part of starting a script. With a non-zero size, the
+ *  pool keeps up to that many isolates, each with a single copy of the
+ *  templates and a single pair of strands, and new scripts are assigned to
+ *  the least loaded one so starting a script only requires a new v8 context.
+ *  Scripts in the same isolate are serialized by the isolate's lock and
+ *  strands, so the pool size bounds how many scripts can run in parallel.
+ *
+ *  With size 0, every script gets its own isolate which is disposed of with
+ *  the script.
+ */
+class JSIsolatePool {
+public:
+    // Fills in all the templates of a new isolate's root JSCtx. Invoked with
+    // the isolate locked and entered and a HandleScope set up.
+    typedef std::tr1::function<void(JSCtx*)> TemplateInitializer;
+
+    JSIsolatePool(Context* ctx, uint32 size, TemplateInitializer init);
+    ~JSIsolatePool();
+
+    /** Get a JSCtx for a new script. name is used to label the strands of
+     *  dedicated isolates. The returned JSCtx should just be deleted when the
+     *  script is done with it.
+     */
+    JSCtx* acquire(const String& name);
+    // Invoked by JSCtx when a context created by acquire is destroyed
+    void release(JSCtx* ctx);
+
+    // Reports per-isolate load, heap and GC statistics.
+    void commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
+
+private:
+    struct PooledIsolate {
+        PooledIsolate(uint32 id_, JSCtx* root_, bool dedicated_);
+
+        const uint32 id;
+        JSCtx* const root;
+        const bool dedicated;
+        const Time created;
+        // Protected by the pool's mutex
+        uint32 scripts;
+        uint64 totalScripts;
+
+        // GC statistics are updated from whichever thread is running the
+        // isolate, so they get their own lock.
+        boost::mutex statsMutex;
+        uint32 gcCount;
+        Duration gcTime;
+        Duration gcMax;
+        Time gcStart;
+        uint64 heapUsed;
+        uint64 heapTotal;
+    };
+    typedef std::tr1::unordered_map<JSCtx*, PooledIsolate*> IsolateMap;
+
+    // Must be called with mMutex held
+    PooledIsolate* createIsolate(const String& name, bool dedicated);
+    PooledIsolate* leastLoaded();
+    static void destroyIsolate(PooledIsolate* pi);
+
+    static void gcPrologue(v8::GCType type, v8::GCCallbackFlags flags);
+    static void gcEpilogue(v8::GCType type, v8::GCCallbackFlags flags);
+
+    Context* mContext;
+    const uint32 mSize;
+    TemplateInitializer mInitTemplates;
+
+    boost::mutex mMutex;
+    IsolateMap mIsolates;
+    uint32 mNextID;
+    uint64 mIsolatesCreated;
+};
+
+} // namespace JS
+} // namespace Sirikata
+
+#endif //_SIRIKATA_JS_ISOLATE_POOL_HPP_
@@ -54,6 +54,7 @@
 #include <set>
 #include "JSObjects/JSFields.hpp"
 #include "emerson/EmersonUtil.h"
+#include "EmersonCompileCache.hpp"
 #include "emerson/EmersonException.h"
 #include "emerson/Util.h"
 #include "JSSystemNames.hpp"
@@ -1205,6 +1206,39 @@ void handleEmersonRecognitionError(struct ANTLR3_BASE_RECOGNIZER_struct* recogni
     pANTLR3_EXCEPTION exception = recognizer->state->exception;
     throw EmersonParserException(exception->line, exception->charPositionInLine, (const char*)exception->message);
 }
+
+// Compiles Emerson to JS, reusing the result of compiling identical source if
+// it's still in the compile cache. Throws EmersonParserException on syntax
+// errors and returns an empty pointer for any other failure. script_name is
+// only used for error messages, so it isn't part of the cache key.
+EmersonCompileCache::EntryPtr compileEmerson(const String& script_name, const String& em_script_str) {
+    EmersonCompileCache& cache = EmersonCompileCache::getSingleton();
+    EmersonCompileCache::EntryPtr cached = cache.get(em_script_str);
+    if (cached) return cached;
+
+    emerson_init();
+
+    std::tr1::shared_ptr<EmersonCompileCache::Entry> compiled(new EmersonCompileCache::Entry());
+    int em_compile_err = 0;
+    bool successfullyCompiled = EmersonUtil::emerson_compile(
+        script_name, em_script_str.c_str(),
+        compiled->js, em_compile_err, handleEmersonRecognitionError,
+        &compiled->lineMap);
+    if (!successfullyCompiled)
+        return EmersonCompileCache::EntryPtr();
+
+    // Preparsing is cheap compared to the Emerson compiler and lets every
+    // script that uses this entry skip it.
+    v8::ScriptData* preparse = v8::ScriptData::PreCompile(compiled->js.c_str(), compiled->js.size());
+    if (preparse != NULL) {
+        if (!preparse->HasError())
+            compiled->preparseData.assign(preparse->Data(), preparse->Length());
+        delete preparse;
+    }
+
+    cache.put(em_script_str, compiled);
+    return compiled;
+}
 }
 
 v8::Handle<v8::Value> JSObjectScript::emersonCompileString(const String& toCompile)
@@ -1212,26 +1246,18 @@ v8::Handle<v8::Value> JSObjectScript::emersonCompileString(const String& toCompi
     JSSCRIPT_SERIAL_CHECK();
     HandleScope handle_scope;
     String em_script_str = toCompile;
-    EmersonLineMap lineMap;
 
     if(em_script_str.size() > 0 &&em_script_str.at(em_script_str.size() -1) != '\n')
         em_script_str.push_back('\n');
 
-    emerson_init();
-
     try {
-        int em_compile_err = 0;
+        EmersonCompileCache::EntryPtr compiled =
+            compileEmerson(String("eval statement"), em_script_str);
 
-        String js_script_str;
-        bool successfullyCompiled = EmersonUtil::emerson_compile(
-            String("eval statement"), em_script_str.c_str(),
-            js_script_str, em_compile_err, handleEmersonRecognitionError,
-            &lineMap);
-
-        if (successfullyCompiled)
+        if (compiled)
         {
-            JSLOG(insane, " Compiled JS script = \n" <<js_script_str);
-            return v8::String::New(js_script_str.c_str());
+            JSLOG(insane, " Compiled JS script = \n" <<compiled->js);
+            return v8::String::New(compiled->js.c_str(), compiled->js.size());
         }
     }
     catch(EmersonParserException e)
@@ -1272,6 +1298,8 @@ v8::Handle<v8::Value> JSObjectScript::internalEval(const String& em_script_str,
 
     // Special casing emerson compilation
     v8::Handle<v8::String> source;
+    // Preparse data from the compile cache, if we have any
+    v8::ScriptData* pre_data = NULL;
 #ifdef EMERSON_COMPILE
     if (is_emerson)
     {
@@ -1291,25 +1319,22 @@ v8::Handle<v8::Value> JSObjectScript::internalEval(const String& em_script_str,
             em_script_str_new.push_back('\n');
         }
 
-        emerson_init();
-
         JSLOG(insane, " Input Emerson script = \n" <<em_script_str_new);
 
         try {
-            int em_compile_err = 0;
             v8::String::Utf8Value parent_script_name(em_script_name->ResourceName());
 
-            String js_script_str;
-            bool successfullyCompiled = EmersonUtil::emerson_compile(
-                FromV8String(parent_script_name), em_script_str_new.c_str(),
-                js_script_str, em_compile_err, handleEmersonRecognitionError,
-                &lineMap);
-
+            EmersonCompileCache::EntryPtr compiled =
+                compileEmerson(FromV8String(parent_script_name), em_script_str_new);
 
-            if (successfullyCompiled)
+            if (compiled)
             {
+                const String& js_script_str = compiled->js;
                 JSLOG(insane, " Compiled JS script = \n" <<js_script_str);
-                source = v8::String::New(js_script_str.c_str());
+                source = v8::String::New(js_script_str.c_str(), js_script_str.size());
+                lineMap = compiled->lineMap;
+                if (!compiled->preparseData.empty())
+                    pre_data = v8::ScriptData::New(compiled->preparseData.data(), compiled->preparseData.size());
 
                 // Save the compiled file as a cache
                 if (!cache_path.empty()) {
@@ -1365,7 +1390,8 @@ v8::Handle<v8::Value> JSObjectScript::internalEval(const String& em_script_str,
     }
     // Compile
     //note, because using compile command, will run in the mContext context
-    v8::Handle<v8::Script> script = v8::Script::Compile(source, em_script_name);
+    v8::Handle<v8::Script> script = v8::Script::Compile(source, em_script_name, pre_data);
+    delete pre_data;
     if (try_catch.HasCaught()) {
         v8::String::Utf8Value error(try_catch.Exception());
         String uncaught( *error);
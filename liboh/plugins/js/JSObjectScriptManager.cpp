@@ -53,15 +53,19 @@
 #include "JSObjects/JSContext.hpp"
 
 #include "JSLogging.hpp"
+#include "JSIsolatePool.hpp"
+#include "EmersonCompileCache.hpp"
 
 #include <sirikata/core/network/IOService.hpp>
 #include <sirikata/core/network/IOWork.hpp>
+#include <sirikata/core/network/IOStrandImpl.hpp>
 #include <sirikata/mesh/ModelsSystemFactory.hpp>
 #include <sirikata/mesh/CompositeFilter.hpp>
 
 #include <sirikata/core/transfer/AggregatedTransferPool.hpp>
 
 #include <sirikata/core/util/Paths.hpp>
+#include <sirikata/core/command/Commander.hpp>
 
 
 namespace Sirikata {
@@ -77,6 +81,7 @@ ObjectScriptManager* JSObjectScriptManager::createObjectScriptManager(ObjectHost
 
 JSObjectScriptManager::JSObjectScriptManager(ObjectHostContext* ctx, const Sirikata::String& arguments)
  : mContext(ctx),
+   mIsolatePool(NULL),
    mTransferPool(),
    mParsingIOService(NULL),
    mParsingWork(NULL),
@@ -114,6 +119,8 @@ JSObjectScriptManager::JSObjectScriptManager(ObjectHostContext* ctx, const Sirik
     OptionValue* import_paths;
     OptionValue* v8_flags_opt;
     OptionValue* emer_resource_max;
+    OptionValue* isolate_pool_size;
+    OptionValue* compile_cache_size;
     InitializeClassOptions(
         "jsobjectscriptmanager",this,
         // Default value allows us to use std libs in the build tree, starting
@@ -133,6 +140,8 @@ JSObjectScriptManager::JSObjectScriptManager(ObjectHostContext* ctx, const Sirik
         import_paths = new OptionValue("import-paths","",OptionValueType<std::list<String> >(),"Comma separated list of paths to import files from, searched in order for the requested import."),
         v8_flags_opt = new OptionValue("v8-flags", "", OptionValueType<String>(), "Flags to pass on to v8, e.g. for profiling."),
         emer_resource_max = new OptionValue("emer-resource-max","100000000",OptionValueType<int>(),"int32: how many cycles to allow to run in one pass of event loop before throwing resource error in Emerson."),
+        isolate_pool_size = new OptionValue("isolate-pool-size","0",OptionValueType<uint32>(),"Number of v8 isolates to share between all scripts. Scripts sharing an isolate don't run in parallel, but are much cheaper to create. 0 gives each script its own isolate."),
+        compile_cache_size = new OptionValue("compile-cache-size","67108864",OptionValueType<uint64>(),"Maximum size in bytes of the in-memory cache of compiled Emerson, shared by all scripts. 0 disables the cache."),
         NULL
     );
 
@@ -143,6 +152,26 @@ JSObjectScriptManager::JSObjectScriptManager(ObjectHostContext* ctx, const Sirik
     if (!v8_flags.empty()) {
         v8::V8::SetFlagsFromString(v8_flags.c_str(), v8_flags.size());
     }
+
+    EmersonCompileCache::getSingleton().setCapacity(compile_cache_size->as<uint64>());
+
+    if (mContext != NULL) {
+        mIsolatePool = new JSIsolatePool(
+            mContext, isolate_pool_size->as<uint32>(),
+            std::tr1::bind(&JSObjectScriptManager::createTemplates, this, std::tr1::placeholders::_1)
+        );
+
+        if (mContext->commander() != NULL) {
+            mContext->commander()->registerCommand(
+                "oh.js.isolates",
+                mContext->mainStrand->wrap(std::tr1::bind(&JSIsolatePool::commandStats, mIsolatePool, std::tr1::placeholders::_1, std::tr1::placeholders::_2, std::tr1::placeholders::_3))
+            );
+            mContext->commander()->registerCommand(
+                "oh.js.compile-cache",
+                std::tr1::bind(&EmersonCompileCache::commandStats, &EmersonCompileCache::getSingleton(), std::tr1::placeholders::_1, std::tr1::placeholders::_2, std::tr1::placeholders::_3)
+            );
+        }
+    }
 }
 
 /*
@@ -187,20 +216,14 @@ void JSObjectScriptManager::createUtilTemplate(JSCtx* jsctx)
 
 
 
-//these templates involve vec, quat, pattern, etc.
 JSCtx* JSObjectScriptManager::createJSCtx(HostedObjectPtr ho)
 {
-    JSCtx* jsctx =
-        new JSCtx(mContext,
-            Network::IOStrandPtr(
-                mContext->ioService->createStrand("EmersonScript " + ho->id().toString())),
-            Network::IOStrandPtr(
-                mContext->ioService->createStrand("VisManager "    + ho->id().toString())),
-            v8::Isolate::New());
-
-    v8::Locker locker (jsctx->mIsolate);
-    v8::Isolate::Scope iscope(jsctx->mIsolate);
-    v8::HandleScope handle_scope;
+    return mIsolatePool->acquire(ho->id().toString());
+}
+
+//these templates involve vec, quat, pattern, etc.
+void JSObjectScriptManager::createTemplates(JSCtx* jsctx)
+{
     jsctx->mVec3Template = v8::Persistent<v8::FunctionTemplate>::New(CreateVec3Template());
     jsctx->mQuaternionTemplate  = v8::Persistent<v8::FunctionTemplate>::New(CreateQuaternionTemplate());
 
@@ -212,8 +235,6 @@ JSCtx* JSObjectScriptManager::createJSCtx(HostedObjectPtr ho)
     createSystemTemplate(jsctx);
     createContextTemplate(jsctx);
     createContextGlobalTemplate(jsctx);
-
-    return jsctx;
 }
 
 
@@ -244,6 +265,8 @@ void JSObjectScriptManager::createSystemTemplate(JSCtx* jsctx)
 
     jsctx->mSystemTemplate->Set(v8::String::New("registerProxAddedHandler"),v8::FunctionTemplate::New(JSSystem::root_proxAddedHandler));
     jsctx->mSystemTemplate->Set(v8::String::New("registerProxRemovedHandler"),v8::FunctionTemplate::New(JSSystem::root_proxRemovedHandler));
+    jsctx->mSystemTemplate->Set(v8::String::New("registerProxAddedBatchHandler"),v8::FunctionTemplate::New(JSSystem::root_proxAddedBatchHandler));
+    jsctx->mSystemTemplate->Set(v8::String::New("registerProxRemovedBatchHandler"),v8::FunctionTemplate::New(JSSystem::root_proxRemovedBatchHandler));
 
 
     jsctx->mSystemTemplate->Set(v8::String::New("headless"),v8::FunctionTemplate::New(JSSystem::root_headless));
@@ -595,6 +618,11 @@ JSObjectScriptManager::~JSObjectScriptManager()
 {
     if (mContext != NULL) {
         // These only allocated if we're not headless.
+        if (mContext->commander() != NULL) {
+            mContext->commander()->unregisterCommand("oh.js.isolates");
+            mContext->commander()->unregisterCommand("oh.js.compile-cache");
+        }
+        delete mIsolatePool;
 
         mParsingThread->join();
         delete mParsingThread;
@@ -52,6 +52,7 @@ namespace JS {
 
 class JSObjectScript;
 class JSCtx;
+class JSIsolatePool;
 class SIRIKATA_SCRIPTING_JS_EXPORT JSObjectScriptManager : public ObjectScriptManager {
 public:
     static ObjectScriptManager* createObjectScriptManager(ObjectHostContext* ctx, const Sirikata::String& arguments);
@@ -84,8 +85,13 @@ private:
     void createSystemTemplate(JSCtx*);
     void createTimerTemplate(JSCtx*);
     void createContextGlobalTemplate(JSCtx*);
+    // Builds all the templates for a new isolate
+    void createTemplates(JSCtx*);
     JSCtx* createJSCtx(HostedObjectPtr);
 
+    // Isolates (and their templates) are shared between scripts
+    JSIsolatePool* mIsolatePool;
+
 
     OptionSet* mOptions;
 
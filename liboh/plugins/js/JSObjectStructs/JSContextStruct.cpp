@@ -201,6 +201,43 @@ void JSContextStruct::proximateEvent(const SpaceObjectReference& goneFrom,
 }
 
 
+void JSContextStruct::proximateBatchEvent(const SpaceObjectReference& querier,
+    const std::vector<SpaceObjectReference>& added,
+    const std::vector<SpaceObjectReference>& removed)
+{
+    if (getIsSuspended() || getIsCleared())
+        return;
+
+    CHECK_EMERSON_SCRIPT_RETURN(emerScript,notifyProximateBatch,jsObjScript);
+
+    if (!(((associatedPresence != NULL) &&
+            (associatedPresence->getSporef() == querier)) ||
+            hasPresence(querier)))
+        return;
+
+    static const std::vector<SpaceObjectReference> none;
+    const std::vector<SpaceObjectReference>* toAdd = &added;
+    const std::vector<SpaceObjectReference>* toRemove = &removed;
+
+    if (cbOnConnected.IsEmpty() && !added.empty())
+    {
+        JSLOG(warn,"Ignoring proximity additions because have no callback");
+        toAdd = &none;
+    }
+
+    if (cbOnDisconnected.IsEmpty() && !removed.empty())
+    {
+        JSLOG(warn,"Ignoring proximity removals because have no callback");
+        toRemove = &none;
+    }
+
+    if (toAdd->empty() && toRemove->empty())
+        return;
+
+    emerScript->fireProxBatchEvent(querier, *toAdd, *toRemove, this);
+}
+
+
 v8::Handle<v8::Value> JSContextStruct::struct_evalInGlobal(const String& native_contents, ScriptOrigin* sOrigin)
 {
     return jsObjScript->evalInGlobal(native_contents,sOrigin,this);
@@ -308,6 +345,24 @@ v8::Handle<v8::Value> JSContextStruct::proxRemovedHandlerCallallback(v8::Handle<
     return v8::Undefined();
 }
 
+v8::Handle<v8::Value> JSContextStruct::proxAddedBatchHandlerCallallback(v8::Handle<v8::Function>cb)
+{
+    if (!proxAddedBatchFunc.IsEmpty())
+        proxAddedBatchFunc.Dispose();
+
+    proxAddedBatchFunc = v8::Persistent<v8::Function>::New(cb);
+    return v8::Undefined();
+}
+
+v8::Handle<v8::Value> JSContextStruct::proxRemovedBatchHandlerCallallback(v8::Handle<v8::Function>cb)
+{
+    if (!proxRemovedBatchFunc.IsEmpty())
+        proxRemovedBatchFunc.Dispose();
+
+    proxRemovedBatchFunc = v8::Persistent<v8::Function>::New(cb);
+    return v8::Undefined();
+}
+
 v8::Handle<v8::Value> JSContextStruct::killEntity()
 {
     //checks to make sure executing killEntity from a non-headless script
@@ -493,29 +548,8 @@ v8::Handle<v8::Value> JSContextStruct::deserialize(const String& toDeserialize)
     CHECK_EMERSON_SCRIPT_ERROR(emerScript,deserialize,jsObjScript);
 
 
-    Sirikata::JS::Protocol::JSMessage js_msg;
-    bool parsed = js_msg.ParseFromString(toDeserialize);
-
-    if (parsed)
-    {
-        bool deserializedSuccess;
-        v8::Handle<v8::Object> obj = JSSerializer::deserializeObject(emerScript, js_msg,deserializedSuccess);
-
-        if (!deserializedSuccess)
-            return v8::ThrowException( v8::Exception::Error(v8::String::New("Error could not deserialize object")));
-
-        return handle_scope.Close(obj);
-    }
-
-    //if it does not parse as a js_msg, then we should try to parse it as a
-    //jsfieldval
-    Sirikata::JS::Protocol::JSFieldValue jsFieldVal;
-    parsed = jsFieldVal.ParseFromString(toDeserialize);
-    if (!parsed)
-        return v8::ThrowException( v8::Exception::Error(v8::String::New("Error could not parse string.")));
-
     bool deserializedSuccess = false;
-    v8::Handle<v8::Value> returner = JSSerializer::deserializeMessage(emerScript, jsFieldVal, deserializedSuccess);
+    v8::Handle<v8::Value> returner = JSSerializer::deserialize(emerScript, toDeserialize, deserializedSuccess);
 
     if (!deserializedSuccess)
             return v8::ThrowException( v8::Exception::Error(v8::String::New("Error could not deserialize object")));
@@ -617,6 +651,18 @@ v8::Handle<v8::Value> JSContextStruct::struct_rootReset()
     systemObj.Dispose();
     mContext.Dispose();
 
+    //batch handlers are optional, so the reset script may not set them again
+    if (!proxAddedBatchFunc.IsEmpty())
+    {
+        proxAddedBatchFunc.Dispose();
+        proxAddedBatchFunc.Clear();
+    }
+    if (!proxRemovedBatchFunc.IsEmpty())
+    {
+        proxRemovedBatchFunc.Dispose();
+        proxRemovedBatchFunc.Clear();
+    }
+
     inClear = false;
     //recreate system and mcontext objects
     v8::HandleScope handle_scope;
@@ -756,6 +802,11 @@ void JSContextStruct::finishClear()
     if (!presenceMessageCallback.IsEmpty())
         presenceMessageCallback.Dispose();
 
+    if (!proxAddedBatchFunc.IsEmpty())
+        proxAddedBatchFunc.Dispose();
+    if (!proxRemovedBatchFunc.IsEmpty())
+        proxRemovedBatchFunc.Dispose();
+
 
     mContext.Dispose();
     inClear = false;
@@ -94,6 +94,15 @@ struct JSContextStruct : public JSSuspendable, public Liveness
     void proximateEvent(const SpaceObjectReference& goneFrom,
         JSVisibleStruct* jsvis,bool isGone);
 
+    /**
+       Same checks as proximateEvent, but for all the additions and removals
+       of a single proximity update to querier's result set, which are then
+       fired together.
+     */
+    void proximateBatchEvent(const SpaceObjectReference& querier,
+        const std::vector<SpaceObjectReference>& added,
+        const std::vector<SpaceObjectReference>& removed);
+
 
     v8::Handle<v8::Value> pushEvalContextScopeDirectory(const String& newDir);
     v8::Handle<v8::Value> popEvalContextScopeDirectory();
@@ -225,6 +234,9 @@ struct JSContextStruct : public JSSuspendable, public Liveness
     //sets proxAddedFunc and proxRemovedFunc, respectively
     v8::Handle<v8::Value> proxAddedHandlerCallallback(v8::Handle<v8::Function>cb);
     v8::Handle<v8::Value> proxRemovedHandlerCallallback(v8::Handle<v8::Function>cb);
+    //sets proxAddedBatchFunc and proxRemovedBatchFunc, respectively
+    v8::Handle<v8::Value> proxAddedBatchHandlerCallallback(v8::Handle<v8::Function>cb);
+    v8::Handle<v8::Value> proxRemovedBatchHandlerCallallback(v8::Handle<v8::Function>cb);
 
 
     v8::Handle<v8::Value> getAssociatedPresence();
@@ -236,6 +248,10 @@ struct JSContextStruct : public JSSuspendable, public Liveness
 
     v8::Persistent<v8::Function>proxAddedFunc;
     v8::Persistent<v8::Function>proxRemovedFunc;
+    //If set, take precedence over proxAddedFunc and proxRemovedFunc and get
+    //called once per proximity update with an array of visibles.
+    v8::Persistent<v8::Function>proxAddedBatchFunc;
+    v8::Persistent<v8::Function>proxRemovedBatchFunc;
 
 
    /**
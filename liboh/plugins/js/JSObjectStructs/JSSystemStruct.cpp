@@ -138,6 +138,14 @@ v8::Handle<v8::Value> JSSystemStruct::proxRemovedHandlerCallallback(v8::Handle<v
 {
     return associatedContext->proxRemovedHandlerCallallback(cb);
 }
+v8::Handle<v8::Value> JSSystemStruct::proxAddedBatchHandlerCallallback(v8::Handle<v8::Function>cb)
+{
+    return associatedContext->proxAddedBatchHandlerCallallback(cb);
+}
+v8::Handle<v8::Value> JSSystemStruct::proxRemovedBatchHandlerCallallback(v8::Handle<v8::Function>cb)
+{
+    return associatedContext->proxRemovedBatchHandlerCallallback(cb);
+}
 
 
 v8::Handle<v8::Value> JSSystemStruct::killEntity()
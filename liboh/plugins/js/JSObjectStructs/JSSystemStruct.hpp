@@ -30,6 +30,8 @@ struct JSSystemStruct
 
     v8::Handle<v8::Value> proxAddedHandlerCallallback(v8::Handle<v8::Function>cb);
     v8::Handle<v8::Value> proxRemovedHandlerCallallback(v8::Handle<v8::Function>cb);
+    v8::Handle<v8::Value> proxAddedBatchHandlerCallallback(v8::Handle<v8::Function>cb);
+    v8::Handle<v8::Value> proxRemovedBatchHandlerCallallback(v8::Handle<v8::Function>cb);
 
     //regular members
     v8::Handle<v8::Value> struct_canSendMessage();
@@ -611,6 +611,56 @@ v8::Handle<v8::Value> root_proxRemovedHandler(const v8::Arguments& args)
 }
 
 
+/**
+   Registers a function that receives all the proximity additions from a
+   single update at once. It's called with an array of visibles and the
+   sporef of the presence they're visible to, and replaces per-object calls
+   to the handler registered with registerProxAddedHandler.
+ */
+v8::Handle<v8::Value> root_proxAddedBatchHandler(const v8::Arguments& args)
+{
+    if (args.Length() != 1)
+        return v8::ThrowException( v8::Exception::Error(v8::String::New("Error registering prox added batch handler requires one argument <function>")));
+
+    String errMsg = "Error decoding system struct when registering prox added batch handler. ";
+    JSSystemStruct* jssys  = JSSystemStruct::decodeSystemStruct(args.This(),errMsg);
+
+    if (jssys == NULL)
+        return v8::ThrowException( v8::Exception::Error(v8::String::New( errMsg.c_str())));
+
+
+    v8::Handle<v8::Value> cbVal = args[0];
+    if (!cbVal -> IsFunction())
+        return v8::ThrowException( v8::Exception::Error(v8::String::New( "Error in prox added batch handler.  First argument should be a function.")));
+
+    v8::Handle<v8::Function> cb = v8::Handle<v8::Function>::Cast(cbVal);
+    return jssys->proxAddedBatchHandlerCallallback(cb);
+}
+
+/**
+   Removal counterpart of root_proxAddedBatchHandler.
+ */
+v8::Handle<v8::Value> root_proxRemovedBatchHandler(const v8::Arguments& args)
+{
+    if (args.Length() != 1)
+        return v8::ThrowException( v8::Exception::Error(v8::String::New("Error registering prox removed batch handler requires one argument <function>")));
+
+    String errMsg = "Error decoding system struct when registering prox removed batch handler. ";
+    JSSystemStruct* jssys  = JSSystemStruct::decodeSystemStruct(args.This(),errMsg);
+
+    if (jssys == NULL)
+        return v8::ThrowException( v8::Exception::Error(v8::String::New( errMsg.c_str())));
+
+
+    v8::Handle<v8::Value> cbVal = args[0];
+    if (!cbVal -> IsFunction())
+        return v8::ThrowException( v8::Exception::Error(v8::String::New( "Error in prox removed batch handler.  First argument should be a function.")));
+
+    v8::Handle<v8::Function> cb = v8::Handle<v8::Function>::Cast(cbVal);
+    return jssys->proxRemovedBatchHandlerCallallback(cb);
+}
+
+
 
 v8::Handle<v8::Value> root_deserialize(const v8::Arguments& args)
 {
@@ -26,18 +26,6 @@ namespace Sirikata{
 namespace JS{
 
 
-void annotateMessage(Sirikata::JS::Protocol::JSMessage& toAnnotate,int32 &toStampWith)
-{
-    toAnnotate.set_msg_id(toStampWith);
-    ++toStampWith;
-}
-void annotateMessage(Sirikata::JS::Protocol::IJSMessage& toAnnotate, int32&toStampWith)
-{
-    toAnnotate.set_msg_id(toStampWith);
-    ++toStampWith;
-}
-
-
 //Runs through all the objects in the object vector toUnmark.  For each of these
 //objects, calls DeleteHiddenValue on each of them.
 void JSSerializer::unmarkSerialized(ObjectVec& toUnmark)
@@ -75,117 +63,6 @@ void JSSerializer::unmarkDeserialized(ObjectMap& objMap)
 
 
 
-//Points the jsf_value to int32ToPointTo
-void JSSerializer::pointOtherObject(int32 int32ToPointTo,Sirikata::JS::Protocol::IJSFieldValue& jsf_value)
-{
-    jsf_value.set_loop_pointer(int32ToPointTo);
-}
-
-
-
-void JSSerializer::serializeSystem(v8::Local<v8::Object> jsSystem, Sirikata::JS::Protocol::IJSMessage& jsmessage,int32& toStampWith,ObjectVec& allObjs)
-{
-    std::string err_msg;
-
-    annotateMessage(jsmessage,toStampWith);
-
-    JSSystemStruct* sys_struct = JSSystemStruct::decodeSystemStruct(jsSystem, err_msg);
-    if(err_msg.size() > 0) {
-        SILOG(js, error, "Could not decode system in JSSerializer::serializeSystem: "+ err_msg );
-        return;
-    }
-
-    Sirikata::JS::Protocol::IJSField jsf = jsmessage.add_fields();
-    jsf.set_name(TYPEID_FIELD_NAME);
-    Sirikata::JS::Protocol::IJSFieldValue jsf_value = jsf.mutable_value();
-    jsf_value.set_s_value(SYSTEM_TYPEID_STRING);
-}
-
-
-void JSSerializer::serializeVisible(v8::Local<v8::Object> jsVisible, Sirikata::JS::Protocol::IJSMessage&jsmessage,int32& toStampWith,ObjectVec& allObjs)
-{
-  std::string err_msg;
-  annotateMessage(jsmessage,toStampWith);
-
-  JSVisibleStruct* vstruct = JSVisibleStruct::decodeVisible(jsVisible, err_msg);
-  if(err_msg.size() > 0)
-  {
-    SILOG(js, error, "Could not decode Visible in JSSerializer::serializeVisible: "+ err_msg );
-    return ;
-  }
-
-  SpaceObjectReference sporef       =      vstruct->getSporef();
-
-  fillVisible(jsmessage, sporef);
-}
-
-
-void JSSerializer::fillVisible(Sirikata::JS::Protocol::IJSMessage& jsmessage, const SpaceObjectReference& listenTo)
-{
-  // serialize SpaceObjectReference
-  Sirikata::JS::Protocol::IJSField jsf = jsmessage.add_fields();
-  jsf.set_name(TYPEID_FIELD_NAME);
-  Sirikata::JS::Protocol::IJSFieldValue jsf_value = jsf.mutable_value();
-  jsf_value.set_s_value(VISIBLE_TYPEID_STRING);
-
-  jsf = jsmessage.add_fields();
-  jsf.set_name(VISIBLE_SPACEOBJREF_STRING);
-  jsf_value = jsf.mutable_value();
-  jsf_value.set_s_value(listenTo.toString());
-
-}
-
-void JSSerializer::serializePresence(v8::Local<v8::Object> jsPresence, Sirikata::JS::Protocol::IJSMessage&jsmessage,int32& toStampWith,ObjectVec& allObjs)
-{
-  std::string err_msg;
-  annotateMessage(jsmessage,toStampWith);
-
-  JSPresenceStruct* presStruct = JSPresenceStruct::decodePresenceStruct(jsPresence, err_msg);
-  if(err_msg.size() > 0)
-  {
-    SILOG(js, error, "Could not decode Presence in JSSerializer::serializePresence: "+ err_msg );
-    return;
-  }
-  fillVisible(jsmessage, presStruct->getSporef());
-}
-
-
-
-std::string JSSerializer::serializeMessage(v8::Local<v8::Value> v8Val, int32 toStamp)
-{
-    ObjectVec allObjs;
-    Sirikata::JS::Protocol::JSFieldValue jsfield;
-    v8::HandleScope handleScope;
-    serializeFieldValueInternal(jsfield,v8Val,toStamp, allObjs);
-
-    String serializedFieldValue;
-    jsfield.SerializeToString(&serializedFieldValue);
-    unmarkSerialized(allObjs);
-    return serializedFieldValue;
-}
-
-
-std::string JSSerializer::serializeObject(v8::Local<v8::Value> v8Val,int32 toStampWith)
-{
-  ObjectVec allObjs;
-  Sirikata::JS::Protocol::JSMessage jsmessage;
-
-  v8::HandleScope handleScope;
-
-  annotateMessage(jsmessage,toStampWith);
-
-  if(v8Val->IsObject())
-      serializeObjectInternal(v8Val, jsmessage,toStampWith,allObjs);
-
-
-  std::string serialized_message;
-  jsmessage.SerializeToString(&serialized_message);
-
-  unmarkSerialized(allObjs);
-  return serialized_message;
-}
-
-
 void debug_printSerialized(Sirikata::JS::Protocol::JSMessage jm, String prepend)
 {
     std::cout<<prepend<<":id: "<<jm.msg_id()<<"\n";
@@ -293,230 +170,262 @@ void JSSerializer::annotateObject(ObjectVec& objVec, v8::Handle<v8::Object> v8Ob
 
 
 
-void JSSerializer::serializeObjectInternal(v8::Local<v8::Value> v8Val, Sirikata::JS::Protocol::IJSMessage& jsmessage,int32 & toStampWith,ObjectVec& objVec)
+/** Walks a v8 value, writing it out in the binary format. Objects are marked
+ *  with a hidden value holding their index as they are written, so later
+ *  references to them become back references. The caller unmarks them once
+ *  the whole message has been written.
+ */
+class JSSerializer::BinaryEncoder
 {
-    //otherwise assuming it is a v8 object for now
-    v8::Local<v8::Object> v8Obj = v8Val->ToObject();
-
-    //stamps message
-    annotateObject(objVec,v8Obj,toStampWith);
-    annotateMessage(jsmessage,toStampWith);
-
-    //if the object is a function, save its function text separately
-    if (v8Obj->IsFunction())
+public:
+    BinaryEncoder(String& buf, ObjectVec& marked)
+     : mWriter(buf),
+       mMarked(marked),
+       mTokenName(v8::String::New(JSSERIALIZER_TOKEN_FIELD_NAME)),
+       mRootObject(v8::Object::New()->GetPrototype())
+    {}
+
+    void writeValue(v8::Handle<v8::Value> val);
+    void writeEmptyObject();
+
+private:
+    void beginObject(v8::Local<v8::Object> obj, JSBinary::Tag tag);
+    void writeObject(v8::Local<v8::Object> obj, JSBinary::Tag tag);
+    // Visibles, presences and systems.
+    void writeInternalObject(v8::Local<v8::Object> obj, v8::Local<v8::Value> typeidVal);
+    void writeFields(v8::Local<v8::Object> obj);
+
+    JSBinary::Writer mWriter;
+    ObjectVec& mMarked;
+    v8::Handle<v8::String> mTokenName;
+    v8::Handle<v8::Value> mRootObject;
+};
+
+void JSSerializer::BinaryEncoder::writeValue(v8::Handle<v8::Value> val)
+{
+    if (val->IsObject())
     {
-        v8::Local<v8::Value> funcTextValue = v8::Handle<v8::Function>::Cast(v8Obj)->ToString();
-        INLINE_STR_CONV(funcTextValue, funcTextStr, "error decoding string when serializing function.");
-        jsmessage.set_f_value(funcTextStr);
-        if (funcTextStr == FUNCTION_CONSTRUCTOR_TEXT)
+        v8::Local<v8::Object> obj = val->ToObject();
+        v8::Local<v8::Value> hiddenValue = obj->GetHiddenValue(mTokenName);
+        if (!hiddenValue.IsEmpty())
+        {
+            //already written this object, just point to it.
+            if (hiddenValue->IsInt32())
+                mWriter.writeBackref(hiddenValue->Int32Value());
+            else
+            {
+                JSLOG(error,"Error in serialization.  Hidden value was not an int32");
+                mWriter.writeTag(JSBinary::TAG_UNDEFINED);
+            }
             return;
+        }
+
+        if (obj->IsFunction())
+            writeObject(obj, JSBinary::TAG_FUNCTION);
+        else if (obj->IsArray())
+            writeObject(obj, JSBinary::TAG_ARRAY);
+        else if (val->StrictEquals(mRootObject))
+            writeObject(obj, JSBinary::TAG_ROOT_OBJECT);
+        else
+            writeObject(obj, JSBinary::TAG_OBJECT);
+    }
+    else if (val->IsNull())
+        mWriter.writeTag(JSBinary::TAG_NULL);
+    else if (val->IsUndefined())
+        mWriter.writeTag(JSBinary::TAG_UNDEFINED);
+    else if (val->IsInt32())
+    {
+        mWriter.writeTag(JSBinary::TAG_INT32);
+        mWriter.writeInt32(val->Int32Value());
+    }
+    else if (val->IsUint32())
+    {
+        mWriter.writeTag(JSBinary::TAG_UINT32);
+        mWriter.writeUint32(val->Uint32Value());
+    }
+    else if (val->IsString())
+    {
+        INLINE_STR_CONV(val,s_value, "error decoding string in serializeMessage");
+        mWriter.writeTag(JSBinary::TAG_STRING);
+        mWriter.writeString(s_value);
+    }
+    else if (val->IsNumber())
+    {
+        mWriter.writeTag(JSBinary::TAG_DOUBLE);
+        mWriter.writeDouble(val->NumberValue());
+    }
+    else if (val->IsBoolean())
+    {
+        mWriter.writeTag(val->BooleanValue() ? JSBinary::TAG_TRUE : JSBinary::TAG_FALSE);
     }
+    else
+    {
+        JSLOG(error, "Unknown type of value in serializeMessage, sending undefined.");
+        mWriter.writeTag(JSBinary::TAG_UNDEFINED);
+    }
+}
 
+void JSSerializer::BinaryEncoder::writeEmptyObject()
+{
+    mWriter.beginObject(JSBinary::TAG_OBJECT);
+    mWriter.endFields();
+}
+
+void JSSerializer::BinaryEncoder::beginObject(v8::Local<v8::Object> obj, JSBinary::Tag tag)
+{
+    uint32 idx = mWriter.beginObject(tag);
+    annotateObject(mMarked, obj, idx);
+}
 
-    if(v8Obj->InternalFieldCount() > 0)
+void JSSerializer::BinaryEncoder::writeObject(v8::Local<v8::Object> obj, JSBinary::Tag tag)
+{
+    if (tag == JSBinary::TAG_OBJECT && obj->InternalFieldCount() > 0)
     {
-        v8::Local<v8::Value> typeidVal = v8Obj->GetInternalField(TYPEID_FIELD);
-        if (!typeidVal.IsEmpty())
+        v8::Local<v8::Value> typeidVal = obj->GetInternalField(TYPEID_FIELD);
+        if (!typeidVal.IsEmpty() && !typeidVal->IsNull() && !typeidVal->IsUndefined())
         {
-            if(!typeidVal->IsNull() && !typeidVal->IsUndefined())
-            {
-                v8::Local<v8::External> wrapped  = v8::Local<v8::External>::Cast(typeidVal);
-                void* ptr = wrapped->Value();
-                std::string* typeId = static_cast<std::string*>(ptr);
-                if(typeId == NULL) return;
-
-                std::string typeIdString = *typeId;
-                if (typeIdString == VISIBLE_TYPEID_STRING)
-                {
-                    serializeVisible(v8Obj, jsmessage,toStampWith,objVec);
-                }
-                else if (typeIdString == SYSTEM_TYPEID_STRING)
-                {
-                    serializeSystem(v8Obj, jsmessage,toStampWith,objVec);
-                }
-                else if (typeIdString == PRESENCE_TYPEID_STRING)
-                {
-                    serializePresence(v8Obj, jsmessage,toStampWith,objVec);
-                }
-                return;
-            }
+            writeInternalObject(obj, typeidVal);
+            return;
         }
     }
 
+    beginObject(obj, tag);
 
-    std::vector<String> properties = getOwnPropertyNames(v8Obj);
-    for( unsigned int i = 0; i < properties.size(); i++)
+    //if the object is a function, save its function text separately
+    if (tag == JSBinary::TAG_FUNCTION)
     {
-        String prop_name = properties[i];
-
-        v8::Local<v8::Value> prop_val;
-
-        if (properties[i] == JSSERIALIZER_PROTOTYPE_NAME)
-            prop_val = v8Obj->GetPrototype();
-        else
-            prop_val = v8Obj->Get( v8::String::New(properties[i].c_str(), properties[i].size()) );
-
-        /* This is a little gross, but currently necessary. If something is
-         * referring to native code, we shouldn't be shipping it. This means we
-         * need to detect native code and drop the field. However, v8 doesn't
-         * provide a way to check for native code. Instead, we need to check for
-         * the { [native code] } definition.
-         *
-         * This is considered bad because of the way we are filtering instead of
-         * detecting native types and . A better approach would work on the
-         * whole-object level, detecting special types and converting them to an
-         * appropriate form for restoration on the remote side. In some cases
-         * this would be seamless (e.g. vec3) and sometimes would require
-         * 'simplification' (e.g. Presence).
-         */
-        if(prop_val->IsFunction())
+        v8::Local<v8::Value> funcTextValue = v8::Handle<v8::Function>::Cast(obj)->ToString();
+        INLINE_STR_CONV(funcTextValue, funcTextStr, "error decoding string when serializing function.");
+        mWriter.writeString(funcTextStr);
+        if (funcTextStr == FUNCTION_CONSTRUCTOR_TEXT)
         {
-            v8::Local<v8::Function> v8Func = v8::Local<v8::Function>::Cast(prop_val);
-            INLINE_STR_CONV(v8Func->ToString(),cStrMsgBody2, "error decoding string in serializeObjectInternal");
-
-            if ((cStrMsgBody2.find("{ [native code] }") != String::npos) &&
-                (cStrMsgBody2 != FUNCTION_CONSTRUCTOR_TEXT))
-            {
-                continue;
-            }
+            mWriter.endFields();
+            return;
         }
-
-        Sirikata::JS::Protocol::IJSField jsf = jsmessage.add_fields();
-        Sirikata::JS::Protocol::IJSFieldValue jsf_value = jsf.mutable_value();
-
-        // create a JSField out of this
-        jsf.set_name(prop_name);
-        serializeFieldValueInternal(jsf_value,prop_val,toStampWith,objVec);
     }
-}
 
+    writeFields(obj);
+}
 
-void JSSerializer::serializeFieldValueInternal(Sirikata::JS::Protocol::IJSFieldValue& jsf_value,
-                                               v8::Handle<v8::Value> prop_val,
-                                               int32 & toStampWith,
-                                               ObjectVec& objVec)
+void JSSerializer::BinaryEncoder::writeInternalObject(v8::Local<v8::Object> obj, v8::Local<v8::Value> typeidVal)
 {
-    /* Check if the value is a function, object, bool, etc. */
-    if(prop_val->IsFunction())
-    {
-        v8::Local<v8::Function> v8Func = v8::Local<v8::Function>::Cast(prop_val->ToObject());
-        v8::Local<v8::Value> hiddenValue = v8Func->GetHiddenValue(v8::String::New(JSSERIALIZER_TOKEN_FIELD_NAME));
+    v8::Local<v8::External> wrapped  = v8::Local<v8::External>::Cast(typeidVal);
+    std::string* typeId = static_cast<std::string*>(wrapped->Value());
+    std::string err_msg;
 
-        if (hiddenValue.IsEmpty())
-        {
-            //means that we have not already stamped this function object
-            //as having been serialized.  need to serialize it now.
-            //annotateObject(objVec,v8Func,toStampWith);
-            Sirikata::JS::Protocol::IJSMessage ijs_m =jsf_value.mutable_o_value();
-            serializeObjectInternal(v8Func, ijs_m, toStampWith,objVec);
-        }
-        else
+    if (typeId != NULL && *typeId == VISIBLE_TYPEID_STRING)
+    {
+        JSVisibleStruct* vstruct = JSVisibleStruct::decodeVisible(obj, err_msg);
+        if (vstruct != NULL)
         {
-            //we have already stamped this function object as having been
-            //serialized.  Instead of serializing it again, point to
-            //the old version.
-
-            if (hiddenValue->IsInt32())
-                pointOtherObject(hiddenValue->ToInt32()->Value(),jsf_value);
-            else
-                JSLOG(error,"Error in serialization.  Hidden value was not an int32");
+            beginObject(obj, JSBinary::TAG_VISIBLE);
+            mWriter.writeString(vstruct->getSporef().toString());
+            return;
         }
+        SILOG(js, error, "Could not decode Visible in JSSerializer: "+ err_msg );
     }
-    else if(prop_val->IsArray())
+    else if (typeId != NULL && *typeId == PRESENCE_TYPEID_STRING)
     {
-        /* If this value is an object , then recursively call the serlialize on this */
-        v8::Local<v8::Array> v8Array = v8::Local<v8::Array>::Cast(prop_val->ToObject());
-        v8::Local<v8::Value> hiddenValue = v8Array->GetHiddenValue(v8::String::New(JSSERIALIZER_TOKEN_FIELD_NAME));
-        if (hiddenValue.IsEmpty())
+        //presences are received as visibles
+        JSPresenceStruct* presStruct = JSPresenceStruct::decodePresenceStruct(obj, err_msg);
+        if (presStruct != NULL)
         {
-            Sirikata::JS::Protocol::IJSMessage ijs_m =jsf_value.mutable_a_value();
-            serializeObjectInternal(v8Array, ijs_m, toStampWith,objVec);
+            beginObject(obj, JSBinary::TAG_VISIBLE);
+            mWriter.writeString(presStruct->getSporef().toString());
+            return;
         }
-        else
+        SILOG(js, error, "Could not decode Presence in JSSerializer: "+ err_msg );
+    }
+    else if (typeId != NULL && *typeId == SYSTEM_TYPEID_STRING)
+    {
+        JSSystemStruct* sys_struct = JSSystemStruct::decodeSystemStruct(obj, err_msg);
+        if (sys_struct != NULL)
         {
-            //we have already stamped this function object as having been
-            //serialized.  Instead of serializing it again, point to
-            //the old version.
-            if (hiddenValue->IsInt32())
-                pointOtherObject(hiddenValue->ToInt32()->Value(),jsf_value);
-            else
-                JSLOG(error,"Error in serialization.  Hidden value was not an int32");
+            beginObject(obj, JSBinary::TAG_SYSTEM);
+            return;
         }
+        SILOG(js, error, "Could not decode system in JSSerializer: "+ err_msg );
     }
 
-    else if (prop_val->IsNull())
-    {
-        jsf_value.set_null_value(true);
-    }
-    else if (prop_val->IsUndefined())
-    {
-        jsf_value.set_undefined_value(true);
-    }
-    else if(prop_val->IsObject())
+    //other native types, or ones we couldn't decode, are sent as empty objects
+    beginObject(obj, JSBinary::TAG_OBJECT);
+    mWriter.endFields();
+}
+
+void JSSerializer::BinaryEncoder::writeFields(v8::Local<v8::Object> obj)
+{
+    std::vector<String> properties = getOwnPropertyNames(obj);
+    for(std::vector<String>::size_type i = 0; i < properties.size(); i++)
     {
-        v8::Local<v8::Object> v8obj = prop_val->ToObject();
+        const String& prop_name = properties[i];
 
-        v8::Local<v8::Value> hiddenValue = v8obj->GetHiddenValue(v8::String::New(JSSERIALIZER_TOKEN_FIELD_NAME));
+        v8::Local<v8::Value> prop_val;
+        if (prop_name == JSSERIALIZER_PROTOTYPE_NAME)
+            prop_val = obj->GetPrototype();
+        else
+            prop_val = obj->Get( v8::String::New(prop_name.c_str(), prop_name.size()) );
 
-        if (hiddenValue.IsEmpty())
+        /* If something is referring to native code, we shouldn't be shipping
+         * it. v8 doesn't provide a way to check for native code, so we check
+         * for the { [native code] } definition and drop the field.
+         */
+        if(prop_val->IsFunction())
         {
-            //check if it's the root object.
-            v8::Handle<v8::Object> tmpObj = v8::Object::New();
+            v8::Local<v8::Function> v8Func = v8::Local<v8::Function>::Cast(prop_val);
+            INLINE_STR_CONV(v8Func->ToString(),funcText, "error decoding string in serializeMessage");
 
-            if (prop_val->Equals(tmpObj->GetPrototype()))
-            {
-                Sirikata::JS::Protocol::IJSMessage ijs_o = jsf_value.mutable_root_object();
-                serializeObjectInternal(v8obj, ijs_o, toStampWith,objVec);;
-            }
-            else
+            if ((funcText.find("{ [native code] }") != String::npos) &&
+                (funcText != FUNCTION_CONSTRUCTOR_TEXT))
             {
-                Sirikata::JS::Protocol::IJSMessage    ijs_o = jsf_value.mutable_o_value();
-                serializeObjectInternal(v8obj, ijs_o, toStampWith,objVec);;
+                continue;
             }
         }
-        else
-        {
-            if (hiddenValue->IsInt32())
-                pointOtherObject(hiddenValue->ToInt32()->Value(),jsf_value);
-            else
-                JSLOG(error,"Error in serialization.  Hidden value was not an int32");
-        }
-    }
-    else if(prop_val->IsInt32())
-    {
-        int32 i_value = prop_val->Int32Value();
-        jsf_value.set_i_value(i_value);
-    }
-    else if(prop_val->IsUint32())
-    {
-        uint32 ui_value = prop_val->Uint32Value();
-        jsf_value.set_ui_value(ui_value);
-    }
-    else if(prop_val->IsString())
-    {
-        INLINE_STR_CONV(prop_val,s_value, "error decoding string in serializeObjectInternal");
-        jsf_value.set_s_value(s_value);
-    }
-    else if(prop_val->IsNumber())
-    {
-        float64 d_value = prop_val->NumberValue();
-        jsf_value.set_d_value(d_value);
-    }
-    else if(prop_val->IsBoolean())
-    {
-        bool b_value = prop_val->BooleanValue();
-        jsf_value.set_b_value(b_value);
+
+        mWriter.writeName(prop_name);
+        writeValue(prop_val);
     }
-    else if(prop_val->IsDate())
+    mWriter.endFields();
+}
+
+
+void JSSerializer::serializeMessage(v8::Local<v8::Value> v8Val, String& buf)
+{
+    v8::HandleScope handleScope;
+    ObjectVec allObjs;
     {
-        JSLOG(error, "Have not yet added serialization for date object directly.");
+        BinaryEncoder encoder(buf, allObjs);
+        encoder.writeValue(v8Val);
     }
-    else if(prop_val->IsRegExp())
+    unmarkSerialized(allObjs);
+}
+
+std::string JSSerializer::serializeMessage(v8::Local<v8::Value> v8Val)
+{
+    String serialized;
+    serializeMessage(v8Val, serialized);
+    return serialized;
+}
+
+void JSSerializer::serializeObject(v8::Local<v8::Value> v8Val, String& buf)
+{
+    v8::HandleScope handleScope;
+    ObjectVec allObjs;
     {
-        JSLOG(error, "Have not yet added serialization for regexp object directly.");
+        BinaryEncoder encoder(buf, allObjs);
+        if (v8Val->IsObject())
+            encoder.writeValue(v8Val);
+        else
+            encoder.writeEmptyObject();
     }
+    unmarkSerialized(allObjs);
 }
 
+std::string JSSerializer::serializeObject(v8::Local<v8::Value> v8Val)
+{
+    String serialized;
+    serializeObject(v8Val, serialized);
+    return serialized;
+}
 
 /**
    This function runs through the map of values toFixUp, pointing them to the
@@ -880,5 +789,294 @@ v8::Handle<v8::Value> JSSerializer::deserializeFieldValue(EmersonScript* emerScr
 }
 
 
+namespace {
+// Limit on nesting of objects in binary messages, protecting the stack from
+// malicious messages.
+const uint32 MAX_DESERIALIZE_DEPTH = 1024;
+}
+
+/** Reads a binary message back into v8 values. Objects are created before
+ *  their fields are read and recorded in the order they appear, so back
+ *  references can be resolved immediately.
+ */
+class JSSerializer::BinaryDecoder
+{
+public:
+    BinaryDecoder(EmersonScript* emerScript, const String& payload)
+     : mScript(emerScript),
+       mReader(payload),
+       mDepth(0)
+    {}
+
+    bool decode(v8::Handle<v8::Value>* result);
+
+private:
+    // backref is set to the index of the object if val was a back reference
+    // and -1 otherwise.
+    bool readValue(v8::Handle<v8::Value>* val, int32* backref);
+    bool readFields(v8::Handle<v8::Object> obj);
+    v8::Handle<v8::Function> createFunction(const String& funcText);
+
+    EmersonScript* mScript;
+    JSBinary::Reader mReader;
+    std::vector<v8::Handle<v8::Object> > mObjects;
+    // Objects whose prototype is a back reference. As with PBJ messages, these
+    // are set up after everything is decoded so the fields copied from the
+    // prototype are complete.
+    std::vector<std::pair<v8::Handle<v8::Object>, int32> > mPrototypeFixups;
+    ObjectVec mRootObjects;
+    uint32 mDepth;
+};
+
+bool JSSerializer::BinaryDecoder::decode(v8::Handle<v8::Value>* result)
+{
+    int32 backref;
+    bool success = mReader.valid() && readValue(result, &backref) && mReader.done();
+
+    if (success)
+    {
+        for(uint32 i = 0; i < mPrototypeFixups.size(); i++)
+            setPrototype(mPrototypeFixups[i].first, mObjects[mPrototypeFixups[i].second]);
+    }
+
+    //remove the hidden values used to notate the root object
+    v8::Handle<v8::String> hiddenFieldName = v8::String::New(JSSERIALIZER_ROOT_OBJ_TOKEN);
+    for(ObjectVecIter iter = mRootObjects.begin(); iter != mRootObjects.end(); ++iter)
+        (*iter)->DeleteHiddenValue(hiddenFieldName);
+
+    return success;
+}
+
+bool JSSerializer::BinaryDecoder::readValue(v8::Handle<v8::Value>* val, int32* backref)
+{
+    *backref = -1;
+
+    JSBinary::Tag tag;
+    if (!mReader.readTag(&tag))
+        return false;
+
+    switch(tag)
+    {
+      case JSBinary::TAG_UNDEFINED:
+        *val = v8::Undefined();
+        return true;
+      case JSBinary::TAG_NULL:
+        *val = v8::Null();
+        return true;
+      case JSBinary::TAG_TRUE:
+        *val = v8::Boolean::New(true);
+        return true;
+      case JSBinary::TAG_FALSE:
+        *val = v8::Boolean::New(false);
+        return true;
+      case JSBinary::TAG_INT32:
+        {
+            int32 i_value;
+            if (!mReader.readInt32(&i_value)) return false;
+            *val = v8::Integer::New(i_value);
+            return true;
+        }
+      case JSBinary::TAG_UINT32:
+        {
+            uint32 ui_value;
+            if (!mReader.readUint32(&ui_value)) return false;
+            *val = v8::Integer::NewFromUnsigned(ui_value);
+            return true;
+        }
+      case JSBinary::TAG_DOUBLE:
+        {
+            float64 d_value;
+            if (!mReader.readDouble(&d_value)) return false;
+            *val = v8::Number::New(d_value);
+            return true;
+        }
+      case JSBinary::TAG_STRING:
+        {
+            String s_value;
+            if (!mReader.readString(&s_value)) return false;
+            *val = v8::String::New(s_value.data(), s_value.size());
+            return true;
+        }
+      case JSBinary::TAG_OBJECT:
+        {
+            v8::Handle<v8::Object> obj = v8::Object::New();
+            mObjects.push_back(obj);
+            *val = obj;
+            return readFields(obj);
+        }
+      case JSBinary::TAG_ARRAY:
+        {
+            v8::Handle<v8::Object> arr = v8::Array::New();
+            mObjects.push_back(arr);
+            *val = arr;
+            return readFields(arr);
+        }
+      case JSBinary::TAG_FUNCTION:
+        {
+            String funcText;
+            if (!mReader.readString(&funcText)) return false;
+            if (mScript == NULL)
+            {
+                JSLOG(error, "Cannot deserialize function without a script.");
+                return false;
+            }
+            v8::Handle<v8::Function> func = createFunction(funcText);
+            mObjects.push_back(func);
+            *val = func;
+            return readFields(func);
+        }
+      case JSBinary::TAG_ROOT_OBJECT:
+        {
+            //instead of modifying the root object directly, will write all
+            //fields.
+            v8::Handle<v8::Object> rootObj = v8::Object::New();
+            rootObj->SetHiddenValue(v8::String::New(JSSERIALIZER_ROOT_OBJ_TOKEN),v8::Boolean::New(true));
+            mRootObjects.push_back(rootObj);
+            mObjects.push_back(rootObj);
+            *val = rootObj;
+            return readFields(rootObj);
+        }
+      case JSBinary::TAG_BACKREF:
+        {
+            uint32 idx;
+            if (!mReader.readBackref(&idx)) return false;
+            if (idx >= mObjects.size())
+            {
+                JSLOG(error, "error deserializing object pointing to "<< idx<< ". No record of that label.");
+                return false;
+            }
+            *val = mObjects[idx];
+            *backref = (int32)idx;
+            return true;
+        }
+      case JSBinary::TAG_VISIBLE:
+        {
+            String sporef;
+            if (!mReader.readString(&sporef)) return false;
+            if (mScript == NULL)
+            {
+                JSLOG(error, "Cannot deserialize visible without a script.");
+                return false;
+            }
+            v8::Handle<v8::Object> vis = mScript->createVisibleWeakPersistent(SpaceObjectReference(sporef), JSVisibleDataPtr());
+            mObjects.push_back(vis);
+            *val = vis;
+            return true;
+        }
+      case JSBinary::TAG_SYSTEM:
+        {
+            v8::Handle<v8::Object> sys = v8::Object::New();
+            static String sysFieldname = "builtin";
+            static String sysFieldval = "[object system]";
+            sys->Set(v8::String::New(sysFieldname.c_str(), sysFieldname.size()),
+                v8::String::New(sysFieldval.c_str(), sysFieldval.size()));
+            mObjects.push_back(sys);
+            *val = sys;
+            return true;
+        }
+      default:
+        return false;
+    }
+}
+
+bool JSSerializer::BinaryDecoder::readFields(v8::Handle<v8::Object> obj)
+{
+    if (mDepth >= MAX_DESERIALIZE_DEPTH)
+    {
+        JSLOG(error, "Error deserializing message, objects are nested too deeply.");
+        return false;
+    }
+    mDepth++;
+
+    String fieldname;
+    bool end = false;
+    while(true)
+    {
+        if (!mReader.readName(&fieldname, &end))
+            return false;
+        if (end)
+            break;
+
+        v8::Handle<v8::Value> val;
+        int32 backref;
+        if (!readValue(&val, &backref))
+            return false;
+
+        if (fieldname == JSSERIALIZER_PROTOTYPE_NAME)
+        {
+            if (backref >= 0)
+                mPrototypeFixups.push_back(std::make_pair(obj, backref));
+            else if (!val->IsUndefined() && !val->IsNull())
+            {
+                if (val->IsObject())
+                    setPrototype(obj,val->ToObject());
+                else
+                    obj->SetPrototype(val);
+            }
+        }
+        else
+            obj->Set(v8::String::New(fieldname.c_str(), fieldname.size()), val);
+    }
+
+    mDepth--;
+    return true;
+}
+
+v8::Handle<v8::Function> JSSerializer::BinaryDecoder::createFunction(const String& funcText)
+{
+    if (funcText != FUNCTION_CONSTRUCTOR_TEXT)
+        return mScript->functionValue(funcText);
+
+    v8::Local<v8::Function> tmpFun = mScript->functionValue("function(){}");
+    if ((tmpFun->Has(v8::String::New("constructor"))) &&
+        (tmpFun->Get(v8::String::New("constructor"))->IsFunction()))
+    {
+        return v8::Handle<v8::Function>::Cast(tmpFun->Get(v8::String::New("constructor")));
+    }
+
+    JSLOG(error, "Error setting the constructor of an object.  Setting to dummy constructor.");
+    return tmpFun;
+}
+
+
+v8::Handle<v8::Value> JSSerializer::deserialize(EmersonScript* emerScript, const String& payload, bool& deserializeSuccessful)
+{
+    deserializeSuccessful = false;
+
+    //error if not in context, won't be able to create a new v8 object.
+    if (! v8::Context::InContext())
+    {
+        JSLOG(error, "Error when deserializing.  Am not inside a v8 context.  Aborting.");
+        return v8::Undefined();
+    }
+
+    if (JSBinary::isBinary(payload))
+    {
+        v8::HandleScope handle_scope;
+        BinaryDecoder decoder(emerScript, payload);
+        v8::Handle<v8::Value> result;
+        deserializeSuccessful = decoder.decode(&result);
+        if (!deserializeSuccessful)
+        {
+            JSLOG(error, "Error deserializing binary message.");
+            return v8::Undefined();
+        }
+        return handle_scope.Close(result);
+    }
+
+    //older peers send PBJ messages: a JSMessage for objects, JSFieldValues
+    //for everything else.
+    Sirikata::JS::Protocol::JSMessage js_msg;
+    if (js_msg.ParseFromString(payload))
+        return deserializeObject(emerScript, js_msg, deserializeSuccessful);
+
+    Sirikata::JS::Protocol::JSFieldValue js_field_val;
+    if (js_field_val.ParseFromString(payload))
+        return deserializeMessage(emerScript, js_field_val, deserializeSuccessful);
+
+    return v8::Undefined();
+}
+
+
 } //end namespace js
 } //end namespace sirikata
@@ -5,6 +5,7 @@
 
 #include <string>
 #include "JS_JSMessage.pbj.hpp"
+#include "JSBinaryCodec.hpp"
 #include "JSObjectScript.hpp"
 #include "EmersonScript.hpp"
 #include <vector>
@@ -57,7 +58,10 @@ void debug_printSerializedFieldVal(Sirikata::JS::Protocol::JSFieldValue jsfieldv
 
 class JSSerializer
 {
-    static void pointOtherObject(int32 int32ToPointTo,Sirikata::JS::Protocol::IJSFieldValue& jsf_value);
+    class BinaryEncoder;
+    class BinaryDecoder;
+    friend class BinaryEncoder;
+    friend class BinaryDecoder;
 
     static void annotateObject(ObjectVec& objVec, v8::Handle<v8::Object> v8Obj,int32 toStampWith);
 
@@ -65,23 +69,10 @@ class JSSerializer
     static void unmarkDeserialized(ObjectMap& objMap);
 
     static void setPrototype(v8::Handle<v8::Object> toSetProtoOf, v8::Handle<v8::Object> toSetTo);
-    
-    static void serializeVisible(v8::Local<v8::Object> v8Obj, Sirikata::JS::Protocol::IJSMessage&,int32& toStampWith,ObjectVec& allObjs);
-    static void fillVisible(Sirikata::JS::Protocol::IJSMessage&, const SpaceObjectReference& listenTo);// Reused by serializePresence
-    static void serializePresence(v8::Local<v8::Object> v8Obj, Sirikata::JS::Protocol::IJSMessage&,int32& toStampWith,ObjectVec& allObjs);
-    static void serializeSystem(v8::Local<v8::Object> v8Obj, Sirikata::JS::Protocol::IJSMessage&,int32& toStampWith,ObjectVec& allObjs);
-    static void serializeObjectInternal(v8::Local<v8::Value> v8Val, Sirikata::JS::Protocol::IJSMessage&,int32& toStampWith,ObjectVec& allObjs );
-
-    static void serializeInternalFields(v8::Local<v8::Object> v8Obj, Sirikata::JS::Protocol::JSMessage&,ObjectVec& allObjs);
-    static void serializeAddressable(v8::Local<v8::Object> v8Obj, Sirikata::JS::Protocol::JSMessage&,ObjectVec& allObjs);
-
 
     static void shallowCopyFields(v8::Handle<v8::Object> dst, v8::Handle<v8::Object> src);
     static bool deserializePerformFixups(ObjectMap& labeledObjs, FixupMap& toFixUp);
 
-    static void serializeFieldValueInternal(Sirikata::JS::Protocol::IJSFieldValue& jsf_value,v8::Handle<v8::Value> prop_val,int32 & toStampWith,ObjectVec& objVec);
-
-    
     static bool deserializeObjectInternal( EmersonScript* jsObjScript, Sirikata::JS::Protocol::JSMessage jsmessage,v8::Handle<v8::Object>& deserializeTo, ObjectMap& labeledObjs,FixupMap& toFixUp);
 
     static v8::Handle<v8::Value> deserializeFieldValue(EmersonScript* emerScript,
@@ -90,11 +81,25 @@ class JSSerializer
 
 
 public:
-    
-    //deprecated
-    static std::string serializeObject(v8::Local<v8::Value> v8Val,int32 toStamp = 0);
-    static std::string serializeMessage(v8::Local<v8::Value> v8Val, int32 toStamp=0);
 
+    /** Serialize a value using the binary format described in
+     *  JSBinaryCodec.hpp. The versions taking a buffer write directly into it,
+     *  so callers sending many messages can reuse the same String.
+     */
+    static std::string serializeMessage(v8::Local<v8::Value> v8Val);
+    static void serializeMessage(v8::Local<v8::Value> v8Val, String& buf);
+    // Like serializeMessage, but anything other than an object is sent as an
+    // empty object.
+    static std::string serializeObject(v8::Local<v8::Value> v8Val);
+    static void serializeObject(v8::Local<v8::Value> v8Val, String& buf);
+
+    /** Decode a serialized value. Accepts both the binary format and the
+     *  older PBJ-based JSMessage and JSFieldValue messages. Must be called from
+     *  within a v8 context.
+     */
+    static v8::Handle<v8::Value> deserialize(EmersonScript* emerScript, const String& payload, bool& deserializeSuccessful);
+
+    // Decoding of the older PBJ-based messages.
     //both of these must be called from within a v8 context
     static v8::Handle<v8::Value> deserializeMessage( EmersonScript* emerScript, Sirikata::JS::Protocol::JSFieldValue jsfieldval,bool& deserializeSuccessful);
     //both of these must be called from within a v8 context
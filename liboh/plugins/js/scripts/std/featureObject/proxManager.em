@@ -140,6 +140,21 @@ system.require('featureObject.em');
      //deregistered.
      var pRemCB = {};
 
+     //map
+     //keys: sporef of presence
+     //values: arrays of batch proximity added and removed
+     //functions. Same layout as pAddCB and pRemCB, but each function
+     //takes an array of visibles.
+     var pAddBatchCB = {};
+     var pRemBatchCB = {};
+
+     //map
+     //keys: sporef of presence
+     //values: visibles added to its result set while handling a
+     //batched proximity update. Only has an entry during
+     //proxAddedBatchEvent.
+     var pPendingAdded = {};
+
      //map
      //keys: sporef of presence
      //values: presences themselves.
@@ -155,6 +170,8 @@ system.require('featureObject.em');
              pResultSet[nString]        = {};
              pAddCB[nString]            = [];
              pRemCB[nString]            = [];
+             pAddBatchCB[nString]       = [];
+             pRemBatchCB[nString]       = [];
          }
      );
 
@@ -228,6 +245,90 @@ system.require('featureObject.em');
      };
 
 
+     //puts cb into the first free slot of cbMap's array for pres and
+     //returns its index.
+     function addToCallbackArray(cbMap,pres,cb)
+     {
+         var pString = pres.toString();
+         if (!(pString in cbMap))
+         {
+             throw new Error('Cannot add prox batch callback because do ' +
+                             'not have associated presence in ProxManager.');
+         }
+
+         var pArray = cbMap[pString];
+         for (var i = 0; i <= pArray.length; i++)
+         {
+             if ((typeof(pArray[i]) == 'undefined') || (pArray[i] == null))
+             {
+                 pArray[i] = cb;
+                 return i;
+             }
+         }
+         return null;
+     }
+
+     function delFromCallbackArray(cbMap,pres,id)
+     {
+         var pString = pres.toString();
+         if (!(pString in cbMap))
+         {
+             throw new Error('Cannot del prox batch callback because do ' +
+                             'not have associated presence in ProxManager.');
+         }
+
+         var pArray = cbMap[pString];
+         if (!(typeof(pArray[id]) == 'undefined'))
+             pArray[id] = null;
+     }
+
+     //prints an error thrown while handling one visible of a batched
+     //update, so the rest of the batch can still be handled.  Resets
+     //and kills are carried out by throwing, so those still propagate.
+     function reportBatchError(excep,action,visibleObj)
+     {
+         if (system.__isResetting() || system.__isKilling())
+             throw excep;
+
+         system.print('ERROR: Error ' + action + ' visible ' +
+                      visibleObj.toString() + ' in batched proximity ' +
+                      'update: ' + excep.toString() + '\n');
+     }
+
+     //calls every batch callback in pArray with visibleObjs.
+     function triggerBatchCallbacks(pArray,pres,visibleObjs)
+     {
+         if (visibleObjs.length == 0)
+             return;
+
+         system.changeSelf(pres);
+         for (var i in pArray)
+         {
+             if ((typeof(pArray[i]) != 'undefined') && (pArray[i] != null))
+                 pArray[i](visibleObjs);
+         }
+     }
+
+     ProxManager.prototype.setProxAddBatchCB = function(pres,cb)
+     {
+         return addToCallbackArray(pAddBatchCB,pres,cb);
+     };
+
+     ProxManager.prototype.setProxRemBatchCB = function(pres,cb)
+     {
+         return addToCallbackArray(pRemBatchCB,pres,cb);
+     };
+
+     ProxManager.prototype.delProxAddBatchCB = function(pres,addID)
+     {
+         delFromCallbackArray(pAddBatchCB,pres,addID);
+     };
+
+     ProxManager.prototype.delProxRemBatchCB = function(pres,remID)
+     {
+         delFromCallbackArray(pRemBatchCB,pres,remID);
+     };
+
      ProxManager.prototype.delProxAddCB = function(pres,addID)
      {
          var pString = pres.toString();
@@ -353,6 +454,43 @@ system.require('featureObject.em');
      // };
 
      
+     /**
+      Gets called by system with all the visibles that a single
+      proximity update added to pres's result set.  Each one goes
+      through proxAddedEvent, so per-visible callbacks fire as
+      usual, and batch callbacks get called once at the end with all
+      the visibles that actually got added.
+      */
+     ProxManager.prototype.proxAddedBatchEvent = function (pres,visibleObjs)
+     {
+         var pString = pres.toString();
+         var added = [];
+         pPendingAdded[pString] = added;
+         try
+         {
+             for (var i = 0; i < visibleObjs.length; ++i)
+             {
+                 //a callback that throws shouldn't keep the rest of
+                 //the batch from being added.
+                 try
+                 {
+                     this.proxAddedEvent(pres,visibleObjs[i]);
+                 }
+                 catch (excep)
+                 {
+                     reportBatchError(excep,'adding',visibleObjs[i]);
+                 }
+             }
+         }
+         finally
+         {
+             delete pPendingAdded[pString];
+         }
+
+         triggerBatchCallbacks(pAddBatchCB[pString],pres,added);
+     };
+
+
      //tells pres to listen for feature vector from visibleObj.
      //numTriesLeft should be left blank except when this function
      //calls itself.  (the idea is that it tries to get feature object
@@ -461,6 +599,14 @@ system.require('featureObject.em');
      {
          var pString = pres.toString();
          pResultSet[pString][visibleObj.toString()] = visibleObj;
+
+         //additions that are part of a batched update get delivered
+         //together by proxAddedBatchEvent.  Recorded before the
+         //callbacks run, so it's included even if one of them throws.
+         var batched = (pString in pPendingAdded);
+         if (batched)
+             pPendingAdded[pString].push(visibleObj);
+
          var pArray = pAddCB[pString];
          //trigger all non-null non-undefined callbacks
          system.changeSelf(pres);
@@ -469,6 +615,9 @@ system.require('featureObject.em');
 	     if ((typeof(pArray[i]) != 'undefined') && (pArray[i] != null))
 		 pArray[i](visibleObj);                 
          }
+
+         if (!batched)
+             triggerBatchCallbacks(pAddBatchCB[pString],pres,[visibleObj]);
      };
 
 
@@ -545,6 +694,10 @@ system.require('featureObject.em');
 		 pArray[i](visibleObj);                          
          }
 
+         //removals are delayed individually (see
+         //TIME_TO_WAIT_BETWEEN_REMOVAL_AND_NOTIFICATION), so batch
+         //callbacks get them one at a time.
+         triggerBatchCallbacks(pRemBatchCB[pString],pres,[visibleObj]);
      };
 
 
@@ -72,12 +72,43 @@ function (funcToCallback)
 };
 
 
+system.__presence_constructor__.prototype.onProxAddedBatch =
+function (funcToCallback,onExisting)
+{
+    var cb_handle = system.__sys_register_onProxAddedBatch(this,funcToCallback,onExisting);
+    return {
+        'clear' : std.core.bind(this._delProxAddedBatch, this, cb_handle)
+    };
+};
+
+system.__presence_constructor__.prototype.onProxRemovedBatch =
+function (funcToCallback)
+{
+    var cb_handle = system.__sys_register_onProxRemovedBatch(this,funcToCallback);
+    return {
+        'clear' : std.core.bind(this._delProxRemovedBatch, this, cb_handle)
+    };
+};
+
+
 system.__presence_constructor__.prototype._delProxAdded =
 function (idToDelete)
 {
     system.__sys_register_delProxAdded(this,idToDelete);
 };
 
+system.__presence_constructor__.prototype._delProxAddedBatch =
+function (idToDelete)
+{
+    system.__sys_register_delProxAddedBatch(this,idToDelete);
+};
+
+system.__presence_constructor__.prototype._delProxRemovedBatch =
+function (idToDelete)
+{
+    system.__sys_register_delProxRemovedBatch(this,idToDelete);
+};
+
 system.__presence_constructor__.prototype._delProxRemoved =
 function (idToDelete)
 {
@@ -362,6 +393,26 @@ system.__presence_constructor__.prototype.toString = function()
        */
       presence.prototype.onProxRemoved = function(){ };
 
+      /** @function
+       @description Like onProxAdded, but cb is called once per
+       proximity update with an array of all the visibles added to the
+       proximity set by it, instead of once per visible.
+       @param {function} cb Callback function taking an array of visibles.
+       @param {bool} (optional) onExisting If true, cb is also called
+       with an array of all the visibles already in the result set.
+       @return {object} Can call clear on this object to de-register
+       cb.
+       */
+      presence.prototype.onProxAddedBatch = function(){ };
+
+      /** @function
+       @description Array-based counterpart of onProxRemoved.  cb
+       receives an array of the visibles that left the proximity set.
+       @param {function} cb Callback function taking an array of visibles.
+       @return {object} Can call clear on this object to de-register cb.
+       */
+      presence.prototype.onProxRemovedBatch = function(){ };
+
     /**@function
        @description Sets the raw query that is issued from this presence.
        @param newQuery
@@ -84,6 +84,16 @@ PresenceEntry.prototype.setProxRemCB = function (proxRemCB)
     return this.proxMan.setProxRemCB(this.presObj,proxRemCB);
 };
 
+PresenceEntry.prototype.setProxAddBatchCB = function (proxAddCB)
+{
+    return this.proxMan.setProxAddBatchCB(this.presObj,proxAddCB);
+};
+
+PresenceEntry.prototype.setProxRemBatchCB = function (proxRemCB)
+{
+    return this.proxMan.setProxRemBatchCB(this.presObj,proxRemCB);
+};
+
 PresenceEntry.prototype.delProxAddCB = function(addID)
 {
     return this.proxMan.delProxAddCB(this.presObj,addID);
@@ -94,6 +104,21 @@ PresenceEntry.prototype.delProxRemCB = function(remID)
     return this.proxMan.delProxRemCB(this.presObj,remID);
 };
 
+PresenceEntry.prototype.delProxAddBatchCB = function(addID)
+{
+    return this.proxMan.delProxAddBatchCB(this.presObj,addID);
+};
+
+PresenceEntry.prototype.delProxRemBatchCB = function(remID)
+{
+    return this.proxMan.delProxRemBatchCB(this.presObj,remID);
+};
+
+PresenceEntry.prototype.proxAddedBatchEvent = function(visibleObjs,visTo)
+{
+    return this.proxMan.proxAddedBatchEvent(visTo,visibleObjs);
+};
+
 PresenceEntry.prototype.proxAddedEvent = function(visibleObj,visTo)
 {
     return this.proxMan.proxAddedEvent(visTo,visibleObj);
@@ -1344,8 +1369,58 @@ PresenceEntry.prototype.proxRemovedEvent = function (visibleObj,visTo)
              throw new Error('Error: received prox added message for presence not controlling');
      };
 
+     /**
+      @param visObjs is an array of visible objects that moved into
+      presence's result set in a single proximity update.
+      @param presVisTo is a string that is the identifier for the presence the visibles are visible to.
+
+      Takes precedence over proxAddedManager, so whole updates are
+      handled with one call into the script.
+      */
+     var proxAddedBatchManager = function(visObjs, presVisTo)
+     {
+         var key = presVisTo.toString();
+         if (!(key in system._selfMap))
+             throw new Error('Error: received prox added message for presence not controlling');
+
+         system.__setBehindSelf( system._selfMap[key].presObj);
+         system._selfMap[key].proxAddedBatchEvent(visObjs,system.self);
+     };
+
+     /**
+      @param visObjs is an array of visible objects that left presence's result set in a single proximity update.
+      @param presVisTo is a string that is the identifier for the presence the visibles were visible to.
+      */
+     var proxRemovedBatchManager = function(visObjs, presVisTo)
+     {
+         var key = presVisTo.toString();
+         if (!(key in system._selfMap))
+             throw new Error('Error: received prox removed message for presence not controlling');
+
+         system.__setBehindSelf( system._selfMap[key].presObj);
+         for (var i = 0; i < visObjs.length; ++i)
+         {
+             //keep going with the rest of the batch if one fails, but
+             //let resets and kills through.
+             try
+             {
+                 system._selfMap[key].proxRemovedEvent(visObjs[i],system.self);
+             }
+             catch (excep)
+             {
+                 if (system.__isResetting() || system.__isKilling())
+                     throw excep;
+                 system.print('ERROR: Error removing visible ' +
+                              visObjs[i].toString() + ' in batched ' +
+                              'proximity update: ' + excep.toString() + '\n');
+             }
+         }
+     };
+
      baseSystem.registerProxAddedHandler(proxAddedManager);
      baseSystem.registerProxRemovedHandler(proxRemovedManager);
+     baseSystem.registerProxAddedBatchHandler(proxAddedBatchManager);
+     baseSystem.registerProxRemovedBatchHandler(proxRemovedBatchManager);
 
      /**
       @presCalling this is the presence that want to register
@@ -1392,6 +1467,57 @@ PresenceEntry.prototype.proxRemovedEvent = function (visibleObj,visTo)
               throw new Error('Error: do not have a presence in map matching ' + presCalling.toString());
       };
 
+     /**
+      @presCalling this is the presence that want to register
+      onProxAddedBatch function for
+      @funcToCall function that gets called with an array of the
+      visibles added by each proximity update.
+      @onExisting if true, funcToCall is also called immediately with
+      an array of the visibles already in presCalling's result set.
+      */
+      system.__sys_register_onProxAddedBatch = function (presCalling, funcToCall, onExisting)
+      {
+          var key = presCalling.toString();
+          if (!(key in this._selfMap))
+              throw new Error('Error: do not have a presence in map matching ' + key);
+
+          var returner = this._selfMap[key].setProxAddBatchCB(funcToCall);
+          if (onExisting)
+          {
+              var existing = system.getProxSet(presCalling);
+              var existingArray = [];
+              for (var s in existing)
+                  existingArray.push(existing[s]);
+
+              if (existingArray.length != 0)
+              {
+                  var prevSelf = system.self;
+                  system.__setBehindSelf( system._selfMap[key].presObj);
+                  funcToCall(existingArray);
+                  system.__setBehindSelf( prevSelf );
+              }
+          }
+          return returner;
+      };
+
+      system.__sys_register_onProxRemovedBatch = function (presCalling, funcToCall)
+      {
+          if (presCalling.toString()  in this._selfMap)
+              return this._selfMap[presCalling.toString()].setProxRemBatchCB(funcToCall);
+          else
+              throw new Error('Error: do not have a presence in map matching ' + presCalling.toString());
+      };
+
+      system.__sys_register_delProxAddedBatch = function (presCalling, addID)
+      {
+          this._selfMap[presCalling.toString()].delProxAddBatchCB(addID);
+      };
+
+      system.__sys_register_delProxRemovedBatch = function (presCalling, remID)
+      {
+          this._selfMap[presCalling.toString()].delProxRemBatchCB(remID);
+      };
+
 	 /**
 	  @presCalling this is the presence that wants to unregister onProxAdded function
 	  @addID this is the ID number of the onProxAdded function to delete
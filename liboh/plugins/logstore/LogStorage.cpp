@@ -0,0 +1,862 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "LogStorage.hpp"
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOWork.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+#if SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#define LOGSTORAGE_LOG(lvl, msg) SILOG(log-storage, lvl, msg)
+
+namespace Sirikata {
+namespace OH {
+
+/** Log Format
+ *  ----------
+ *
+ *  The log is a sequence of records, each of which is:
+ *
+ *    uint32 payload length | uint32 FNV-1a hash of payload | payload
+ *
+ *  with integers stored little endian. A payload is a sequence of operations,
+ *  each of which is a type byte, the 16 byte bucket ID, and a length-prefixed
+ *  key. Puts are followed by a length-prefixed value. Only the effects of
+ *  transactions are logged, so range erases are logged as individual erases
+ *  and reads aren't logged at all.
+ *
+ *  Each transaction is written as a single record, so a transaction is never
+ *  partially applied during replay.
+ */
+
+namespace {
+
+enum LogOp {
+    LogPut = 1,
+    LogErase = 2
+};
+
+// Don't let compaction build huge records. This is also how much data the
+// storage thread encodes between commits while compacting.
+const uint32 MaxCompactionRecordSize = 1 << 20;
+
+uint32 hashData(const char* data, std::size_t len) {
+    uint32 hash = 2166136261u;
+    for(std::size_t i = 0; i < len; i++) {
+        hash ^= (uint8)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void appendUInt32(String* out, uint32 val) {
+    char bytes[4] = {
+        (char)(val & 0xFF), (char)((val >> 8) & 0xFF),
+        (char)((val >> 16) & 0xFF), (char)((val >> 24) & 0xFF)
+    };
+    out->append(bytes, 4);
+}
+
+uint32 readUInt32(const char* data) {
+    const uint8* bytes = (const uint8*)data;
+    return (uint32)bytes[0] | ((uint32)bytes[1] << 8) | ((uint32)bytes[2] << 16) | ((uint32)bytes[3] << 24);
+}
+
+void appendString(String* out, const String& str) {
+    appendUInt32(out, (uint32)str.size());
+    out->append(str);
+}
+
+// Approximate size of a live key in the log, used to decide when compaction
+// is worthwhile.
+uint64 entrySize(const String& key, const String& value) {
+    return 1 + UUID::static_size + 4 + key.size() + 4 + value.size();
+}
+
+void encodePut(String* payload, const UUID& bucket, const String& key, const String& value) {
+    payload->push_back((char)LogPut);
+    payload->append(bucket.rawData());
+    appendString(payload, key);
+    appendString(payload, value);
+}
+
+void encodeErase(String* payload, const UUID& bucket, const String& key) {
+    payload->push_back((char)LogErase);
+    payload->append(bucket.rawData());
+    appendString(payload, key);
+}
+
+void appendRecord(String* out, const String& payload) {
+    appendUInt32(out, (uint32)payload.size());
+    appendUInt32(out, hashData(payload.data(), payload.size()));
+    out->append(payload);
+}
+
+bool syncFile(FILE* fp) {
+#if SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_WINDOWS
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+// A decoded operation from a record
+struct DecodedOp {
+    uint8 type;
+    UUID bucket;
+    String key;
+    String value;
+};
+
+bool readString(const String& payload, std::size_t* pos, String* out) {
+    if (*pos + 4 > payload.size()) return false;
+    uint32 len = readUInt32(payload.data() + *pos);
+    *pos += 4;
+    if (*pos + len > payload.size()) return false;
+    out->assign(payload, *pos, len);
+    *pos += len;
+    return true;
+}
+
+bool decodePayload(const String& payload, std::vector<DecodedOp>* ops_out) {
+    std::size_t pos = 0;
+    while(pos < payload.size()) {
+        DecodedOp op;
+        op.type = (uint8)payload[pos];
+        pos++;
+        if (op.type != LogPut && op.type != LogErase) return false;
+        if (pos + UUID::static_size > payload.size()) return false;
+        op.bucket = UUID(payload.substr(pos, UUID::static_size), UUID::BinaryString());
+        pos += UUID::static_size;
+        if (!readString(payload, &pos, &op.key)) return false;
+        if (op.type == LogPut && !readString(payload, &pos, &op.value)) return false;
+        ops_out->push_back(op);
+    }
+    return true;
+}
+
+} // namespace
+
+
+LogStorage::LogStorage(ObjectHostContext* ctx, const String& path, bool sync, uint64 compact_min_size, float64 compact_ratio)
+ : mContext(ctx),
+   mPath(path),
+   mCompactPath(path + ".compact"),
+   mLockPath(path + ".lock"),
+   mSync(sync),
+   mCompactMinSize(compact_min_size),
+   mCompactRatio(std::max(compact_ratio, 1.0)),
+   mIOService(NULL),
+   mWork(NULL),
+   mThread(NULL),
+   mCompactionService(NULL),
+   mCompactionWork(NULL),
+   mCompactionThread(NULL),
+   mCompactionActiveWork(NULL),
+   mCompactLog(NULL),
+   mCompactLogOK(false),
+   mTransactionQueue(std::tr1::bind(&LogStorage::postProcessTransactions, this)),
+   mLocked(false),
+   mLock(NULL),
+   mLog(NULL),
+   mLogSize(0),
+   mLiveSize(0),
+   mCompacting(false),
+   mSnapshotBucketIdx(0),
+   mSnapshotHaveKey(false)
+{
+}
+
+LogStorage::~LogStorage()
+{
+}
+
+void LogStorage::start() {
+    mIOService = new Network::IOService("LogStorage");
+    mWork = new Network::IOWork(*mIOService, "LogStorage IO Thread");
+    mThread = new Sirikata::Thread("LogStorage IO", std::tr1::bind(&Network::IOService::runNoReturn, mIOService));
+
+    mCompactionService = new Network::IOService("LogStorage Compaction");
+    mCompactionWork = new Network::IOWork(*mCompactionService, "LogStorage Compaction Thread");
+    mCompactionThread = new Sirikata::Thread("LogStorage Compaction", std::tr1::bind(&Network::IOService::runNoReturn, mCompactionService));
+
+    mIOService->post(std::tr1::bind(&LogStorage::initLog, this), "LogStorage::initLog");
+}
+
+void LogStorage::stop() {
+    // Let any compaction in progress finish first. Its completion is handled
+    // by the IO thread, so that needs to keep running until after this.
+    delete mCompactionWork;
+    mCompactionWork = NULL;
+    mCompactionThread->join();
+    delete mCompactionThread;
+    mCompactionThread = NULL;
+
+    // Then wait for outstanding transactions to complete.
+    delete mWork;
+    mWork = NULL;
+    mThread->join();
+    delete mThread;
+    mThread = NULL;
+
+    // A compaction started by the last few commits never got to run. The
+    // original log is complete, so it's simply abandoned.
+    delete mCompactionActiveWork;
+    mCompactionActiveWork = NULL;
+    if (mCompactLog != NULL) {
+        fclose(mCompactLog);
+        mCompactLog = NULL;
+    }
+
+    delete mCompactionService;
+    mCompactionService = NULL;
+    delete mIOService;
+    mIOService = NULL;
+
+    if (mLog != NULL) {
+        fclose(mLog);
+        mLog = NULL;
+    }
+    if (mLock != NULL) {
+        if (mLocked) mLock->unlock();
+        delete mLock;
+        mLock = NULL;
+        mLocked = false;
+    }
+
+    // Clean up data from any outstanding pending transactions
+    for(BucketTransactions::iterator it = mTransactions.begin(); it != mTransactions.end(); it++) {
+        Transaction* trans = it->second;
+        delete trans;
+    }
+    mTransactions.clear();
+}
+
+void LogStorage::initLog() {
+    // Only one process can use the log at once, so grab the lock file first.
+    try {
+        // file_lock requires the file to exist
+        { std::ofstream lockfile(mLockPath.c_str(), std::ios::app); }
+        mLock = new boost::interprocess::file_lock(mLockPath.c_str());
+        mLocked = mLock->try_lock();
+    }
+    catch(boost::interprocess::interprocess_exception& e) {
+        LOGSTORAGE_LOG(error, "Error locking " << mLockPath << ": " << e.what());
+        mLocked = false;
+    }
+    if (!mLocked) {
+        LOGSTORAGE_LOG(error, "Couldn't lock " << mLockPath << ", it's probably in use by another process. All transactions will fail.");
+        return;
+    }
+
+    // A leftover compacted log means we died while compacting. The original
+    // log is still complete, so just discard it.
+    try {
+        if (boost::filesystem::exists(mCompactPath))
+            boost::filesystem::remove(mCompactPath);
+    }
+    catch(boost::filesystem::filesystem_error& e) {
+        LOGSTORAGE_LOG(warning, "Couldn't remove incomplete compacted log " << mCompactPath << ": " << e.what());
+    }
+
+    mLogSize = replayLog();
+
+    // Drop anything after the valid records, e.g. a record that was only
+    // partially written when we crashed. Otherwise new records would be
+    // appended after it and be ignored the next time the log is replayed.
+    try {
+        if (boost::filesystem::exists(mPath) && boost::filesystem::file_size(mPath) > mLogSize) {
+            LOGSTORAGE_LOG(warning, "Discarding " << (boost::filesystem::file_size(mPath) - mLogSize) << " bytes of incomplete or corrupt records at end of " << mPath);
+            boost::filesystem::resize_file(mPath, mLogSize);
+        }
+    }
+    catch(boost::filesystem::filesystem_error& e) {
+        LOGSTORAGE_LOG(error, "Couldn't truncate " << mPath << ": " << e.what());
+    }
+
+    if (!openLogForAppend())
+        mLocked = false;
+}
+
+uint64 LogStorage::replayLog() {
+    FILE* fp = fopen(mPath.c_str(), "rb");
+    if (fp == NULL) return 0;
+
+    uint64 file_size = 0;
+    try {
+        file_size = boost::filesystem::file_size(mPath);
+    }
+    catch(boost::filesystem::filesystem_error& e) {
+    }
+
+    uint64 valid_size = 0;
+    uint32 nrecords = 0;
+    char header[8];
+    String payload;
+    std::vector<DecodedOp> ops;
+    while(fread(header, 1, 8, fp) == 8) {
+        uint32 len = readUInt32(header);
+        uint32 hash = readUInt32(header + 4);
+        // Don't trust the length of a corrupt header
+        if (valid_size + 8 + len > file_size) break;
+
+        payload.resize(len);
+        if (len > 0 && fread(&payload[0], 1, len, fp) != len) break;
+        if (hashData(payload.data(), payload.size()) != hash) break;
+
+        ops.clear();
+        if (!decodePayload(payload, &ops)) break;
+
+        for(uint32 i = 0; i < ops.size(); i++) {
+            const DecodedOp& op = ops[i];
+            BucketData& bucket_data = mData[op.bucket];
+            BucketData::iterator it = bucket_data.find(op.key);
+            if (it != bucket_data.end()) {
+                mLiveSize -= entrySize(it->first, it->second);
+                if (op.type == LogErase)
+                    bucket_data.erase(it);
+            }
+            if (op.type == LogPut) {
+                bucket_data[op.key] = op.value;
+                mLiveSize += entrySize(op.key, op.value);
+            }
+        }
+
+        valid_size += 8 + len;
+        nrecords++;
+    }
+    fclose(fp);
+
+    LOGSTORAGE_LOG(detailed, "Replayed " << nrecords << " records from " << mPath);
+    return valid_size;
+}
+
+bool LogStorage::openLogForAppend() {
+    mLog = fopen(mPath.c_str(), "ab");
+    if (mLog == NULL) {
+        LOGSTORAGE_LOG(error, "Couldn't open " << mPath << " for writing. All transactions will fail.");
+        return false;
+    }
+    return true;
+}
+
+bool LogStorage::writeLog(FILE* fp, const String& data, bool sync) {
+    if (data.empty()) return true;
+    if (fwrite(data.data(), 1, data.size(), fp) != data.size()) return false;
+    if (fflush(fp) != 0) return false;
+    if (sync && !syncFile(fp)) return false;
+    return true;
+}
+
+LogStorage::Transaction* LogStorage::getTransaction(const Bucket& bucket, bool* is_new) {
+    if (mTransactions.find(bucket) == mTransactions.end()) {
+        if (is_new != NULL) *is_new = true;
+        mTransactions[bucket] = new Transaction();
+    }
+
+    return mTransactions[bucket];
+}
+
+void LogStorage::leaseBucket(const Bucket& bucket) {
+    // Nothing to do, the lock on the log covers all buckets.
+}
+
+void LogStorage::releaseBucket(const Bucket& bucket) {
+    // Nothing to do, the lock on the log covers all buckets.
+}
+
+void LogStorage::beginTransaction(const Bucket& bucket) {
+    getTransaction(bucket);
+}
+
+void LogStorage::commitTransaction(const Bucket& bucket, const CommitCallback& cb, const String& timestamp)
+{
+    Transaction* trans = getTransaction(bucket);
+    mTransactions.erase(bucket);
+
+    // Short cut for empty transactions.
+    if(trans->empty()) {
+        delete trans;
+        ReadSet* rs = NULL;
+        if (cb) cb(SUCCESS, rs);
+        return;
+    }
+
+    mTransactionQueue.push(
+        TransactionData(bucket, trans, cb)
+    );
+}
+
+void LogStorage::postProcessTransactions() {
+    mIOService->post(
+        std::tr1::bind(&LogStorage::processTransactions, this),
+        "LogStorage::processTransactions"
+    );
+}
+
+void LogStorage::processTransactions() {
+    while(!mTransactionQueue.empty()) {
+        // Everything that's queued up gets committed with a single write to
+        // the log.
+        std::vector<TransactionData> transactions;
+        std::vector<Result> results;
+        std::vector<ReadSet*> read_sets;
+        std::vector<UndoLog> undos;
+        String batch;
+
+        TransactionData data;
+        while(mTransactionQueue.pop(data)) {
+            transactions.push_back(data);
+            undos.push_back(UndoLog());
+
+            ReadSet* rs = new ReadSet;
+            String record;
+            Result result = LOCK_ERROR;
+            if (mLocked)
+                result = executeTransaction(data.bucket, data.trans, rs, &record, &undos.back());
+
+            if (result == SUCCESS) {
+                if (!record.empty())
+                    appendRecord(&batch, record);
+            }
+            else {
+                rollback(undos.back());
+                undos.back().clear();
+                rs->clear();
+            }
+            if (rs->empty()) {
+                delete rs;
+                rs = NULL;
+            }
+
+            results.push_back(result);
+            read_sets.push_back(rs);
+        }
+
+        if (!batch.empty()) {
+            if (writeLog(mLog, batch, mSync)) {
+                mLogSize += batch.size();
+                if (mCompacting)
+                    mCompactionBacklog.append(batch);
+            }
+            else {
+                // Couldn't make any of these durable, so undo all of them, most
+                // recent first.
+                LOGSTORAGE_LOG(error, "Error writing to " << mPath << ", failing " << transactions.size() << " transactions");
+                for(int32 i = (int32)transactions.size()-1; i >= 0; i--) {
+                    if (results[i] != SUCCESS) continue;
+                    rollback(undos[i]);
+                    delete read_sets[i];
+                    read_sets[i] = NULL;
+                    results[i] = TRANSACTION_ERROR;
+                }
+                // And get rid of any partial write so later records aren't
+                // lost behind it.
+                fclose(mLog);
+                mLog = NULL;
+                try {
+                    boost::filesystem::resize_file(mPath, mLogSize);
+                }
+                catch(boost::filesystem::filesystem_error& e) {
+                    LOGSTORAGE_LOG(error, "Couldn't truncate " << mPath << ": " << e.what());
+                }
+                if (!openLogForAppend())
+                    mLocked = false;
+            }
+        }
+
+        for(uint32 i = 0; i < transactions.size(); i++) {
+            delete transactions[i].trans;
+            if (transactions[i].cb) {
+                mContext->mainStrand->post(
+                    std::tr1::bind(transactions[i].cb, results[i], read_sets[i]),
+                    "LogStorage completeCommit"
+                );
+            }
+            else {
+                delete read_sets[i];
+            }
+        }
+
+        checkCompaction();
+    }
+}
+
+Storage::Result LogStorage::executeTransaction(const Bucket& bucket, Transaction* trans, ReadSet* rs, String* record, UndoLog* undo) {
+    BucketData& bucket_data = mData[bucket];
+
+    for(Transaction::iterator it = trans->begin(); it != trans->end(); it++) {
+        StorageAction& action = *it;
+        switch(action.type) {
+          case StorageAction::Read:
+            {
+                BucketData::iterator key_it = bucket_data.find(action.key);
+                if (key_it == bucket_data.end()) return TRANSACTION_ERROR;
+                (*rs)[action.key] = key_it->second;
+            }
+            break;
+          case StorageAction::Compare:
+            {
+                BucketData::iterator key_it = bucket_data.find(action.key);
+                if (key_it == bucket_data.end() || key_it->second != action.value)
+                    return TRANSACTION_ERROR;
+            }
+            break;
+          case StorageAction::ReadRange:
+            {
+                if (action.keyEnd < action.key) return TRANSACTION_ERROR;
+                BucketData::iterator key_it = bucket_data.lower_bound(action.key);
+                BucketData::iterator end_it = bucket_data.upper_bound(action.keyEnd);
+                if (key_it == end_it) return TRANSACTION_ERROR;
+                for(; key_it != end_it; key_it++)
+                    (*rs)[key_it->first] = key_it->second;
+            }
+            break;
+          case StorageAction::Write:
+            putKey(bucket, action.key, action.value, record, undo);
+            break;
+          case StorageAction::Erase:
+            {
+                BucketData::iterator key_it = bucket_data.find(action.key);
+                if (key_it != bucket_data.end())
+                    eraseKey(bucket, bucket_data, key_it, record, undo);
+            }
+            break;
+          case StorageAction::EraseRange:
+            {
+                if (action.keyEnd < action.key) break;
+                BucketData::iterator key_it = bucket_data.lower_bound(action.key);
+                BucketData::iterator end_it = bucket_data.upper_bound(action.keyEnd);
+                while(key_it != end_it) {
+                    BucketData::iterator erase_it = key_it++;
+                    eraseKey(bucket, bucket_data, erase_it, record, undo);
+                }
+            }
+            break;
+        }
+    }
+
+    return SUCCESS;
+}
+
+void LogStorage::putKey(const Bucket& bucket, const Key& key, const String& value, String* record, UndoLog* undo) {
+    BucketData& bucket_data = mData[bucket];
+
+    undo->push_back(UndoEntry());
+    UndoEntry& entry = undo->back();
+    entry.bucket = bucket;
+    entry.key = key;
+
+    BucketData::iterator it = bucket_data.find(key);
+    entry.existed = (it != bucket_data.end());
+    if (entry.existed) {
+        entry.value = it->second;
+        mLiveSize -= entrySize(key, it->second);
+        it->second = value;
+    }
+    else {
+        bucket_data.insert(BucketData::value_type(key, value));
+    }
+    mLiveSize += entrySize(key, value);
+
+    encodePut(record, bucket, key, value);
+}
+
+void LogStorage::eraseKey(const Bucket& bucket, BucketData& bucket_data, BucketData::iterator it, String* record, UndoLog* undo) {
+    undo->push_back(UndoEntry());
+    UndoEntry& entry = undo->back();
+    entry.bucket = bucket;
+    entry.key = it->first;
+    entry.existed = true;
+    entry.value = it->second;
+
+    encodeErase(record, bucket, it->first);
+
+    mLiveSize -= entrySize(it->first, it->second);
+    bucket_data.erase(it);
+}
+
+void LogStorage::rollback(UndoLog& undo) {
+    for(UndoLog::reverse_iterator it = undo.rbegin(); it != undo.rend(); it++) {
+        BucketData& bucket_data = mData[it->bucket];
+        BucketData::iterator key_it = bucket_data.find(it->key);
+        if (key_it != bucket_data.end()) {
+            mLiveSize -= entrySize(key_it->first, key_it->second);
+            bucket_data.erase(key_it);
+        }
+        if (it->existed) {
+            bucket_data[it->key] = it->value;
+            mLiveSize += entrySize(it->key, it->value);
+        }
+    }
+}
+
+void LogStorage::checkCompaction() {
+    if (mCompacting || !mLocked) return;
+    if (mLogSize < mCompactMinSize || mLogSize < mCompactRatio * mLiveSize) return;
+
+    LOGSTORAGE_LOG(detailed, "Compacting " << mPath << ": " << mLogSize << " bytes, " << mLiveSize << " bytes live");
+
+    // Anything committed from here on is saved in the backlog so it can be
+    // added to the end of the new log.
+    mCompacting = true;
+    mCompactionBacklog.clear();
+    mSnapshotBuckets.clear();
+    for(Data::const_iterator it = mData.begin(); it != mData.end(); it++) {
+        if (!it->second.empty())
+            mSnapshotBuckets.push_back(it->first);
+    }
+    mSnapshotBucketIdx = 0;
+    mSnapshotHaveKey = false;
+
+    mCompactionActiveWork = new Network::IOWork(*mCompactionService, "LogStorage Compaction In Progress");
+    mCompactionService->post(
+        std::tr1::bind(&LogStorage::openCompactedLog, this),
+        "LogStorage::openCompactedLog"
+    );
+    snapshotChunk();
+}
+
+void LogStorage::snapshotChunk() {
+    StringPtr payload(new String());
+    while(payload->size() < MaxCompactionRecordSize && mSnapshotBucketIdx < mSnapshotBuckets.size()) {
+        const Bucket& bucket = mSnapshotBuckets[mSnapshotBucketIdx];
+        const BucketData& bucket_data = mData[bucket];
+        BucketData::const_iterator it = mSnapshotHaveKey ? bucket_data.upper_bound(mSnapshotKey) : bucket_data.begin();
+        for(; it != bucket_data.end() && payload->size() < MaxCompactionRecordSize; it++)
+            encodePut(payload.get(), bucket, it->first, it->second);
+
+        if (it == bucket_data.end()) {
+            mSnapshotBucketIdx++;
+            mSnapshotHaveKey = false;
+        }
+        else {
+            it--;
+            mSnapshotKey = it->first;
+            mSnapshotHaveKey = true;
+        }
+    }
+
+    if (!payload->empty()) {
+        StringPtr record(new String());
+        appendRecord(record.get(), *payload);
+        mCompactionService->post(
+            std::tr1::bind(&LogStorage::writeCompactedRecord, this, record),
+            "LogStorage::writeCompactedRecord"
+        );
+    }
+
+    if (mSnapshotBucketIdx < mSnapshotBuckets.size()) {
+        // Let queued commits run before encoding the next chunk
+        mIOService->post(
+            std::tr1::bind(&LogStorage::snapshotChunk, this),
+            "LogStorage::snapshotChunk"
+        );
+    }
+    else {
+        mSnapshotBuckets.clear();
+        mCompactionService->post(
+            std::tr1::bind(&LogStorage::closeCompactedLog, this),
+            "LogStorage::closeCompactedLog"
+        );
+    }
+}
+
+void LogStorage::openCompactedLog() {
+    mCompactLog = fopen(mCompactPath.c_str(), "wb");
+    mCompactLogOK = (mCompactLog != NULL);
+}
+
+void LogStorage::writeCompactedRecord(StringPtr record) {
+    if (mCompactLogOK)
+        mCompactLogOK = writeLog(mCompactLog, *record, false);
+}
+
+void LogStorage::closeCompactedLog() {
+    bool success = mCompactLogOK && syncFile(mCompactLog);
+    if (mCompactLog != NULL)
+        fclose(mCompactLog);
+    mCompactLog = NULL;
+
+    // Done before handing back to the storage thread, which may start
+    // another compaction as soon as this one finishes.
+    delete mCompactionActiveWork;
+    mCompactionActiveWork = NULL;
+
+    mIOService->post(
+        std::tr1::bind(&LogStorage::finishCompaction, this, success),
+        "LogStorage::finishCompaction"
+    );
+}
+
+void LogStorage::finishCompaction(bool success) {
+    // Add everything committed since the snapshot was taken
+    if (success) {
+        FILE* fp = fopen(mCompactPath.c_str(), "ab");
+        success = (fp != NULL) && writeLog(fp, mCompactionBacklog, true);
+        if (fp != NULL)
+            fclose(fp);
+    }
+
+    // And swap it in for the current log
+    if (success) {
+        fclose(mLog);
+        mLog = NULL;
+        try {
+            boost::filesystem::rename(mCompactPath, mPath);
+            mLogSize = boost::filesystem::file_size(mPath);
+        }
+        catch(boost::filesystem::filesystem_error& e) {
+            LOGSTORAGE_LOG(error, "Couldn't replace log with compacted log: " << e.what());
+            success = false;
+        }
+        if (!openLogForAppend())
+            mLocked = false;
+    }
+
+    if (success) {
+        LOGSTORAGE_LOG(detailed, "Compacted " << mPath << " to " << mLogSize << " bytes");
+    }
+    else {
+        LOGSTORAGE_LOG(error, "Failed to compact " << mPath);
+        try {
+            boost::filesystem::remove(mCompactPath);
+        }
+        catch(boost::filesystem::filesystem_error& e) {
+        }
+    }
+
+    mCompacting = false;
+    mCompactionBacklog.clear();
+}
+
+
+bool LogStorage::erase(const Bucket& bucket, const Key& key, const CommitCallback& cb, const String& timestamp) {
+    bool is_new = false;
+    Transaction* trans = getTransaction(bucket, &is_new);
+    trans->push_back(StorageAction());
+    StorageAction& action = trans->back();
+    action.type = StorageAction::Erase;
+    action.key = key;
+
+    // Run commit if this is a one-off transaction
+    if (is_new)
+        commitTransaction(bucket, cb);
+
+    return true;
+}
+
+bool LogStorage::write(const Bucket& bucket, const Key& key, const String& strToWrite, const CommitCallback& cb, const String& timestamp) {
+    bool is_new = false;
+    Transaction* trans = getTransaction(bucket, &is_new);
+    trans->push_back(StorageAction());
+    StorageAction& action = trans->back();
+    action.type = StorageAction::Write;
+    action.key = key;
+    action.value = strToWrite;
+
+    // Run commit if this is a one-off transaction
+    if (is_new)
+        commitTransaction(bucket, cb);
+
+    return true;
+}
+
+bool LogStorage::read(const Bucket& bucket, const Key& key, const CommitCallback& cb, const String& timestamp) {
+    bool is_new = false;
+    Transaction* trans = getTransaction(bucket, &is_new);
+    trans->push_back(StorageAction());
+    StorageAction& action = trans->back();
+    action.type = StorageAction::Read;
+    action.key = key;
+
+    // Run commit if this is a one-off transaction
+    if (is_new)
+        commitTransaction(bucket, cb);
+
+    return true;
+}
+
+bool LogStorage::compare(const Bucket& bucket, const Key& key, const String& value, const CommitCallback& cb, const String& timestamp) {
+    bool is_new = false;
+    Transaction* trans = getTransaction(bucket, &is_new);
+    trans->push_back(StorageAction());
+    StorageAction& action = trans->back();
+    action.type = StorageAction::Compare;
+    action.key = key;
+    action.value = value;
+
+    // Run commit if this is a one-off transaction
+    if (is_new)
+        commitTransaction(bucket, cb);
+
+    return true;
+}
+
+bool LogStorage::rangeRead(const Bucket& bucket, const Key& start, const Key& finish, const CommitCallback& cb, const String& timestamp) {
+    bool is_new = false;
+    Transaction* trans = getTransaction(bucket, &is_new);
+    trans->push_back(StorageAction());
+    StorageAction& action = trans->back();
+    action.type = StorageAction::ReadRange;
+    action.key = start;
+    action.keyEnd = finish;
+
+    // Run commit if this is a one-off transaction
+    if (is_new)
+        commitTransaction(bucket, cb);
+
+    return true;
+}
+
+bool LogStorage::rangeErase(const Bucket& bucket, const Key& start, const Key& finish, const CommitCallback& cb, const String& timestamp) {
+    bool is_new = false;
+    Transaction* trans = getTransaction(bucket, &is_new);
+    trans->push_back(StorageAction());
+    StorageAction& action = trans->back();
+    action.type = StorageAction::EraseRange;
+    action.key = start;
+    action.keyEnd = finish;
+
+    // Run commit if this is a one-off transaction
+    if (is_new)
+        commitTransaction(bucket, cb);
+
+    return true;
+}
+
+bool LogStorage::count(const Bucket& bucket, const Key& start, const Key& finish, const CountCallback& cb, const String& timestamp) {
+    mIOService->post(
+        std::tr1::bind(&LogStorage::executeCount, this, bucket, start, finish, cb),
+        "LogStorage::executeCount"
+    );
+    return true;
+}
+
+void LogStorage::executeCount(const Bucket& bucket, const Key& start, const Key& finish, CountCallback cb) {
+    Result result = (mLocked ? SUCCESS : LOCK_ERROR);
+    int32 count = 0;
+
+    Data::const_iterator bucket_it = mData.find(bucket);
+    if (mLocked && bucket_it != mData.end() && !(finish < start)) {
+        const BucketData& bucket_data = bucket_it->second;
+        count = (int32)std::distance(bucket_data.lower_bound(start), bucket_data.upper_bound(finish));
+    }
+
+    if (cb) {
+        mContext->mainStrand->post(
+            std::tr1::bind(cb, result, count),
+            "LogStorage completeCount"
+        );
+    }
+}
+
+} //end namespace OH
+} //end namespace Sirikata
@@ -0,0 +1,210 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef __SIRIKATA_OH_STORAGE_LOG_HPP__
+#define __SIRIKATA_OH_STORAGE_LOG_HPP__
+
+#include <sirikata/oh/Storage.hpp>
+#include <sirikata/core/queue/ThreadSafeQueueWithNotification.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <cstdio>
+
+namespace Sirikata {
+namespace OH {
+
+/** Storage in a single, append-only log file in this process.
+ *
+ *  All data is kept in memory as a sorted map per bucket, so reads never
+ *  touch the disk. Each committed transaction is appended to the log as one
+ *  checksummed record containing the resulting writes and erases; a partial
+ *  record at the end of the log (e.g. after a crash) is discarded when the
+ *  log is replayed on startup. Transactions that queue up while a commit is
+ *  in progress are written (and optionally synced) together.
+ *
+ *  Once the log grows sufficiently larger than the live data, it is
+ *  compacted into a new log. The storage thread walks the data a chunk at a
+ *  time between commits, encoding each chunk as a record which a background
+ *  thread writes out. Since records hold absolute puts and erases, the chunks
+ *  don't need to come from a single point in time: every record committed
+ *  after the walk starts is appended to the new log as well, and replaying
+ *  them brings any key the walk saw too early or too late up to date. Then
+ *  the new log is swapped in.
+ *
+ *  Only one process may use a log at a time. Leases are handled by holding a
+ *  lock on an accompanying lock file for as long as the storage is running,
+ *  which covers every bucket. If the lock can't be acquired, all transactions
+ *  fail with LOCK_ERROR.
+ */
+class LogStorage : public Storage
+{
+public:
+    /** Create a LogStorage.
+     *  \param ctx the ObjectHostContext
+     *  \param path path to the log file
+     *  \param sync if true, sync the log to disk before reporting commits as
+     *         successful. Otherwise commits are only guaranteed to survive
+     *         the process crashing, not the system crashing.
+     *  \param compact_min_size don't compact logs smaller than this
+     *  \param compact_ratio compact when the log is this many times larger
+     *         than the live data
+     */
+    LogStorage(ObjectHostContext* ctx, const String& path, bool sync, uint64 compact_min_size, float64 compact_ratio);
+    ~LogStorage();
+
+    virtual void start();
+    virtual void stop();
+
+    virtual void leaseBucket(const Bucket& bucket);
+    virtual void releaseBucket(const Bucket& bucket);
+
+    virtual void beginTransaction(const Bucket& bucket);
+
+    virtual void commitTransaction(const Bucket& bucket, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool erase(const Bucket& bucket, const Key& key, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool write(const Bucket& bucket, const Key& key, const String& value, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool read(const Bucket& bucket, const Key& key, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool compare(const Bucket& bucket, const Key& key, const String& value, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool rangeRead(const Bucket& bucket, const Key& start, const Key& finish, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool rangeErase(const Bucket& bucket, const Key& start, const Key& finish, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool count(const Bucket& bucket, const Key& start, const Key& finish, const CountCallback& cb = 0, const String& timestamp="current");
+
+private:
+    struct StorageAction {
+        enum Type {
+            Read,
+            ReadRange,
+            Compare,
+            Write,
+            Erase,
+            EraseRange
+        };
+
+        Type type;
+        Key key;
+        Key keyEnd; // Only relevant for *Range
+        String value; // Only relevant for Write and Compare
+    };
+
+    typedef std::vector<StorageAction> Transaction;
+    typedef std::tr1::unordered_map<Bucket, Transaction*, Bucket::Hasher> BucketTransactions;
+
+    struct TransactionData {
+        TransactionData()
+         : bucket(), trans(NULL), cb()
+        {}
+        TransactionData(const Bucket& b, Transaction* t, CommitCallback c)
+         : bucket(b), trans(t), cb(c)
+        {}
+
+        Bucket bucket;
+        Transaction* trans;
+        CommitCallback cb;
+    };
+    typedef ThreadSafeQueueWithNotification<TransactionData> TransactionQueue;
+
+    // The in-memory copy of all data
+    typedef std::map<Key, String> BucketData;
+    typedef std::tr1::unordered_map<Bucket, BucketData, Bucket::Hasher> Data;
+    typedef std::tr1::shared_ptr<String> StringPtr;
+
+    // Previous state of a key modified by a transaction, so it can be rolled
+    // back if the transaction fails.
+    struct UndoEntry {
+        Bucket bucket;
+        Key key;
+        bool existed;
+        String value;
+    };
+    typedef std::vector<UndoEntry> UndoLog;
+
+    Transaction* getTransaction(const Bucket& bucket, bool* is_new = NULL);
+
+    // Storage thread methods
+
+    // Acquire the lock, replay the log and open it for appending.
+    void initLog();
+    // Replay the log into mData. Returns the size of the valid prefix of the
+    // log.
+    uint64 replayLog();
+    bool openLogForAppend();
+    // Write data to the log, syncing if requested. Returns false on error.
+    static bool writeLog(FILE* fp, const String& data, bool sync);
+
+    void postProcessTransactions();
+    void processTransactions();
+    // Runs the transaction against mData. Modifications are recorded in
+    // record (in log format) and undo.
+    Result executeTransaction(const Bucket& bucket, Transaction* trans, ReadSet* rs, String* record, UndoLog* undo);
+    void putKey(const Bucket& bucket, const Key& key, const String& value, String* record, UndoLog* undo);
+    void eraseKey(const Bucket& bucket, BucketData& bucket_data, BucketData::iterator it, String* record, UndoLog* undo);
+    void rollback(UndoLog& undo);
+
+    void executeCount(const Bucket& bucket, const Key& start, const Key& finish, CountCallback cb);
+
+    // Compaction. The storage thread encodes the data one chunk at a time,
+    // the compaction thread writes the chunks out, and the storage thread
+    // finishes it off.
+    void checkCompaction();
+    void snapshotChunk();
+    // Compaction thread methods
+    void openCompactedLog();
+    void writeCompactedRecord(StringPtr record);
+    void closeCompactedLog();
+    // Back on the storage thread
+    void finishCompaction(bool success);
+
+    ObjectHostContext* mContext;
+    BucketTransactions mTransactions;
+
+    const String mPath;
+    const String mCompactPath;
+    const String mLockPath;
+    const bool mSync;
+    const uint64 mCompactMinSize;
+    const float64 mCompactRatio;
+
+    Network::IOService* mIOService;
+    Network::IOWork* mWork;
+    Thread* mThread;
+
+    // Compaction runs in its own thread so it doesn't block commits.
+    Network::IOService* mCompactionService;
+    Network::IOWork* mCompactionWork;
+    Thread* mCompactionThread;
+    // Keeps the compaction thread running between chunks of a compaction,
+    // including while stop() waits for it.
+    Network::IOWork* mCompactionActiveWork;
+    // Only accessed from the compaction thread
+    FILE* mCompactLog;
+    bool mCompactLogOK;
+
+    TransactionQueue mTransactionQueue;
+
+    // Everything below is only accessed from the storage thread.
+    bool mLocked;
+    boost::interprocess::file_lock* mLock;
+    FILE* mLog;
+    Data mData;
+    // Size of the log file and approximate size of the live data in log
+    // format, used to decide when to compact.
+    uint64 mLogSize;
+    uint64 mLiveSize;
+    // Whether a compaction is in progress, and records committed since it
+    // started, which need to be added to the compacted log.
+    bool mCompacting;
+    String mCompactionBacklog;
+    // Where the compaction's walk over mData is. Buckets are listed up front
+    // since mData may rehash in the meantime; any bucket created later only
+    // holds data from the backlog.
+    std::vector<Bucket> mSnapshotBuckets;
+    uint32 mSnapshotBucketIdx;
+    // Last key written from the current bucket, if any
+    bool mSnapshotHaveKey;
+    Key mSnapshotKey;
+};
+
+}//end namespace OH
+}//end namespace Sirikata
+
+#endif //__SIRIKATA_OH_STORAGE_LOG_HPP__
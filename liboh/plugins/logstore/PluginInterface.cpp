@@ -0,0 +1,68 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/oh/Platform.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include "LogStorage.hpp"
+
+static int logstore_plugin_refcount = 0;
+
+namespace Sirikata {
+
+static void InitPluginOptions() {
+    Sirikata::InitializeClassOptions ico("logstorage",NULL,
+        new Sirikata::OptionValue("db", "storage.log", Sirikata::OptionValueType<String>(), "Log file to store data to."),
+        new Sirikata::OptionValue("sync", "false", Sirikata::OptionValueType<bool>(), "Sync the log to disk before reporting each commit as successful. Without this, commits survive the process crashing but not the whole system crashing."),
+        new Sirikata::OptionValue("compact-min-size", "16777216", Sirikata::OptionValueType<uint64>(), "Never compact logs smaller than this many bytes."),
+        new Sirikata::OptionValue("compact-ratio", "2", Sirikata::OptionValueType<float64>(), "Compact the log when it is this many times larger than the live data."),
+        NULL);
+}
+
+static OH::Storage* createLogStorage(ObjectHostContext* ctx, const String& args) {
+    OptionSet* optionsSet = OptionSet::getOptions("logstorage",NULL);
+    optionsSet->parse(args);
+
+    String db = optionsSet->referenceOption("db")->as<String>();
+    bool sync = optionsSet->referenceOption("sync")->as<bool>();
+    uint64 compact_min_size = optionsSet->referenceOption("compact-min-size")->as<uint64>();
+    float64 compact_ratio = optionsSet->referenceOption("compact-ratio")->as<float64>();
+
+    return new OH::LogStorage(ctx, db, sync, compact_min_size, compact_ratio);
+}
+
+} // namespace Sirikata
+
+SIRIKATA_PLUGIN_EXPORT_C void init() {
+    using namespace Sirikata;
+    if (logstore_plugin_refcount==0) {
+        InitPluginOptions();
+        OH::StorageFactory::getSingleton()
+            .registerConstructor("log",
+                                 std::tr1::bind(&createLogStorage, std::tr1::placeholders::_1, std::tr1::placeholders::_2));
+    }
+    logstore_plugin_refcount++;
+}
+
+SIRIKATA_PLUGIN_EXPORT_C int increfcount() {
+    return ++logstore_plugin_refcount;
+}
+SIRIKATA_PLUGIN_EXPORT_C int decrefcount() {
+    assert(logstore_plugin_refcount>0);
+    return --logstore_plugin_refcount;
+}
+
+SIRIKATA_PLUGIN_EXPORT_C void destroy() {
+    using namespace Sirikata;
+    if (logstore_plugin_refcount==0) {
+        OH::StorageFactory::getSingleton().unregisterConstructor("log");
+    }
+}
+
+SIRIKATA_PLUGIN_EXPORT_C const char* name() {
+    return "oh-logstore";
+}
+
+SIRIKATA_PLUGIN_EXPORT_C int refcount() {
+    return logstore_plugin_refcount;
+}
@@ -44,6 +44,10 @@ static void InitPluginOptions() {
     Sirikata::InitializeClassOptions ico("sqlitestorage",NULL,
         new Sirikata::OptionValue("db", "storage.db", Sirikata::OptionValueType<String>(), "Database file to store data to."),
         new Sirikata::OptionValue("lease-duration", "30s", Sirikata::OptionValueType<Duration>(), "Duration to register leases for. Longer times require less overhead, but also mean longer delays if an object or object host dies without cleaning up."),
+        new Sirikata::OptionValue("wal", "false", Sirikata::OptionValueType<bool>(), "Use a write-ahead log instead of a rollback journal. Commits are much cheaper, but the database is split across multiple files."),
+        new Sirikata::OptionValue("mmap-size", "0", Sirikata::OptionValueType<uint64>(), "Maximum number of bytes of the database to access through memory mapped I/O. 0 disables memory mapping."),
+        new Sirikata::OptionValue("group-commit-window", "5ms", Sirikata::OptionValueType<Duration>(), "How long to wait for more transactions before committing, allowing them to be committed together. Higher values increase throughput but also latency."),
+        new Sirikata::OptionValue("max-coalesced", "64", Sirikata::OptionValueType<uint32>(), "Maximum number of transactions to commit together."),
         NULL);
 
     Sirikata::InitializeClassOptions icop("sqlitepersistedset",NULL,
@@ -61,8 +65,12 @@ static OH::Storage* createSQLiteStorage(ObjectHostContext* ctx, const String& ar
 
     String db = optionsSet->referenceOption("db")->as<String>();
     Duration lease_duration = optionsSet->referenceOption("lease-duration")->as<Duration>();
+    bool wal = optionsSet->referenceOption("wal")->as<bool>();
+    uint64 mmap_size = optionsSet->referenceOption("mmap-size")->as<uint64>();
+    Duration group_commit_window = optionsSet->referenceOption("group-commit-window")->as<Duration>();
+    uint32 max_coalesced = optionsSet->referenceOption("max-coalesced")->as<uint32>();
 
-    return new OH::SQLiteStorage(ctx, db, lease_duration);
+    return new OH::SQLiteStorage(ctx, db, lease_duration, wal, mmap_size, group_commit_window, max_coalesced);
 }
 
 static OH::PersistedObjectSet* createSQLitePersistedObjectSet(ObjectHostContext* ctx, const String& args) {
@@ -87,7 +87,58 @@ SQLiteStorage::StorageAction& SQLiteStorage::StorageAction::operator=(const Stor
     return *this;
 }
 
-Storage::Result SQLiteStorage::StorageAction::execute(SQLiteDBPtr db, const Bucket& bucket, ReadSet* rs) {
+namespace {
+// SQL for each StatementType. The bucket is always the first parameter.
+const char* StatementSQL[] = {
+    "BEGIN DEFERRED TRANSACTION",
+    "COMMIT TRANSACTION",
+    "ROLLBACK TRANSACTION",
+    "SELECT value FROM \"" TABLE_NAME "\" WHERE object == ? AND key == ?",
+    "SELECT key, value FROM \"" TABLE_NAME "\" WHERE object == ? AND key BETWEEN ? AND ?",
+    "INSERT OR REPLACE INTO \"" TABLE_NAME "\" (object, key, value) VALUES(?, ?, ?)",
+    "DELETE FROM \"" TABLE_NAME "\" WHERE object = ? AND key = ?",
+    "DELETE FROM \"" TABLE_NAME "\" WHERE object = ? AND key BETWEEN ? AND ?",
+    "SELECT COUNT(*) FROM \"" TABLE_NAME "\" WHERE object = ? AND key BETWEEN ? AND ?"
+};
+}
+
+SQLiteStorage::StatementCache::StatementCache()
+ : mDB()
+{
+    for(int i = 0; i < NumStatements; i++)
+        mStatements[i] = NULL;
+}
+
+SQLiteStorage::StatementCache::~StatementCache() {
+    reset(SQLiteDBPtr());
+}
+
+void SQLiteStorage::StatementCache::reset(SQLiteDBPtr db) {
+    for(int i = 0; i < NumStatements; i++) {
+        if (mStatements[i] != NULL) {
+            sqlite3_finalize(mStatements[i]);
+            mStatements[i] = NULL;
+        }
+    }
+    mDB = db;
+}
+
+sqlite3_stmt* SQLiteStorage::StatementCache::get(StatementType type) {
+    if (mStatements[type] == NULL && mDB) {
+        sqlite3_stmt* stmt = NULL;
+        int rc = sqlite3_prepare_v2(mDB->db(), StatementSQL[type], -1, &stmt, NULL);
+        if (checkSQLiteError(mDB, rc, String("Error preparing statement: ") + StatementSQL[type])) {
+            sqlite3_finalize(stmt);
+            return NULL;
+        }
+        mStatements[type] = stmt;
+    }
+    return mStatements[type];
+}
+
+Storage::Result SQLiteStorage::StorageAction::execute(StatementCache& stmts, const Bucket& bucket, ReadSet* rs) {
+    SQLiteDBPtr db = stmts.db();
+    const String bucket_str = bucket.rawHexData();
     Result result = SUCCESS;
     switch(type) {
 
@@ -96,52 +147,48 @@ Storage::Result SQLiteStorage::StorageAction::execute(SQLiteDBPtr db, const Buck
       case Read:
       case Compare:
           {
-              String value_query = "SELECT value FROM ";
-              value_query += "\"" TABLE_NAME "\"";
-              value_query += " WHERE object == \'" + bucket.rawHexData() + "\' AND key == ?";
               int rc;
-              char* remain;
-              sqlite3_stmt* value_query_stmt;
               bool newStep = true;
-              rc = sqlite3_prepare_v2(db->db(), value_query.c_str(), -1, &value_query_stmt, (const char**)&remain);
+              sqlite3_stmt* value_query_stmt = stmts.get(ReadStatement);
+              if (value_query_stmt == NULL) return TRANSACTION_ERROR;
               bool success = true;
-              success = success && !checkSQLiteError(db, rc, "Error preparing value query statement");
+              rc = sqlite3_bind_text(value_query_stmt, 1, bucket_str.c_str(), (int)bucket_str.size(), SQLITE_TRANSIENT);
+              success = success && !checkSQLiteError(db, rc, "Error binding object to value query statement");
+              if (rc==SQLITE_OK)
+                  rc = sqlite3_bind_text(value_query_stmt, 2, key.c_str(), (int)key.size(), SQLITE_TRANSIENT);
+              success = success && !checkSQLiteError(db, rc, "Error binding key name to value query statement");
               if (rc==SQLITE_OK) {
-                  rc = sqlite3_bind_text(value_query_stmt, 1, key.c_str(), (int)key.size(), SQLITE_TRANSIENT);
-                  success = success && !checkSQLiteError(db, rc, "Error binding key name to value query statement");
-                  if (rc==SQLITE_OK) {
-                      int step_rc = sqlite3_step(value_query_stmt);
-                      while(step_rc == SQLITE_ROW) {
-                          newStep = false;
-                          if (type == Read) {
-                              (*rs)[key] = String(
-                                  (const char*)sqlite3_column_text(value_query_stmt, 0),
-                                  sqlite3_column_bytes(value_query_stmt, 0)
-                              );
-                          }
-                          else if (type == Compare) {
-                              assert(value != NULL);
-                              String db_val(
-                                  (const char*)sqlite3_column_text(value_query_stmt, 0),
-                                  sqlite3_column_bytes(value_query_stmt, 0)
-                              );
-                              success = success && (db_val == *value);
-                          }
-                          step_rc = sqlite3_step(value_query_stmt);
+                  int step_rc = sqlite3_step(value_query_stmt);
+                  while(step_rc == SQLITE_ROW) {
+                      newStep = false;
+                      if (type == Read) {
+                          (*rs)[key] = String(
+                              (const char*)sqlite3_column_text(value_query_stmt, 0),
+                              sqlite3_column_bytes(value_query_stmt, 0)
+                          );
                       }
-                      if (step_rc != SQLITE_DONE) {
-                          // reset the statement so it'll clean up properly
-                          rc = sqlite3_reset(value_query_stmt);
-                          success = success && !checkSQLiteError(db, rc, "Error finalizing value query statement");
-                          // Make sure we notify of temporary failures in case
-                          // retrying is worth it
-                          if (step_rc == SQLITE_LOCKED || step_rc == SQLITE_BUSY)
-                              result = LOCK_ERROR;
+                      else if (type == Compare) {
+                          assert(value != NULL);
+                          String db_val(
+                              (const char*)sqlite3_column_text(value_query_stmt, 0),
+                              sqlite3_column_bytes(value_query_stmt, 0)
+                          );
+                          success = success && (db_val == *value);
                       }
+                      step_rc = sqlite3_step(value_query_stmt);
+                  }
+                  if (step_rc != SQLITE_DONE) {
+                      // reset the statement so it'll clean up properly
+                      rc = sqlite3_reset(value_query_stmt);
+                      success = success && !checkSQLiteError(db, rc, "Error finalizing value query statement");
+                      // Make sure we notify of temporary failures in case
+                      // retrying is worth it
+                      if (step_rc == SQLITE_LOCKED || step_rc == SQLITE_BUSY)
+                          result = LOCK_ERROR;
                   }
               }
-              rc = sqlite3_finalize(value_query_stmt);
-              success = success && !checkSQLiteError(db, rc, "Error finalizing value query statement");
+              rc = sqlite3_reset(value_query_stmt);
+              success = success && !checkSQLiteError(db, rc, "Error resetting value query statement");
 
               if (newStep) { // no rows were found, key is missing
                   success = false;
@@ -159,20 +206,16 @@ Storage::Result SQLiteStorage::StorageAction::execute(SQLiteDBPtr db, const Buck
 
       case ReadRange:
           {
-              String value_query = "SELECT key, value FROM ";
-              value_query += "\"" TABLE_NAME "\"";
-              value_query += " WHERE object == \'" + bucket.rawHexData() + "\' AND key BETWEEN ? AND ?";
-
               int rc;
-              char* remain;
-              sqlite3_stmt* value_query_stmt;
-              rc = sqlite3_prepare_v2(db->db(), value_query.c_str(), -1, &value_query_stmt, (const char**)&remain);
+              sqlite3_stmt* value_query_stmt = stmts.get(ReadRangeStatement);
+              if (value_query_stmt == NULL) return TRANSACTION_ERROR;
               bool success = true;
-              success = success && !checkSQLiteError(db, rc, "Error preparing value query statement");
+              rc = sqlite3_bind_text(value_query_stmt, 1, bucket_str.c_str(), (int)bucket_str.size(), SQLITE_TRANSIENT);
+              success = success && !checkSQLiteError(db, rc, "Error binding object to value query statement");
               if (rc==SQLITE_OK){
-                  rc = sqlite3_bind_text(value_query_stmt, 1, key.c_str(), (int)key.size(), SQLITE_TRANSIENT);
+                  rc = sqlite3_bind_text(value_query_stmt, 2, key.c_str(), (int)key.size(), SQLITE_TRANSIENT);
                   success = success && !checkSQLiteError(db, rc, "Error binding start key to value query statement");
-                  rc = sqlite3_bind_text(value_query_stmt, 2, keyEnd.c_str(), (int)keyEnd.size(), SQLITE_TRANSIENT);
+                  rc = sqlite3_bind_text(value_query_stmt, 3, keyEnd.c_str(), (int)keyEnd.size(), SQLITE_TRANSIENT);
                   success = success && !checkSQLiteError(db, rc, "Error binding finish key to value query statement");
                   if (rc==SQLITE_OK) {
                       int step_rc = sqlite3_step(value_query_stmt);
@@ -208,8 +251,8 @@ Storage::Result SQLiteStorage::StorageAction::execute(SQLiteDBPtr db, const Buck
                       }
                   }
               }
-              rc = sqlite3_finalize(value_query_stmt);
-              success = success && !checkSQLiteError(db, rc, "Error finalizing value query statement");
+              rc = sqlite3_reset(value_query_stmt);
+              success = success && !checkSQLiteError(db, rc, "Error resetting value query statement");
               // If no other error condition is indicated yet, mark transaction
               // error for failures
               if (!success && result == SUCCESS)
@@ -223,31 +266,19 @@ Storage::Result SQLiteStorage::StorageAction::execute(SQLiteDBPtr db, const Buck
               // Erase and write use different statements, but the rest is the
               // same since it just needs to execute and check for success.
               int rc;
-              char* remain;
 
-              String value_insert;
-              if (type == Write) {
-                  value_insert = "INSERT OR REPLACE INTO ";
-                  value_insert += "\"" TABLE_NAME "\"";
-                  value_insert += " (object, key, value) VALUES(\'" + bucket.rawHexData() + "\', ?, ?)";
-              }
-              else if (type == Erase) {
-                  value_insert = "DELETE FROM ";
-                  value_insert += "\"" TABLE_NAME "\"";
-                  value_insert += " WHERE object = \'" + bucket.rawHexData() + "\' AND key = ?";
-              }
-
-              sqlite3_stmt* value_insert_stmt;
-              rc = sqlite3_prepare_v2(db->db(), value_insert.c_str(), -1, &value_insert_stmt, (const char**)&remain);
+              sqlite3_stmt* value_insert_stmt = stmts.get(type == Write ? WriteStatement : EraseStatement);
+              if (value_insert_stmt == NULL) return TRANSACTION_ERROR;
               bool success = true;
-              success = success && !checkSQLiteError(db, rc, "Error preparing value insert statement");
 
-              rc = sqlite3_bind_text(value_insert_stmt, 1, key.c_str(), (int)key.size(), SQLITE_TRANSIENT);
+              rc = sqlite3_bind_text(value_insert_stmt, 1, bucket_str.c_str(), (int)bucket_str.size(), SQLITE_TRANSIENT);
+              success = success && !checkSQLiteError(db, rc, "Error binding object to value insert statement");
+              rc = sqlite3_bind_text(value_insert_stmt, 2, key.c_str(), (int)key.size(), SQLITE_TRANSIENT);
               success = success && !checkSQLiteError(db, rc, "Error binding key name to value insert statement");
               if (rc==SQLITE_OK) {
                   if (type == Write) {
                       assert(value != NULL);
-                      rc = sqlite3_bind_blob(value_insert_stmt, 2, value->c_str(), (int)value->size(), SQLITE_TRANSIENT);
+                      rc = sqlite3_bind_blob(value_insert_stmt, 3, value->c_str(), (int)value->size(), SQLITE_TRANSIENT);
                       success = success && !checkSQLiteError(db, rc, "Error binding value to value insert statement");
                   }
               }
@@ -285,8 +316,8 @@ Storage::Result SQLiteStorage::StorageAction::execute(SQLiteDBPtr db, const Buck
                   }
               }
 
-              rc = sqlite3_finalize(value_insert_stmt);
-              success = success && !checkSQLiteError(db, rc, "Error finalizing value insert statement");
+              rc = sqlite3_reset(value_insert_stmt);
+              success = success && !checkSQLiteError(db, rc, "Error resetting value insert statement");
 
               // If no other error condition is indicated yet, mark transaction
               // error for failures
@@ -297,20 +328,16 @@ Storage::Result SQLiteStorage::StorageAction::execute(SQLiteDBPtr db, const Buck
 
       case EraseRange:
           {
-              String value_delete = "DELETE FROM ";
-              value_delete += "\"" TABLE_NAME "\"";
-              value_delete += " WHERE object = \'" + bucket.rawHexData() + "\' AND key BETWEEN ? AND ?";
-
               int rc;
-              char* remain;
-              sqlite3_stmt* value_delete_stmt;
-              rc = sqlite3_prepare_v2(db->db(), value_delete.c_str(), -1, &value_delete_stmt, (const char**)&remain);
+              sqlite3_stmt* value_delete_stmt = stmts.get(EraseRangeStatement);
+              if (value_delete_stmt == NULL) return TRANSACTION_ERROR;
               bool success = true;
-              success = success && !checkSQLiteError(db, rc, "Error preparing value delete statement");
 
-              rc = sqlite3_bind_text(value_delete_stmt, 1, key.c_str(), (int)key.size(), SQLITE_TRANSIENT);
+              rc = sqlite3_bind_text(value_delete_stmt, 1, bucket_str.c_str(), (int)bucket_str.size(), SQLITE_TRANSIENT);
+              success = success && !checkSQLiteError(db, rc, "Error binding object to value delete statement");
+              rc = sqlite3_bind_text(value_delete_stmt, 2, key.c_str(), (int)key.size(), SQLITE_TRANSIENT);
               success = success && !checkSQLiteError(db, rc, "Error binding start key to value delete statement");
-              rc = sqlite3_bind_text(value_delete_stmt, 2, keyEnd.c_str(), (int)keyEnd.size(), SQLITE_TRANSIENT);
+              rc = sqlite3_bind_text(value_delete_stmt, 3, keyEnd.c_str(), (int)keyEnd.size(), SQLITE_TRANSIENT);
               success = success && !checkSQLiteError(db, rc, "Error binding finish key to value delete statement");
 
               int step_rc = sqlite3_step(value_delete_stmt);
@@ -321,8 +348,8 @@ Storage::Result SQLiteStorage::StorageAction::execute(SQLiteDBPtr db, const Buck
                   if (step_rc == SQLITE_LOCKED || step_rc == SQLITE_BUSY)
                       result = LOCK_ERROR;
               }
-              rc = sqlite3_finalize(value_delete_stmt);
-              success = success && !checkSQLiteError(db, rc, "Error finalizing value delete statement");
+              rc = sqlite3_reset(value_delete_stmt);
+              success = success && !checkSQLiteError(db, rc, "Error resetting value delete statement");
 
               // If no other error condition is indicated yet, mark transaction
               // error for failures
@@ -339,12 +366,12 @@ Storage::Result SQLiteStorage::StorageAction::execute(SQLiteDBPtr db, const Buck
     return result;
 }
 
-Storage::Result SQLiteStorage::StorageAction::executeWithRetry(SQLiteDBPtr db, const Bucket& bucket, ReadSet* rs, int32 retries, const Duration& retry_wait) {
+Storage::Result SQLiteStorage::StorageAction::executeWithRetry(StatementCache& stmts, const Bucket& bucket, ReadSet* rs, int32 retries, const Duration& retry_wait) {
     Storage::Result res = LOCK_ERROR;
     for(int32 i = 0; i < retries && res == LOCK_ERROR; i++) {
         if (i != 0) Timer::sleep(retry_wait);
 
-        res = execute(db, bucket, rs);
+        res = execute(stmts, bucket, rs);
     }
 
     if (res == LOCK_ERROR)
@@ -352,10 +379,14 @@ Storage::Result SQLiteStorage::StorageAction::executeWithRetry(SQLiteDBPtr db, c
     return res;
 }
 
-SQLiteStorage::SQLiteStorage(ObjectHostContext* ctx, const String& dbpath, const Duration& lease_duration)
+SQLiteStorage::SQLiteStorage(ObjectHostContext* ctx, const String& dbpath, const Duration& lease_duration,
+    bool wal, uint64 mmap_size, const Duration& group_commit_window, uint32 max_coalesced)
  : mContext(ctx),
    mDBFilename(dbpath),
    mDB(),
+   mStatements(),
+   mWAL(wal),
+   mMMapSize(mmap_size),
    mIOService(NULL),
    mWork(NULL),
    mThread(NULL),
@@ -365,7 +396,8 @@ SQLiteStorage::SQLiteStorage(ObjectHostContext* ctx, const String& dbpath, const
    mSQLClientID(UUID::random().rawHexData()),
    mLeaseDuration(lease_duration),
    mTransactionQueue(std::tr1::bind(&SQLiteStorage::postProcessTransactions, this)),
-   mMaxCoalescedTransactions(5),
+   mMaxCoalescedTransactions(std::max(max_coalesced, (uint32)1)),
+   mGroupCommitWindow(group_commit_window),
    mRetrySleepDuration(Duration::milliseconds(25)),
    mNormalOpRetries(20),
    mLeaseOpRetries(100),
@@ -405,86 +437,81 @@ void SQLiteStorage::initDB() {
     SQLiteDBPtr db = SQLite::getSingleton().open(mDBFilename);
     sqlite3_busy_timeout(db->db(), 1000);
 
-    // Create the table for this object if it doesn't exist yet
-    String table_create = "CREATE TABLE IF NOT EXISTS ";
-    table_create += "\"" TABLE_NAME "\"";
-    table_create += "(object TEXT, key TEXT, value TEXT, PRIMARY KEY(object, key))";
-
-    int rc;
-    char* remain;
-    sqlite3_stmt* table_create_stmt;
-
     mDB = db;
 
     bool success = true;
 
-    rc = sqlite3_prepare_v2(db->db(), table_create.c_str(), -1, &table_create_stmt, (const char**)&remain);
-    success = success && !checkSQLiteError(db, rc, "Error preparing table create statement");
+    if (mWAL) {
+        // The journal mode is persistent, but setting it again is harmless.
+        // NORMAL sync is safe with WAL: a crash can only lose the most recent
+        // commits, it can't corrupt the database.
+        success = success && sqlExecute("PRAGMA journal_mode=WAL", "journal mode");
+        success = success && sqlExecute("PRAGMA synchronous=NORMAL", "synchronous mode");
+    }
+    // Older versions of SQLite just ignore this.
+    if (mMMapSize > 0)
+        success = success && sqlExecute("PRAGMA mmap_size=" + boost::lexical_cast<String>(mMMapSize), "mmap size");
 
-    rc = sqlite3_step(table_create_stmt);
-    success = success && !checkSQLiteError(db, rc, "Error executing table create statement");
-    rc = sqlite3_finalize(table_create_stmt);
-    success = success && !checkSQLiteError(db, rc, "Error finalizing table create statement");
+    // Create the table for this object if it doesn't exist yet
+    String table_create = "CREATE TABLE IF NOT EXISTS ";
+    table_create += "\"" TABLE_NAME "\"";
+    table_create += "(object TEXT, key TEXT, value TEXT, PRIMARY KEY(object, key))";
+    success = success && sqlExecute(table_create, "table create");
 
-    if (!success)
+    if (!success) {
         mDB.reset();
-}
+        return;
+    }
 
-bool SQLiteStorage::sqlBeginTransaction() {
-    String begin = "BEGIN DEFERRED TRANSACTION";
+    mStatements.reset(mDB);
+}
 
+bool SQLiteStorage::sqlExecute(const String& sql, const String& desc) {
     int rc;
-    char* remain;
-    sqlite3_stmt* begin_stmt;
+    sqlite3_stmt* stmt;
     bool success = true;
 
-    rc = sqlite3_prepare_v2(mDB->db(), begin.c_str(), -1, &begin_stmt, (const char**)&remain);
-    success = success && !checkSQLiteError(mDB, rc, "Error preparing begin transaction statement");
+    rc = sqlite3_prepare_v2(mDB->db(), sql.c_str(), -1, &stmt, NULL);
+    success = success && !checkSQLiteError(mDB, rc, "Error preparing " + desc + " statement");
 
-    rc = sqlite3_step(begin_stmt);
-    success = success && !checkSQLiteError(mDB, rc, "Error executing begin statement");
-    rc = sqlite3_finalize(begin_stmt);
-    success = success && !checkSQLiteError(mDB, rc, "Error finalizing begin statement");
+    if (success) {
+        // Some statements, e.g. pragmas, return rows we don't care about
+        do {
+            rc = sqlite3_step(stmt);
+        } while(rc == SQLITE_ROW);
+        success = success && !checkSQLiteError(mDB, rc, "Error executing " + desc + " statement");
+    }
+    rc = sqlite3_finalize(stmt);
+    success = success && !checkSQLiteError(mDB, rc, "Error finalizing " + desc + " statement");
 
     return success;
 }
 
-bool SQLiteStorage::sqlRollback() {
-    String rollback = "ROLLBACK TRANSACTION";
-
+bool SQLiteStorage::sqlExecuteCached(StatementType type, const String& desc) {
     int rc;
-    char* remain;
-    sqlite3_stmt* rollback_stmt;
     bool success = true;
 
-    rc = sqlite3_prepare_v2(mDB->db(), rollback.c_str(), -1, &rollback_stmt, (const char**)&remain);
-    success = success && !checkSQLiteError(mDB, rc, "Error preparing rollback transaction statement");
+    sqlite3_stmt* stmt = mStatements.get(type);
+    if (stmt == NULL) return false;
 
-    rc = sqlite3_step(rollback_stmt);
-    success = success && !checkSQLiteError(mDB, rc, "Error executing rollback statement");
-    rc = sqlite3_finalize(rollback_stmt);
-    success = success && !checkSQLiteError(mDB, rc, "Error finalizing rollback statement");
+    rc = sqlite3_step(stmt);
+    success = success && !checkSQLiteError(mDB, rc, "Error executing " + desc + " statement");
+    rc = sqlite3_reset(stmt);
+    success = success && !checkSQLiteError(mDB, rc, "Error resetting " + desc + " statement");
 
     return success;
 }
 
-bool SQLiteStorage::sqlCommit() {
-    String commit = "COMMIT TRANSACTION";
-
-    int rc;
-    char* remain;
-    sqlite3_stmt* commit_stmt;
-    bool success = true;
-
-    rc = sqlite3_prepare_v2(mDB->db(), commit.c_str(), -1, &commit_stmt, (const char**)&remain);
-    success = success && !checkSQLiteError(mDB, rc, "Error preparing commit transaction statement");
+bool SQLiteStorage::sqlBeginTransaction() {
+    return sqlExecuteCached(BeginStatement, "begin");
+}
 
-    rc = sqlite3_step(commit_stmt);
-    success = success && !checkSQLiteError(mDB, rc, "Error executing commit statement");
-    rc = sqlite3_finalize(commit_stmt);
-    success = success && !checkSQLiteError(mDB, rc, "Error finalizing commit statement");
+bool SQLiteStorage::sqlRollback() {
+    return sqlExecuteCached(RollbackStatement, "rollback");
+}
 
-    return success;
+bool SQLiteStorage::sqlCommit() {
+    return sqlExecuteCached(CommitStatement, "commit");
 }
 
 void SQLiteStorage::stop() {
@@ -503,6 +530,9 @@ void SQLiteStorage::stop() {
     delete mIOService;
     mIOService = NULL;
 
+    // The IO thread is gone, so it's safe to clean up its statements.
+    mStatements.reset(SQLiteDBPtr());
+
     // Clean up data from any outstanding pending transactions
     for(BucketTransactions::iterator it = mTransactions.begin(); it != mTransactions.end(); it++) {
         Transaction* trans = it->second;
@@ -562,6 +592,17 @@ void SQLiteStorage::commitTransaction(const Bucket& bucket, const CommitCallback
 }
 
 void SQLiteStorage::postProcessTransactions() {
+    // Only triggered when the queue becomes non-empty, so delaying here lets
+    // other transactions queue up and be committed together with this one.
+    if (mGroupCommitWindow > Duration::zero()) {
+        mIOService->post(
+            mGroupCommitWindow,
+            std::tr1::bind(&SQLiteStorage::processTransactions, this),
+            "SQLiteStorage::processTransactions"
+        );
+        return;
+    }
+
     mIOService->post(
         std::tr1::bind(&SQLiteStorage::processTransactions, this),
         "SQLiteStorage::processTransactions"
@@ -673,7 +714,7 @@ Storage::Result SQLiteStorage::executeCommit(const Bucket& bucket, Transaction*
     // and return the error.
     Result result = acquireLease(bucket);
     for (Transaction::iterator it = trans->begin(); (result == SUCCESS) && it != trans->end(); it++) {
-        result = (*it).executeWithRetry(mDB, bucket, rs, mNormalOpRetries, mRetrySleepDuration);
+        result = (*it).executeWithRetry(mStatements, bucket, rs, mNormalOpRetries, mRetrySleepDuration);
     }
 
     if (rs->empty() || (result != SUCCESS)) {
@@ -717,7 +758,7 @@ Storage::Result SQLiteStorage::acquireLease(const Bucket& bucket) {
         StorageAction sa;
         sa.type = StorageAction::Read;
         sa.key = LEASE_KEY;
-        result = sa.executeWithRetry(mDB, bucket, &lease_rs, mLeaseOpRetries, mRetrySleepDuration);
+        result = sa.executeWithRetry(mStatements, bucket, &lease_rs, mLeaseOpRetries, mRetrySleepDuration);
     }
 
     // Decide the next course of action based on whether the lease key
@@ -759,7 +800,7 @@ Storage::Result SQLiteStorage::acquireLease(const Bucket& bucket) {
         sa.key = LEASE_KEY;
         sa.value = new String(getLeaseString());
         ReadSet no_rs;
-        result = sa.executeWithRetry(mDB, bucket, &no_rs, mLeaseOpRetries, mRetrySleepDuration);
+        result = sa.executeWithRetry(mStatements, bucket, &no_rs, mLeaseOpRetries, mRetrySleepDuration);
 
         // If we succeeded here, we got the lease, otherwise we failed
         // and need to give up.
@@ -794,7 +835,7 @@ void SQLiteStorage::renewLease(const Bucket& bucket) {
         StorageAction sa;
         sa.type = StorageAction::Read;
         sa.key = LEASE_KEY;
-        result = sa.executeWithRetry(mDB, bucket, &lease_rs, mLeaseOpRetries, mRetrySleepDuration);
+        result = sa.executeWithRetry(mStatements, bucket, &lease_rs, mLeaseOpRetries, mRetrySleepDuration);
     }
 
     // Nothing in there or database was busy? releaseLease was called and
@@ -824,7 +865,7 @@ void SQLiteStorage::renewLease(const Bucket& bucket) {
         sa.key = LEASE_KEY;
         sa.value = new String(getLeaseString());
         ReadSet no_rs;
-        result = sa.executeWithRetry(mDB, bucket, &no_rs, mLeaseOpRetries, mRetrySleepDuration);
+        result = sa.executeWithRetry(mStatements, bucket, &no_rs, mLeaseOpRetries, mRetrySleepDuration);
     }
 
     // If we failed to write the new key, give up. This really shouldn't happen.
@@ -860,7 +901,7 @@ void SQLiteStorage::releaseLease(const Bucket& bucket) {
         StorageAction sa;
         sa.type = StorageAction::Read;
         sa.key = LEASE_KEY;
-        result = sa.executeWithRetry(mDB, bucket, &lease_rs, mLeaseOpRetries, mRetrySleepDuration);
+        result = sa.executeWithRetry(mStatements, bucket, &lease_rs, mLeaseOpRetries, mRetrySleepDuration);
     }
 
     // Nothing in there or database was busy? Nothing to do, although it might
@@ -895,7 +936,7 @@ void SQLiteStorage::releaseLease(const Bucket& bucket) {
         sa.type = StorageAction::Erase;
         sa.key = LEASE_KEY;
         ReadSet no_rs;
-        result = sa.executeWithRetry(mDB, bucket, &no_rs, mLeaseOpRetries, mRetrySleepDuration);
+        result = sa.executeWithRetry(mStatements, bucket, &no_rs, mLeaseOpRetries, mRetrySleepDuration);
     }
 
     if (result != SUCCESS) {
@@ -1027,43 +1068,40 @@ bool SQLiteStorage::rangeErase(const Bucket& bucket, const Key& start, const Key
 
 bool SQLiteStorage::count(const Bucket& bucket, const Key& start, const Key& finish, const CountCallback& cb, const String& timestamp) {
     // FIXME doesn't fit into transactions...
-    String value_count = "SELECT COUNT(*) FROM ";
-    value_count += "\"" TABLE_NAME "\"";
-    value_count += " WHERE object = \'" + bucket.rawHexData() + "\' AND key BETWEEN ? AND ?";
-
     mIOService->post(
-        std::tr1::bind(&SQLiteStorage::executeCount, this, value_count, start, finish, cb),
+        std::tr1::bind(&SQLiteStorage::executeCount, this, bucket, start, finish, cb),
         "SQLiteStorage::executeCount"
     );
     return true;
 }
 
-void SQLiteStorage::executeCount(const String value_count, const Key& start, const Key& finish, CountCallback cb)
+void SQLiteStorage::executeCount(const Bucket& bucket, const Key& start, const Key& finish, CountCallback cb)
 {
     bool success = true;
     int32 count = 0;
+    const String bucket_str = bucket.rawHexData();
 
-	int rc;
-    char* remain;
-    sqlite3_stmt* value_count_stmt;
-    rc = sqlite3_prepare_v2(mDB->db(), value_count.c_str(), -1, &value_count_stmt, (const char**)&remain);
-    success = success && !checkSQLiteError(mDB, rc, "Error preparing value count statement");
-
-    if (rc==SQLITE_OK) {
-    	rc = sqlite3_bind_text(value_count_stmt, 1, start.c_str(), (int)start.size(), SQLITE_TRANSIENT);
-    	success = success && !checkSQLiteError(mDB, rc, "Error binding start key to value count statement");
-    	rc = sqlite3_bind_text(value_count_stmt, 2, finish.c_str(), (int)finish.size(), SQLITE_TRANSIENT);
-    	success = success && !checkSQLiteError(mDB, rc, "Error binding finish key to value count statement");
-    	if (rc==SQLITE_OK) {
-    		int step_rc = sqlite3_step(value_count_stmt);
-    		count = sqlite3_column_int(value_count_stmt, 0);
-    		if (step_rc != SQLITE_OK && step_rc != SQLITE_DONE && step_rc != SQLITE_ROW)
-    			sqlite3_reset(value_count_stmt); // allow this to be cleaned up
-    	}
+    int rc;
+    sqlite3_stmt* value_count_stmt = mStatements.get(CountStatement);
+    success = (value_count_stmt != NULL);
+
+    if (success) {
+        rc = sqlite3_bind_text(value_count_stmt, 1, bucket_str.c_str(), (int)bucket_str.size(), SQLITE_TRANSIENT);
+        success = success && !checkSQLiteError(mDB, rc, "Error binding object to value count statement");
+        rc = sqlite3_bind_text(value_count_stmt, 2, start.c_str(), (int)start.size(), SQLITE_TRANSIENT);
+        success = success && !checkSQLiteError(mDB, rc, "Error binding start key to value count statement");
+        rc = sqlite3_bind_text(value_count_stmt, 3, finish.c_str(), (int)finish.size(), SQLITE_TRANSIENT);
+        success = success && !checkSQLiteError(mDB, rc, "Error binding finish key to value count statement");
+        if (rc==SQLITE_OK) {
+            int step_rc = sqlite3_step(value_count_stmt);
+            count = sqlite3_column_int(value_count_stmt, 0);
+            if (step_rc != SQLITE_OK && step_rc != SQLITE_DONE && step_rc != SQLITE_ROW)
+                sqlite3_reset(value_count_stmt); // allow this to be cleaned up
+        }
 
+        rc = sqlite3_reset(value_count_stmt);
+        success = success && !checkSQLiteError(mDB, rc, "Error resetting value count statement");
     }
-    rc = sqlite3_finalize(value_count_stmt);
-    success = success && !checkSQLiteError(mDB, rc, "Error finalizing value delete statement");
 
     if (cb) {
         Result result = (success ? SUCCESS : TRANSACTION_ERROR);
@@ -45,7 +45,23 @@ class FileStorageEvent;
 class SQLiteStorage : public Storage
 {
 public:
-    SQLiteStorage(ObjectHostContext* ctx, const String& dbpath, const Duration& lease_duration);
+    /** Create a SQLiteStorage.
+     *  \param ctx the ObjectHostContext
+     *  \param dbpath path to the database file
+     *  \param lease_duration duration to acquire bucket leases for
+     *  \param wal if true, use SQLite's write-ahead log instead of a rollback
+     *         journal, which makes commits cheaper and lets readers proceed
+     *         concurrently with a writer
+     *  \param mmap_size maximum number of bytes of the database to access
+     *         through memory mapped I/O, or 0 to use normal reads
+     *  \param group_commit_window how long to wait for more transactions
+     *         once one is queued, so they can share a single SQLite transaction
+     *  \param max_coalesced maximum number of transactions combined into a
+     *         single SQLite transaction
+     */
+    SQLiteStorage(ObjectHostContext* ctx, const String& dbpath, const Duration& lease_duration,
+        bool wal = false, uint64 mmap_size = 0,
+        const Duration& group_commit_window = Duration::zero(), uint32 max_coalesced = 5);
     ~SQLiteStorage();
 
     virtual void start();
@@ -66,6 +82,42 @@ public:
     virtual bool count(const Bucket& bucket, const Key& start, const Key& finish, const CountCallback& cb = 0, const String& timestamp="current");
 
 private:
+    // All the statements we use. They're prepared once and then reused, with
+    // the bucket and keys bound as parameters.
+    enum StatementType {
+        BeginStatement,
+        CommitStatement,
+        RollbackStatement,
+        ReadStatement,
+        ReadRangeStatement,
+        WriteStatement,
+        EraseStatement,
+        EraseRangeStatement,
+        CountStatement,
+        NumStatements
+    };
+
+    // Cache of prepared statements for a database connection. Statements are
+    // prepared on first use. Only used from the storage thread, and users
+    // must sqlite3_reset() statements when they are done with them.
+    class StatementCache {
+    public:
+        StatementCache();
+        ~StatementCache();
+
+        // Set the connection, discarding any statements for the old one.
+        void reset(SQLiteDBPtr db);
+
+        SQLiteDBPtr db() const { return mDB; }
+
+        // Get the statement, preparing it if necessary. Returns NULL if it
+        // can't be prepared.
+        sqlite3_stmt* get(StatementType type);
+    private:
+        SQLiteDBPtr mDB;
+        sqlite3_stmt* mStatements[NumStatements];
+    };
+
     // StorageActions are individual actions to take, i.e. read, write,
     // erase. We queue them up in a list and eventually fire them off in a
     // transaction.
@@ -87,12 +139,12 @@ private:
         StorageAction& operator=(const StorageAction& rhs);
 
         // Executes this action. Assumes the owning SQLiteStorage has setup the transaction.
-        Result execute(SQLiteDBPtr db, const Bucket& bucket, ReadSet* rs);
+        Result execute(StatementCache& stmts, const Bucket& bucket, ReadSet* rs);
 
         // Executes this action, retrying the given number of times if there's a
         // temporary failure to lock the database. Assumes the owning
         // SQLiteStorage has setup the transaction.
-        Result executeWithRetry(SQLiteDBPtr db, const Bucket& bucket, ReadSet* rs, int32 retries, const Duration& retry_wait);
+        Result executeWithRetry(StatementCache& stmts, const Bucket& bucket, ReadSet* rs, int32 retries, const Duration& retry_wait);
 
         // Bucket is implicit, passed into execute
         Type type;
@@ -145,9 +197,12 @@ private:
     // rollback/retrying.
     Result executeCommit(const Bucket& bucket, Transaction* trans, CommitCallback cb, ReadSet** read_set_out);
 
-    void executeCount(const String value_count, const Key& start, const Key& finish, CountCallback cb);
+    void executeCount(const Bucket& bucket, const Key& start, const Key& finish, CountCallback cb);
 
     // A few helper methods that wrap sql operations.
+    // Run a statement that doesn't need to be cached, e.g. setup or pragmas.
+    bool sqlExecute(const String& sql, const String& desc);
+    bool sqlExecuteCached(StatementType type, const String& desc);
     bool sqlBeginTransaction();
     bool sqlCommit();
     bool sqlRollback();
@@ -178,6 +233,9 @@ private:
     BucketTransactions mTransactions;
     String mDBFilename;
     SQLiteDBPtr mDB;
+    StatementCache mStatements;
+    const bool mWAL;
+    const uint64 mMMapSize;
 
     // FIXME because we don't have proper multithreaded support in cppoh, we
     // need to allocate our own thread dedicated to IO
@@ -194,8 +252,11 @@ private:
     // Maximum transactions to combine into a single transaction in the
     // underlying database. TODO(ewencp) this should probably be dynamic, should
     // increase/decrease based on success/failure and avoid latency getting too
-    // hight. Right now we just have a reasonable, but small, number.
+    // hight.
     uint32 mMaxCoalescedTransactions;
+    // When the queue goes from empty to non-empty, we wait this long before
+    // processing it so more transactions can be grouped into one commit.
+    const Duration mGroupCommitWindow;
 
     // Amount of time to sleep between retries. Shouldn't be too big or you can
     // back up all storage, but should be long enough that transient errors such
@@ -821,6 +821,12 @@ void HostedObject::handleProximityUpdate(const SpaceObjectReference& spaceobj, c
         return;
     }
 
+    // The script gets the whole update at once, so collect the objects that
+    // entered and left the result set as we go.
+    std::vector<ProxyObjectPtr> added_objs, removed_objs;
+    std::vector<bool> removed_permanent;
+    added_objs.reserve(update.addition_size());
+
     for(int32 aidx = 0; aidx < update.addition_size(); aidx++) {
         Sirikata::Protocol::Prox::ObjectAddition addition = update.addition(aidx);
         ProxProtocolLocUpdate add(addition);
@@ -882,7 +888,7 @@ void HostedObject::handleProximityUpdate(const SpaceObjectReference& spaceobj, c
         //tells the object script that something that was close has come
         //into view
         if(self->mObjectScript)
-            self->mObjectScript->notifyProximate(proxy_obj,spaceobj);
+            added_objs.push_back(proxy_obj);
     }
 
     for(int32 ridx = 0; ridx < update.removal_size(); ridx++) {
@@ -913,10 +919,10 @@ void HostedObject::handleProximityUpdate(const SpaceObjectReference& spaceobj, c
                 // across space servers (see handleMigrated).
                 proxy_manager->destroyObject(proxy_obj);
 
-                if (self->mObjectScript)
-                    self->mObjectScript->notifyProximateGone(proxy_obj,spaceobj);
-
-                proxy_obj->invalidate(permanent);
+                // Invalidation waits until the script has been notified
+                // below.
+                removed_objs.push_back(proxy_obj);
+                removed_permanent.push_back(permanent);
             }
         }
 
@@ -929,6 +935,11 @@ void HostedObject::handleProximityUpdate(const SpaceObjectReference& spaceobj, c
         );
     }
 
+    if (self->mObjectScript && (!added_objs.empty() || !removed_objs.empty()))
+        self->mObjectScript->notifyProximateBatch(added_objs, removed_objs, spaceobj);
+
+    for(uint32 i = 0; i < removed_objs.size(); i++)
+        removed_objs[i]->invalidate(removed_permanent[i]);
 }
 
 ProxyObjectPtr HostedObject::createProxy(const SpaceObjectReference& objref, const SpaceObjectReference& owner_objref, const Transfer::URI& meshuri, TimedMotionVector3f& tmv, TimedMotionQuaternion& tmq, const BoundingSphere3f& bs, const String& phy, const String& query, bool isAggregate, uint64 seqNo)
@@ -50,16 +50,26 @@
 #include <sirikata/mesh/Filter.hpp>
 
 #include <sirikata/core/transfer/HttpManager.hpp>
+#include <sirikata/core/command/Command.hpp>
 
 namespace Sirikata {
 
 class SIRIKATA_SPACE_EXPORT AggregateManager : public LocationServiceListener {
 private:
 
+  // Bookkeeping for aggregate generation (the dirty set, the generation DAG
+  // and the ready queue) happens on mAggregationStrand.
   Thread* mAggregationThread;
   Network::IOService* mAggregationService;
   Network::IOStrand* mAggregationStrand;
   Network::IOWork* mIOWork;  
+
+  // The mesh work for each aggregate is posted to a pool of worker threads
+  // so independent aggregates, e.g. siblings, are generated in parallel.
+  Network::IOService* mWorkerService;
+  Network::IOWork* mWorkerWork;
+  std::vector<Thread*> mWorkerThreads;
+  void workerThreadMain();
   
   typedef struct LocationInfo {
     Vector3f currentPosition;
@@ -122,6 +132,25 @@ private:
   Sirikata::Mesh::MeshSimplifier mMeshSimplifier;
   Sirikata::Mesh::Filter* mCenteringFilter;
 
+  // Timing for generating a single aggregate, reported through the commander.
+  struct GenerationStats {
+    GenerationStats()
+     : generated(0), failed(0),
+       total(Duration::zero()), last(Duration::zero()), max(Duration::zero()),
+       lastChildren(0), lastReusedChildren(0)
+    {}
+
+    uint32 generated;
+    uint32 failed;
+    Duration total;
+    Duration last;
+    Duration max;
+    // Number of children merged in the last generation, and how many of them
+    // could reuse their centered mesh from an earlier generation.
+    uint32 lastChildren;
+    uint32 lastReusedChildren;
+  };
+
   typedef struct AggregateObject{
     UUID mUUID;
     std::set<UUID> mParentUUIDs;
@@ -140,7 +169,12 @@ private:
       mTreeLevel(0),  mNumObservers(0),
       mNumFailedGenerationAttempts(0),
       cdnBaseName(),
-      refreshTTL(Time::null())
+      refreshTTL(Time::null()),
+      mPending(false),
+      mInFlight(false),
+      mDirtyWhileGenerating(false),
+      mQueued(false),
+      mCenteredRadius(0)
     {
       mParentUUIDs.insert(parentUUID);
       mMeshdata = Mesh::MeshdataPtr();
@@ -162,6 +196,27 @@ private:
     // a bit less than the actual timeout.
     Time refreshTTL;
 
+    // Generation DAG state, only used on the aggregation strand. An aggregate
+    // is pending from the time it's dirtied until it has been generated, and
+    // is queued for a worker once none of its children are pending.
+    bool mPending;
+    bool mInFlight;
+    bool mDirtyWhileGenerating;
+    bool mQueued;
+
+    // The result of the last generation. Parents use this directly instead
+    // of waiting for it to be uploaded and downloading it again.
+    Mesh::MeshdataPtr mGeneratedMesh;
+    std::tr1::unordered_map<String, String> mGeneratedTextures;
+
+    // Centered copy of this object's mesh, its radius, and the mesh it was
+    // made from. Parents reuse it until the source mesh changes, so
+    // regenerating an aggregate only reprocesses the children that changed.
+    Mesh::MeshdataPtr mCenteredSource;
+    Mesh::MeshdataPtr mCenteredMesh;
+    double mCenteredRadius;
+
+    GenerationStats mStats;
   } AggregateObject;
   typedef std::tr1::shared_ptr<AggregateObject> AggregateObjectPtr;
 
@@ -172,7 +227,12 @@ private:
   AggregateObjectsMap mAggregateObjects;
   Time mAggregateGenerationStartTime;    
   std::tr1::unordered_map<UUID, AggregateObjectPtr, UUID::Hasher> mDirtyAggregateObjects;
+  // Aggregates whose children are all generated, by priority. Only used on
+  // the aggregation strand.
   std::map<float, std::deque<AggregateObjectPtr > > mObjectsByPriority;
+  // Number of aggregates currently being generated by workers.
+  uint32 mNumInFlight;
+  GenerationStats mTotalStats;
 
   //Variables related to downloading and in-memory caching meshes
   boost::mutex mMeshStoreMutex;
@@ -187,13 +247,13 @@ private:
   Duration mModelTTL;
   Poller* mCDNKeepAlivePoller;
 
-  //CDN upload threads' variables
+  //CDN upload threads' variables. Uploads block while converting and saving
+  //meshes, so they get their own pool and any idle thread takes the next one.
   enum{NUM_UPLOAD_THREADS = 8};
-  Thread* mUploadThreads[NUM_UPLOAD_THREADS];
-  Network::IOService* mUploadServices[NUM_UPLOAD_THREADS];
-  Network::IOStrand* mUploadStrands[NUM_UPLOAD_THREADS];
-  Network::IOWork* mUploadWorks[NUM_UPLOAD_THREADS];
-  void uploadThreadMain(uint8 i);
+  Network::IOService* mUploadService;
+  Network::IOWork* mUploadWork;
+  std::vector<Thread*> mUploadThreads;
+  void uploadThreadMain();
   
 
   //Various utility functions 
@@ -211,7 +271,17 @@ private:
   void updateChildrenTreeLevel(const UUID& uuid, uint16 treeLevel);
   void addDirtyAggregates(UUID uuid);
   void generateMeshesFromQueue(Time postTime);
-  void generateAggregateMeshAsyncIgnoreErrors(const UUID uuid, Time postTime, bool generateSiblings = true);
+  // Generation DAG helpers, all run on the aggregation strand.
+  void enqueueReadyAggregate(AggregateObjectPtr aggObject);
+  void dispatchReadyAggregates();
+  void generateAggregateMeshTask(AggregateObjectPtr aggObject);
+  void handleAggregateGenerated(AggregateObjectPtr aggObject, uint32 retval, Duration genTime);
+  void retryAggregate(AggregateObjectPtr aggObject);
+  // Get a centered copy of the child's mesh, reusing the cached one if the
+  // child's mesh hasn't changed. Returns true if the cached copy was used.
+  bool getCenteredMesh(AggregateObjectPtr child, Mesh::MeshdataPtr source,
+                       Mesh::MeshdataPtr* centered_out, double* radius_out);
+  void scheduleAggregate(AggregateObjectPtr aggObject);
   enum{GEN_SUCCESS=1, CHILDREN_NOT_YET_GEN=2, OTHER_GEN_FAILURE=3}; 
   uint32 generateAggregateMeshAsync(const UUID uuid, Time postTime, bool generateSiblings = true);
   void aggregationThreadMain();
@@ -240,6 +310,8 @@ private:
   // removed.
   bool cleanUpChild(const UUID& parent_uuid, const UUID& child_id);
   void removeStaleLeaves();
+
+  void commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
   
 
 public:
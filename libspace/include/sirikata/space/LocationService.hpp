@@ -45,6 +45,7 @@
 
 #include <sirikata/core/util/Factory.hpp>
 #include <sirikata/space/ObjectSessionManager.hpp>
+#include <sirikata/space/LocationUpdateBatch.hpp>
 
 namespace Sirikata {
 
@@ -59,6 +60,19 @@ class SIRIKATA_SPACE_EXPORT LocationServiceListener {
 public:
     virtual ~LocationServiceListener();
 
+    /** Listeners which return true don't get the individual *Updated
+     *  callbacks. Instead, once per LocationService tick, they get a single
+     *  locationUpdateBatch() call covering every object which changed, with
+     *  multiple updates to the same object collapsed into one entry. Only
+     *  which properties changed is included; the current values should be
+     *  looked up in the LocationService. Additions and removals are still
+     *  delivered immediately, and an object removed before the end of the
+     *  tick won't appear in the batch. This is checked once, when the
+     *  listener is added.
+     */
+    virtual bool batchedUpdates() const { return false; }
+    virtual void locationUpdateBatch(const LocationUpdateBatchEntry* begin, const LocationUpdateBatchEntry* end) {}
+
     virtual void localObjectAdded(const UUID& uuid, bool agg, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics, const String& zernike) {}
     virtual void localObjectRemoved(const UUID& uuid, bool agg) {}
     virtual void localLocationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval) {}
@@ -232,6 +246,12 @@ protected:
     void notifyReplicaMeshUpdated(const UUID& uuid, const String& newval) const;
     void notifyReplicaPhysicsUpdated(const UUID& uuid, const String& newval) const;
 
+    // Batched updates. Changes are collected as they are notified and handed
+    // to batching listeners after each call to service().
+    void queueBatchedUpdate(const UUID& uuid, bool local, bool agg, uint8 field) const;
+    void dropBatchedUpdate(const UUID& uuid) const;
+    void deliverBatchedUpdates();
+
     // Helpers for listening to streams
     typedef SST::Stream<SpaceObjectReference> SSTStream;
     typedef SSTStream::Ptr SSTStreamPtr;
@@ -246,11 +266,15 @@ protected:
     struct ListenerInfo {
         LocationServiceListener* listener;
         bool wantAggregates;
+        bool batched;
 
         bool operator<(const ListenerInfo& rhs) const { return listener < rhs.listener; }
     };
     typedef std::set<ListenerInfo> ListenerList;
     ListenerList mListeners;
+    uint32 mBatchedListeners;
+    mutable LocationUpdateBatcher mPendingUpdates;
+    LocationUpdateBatcher::Batch mDeliveringUpdates;
 
     LocationUpdatePolicy* mUpdatePolicy;
 }; // class LocationService
@@ -0,0 +1,61 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SPACE_LOCATION_UPDATE_BATCH_HPP_
+#define _SIRIKATA_SPACE_LOCATION_UPDATE_BATCH_HPP_
+
+#include <sirikata/space/Platform.hpp>
+#include <sirikata/core/util/UUID.hpp>
+
+namespace Sirikata {
+
+/** A record of which properties of an object changed since the last batch of
+ *  updates was delivered. See LocationServiceListener::batchedUpdates().
+ */
+struct LocationUpdateBatchEntry {
+    enum Fields {
+        LOCATION = 0x01,
+        ORIENTATION = 0x02,
+        BOUNDS = 0x04,
+        MESH = 0x08,
+        PHYSICS = 0x10
+    };
+
+    UUID uuid;
+    bool local; // False for replicas
+    bool aggregate;
+    uint8 fields; // Bitwise or of Fields
+};
+
+/** Collects location updates into batches, merging all the updates to an
+ *  object into one entry.
+ */
+class SIRIKATA_SPACE_EXPORT LocationUpdateBatcher {
+public:
+    typedef std::vector<LocationUpdateBatchEntry> Batch;
+
+    void add(const UUID& uuid, bool local, bool agg, uint8 field);
+    /** Drop any pending updates for uuid, e.g. because it was removed. */
+    void remove(const UUID& uuid);
+
+    bool empty() const { return mEntries.empty(); }
+
+    /** Move the current batch into batch_out, leaving this empty. Entries for
+     *  non-aggregates come first.
+     *  \param batch_out the batch, whose storage is kept and reused for the
+     *         next batch
+     *  \returns the number of non-aggregate entries in the batch
+     */
+    size_t take(Batch* batch_out);
+
+private:
+    Batch mEntries;
+    // Index of each object's entry in mEntries
+    typedef std::tr1::unordered_map<UUID, uint32, UUID::Hasher> EntryIndex;
+    EntryIndex mIndex;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SPACE_LOCATION_UPDATE_BATCH_HPP_
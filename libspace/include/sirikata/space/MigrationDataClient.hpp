@@ -35,12 +35,59 @@
 
 #include <sirikata/core/util/Platform.hpp>
 #include <sirikata/core/util/UUID.hpp>
+#include "Protocol_Migration.pbj.hpp"
 
 namespace Sirikata {
 
+/** MigrationDataWriter hands a MigrationDataClient the entry for its data in
+ *  the outgoing migration message, so the data is written straight into the
+ *  message rather than being passed back through the registry. The entry is
+ *  only added when the client writes something, so clients with nothing to
+ *  say about an object don't add anything to the message.
+ */
+class MigrationDataWriter {
+public:
+    MigrationDataWriter(Sirikata::Protocol::Migration::IMigrationMessage& migrate_msg, const String& tag)
+     : mMigrateMsg(migrate_msg),
+       mTag(tag),
+       mWritten(false),
+       mSize(0)
+    {}
+
+    /** Set this client's data. A client may write at most once per object. */
+    void write(const std::string& data) {
+        assert(!mWritten);
+        Sirikata::Protocol::Migration::IMigrationClientData client_data = mMigrateMsg.add_client_data();
+        client_data.set_key(mTag);
+        client_data.set_data(data);
+        mWritten = true;
+        mSize = data.size();
+    }
+
+    /** Serialize a PBJ message as this client's data. */
+    template<typename PBJMessageType>
+    void writeMessage(const PBJMessageType& contents) {
+        std::string data;
+        bool serialized_success = contents.SerializeToString(&data);
+        assert(serialized_success);
+        write(data);
+    }
+
+    bool written() const { return mWritten; }
+    /** Size in bytes of the data written. */
+    uint32 size() const { return mSize; }
+
+private:
+    Sirikata::Protocol::Migration::IMigrationMessage& mMigrateMsg;
+    const String& mTag;
+    bool mWritten;
+    uint32 mSize;
+};
+
 /** MigrationDataClients produce and accept chunks of data during migration.
  *  MigrationDataClient is a generic interface to allow any component of the
- *  space to participate in the migration process.
+ *  space to participate in the migration process. Clients participate by
+ *  adding themselves to the SpaceContext's MigrationDataClientRegistry.
  */
 class MigrationDataClient {
 public:
@@ -50,9 +97,10 @@ public:
     virtual std::string migrationClientTag() = 0;
 
     /** Produce data for the migration of obj from source_server to
-     *  dest_server.
+     *  dest_server, writing it to out. Clients with no state for obj should
+     *  leave out untouched.
      */
-    virtual std::string generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server) = 0;
+    virtual void generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, MigrationDataWriter& out) = 0;
 
     /** Receive data for the migration of obj from source_server to
      *  dest_server.
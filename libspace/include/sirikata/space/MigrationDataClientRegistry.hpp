@@ -0,0 +1,90 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SPACE_MIGRATION_DATA_CLIENT_REGISTRY_HPP_
+#define _SIRIKATA_SPACE_MIGRATION_DATA_CLIENT_REGISTRY_HPP_
+
+#include <sirikata/space/Platform.hpp>
+#include <sirikata/space/MigrationDataClient.hpp>
+#include <sirikata/space/SpaceContext.hpp>
+#include <sirikata/core/command/Command.hpp>
+#include "Protocol_Migration.pbj.hpp"
+
+namespace Sirikata {
+
+/** MigrationDataClientRegistry tracks the space components which package up
+ *  per-object state when an object migrates. Components add themselves when
+ *  they are created and the Server asks the registry to gather and dispatch
+ *  their data, so the Server doesn't need to know about any of them.
+ *
+ *  Clients write their data directly into the outgoing migration message, in
+ *  the order they were added, and is handed back to the matching clients on the
+ *  destination in that same order, so a client may rely on clients added
+ *  before it having already received their data.
+ *
+ *  The registry must only be used from the main strand.
+ */
+class SIRIKATA_SPACE_EXPORT MigrationDataClientRegistry {
+public:
+    MigrationDataClientRegistry(SpaceContext* ctx);
+    ~MigrationDataClientRegistry();
+
+    /** Add a client. Its migrationClientTag() must be unique. */
+    void addClient(MigrationDataClient* client);
+    void removeClient(MigrationDataClient* client);
+
+    /** Collect data from all clients for the migration of obj from
+     *  source_server to dest_server, adding an entry to migrate_msg's
+     *  client_data for each client that writes any.
+     */
+    void generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, Sirikata::Protocol::Migration::IMigrationMessage& migrate_msg);
+
+    /** Hand each entry of migrate_msg's client_data to the client it came
+     *  from.
+     */
+    void receiveMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, const Sirikata::Protocol::Migration::MigrationMessage& migrate_msg);
+
+private:
+    struct Stats {
+        Stats()
+         : generated(0),
+           generatedBytes(0),
+           generateTime(Duration::zero()),
+           received(0),
+           receivedBytes(0),
+           receiveTime(Duration::zero())
+        {}
+
+        uint64 generated;
+        uint64 generatedBytes;
+        Duration generateTime;
+        uint64 received;
+        uint64 receivedBytes;
+        Duration receiveTime;
+    };
+
+    struct ClientInfo {
+        ClientInfo(MigrationDataClient* c, const String& t)
+         : client(c), tag(t)
+        {}
+
+        MigrationDataClient* client;
+        String tag;
+        Stats stats;
+    };
+    typedef std::vector<ClientInfo> ClientList;
+
+    ClientList::iterator findClient(const String& tag);
+
+    void commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
+
+    SpaceContext* mContext;
+    ClientList mClients;
+    // Data for tags without a client
+    uint64 mUnknownReceived;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SPACE_MIGRATION_DATA_CLIENT_REGISTRY_HPP_
@@ -77,7 +77,9 @@ public:
         // other two, and the connected/disconnected callbacks should be treated
         // simply as a sort of session manaagement.
 
-        virtual bool onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id, const ShortObjectHostConnectionID short_conn_id, Sirikata::Protocol::Object::ObjectMessage*) = 0;
+        // The message comes with the bytes it was parsed from so that it can
+        // be forwarded without being serialized again.
+        virtual bool onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id, const ShortObjectHostConnectionID short_conn_id, Sirikata::Protocol::Object::ObjectMessage*, const ObjectMessageBytesPtr&) = 0;
 
         virtual void onObjectHostConnected(const ObjectHostConnectionID& conn_id, const ShortObjectHostConnectionID short_conn_id, OHDPSST::Stream::Ptr stream) = 0;
         virtual void onObjectHostDisconnected(const ObjectHostConnectionID& conn_id, const ShortObjectHostConnectionID short_conn_id) = 0;
@@ -92,12 +94,15 @@ public:
     bool validConnection(const ObjectHostConnectionID& conn_id) const;
     bool validConnection(const ShortObjectHostConnectionID& short_conn_id) const;
 
-    /** NOTE: Must be used from within the main strand.  Currently this is required since we have the return value... */
+    /** NOTE: Must be used from within the main strand.  Currently this is required since we have the return value...
+     *  If msg_bytes is set it must be the serialized form of msg and is sent
+     *  as is, e.g. when passing along a message we received.
+     */
     WARN_UNUSED
-    bool send(const ObjectHostConnectionID& conn_id, Sirikata::Protocol::Object::ObjectMessage* msg);
+    bool send(const ObjectHostConnectionID& conn_id, Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes = ObjectMessageBytesPtr());
 
     WARN_UNUSED
-    bool send(const ShortObjectHostConnectionID short_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg);
+    bool send(const ShortObjectHostConnectionID short_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes = ObjectMessageBytesPtr());
 
     void shutdown();
 
@@ -136,7 +141,7 @@ private:
     // Handle async reading callbacks for this connection
     void handleConnectionRead(ObjectHostConnection* conn, Sirikata::Network::Chunk& chunk, const Sirikata::Network::Stream::PauseReceiveCallback& pause);
 
-    bool sendHelper(ObjectHostConnection* conn, Sirikata::Protocol::Object::ObjectMessage* msg);
+    bool sendHelper(ObjectHostConnection* conn, Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes);
 
     // Utility methods which we can post to the main strand to ensure they operate safely.
     void insertConnection(ObjectHostConnection* conn);
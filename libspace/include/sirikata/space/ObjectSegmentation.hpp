@@ -173,6 +173,24 @@ public:
     virtual void removeObject(const UUID& obj_id) = 0;
     virtual bool clearToMigrate(const UUID& obj_id) = 0;
 
+    typedef std::vector< std::pair<UUID, OSegEntry> > OSegEntryList;
+    /** Migrate a group of objects, e.g. all the objects leaving for one server
+     *  at the same time. Implementations which can commit several updates at
+     *  once should override this; by default it calls migrateObject for each.
+     */
+    virtual void migrateObjects(const OSegEntryList& objects) {
+        for(OSegEntryList::const_iterator it = objects.begin(); it != objects.end(); it++)
+            migrateObject(it->first, it->second);
+    }
+    /** Add a group of objects which migrated to this server, all from
+     *  idServerAckTo. Only the radius of each entry is used. By default this
+     *  calls addMigratedObject for each.
+     */
+    virtual void addMigratedObjects(const OSegEntryList& objects, ServerID idServerAckTo, bool generateAck) {
+        for(OSegEntryList::const_iterator it = objects.begin(); it != objects.end(); it++)
+            addMigratedObject(it->first, it->second.radius(), idServerAckTo, generateAck);
+    }
+
     virtual int getPushback()
     {
         return 0;
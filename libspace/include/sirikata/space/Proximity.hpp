@@ -83,7 +83,7 @@ class SIRIKATA_SPACE_EXPORT Proximity :
 
     // MigrationDataClient Interface
     virtual std::string migrationClientTag() = 0;
-    virtual std::string generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server) = 0;
+    virtual void generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, MigrationDataWriter& out) = 0;
     virtual void receiveMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, const std::string& data) = 0;
 
     // ** These interfaces are stubbed out because you don't necessarily need to
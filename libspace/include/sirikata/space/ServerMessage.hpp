@@ -59,6 +59,7 @@ typedef uint16 ServerMessagePort;
 #define SERVER_PORT_OSEG_MIGRATE_ACKNOWLEDGE   9
 #define SERVER_PORT_OSEG_UPDATE                15
 #define SERVER_PORT_FORWARDER_WEIGHT_UPDATE    16
+#define SERVER_PORT_BULK_MIGRATION             17
 #define SERVER_PORT_UNPROCESSED_PACKET         0xFFFF
 
 /** Base class for messages that go over the network.  Must provide
@@ -70,6 +71,11 @@ public:
     Message(ServerID src, uint16 src_port, ServerID dest, ServerID dest_port);
     Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const std::string& pl);
     Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const Sirikata::Protocol::Object::ObjectMessage* pl);
+    /** Wrap an ObjectMessage which is already serialized, e.g. one being
+     *  forwarded. pl_bytes must be the serialized form of pl; it is used as the
+     *  payload as is and pl only supplies the payload ID.
+     */
+    Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const Sirikata::Protocol::Object::ObjectMessage* pl, const std::string& pl_bytes);
 
     ServerID source_server() const { return mImpl.source_server(); }
     void set_source_server(const ServerID sid);
@@ -90,19 +96,22 @@ public:
     // NOTE: We don't expose set_id() so we guarantee it gets created properly.
     // Use the constructor taking an ObjectMessage to ensure this works properly.
 
-    std::string payload() const { return mImpl.payload(); }
-    void set_payload(const std::string& pl) { mImpl.set_payload(pl); }
+    const std::string& payload() const { return mPayload; }
+    void set_payload(const std::string& pl) { mPayload = pl; mCachedSize = 0; }
 
 
     bool ParseFromString(const std::string& data) {
-        return mImpl.ParseFromString(data);
-    }
-    bool ParseFromArray(const void* data, int size) {
-        return mImpl.ParseFromArray(data, size);
+        return ParseFromArray(data.data(), (int)data.size());
     }
+    bool ParseFromArray(const void* data, int size);
 
     // Deprecated. Remains for backwards compatibility.
     bool serialize(Network::Chunk* result) const;
+    /** Serialize everything except the payload bytes themselves. Sending the
+     *  result followed by payload() gives the same bytes as serialize(), but
+     *  lets the payload go straight from this message to the network.
+     */
+    bool serializeHeader(std::string* header_out) const;
     static Message* deserialize(const Network::Chunk& wire);
 
     // Deprecated. Remains for backwards compatibility.
@@ -120,7 +129,11 @@ private:
     void fillMessage(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port);
     void fillMessage(ServerID src, uint16 src_port, ServerID dest, ServerID dest_port, const std::string& pl);
 
+    // The payload is kept out of mImpl, which only ever holds the routing
+    // header, so it is copied once when a message is received and not at all
+    // when it is sent.
     Sirikata::Protocol::Server::ServerMessage mImpl;
+    std::string mPayload;
     mutable uint32 mCachedSize;
 }; // class Message
 
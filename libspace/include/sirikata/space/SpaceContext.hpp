@@ -52,6 +52,7 @@ class CoordinateSegmentation;
 
 class ObjectHostSessionManager;
 class ObjectSessionManager;
+class MigrationDataClientRegistry;
 
 
 /** SpaceContext holds a number of useful items that are effectively global
@@ -90,6 +91,10 @@ public:
         return mObjectHostSessionManager;
     }
 
+    MigrationDataClientRegistry* migrationDataClients() const {
+        return mMigrationDataClients;
+    }
+
     ODPSST::ConnectionManager* sstConnectionManager() const {
         return mSSTConnMgr;
     }
@@ -107,6 +112,7 @@ private:
     friend class ObjectSessionManager;
     friend class ObjectHostSessionManager;
     friend class CoordinateSegmentation;
+    friend class MigrationDataClientRegistry;
 
     const String mName;
 
@@ -120,6 +126,8 @@ private:
     Sirikata::AtomicValue<ObjectHostSessionManager*> mObjectHostSessionManager;
     Sirikata::AtomicValue<ObjectSessionManager*> mObjectSessionManager;
 
+    Sirikata::AtomicValue<MigrationDataClientRegistry*> mMigrationDataClients;
+
     Sirikata::AtomicValue<ODPSST::ConnectionManager*> mSSTConnMgr;
 
     Sirikata::AtomicValue<OHDPSST::ConnectionManager*> mOHSSTConnMgr;
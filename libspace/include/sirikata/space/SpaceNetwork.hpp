@@ -66,6 +66,9 @@ public:
 
         virtual ServerID id() const = 0;
         virtual bool send(const Chunk&) = 0;
+        // Sends first and second as a single message, without joining them
+        // into one buffer first.
+        virtual bool send(MemoryReference first, MemoryReference second) = 0;
     };
 
     /** The Network::SendListener interface should be implemented by the object
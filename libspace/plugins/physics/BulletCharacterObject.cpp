@@ -17,7 +17,9 @@ BulletCharacterObject::BulletCharacterObject(BulletPhysicsService* parent, const
    mBBox(bb),
    mGhostObject(NULL),
    mCharacter(NULL),
-   mCollisionShape(NULL)
+   mCollisionShape(NULL),
+   mVelocity(0, 0, 0),
+   mStopReported(false)
 {
     if (mBBox != BULLET_OBJECT_BOUNDS_SPHERE &&
         mBBox != BULLET_OBJECT_BOUNDS_ENTIRE_OBJECT)
@@ -46,11 +48,13 @@ float32 BulletCharacterObject::mass() {
     return 0.f;
 }
 
-void BulletCharacterObject::load(Mesh::MeshdataPtr mesh) {
-    LocationInfo& locinfo = mParent->info(mID);
+void BulletCharacterObject::load(Mesh::MeshdataPtr mesh, const PresenceProperties& props) {
+    Time t = mParent->context()->simTime();
+    mVelocity = props.location().velocity();
+    mOrientation = props.orientation();
 
-    Vector3f objPosition = mParent->currentPosition(mID);
-    Quaternion objOrient = mParent->currentOrientation(mID);
+    Vector3f objPosition = props.location().position(t);
+    Quaternion objOrient = mOrientation.position(t);
     btTransform startTransform = btTransform(
         btQuaternion(objOrient.x,objOrient.y,objOrient.z,objOrient.w),
         btVector3(objPosition.x,objPosition.y,objPosition.z)
@@ -62,7 +66,7 @@ void BulletCharacterObject::load(Mesh::MeshdataPtr mesh) {
 
     // Currently only support spheres, TODO(ewencp) we might want to support
     // capsules instead.
-    mCollisionShape = computeCollisionShape(mID, mBBox, BULLET_OBJECT_TREATMENT_CHARACTER, Mesh::MeshdataPtr());
+    mCollisionShape = computeCollisionShape(mID, mBBox, BULLET_OBJECT_TREATMENT_CHARACTER, Mesh::MeshdataPtr(), props.bounds());
     mGhostObject->setCollisionShape(mCollisionShape);
     mGhostObject->setCollisionFlags(btCollisionObject::CF_CHARACTER_OBJECT);
 
@@ -80,14 +84,14 @@ void BulletCharacterObject::load(Mesh::MeshdataPtr mesh) {
     mParent->dynamicsWorld()->addCollisionObject(mGhostObject, (short)mygroup, (short)collide_with);
     mParent->dynamicsWorld()->addAction(mCharacter);
 
-    mParent->addTickObject(mID);
-    mParent->addDeactivateableObject(mID);
+    mParent->addTickObject(this);
+    mParent->addDeactivateableObject(this);
 }
 
 void BulletCharacterObject::unload() {
     if (mCharacter) {
-        mParent->removeTickObject(mID);
-        mParent->removeDeactivateableObject(mID);
+        mParent->removeTickObject(this);
+        mParent->removeDeactivateableObject(this);
 
         mParent->dynamicsWorld()->removeAction(mCharacter);
         mParent->dynamicsWorld()->removeCollisionObject(mGhostObject);
@@ -104,9 +108,7 @@ void BulletCharacterObject::unload() {
 }
 
 void BulletCharacterObject::preTick(const Time& t) {
-    LocationInfo& locinfo = mParent->info(mID);
-    Vector3f char_vel = locinfo.props.location().velocity();
-    btVector3 bt_char_vel(char_vel.x, char_vel.y, char_vel.z);
+    btVector3 bt_char_vel(mVelocity.x, mVelocity.y, mVelocity.z);
     mCharacter->setWalkDirection(bt_char_vel);
     // Character controller doesn't have any rotation support. Instead, we set
     // the rotation on the ghost object directly based on the requested
@@ -114,7 +116,7 @@ void BulletCharacterObject::preTick(const Time& t) {
     // walking direction where we know to stop the rotation at some point.
     btTransform xform = mGhostObject->getWorldTransform();
     btVector3 objPosition = xform.getOrigin();
-    Quaternion objOrient = mParent->currentOrientation(mID);
+    Quaternion objOrient = mOrientation.position(t);
     mGhostObject->setWorldTransform(
         btTransform(
             btQuaternion(objOrient.x, objOrient.y, objOrient.z, objOrient.w),
@@ -124,44 +126,43 @@ void BulletCharacterObject::preTick(const Time& t) {
 }
 
 void BulletCharacterObject::postTick(const Time& t) {
-    LocationInfo& locinfo = mParent->info(mID);
-
     btTransform worldTrans = mGhostObject->getWorldTransform();
     btVector3 pos = worldTrans.getOrigin();
-    TimedMotionVector3f newLocation(t, MotionVector3f(Vector3f(pos.x(), pos.y(), pos.z()), locinfo.props.location().velocity()));
+    TimedMotionVector3f newLocation(t, MotionVector3f(Vector3f(pos.x(), pos.y(), pos.z()), mVelocity));
 
     btQuaternion rot = worldTrans.getRotation();
     TimedMotionQuaternion newOrientation(
         t,
         MotionQuaternion(
             Quaternion(rot.x(), rot.y(), rot.z(), rot.w()),
-            locinfo.props.orientation().velocity()
+            mOrientation.velocity()
         )
     );
 
-    // Only update and report a change if it's big enough. This allows us to
-    // stop sending updates if the object ends up essentially still.
-    float32 pos_diff = (mParent->location(mID).position(t)-newLocation.position(t)).lengthSquared();
-    // This test is easy, but also conservative...
-    float32 angle1, angle2;
-    Vector3f axis1, axis2;
-    mParent->orientation(mID).position(t).toAngleAxis(angle1, axis1);
-    newOrientation.position(t).toAngleAxis(angle2, axis2);
-    // FIXME what should this really be? This approach doesn't seem to really
-    // work because we sometimes get 0 vectors and the constants seem odd...
-    bool orient_changed =
-        (axis1.dot(axis2) < 0.9) || (fabs(angle1-angle2) > 3.14159/180);
-
-    if (pos_diff > 0.001 || orient_changed) {
-        mParent->setLocation(mID, newLocation);
-        mParent->setOrientation(mID, newOrientation);
-        mParent->addUpdate(mID);
-    }
+    // Only changes that are big enough get reported, so updates stop if the
+    // object ends up essentially still.
+    mParent->addUpdate(mID, newLocation, newOrientation);
 }
 
 void BulletCharacterObject::deactivationTick(const Time& t) {
-    if (mGhostObject != NULL && !mGhostObject->isActive())
-        mParent->updateObjectFromDeactivation(mID);
+    if (mGhostObject == NULL)
+        return;
+    if (mGhostObject->isActive()) {
+        mStopReported = false;
+        return;
+    }
+    if (mStopReported)
+        return;
+
+    const btTransform& worldTrans = mGhostObject->getWorldTransform();
+    btVector3 pos = worldTrans.getOrigin();
+    btQuaternion rot = worldTrans.getRotation();
+    mParent->updateObjectFromDeactivation(
+        mID,
+        Vector3f(pos.x(), pos.y(), pos.z()),
+        Quaternion(rot.x(), rot.y(), rot.z(), rot.w())
+    );
+    mStopReported = true;
 }
 
 bool BulletCharacterObject::applyRequestedLocation(const TimedMotionVector3f& loc, uint64 epoch) {
@@ -178,19 +179,46 @@ void BulletCharacterObject::applyForcedLocation(const TimedMotionVector3f& loc,
     // Update recorded info. Note that this still follows epoch ordering! It
     // will be ignored if it is out of date, even though this is "forced".
     LocationInfo& locinfo = mParent->info(mID);
-    locinfo.props.setLocation(loc, epoch);
+    if (!locinfo.props.setLocation(loc, epoch))
+        return;
+    // Whatever we last simulated is out of date now
+    locinfo.simulated = false;
+
+    mParent->physicsStrand()->post(
+        std::tr1::bind(&BulletCharacterObject::setCharacterLocation, this, loc),
+        "BulletCharacterObject::setCharacterLocation"
+    );
+}
 
+void BulletCharacterObject::applyForcedOrientation(const TimedMotionQuaternion& orient, uint64 epoch) {
+    // Update recorded info. Note that this still follows epoch ordering! It
+    // will be ignored if it is out of date, even though this is "forced".
+    LocationInfo& locinfo = mParent->info(mID);
+    if (!locinfo.props.setOrientation(orient, epoch))
+        return;
+    // Whatever we last simulated is out of date now
+    locinfo.simulated = false;
+
+    mParent->physicsStrand()->post(
+        std::tr1::bind(&BulletCharacterObject::setCharacterOrientation, this, orient),
+        "BulletCharacterObject::setCharacterOrientation"
+    );
+}
+
+void BulletCharacterObject::setCharacterLocation(const TimedMotionVector3f& loc) {
     //mesh for mGhostObject may not have been loaded yet before person
-    //pressed a key requesting character to move.  update that occurs
-    //in load will overwrite current position anyways, so don't lose
-    //any information from discarding move here.
+    //pressed a key requesting character to move. The load gets posted
+    //after this with the updated properties, so don't lose any
+    //information from discarding move here.
     if (mGhostObject == NULL)
       return;
 
-    // And apply current position. We don't need to apply velocity because it'll
-    // be applied at the next tick.
+    // The velocity gets applied at the next tick
+    mVelocity = loc.velocity();
+
+    // And apply current position.
     btTransform xform = mGhostObject->getWorldTransform();
-    Vector3f objPosition = mParent->currentPosition(mID);
+    Vector3f objPosition = loc.position(mParent->context()->simTime());
     btQuaternion objOrient = xform.getRotation();
     mGhostObject->setWorldTransform(
         btTransform(
@@ -198,33 +226,33 @@ void BulletCharacterObject::applyForcedLocation(const TimedMotionVector3f& loc,
             btVector3( objPosition.x, objPosition.y, objPosition.z )
         )
     );
+    mGhostObject->activate();
 }
 
-void BulletCharacterObject::applyForcedOrientation(const TimedMotionQuaternion& orient, uint64 epoch) {
-    // Update recorded info. Note that this still follows epoch ordering! It
-    // will be ignored if it is out of date, even though this is "forced".
-    LocationInfo& locinfo = mParent->info(mID);
-    locinfo.props.setOrientation(orient, epoch);
-
-    //mesh for mGhostObject may not have been loaded yet before person
-    //pressed a key requesting character to move.  update that occurs
-    //in load will overwrite current position anyways, so don't lose
-    //any information from discarding move here.
+void BulletCharacterObject::setCharacterOrientation(const TimedMotionQuaternion& orient) {
+    // See setCharacterLocation
     if (mGhostObject == NULL)
       return;
 
+    // The rotation gets applied at the next tick
+    mOrientation = orient;
 
-    // And apply current position. We don't need to apply velocity because it'll
-    // be applied at the next tick.
+    // And apply current orientation.
     btTransform xform = mGhostObject->getWorldTransform();
     btVector3 objPosition = xform.getOrigin();
-    Quaternion objOrient = mParent->currentOrientation(mID);
+    Quaternion objOrient = orient.position(mParent->context()->simTime());
     mGhostObject->setWorldTransform(
         btTransform(
             btQuaternion(objOrient.x, objOrient.y, objOrient.z, objOrient.w),
             objPosition
         )
     );
+    mGhostObject->activate();
+}
+
+void BulletCharacterObject::restoreSimulatedMotion(const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient) {
+    setCharacterLocation(loc);
+    setCharacterOrientation(orient);
 }
 
 } // namespace Sirikata
@@ -28,7 +28,7 @@ public:
     virtual bulletObjBBox bbox();
     virtual float32 mass();
 
-    virtual void load(Mesh::MeshdataPtr mesh);
+    virtual void load(Mesh::MeshdataPtr mesh, const PresenceProperties& props);
     virtual void unload();
     virtual void preTick(const Time& t);
     virtual void postTick(const Time& t);
@@ -39,8 +39,13 @@ public:
     virtual bool applyRequestedOrientation(const TimedMotionQuaternion& orient, uint64 epoch);
     virtual void applyForcedLocation(const TimedMotionVector3f& loc, uint64 epoch);
     virtual void applyForcedOrientation(const TimedMotionQuaternion& orient, uint64 epoch);
+    virtual void restoreSimulatedMotion(const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient);
 
 private:
+    // Physics strand halves of applyForcedLocation/Orientation
+    void setCharacterLocation(const TimedMotionVector3f& loc);
+    void setCharacterOrientation(const TimedMotionQuaternion& orient);
+
     UUID mID;
 
     bulletObjBBox mBBox;
@@ -48,6 +53,14 @@ private:
     btPairCachingGhostObject* mGhostObject;
     BulletCharacterController* mCharacter;
     btCollisionShape* mCollisionShape;
+
+    // The walking velocity and rotation last requested for the character,
+    // owned by the physics strand. These are what we simulate, whereas the
+    // properties only hold what was last published.
+    Vector3f mVelocity;
+    TimedMotionQuaternion mOrientation;
+    // Whether we've reported the character coming to rest since it last moved
+    bool mStopReported;
 }; // class BulletCharacterObject
 
 } // namespace Sirikata
@@ -51,13 +51,11 @@ void BulletObject::getCollisionMask(bulletObjTreatment treatment, bulletObjColli
 }
 
 
-btCollisionShape* BulletObject::computeCollisionShape(const UUID& id, bulletObjBBox shape_type, bulletObjTreatment treatment, Mesh::MeshdataPtr retrievedMesh) {
-    const LocationInfo& locinfo = mParent->info(id);
-
+btCollisionShape* BulletObject::computeCollisionShape(const UUID& id, bulletObjBBox shape_type, bulletObjTreatment treatment, Mesh::MeshdataPtr retrievedMesh, const BoundingSphere3f& bounds) {
     // Spheres can be handled trivially
     if(shape_type == BULLET_OBJECT_BOUNDS_SPHERE || !retrievedMesh) {
-        BULLETLOG(detailed, "sphere radius: " << locinfo.props.bounds().radius());
-        btCollisionShape* shape = new btSphereShape(locinfo.props.bounds().radius());
+        BULLETLOG(detailed, "sphere radius: " << bounds.radius());
+        btCollisionShape* shape = new btSphereShape(bounds.radius());
         return shape;
     }
 
@@ -77,7 +75,7 @@ btCollisionShape* BulletObject::computeCollisionShape(const UUID& id, bulletObjB
     //objBBox enum defined in header file
     //using if/elseif here to avoid switch/case compiler complaints (initializing variables in a case)
     if(shape_type == BULLET_OBJECT_BOUNDS_ENTIRE_OBJECT) {
-        double scalingFactor = locinfo.props.bounds().radius()/mesh_rad;
+        double scalingFactor = bounds.radius()/mesh_rad;
         BULLETLOG(detailed, "bbox half extents: " << fabs(diff.x/2)*scalingFactor << ", " << fabs(diff.y/2)*scalingFactor << ", " << fabs(diff.z/2)*scalingFactor);
         btCollisionShape* shape = new btBoxShape(btVector3(fabs((diff.x/2)*scalingFactor), fabs((diff.y/2)*scalingFactor), fabs((diff.z/2)*scalingFactor)));
         return shape;
@@ -213,7 +211,7 @@ btCollisionShape* BulletObject::computeCollisionShape(const UUID& id, bulletObjB
 
     // Apply additional scaling factor to get from unit
     // scale up to requested scale.
-    float32 rad_scale = locinfo.props.bounds().radius();
+    float32 rad_scale = bounds.radius();
     shape->setLocalScaling(btVector3(rad_scale, rad_scale, rad_scale));
 
     //FIXME bug somewhere else? bnds.radius()/mesh_rad should be
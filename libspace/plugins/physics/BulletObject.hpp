@@ -14,6 +14,13 @@ namespace Sirikata {
 /** Base class for simulated objects in bullet. This provides a pretty generic
  *  interface since different types of objects are handled very differently,
  *  e.g. regular rigid bodies vs. characters.
+ *
+ *  Objects are created on the main strand, but all their Bullet state belongs
+ *  to the BulletPhysicsService's physics strand. load(), unload() and the tick
+ *  callbacks run there, and must not look at the service's LocationInfo since
+ *  the main strand owns it. The apply* methods run on the main strand, update
+ *  the LocationInfo, and post any change to the simulation to the physics
+ *  strand.
  */
 class BulletObject {
 public:
@@ -33,8 +40,10 @@ public:
     /** After the mesh has been downloaded and parsed (or immediately if no mesh
      *  is required), this loads the object into the simulation. This should
      *  setup any Bullet state and start the physical simulation on the object.
+     *  props is a copy of the object's properties taken when the load was
+     *  posted.
      */
-    virtual void load(Mesh::MeshdataPtr mesh) = 0;
+    virtual void load(Mesh::MeshdataPtr mesh, const PresenceProperties& props) = 0;
 
     /** Unload the object from the simulation.
      */
@@ -54,8 +63,8 @@ public:
     virtual void internalTick(const Time& t) {}
 
     /** Check this object for deactivation. Implementations should call
-     *  BulletPhysicsService::updateObjectFromDeactivation if the object has
-     *  been deactivated.
+     *  BulletPhysicsService::updateObjectFromDeactivation with the simulated
+     *  pose once when the object has been deactivated.
      */
     virtual void deactivationTick(const Time& t) {}
 
@@ -89,10 +98,16 @@ public:
      */
     virtual void applyForcedOrientation(const TimedMotionQuaternion& orient, uint64 epoch) = 0;
 
+    /** Continue the simulation from exact simulated motion, e.g. from the
+     *  server this object just migrated from. Runs on the physics strand,
+     *  after the service has stored the motion in the object's properties.
+     */
+    virtual void restoreSimulatedMotion(const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient) {}
+
 protected:
 
     // Helper for computing the collision
-    btCollisionShape* computeCollisionShape(const UUID& id, bulletObjBBox shape_type, bulletObjTreatment treatment, Mesh::MeshdataPtr retrievedMesh);
+    btCollisionShape* computeCollisionShape(const UUID& id, bulletObjBBox shape_type, bulletObjTreatment treatment, Mesh::MeshdataPtr retrievedMesh, const BoundingSphere3f& bounds);
 
     BulletPhysicsService* mParent;
 }; // class BulletObject
@@ -36,13 +36,17 @@
 #include "BulletCharacterObject.hpp"
 #include <sirikata/core/trace/Trace.hpp>
 #include <sirikata/mesh/CompositeFilter.hpp>
+#include <sirikata/space/MigrationDataClientRegistry.hpp>
 
 #include "Protocol_Loc.pbj.hpp"
+#include "Protocol_Migration.pbj.hpp"
 
 #include <json_spirit/json_spirit.h>
 
 #include <sirikata/core/transfer/AggregatedTransferPool.hpp>
 #include <sirikata/core/network/IOStrandImpl.hpp>
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOWork.hpp>
 
 namespace Sirikata {
 
@@ -53,9 +57,17 @@ void bulletPhysicsInternalTickCallback(btDynamicsWorld *world, btScalar timeStep
 }
 }
 
-BulletPhysicsService::BulletPhysicsService(SpaceContext* ctx, LocationUpdatePolicy* update_policy)
+BulletPhysicsService::BulletPhysicsService(SpaceContext* ctx, LocationUpdatePolicy* update_policy, float32 position_tolerance, float32 velocity_tolerance, float32 angle_tolerance)
  : LocationService(ctx, update_policy),
+   mPositionToleranceSq(position_tolerance * position_tolerance),
+   mVelocityToleranceSq(velocity_tolerance * velocity_tolerance),
+   mAngleTolerance(angle_tolerance),
    mUpdateIteration(0),
+   mPhysicsService(NULL),
+   mPhysicsStrand(NULL),
+   mPhysicsWork(NULL),
+   mPhysicsThread(NULL),
+   mStepInProgress(false),
    mParsingStrand( ctx->ioService->createStrand("BulletPhysicsService Parsing") )
 {
 
@@ -67,6 +79,11 @@ BulletPhysicsService::BulletPhysicsService(SpaceContext* ctx, LocationUpdatePoli
     mDynamicsWorld->setInternalTickCallback(bulletPhysicsInternalTickCallback, (void*)this);
     mDynamicsWorld->setGravity(btVector3(0,-9.8,0));
 
+    mPhysicsService = new Network::IOService("BulletPhysicsService");
+    mPhysicsStrand = mPhysicsService->createStrand("BulletPhysicsService Simulation");
+    mPhysicsWork = new Network::IOWork(mPhysicsService, "BulletPhysicsService Work");
+    mPhysicsThread = new Thread("BulletPhysicsService", std::tr1::bind(&BulletPhysicsService::physicsThreadMain, this));
+
     mLastTime = mContext->simTime();
     mLastDeactivationTime = mContext->simTime();
 
@@ -91,10 +108,16 @@ BulletPhysicsService::BulletPhysicsService(SpaceContext* ctx, LocationUpdatePoli
     mTransferMediator = &(Transfer::TransferMediator::getSingleton());
     mTransferPool = mTransferMediator->registerClient<Transfer::AggregatedTransferPool>("BulletPhysics");
 
+    if (mContext->migrationDataClients())
+        mContext->migrationDataClients()->addClient(this);
+
     BULLETLOG(detailed, "Service Loaded");
 }
 
 BulletPhysicsService::~BulletPhysicsService() {
+    if (mContext->migrationDataClients())
+        mContext->migrationDataClients()->removeClient(this);
+
     // Note that we should get removal requests for all objects.  Just as a
     // sanity check, we'll make sure we've cleaned everything out at this point.
     while(!mLocations.empty()) {
@@ -102,6 +125,16 @@ BulletPhysicsService::~BulletPhysicsService() {
         mLocations.erase(mLocations.begin());
     }
 
+    // Let the physics thread finish up any outstanding work, including the
+    // unloads just posted, before tearing down the world. Any step results it
+    // posts back to the main strand are dropped with it.
+    delete mPhysicsWork;
+    mPhysicsWork = NULL;
+    mPhysicsThread->join();
+    delete mPhysicsThread;
+    delete mPhysicsStrand;
+    delete mPhysicsService;
+
     delete mDynamicsWorld;
     delete solver;
     delete dispatcher;
@@ -132,57 +165,70 @@ LocationService::TrackingType BulletPhysicsService::type(const UUID& uuid) const
 
 
 void BulletPhysicsService::service() {
-    //get the time elapsed between calls to this service and
-    //move the simulation forward by that amount
-    Time now = mContext->simTime();
-    Duration delTime = now - mLastTime;
-    mLastTime = now;
-    float simForwardTime = delTime.toMilliseconds() / 1000.0f;
+    // If the simulation is still working on the last step, this one gets
+    // folded into the next.
+    if (!mStepInProgress) {
+        //get the time elapsed between calls to this service and
+        //move the simulation forward by that amount
+        Time now = mContext->simTime();
+        Duration delTime = now - mLastTime;
+        mLastTime = now;
+        float simForwardTime = delTime.toMilliseconds() / 1000.0f;
+
+        // Check for deactivated objects. Unfortunately there isn't a way to
+        // get this information from bullet at the time deactivation, so we
+        // need to poll for it
+        static Duration deactivation_check_interval(Duration::seconds(1));
+        bool check_deactivation = (now - mLastDeactivationTime > deactivation_check_interval);
+        if (check_deactivation)
+            mLastDeactivationTime = now;
+
+        mStepInProgress = true;
+        mPhysicsStrand->post(
+            std::tr1::bind(&BulletPhysicsService::physicsTick, this, now, simForwardTime, check_deactivation),
+            "BulletPhysicsService::physicsTick"
+        );
+    }
 
+    // See note at declaration of mUpdateIteration. The fastest possible update
+    // rate depends on this constant (10) and the LocationService target tick
+    // period (10ms) -- so we'll get updates at most every 100ms currently.
+    if (mUpdateIteration++ % 10 == 0)
+        mUpdatePolicy->service();
+}
+
+void BulletPhysicsService::physicsThreadMain() {
+    mPhysicsService->run();
+}
+
+void BulletPhysicsService::physicsTick(const Time& now, float32 simForwardTime, bool checkDeactivation) {
     // Pre tick
-    for(UUIDSet::iterator id_it = mTickObjects.begin(); id_it != mTickObjects.end(); id_it++) {
-        const UUID& locobj = *id_it;
-        LocationInfo& locinfo = mLocations[locobj];
-        assert(locinfo.simObject != NULL);
-        locinfo.simObject->preTick(now);
-    }
+    for(ObjectSet::iterator obj_it = mTickObjects.begin(); obj_it != mTickObjects.end(); obj_it++)
+        (*obj_it)->preTick(now);
     // Step simulation
     mDynamicsWorld->stepSimulation(simForwardTime);
     // Post tick
-    for(UUIDSet::iterator id_it = mTickObjects.begin(); id_it != mTickObjects.end(); id_it++) {
-        const UUID& locobj = *id_it;
-        LocationInfo& locinfo = mLocations[locobj];
-        assert(locinfo.simObject != NULL);
-        locinfo.simObject->postTick(now);
-    }
+    for(ObjectSet::iterator obj_it = mTickObjects.begin(); obj_it != mTickObjects.end(); obj_it++)
+        (*obj_it)->postTick(now);
 
-    // Check for deactivated objects. Unfortunately there isn't a way to get
-    // this information from bullet at the time deactivation, so we need to poll
-    // for it
-    static Duration deactivation_check_interval(Duration::seconds(1));
-    if (now - mLastDeactivationTime > deactivation_check_interval) {
-        for(UUIDSet::iterator id_it = mDeactivateableObjects.begin(); id_it != mDeactivateableObjects.end(); id_it++) {
-            const UUID& locobj = *id_it;
-            LocationInfo& locinfo = mLocations[locobj];
-            assert(locinfo.simObject != NULL);
-            locinfo.simObject->deactivationTick(now);
-        }
-        mLastDeactivationTime = now;
+    if (checkDeactivation) {
+        for(ObjectSet::iterator obj_it = mDeactivateableObjects.begin(); obj_it != mDeactivateableObjects.end(); obj_it++)
+            (*obj_it)->deactivationTick(now);
     }
 
-    // Process location updates
-    for(UUIDSet::iterator i = physicsUpdates.begin(); i != physicsUpdates.end(); i++) {
-        LocationMap::iterator it = mLocations.find(*i);
-        if(it != mLocations.end())
-            notifyLocalLocationUpdated(*i, it->second.aggregate, it->second.props.location() );
-    }
-    physicsUpdates.clear();
+    // Hand the updates over to be published
+    PhysicsUpdateMap* updates = new PhysicsUpdateMap();
+    updates->swap(mPhysicsUpdates);
+    mContext->mainStrand->post(
+        std::tr1::bind(&BulletPhysicsService::finishPhysicsTick, this, updates),
+        "BulletPhysicsService::finishPhysicsTick"
+    );
+}
 
-    // See note at declaration of mUpdateIteration. The fastest possible update
-    // rate depends on this constant (10) and the LocationService target tick
-    // period (10ms) -- so we'll get updates at most every 100ms currently.
-    if (mUpdateIteration++ % 10 == 0)
-        mUpdatePolicy->service();
+void BulletPhysicsService::finishPhysicsTick(PhysicsUpdateMap* updates) {
+    publishPhysicsUpdates(*updates);
+    delete updates;
+    mStepInProgress = false;
 }
 
 uint64 BulletPhysicsService::epoch(const UUID& uuid) {
@@ -396,11 +442,7 @@ void BulletPhysicsService::updatePhysicsWorld(const UUID& uuid) {
     }
 
     // Clear out previous state from the simulation.
-    if (locinfo.simObject != NULL) {
-        locinfo.simObject->unload();
-        delete locinfo.simObject;
-        locinfo.simObject = NULL;
-    }
+    cleanupLocationInfo(locinfo);
 
     // And then proceed to add the new simulated object into bullet
     switch(objTreatment) {
@@ -448,17 +490,31 @@ void BulletPhysicsService::updatePhysicsWorldWithMesh(const UUID& uuid, Meshdata
     if (it == mLocations.end()) return;
 
     LocationInfo& locinfo = it->second;
+    if (locinfo.simObject == NULL) return;
 
-    locinfo.simObject->load(retrievedMesh);
+    // The simulation starts from the properties as they are now. Any moves
+    // after this are posted behind the load.
+    mPhysicsStrand->post(
+        std::tr1::bind(&BulletObject::load, locinfo.simObject, retrievedMesh, PresenceProperties(locinfo.props)),
+        "BulletObject::load"
+    );
 }
 
 // Helper for cleaning up a LocationInfo before removing it
 void BulletPhysicsService::cleanupLocationInfo(LocationInfo& locinfo) {
     if (locinfo.simObject != NULL) {
-        locinfo.simObject->unload();
-        delete locinfo.simObject;
+        mPhysicsStrand->post(
+            std::tr1::bind(&BulletPhysicsService::unloadObject, this, locinfo.simObject),
+            "BulletPhysicsService::unloadObject"
+        );
         locinfo.simObject = NULL;
     }
+    locinfo.simulated = false;
+}
+
+void BulletPhysicsService::unloadObject(BulletObject* obj) {
+    obj->unload();
+    delete obj;
 }
 
 void BulletPhysicsService::removeLocalObject(const UUID& uuid) {
@@ -491,74 +547,114 @@ const LocationInfo& BulletPhysicsService::info(const UUID& uuid) const {
     return mLocations.find(uuid)->second;
 }
 
-void BulletPhysicsService::addTickObject(const UUID& uuid) {
-    mTickObjects.insert(uuid);
+void BulletPhysicsService::addTickObject(BulletObject* obj) {
+    mTickObjects.insert(obj);
 }
-void BulletPhysicsService::removeTickObject(const UUID& uuid) {
-    UUIDSet::iterator dynamic_obj_it = mTickObjects.find(uuid);
-    if (dynamic_obj_it != mTickObjects.end())
-        mTickObjects.erase(dynamic_obj_it);
+void BulletPhysicsService::removeTickObject(BulletObject* obj) {
+    mTickObjects.erase(obj);
 }
 
-void BulletPhysicsService::addInternalTickObject(const UUID& uuid) {
-    mInternalTickObjects.insert(uuid);
+void BulletPhysicsService::addInternalTickObject(BulletObject* obj) {
+    mInternalTickObjects.insert(obj);
 }
-void BulletPhysicsService::removeInternalTickObject(const UUID& uuid) {
-    UUIDSet::iterator dynamic_obj_it = mInternalTickObjects.find(uuid);
-    if (dynamic_obj_it != mInternalTickObjects.end())
-        mInternalTickObjects.erase(dynamic_obj_it);
+void BulletPhysicsService::removeInternalTickObject(BulletObject* obj) {
+    mInternalTickObjects.erase(obj);
 }
 
-void BulletPhysicsService::addDeactivateableObject(const UUID& uuid) {
-    mDeactivateableObjects.insert(uuid);
+void BulletPhysicsService::addDeactivateableObject(BulletObject* obj) {
+    mDeactivateableObjects.insert(obj);
 }
-void BulletPhysicsService::removeDeactivateableObject(const UUID& uuid) {
-    UUIDSet::iterator dynamic_obj_it = mDeactivateableObjects.find(uuid);
-    if (dynamic_obj_it != mDeactivateableObjects.end())
-        mDeactivateableObjects.erase(dynamic_obj_it);
+void BulletPhysicsService::removeDeactivateableObject(BulletObject* obj) {
+    mDeactivateableObjects.erase(obj);
 }
 
 
-void BulletPhysicsService::addUpdate(const UUID& uuid) {
-    physicsUpdates.insert(uuid);
+void BulletPhysicsService::addUpdate(const UUID& uuid, const TimedMotionVector3f& newloc, const TimedMotionQuaternion& neworient, bool stopped) {
+    PhysicsUpdate& update = mPhysicsUpdates[uuid];
+    update.location = newloc;
+    update.orientation = neworient;
+    update.stopped = stopped;
 }
 
-void BulletPhysicsService::updateObjectFromDeactivation(const UUID& uuid) {
-    if (isFixed(uuid)) return;
-    if (location(uuid).velocity() == Vector3f(0.f, 0.f, 0.f) &&
-        orientation(uuid).velocity() == Quaternion::identity())
-        return;
+bool BulletPhysicsService::locationDiffers(const TimedMotionVector3f& published, const TimedMotionVector3f& simulated) const {
+    Time t = simulated.updateTime();
+    return
+        (published.position(t) - simulated.position(t)).lengthSquared() > mPositionToleranceSq ||
+        (published.velocity() - simulated.velocity()).lengthSquared() > mVelocityToleranceSq;
+}
 
+namespace {
+// Angle between the rotations represented by two quaternions
+float32 rotationDifference(const Quaternion& a, const Quaternion& b) {
+    float32 cos_half = fabs(a.normal().dot(b.normal()));
+    return 2.f * acos(std::min(cos_half, 1.f));
+}
+}
+
+bool BulletPhysicsService::orientationDiffers(const TimedMotionQuaternion& published, const TimedMotionQuaternion& simulated) const {
+    Time t = simulated.updateTime();
+    return
+        rotationDifference(published.position(t), simulated.position(t)) > mAngleTolerance ||
+        rotationDifference(published.velocity(), simulated.velocity()) > mAngleTolerance;
+}
+
+void BulletPhysicsService::publishPhysicsUpdates(const PhysicsUpdateMap& updates) {
+    for(PhysicsUpdateMap::const_iterator up_it = updates.begin(); up_it != updates.end(); up_it++) {
+        LocationMap::iterator it = mLocations.find(up_it->first);
+        if (it == mLocations.end()) continue;
+        LocationInfo& locinfo = it->second;
+        const PhysicsUpdate& update = up_it->second;
+
+        locinfo.simulated = true;
+        locinfo.simLocation = update.location;
+        locinfo.simOrientation = update.orientation;
+
+        // Coming to rest always gets published, even a tiny leftover
+        // velocity would otherwise make the object drift forever. If it
+        // was already published at rest there's nothing to do.
+        bool force = update.stopped &&
+            !(locinfo.props.location().velocity() == Vector3f(0.f, 0.f, 0.f) &&
+                locinfo.props.orientation().velocity() == Quaternion::identity());
+
+        // Objects coasting along as predicted, including ones that have
+        // settled and stopped, don't need to generate any traffic.
+        if (force || locationDiffers(locinfo.props.location(), update.location)) {
+            locinfo.props.setLocation(update.location);
+            notifyLocalLocationUpdated(up_it->first, locinfo.aggregate, locinfo.props.location());
+        }
+        if (force || orientationDiffers(locinfo.props.orientation(), update.orientation)) {
+            locinfo.props.setOrientation(update.orientation);
+            notifyLocalOrientationUpdated(up_it->first, locinfo.aggregate, locinfo.props.orientation());
+        }
+    }
+}
+
+void BulletPhysicsService::updateObjectFromDeactivation(const UUID& uuid, const Vector3f& pos, const Quaternion& orient) {
     Time t = context()->simTime();
     TimedMotionVector3f newLocation(
         t,
         MotionVector3f(
-            currentPosition(uuid),
+            pos,
             Vector3f(0.f, 0.f, 0.f)
         )
     );
-    setLocation(uuid, newLocation);
     BULLETLOG(insane, "Updating " << uuid.toString() << " to stopped.");
 
     TimedMotionQuaternion newOrientation(
         t,
         MotionQuaternion(
-            currentOrientation(uuid),
+            orient,
             Quaternion::identity()
         )
     );
-    setOrientation(uuid, newOrientation);
 
-    physicsUpdates.insert(uuid);
+    addUpdate(uuid, newLocation, newOrientation, true);
 }
 
 void BulletPhysicsService::internalTickCallback() {
     Time t = mContext->simTime();
-    for(UUIDSet::iterator id_it = mInternalTickObjects.begin(); id_it != mInternalTickObjects.end(); id_it++) {
-        LocationInfo& locinfo = mLocations[*id_it];
-        assert(locinfo.simObject != NULL);
-        locinfo.simObject->internalTick(t);
-    }
+    for(ObjectSet::iterator obj_it = mInternalTickObjects.begin(); obj_it != mInternalTickObjects.end(); obj_it++)
+        (*obj_it)->internalTick(t);
 }
 
 void BulletPhysicsService::addLocalAggregateObject(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bnds, const String& msh, const String& phy) {
@@ -914,6 +1010,70 @@ bool BulletPhysicsService::locationUpdate(UUID source, void* buffer, uint32 leng
     return true;
 }
 
+// MigrationDataClient Interface
+
+std::string BulletPhysicsService::migrationClientTag() {
+    return "bullet";
+}
 
+void BulletPhysicsService::generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, MigrationDataWriter& out) {
+    // The location sent with the migration is the last one published, which
+    // can be off by up to the publishing tolerances. Send the exact simulated
+    // motion so the destination picks up where we left off.
+    LocationMap::iterator it = mLocations.find(obj);
+    if (it == mLocations.end() || it->second.simObject == NULL || !it->second.simulated)
+        return;
+
+    const TimedMotionVector3f& loc = it->second.simLocation;
+    const TimedMotionQuaternion& orient = it->second.simOrientation;
+
+    Sirikata::Protocol::Migration::PhysicsMigrationData migr_data;
+    Sirikata::Protocol::ITimedMotionVector migr_loc = migr_data.mutable_loc();
+    migr_loc.set_t(loc.updateTime());
+    migr_loc.set_position(loc.position());
+    migr_loc.set_velocity(loc.velocity());
+    Sirikata::Protocol::ITimedMotionQuaternion migr_orient = migr_data.mutable_orientation();
+    migr_orient.set_t(orient.updateTime());
+    migr_orient.set_position(orient.position());
+    migr_orient.set_velocity(orient.velocity());
+    out.writeMessage(migr_data);
+}
+
+void BulletPhysicsService::receiveMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, const std::string& data) {
+    Sirikata::Protocol::Migration::PhysicsMigrationData migr_data;
+    bool parse_success = migr_data.ParseFromString(data);
+    if (!parse_success) {
+        LOG_INVALID_MESSAGE(BulletPhysics, error, data);
+        return;
+    }
+
+    // The object was added with the location from the migration message, so
+    // we only need to correct it if it's being simulated here too
+    LocationMap::iterator it = mLocations.find(obj);
+    if (it == mLocations.end() || !it->second.local || it->second.simObject == NULL)
+        return;
+    LocationInfo& locinfo = it->second;
+
+    TimedMotionVector3f loc(
+        migr_data.loc().t(),
+        MotionVector3f( migr_data.loc().position(), migr_data.loc().velocity() )
+    );
+    TimedMotionQuaternion orient(
+        migr_data.orientation().t(),
+        MotionQuaternion( migr_data.orientation().position(), migr_data.orientation().velocity() )
+    );
+    locinfo.props.setLocation(loc);
+    locinfo.props.setOrientation(orient);
+    locinfo.simulated = true;
+    locinfo.simLocation = loc;
+    locinfo.simOrientation = orient;
+    mPhysicsStrand->post(
+        std::tr1::bind(&BulletObject::restoreSimulatedMotion, locinfo.simObject, loc, orient),
+        "BulletObject::restoreSimulatedMotion"
+    );
+
+    notifyLocalLocationUpdated(obj, locinfo.aggregate, locinfo.props.location());
+    notifyLocalOrientationUpdated(obj, locinfo.aggregate, locinfo.props.orientation());
+}
 
 } // namespace Sirikata
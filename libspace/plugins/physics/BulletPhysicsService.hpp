@@ -34,6 +34,7 @@
 #define _SIRIKATA_BULLET_PHYSICS_SERVICE_HPP_
 
 #include <sirikata/space/LocationService.hpp>
+#include <sirikata/space/MigrationDataClient.hpp>
 #include "btBulletDynamicsCommon.h"
 
 #include <sirikata/mesh/ModelsSystemFactory.hpp>
@@ -44,6 +45,9 @@
 #include <sirikata/mesh/Filter.hpp>
 #include <sirikata/mesh/Meshdata.hpp>
 
+#include <sirikata/core/network/IODefs.hpp>
+#include <sirikata/core/util/Thread.hpp>
+
 #include "Defs.hpp"
 
 namespace Sirikata {
@@ -51,10 +55,28 @@ namespace Sirikata {
 using namespace Mesh;
 /** Standard location service, which functions entirely based on location
  *  updates from objects and other spaces servers.
+ *
+ *  The Bullet world is stepped on its own thread so simulation doesn't hold up
+ *  the main strand. Everything in the world -- the BulletObjects' Bullet state,
+ *  the tick object sets, and the updates collected during a step -- belongs
+ *  to the physics strand, while mLocations belongs to the main strand. Loads,
+ *  unloads, and moves are posted to the physics strand, and each step's
+ *  updates are handed back to the main strand in one batch to be published.
  */
-class BulletPhysicsService : public LocationService {
+class BulletPhysicsService : public LocationService, public MigrationDataClient {
 public:
-    BulletPhysicsService(SpaceContext* ctx, LocationUpdatePolicy* update_policy);
+    /** Create a BulletPhysicsService.
+     *  \param position_tolerance how far, in meters, an object's simulated
+     *         position may drift from the one extrapolated from its last
+     *         published location before a new location is published
+     *  \param velocity_tolerance how much an object's simulated velocity may
+     *         differ from its last published one before a new location is
+     *         published
+     *  \param angle_tolerance how far, in radians, an object's simulated
+     *         orientation or angular velocity may differ from its last
+     *         published one before a new orientation is published
+     */
+    BulletPhysicsService(SpaceContext* ctx, LocationUpdatePolicy* update_policy, float32 position_tolerance, float32 velocity_tolerance, float32 angle_tolerance);
     virtual ~BulletPhysicsService();
 
     virtual bool contains(const UUID& uuid) const;
@@ -99,6 +121,11 @@ public:
 
     virtual bool locationUpdate(UUID source, void* buffer, uint32 length);
 
+    // MigrationDataClient Interface
+    virtual std::string migrationClientTag();
+    virtual void generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, MigrationDataWriter& out);
+    virtual void receiveMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, const std::string& data);
+
     typedef std::tr1::function<void(MeshdataPtr)> MeshdataParsedCallback;
     void getMesh(const Transfer::URI meshURI, const UUID uuid, MeshdataParsedCallback cb);
     // The last two get set in this callback, indicating that the
@@ -111,23 +138,32 @@ public:
 
     btDiscreteDynamicsWorld* dynamicsWorld() { return mDynamicsWorld; }
     btBroadphaseInterface* broadphase() { return mBroadphase; }
+    // Strand that owns the simulation, see class comment
+    Network::IOStrand* physicsStrand() { return mPhysicsStrand; }
 
+    // Called from the physics strand:
     // Objects that want callbacks for each tick, e.g. for grabbing updates that
     // aren't emitted automatically or updating velocity
-    void addTickObject(const UUID& uuid);
-    void removeTickObject(const UUID& uuid);
+    void addTickObject(BulletObject* obj);
+    void removeTickObject(BulletObject* obj);
     // Objects that want callbacks for each internal tick, e.g. for capping
     // velocity
-    void addInternalTickObject(const UUID& uuid);
-    void removeInternalTickObject(const UUID& uuid);
+    void addInternalTickObject(BulletObject* obj);
+    void removeInternalTickObject(BulletObject* obj);
     // Objects that want deactivation check callbacks
-    void addDeactivateableObject(const UUID& uuid);
-    void removeDeactivateableObject(const UUID& uuid);
+    void addDeactivateableObject(BulletObject* obj);
+    void removeDeactivateableObject(BulletObject* obj);
 
-    // Add an update for this object, i.e. it was detected that it moved
-    void addUpdate(const UUID& uuid);
+    // Add an update for this object, i.e. the simulation moved it. Updates are
+    // collected during the step and published together on the main strand
+    // after it, skipping any that listeners could already extrapolate from
+    // the last published values. stopped marks the object as having come to
+    // rest, which is always published unless it was already published at
+    // rest.
+    void addUpdate(const UUID& uuid, const TimedMotionVector3f& newloc, const TimedMotionQuaternion& neworient, bool stopped = false);
 
-    void updateObjectFromDeactivation(const UUID& uuid);
+    // The object came to rest at the given pose
+    void updateObjectFromDeactivation(const UUID& uuid, const Vector3f& pos, const Quaternion& orient);
 
     // Callback invoked each time bullet performs an internal tick
     // (may be finer granularity than we request).
@@ -136,18 +172,32 @@ protected:
     typedef std::tr1::unordered_map<UUID, LocationInfo, UUID::Hasher> LocationMap;
     LocationMap mLocations;
 
-    typedef std::tr1::unordered_set<UUID, UUID::Hasher> UUIDSet;
+    // These are all owned by the physics strand. They hold the objects
+    // directly since the physics strand can't look at mLocations.
+    typedef std::tr1::unordered_set<BulletObject*> ObjectSet;
     // Which objects have dynamic physical simulation and need to be
     // sanity checked at each tick.
-    UUIDSet mTickObjects;
+    ObjectSet mTickObjects;
     // Which objects have dynamic physical simulation and need to be
     // sanity checked at each tick.
-    UUIDSet mInternalTickObjects;
+    ObjectSet mInternalTickObjects;
     // Objects that need to be checked for deactivation
-    UUIDSet mDeactivateableObjects;
-    // Objects which have outstanding updates to location information
-    // from the physics engine.
-    UUIDSet physicsUpdates;
+    ObjectSet mDeactivateableObjects;
+    // Outstanding updates to location information from the physics engine,
+    // handed to the main strand for publishing at the end of each step.
+    struct PhysicsUpdate {
+        PhysicsUpdate() : stopped(false) {}
+
+        TimedMotionVector3f location;
+        TimedMotionQuaternion orientation;
+        bool stopped;
+    };
+    typedef std::tr1::unordered_map<UUID, PhysicsUpdate, UUID::Hasher> PhysicsUpdateMap;
+    PhysicsUpdateMap mPhysicsUpdates;
+    // Thresholds for publishing updates, see constructor
+    float32 mPositionToleranceSq;
+    float32 mVelocityToleranceSq;
+    float32 mAngleTolerance;
     // TODO(ewencp) This is kind of a hack. If we generate updates too quickly
     // we can overwhelm the client and the networking, making it hard for more
     // recent updates to get out. This is common for bullet since it is
@@ -168,6 +218,20 @@ private:
 
     // Helper for cleaning up a LocationInfo before removing it
     void cleanupLocationInfo(LocationInfo& locinfo);
+    // Takes the object out of the simulation and destroys it, on the physics
+    // strand
+    void unloadObject(BulletObject* obj);
+
+    void physicsThreadMain();
+    // Steps the simulation, on the physics strand
+    void physicsTick(const Time& t, float32 simForwardTime, bool checkDeactivation);
+    // Main strand half of physicsTick, publishing its updates
+    void finishPhysicsTick(PhysicsUpdateMap* updates);
+
+    // Apply and notify listeners of physics updates
+    void publishPhysicsUpdates(const PhysicsUpdateMap& updates);
+    bool locationDiffers(const TimedMotionVector3f& published, const TimedMotionVector3f& simulated) const;
+    bool orientationDiffers(const TimedMotionQuaternion& published, const TimedMotionQuaternion& simulated) const;
 
 
     //Bullet Dynamics World Vars
@@ -177,6 +241,16 @@ private:
     btSequentialImpulseConstraintSolver* solver;
     btDiscreteDynamicsWorld* mDynamicsWorld;
 
+    // The simulation's thread. Its work keeps it alive until we're destroyed.
+    Network::IOService* mPhysicsService;
+    Network::IOStrand* mPhysicsStrand;
+    Network::IOWork* mPhysicsWork;
+    Thread* mPhysicsThread;
+    // Whether a step has been posted to the physics strand and hasn't
+    // finished yet. We don't queue up more steps than the simulation can keep
+    // up with, the next one just covers a longer period.
+    bool mStepInProgress;
+
     Time mLastTime;
     // Track last time we checked deactivation state
     Time mLastDeactivationTime;
@@ -39,7 +39,8 @@ BulletRigidBodyObject::BulletRigidBodyObject(BulletPhysicsService* parent, const
    mMass(mass),
    mObjShape(NULL),
    mObjMotionState(NULL),
-   mObjRigidBody(NULL)
+   mObjRigidBody(NULL),
+   mStopReported(false)
 {
     switch(treatment) {
       case BULLET_OBJECT_TREATMENT_STATIC:
@@ -73,14 +74,28 @@ BulletRigidBodyObject::~BulletRigidBodyObject() {
     removeRigidBody();
 }
 
-void BulletRigidBodyObject::load(MeshdataPtr retrievedMesh) {
-    mObjShape = computeCollisionShape(mID, mBBox, mTreatment, retrievedMesh);
+namespace {
+
+btTransform transformAt(const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const Time& t) {
+    Vector3f objPosition = loc.position(t);
+    Quaternion objOrient = orient.position(t);
+    return btTransform(
+        btQuaternion(objOrient.x,objOrient.y,objOrient.z,objOrient.w),
+        btVector3(objPosition.x,objPosition.y,objPosition.z)
+    );
+}
+
+}
+
+void BulletRigidBodyObject::load(MeshdataPtr retrievedMesh, const PresenceProperties& props) {
+    mObjShape = computeCollisionShape(mID, mBBox, mTreatment, retrievedMesh, props.bounds());
     assert(mObjShape != NULL);
-    addRigidBody();
+    addRigidBody(props);
 }
 
-void BulletRigidBodyObject::addRigidBody() {
-    LocationInfo& locinfo = mParent->info(mID);
+void BulletRigidBodyObject::addRigidBody(const PresenceProperties& props) {
+    // Where the motion state will tell the new body to start
+    mSyncTransform = transformAt(props.location(), props.orientation(), mParent->context()->simTime());
 
     //register the motion state (callbacks) for Bullet
     mObjMotionState = new SirikataMotionState(this);
@@ -96,14 +111,7 @@ void BulletRigidBodyObject::addRigidBody() {
     mObjRigidBody = new btRigidBody(objRigidBodyCI);
     //mObjRigidBody->setRestitution(0.5);
     //set initial velocity
-    Vector3f objVelocity = locinfo.props.location().velocity();
-    mObjRigidBody->setLinearVelocity(btVector3(objVelocity.x, objVelocity.y, objVelocity.z));
-    Quaternion objAngVelocity = locinfo.props.orientation().velocity();
-    Vector3f angvel_axis;
-    float32 angvel_angle;
-    objAngVelocity.toAngleAxis(angvel_angle, angvel_axis);
-    Vector3f angvel = angvel_axis.normal() * angvel_angle;
-    mObjRigidBody->setAngularVelocity(btVector3(angvel.x, angvel.y, angvel.z));
+    setBodyVelocity(props.location().velocity(), props.orientation().velocity());
     // With different types of dynamic objects we need to set . Eventually, we
     // might just want to store values for this in locinfo, currently we just
     // decide based on the treatment.  Everything is linear: <1, 1, 1>, angular
@@ -123,8 +131,8 @@ void BulletRigidBodyObject::addRigidBody() {
     mParent->dynamicsWorld()->addRigidBody(mObjRigidBody, (short)mygroup, (short)collide_with);
     // And if its dynamic, make sure its in our list of objects to
     // track for sanity checking
-    mParent->addInternalTickObject(mID);
-    mParent->addDeactivateableObject(mID);
+    mParent->addInternalTickObject(this);
+    mParent->addDeactivateableObject(this);
 }
 
 void BulletRigidBodyObject::unload() {
@@ -142,44 +150,61 @@ void BulletRigidBodyObject::removeRigidBody() {
         delete mObjRigidBody;
         mObjRigidBody = NULL;
 
-        mParent->removeInternalTickObject(mID);
-        mParent->removeDeactivateableObject(mID);
+        mParent->removeInternalTickObject(this);
+        mParent->removeDeactivateableObject(this);
     }
 }
 
-void BulletRigidBodyObject::updateBulletFromObject(btTransform& worldTrans) {
-    Vector3f objPosition = mParent->currentPosition(mID);
-    Quaternion objOrient = mParent->currentOrientation(mID);
-    worldTrans = btTransform(
-        btQuaternion(objOrient.x,objOrient.y,objOrient.z,objOrient.w),
-        btVector3(objPosition.x,objPosition.y,objPosition.z)
-    );
+void BulletRigidBodyObject::setBodyVelocity(const Vector3f& vel, const Quaternion& angvel) {
+    mObjRigidBody->setLinearVelocity(btVector3(vel.x, vel.y, vel.z));
+    Vector3f angvel_axis;
+    float32 angvel_angle;
+    angvel.toAngleAxis(angvel_angle, angvel_axis);
+    Vector3f angvel_vec = angvel_axis.normal() * angvel_angle;
+    mObjRigidBody->setAngularVelocity(btVector3(angvel_vec.x, angvel_vec.y, angvel_vec.z));
 }
 
-void BulletRigidBodyObject::updateObjectFromBullet(const btTransform& worldTrans) {
-    assert(mFixed == false);
-
-    LocationInfo& locinfo = mParent->info(mID);
-
+void BulletRigidBodyObject::bodyMotion(const Time& t, const btTransform& worldTrans, TimedMotionVector3f* loc, TimedMotionQuaternion* orient) {
     btVector3 pos = worldTrans.getOrigin();
     btVector3 vel = mObjRigidBody->getLinearVelocity();
-    TimedMotionVector3f newLocation(mParent->context()->simTime(), MotionVector3f(Vector3f(pos.x(), pos.y(), pos.z()), Vector3f(vel.x(), vel.y(), vel.z())));
-    mParent->setLocation(mID, newLocation);
-    BULLETLOG(insane, "Updating " << mID << " to velocity " << vel.x() << " " << vel.y() << " " << vel.z());
+    *loc = TimedMotionVector3f(t, MotionVector3f(Vector3f(pos.x(), pos.y(), pos.z()), Vector3f(vel.x(), vel.y(), vel.z())));
     btQuaternion rot = worldTrans.getRotation();
     btVector3 angvel = mObjRigidBody->getAngularVelocity();
     Vector3f angvel_siri(angvel.x(), angvel.y(), angvel.z());
     float angvel_angle = angvel_siri.normalizeThis();
-    TimedMotionQuaternion newOrientation(
-        mParent->context()->simTime(),
+    *orient = TimedMotionQuaternion(
+        t,
         MotionQuaternion(
             Quaternion(rot.x(), rot.y(), rot.z(), rot.w()),
             Quaternion(angvel_siri, angvel_angle)
         )
     );
-    mParent->setOrientation(mID, newOrientation);
+}
+
+void BulletRigidBodyObject::syncBody() {
+    // Setting the motion state triggers a sync, even if its the same one that
+    // was already being used.
+    mObjRigidBody->setMotionState(mObjMotionState);
+    // Activate the object in case it's gone to sleep from being still
+    mObjRigidBody->activate();
+}
+
+void BulletRigidBodyObject::updateBulletFromObject(btTransform& worldTrans) {
+    worldTrans = mSyncTransform;
+}
 
-    mParent->addUpdate(mID);
+void BulletRigidBodyObject::updateObjectFromBullet(const btTransform& worldTrans) {
+    assert(mFixed == false);
+
+    TimedMotionVector3f newLocation;
+    TimedMotionQuaternion newOrientation;
+    bodyMotion(mParent->context()->simTime(), worldTrans, &newLocation, &newOrientation);
+    Vector3f vel = newLocation.velocity();
+    BULLETLOG(insane, "Updating " << mID << " to velocity " << vel.x << " " << vel.y << " " << vel.z);
+
+    mParent->addUpdate(mID, newLocation, newOrientation);
+    // It's moving, so we'll need to report when it settles again
+    mStopReported = false;
 }
 
 
@@ -208,8 +233,20 @@ void BulletRigidBodyObject::internalTick(const Time& t) {
 }
 
 void BulletRigidBodyObject::deactivationTick(const Time& t) {
-    if (mObjRigidBody != NULL && !mObjRigidBody->isActive())
-        mParent->updateObjectFromDeactivation(mID);
+    if (mFixed || mObjRigidBody == NULL || mObjRigidBody->isActive() || mStopReported)
+        return;
+
+    // Report where the body actually came to rest, not where listeners
+    // extrapolate it to be.
+    const btTransform& worldTrans = mObjRigidBody->getWorldTransform();
+    btVector3 pos = worldTrans.getOrigin();
+    btQuaternion rot = worldTrans.getRotation();
+    mParent->updateObjectFromDeactivation(
+        mID,
+        Vector3f(pos.x(), pos.y(), pos.z()),
+        Quaternion(rot.x(), rot.y(), rot.z(), rot.w())
+    );
+    mStopReported = true;
 }
 
 
@@ -236,40 +273,65 @@ bool BulletRigidBodyObject::applyRequestedOrientation(const TimedMotionQuaternio
 void BulletRigidBodyObject::applyForcedLocation(const TimedMotionVector3f& loc, uint64 epoch) {
     // Update recorded info
     LocationInfo& locinfo = mParent->info(mID);
-    locinfo.props.setLocation(loc, epoch);
-
-    //mesh for mObjRigidBody may not have been loaded yet before
-    //request to update that occurs
-    //in addRigidBody will overwrite current position anyways, so don't lose
-    //any information from discarding move here.
-    if (mObjRigidBody == NULL)
-      return;
-
-    // Setting the motion state triggers a sync, even if its the same one that
-    // was already being used.
-    mObjRigidBody->setMotionState(mObjMotionState);
-    // Activate the object in case it's gone to sleep from being still
-    mObjRigidBody->activate();
+    if (!locinfo.props.setLocation(loc, epoch))
+        return;
+    // Whatever we last simulated is out of date now
+    locinfo.simulated = false;
+
+    mParent->physicsStrand()->post(
+        std::tr1::bind(&BulletRigidBodyObject::setBodyLocation, this, loc),
+        "BulletRigidBodyObject::setBodyLocation"
+    );
 }
 
 void BulletRigidBodyObject::applyForcedOrientation(const TimedMotionQuaternion& orient, uint64 epoch) {
     // Update recorded info
     LocationInfo& locinfo = mParent->info(mID);
-    locinfo.props.setOrientation(orient, epoch);
+    if (!locinfo.props.setOrientation(orient, epoch))
+        return;
+    // Whatever we last simulated is out of date now
+    locinfo.simulated = false;
+
+    mParent->physicsStrand()->post(
+        std::tr1::bind(&BulletRigidBodyObject::setBodyOrientation, this, orient),
+        "BulletRigidBodyObject::setBodyOrientation"
+    );
+}
 
+void BulletRigidBodyObject::setBodyLocation(const TimedMotionVector3f& loc) {
     //mesh for mObjRigidBody may not have been loaded yet before
-    //request to update that occurs
-    //in addRigidBody will overwrite current position anyways, so don't lose
-    //any information from discarding move here.
+    //request to update that occurs. The load gets posted after this
+    //with the updated properties, so don't lose any information from
+    //discarding move here.
     if (mObjRigidBody == NULL)
       return;
 
+    Vector3f objPosition = loc.position(mParent->context()->simTime());
+    mSyncTransform = mObjRigidBody->getWorldTransform();
+    mSyncTransform.setOrigin(btVector3(objPosition.x,objPosition.y,objPosition.z));
+    syncBody();
+}
 
-    // Setting the motion state triggers a sync, even if its the same one that
-    // was already being used.
-    mObjRigidBody->setMotionState(mObjMotionState);
-    // Activate the object in case it's gone to sleep from being still
-    mObjRigidBody->activate();
+void BulletRigidBodyObject::setBodyOrientation(const TimedMotionQuaternion& orient) {
+    // See setBodyLocation
+    if (mObjRigidBody == NULL)
+      return;
+
+    Quaternion objOrient = orient.position(mParent->context()->simTime());
+    mSyncTransform = mObjRigidBody->getWorldTransform();
+    mSyncTransform.setRotation(btQuaternion(objOrient.x,objOrient.y,objOrient.z,objOrient.w));
+    syncBody();
+}
+
+void BulletRigidBodyObject::restoreSimulatedMotion(const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient) {
+    // If the mesh is still loading, addRigidBody will pick these up from the
+    // properties
+    if (mObjRigidBody == NULL)
+        return;
+
+    mSyncTransform = transformAt(loc, orient, mParent->context()->simTime());
+    setBodyVelocity(loc.velocity(), orient.velocity());
+    syncBody();
 }
 
 } // namespace Sirikata
@@ -25,7 +25,7 @@ public:
     virtual bulletObjBBox bbox() { return mBBox; }
     virtual float32 mass() { return mMass; }
 
-    virtual void load(Mesh::MeshdataPtr mesh);
+    virtual void load(Mesh::MeshdataPtr mesh, const PresenceProperties& props);
     virtual void unload();
     virtual void internalTick(const Time& t);
     virtual void deactivationTick(const Time& t);
@@ -35,6 +35,7 @@ public:
     virtual bool applyRequestedOrientation(const TimedMotionQuaternion& orient, uint64 epoch);
     virtual void applyForcedLocation(const TimedMotionVector3f& loc, uint64 epoch);
     virtual void applyForcedOrientation(const TimedMotionQuaternion& orient, uint64 epoch);
+    virtual void restoreSimulatedMotion(const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient);
 
 
     // Updates from SirikataMotionState
@@ -42,8 +43,17 @@ public:
     void updateObjectFromBullet(const btTransform& worldTrans);
 
 private:
-    void addRigidBody();
+    void addRigidBody(const PresenceProperties& props);
     void removeRigidBody();
+    // Physics strand halves of applyForcedLocation/Orientation
+    void setBodyLocation(const TimedMotionVector3f& loc);
+    void setBodyOrientation(const TimedMotionQuaternion& orient);
+    // Push mSyncTransform into the body and wake it up
+    void syncBody();
+    // Set the body's velocities from the ones stored in Sirikata's format
+    void setBodyVelocity(const Vector3f& vel, const Quaternion& angvel);
+    // Get the body's motion, positioned at worldTrans
+    void bodyMotion(const Time& t, const btTransform& worldTrans, TimedMotionVector3f* loc, TimedMotionQuaternion* orient);
 
     UUID mID;
     // Bullet specific data. First some basic properties:
@@ -55,6 +65,11 @@ private:
     btCollisionShape* mObjShape;
     SirikataMotionState* mObjMotionState;
     btRigidBody* mObjRigidBody;
+    // The transform handed to Bullet the next time it asks the motion state,
+    // i.e. on load and after a forced move
+    btTransform mSyncTransform;
+    // Whether we've reported the body coming to rest since it last moved
+    bool mStopReported;
 
 }; // class BulletRigidBodyObject
 
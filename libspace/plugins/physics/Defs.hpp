@@ -64,7 +64,8 @@ struct LocationInfo {
      : props(),
        local(),
        aggregate(),
-       simObject(NULL)
+       simObject(NULL),
+       simulated(false)
     {}
 
     // Regular location info that we need to maintain for all objects
@@ -78,7 +79,15 @@ struct LocationInfo {
     bool local;
     bool aggregate;
 
+    // Owned by the physics strand once loaded, see BulletPhysicsService
     BulletObject* simObject;
+
+    // The exact motion from the last simulation step that moved the
+    // object. props only holds what was last published, which can be off by
+    // up to the publishing tolerances.
+    bool simulated;
+    TimedMotionVector3f simLocation;
+    TimedMotionQuaternion simOrientation;
 };
 
 } // namespace Sirikata
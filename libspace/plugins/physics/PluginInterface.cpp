@@ -31,6 +31,7 @@
  */
 
 #include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/options/Options.hpp>
 #include <sirikata/space/LocationService.hpp>
 
 #include "BulletPhysicsService.hpp"
@@ -42,10 +43,23 @@ namespace Sirikata {
 
 static void InitPluginOptions() {
     //InitAlwaysLocationUpdatePolicyOptions();
+    Sirikata::InitializeClassOptions ico("space_bulletphysics", NULL,
+        new OptionValue("position-tolerance","0.01",Sirikata::OptionValueType<float32>(),"Distance in meters a simulated object can drift from its last published motion before an update is published."),
+        new OptionValue("velocity-tolerance","0.01",Sirikata::OptionValueType<float32>(),"Change in velocity in meters per second that causes an update to be published."),
+        new OptionValue("angle-tolerance","0.01",Sirikata::OptionValueType<float32>(),"Change in orientation or angular velocity in radians that causes an update to be published."),
+        NULL
+    );
 }
 
 static LocationService* createStandardLoc(SpaceContext* ctx, LocationUpdatePolicy* update_policy, const String& args) {
-    return new BulletPhysicsService(ctx, update_policy);
+    OptionSet* optionsSet = OptionSet::getOptions("space_bulletphysics", NULL);
+    optionsSet->parse(args);
+
+    float32 position_tolerance = optionsSet->referenceOption("position-tolerance")->as<float32>();
+    float32 velocity_tolerance = optionsSet->referenceOption("velocity-tolerance")->as<float32>();
+    float32 angle_tolerance = optionsSet->referenceOption("angle-tolerance")->as<float32>();
+
+    return new BulletPhysicsService(ctx, update_policy, position_tolerance, velocity_tolerance, angle_tolerance);
 }
 
 //static LocationUpdatePolicy* createAlwaysPolicy(const String& args) {
@@ -53,6 +53,8 @@ CBRLocationServiceCache::~CBRLocationServiceCache() {
     mLoc->removeListener(this);
     mLoc = NULL;
     mListeners.clear();
+    for(ObjectDataMap::iterator it = mObjects.begin(); it != mObjects.end(); it++)
+        delete it->second;
     mObjects.clear();
 }
 
@@ -62,9 +64,9 @@ LocationServiceCache::Iterator CBRLocationServiceCache::startTracking(const UUID
     ObjectDataMap::iterator it = mObjects.find(id);
     assert(it != mObjects.end());
 
-    it->second.tracking++;
+    it->second->tracking++;
 
-    return Iterator( new IteratorData(id, it) );
+    return Iterator( new IteratorData(id, it->second) );
 }
 
 void CBRLocationServiceCache::stopTracking(const Iterator& id) {
@@ -80,10 +82,10 @@ void CBRLocationServiceCache::stopTracking(const Iterator& id) {
         printf("Warning: stopped tracking unknown object\n");
         return;
     }
-    if (it->second.tracking <= 0) {
+    if (it->second->tracking <= 0) {
         printf("Warning: stopped tracking untracked object\n");
     }
-    it->second.tracking--;
+    it->second->tracking--;
     tryRemoveObject(it);
 }
 
@@ -96,27 +98,27 @@ bool CBRLocationServiceCache::tracking(const UUID& id) {
 TimedMotionVector3f CBRLocationServiceCache::location(const Iterator& id) {
     // NOTE: Only accesses via iterator, shouldn't need a lock
     IteratorData* itdat = (IteratorData*)id.data;
-    ObjectDataMap::iterator it = itdat->it;
-    assert(it != mObjects.end());
-    return it->second.location;
+    ObjectData* data = itdat->data;
+    assert(data != NULL);
+    return data->location;
 }
 
 Prox::ZernikeDescriptor& CBRLocationServiceCache::zernikeDescriptor(const Iterator& id)  {
   // NOTE: Only accesses via iterator, shouldn't need a lock
   IteratorData* itdat = (IteratorData*)id.data;
-  ObjectDataMap::iterator it = itdat->it;
-  assert(it != mObjects.end());
+  ObjectData* data = itdat->data;
+  assert(data != NULL);
 
-  return it->second.zernike;
+  return data->zernike;
 }
 
 String CBRLocationServiceCache::mesh(const Iterator& id)  {
   // NOTE: Only accesses via iterator, shouldn't need a lock
   IteratorData* itdat = (IteratorData*)id.data;
-  ObjectDataMap::iterator it = itdat->it;
-  assert(it != mObjects.end());
+  ObjectData* data = itdat->data;
+  assert(data != NULL);
 
-  return it->second.mesh;
+  return data->mesh;
 }
 
 BoundingSphere3f CBRLocationServiceCache::region(const Iterator& id)  {
@@ -124,34 +126,33 @@ BoundingSphere3f CBRLocationServiceCache::region(const Iterator& id)  {
     // "Region" for individual objects is the degenerate bounding sphere about
     // their center.
     IteratorData* itdat = (IteratorData*)id.data;
-    ObjectDataMap::iterator it = itdat->it;
-    assert(it != mObjects.end());
-    return it->second.region;
+    ObjectData* data = itdat->data;
+    assert(data != NULL);
+    return data->region;
 }
 
 float32 CBRLocationServiceCache::maxSize(const Iterator& id) {
     // NOTE: Only accesses via iterator, shouldn't need a lock
     // Max size is just the size of the object.
     IteratorData* itdat = (IteratorData*)id.data;
-    ObjectDataMap::iterator it = itdat->it;
-    assert(it != mObjects.end());
-    return it->second.maxSize;
+    ObjectData* data = itdat->data;
+    assert(data != NULL);
+    return data->maxSize;
 }
 
 bool CBRLocationServiceCache::isLocal(const Iterator& id) {
     // NOTE: Only accesses via iterator, shouldn't need a lock
     IteratorData* itdat = (IteratorData*)id.data;
-    ObjectDataMap::iterator it = itdat->it;
-    assert(it != mObjects.end());
-    return it->second.isLocal;
+    ObjectData* data = itdat->data;
+    assert(data != NULL);
+    return data->isLocal;
 }
 
 
 const UUID& CBRLocationServiceCache::iteratorID(const Iterator& id) {
     // NOTE: Only accesses via iterator, shouldn't need a lock
     IteratorData* itdat = (IteratorData*)id.data;
-    ObjectDataMap::iterator it = itdat->it;
-    return it->first;
+    return itdat->objid;
 }
 
 void CBRLocationServiceCache::addUpdateListener(LocationUpdateListener* listener) {
@@ -175,38 +176,38 @@ void CBRLocationServiceCache::removeUpdateListener(LocationUpdateListener* liste
 
 const TimedMotionVector3f& CBRLocationServiceCache::location(const ObjectID& id) const {
     GET_OBJ_ENTRY(id); // NOTE: should only be accessed by prox thread, shouldn't need lock
-    return it->second.location;
+    return it->second->location;
 }
 
 const TimedMotionQuaternion& CBRLocationServiceCache::orientation(const ObjectID& id) const {
     GET_OBJ_ENTRY(id); // NOTE: should only be accessed by prox thread, shouldn't need lock
-    return it->second.orientation;
+    return it->second->orientation;
 }
 
 const BoundingSphere3f& CBRLocationServiceCache::bounds(const ObjectID& id) const {
     GET_OBJ_ENTRY(id); // NOTE: should only be accessed by prox thread, shouldn't need lock
-    return it->second.bounds;
+    return it->second->bounds;
 }
 
 float32 CBRLocationServiceCache::radius(const ObjectID& id) const {
     GET_OBJ_ENTRY(id); // NOTE: should only be accessed by prox thread, shouldn't need lock
-    return it->second.bounds.radius();
+    return it->second->bounds.radius();
 }
 
 const String& CBRLocationServiceCache::mesh(const ObjectID& id) const {
     GET_OBJ_ENTRY(id); // NOTE: should only be accessed by prox thread, shouldn't need lock
-    return it->second.mesh;
+    return it->second->mesh;
 }
 
 const String& CBRLocationServiceCache::physics(const ObjectID& id) const {
     GET_OBJ_ENTRY(id); // NOTE: should only be accessed by prox thread, shouldn't need lock
-    return it->second.physics;
+    return it->second->physics;
 }
 
 
 const bool CBRLocationServiceCache::isAggregate(const ObjectID& id) const {
     GET_OBJ_ENTRY(id); // NOTE: should only be accessed by prox thread, shouldn't need lock
-    return it->second.isAggregate;
+    return it->second->isAggregate;
 }
 
 
@@ -304,7 +305,7 @@ void CBRLocationServiceCache::processObjectAdded(const UUID& uuid, ObjectData da
     if (mObjects.find(uuid) != mObjects.end())
         return;
 
-    mObjects[uuid] = data;
+    mObjects[uuid] = new ObjectData(data);
 
     if (!data.isAggregate)
         for(ListenerSet::iterator it = mListeners.begin(); it != mListeners.end(); it++)
@@ -327,8 +328,8 @@ void CBRLocationServiceCache::processObjectRemoved(const UUID& uuid, bool agg) {
     ObjectDataMap::iterator data_it = mObjects.find(uuid);
     if (data_it == mObjects.end()) return;
 
-    assert(data_it->second.exists);
-    data_it->second.exists = false;
+    assert(data_it->second->exists);
+    data_it->second->exists = false;
 
     tryRemoveObject(data_it);
 
@@ -353,8 +354,8 @@ void CBRLocationServiceCache::processLocationUpdated(const UUID& uuid, bool agg,
     ObjectDataMap::iterator it = mObjects.find(uuid);
     if (it == mObjects.end()) return;
 
-    TimedMotionVector3f oldval = it->second.location;
-    it->second.location = newval;
+    TimedMotionVector3f oldval = it->second->location;
+    it->second->location = newval;
 
     if (!agg)
         for(ListenerSet::iterator it = mListeners.begin(); it != mListeners.end(); it++)
@@ -377,7 +378,7 @@ void CBRLocationServiceCache::processOrientationUpdated(const UUID& uuid, bool a
     ObjectDataMap::iterator it = mObjects.find(uuid);
     if (it == mObjects.end()) return;
 
-    it->second.orientation = newval;
+    it->second->orientation = newval;
 }
 
 void CBRLocationServiceCache::boundsUpdated(const UUID& uuid, bool agg, const BoundingSphere3f& newval) {
@@ -396,17 +397,17 @@ void CBRLocationServiceCache::processBoundsUpdated(const UUID& uuid, bool agg, c
     ObjectDataMap::iterator it = mObjects.find(uuid);
     if (it == mObjects.end()) return;
 
-    it->second.bounds = newval;
+    it->second->bounds = newval;
 
-    BoundingSphere3f old_region = it->second.region;
-    it->second.region = BoundingSphere3f(newval.center(), 0.f);
-    float32 old_maxSize = it->second.maxSize;
-    it->second.maxSize = newval.radius();
+    BoundingSphere3f old_region = it->second->region;
+    it->second->region = BoundingSphere3f(newval.center(), 0.f);
+    float32 old_maxSize = it->second->maxSize;
+    it->second->maxSize = newval.radius();
 
     if (!agg) {
         for(ListenerSet::iterator listen_it = mListeners.begin(); listen_it != mListeners.end(); listen_it++) {
-            (*listen_it)->locationRegionUpdated(uuid, old_region, it->second.region);
-            (*listen_it)->locationMaxSizeUpdated(uuid, old_maxSize, it->second.maxSize);
+            (*listen_it)->locationRegionUpdated(uuid, old_region, it->second->region);
+            (*listen_it)->locationMaxSizeUpdated(uuid, old_maxSize, it->second->maxSize);
         }
     }
 }
@@ -426,8 +427,8 @@ void CBRLocationServiceCache::processMeshUpdated(const UUID& uuid, bool agg, con
 
     ObjectDataMap::iterator it = mObjects.find(uuid);
     if (it == mObjects.end()) return;
-    String oldval = it->second.mesh;
-    it->second.mesh = newval;
+    String oldval = it->second->mesh;
+    it->second->mesh = newval;
 }
 
 void CBRLocationServiceCache::physicsUpdated(const UUID& uuid, bool agg, const String& newval) {
@@ -445,14 +446,15 @@ void CBRLocationServiceCache::processPhysicsUpdated(const UUID& uuid, bool agg,
 
     ObjectDataMap::iterator it = mObjects.find(uuid);
     if (it == mObjects.end()) return;
-    String oldval = it->second.physics;
-    it->second.physics = newval;
+    String oldval = it->second->physics;
+    it->second->physics = newval;
 }
 
 bool CBRLocationServiceCache::tryRemoveObject(ObjectDataMap::iterator& obj_it) {
-    if (obj_it->second.tracking > 0  || obj_it->second.exists)
+    if (obj_it->second->tracking > 0  || obj_it->second->exists)
         return false;
 
+    delete obj_it->second;
     mObjects.erase(obj_it);
     return true;
 }
@@ -35,6 +35,7 @@
 
 #include "ProxSimulationTraits.hpp"
 #include <sirikata/space/LocationService.hpp>
+#include <sirikata/core/util/UUIDFlatMap.hpp>
 #include <prox/base/LocationServiceCache.hpp>
 #include <prox/base/ZernikeDescriptor.hpp>
 
@@ -164,21 +165,23 @@ private:
     typedef std::set<LocationUpdateListener*> ListenerSet;
     ListenerSet mListeners;
 
-    typedef std::tr1::unordered_map<UUID, ObjectData, UUID::Hasher> ObjectDataMap;
+    // ObjectData is allocated separately so Iterators can keep pointing at it
+    // as other objects are added.
+    typedef UUIDFlatMap<ObjectData*> ObjectDataMap;
     ObjectDataMap mObjects;
     bool mWithReplicas;
 
     bool tryRemoveObject(ObjectDataMap::iterator& obj_it);
 
     // Data contained in our Iterators. We maintain both the UUID and the
-    // iterator because the iterator can become invalidated due to ordering of
+    // data because the data can become invalidated due to ordering of
     // events in the prox thread.
     struct IteratorData {
-        IteratorData(const UUID& _objid, ObjectDataMap::iterator _it)
-         : objid(_objid), it(_it) {}
+        IteratorData(const UUID& _objid, ObjectData* _data)
+         : objid(_objid), data(_data) {}
 
         const UUID objid;
-        ObjectDataMap::iterator it;
+        ObjectData* data;
     };
 
 };
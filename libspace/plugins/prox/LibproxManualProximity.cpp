@@ -93,10 +93,9 @@ std::string LibproxManualProximity::migrationClientTag() {
     return "prox";
 }
 
-std::string LibproxManualProximity::generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server) {
+void LibproxManualProximity::generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, MigrationDataWriter& out) {
     // There shouldn't be any object data to move since we only manage
     // ObjectHost queries
-    return "";
 }
 
 void LibproxManualProximity::receiveMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, const std::string& data) {
@@ -48,7 +48,7 @@ public:
 
     // MigrationDataClient Interface
     virtual std::string migrationClientTag();
-    virtual std::string generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server);
+    virtual void generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, MigrationDataWriter& out);
     virtual void receiveMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, const std::string& data);
 
     // ObjectHostSessionListener Interface
@@ -360,10 +360,10 @@ std::string LibproxProximity::migrationClientTag() {
     return "prox";
 }
 
-std::string LibproxProximity::generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server) {
+void LibproxProximity::generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, MigrationDataWriter& out) {
     ObjectQueryAngleMap::iterator it = mObjectQueryAngles.find(obj);
-    if (it == mObjectQueryAngles.end()) // no query registered, return nothing
-        return std::string();
+    if (it == mObjectQueryAngles.end()) // no query registered, write nothing
+        return;
     else {
         SolidAngle query_angle = it->second;
         removeQuery(obj);
@@ -372,7 +372,7 @@ std::string LibproxProximity::generateMigrationData(const UUID& obj, ServerID so
         migr_data.set_min_angle( query_angle.asFloat() );
         if (mObjectQueryMaxCounts.find(obj) != mObjectQueryMaxCounts.end())
             migr_data.set_max_count( mObjectQueryMaxCounts[obj] );
-        return serializePBJMessage(migr_data);
+        out.writeMessage(migr_data);
     }
 }
 
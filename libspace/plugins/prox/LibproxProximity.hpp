@@ -34,6 +34,7 @@
 #define _SIRIKATA_LIBPROX_PROXIMITY_HPP_
 
 #include "LibproxProximityBase.hpp"
+#include <sirikata/core/util/UUIDFlatMap.hpp>
 #include "ProxSimulationTraits.hpp"
 #include <prox/geom/QueryHandler.hpp>
 #include <prox/base/LocationUpdateListener.hpp>
@@ -101,7 +102,7 @@ public:
 
     // MigrationDataClient Interface
     virtual std::string migrationClientTag();
-    virtual std::string generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server);
+    virtual void generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, MigrationDataWriter& out);
     virtual void receiveMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, const std::string& data);
 
     // PintoServerQuerierListener Interface
@@ -199,7 +200,7 @@ private:
     typedef std::set<UUID> ObjectSet;
     typedef std::tr1::unordered_map<ServerID, Query*> ServerQueryMap;
     typedef std::tr1::unordered_map<Query*, ServerID> InvertedServerQueryMap;
-    typedef std::tr1::unordered_map<UUID, Query*, UUID::Hasher> ObjectQueryMap;
+    typedef UUIDFlatMap<Query*> ObjectQueryMap;
     typedef std::tr1::unordered_set<Query*> FirstIterationObjectSet;
     typedef std::tr1::unordered_map<Query*, UUID> InvertedObjectQueryMap;
 
@@ -87,6 +87,12 @@ struct RedisObjectMigratedOperationInfo {
     UUID obj;
     ServerID ackTo;
 };
+// A group of migrated objects written with a single MSET
+struct RedisObjectsMigratedOperationInfo {
+    RedisObjectSegmentation* oseg;
+    std::vector<UUID> objs;
+    ServerID ackTo;
+};
 
 void globalRedisLookupObjectReadFinished(redisAsyncContext* c, void* _reply, void* privdata) {
     redisReply *reply = (redisReply*)_reply;
@@ -178,6 +184,27 @@ void globalRedisAddMigratedObjectWriteFinished(redisAsyncContext* c, void* _repl
     delete wi;
 }
 
+void globalRedisAddMigratedObjectsWriteFinished(redisAsyncContext* c, void* _reply, void* privdata) {
+    redisReply *reply = (redisReply*)_reply;
+    RedisObjectsMigratedOperationInfo* wi = (RedisObjectsMigratedOperationInfo*)privdata;
+
+    if (reply == NULL) {
+        REDISOSEG_LOG(error, "Unknown redis error when writing " << wi->objs.size() << " migrated objects");
+    }
+    else if (reply->type == REDIS_REPLY_STATUS && String(reply->str, reply->len) == String("OK")) {
+        for(std::vector<UUID>::iterator it = wi->objs.begin(); it != wi->objs.end(); it++)
+            wi->oseg->finishWriteMigratedObject(*it, wi->ackTo);
+    }
+    else if (reply->type == REDIS_REPLY_ERROR || reply->type == REDIS_REPLY_STATUS) {
+        REDISOSEG_LOG(error, "Redis error when writing " << wi->objs.size() << " migrated objects: " << String(reply->str, reply->len));
+    }
+    else {
+        REDISOSEG_LOG(error, "Unexpected redis reply type when writing " << wi->objs.size() << " migrated objects: " << reply->type);
+    }
+
+    delete wi;
+}
+
 void globalRedisDeleteFinished(redisAsyncContext* c, void* _reply, void* privdata) {
     redisReply *reply = (redisReply*)_reply;
     RedisObjectOperationInfo* wi = (RedisObjectOperationInfo*)privdata;
@@ -444,6 +471,39 @@ void RedisObjectSegmentation::addMigratedObject(const UUID& obj_id, float radius
     redisAsyncCommand(mRedisContext, globalRedisAddMigratedObjectWriteFinished, wi, "SET %s%s %b", mRedisPrefix.c_str(), obj_id.toString().c_str(), valstr.c_str(), valstr.size());
 }
 
+void RedisObjectSegmentation::addMigratedObjects(const OSegEntryList& objects, ServerID idServerAckTo, bool generateAck) {
+    if (mStopping || objects.empty()) return;
+
+    RedisObjectsMigratedOperationInfo* wi = new RedisObjectsMigratedOperationInfo();
+    wi->oseg = this;
+    wi->ackTo = (generateAck ? idServerAckTo : NullServerID);
+
+    // Commit the whole group with one MSET instead of a SET per object
+    std::vector<String> args;
+    args.reserve(1 + 2*objects.size());
+    args.push_back("MSET");
+    for(OSegEntryList::const_iterator it = objects.begin(); it != objects.end(); it++) {
+        const UUID& obj_id = it->first;
+        mOSeg[obj_id] = OSegEntry(mContext->id(), it->second.radius());
+        wi->objs.push_back(obj_id);
+
+        std::ostringstream os;
+        os << mContext->id() << ":" << it->second.radius();
+        args.push_back(mRedisPrefix + obj_id.toString());
+        args.push_back(os.str());
+    }
+    std::vector<const char*> argv(args.size());
+    std::vector<size_t> argvlen(args.size());
+    for(size_t i = 0; i < args.size(); i++) {
+        argv[i] = args[i].c_str();
+        argvlen[i] = args[i].size();
+    }
+
+    REDISOSEG_LOG(insane, "MSET " << objects.size() << " migrated objects");
+    ensureConnected();
+    redisAsyncCommandArgv(mRedisContext, globalRedisAddMigratedObjectsWriteFinished, wi, (int)argv.size(), &argv[0], &argvlen[0]);
+}
+
 void RedisObjectSegmentation::finishWriteMigratedObject(const UUID& obj_id, ServerID ackTo) {
     REDISOSEG_LOG(detailed, "Finished writing OSEG entry for migrated object " << obj_id.toString());
     if (mStopping) return;
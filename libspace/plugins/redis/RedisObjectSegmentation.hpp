@@ -34,6 +34,7 @@
 #define _SIRIKATA_REDIS_OBJECT_SEGMENTATION_HPP_
 
 #include <sirikata/space/ObjectSegmentation.hpp>
+#include <sirikata/core/util/UUIDFlatMap.hpp>
 #include <hiredis/async.h>
 
 namespace Sirikata {
@@ -50,6 +51,7 @@ public:
 
     virtual void addNewObject(const UUID& obj_id, float radius);
     virtual void addMigratedObject(const UUID& obj_id, float radius, ServerID idServerAckTo, bool);
+    virtual void addMigratedObjects(const OSegEntryList& objects, ServerID idServerAckTo, bool);
     virtual void removeObject(const UUID& obj_id);
 
     virtual bool clearToMigrate(const UUID& obj_id);
@@ -88,7 +90,7 @@ private:
     CoordinateSegmentation* mCSeg;
     OSegCache* mCache;
 
-    typedef std::tr1::unordered_map<UUID, OSegEntry, UUID::Hasher> OSegMap;
+    typedef UUIDFlatMap<OSegEntry> OSegMap;
     OSegMap mOSeg;
 
     String mRedisHost;
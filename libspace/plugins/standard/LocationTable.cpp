@@ -0,0 +1,168 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "LocationTable.hpp"
+
+namespace Sirikata {
+
+StringInterner::ID StringInterner::intern(const String& str) {
+    IndexMap::iterator it = mIndex.find(&str);
+    if (it != mIndex.end()) {
+        mRefCounts[it->second]++;
+        return it->second;
+    }
+
+    ID id;
+    if (!mFreeIDs.empty()) {
+        id = mFreeIDs.back();
+        mFreeIDs.pop_back();
+        mStrings[id] = str;
+        mRefCounts[id] = 1;
+    }
+    else {
+        id = (ID)mStrings.size();
+        mStrings.push_back(str);
+        mRefCounts.push_back(1);
+    }
+    mIndex[&mStrings[id]] = id;
+    return id;
+}
+
+void StringInterner::release(ID id) {
+    assert(mRefCounts[id] > 0);
+    if (--mRefCounts[id] > 0)
+        return;
+    mIndex.erase(&mStrings[id]);
+    // Free the memory, the slot will be reused for another string
+    String().swap(mStrings[id]);
+    mFreeIDs.push_back(id);
+}
+
+
+const LocationTable::Slot LocationTable::NullSlot = (LocationTable::Slot)-1;
+
+LocationTable::LocationTable() {
+}
+
+LocationTable::~LocationTable() {
+}
+
+LocationTable::Slot LocationTable::find(const UUID& uuid) const {
+    SlotMap::const_iterator it = mSlots.find(uuid);
+    if (it == mSlots.end())
+        return NullSlot;
+    return it->second;
+}
+
+LocationTable::Slot LocationTable::insert(const UUID& uuid, uint8 flags, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics) {
+    assert(mSlots.find(uuid) == mSlots.end());
+
+    Slot slot;
+    if (!mFreeSlots.empty()) {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+        mIDs[slot] = uuid;
+    }
+    else {
+        slot = (Slot)mIDs.size();
+        mIDs.push_back(uuid);
+        mFlags.push_back(0);
+        mLocations.push_back(loc);
+        mOrientations.push_back(orient);
+        mBounds.push_back(bounds);
+        // Placeholders for reset() to release
+        mMeshes.push_back(mStrings.intern(String()));
+        mPhysics.push_back(mStrings.intern(String()));
+        mSeqNos.push_back(SeqNos());
+    }
+    mSlots[uuid] = slot;
+
+    reset(slot, flags, loc, orient, bounds, mesh, physics);
+    return slot;
+}
+
+void LocationTable::reset(Slot slot, uint8 flags, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics) {
+    mFlags[slot] = flags;
+    mLocations[slot] = loc;
+    mOrientations[slot] = orient;
+    mBounds[slot] = bounds;
+    // Intern before releasing so an unchanged string isn't dropped and
+    // re-added
+    StringInterner::ID old_mesh = mMeshes[slot], old_phy = mPhysics[slot];
+    mMeshes[slot] = mStrings.intern(mesh);
+    mPhysics[slot] = mStrings.intern(physics);
+    mStrings.release(old_mesh);
+    mStrings.release(old_phy);
+    std::fill(mSeqNos[slot].part, mSeqNos[slot].part + NUM_PARTS, 0);
+}
+
+void LocationTable::erase(Slot slot) {
+    SlotMap::iterator it = mSlots.find(mIDs[slot]);
+    assert(it != mSlots.end() && it->second == slot);
+    mSlots.erase(it);
+
+    // Free slots hold the empty string so there's always something valid to
+    // release when they're reused.
+    mStrings.release(mMeshes[slot]);
+    mMeshes[slot] = mStrings.intern(String());
+    mStrings.release(mPhysics[slot]);
+    mPhysics[slot] = mStrings.intern(String());
+    mIDs[slot] = UUID::null();
+    mFlags[slot] = 0;
+    mFreeSlots.push_back(slot);
+}
+
+uint64 LocationTable::maxSeqNo(Slot slot) const {
+    const SeqNos& seqnos = mSeqNos[slot];
+    return *std::max_element(seqnos.part, seqnos.part + NUM_PARTS);
+}
+
+bool LocationTable::acceptSeqNo(Slot slot, Parts part, uint64 seqno) {
+    uint64& cur = mSeqNos[slot].part[part];
+    if (seqno < cur)
+        return false;
+    cur = seqno;
+    return true;
+}
+
+bool LocationTable::setLocation(Slot slot, const TimedMotionVector3f& loc, uint64 seqno) {
+    if (!acceptSeqNo(slot, LOCATION_PART, seqno))
+        return false;
+    mLocations[slot] = loc;
+    return true;
+}
+
+bool LocationTable::setOrientation(Slot slot, const TimedMotionQuaternion& orient, uint64 seqno) {
+    if (!acceptSeqNo(slot, ORIENTATION_PART, seqno))
+        return false;
+    mOrientations[slot] = orient;
+    return true;
+}
+
+bool LocationTable::setBounds(Slot slot, const BoundingSphere3f& bounds, uint64 seqno) {
+    if (!acceptSeqNo(slot, BOUNDS_PART, seqno))
+        return false;
+    mBounds[slot] = bounds;
+    return true;
+}
+
+bool LocationTable::setMesh(Slot slot, const String& mesh, uint64 seqno) {
+    if (!acceptSeqNo(slot, MESH_PART, seqno))
+        return false;
+    StringInterner::ID old_mesh = mMeshes[slot];
+    mMeshes[slot] = mStrings.intern(mesh);
+    mStrings.release(old_mesh);
+    return true;
+}
+
+bool LocationTable::setPhysics(Slot slot, const String& physics, uint64 seqno) {
+    if (!acceptSeqNo(slot, PHYSICS_PART, seqno))
+        return false;
+    StringInterner::ID old_phy = mPhysics[slot];
+    mPhysics[slot] = mStrings.intern(physics);
+    mStrings.release(old_phy);
+    return true;
+}
+
+} // namespace Sirikata
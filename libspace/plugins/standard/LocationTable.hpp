@@ -0,0 +1,138 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_STANDARD_LOCATION_TABLE_HPP_
+#define _SIRIKATA_STANDARD_LOCATION_TABLE_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/UUID.hpp>
+#include <sirikata/core/util/MotionVector.hpp>
+#include <sirikata/core/util/MotionQuaternion.hpp>
+#include <sirikata/core/util/BoundingSphere.hpp>
+
+namespace Sirikata {
+
+/** Keeps one copy of each distinct string and hands out small integer IDs for
+ *  them. Strings are reference counted and their IDs are reused once the last
+ *  reference is released. References returned by get() remain valid until
+ *  then.
+ */
+class StringInterner {
+public:
+    typedef uint32 ID;
+
+    ID intern(const String& str);
+    void release(ID id);
+
+    const String& get(ID id) const { return mStrings[id]; }
+    // Number of distinct strings currently held
+    size_t size() const { return mIndex.size(); }
+
+private:
+    // The index refers to the strings stored in mStrings rather than keeping
+    // its own copies of them
+    struct StringPtrHash {
+        size_t operator()(const String* str) const {
+            return std::tr1::hash<String>()(*str);
+        }
+    };
+    struct StringPtrEquals {
+        bool operator()(const String* lhs, const String* rhs) const {
+            return *lhs == *rhs;
+        }
+    };
+    typedef std::tr1::unordered_map<const String*, ID, StringPtrHash, StringPtrEquals> IndexMap;
+    IndexMap mIndex;
+    // deque so references stay valid as strings are added
+    std::deque<String> mStrings;
+    std::vector<uint32> mRefCounts;
+    std::vector<ID> mFreeIDs;
+};
+
+/** Storage for StandardLocationService. Each object gets a slot and each
+ *  property is kept in its own dense array indexed by slot, so scans over one
+ *  property touch only that property's memory, and adding or removing objects
+ *  just reuses slots instead of allocating. Mesh and physics strings, which
+ *  are usually shared by many objects, are interned.
+ *
+ *  Each property has a sequence number. Setters ignore (and return false for)
+ *  values older than the current one, like SequencedPresenceProperties.
+ */
+class LocationTable {
+public:
+    typedef uint32 Slot;
+    static const Slot NullSlot;
+
+    enum Flags {
+        LOCAL = 0x01,
+        AGGREGATE = 0x02
+    };
+
+    LocationTable();
+    ~LocationTable();
+
+    Slot find(const UUID& uuid) const;
+    /** Allocates a slot for uuid, which must not already have one. */
+    Slot insert(const UUID& uuid, uint8 flags, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics);
+    /** Replaces all the data in a slot, resetting sequence numbers. */
+    void reset(Slot slot, uint8 flags, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics);
+    void erase(Slot slot);
+
+    size_t size() const { return mSlots.size(); }
+    // Number of allocated slots, including free ones
+    size_t capacity() const { return mIDs.size(); }
+    size_t distinctStrings() const { return mStrings.size(); }
+
+    const UUID& id(Slot slot) const { return mIDs[slot]; }
+    uint8 flags(Slot slot) const { return mFlags[slot]; }
+    uint64 maxSeqNo(Slot slot) const;
+
+    const TimedMotionVector3f& location(Slot slot) const { return mLocations[slot]; }
+    const TimedMotionQuaternion& orientation(Slot slot) const { return mOrientations[slot]; }
+    const BoundingSphere3f& bounds(Slot slot) const { return mBounds[slot]; }
+    const String& mesh(Slot slot) const { return mStrings.get(mMeshes[slot]); }
+    const String& physics(Slot slot) const { return mStrings.get(mPhysics[slot]); }
+
+    bool setLocation(Slot slot, const TimedMotionVector3f& loc, uint64 seqno);
+    bool setOrientation(Slot slot, const TimedMotionQuaternion& orient, uint64 seqno);
+    bool setBounds(Slot slot, const BoundingSphere3f& bounds, uint64 seqno);
+    bool setMesh(Slot slot, const String& mesh, uint64 seqno);
+    bool setPhysics(Slot slot, const String& physics, uint64 seqno);
+
+private:
+    enum Parts {
+        LOCATION_PART = 0,
+        ORIENTATION_PART,
+        BOUNDS_PART,
+        MESH_PART,
+        PHYSICS_PART,
+        NUM_PARTS
+    };
+    struct SeqNos {
+        uint64 part[NUM_PARTS];
+    };
+
+    // Checks seqno against the current sequence number for the part,
+    // recording it if it isn't out of date.
+    bool acceptSeqNo(Slot slot, Parts part, uint64 seqno);
+
+    typedef std::tr1::unordered_map<UUID, Slot, UUID::Hasher> SlotMap;
+    SlotMap mSlots;
+    std::vector<Slot> mFreeSlots;
+
+    std::vector<UUID> mIDs;
+    std::vector<uint8> mFlags;
+    std::vector<TimedMotionVector3f> mLocations;
+    std::vector<TimedMotionQuaternion> mOrientations;
+    std::vector<BoundingSphere3f> mBounds;
+    std::vector<StringInterner::ID> mMeshes;
+    std::vector<StringInterner::ID> mPhysics;
+    std::vector<SeqNos> mSeqNos;
+
+    StringInterner mStrings;
+}; // class LocationTable
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_STANDARD_LOCATION_TABLE_HPP_
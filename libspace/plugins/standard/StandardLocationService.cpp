@@ -32,27 +32,38 @@
 
 #include "StandardLocationService.hpp"
 #include <sirikata/core/trace/Trace.hpp>
+#include <sirikata/core/transfer/URI.hpp>
 
 #include "Protocol_Loc.pbj.hpp"
 
 namespace Sirikata {
 
+
+namespace {
+// Meshes were historically stored as URIs, so keep returning them in the
+// form URI normalizes them to.
+String meshString(const String& msh) {
+    return Transfer::URI(msh).toString();
+}
+}
+
 StandardLocationService::StandardLocationService(SpaceContext* ctx, LocationUpdatePolicy* update_policy)
  : LocationService(ctx, update_policy)
 {
 }
 
 bool StandardLocationService::contains(const UUID& uuid) const {
-    return (mLocations.find(uuid) != mLocations.end());
+    return (mObjects.find(uuid) != LocationTable::NullSlot);
 }
 
 LocationService::TrackingType StandardLocationService::type(const UUID& uuid) const {
-    LocationMap::const_iterator it = mLocations.find(uuid);
-    if (it == mLocations.end())
+    LocationTable::Slot slot = mObjects.find(uuid);
+    if (slot == LocationTable::NullSlot)
         return NotTracking;
-    if (it->second.aggregate)
+    uint8 flags = mObjects.flags(slot);
+    if (flags & LocationTable::AGGREGATE)
         return Aggregate;
-    if (it->second.local)
+    if (flags & LocationTable::LOCAL)
         return Local;
     return Replica;
 }
@@ -63,19 +74,15 @@ void StandardLocationService::service() {
 }
 
 uint64 StandardLocationService::epoch(const UUID& uuid) {
-    LocationMap::iterator it = mLocations.find(uuid);
-    assert(it != mLocations.end());
-
-    LocationInfo locinfo = it->second;
-    return locinfo.props.maxSeqNo();
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert(slot != LocationTable::NullSlot);
+    return mObjects.maxSeqNo(slot);
 }
 
 TimedMotionVector3f StandardLocationService::location(const UUID& uuid) {
-    LocationMap::iterator it = mLocations.find(uuid);
-    assert(it != mLocations.end());
-
-    LocationInfo locinfo = it->second;
-    return locinfo.props.location();
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert(slot != LocationTable::NullSlot);
+    return mObjects.location(slot);
 }
 
 Vector3f StandardLocationService::currentPosition(const UUID& uuid) {
@@ -85,11 +92,9 @@ Vector3f StandardLocationService::currentPosition(const UUID& uuid) {
 }
 
 TimedMotionQuaternion StandardLocationService::orientation(const UUID& uuid) {
-    LocationMap::iterator it = mLocations.find(uuid);
-    assert(it != mLocations.end());
-
-    LocationInfo locinfo = it->second;
-    return locinfo.props.orientation();
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert(slot != LocationTable::NullSlot);
+    return mObjects.orientation(slot);
 }
 
 Quaternion StandardLocationService::currentOrientation(const UUID& uuid) {
@@ -98,69 +103,50 @@ Quaternion StandardLocationService::currentOrientation(const UUID& uuid) {
 }
 
 BoundingSphere3f StandardLocationService::bounds(const UUID& uuid) {
-    LocationMap::iterator it = mLocations.find(uuid);
-    assert(it != mLocations.end());
-
-    LocationInfo locinfo = it->second;
-    return locinfo.props.bounds();
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert(slot != LocationTable::NullSlot);
+    return mObjects.bounds(slot);
 }
 
 const String& StandardLocationService::mesh(const UUID& uuid) {
-    LocationMap::iterator it = mLocations.find(uuid);
-    assert(it != mLocations.end());
-
-    LocationInfo& locinfo = it->second;
-    locinfo.mesh_copied_str = locinfo.props.mesh().toString();
-    return locinfo.mesh_copied_str;
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert(slot != LocationTable::NullSlot);
+    return mObjects.mesh(slot);
 }
 
 const String& StandardLocationService::physics(const UUID& uuid) {
-    LocationMap::iterator it = mLocations.find(uuid);
-    assert(it != mLocations.end());
-
-    LocationInfo& locinfo = it->second;
-    locinfo.physics_copied_str = locinfo.props.physics();
-    return locinfo.physics_copied_str;
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert(slot != LocationTable::NullSlot);
+    return mObjects.physics(slot);
 }
 
   void StandardLocationService::addLocalObject(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bnds, const String& msh, const String& phy, const String& zernike) {
-    LocationMap::iterator it = mLocations.find(uuid);
+    LocationTable::Slot slot = mObjects.find(uuid);
 
     // Add or update the information to the cache
-    if (it == mLocations.end()) {
-        mLocations[uuid] = LocationInfo();
-        it = mLocations.find(uuid);
+    if (slot == LocationTable::NullSlot) {
+        slot = mObjects.insert(uuid, LocationTable::LOCAL, loc, orient, bnds, meshString(msh), phy);
     } else {
         // It was already in there as a replica, notify its removal
-        assert(it->second.local == false);
+        assert((mObjects.flags(slot) & LocationTable::LOCAL) == 0);
         CONTEXT_SPACETRACE(serverObjectEvent, 0, mContext->id(), uuid, false, TimedMotionVector3f()); // FIXME remote server ID
         notifyReplicaObjectRemoved(uuid);
+        mObjects.reset(slot, LocationTable::LOCAL, loc, orient, bnds, meshString(msh), phy);
     }
 
-    LocationInfo& locinfo = it->second;
-    locinfo.props.reset();
-    locinfo.props.setLocation(loc, 0);
-    locinfo.props.setOrientation(orient, 0);
-    locinfo.props.setBounds(bnds, 0);
-    locinfo.props.setMesh(Transfer::URI(msh), 0);
-    locinfo.props.setPhysics(phy, 0);
-    locinfo.local = true;
-    locinfo.aggregate = false;
-
     // FIXME: we might want to verify that location(uuid) and bounds(uuid) are
     // reasonable compared to the loc and bounds passed in
 
     // Add to the list of local objects
     CONTEXT_SPACETRACE(serverObjectEvent, mContext->id(), mContext->id(), uuid, true, loc);
-    notifyLocalObjectAdded(uuid, false, location(uuid), orientation(uuid), bounds(uuid), mesh(uuid), physics(uuid), zernike);
+    notifyLocalObjectAdded(uuid, false, mObjects.location(slot), mObjects.orientation(slot), mObjects.bounds(slot), mObjects.mesh(slot), mObjects.physics(slot), zernike);
 }
 
 void StandardLocationService::removeLocalObject(const UUID& uuid) {
-    // Remove from mLocations, but save the cached state
-    assert( mLocations.find(uuid) != mLocations.end() );
-    assert( mLocations[uuid].local == true );
-    assert( mLocations[uuid].aggregate == false );
-    mLocations.erase(uuid);
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert( slot != LocationTable::NullSlot );
+    assert( mObjects.flags(slot) == LocationTable::LOCAL );
+    mObjects.erase(slot);
 
     // Remove from the list of local objects
     CONTEXT_SPACETRACE(serverObjectEvent, mContext->id(), mContext->id(), uuid, false, TimedMotionVector3f());
@@ -176,125 +162,94 @@ void StandardLocationService::addLocalAggregateObject(const UUID& uuid, const Ti
     // Aggregates get randomly assigned IDs -- if there's a conflict either we
     // got a true conflict (incredibly unlikely) or somebody (prox/query
     // handler) screwed up.
-    assert(mLocations.find(uuid) == mLocations.end());
+    assert(mObjects.find(uuid) == LocationTable::NullSlot);
 
-    mLocations[uuid] = LocationInfo();
-    LocationMap::iterator it = mLocations.find(uuid);
-
-    LocationInfo& locinfo = it->second;
-    locinfo.props.reset();
-    locinfo.props.setLocation(loc, 0);
-    locinfo.props.setOrientation(orient, 0);
-    locinfo.props.setBounds(bnds, 0);
-    locinfo.props.setMesh(Transfer::URI(msh), 0);
-    locinfo.props.setPhysics(phy, 0);
-
-    locinfo.local = true;
-    locinfo.aggregate = true;
+    LocationTable::Slot slot = mObjects.insert(uuid, LocationTable::LOCAL | LocationTable::AGGREGATE, loc, orient, bnds, meshString(msh), phy);
 
     // Add to the list of local objects
-    notifyLocalObjectAdded(uuid, true, location(uuid), orientation(uuid), bounds(uuid), mesh(uuid), physics(uuid), "");
+    notifyLocalObjectAdded(uuid, true, mObjects.location(slot), mObjects.orientation(slot), mObjects.bounds(slot), mObjects.mesh(slot), mObjects.physics(slot), "");
 }
 
 void StandardLocationService::removeLocalAggregateObject(const UUID& uuid) {
-    // Remove from mLocations, but save the cached state
-    assert( mLocations.find(uuid) != mLocations.end() );
-    assert( mLocations[uuid].local == true );
-    assert( mLocations[uuid].aggregate == true );
-    mLocations.erase(uuid);
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert( slot != LocationTable::NullSlot );
+    assert( mObjects.flags(slot) == (LocationTable::LOCAL | LocationTable::AGGREGATE) );
+    mObjects.erase(slot);
 
     notifyLocalObjectRemoved(uuid, true);
 }
 
 void StandardLocationService::updateLocalAggregateLocation(const UUID& uuid, const TimedMotionVector3f& newval) {
-    LocationMap::iterator loc_it = mLocations.find(uuid);
-    assert(loc_it != mLocations.end());
-    assert(loc_it->second.aggregate == true);
-    loc_it->second.props.setLocation(newval, 0);
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert(slot != LocationTable::NullSlot);
+    assert(mObjects.flags(slot) & LocationTable::AGGREGATE);
+    mObjects.setLocation(slot, newval, 0);
     notifyLocalLocationUpdated( uuid, true, newval );
 }
 void StandardLocationService::updateLocalAggregateOrientation(const UUID& uuid, const TimedMotionQuaternion& newval) {
-    LocationMap::iterator loc_it = mLocations.find(uuid);
-    assert(loc_it != mLocations.end());
-    assert(loc_it->second.aggregate == true);
-    loc_it->second.props.setOrientation(newval, 0);
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert(slot != LocationTable::NullSlot);
+    assert(mObjects.flags(slot) & LocationTable::AGGREGATE);
+    mObjects.setOrientation(slot, newval, 0);
     notifyLocalOrientationUpdated( uuid, true, newval );
 }
 void StandardLocationService::updateLocalAggregateBounds(const UUID& uuid, const BoundingSphere3f& newval) {
-    LocationMap::iterator loc_it = mLocations.find(uuid);
-    assert(loc_it != mLocations.end());
-    assert(loc_it->second.aggregate == true);
-    loc_it->second.props.setBounds(newval);
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert(slot != LocationTable::NullSlot);
+    assert(mObjects.flags(slot) & LocationTable::AGGREGATE);
+    mObjects.setBounds(slot, newval, 0);
     notifyLocalBoundsUpdated( uuid, true, newval );
 }
 void StandardLocationService::updateLocalAggregateMesh(const UUID& uuid, const String& newval) {
-    LocationMap::iterator loc_it = mLocations.find(uuid);
-    assert(loc_it != mLocations.end());
-    assert(loc_it->second.aggregate == true);
-    loc_it->second.props.setMesh(Transfer::URI(newval));
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert(slot != LocationTable::NullSlot);
+    assert(mObjects.flags(slot) & LocationTable::AGGREGATE);
+    mObjects.setMesh(slot, meshString(newval), 0);
     notifyLocalMeshUpdated( uuid, true, newval );
 }
 void StandardLocationService::updateLocalAggregatePhysics(const UUID& uuid, const String& newval) {
-    LocationMap::iterator loc_it = mLocations.find(uuid);
-    assert(loc_it != mLocations.end());
-    assert(loc_it->second.aggregate == true);
-    loc_it->second.props.setPhysics(newval, 0);
+    LocationTable::Slot slot = mObjects.find(uuid);
+    assert(slot != LocationTable::NullSlot);
+    assert(mObjects.flags(slot) & LocationTable::AGGREGATE);
+    mObjects.setPhysics(slot, newval, 0);
     notifyLocalPhysicsUpdated( uuid, true, newval );
 }
 
   void StandardLocationService::addReplicaObject(const Time& t, const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bnds, const String& msh, const String& phy, const String& zernike) {
     // FIXME we should do checks on timestamps to decide which setting is "more" sane
-    LocationMap::iterator it = mLocations.find(uuid);
+    LocationTable::Slot slot = mObjects.find(uuid);
 
-    if (it != mLocations.end()) {
+    if (slot != LocationTable::NullSlot) {
         // It already exists. If its local, ignore the update. If its another replica, somethings out of sync, but perform the update anyway
-        LocationInfo& locinfo = it->second;
-        if (!locinfo.local) {
-            locinfo.props.reset();
-            locinfo.props.setLocation(loc, 0);
-            locinfo.props.setOrientation(orient, 0);
-            locinfo.props.setBounds(bnds, 0);
-            locinfo.props.setMesh(Transfer::URI(msh), 0);
-            locinfo.props.setPhysics(phy, 0);
-
-            //local = false
+        if ((mObjects.flags(slot) & LocationTable::LOCAL) == 0) {
+            mObjects.reset(slot, 0, loc, orient, bnds, meshString(msh), phy);
             // FIXME should we notify location and bounds updated info?
         }
         // else ignore
     }
     else {
         // Its a new replica, just insert it
-        LocationInfo locinfo;
-        locinfo.props.reset();
-        locinfo.props.setLocation(loc, 0);
-        locinfo.props.setOrientation(orient, 0);
-        locinfo.props.setBounds(bnds, 0);
-        locinfo.props.setMesh(Transfer::URI(msh), 0);
-        locinfo.props.setPhysics(phy, 0);
-        locinfo.local = false;
-        locinfo.aggregate = false;
-        mLocations[uuid] = locinfo;
+        slot = mObjects.insert(uuid, 0, loc, orient, bnds, meshString(msh), phy);
 
         // We only run this notification when the object actually is new
         CONTEXT_SPACETRACE(serverObjectEvent, 0, mContext->id(), uuid, true, loc); // FIXME add remote server ID
-        notifyReplicaObjectAdded(uuid, location(uuid), orientation(uuid), bounds(uuid), mesh(uuid), physics(uuid), zernike);
+        notifyReplicaObjectAdded(uuid, mObjects.location(slot), mObjects.orientation(slot), mObjects.bounds(slot), mObjects.mesh(slot), mObjects.physics(slot), zernike);
     }
 }
 
 void StandardLocationService::removeReplicaObject(const Time& t, const UUID& uuid) {
     // FIXME we should maintain some time information and check t against it to make sure this is sane
 
-    LocationMap::iterator it = mLocations.find(uuid);
-    if (it == mLocations.end())
+    LocationTable::Slot slot = mObjects.find(uuid);
+    if (slot == LocationTable::NullSlot)
         return;
 
     // If the object is marked as local, this is out of date information.  Just ignore it.
-    LocationInfo& locinfo = it->second;
-    if (locinfo.local)
+    if (mObjects.flags(slot) & LocationTable::LOCAL)
         return;
 
     // Otherwise, remove and notify
-    mLocations.erase(uuid);
+    mObjects.erase(slot);
     CONTEXT_SPACETRACE(serverObjectEvent, 0, mContext->id(), uuid, false, TimedMotionVector3f()); // FIXME add remote server ID
     notifyReplicaObjectRemoved(uuid);
 }
@@ -312,18 +267,10 @@ void StandardLocationService::receiveMessage(Message* msg) {
             // Its possible we'll get an out of date update. We only use this update
             // if (a) we have this object marked as a replica object and (b) we don't
             // have this object marked as a local object
-            if (type(update.object()) != Replica)
+            LocationTable::Slot slot = mObjects.find( update.object() );
+            if (slot == LocationTable::NullSlot || mObjects.flags(slot) != 0)
                 continue;
 
-            LocationMap::iterator loc_it = mLocations.find( update.object() );
-            // We can safely make this assertion right now because space server
-            // to space server loc and prox are on the same reliable channel. If
-            // this goes away then a) we can't make this assertion and b) we
-            // need an OrphanLocUpdateManager to save updates where this
-            // condition is false so they can be applied once the prox update
-            // arrives.
-            assert(loc_it != mLocations.end());
-
             uint64 epoch = 0;
             if (update.has_epoch())
                 epoch = update.epoch();
@@ -333,10 +280,10 @@ void StandardLocationService::receiveMessage(Message* msg) {
                     update.location().t(),
                     MotionVector3f( update.location().position(), update.location().velocity() )
                 );
-                loc_it->second.props.setLocation(newloc, epoch);
-                notifyReplicaLocationUpdated( update.object(), loc_it->second.props.location() );
+                mObjects.setLocation(slot, newloc, epoch);
+                notifyReplicaLocationUpdated( update.object(), mObjects.location(slot) );
 
-                CONTEXT_SPACETRACE(serverLoc, msg->source_server(), mContext->id(), update.object(), loc_it->second.props.location() );
+                CONTEXT_SPACETRACE(serverLoc, msg->source_server(), mContext->id(), update.object(), mObjects.location(slot) );
             }
 
             if (update.has_orientation()) {
@@ -344,26 +291,26 @@ void StandardLocationService::receiveMessage(Message* msg) {
                     update.orientation().t(),
                     MotionQuaternion( update.orientation().position(), update.orientation().velocity() )
                 );
-                loc_it->second.props.setOrientation(neworient, epoch);
-                notifyReplicaOrientationUpdated( update.object(), loc_it->second.props.orientation() );
+                mObjects.setOrientation(slot, neworient, epoch);
+                notifyReplicaOrientationUpdated( update.object(), mObjects.orientation(slot) );
             }
 
             if (update.has_bounds()) {
                 BoundingSphere3f newbounds = update.bounds();
-                loc_it->second.props.setBounds(newbounds, epoch);
-                notifyReplicaBoundsUpdated( update.object(), loc_it->second.props.bounds() );
+                mObjects.setBounds(slot, newbounds, epoch);
+                notifyReplicaBoundsUpdated( update.object(), mObjects.bounds(slot) );
             }
 
             if (update.has_mesh()) {
                 String newmesh = update.mesh();
-                loc_it->second.props.setMesh(Transfer::URI(newmesh), epoch);
-                notifyReplicaMeshUpdated( update.object(), loc_it->second.props.mesh().toString() );
+                mObjects.setMesh(slot, meshString(newmesh), epoch);
+                notifyReplicaMeshUpdated( update.object(), mObjects.mesh(slot) );
             }
 
             if (update.has_physics()) {
                 String newphy = update.physics();
-                loc_it->second.props.setPhysics(newphy, epoch);
-                notifyReplicaPhysicsUpdated( update.object(), loc_it->second.props.physics() );
+                mObjects.setPhysics(slot, newphy, epoch);
+                notifyReplicaPhysicsUpdated( update.object(), mObjects.physics(slot) );
             }
         }
     }
@@ -384,8 +331,9 @@ bool StandardLocationService::locationUpdate(UUID source, void* buffer, uint32 l
 
         TrackingType obj_type = type(source);
         if (obj_type == Local) {
-            LocationMap::iterator loc_it = mLocations.find( source );
-            assert(loc_it != mLocations.end());
+            LocationTable::Slot slot = mObjects.find( source );
+            assert(slot != LocationTable::NullSlot);
+            bool aggregate = (mObjects.flags(slot) & LocationTable::AGGREGATE) != 0;
 
             uint64 epoch = 0;
             if (request.has_epoch())
@@ -396,10 +344,10 @@ bool StandardLocationService::locationUpdate(UUID source, void* buffer, uint32 l
                     request.location().t(),
                     MotionVector3f( request.location().position(), request.location().velocity() )
                 );
-                loc_it->second.props.setLocation(newloc, epoch);
-                notifyLocalLocationUpdated( source, loc_it->second.aggregate, loc_it->second.props.location() );
+                mObjects.setLocation(slot, newloc, epoch);
+                notifyLocalLocationUpdated( source, aggregate, mObjects.location(slot) );
 
-                CONTEXT_SPACETRACE(serverLoc, mContext->id(), mContext->id(), source, loc_it->second.props.location() );
+                CONTEXT_SPACETRACE(serverLoc, mContext->id(), mContext->id(), source, mObjects.location(slot) );
             }
 
             if (request.has_orientation()) {
@@ -407,26 +355,26 @@ bool StandardLocationService::locationUpdate(UUID source, void* buffer, uint32 l
                     request.orientation().t(),
                     MotionQuaternion( request.orientation().position(), request.orientation().velocity() )
                 );
-                loc_it->second.props.setOrientation(neworient, epoch);
-                notifyLocalOrientationUpdated( source, loc_it->second.aggregate, loc_it->second.props.orientation() );
+                mObjects.setOrientation(slot, neworient, epoch);
+                notifyLocalOrientationUpdated( source, aggregate, mObjects.orientation(slot) );
             }
 
             if (request.has_bounds()) {
                 BoundingSphere3f newbounds = request.bounds();
-                loc_it->second.props.setBounds(newbounds, epoch);
-                notifyLocalBoundsUpdated( source, loc_it->second.aggregate, loc_it->second.props.bounds() );
+                mObjects.setBounds(slot, newbounds, epoch);
+                notifyLocalBoundsUpdated( source, aggregate, mObjects.bounds(slot) );
             }
 
             if (request.has_mesh()) {
                 String newmesh = request.mesh();
-                loc_it->second.props.setMesh(Transfer::URI(newmesh), epoch);
-                notifyLocalMeshUpdated( source, loc_it->second.aggregate, loc_it->second.props.mesh().toString() );
+                mObjects.setMesh(slot, meshString(newmesh), epoch);
+                notifyLocalMeshUpdated( source, aggregate, mObjects.mesh(slot) );
             }
 
             if (request.has_physics()) {
                 String newphy = request.physics();
-                loc_it->second.props.setPhysics(newphy, epoch);
-                notifyLocalPhysicsUpdated( source, loc_it->second.aggregate, loc_it->second.props.physics() );
+                mObjects.setPhysics(slot, newphy, epoch);
+                notifyLocalPhysicsUpdated( source, aggregate, mObjects.physics(slot) );
             }
 
         }
@@ -34,7 +34,7 @@
 #define _SIRIKATA_STANDARD_LOCATION_SERVICE_HPP_
 
 #include <sirikata/space/LocationService.hpp>
-#include <sirikata/core/util/PresenceProperties.hpp>
+#include "LocationTable.hpp"
 
 namespace Sirikata {
 
@@ -79,21 +79,7 @@ public:
     virtual bool locationUpdate(UUID source, void* buffer, uint32 length);
 
 private:
-    struct LocationInfo {
-        // Regular location info that we need to maintain for all objects
-        SequencedPresenceProperties props;
-        // NOTE: This is a copy of props.mesh(), which *is not always valid*. It's
-        // only used for the accessor, when returning by const& since we don't have
-        // a String version within props. DO NOT use anywhere else.
-        String mesh_copied_str;
-        String physics_copied_str;
-        
-        bool local;
-        bool aggregate;
-    };
-    typedef std::tr1::unordered_map<UUID, LocationInfo, UUID::Hasher> LocationMap;
-
-    LocationMap mLocations;
+    LocationTable mObjects;
 }; // class StandardLocationService
 
 } // namespace Sirikata
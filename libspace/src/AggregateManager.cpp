@@ -67,7 +67,12 @@ AggregateManager::AggregateManager(LocationService* loc, Transfer::OAuthParamsPt
     mAggregationService(new Network::IOService("AggregateManager")),
     mAggregationStrand(mAggregationService->createStrand("AggregateManager")),
     mIOWork(new Network::IOWork(mAggregationService, "Aggregation Work")),
+    mWorkerService(new Network::IOService("AggregateManager::Workers")),
+    mWorkerWork(new Network::IOWork(mWorkerService, "AggregateManager::Workers Work")),
     mLoc(loc),
+    // Aggregates are already generated in parallel by the worker threads, so
+    // each simplification runs on the worker that asked for it.
+    mMeshSimplifier(1),
     mOAuth(oauth),
     mCDNUsername(username),
     mModelTTL(Duration::minutes(60)),
@@ -90,6 +95,8 @@ AggregateManager::AggregateManager(LocationService* loc, Transfer::OAuthParamsPt
     names_and_args.push_back("center"); names_and_args.push_back("");
     mCenteringFilter = new Mesh::CompositeFilter(names_and_args);
 
+    mNumInFlight = 0;
+
     mTransferMediator = &(Transfer::TransferMediator::getSingleton());
 
     static char x = '1';
@@ -99,14 +106,24 @@ AggregateManager::AggregateManager(LocationService* loc, Transfer::OAuthParamsPt
     // Start the processing thread
     mAggregationThread = new Thread( "AggregateManager", std::tr1::bind(&AggregateManager::aggregationThreadMain, this) );
 
-    for (uint8 i = 0; i < NUM_UPLOAD_THREADS; i++) {
-      char id = '1';
-      mUploadServices[i] = new Network::IOService("AggregateManager::UploadService"+id);
-      mUploadStrands[i] = mUploadServices[i]->createStrand("AggregateManager::UploadStrand"+id);
-      mUploadWorks[i] =new Network::IOWork(mUploadServices[i], "AggregateManager::UploadWork"+id);
-      mUploadThreads[i] = new Thread("AggregateManager Upload", std::tr1::bind(&AggregateManager::uploadThreadMain, this, i));
-
-      id++;
+    // Generation workers, one per hardware thread
+    uint32 num_workers = std::max(Thread::hardware_concurrency(), (unsigned)1);
+    for (uint32 i = 0; i < num_workers; i++)
+      mWorkerThreads.push_back(new Thread("AggregateManager Worker", std::tr1::bind(&AggregateManager::workerThreadMain, this)));
+
+    mUploadService = new Network::IOService("AggregateManager::UploadService");
+    mUploadWork = new Network::IOWork(mUploadService, "AggregateManager::UploadWork");
+    for (uint32 i = 0; i < NUM_UPLOAD_THREADS; i++)
+      mUploadThreads.push_back(new Thread("AggregateManager Upload", std::tr1::bind(&AggregateManager::uploadThreadMain, this)));
+
+    if (mLoc->context()->commander()) {
+      mLoc->context()->commander()->registerCommand(
+          "space.aggregates.stats",
+          mAggregationStrand->wrap(
+              std::tr1::bind(&AggregateManager::commandStats, this,
+                  std::tr1::placeholders::_1, std::tr1::placeholders::_2, std::tr1::placeholders::_3)
+          )
+      );
     }
 
     removeStaleLeaves();
@@ -115,11 +132,27 @@ AggregateManager::AggregateManager(LocationService* loc, Transfer::OAuthParamsPt
 }
 
 AggregateManager::~AggregateManager() {
+    if (mLoc->context()->commander())
+      mLoc->context()->commander()->unregisterCommand("space.aggregates.stats");
+
     // We need to make sure we clean this up before the IOService and IOStrand
     // it's running on.
     mCDNKeepAlivePoller->stop();
     delete mCDNKeepAlivePoller;
 
+    // Stop the workers first since they post results back to the aggregation
+    // strand.
+    delete mWorkerWork;
+    mWorkerWork = NULL;
+    mWorkerService->stop();
+    for (uint32 i = 0; i < mWorkerThreads.size(); i++) {
+      mWorkerThreads[i]->join();
+      delete mWorkerThreads[i];
+    }
+    mWorkerThreads.clear();
+    delete mWorkerService;
+    mWorkerService = NULL;
+
     // Shut down the main processing thread
     delete mIOWork;
     mIOWork = NULL;
@@ -134,19 +167,16 @@ AggregateManager::~AggregateManager() {
     delete mAggregationThread;
 
     //Shutdown the upload threads.
-    for (uint8 i = 0; i < NUM_UPLOAD_THREADS; i++) {
-      if (mUploadThreads[i] != NULL) {
-        if (mUploadServices[i] != NULL)
-            mUploadServices[i]->stop();
-        mUploadThreads[i]->join();
-      }
-
-      delete mUploadWorks[i];
-      delete mUploadStrands[i];
-      delete mUploadServices[i];
-
+    delete mUploadWork;
+    mUploadWork = NULL;
+    mUploadService->stop();
+    for (uint32 i = 0; i < mUploadThreads.size(); i++) {
+      mUploadThreads[i]->join();
       delete mUploadThreads[i];
     }
+    mUploadThreads.clear();
+    delete mUploadService;
+    mUploadService = NULL;
 
     delete mCenteringFilter;
     //Delete the model system.
@@ -158,8 +188,12 @@ void AggregateManager::aggregationThreadMain() {
   mAggregationService->run();
 }
 
-void AggregateManager::uploadThreadMain(uint8 i) {
-  mUploadServices[i]->run();
+void AggregateManager::workerThreadMain() {
+  mWorkerService->run();
+}
+
+void AggregateManager::uploadThreadMain() {
+  mUploadService->run();
 }
 
 void AggregateManager::addAggregate(const UUID& uuid) {
@@ -308,16 +342,219 @@ void AggregateManager::generateAggregateMesh(const UUID& uuid, AggregateObjectPt
   AGG_LOG(detailed,"Setting up aggregate " << uuid << " to generate aggregate mesh with " << aggObject->mChildren.size() << " in " << delayFor);
   mAggregationStrand->post(
       delayFor,
-      std::tr1::bind(&AggregateManager::generateAggregateMeshAsyncIgnoreErrors, this, uuid, aggObject->mLastGenerateTime, true),
-      "AggregateManager::generateAggregateMeshAsyncIgnoreErrors"
+      std::tr1::bind(&AggregateManager::scheduleAggregate, this, aggObject),
+      "AggregateManager::scheduleAggregate"
   );
 }
 
-void AggregateManager::generateAggregateMeshAsyncIgnoreErrors(const UUID uuid, Time postTime, bool generateSiblings) {
-	uint32 retval=generateAggregateMeshAsync(uuid, postTime, generateSiblings);
-	if (retval != GEN_SUCCESS) {
-          SILOG(aggregate,error,"generateAggregateMeshAsync returned false, but no error handling happening" << "\n");
-	}
+void AggregateManager::scheduleAggregate(AggregateObjectPtr aggObject) {
+  if (aggObject->mInFlight) {
+    aggObject->mDirtyWhileGenerating = true;
+    return;
+  }
+  aggObject->mPending = true;
+  enqueueReadyAggregate(aggObject);
+  dispatchReadyAggregates();
+}
+
+void AggregateManager::enqueueReadyAggregate(AggregateObjectPtr aggObject) {
+  if (!aggObject->mPending || aggObject->mInFlight || aggObject->mQueued)
+    return;
+
+  // Children have to be generated first so we can use their new meshes.
+  {
+    boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
+    for (uint32 i = 0; i < aggObject->mChildren.size(); i++) {
+      if (aggObject->mChildren[i]->mPending)
+        return;
+    }
+  }
+
+  aggObject->mQueued = true;
+  mObjectsByPriority[ aggObject->mNumObservers + (aggObject->mTreeLevel*0.001) ].push_back(aggObject);
+}
+
+void AggregateManager::dispatchReadyAggregates() {
+  while (mNumInFlight < mWorkerThreads.size() && !mObjectsByPriority.empty()) {
+    std::map<float, std::deque<AggregateObjectPtr> >::iterator it = --mObjectsByPriority.end();
+    AggregateObjectPtr aggObject = it->second.front();
+    it->second.pop_front();
+    if (it->second.empty())
+      mObjectsByPriority.erase(it);
+
+    aggObject->mQueued = false;
+    if (!aggObject->mPending || aggObject->mInFlight)
+      continue;
+
+    aggObject->mInFlight = true;
+    mNumInFlight++;
+    mWorkerService->post(
+        std::tr1::bind(&AggregateManager::generateAggregateMeshTask, this, aggObject),
+        "AggregateManager::generateAggregateMeshTask"
+    );
+  }
+}
+
+void AggregateManager::generateAggregateMeshTask(AggregateObjectPtr aggObject) {
+  Time start = Timer::now();
+  uint32 retval = generateAggregateMeshAsync(aggObject->mUUID, start, false);
+  Duration genTime = Timer::now() - start;
+
+  mAggregationStrand->post(
+      std::tr1::bind(&AggregateManager::handleAggregateGenerated, this, aggObject, retval, genTime),
+      "AggregateManager::handleAggregateGenerated"
+  );
+}
+
+void AggregateManager::handleAggregateGenerated(AggregateObjectPtr aggObject, uint32 retval, Duration genTime) {
+  mNumInFlight--;
+  aggObject->mInFlight = false;
+
+  if (retval == GEN_SUCCESS) {
+    boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
+    GenerationStats* stats[2] = { &aggObject->mStats, &mTotalStats };
+    for (uint32 i = 0; i < 2; i++) {
+      stats[i]->generated++;
+      stats[i]->total += genTime;
+      stats[i]->last = genTime;
+      stats[i]->max = std::max(stats[i]->max, genTime);
+    }
+  }
+  else {
+    boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
+    aggObject->mStats.failed++;
+    mTotalStats.failed++;
+  }
+
+  if (aggObject->mDirtyWhileGenerating) {
+    // Changed while we were working on it, so the result is already out of
+    // date. Run it again (after any children that were also changed).
+    aggObject->mDirtyWhileGenerating = false;
+    aggObject->mNumFailedGenerationAttempts = 0;
+    enqueueReadyAggregate(aggObject);
+  }
+  else if (retval == GEN_SUCCESS || aggObject->mNumFailedGenerationAttempts > 25) {
+    if (retval != GEN_SUCCESS) {
+      AGG_LOG(error, "Could not generate aggregate mesh for " <<
+              aggObject->mTreeLevel << "_" << aggObject->mUUID.toString() << "\n");
+    }
+    aggObject->mNumFailedGenerationAttempts = 0;
+    aggObject->mPending = false;
+
+    // Parents waiting on this one may be able to go now
+    std::vector<AggregateObjectPtr> parents;
+    {
+      boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
+      for (std::set<UUID>::iterator it = aggObject->mParentUUIDs.begin(); it != aggObject->mParentUUIDs.end(); it++) {
+        AggregateObjectsMap::iterator parent_it = mAggregateObjects.find(*it);
+        if (parent_it != mAggregateObjects.end())
+          parents.push_back(parent_it->second);
+      }
+    }
+    for (uint32 i = 0; i < parents.size(); i++)
+      enqueueReadyAggregate(parents[i]);
+  }
+  else {
+    Duration dur = Duration::milliseconds(50.0);
+    if (retval == OTHER_GEN_FAILURE) {
+      aggObject->mNumFailedGenerationAttempts++;
+      dur = Duration::milliseconds(10.0*pow(2.f,(float)aggObject->mNumFailedGenerationAttempts));
+    }
+    mAggregationStrand->post(
+        dur,
+        std::tr1::bind(&AggregateManager::retryAggregate, this, aggObject),
+        "AggregateManager::retryAggregate"
+    );
+  }
+
+  dispatchReadyAggregates();
+}
+
+void AggregateManager::retryAggregate(AggregateObjectPtr aggObject) {
+  enqueueReadyAggregate(aggObject);
+  dispatchReadyAggregates();
+}
+
+bool AggregateManager::getCenteredMesh(AggregateObjectPtr child, MeshdataPtr source,
+                                       MeshdataPtr* centered_out, double* radius_out)
+{
+  {
+    boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
+    if (child->mCenteredMesh && child->mCenteredSource == source) {
+      *centered_out = child->mCenteredMesh;
+      *radius_out = child->mCenteredRadius;
+      return true;
+    }
+  }
+
+  // Center a copy, as its done on the client side for display. The source may
+  // be shared with other aggregates being generated at the same time, so it
+  // can't be modified in place.
+  Mesh::MutableFilterDataPtr input_data(new Mesh::FilterData);
+  input_data->push_back(MeshdataPtr(new Meshdata(*source)));
+  Mesh::FilterDataPtr output_data = mCenteringFilter->apply(input_data);
+  MeshdataPtr centered = std::tr1::dynamic_pointer_cast<Mesh::Meshdata> (output_data->get());
+
+  BoundingBox3f3f bbox = BoundingBox3f3f::null();
+  double radius = 0;
+  ComputeBounds(centered, &bbox, &radius);
+
+  boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
+  child->mCenteredSource = source;
+  child->mCenteredMesh = centered;
+  child->mCenteredRadius = radius;
+  *centered_out = centered;
+  *radius_out = radius;
+  return false;
+}
+
+void AggregateManager::commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+  Command::Result result = Command::EmptyResult();
+
+  // Optionally restrict the per-aggregate listing to a single aggregate
+  UUID filter = UUID::null();
+  if (cmd.contains("aggregate"))
+    filter = UUID(cmd.getString("aggregate"), UUID::HumanReadable());
+
+  uint32 num_pending = 0, num_queued = 0;
+
+  boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
+  result.put("aggregates", Command::Array());
+  Command::Array& aggs_array = result.getArray("aggregates");
+  for (AggregateObjectsMap::iterator it = mAggregateObjects.begin(); it != mAggregateObjects.end(); it++) {
+    AggregateObjectPtr aggObject = it->second;
+    if (aggObject->mChildren.empty()) continue;
+
+    if (aggObject->mPending) num_pending++;
+    if (aggObject->mQueued) num_queued++;
+
+    if (filter != UUID::null() && filter != aggObject->mUUID) continue;
+
+    const GenerationStats& stats = aggObject->mStats;
+    aggs_array.push_back(Command::Object());
+    aggs_array.back().put("id", aggObject->mUUID.toString());
+    aggs_array.back().put("level", aggObject->mTreeLevel);
+    aggs_array.back().put("children", (uint32)aggObject->mChildren.size());
+    aggs_array.back().put("generated", stats.generated);
+    aggs_array.back().put("failed", stats.failed);
+    aggs_array.back().put("time.last", stats.last.toMilliseconds());
+    aggs_array.back().put("time.max", stats.max.toMilliseconds());
+    aggs_array.back().put("time.avg", stats.generated > 0 ? (stats.total.toMilliseconds() / stats.generated) : 0);
+    aggs_array.back().put("last_children", stats.lastChildren);
+    aggs_array.back().put("last_reused_children", stats.lastReusedChildren);
+  }
+
+  result.put("stats.pending", num_pending);
+  result.put("stats.queued", num_queued);
+  result.put("stats.in_flight", mNumInFlight);
+  result.put("stats.workers", (uint32)mWorkerThreads.size());
+  result.put("stats.generated", mTotalStats.generated);
+  result.put("stats.failed", mTotalStats.failed);
+  result.put("stats.time.max", mTotalStats.max.toMilliseconds());
+  result.put("stats.time.avg", mTotalStats.generated > 0 ? (mTotalStats.total.toMilliseconds() / mTotalStats.generated) : 0);
+  lock.unlock();
+
+  cmdr->result(cmdid, result);
 }
 
 uint32 AggregateManager::generateAggregateMeshAsync(const UUID uuid, Time postTime, bool generateSiblings) {
@@ -357,9 +594,17 @@ uint32 AggregateManager::generateAggregateMeshAsync(const UUID uuid, Time postTi
     currentLocMap[uuid] = locInfoForUUID;
   }
 
-  std::vector<AggregateObjectPtr>& children = aggObject->mChildren;
-                                                   //Set this to mLeaves if you want
-                                                   //to generate directly from the leaves of the tree
+  // Copy the list of children since it may be modified while we're working.
+  std::vector<AggregateObjectPtr> children;
+  {
+    boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
+    children = aggObject->mChildren;  //Set this to mLeaves if you want
+                                      //to generate directly from the leaves of the tree
+  }
+
+  // Meshes of child aggregates generated by this manager, which are used
+  // directly instead of waiting for them to be uploaded and downloaded.
+  std::tr1::unordered_map<UUID, AggregateObjectPtr, UUID::Hasher> generatedChildren;
 
   for (uint32 i= 0; i < children.size(); i++) {
     UUID child_uuid = children[i]->mUUID;
@@ -370,9 +615,16 @@ uint32 AggregateManager::generateAggregateMeshAsync(const UUID uuid, Time postTi
     }
     currentLocMap[child_uuid] = locInfoForChildUUID;
 
-    if (isAggregate(child_uuid) && locInfoForChildUUID->mesh == "") {
-      AGG_LOG(detailed,  "Not yet generated: " << child_uuid);
-      return CHILDREN_NOT_YET_GEN;
+    if (isAggregate(child_uuid)) {
+      boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
+      if (children[i]->mGeneratedMesh) {
+        generatedChildren[child_uuid] = children[i];
+        continue;
+      }
+      if (locInfoForChildUUID->mesh == "") {
+        AGG_LOG(detailed,  "Not yet generated: " << child_uuid);
+        return CHILDREN_NOT_YET_GEN;
+      }
     }
   }
 
@@ -380,6 +632,7 @@ uint32 AggregateManager::generateAggregateMeshAsync(const UUID uuid, Time postTi
   bool allMeshesAvailable = true;
   for (uint32 i= 0; i < children.size(); i++) {
     UUID child_uuid = children[i]->mUUID;
+    if (generatedChildren.find(child_uuid) != generatedChildren.end()) continue;
 
     boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
     if ( mAggregateObjects.find(child_uuid) == mAggregateObjects.end()) {
@@ -436,6 +689,7 @@ uint32 AggregateManager::generateAggregateMeshAsync(const UUID uuid, Time postTi
   // Make sure we've got all the Meshdatas
   for (uint32 i= 0; i < children.size(); i++) {
     UUID child_uuid = children[i]->mUUID;
+    if (generatedChildren.find(child_uuid) != generatedChildren.end()) continue;
 
     boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
     if ( mAggregateObjects.find(child_uuid) == mAggregateObjects.end()) {
@@ -459,6 +713,7 @@ uint32 AggregateManager::generateAggregateMeshAsync(const UUID uuid, Time postTi
   // original texture URL so we can tell the CDN to reuse that data.
   std::tr1::unordered_map<String, String> textureSet;
 
+  uint32 numMergedChildren = 0, numReusedChildren = 0;
   for (uint32 i= 0; i < children.size(); i++) {
     UUID child_uuid = children[i]->mUUID;
     boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
@@ -467,20 +722,25 @@ uint32 AggregateManager::generateAggregateMeshAsync(const UUID uuid, Time postTi
     }
     MeshdataPtr m = mAggregateObjects[child_uuid]->mMeshdata;
     std::string meshName = currentLocMap[child_uuid]->mesh;
+    bool generatedChild = (generatedChildren.find(child_uuid) != generatedChildren.end());
+    if (generatedChild) {
+      m = children[i]->mGeneratedMesh;
+      // Only used to share data between identical children, and each
+      // generated aggregate is unique.
+      meshName = "aggregate:" + child_uuid.toString();
+      // Texture names were already resolved when the child was generated.
+      textureSet.insert(children[i]->mGeneratedTextures.begin(), children[i]->mGeneratedTextures.end());
+    }
     lock.unlock();
 
     if (!m || meshName == "") continue;
 
-    //Center the mesh, as its done on the client side for display.
-    Mesh::MutableFilterDataPtr input_data(new Mesh::FilterData);
-    input_data->push_back(m);
-    Mesh::FilterDataPtr output_data = mCenteringFilter->apply(input_data);
-    m = std::tr1::dynamic_pointer_cast<Mesh::Meshdata> (output_data->get());
-
-    //Compute the bounds for the child's mesh.
-    BoundingBox3f3f originalMeshBoundingBox = BoundingBox3f3f::null();
+    //Center the mesh and compute its bounds. Unchanged children reuse the
+    //result from the last time this aggregate (or another parent) was generated.
     double originalMeshBoundsRadius=0;
-    ComputeBounds( m, &originalMeshBoundingBox, &originalMeshBoundsRadius);
+    numMergedChildren++;
+    if (getCenteredMesh(children[i], m, &m, &originalMeshBoundsRadius))
+      numReusedChildren++;
 
     // We me reuse more than one of the same mesh, e.g. the aggregate may have
     // two identical trees that are at different locations. In that case,
@@ -505,7 +765,7 @@ uint32 AggregateManager::generateAggregateMeshAsync(const UUID uuid, Time postTi
           m->materials.end());
       // Copy names of textures from the materials into a set so we can fill in
       // the texture list when we finish adding all subobjects
-      for(MaterialEffectInfoList::const_iterator mat_it = m->materials.begin(); mat_it != m->materials.end(); mat_it++) {
+      for(MaterialEffectInfoList::const_iterator mat_it = m->materials.begin(); !generatedChild && mat_it != m->materials.end(); mat_it++) {
           for(MaterialEffectInfo::TextureList::const_iterator tex_it = mat_it->textures.begin(); tex_it != mat_it->textures.end(); tex_it++) {
               if (!tex_it->uri.empty()) {
                   Transfer::URI orig_tex_uri;
@@ -553,7 +813,7 @@ uint32 AggregateManager::generateAggregateMeshAsync(const UUID uuid, Time postTi
     //If the child is an aggregate, don't use the information from LOC blindly.
     //Fix that info up so that it corresponds with the actual position and size
     //of the aggregate mesh.
-    if (isAggregate(child_uuid)) {
+    if (generatedChild || isAggregate(child_uuid)) {
       Vector4f offsetFromCenter = m->globalTransform.getCol(3);
       offsetFromCenter = offsetFromCenter * -1.f;
 
@@ -693,6 +953,15 @@ uint32 AggregateManager::generateAggregateMeshAsync(const UUID uuid, Time postTi
   //Simplify the mesh...
   mMeshSimplifier.simplify(agg_mesh, 20000);
 
+  // Keep the result so parents can be generated from it right away.
+  {
+    boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
+    aggObject->mGeneratedMesh = agg_mesh;
+    aggObject->mGeneratedTextures = textureSet;
+    aggObject->mStats.lastChildren = numMergedChildren;
+    aggObject->mStats.lastReusedChildren = numReusedChildren;
+  }
+
   //Set the mesh of this aggregate to the empty string until the new version gets uploaded. This is so that
   //higher level aggregates are not generated from the now out-of-date version of the mesh. 
   mLoc->context()->mainStrand->post(
@@ -704,7 +973,7 @@ uint32 AggregateManager::generateAggregateMeshAsync(const UUID uuid, Time postTi
   );  
 
   //... and now create the collada file, upload to the CDN and update LOC.
-  mUploadStrands[rand() % NUM_UPLOAD_THREADS]->post(
+  mUploadService->post(
           std::tr1::bind(&AggregateManager::uploadAggregateMesh, this, agg_mesh, aggObject, textureSet, 0),
           "AggregateManager::uploadAggregateMesh"
       );
@@ -908,7 +1177,7 @@ void AggregateManager::handleUploadFinished(Transfer::UploadRequestPtr request,
       AGG_LOG(error, "Failure was retry attempt # " << retryAttempt);
       //Retry uploading up to 5 times.
       if (retryAttempt < 5) {
-	mUploadStrands[rand() % NUM_UPLOAD_THREADS]->post(
+	mUploadService->post(
 		  std::tr1::bind(&AggregateManager::uploadAggregateMesh, this, agg_mesh, aggObject, textureSet, retryAttempt + 1),
 		  "AggregateManager::uploadAggregateMesh"
 		);
@@ -1109,6 +1378,7 @@ void AggregateManager::generateMeshesFromQueue(Time postTime) {
     //Get the leaves that belong to each node.
     std::vector<UUID> individualObjects;
 
+    boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
     if ( mDirtyAggregateObjects.size() > 0 ) {
       for (std::tr1::unordered_map<UUID, AggregateObjectPtr, UUID::Hasher >::iterator it = mAggregateObjects.begin();
            it != mAggregateObjects.end() ; it++)
@@ -1144,72 +1414,31 @@ void AggregateManager::generateMeshesFromQueue(Time postTime) {
       getLeaves(individualObjects);
     }
 
-    //Add objects to generation queue, ordered by priority.
+    //Mark everything that changed as needing generation. Children are
+    //generated before their parents, so only those whose children are all up
+    //to date actually get queued here -- the rest are queued as their children
+    //finish.
+    std::vector<AggregateObjectPtr> dirty;
     for (std::tr1::unordered_map<UUID, AggregateObjectPtr, UUID::Hasher>::iterator it = mDirtyAggregateObjects.begin();
          it != mDirtyAggregateObjects.end(); it++)
     {
       std::tr1::shared_ptr<AggregateObject> aggObject = it->second;
       if (aggObject->mTreeLevel >= 0)
-        mObjectsByPriority[ aggObject->mNumObservers + (aggObject->mTreeLevel*0.001) ].push_back(aggObject);
-    }
-
-
-    //Generate the aggregates from the priority queue.
-    Time curTime = (mObjectsByPriority.size() > 0) ? Timer::now() : Time::null();
-    uint32 returner = GEN_SUCCESS;
-    uint32 numFailedAttempts = 1;
-    bool noObjectsToGenerate = true;
-    for (std::map<float, std::deque<AggregateObjectPtr> >::reverse_iterator it =  mObjectsByPriority.rbegin();
-         it != mObjectsByPriority.rend(); it++)
-    {
-      if (it->second.size() > 0) {
-        noObjectsToGenerate = false;
-        std::tr1::shared_ptr<AggregateObject> aggObject = it->second.front();
-
-        if (aggObject->generatedLastRound) continue;
-	
-	//AGG_LOG(info, "Generating mesh for " << aggObject->mTreeLevel <<"-" << aggObject->mUUID );
-        returner=generateAggregateMeshAsync(aggObject->mUUID, curTime, false);
-
-        if (returner==GEN_SUCCESS || aggObject->mNumFailedGenerationAttempts > 25) {
-          it->second.pop_front();
-	        if (returner != GEN_SUCCESS) {
-            AGG_LOG(error, "Could not generate aggregate mesh for " <<
-	                   aggObject->mTreeLevel << "_" << aggObject->mUUID.toString() << "\n");
-          }
-
-          aggObject->mNumFailedGenerationAttempts = 0;
-        }
-        else if (returner == OTHER_GEN_FAILURE) {
-          aggObject->mNumFailedGenerationAttempts++;
-          numFailedAttempts = aggObject->mNumFailedGenerationAttempts;
-        }
-
-        break;
-      }
+        dirty.push_back(aggObject);
     }
-
     mDirtyAggregateObjects.clear();
+    lock.unlock();
 
-    if (noObjectsToGenerate) {
-      mObjectsByPriority.clear();
+    for (uint32 i = 0; i < dirty.size(); i++) {
+      if (dirty[i]->mInFlight)
+        dirty[i]->mDirtyWhileGenerating = true;
+      else
+        dirty[i]->mPending = true;
     }
+    for (uint32 i = 0; i < dirty.size(); i++)
+      enqueueReadyAggregate(dirty[i]);
 
-    if (mObjectsByPriority.size() > 0) {
-      Duration dur = Duration::milliseconds(1.0);
-      if (returner == OTHER_GEN_FAILURE) {
-	dur = Duration::milliseconds(10.0*pow(2.f,(float)numFailedAttempts));
-      }
-      else if (returner == CHILDREN_NOT_YET_GEN) {
-	dur = Duration::milliseconds(50.0);
-      }
- 
-      mAggregationStrand->post(
-          dur,
-          std::tr1::bind(&AggregateManager::generateMeshesFromQueue, this, curTime),
-          "AggregateManager::generateMeshesFromQueue"
-      );
-    }
+    dispatchReadyAggregates();
 }
 
 void AggregateManager::updateChildrenTreeLevel(const UUID& uuid, uint16 treeLevel) {
@@ -79,6 +79,7 @@ void LocationServiceFactory::destroy() {
 LocationService::LocationService(SpaceContext* ctx, LocationUpdatePolicy* update_policy)
  : PollingService(ctx->mainStrand, "LocationService Poll", Duration::milliseconds((int64)10)),
    mContext(ctx),
+   mBatchedListeners(0),
    mUpdatePolicy(update_policy)
 {
     mProfiler = mContext->profiler->addStage("Location Service");
@@ -170,6 +171,7 @@ void LocationService::stop() {
 void LocationService::poll() {
     mProfiler->started();
     service();
+    deliverBatchedUpdates();
     mProfiler->finished();
 }
 
@@ -177,12 +179,16 @@ void LocationService::addListener(LocationServiceListener* listener, bool want_a
     ListenerInfo info;
     info.listener = listener;
     info.wantAggregates = want_aggregates;
-    mListeners.insert(info);
+    info.batched = listener->batchedUpdates();
+    if (mListeners.insert(info).second && info.batched)
+        mBatchedListeners++;
 }
 
 void LocationService::removeListener(LocationServiceListener* listener) {
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++) {
         if (it->listener == listener) {
+            if (it->batched)
+                mBatchedListeners--;
             mListeners.erase(it);
             break;
         }
@@ -234,6 +240,7 @@ void LocationService::notifyLocalObjectAdded(const UUID& uuid, bool agg, const T
 }
 
 void LocationService::notifyLocalObjectRemoved(const UUID& uuid, bool agg) const {
+    dropBatchedUpdate(uuid);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
         if (!agg || it->wantAggregates)
             it->listener->localObjectRemoved(uuid, agg);
@@ -241,33 +248,38 @@ void LocationService::notifyLocalObjectRemoved(const UUID& uuid, bool agg) const
 
 
 void LocationService::notifyLocalLocationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval) const {
+    queueBatchedUpdate(uuid, true, agg, LocationUpdateBatchEntry::LOCATION);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
-        if (!agg || it->wantAggregates)
+        if (!it->batched && (!agg || it->wantAggregates))
             it->listener->localLocationUpdated(uuid, agg, newval);
 }
 
 void LocationService::notifyLocalOrientationUpdated(const UUID& uuid, bool agg, const TimedMotionQuaternion& newval) const {
+    queueBatchedUpdate(uuid, true, agg, LocationUpdateBatchEntry::ORIENTATION);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
-        if (!agg || it->wantAggregates)
+        if (!it->batched && (!agg || it->wantAggregates))
             it->listener->localOrientationUpdated(uuid, agg, newval);
 }
 
 void LocationService::notifyLocalBoundsUpdated(const UUID& uuid, bool agg, const BoundingSphere3f& newval) const {
+    queueBatchedUpdate(uuid, true, agg, LocationUpdateBatchEntry::BOUNDS);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
-        if (!agg || it->wantAggregates)
+        if (!it->batched && (!agg || it->wantAggregates))
             it->listener->localBoundsUpdated(uuid, agg, newval);
 }
 
 
 void LocationService::notifyLocalMeshUpdated(const UUID& uuid, bool agg, const String& newval) const {
+    queueBatchedUpdate(uuid, true, agg, LocationUpdateBatchEntry::MESH);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
-        if (!agg || it->wantAggregates)
+        if (!it->batched && (!agg || it->wantAggregates))
             it->listener->localMeshUpdated(uuid, agg, newval);
 }
 
 void LocationService::notifyLocalPhysicsUpdated(const UUID& uuid, bool agg, const String& newval) const {
+    queueBatchedUpdate(uuid, true, agg, LocationUpdateBatchEntry::PHYSICS);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
-        if (!agg || it->wantAggregates)
+        if (!it->batched && (!agg || it->wantAggregates))
             it->listener->localPhysicsUpdated(uuid, agg, newval);
 }
 
@@ -278,33 +290,73 @@ void LocationService::notifyReplicaObjectAdded(const UUID& uuid, const TimedMoti
 }
 
 void LocationService::notifyReplicaObjectRemoved(const UUID& uuid) const {
+    dropBatchedUpdate(uuid);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
         it->listener->replicaObjectRemoved(uuid);
 }
 
 void LocationService::notifyReplicaLocationUpdated(const UUID& uuid, const TimedMotionVector3f& newval) const {
+    queueBatchedUpdate(uuid, false, false, LocationUpdateBatchEntry::LOCATION);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
-        it->listener->replicaLocationUpdated(uuid, newval);
+        if (!it->batched)
+            it->listener->replicaLocationUpdated(uuid, newval);
 }
 
 void LocationService::notifyReplicaOrientationUpdated(const UUID& uuid, const TimedMotionQuaternion& newval) const {
+    queueBatchedUpdate(uuid, false, false, LocationUpdateBatchEntry::ORIENTATION);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
-        it->listener->replicaOrientationUpdated(uuid, newval);
+        if (!it->batched)
+            it->listener->replicaOrientationUpdated(uuid, newval);
 }
 
 void LocationService::notifyReplicaBoundsUpdated(const UUID& uuid, const BoundingSphere3f& newval) const {
+    queueBatchedUpdate(uuid, false, false, LocationUpdateBatchEntry::BOUNDS);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
-        it->listener->replicaBoundsUpdated(uuid, newval);
+        if (!it->batched)
+            it->listener->replicaBoundsUpdated(uuid, newval);
 }
 
 void LocationService::notifyReplicaMeshUpdated(const UUID& uuid, const String& newval) const {
+    queueBatchedUpdate(uuid, false, false, LocationUpdateBatchEntry::MESH);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
-        it->listener->replicaMeshUpdated(uuid, newval);
+        if (!it->batched)
+            it->listener->replicaMeshUpdated(uuid, newval);
 }
 
 void LocationService::notifyReplicaPhysicsUpdated(const UUID& uuid, const String& newval) const {
+    queueBatchedUpdate(uuid, false, false, LocationUpdateBatchEntry::PHYSICS);
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
-        it->listener->replicaPhysicsUpdated(uuid, newval);
+        if (!it->batched)
+            it->listener->replicaPhysicsUpdated(uuid, newval);
+}
+
+void LocationService::queueBatchedUpdate(const UUID& uuid, bool local, bool agg, uint8 field) const {
+    if (mBatchedListeners > 0)
+        mPendingUpdates.add(uuid, local, agg, field);
+}
+
+void LocationService::dropBatchedUpdate(const UUID& uuid) const {
+    mPendingUpdates.remove(uuid);
+}
+
+void LocationService::deliverBatchedUpdates() {
+    if (mPendingUpdates.empty())
+        return;
+
+    // Listeners may cause more updates, which go into the next batch. Aggregates
+    // come last, so listeners which don't want them just get a prefix.
+    size_t num_nonagg = mPendingUpdates.take(&mDeliveringUpdates);
+    size_t num_all = mDeliveringUpdates.size();
+    if (num_all == 0)
+        return;
+
+    const LocationUpdateBatchEntry* entries = &mDeliveringUpdates[0];
+    for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++) {
+        if (!it->batched) continue;
+        size_t num = (it->wantAggregates ? num_all : num_nonagg);
+        if (num > 0)
+            it->listener->locationUpdateBatch(entries, entries + num);
+    }
 }
 
 } // namespace Sirikata
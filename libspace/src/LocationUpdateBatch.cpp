@@ -0,0 +1,54 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/space/LocationUpdateBatch.hpp>
+
+namespace Sirikata {
+
+namespace {
+bool removedFromBatch(const LocationUpdateBatchEntry& entry) {
+    return entry.fields == 0;
+}
+bool notAggregate(const LocationUpdateBatchEntry& entry) {
+    return !entry.aggregate;
+}
+}
+
+void LocationUpdateBatcher::add(const UUID& uuid, bool local, bool agg, uint8 field) {
+    EntryIndex::iterator idx_it = mIndex.find(uuid);
+    if (idx_it == mIndex.end()) {
+        idx_it = mIndex.insert(EntryIndex::value_type(uuid, (uint32)mEntries.size())).first;
+        mEntries.push_back(LocationUpdateBatchEntry());
+        mEntries.back().uuid = uuid;
+        mEntries.back().fields = 0;
+    }
+    LocationUpdateBatchEntry& entry = mEntries[idx_it->second];
+    entry.local = local;
+    entry.aggregate = agg;
+    entry.fields |= field;
+}
+
+void LocationUpdateBatcher::remove(const UUID& uuid) {
+    if (mIndex.empty())
+        return;
+    // Left in place and filtered out by take(). If the object comes back
+    // before then, the entry is just reused.
+    EntryIndex::iterator idx_it = mIndex.find(uuid);
+    if (idx_it != mIndex.end())
+        mEntries[idx_it->second].fields = 0;
+}
+
+size_t LocationUpdateBatcher::take(Batch* batch_out) {
+    Batch::iterator live_end = std::remove_if(mEntries.begin(), mEntries.end(), removedFromBatch);
+    mEntries.erase(live_end, mEntries.end());
+    Batch::iterator aggs_begin = std::stable_partition(mEntries.begin(), mEntries.end(), notAggregate);
+    size_t num_nonagg = aggs_begin - mEntries.begin();
+
+    batch_out->clear();
+    batch_out->swap(mEntries);
+    mIndex.clear();
+    return num_nonagg;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,120 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/space/MigrationDataClientRegistry.hpp>
+#include <sirikata/core/command/Commander.hpp>
+#include <sirikata/core/network/IOStrandImpl.hpp>
+#include <sirikata/core/util/Timer.hpp>
+
+#define MIGRATION_LOG(lvl, msg) SILOG(migration-data, lvl, msg)
+
+namespace Sirikata {
+
+MigrationDataClientRegistry::MigrationDataClientRegistry(SpaceContext* ctx)
+ : mContext(ctx),
+   mUnknownReceived(0)
+{
+    ctx->mMigrationDataClients = this;
+
+    if (mContext->commander()) {
+        mContext->commander()->registerCommand(
+            "space.migration.clients",
+            mContext->mainStrand->wrap(
+                std::tr1::bind(&MigrationDataClientRegistry::commandStats, this,
+                    std::tr1::placeholders::_1, std::tr1::placeholders::_2, std::tr1::placeholders::_3)
+            )
+        );
+    }
+}
+
+MigrationDataClientRegistry::~MigrationDataClientRegistry() {
+    if (mContext->commander())
+        mContext->commander()->unregisterCommand("space.migration.clients");
+    mContext->mMigrationDataClients = NULL;
+}
+
+MigrationDataClientRegistry::ClientList::iterator MigrationDataClientRegistry::findClient(const String& tag) {
+    for(ClientList::iterator it = mClients.begin(); it != mClients.end(); it++)
+        if (it->tag == tag) return it;
+    return mClients.end();
+}
+
+void MigrationDataClientRegistry::addClient(MigrationDataClient* client) {
+    String tag = client->migrationClientTag();
+    if (findClient(tag) != mClients.end()) {
+        MIGRATION_LOG(error, "Ignoring second migration data client with tag " << tag);
+        return;
+    }
+    mClients.push_back(ClientInfo(client, tag));
+}
+
+void MigrationDataClientRegistry::removeClient(MigrationDataClient* client) {
+    for(ClientList::iterator it = mClients.begin(); it != mClients.end(); it++) {
+        if (it->client == client) {
+            mClients.erase(it);
+            return;
+        }
+    }
+}
+
+void MigrationDataClientRegistry::generateMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, Sirikata::Protocol::Migration::IMigrationMessage& migrate_msg) {
+    for(ClientList::iterator it = mClients.begin(); it != mClients.end(); it++) {
+        MigrationDataWriter writer(migrate_msg, it->tag);
+        Time start = Timer::now();
+        it->client->generateMigrationData(obj, source_server, dest_server, writer);
+        it->stats.generateTime += Timer::now() - start;
+
+        if (!writer.written()) continue;
+
+        it->stats.generated++;
+        it->stats.generatedBytes += writer.size();
+    }
+}
+
+void MigrationDataClientRegistry::receiveMigrationData(const UUID& obj, ServerID source_server, ServerID dest_server, const Sirikata::Protocol::Migration::MigrationMessage& migrate_msg) {
+    // Entries were generated in client order, so we can usually find the next
+    // client by continuing from the last one.
+    ClientList::iterator client_it = mClients.begin();
+    for(int32 i = 0; i < migrate_msg.client_data_size(); i++) {
+        Sirikata::Protocol::Migration::MigrationClientData client_data = migrate_msg.client_data(i);
+        const std::string& tag = client_data.key();
+
+        if (client_it == mClients.end() || client_it->tag != tag)
+            client_it = findClient(tag);
+        if (client_it == mClients.end()) {
+            MIGRATION_LOG(error, "Got unknown tag " << tag << " for client migration data");
+            mUnknownReceived++;
+            continue;
+        }
+
+        const std::string& data = client_data.data();
+        Time start = Timer::now();
+        client_it->client->receiveMigrationData(obj, source_server, dest_server, data);
+        client_it->stats.receiveTime += Timer::now() - start;
+        client_it->stats.received++;
+        client_it->stats.receivedBytes += data.size();
+        client_it++;
+    }
+}
+
+void MigrationDataClientRegistry::commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    Command::Result result = Command::EmptyResult();
+    result.put("clients", Command::Array());
+    Command::Array& clients_array = result.getArray("clients");
+    for(ClientList::iterator it = mClients.begin(); it != mClients.end(); it++) {
+        const Stats& stats = it->stats;
+        clients_array.push_back(Command::Object());
+        clients_array.back().put("tag", it->tag);
+        clients_array.back().put("generated", stats.generated);
+        clients_array.back().put("generated_bytes", stats.generatedBytes);
+        clients_array.back().put("generate_time", stats.generateTime.toMilliseconds());
+        clients_array.back().put("received", stats.received);
+        clients_array.back().put("received_bytes", stats.receivedBytes);
+        clients_array.back().put("receive_time", stats.receiveTime.toMilliseconds());
+    }
+    result.put("unknown_received", mUnknownReceived);
+    cmdr->result(cmdid, result);
+}
+
+} // namespace Sirikata
@@ -101,7 +101,7 @@ bool ObjectHostConnectionManager::validConnection(const ShortObjectHostConnectio
     );
 }
 
-bool ObjectHostConnectionManager::send(const ObjectHostConnectionID& conn_id, Sirikata::Protocol::Object::ObjectMessage* msg) {
+bool ObjectHostConnectionManager::send(const ObjectHostConnectionID& conn_id, Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes) {
     // If its not in the connection list we're probably chasing bad
     // pointers
     if (mContext->stopped()) {
@@ -116,10 +116,10 @@ bool ObjectHostConnectionManager::send(const ObjectHostConnectionID& conn_id, Si
         return false;
     }
 
-    return sendHelper(conn, msg);
+    return sendHelper(conn, msg, msg_bytes);
 }
 
-bool ObjectHostConnectionManager::send(const ShortObjectHostConnectionID short_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg) {
+bool ObjectHostConnectionManager::send(const ShortObjectHostConnectionID short_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes) {
     if (mContext->stopped()) {
         SPACE_LOG(fatal,"Trying to send after shutdown requested.");
         return false;
@@ -132,18 +132,24 @@ bool ObjectHostConnectionManager::send(const ShortObjectHostConnectionID short_c
     }
     ObjectHostConnection* conn = it->second;
 
-    return sendHelper(conn, msg);
+    return sendHelper(conn, msg, msg_bytes);
 }
 
-bool ObjectHostConnectionManager::sendHelper(ObjectHostConnection* conn, Sirikata::Protocol::Object::ObjectMessage* msg) {
+bool ObjectHostConnectionManager::sendHelper(ObjectHostConnection* conn, Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes) {
     if (conn == NULL) {
         SPACE_LOG(error,"Tried to send over invalid connection.");
         return false;
     }
 
-    String data;
-    serializePBJMessage(&data, *msg);
-    bool sent = conn->socket->send( Sirikata::MemoryReference(data), Sirikata::Network::ReliableOrdered );
+    bool sent;
+    if (msg_bytes) {
+        sent = conn->socket->send( Sirikata::MemoryReference(*msg_bytes), Sirikata::Network::ReliableOrdered );
+    }
+    else {
+        String data;
+        serializePBJMessage(&data, *msg);
+        sent = conn->socket->send( Sirikata::MemoryReference(data), Sirikata::Network::ReliableOrdered );
+    }
 
     if (sent) {
         TIMESTAMP(msg, Trace::SPACE_TO_OH_ENQUEUED);
@@ -258,8 +264,13 @@ void ObjectHostConnectionManager::handleConnectionEvent(ObjectHostConnection* co
 void ObjectHostConnectionManager::handleConnectionRead(ObjectHostConnection* conn, Sirikata::Network::Chunk& chunk, const Sirikata::Network::Stream::PauseReceiveCallback& pause) {
     SPACE_LOG(insane, "Handling connection read: " << chunk.size() << " bytes");
 
+    // Keep the raw bytes alongside the parsed message so forwarding can send
+    // them on unchanged instead of serializing the message again.
+    ObjectMessageBytesPtr obj_msg_bytes(
+        chunk.empty() ? new std::string() : new std::string((const char*)&(*chunk.begin()), chunk.size())
+    );
     Sirikata::Protocol::Object::ObjectMessage* obj_msg = new Sirikata::Protocol::Object::ObjectMessage();
-    bool parse_success = obj_msg->ParseFromArray(&(*chunk.begin()),chunk.size());
+    bool parse_success = obj_msg->ParseFromString(*obj_msg_bytes);
 
     if (!parse_success) {
         LOG_INVALID_MESSAGE(space, error, chunk);
@@ -269,7 +280,7 @@ void ObjectHostConnectionManager::handleConnectionRead(ObjectHostConnection* con
 
     TIMESTAMP(obj_msg, Trace::HANDLE_OBJECT_HOST_MESSAGE);
 
-    mListener->onObjectHostMessageReceived(conn_id(conn), conn->short_id, obj_msg);
+    mListener->onObjectHostMessageReceived(conn_id(conn), conn->short_id, obj_msg, obj_msg_bytes);
 
     // We either got it or dropped it, either way it was accepted.  Don't do
     // anything with pause parameter.
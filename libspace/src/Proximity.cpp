@@ -4,6 +4,7 @@
 
 
 #include <sirikata/space/Proximity.hpp>
+#include <sirikata/space/MigrationDataClientRegistry.hpp>
 
 AUTO_SINGLETON_INSTANCE(Sirikata::ProximityFactory);
 
@@ -41,9 +42,13 @@ Proximity::Proximity(SpaceContext* ctx, LocationService* locservice, CoordinateS
     mContext->serverDispatcher()->registerMessageRecipient(SERVER_PORT_PROX, this);
     mContext->objectSessionManager()->addListener(this);
     mContext->ohSessionManager()->addListener(this);
+    if (mContext->migrationDataClients())
+        mContext->migrationDataClients()->addClient(this);
 }
 
 Proximity::~Proximity() {
+    if (mContext->migrationDataClients())
+        mContext->migrationDataClients()->removeClient(this);
     mContext->ohSessionManager()->removeListener(this);
     mContext->objectSessionManager()->removeListener(this);
     mContext->serverDispatcher()->unregisterMessageRecipient(SERVER_PORT_PROX, this);
@@ -35,6 +35,91 @@
 
 namespace Sirikata {
 
+namespace {
+
+// The payload is field 7 of ServerMessage, length delimited. Serializers emit
+// fields in order, so it comes after the routing header.
+const uint8 PAYLOAD_TAG = (7 << 3) | 2;
+
+uint32 varintSize(uint64 val) {
+    uint32 size = 1;
+    while(val >= 0x80) {
+        val >>= 7;
+        size++;
+    }
+    return size;
+}
+
+void appendVarint(std::string* out, uint64 val) {
+    while(val >= 0x80) {
+        out->push_back((char)((val & 0x7F) | 0x80));
+        val >>= 7;
+    }
+    out->push_back((char)val);
+}
+
+bool readVarint(const uint8* data, uint32 size, uint32* pos, uint64* val_out) {
+    uint64 val = 0;
+    for(uint32 shift = 0; shift < 64 && *pos < size; shift += 7) {
+        uint8 byte = data[(*pos)++];
+        val |= (uint64)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *val_out = val;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Walks the top level fields of a serialized ServerMessage to find the
+// payload. Only succeeds if the payload is the last field and appears only
+// once, which is always the case for messages we serialized, so that
+// everything before it is the header and the header can't carry a payload of
+// its own.
+bool findTrailingPayload(const uint8* data, uint32 size, uint32* header_size_out, uint32* payload_start_out) {
+    uint32 pos = 0;
+    while(pos < size) {
+        uint32 field_start = pos;
+        uint64 tag, len;
+        if (!readVarint(data, size, &pos, &tag))
+            return false;
+        if ((tag >> 3) == (PAYLOAD_TAG >> 3)) {
+            // An earlier copy of the payload or one with the wrong wire type
+            // would end up in the header, so leave those to the full parse.
+            if (tag != PAYLOAD_TAG || !readVarint(data, size, &pos, &len) || len != size - pos)
+                return false;
+            *header_size_out = field_start;
+            *payload_start_out = pos;
+            return true;
+        }
+        switch(tag & 0x7) {
+          case 0: // varint
+            if (!readVarint(data, size, &pos, &len))
+                return false;
+            break;
+          case 1: // 64 bit
+            if (size - pos < 8)
+                return false;
+            pos += 8;
+            break;
+          case 2: // length delimited
+            if (!readVarint(data, size, &pos, &len) || len > size - pos)
+                return false;
+            pos += (uint32)len;
+            break;
+          case 5: // 32 bit
+            if (size - pos < 4)
+                return false;
+            pos += 4;
+            break;
+          default:
+            return false;
+        }
+    }
+    return false;
+}
+
+}
 
 void Message::fillMessage(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port) {
     set_source_server(src);
@@ -75,7 +160,15 @@ Message::Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port,
 Message::Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const Sirikata::Protocol::Object::ObjectMessage* pl)
  : mCachedSize(0)
 {
-    fillMessage(src, src_port, dest, dest_port, serializePBJMessage(*pl));
+    fillMessage(src, src_port, dest, dest_port);
+    serializePBJMessage(&mPayload, *pl);
+    set_payload_id(pl->unique());
+}
+
+Message::Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const Sirikata::Protocol::Object::ObjectMessage* pl, const std::string& pl_bytes)
+ : mCachedSize(0)
+{
+    fillMessage(src, src_port, dest, dest_port, pl_bytes);
     set_payload_id(pl->unique());
 }
 
@@ -84,13 +177,56 @@ void Message::set_source_server(const ServerID sid) {
     set_id( GenerateUniqueID(sid) );
 }
 
+bool Message::ParseFromArray(const void* data, int size) {
+    mCachedSize = 0;
+    const uint8* bytes = (const uint8*)data;
+    uint32 header_size = 0, payload_start = 0;
+    if (size > 0 && findTrailingPayload(bytes, size, &header_size, &payload_start)) {
+        // Only the header goes through the parser, and the payload is copied
+        // straight out of the wire data.
+        if (!mImpl.ParseFromArray(data, header_size))
+            return false;
+        mPayload.assign((const char*)bytes + payload_start, size - payload_start);
+        return true;
+    }
+
+    // No payload, or it isn't where we expect it. Parse the whole thing and
+    // split it up, which also keeps only the last payload if there are
+    // several, like any other parser would.
+    Sirikata::Protocol::Server::ServerMessage full;
+    if (!full.ParseFromArray(data, size))
+        return false;
+    mImpl.set_source_server(full.source_server());
+    mImpl.set_source_port(full.source_port());
+    mImpl.set_dest_server(full.dest_server());
+    mImpl.set_dest_port(full.dest_port());
+    if (full.has_id())
+        mImpl.set_id(full.id());
+    if (full.has_payload_id())
+        mImpl.set_payload_id(full.payload_id());
+    mPayload = full.payload();
+    return true;
+}
+
+bool Message::serializeHeader(std::string* header_out) const {
+    if (!serializePBJMessage(header_out, mImpl))
+        return false;
+    if (!mPayload.empty()) {
+        header_out->push_back((char)PAYLOAD_TAG);
+        appendVarint(header_out, mPayload.size());
+    }
+    return true;
+}
+
 bool Message::serialize(Network::Chunk* output) const {
-    // FIXME having to copy here sucks
-    std::string result;
-    bool success = serializePBJMessage(&result, mImpl);
-    if (!success) return false;
-    output->resize( result.size() );
-    memcpy(&((*output)[0]), &(result[0]), sizeof(uint8)*result.size());
+    std::string header;
+    if (!serializeHeader(&header))
+        return false;
+    output->resize( header.size() + mPayload.size() );
+    if (!header.empty())
+        memcpy(&((*output)[0]), header.data(), header.size());
+    if (!mPayload.empty())
+        memcpy(&((*output)[header.size()]), mPayload.data(), mPayload.size());
     return true;
 }
 static char toHex(unsigned char u) {
@@ -124,7 +260,10 @@ uint32 Message::serializedSize() const {
     if (mCachedSize != 0)
         return mCachedSize;
 
-    return (mCachedSize = mImpl.ByteSize());
+    uint32 size = mImpl.ByteSize();
+    if (!mPayload.empty())
+        size += 1 + varintSize(mPayload.size()) + mPayload.size();
+    return (mCachedSize = size);
 }
 
 
@@ -41,6 +41,7 @@ SpaceContext::SpaceContext(const String& name, ServerID _id, ODPSST::ConnectionM
    mID(_id),
    mServerRouter(NULL),
    mServerDispatcher(NULL),
+   mMigrationDataClients(NULL),
    mSSTConnMgr(sstConnMgr),
    mOHSSTConnMgr(ohSstConnMgr),
    mSpaceTrace( new SpaceTrace(_trace) )
@@ -237,6 +237,18 @@ CREATE_TRACE_DEF(SpaceTrace, objectMigrationRoundTrip, mLogMigration, const Time
     mTrace->writeRecord(MigrationRoundTripTag, rt);
 }
 
+CREATE_TRACE_DEF(SpaceTrace, objectMigrationPause, mLogMigration, const Time& t, const UUID& obj_id, const ServerID &migrate_from, const ServerID& migrate_to, const Duration& pause)
+{
+    Sirikata::Trace::Migration::Pause rec;
+    rec.set_t(t);
+    rec.set_object(obj_id);
+    rec.set_from(migrate_from);
+    rec.set_toward(migrate_to);
+    rec.set_pause(pause);
+
+    mTrace->writeRecord(MigrationPauseTag, rec);
+}
+
 // Datagram
 
 CREATE_TRACE_DEF(SpaceTrace, serverDatagramQueued, mLogDatagram, const Time& t, const ServerID& dest, uint64 id, uint32 size) {
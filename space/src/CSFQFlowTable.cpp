@@ -0,0 +1,158 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "CSFQFlowTable.hpp"
+
+namespace Sirikata {
+
+namespace {
+const uint32 MIN_CAPACITY = 64;
+
+// Capacity needed to hold num flows at no more than half full
+uint32 capacityFor(uint32 num) {
+    uint32 cap = MIN_CAPACITY;
+    while(cap < num * 2)
+        cap *= 2;
+    return cap;
+}
+}
+
+CSFQFlowTable::Removed::Removed()
+ : count(0),
+   weight(0),
+   rate(0)
+{
+    for(int i = 0; i < NUM_DOWNSTREAM; i++)
+        usedWeight[i] = 0;
+}
+
+CSFQFlowTable::CSFQFlowTable()
+ : mMask(0),
+   mSize(0)
+{
+    rehash(MIN_CAPACITY);
+}
+
+uint64 CSFQFlowTable::pairHash(const UUID& source, const UUID& dest) {
+    // Rotate one side so that (a,b) and (b,a) land in different places
+    uint64 d = dest.hash64();
+    uint64 h = source.hash64() ^ ((d << 31) | (d >> 33));
+    h ^= h >> 32;
+    h *= 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 29;
+    return (h == 0) ? 1 : h;
+}
+
+uint32 CSFQFlowTable::probe(uint64 hash, const UUID& source, const UUID& dest) const {
+    uint32 idx = (uint32)hash & mMask;
+    while(true) {
+        uint64 slot_hash = mHashes[idx];
+        if (slot_hash == 0)
+            return idx;
+        if (slot_hash == hash && mFlows[idx].source == source && mFlows[idx].dest == dest)
+            return idx;
+        idx = (idx + 1) & mMask;
+    }
+}
+
+CSFQFlowTable::Flow* CSFQFlowTable::find(const UUID& source, const UUID& dest) {
+    uint32 idx = probe(pairHash(source, dest), source, dest);
+    return (mHashes[idx] != 0) ? &mFlows[idx] : NULL;
+}
+
+CSFQFlowTable::Flow* CSFQFlowTable::insert(const UUID& source, const UUID& dest, const Time& t, bool* added) {
+    uint64 hash = pairHash(source, dest);
+    uint32 idx = probe(hash, source, dest);
+    if (mHashes[idx] != 0) {
+        *added = false;
+        return &mFlows[idx];
+    }
+
+    // Keep the table at most 3/4 full so probe sequences stay short
+    if ((mSize + 1) * 4 > capacity() * 3) {
+        rehash(capacity() * 2);
+        idx = probe(hash, source, dest);
+    }
+
+    Flow& flow = mFlows[idx];
+    flow.source = source;
+    flow.dest = dest;
+    flow.rate = RateEstimator(0.0, t);
+    flow.lastActive = t;
+    flow.weight = 0;
+    for(int i = 0; i < NUM_DOWNSTREAM; i++)
+        flow.usedWeight[i] = 0;
+#ifdef CSFQODP_DEBUG
+    flow.arrived = 0;
+    flow.accepted = 0;
+#endif
+    mHashes[idx] = hash;
+    mSize++;
+    *added = true;
+    return &flow;
+}
+
+void CSFQFlowTable::removeIdle(const Time& cutoff, Removed* removed_out) {
+    uint32 cap = capacity();
+    uint32 removed = 0;
+    for(uint32 idx = 0; idx < cap; idx++) {
+        if (mHashes[idx] == 0 || !(mFlows[idx].lastActive < cutoff))
+            continue;
+        const Flow& flow = mFlows[idx];
+        removed++;
+        removed_out->weight += flow.weight;
+        for(int i = 0; i < NUM_DOWNSTREAM; i++)
+            removed_out->usedWeight[i] += flow.usedWeight[i];
+        removed_out->rate += flow.rate.get();
+    }
+    if (removed == 0)
+        return;
+    removed_out->count += removed;
+
+    // Deleting in place would break the probe sequences of the flows after
+    // each removed one, so rebuild with only the survivors. This also shrinks
+    // the table back down after a burst of short lived flows.
+    std::vector<uint64> old_hashes;
+    std::vector<Flow> old_flows;
+    old_hashes.swap(mHashes);
+    old_flows.swap(mFlows);
+    mSize -= removed;
+    mHashes.resize(capacityFor(mSize), 0);
+    mFlows.resize(mHashes.size());
+    mMask = (uint32)mHashes.size() - 1;
+    for(uint32 idx = 0; idx < cap; idx++) {
+        if (old_hashes[idx] == 0 || old_flows[idx].lastActive < cutoff)
+            continue;
+        uint32 new_idx = probe(old_hashes[idx], old_flows[idx].source, old_flows[idx].dest);
+        mHashes[new_idx] = old_hashes[idx];
+        mFlows[new_idx] = old_flows[idx];
+    }
+}
+
+void CSFQFlowTable::clear() {
+    mHashes.clear();
+    mFlows.clear();
+    mSize = 0;
+    rehash(MIN_CAPACITY);
+}
+
+void CSFQFlowTable::rehash(uint32 new_capacity) {
+    std::vector<uint64> old_hashes;
+    std::vector<Flow> old_flows;
+    old_hashes.swap(mHashes);
+    old_flows.swap(mFlows);
+
+    mHashes.resize(new_capacity, 0);
+    mFlows.resize(new_capacity);
+    mMask = new_capacity - 1;
+    for(uint32 idx = 0; idx < old_hashes.size(); idx++) {
+        if (old_hashes[idx] == 0)
+            continue;
+        uint32 new_idx = probe(old_hashes[idx], old_flows[idx].source, old_flows[idx].dest);
+        mHashes[new_idx] = old_hashes[idx];
+        mFlows[new_idx] = old_flows[idx];
+    }
+}
+
+} // namespace Sirikata
@@ -0,0 +1,99 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_CSFQ_FLOW_TABLE_HPP_
+#define _SIRIKATA_CSFQ_FLOW_TABLE_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/UUID.hpp>
+#include "RateEstimator.hpp"
+
+//#define CSFQODP_DEBUG
+
+namespace Sirikata {
+
+/** The per-flow state CSFQODPFlowScheduler keeps for each (source, dest)
+ *  object pair. Flows are stored inline in one open addressing table, probed
+ *  linearly over a parallel array of 64 bit pair hashes, so a lookup normally
+ *  reads one or two hashes and one flow record. Flows aren't removed
+ *  individually: removeIdle() drops every flow which hasn't seen traffic
+ *  recently in a single pass and reports what was removed so the scheduler
+ *  can fix up its totals once.
+ */
+class CSFQFlowTable {
+public:
+    enum {
+        SENDER = 0,
+        RECEIVER = 1,
+        NUM_DOWNSTREAM = 2
+    };
+
+    struct Flow {
+        UUID source;
+        UUID dest;
+        RateEstimator rate;
+        // Last time a packet for this flow arrived
+        Time lastActive;
+        double weight;
+        double usedWeight[NUM_DOWNSTREAM];
+#ifdef CSFQODP_DEBUG
+        uint64 arrived;
+        uint64 accepted;
+#endif
+    };
+
+    /** Sums over the flows removed by removeIdle(). */
+    struct Removed {
+        Removed();
+
+        uint32 count;
+        double weight;
+        double usedWeight[NUM_DOWNSTREAM];
+        double rate;
+    };
+
+    CSFQFlowTable();
+
+    uint32 size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    /** Hash over both full object IDs. Never 0, which marks an empty slot. */
+    static uint64 pairHash(const UUID& source, const UUID& dest);
+
+    /** Returns the flow for the pair, or NULL if there isn't one. */
+    Flow* find(const UUID& source, const UUID& dest);
+
+    /** Returns the flow for the pair, adding one if necessary. A new flow has
+     *  weight 0 and a rate estimate of 0 starting at t, and *added is set to
+     *  true. The pointer is only valid until the next call to insert or
+     *  removeIdle.
+     */
+    Flow* insert(const UUID& source, const UUID& dest, const Time& t, bool* added);
+
+    /** Removes all flows which haven't been active since cutoff, adding their
+     *  weights and rates to removed_out.
+     */
+    void removeIdle(const Time& cutoff, Removed* removed_out);
+
+    void clear();
+
+    // Slot access, for walking every flow. flowAt returns NULL for empty slots.
+    uint32 capacity() const { return (uint32)mHashes.size(); }
+    const Flow* flowAt(uint32 idx) const { return mHashes[idx] != 0 ? &mFlows[idx] : NULL; }
+
+private:
+    // Returns the slot holding the pair or the empty slot it would go in
+    uint32 probe(uint64 hash, const UUID& source, const UUID& dest) const;
+    void rehash(uint32 new_capacity);
+
+    // mHashes[i] is 0 if slot i is empty, otherwise the pair hash of mFlows[i]
+    std::vector<uint64> mHashes;
+    std::vector<Flow> mFlows;
+    uint32 mMask;
+    uint32 mSize;
+}; // class CSFQFlowTable
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_CSFQ_FLOW_TABLE_HPP_
@@ -42,6 +42,7 @@
 #define _Kcwin_double (_Ka.toSeconds())
 #define _Ka (Duration::milliseconds((int64)200))
 #define _Ka_double (_Ka.toSeconds())
+#define _Kidle (Duration::milliseconds((int64)30000)) // Flows idle this long are dropped
 
 #define KALPHA 29 // Max times fair rate can be decreased during interval
 
@@ -65,6 +66,7 @@ CSFQODPFlowScheduler::CSFQODPFlowScheduler(SpaceContext* ctx, ForwarderServiceQu
    mCongestionStartTime(Time::null()),
    mCongestionWindow(_Kcwin),
    mKAlphaReductionsLeft(KALPHA),
+   mLastIdleSweep(ctx->recentSimTime()),
    mTotalActiveWeight(0)
 {
     for(int i = 0; i < NUM_DOWNSTREAM; i++)
@@ -74,11 +76,12 @@ CSFQODPFlowScheduler::CSFQODPFlowScheduler(SpaceContext* ctx, ForwarderServiceQu
 CSFQODPFlowScheduler::~CSFQODPFlowScheduler() {
 #ifdef CSFQODP_DEBUG
     CSFQLOG(warn,"Flow");
-    for(FlowMap::iterator flow_it = mFlows.begin(); flow_it != mFlows.end(); flow_it++) {
-        ObjectPair op = flow_it->first;
-        const FlowInfo& fi = flow_it->second;
+    for(uint32 idx = 0; idx < mFlows.capacity(); idx++) {
+        const FlowInfo* fi_ptr = mFlows.flowAt(idx);
+        if (fi_ptr == NULL) continue;
+        const FlowInfo& fi = *fi_ptr;
         CSFQLOG(warn,"  " <<
-            "[" << op.source.toString() << ":" << op.dest.toString() << "] " <<
+            "[" << fi.source.toString() << ":" << fi.dest.toString() << "] " <<
             "weight: " << fi.weight <<
             " sused: " << fi.usedWeight[SENDER] <<
             " rused: " << fi.usedWeight[RECEIVER] <<
@@ -90,12 +93,14 @@ CSFQODPFlowScheduler::~CSFQODPFlowScheduler() {
 }
 
 // ODP push interface
-bool CSFQODPFlowScheduler::push(Sirikata::Protocol::Object::ObjectMessage* msg, const OSegEntry&source_entry, const OSegEntry& dest_entry) {
+bool CSFQODPFlowScheduler::push(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes, const OSegEntry&source_entry, const OSegEntry& dest_entry) {
     boost::lock_guard<boost::mutex> lck(mPushMutex); // FIXME
 
-    ObjectPair op(msg->source_object(), msg->dest_object());
     Time curtime = mContext->recentSimTime();
-    FlowInfo* flow_info = getFlow(op,source_entry,dest_entry, curtime);
+    if (curtime - mLastIdleSweep > _Kidle)
+        removeIdleFlows(curtime);
+    FlowInfo* flow_info = getFlow(msg->source_object(), msg->dest_object(), source_entry, dest_entry, curtime);
+    flow_info->lastActive = curtime;
 
     // FIXME update weights, due to possible movement?
     double weight = flow_info->weight;
@@ -105,7 +110,7 @@ bool CSFQODPFlowScheduler::push(Sirikata::Protocol::Object::ObjectMessage* msg,
         return false;
     }
 
-    int32 packet_size = msg->ByteSize();
+    int32 packet_size = msg_bytes ? (int32)msg_bytes->size() : msg->ByteSize();
 
 #ifdef CSFQODP_DEBUG
     flow_info->arrived += packet_size;
@@ -124,7 +129,7 @@ bool CSFQODPFlowScheduler::push(Sirikata::Protocol::Object::ObjectMessage* msg,
         // Compute label, updating the rate
         double old_rate = flow_info->rate.get();
         mSumEstimatedArrivalRates -= old_rate;
-        double est_flow_rate = flow_info->rate.estimate_rate(curtime, packet_size, _Kf_double);
+        double est_flow_rate = flow_info->rate.estimate_rate_approx(curtime, packet_size, _Kf_double);
         mSumEstimatedArrivalRates += est_flow_rate;
         double flow_rate =
             (mSumEstimatedArrivalRates == 0) ?
@@ -181,7 +186,7 @@ bool CSFQODPFlowScheduler::push(Sirikata::Protocol::Object::ObjectMessage* msg,
     //}
 
     // Try to enqueue.
-    Message* serv_msg = createMessageFromODP(msg, mDestServer);
+    Message* serv_msg = createMessageFromODP(msg, msg_bytes, mDestServer);
     QueuedMessage qmsg(serv_msg, packet_size);
     bool enqueue_success = mQueue.push(qmsg, false);
     // If we overflowed, drop and adjust alpha
@@ -371,36 +376,45 @@ BoundingBox3f CSFQODPFlowScheduler::getObjectWeightRegion(const UUID& objid, con
     return BoundingBox3f(server_bbox.center(), info.radius());
 }
 
-CSFQODPFlowScheduler::FlowInfo* CSFQODPFlowScheduler::getFlow(const ObjectPair& new_packet_pair, const OSegEntry&source_info, const OSegEntry&dst_info, const Time& t) {
-    FlowMap::iterator where = mFlows.find(new_packet_pair);
-    if (where==mFlows.end()) {
-        BoundingBox3f source_bbox = getObjectWeightRegion(new_packet_pair.source, source_info);
-        BoundingBox3f dest_bbox = getObjectWeightRegion(new_packet_pair.dest, dst_info);
+CSFQODPFlowScheduler::FlowInfo* CSFQODPFlowScheduler::getFlow(const UUID& source, const UUID& dest, const OSegEntry&source_info, const OSegEntry&dst_info, const Time& t) {
+    bool added = false;
+    FlowInfo* flow = mFlows.insert(source, dest, t, &added);
+    if (added) {
+        BoundingBox3f source_bbox = getObjectWeightRegion(source, source_info);
+        BoundingBox3f dest_bbox = getObjectWeightRegion(dest, dst_info);
 
         double weight = mWeightCalculator->weight(source_bbox, dest_bbox);
-
-        std::pair<FlowMap::iterator, bool> ins_it = mFlows.insert(FlowMap::value_type(new_packet_pair,FlowInfo(weight, t)));
-        assert(ins_it.second == true);
+        flow->weight = weight;
+        for(int i = 0; i < NUM_DOWNSTREAM; i++)
+            flow->usedWeight[i] = weight;
 
         mTotalActiveWeight += weight;
         for(int i = 0; i < NUM_DOWNSTREAM; i++)
             mTotalUsedWeight[i] += weight;
-
-        where = ins_it.first;
     }
-    return &(where->second);
+    return flow;
 }
 
-void CSFQODPFlowScheduler::removeFlow(const ObjectPair& packet_pair) {
-    FlowMap::iterator where = mFlows.find(packet_pair);
-    assert(where != mFlows.end());
-    assert(0);
-    FlowInfo* fi = &(where->second);
-    mTotalActiveWeight -= fi->weight;
+void CSFQODPFlowScheduler::removeIdleFlows(const Time& t) {
+    mLastIdleSweep = t;
+    CSFQFlowTable::Removed removed;
+    mFlows.removeIdle(t - _Kidle, &removed);
+    if (removed.count == 0)
+        return;
+
+    // Start from exact zeros when everything went idle rather than leaving
+    // accumulated rounding error behind
+    if (mFlows.empty()) {
+        mTotalActiveWeight = 0;
+        for(int i = 0; i < NUM_DOWNSTREAM; i++)
+            mTotalUsedWeight[i] = 0;
+        mSumEstimatedArrivalRates = 0;
+        return;
+    }
+    mTotalActiveWeight -= removed.weight;
     for(int i = 0; i < NUM_DOWNSTREAM; i++)
-        mTotalUsedWeight[i] -= fi->usedWeight[i];
-    fi = NULL;
-    mFlows.erase(where);
+        mTotalUsedWeight[i] -= removed.usedWeight[i];
+    mSumEstimatedArrivalRates -= removed.rate;
 }
 
 int CSFQODPFlowScheduler::flowCount() const {
@@ -36,10 +36,9 @@
 #include "ODPFlowScheduler.hpp"
 #include <sirikata/core/queue/Queue.hpp>
 #include "RateEstimator.hpp"
+#include "CSFQFlowTable.hpp"
 #include <sirikata/core/queue/SizedThreadSafeQueue.hpp>
 
-//#define CSFQODP_DEBUG
-
 namespace Sirikata {
 
 class LocationService;
@@ -60,7 +59,7 @@ public:
     virtual uint32 size() const { return mQueue.getResourceMonitor().filledSize(); }
 
     // ODP push interface
-    virtual bool push(Sirikata::Protocol::Object::ObjectMessage* msg, const OSegEntry&, const OSegEntry&);
+    virtual bool push(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes, const OSegEntry&, const OSegEntry&);
     // Get the sum of the weights of active queues.
     virtual float totalActiveWeight();
     // Get the total used weight of active queues.  If all flows are saturating,
@@ -72,57 +71,12 @@ public:
 private:
 
     enum {
-        SENDER = 0,
-        RECEIVER = 1,
-        NUM_DOWNSTREAM = 2
+        SENDER = CSFQFlowTable::SENDER,
+        RECEIVER = CSFQFlowTable::RECEIVER,
+        NUM_DOWNSTREAM = CSFQFlowTable::NUM_DOWNSTREAM
     };
 
-    struct ObjectPair {
-        ObjectPair(const UUID& s, const UUID& d)
-         : source(s), dest(d)
-        {}
-
-        bool operator<(const ObjectPair& rhs) const {
-            return (source < rhs.source || (source == rhs.source && dest < rhs.dest));
-        }
-
-        bool operator==(const ObjectPair& rhs) const {
-            return (source == rhs.source && dest == rhs.dest);
-        }
-
-        class Hasher {
-        public:
-            size_t operator() (const ObjectPair& op) const {
-                return *(uint32*)op.source.getArray().data() ^ *(uint32*)op.dest.getArray().data();
-            }
-        };
-
-        UUID source;
-        UUID dest;
-    };
-
-    struct FlowInfo {
-        FlowInfo(double w, const Time& start)
-         : rate(0.0, start),
-           weight(w)
-#ifdef CSFQODP_DEBUG
-           ,
-           arrived(0),
-           accepted(0)
-#endif
-        {
-            for(int i = 0; i < NUM_DOWNSTREAM; i++)
-                usedWeight[i] = w;
-        }
-
-        RateEstimator rate;
-        double weight;
-        double usedWeight[NUM_DOWNSTREAM];
-#ifdef CSFQODP_DEBUG
-        uint64 arrived;
-        uint64 accepted;
-#endif
-    };
+    typedef CSFQFlowTable::Flow FlowInfo;
 
     struct QueuedMessage {
         QueuedMessage()
@@ -141,8 +95,10 @@ private:
         int32 _size;
     };
 
-    FlowInfo* getFlow(const ObjectPair& new_packet_pair, const OSegEntry&src_info, const OSegEntry&dst_info, const Time& t);
-    void removeFlow(const ObjectPair& packet_pair);
+    FlowInfo* getFlow(const UUID& source, const UUID& dest, const OSegEntry&src_info, const OSegEntry&dst_info, const Time& t);
+    // Drops flows which haven't seen any traffic in a while, along with their
+    // contributions to the active weight and arrival rate totals
+    void removeIdleFlows(const Time& t);
     int flowCount() const;
     float normalizedFlowWeight(float unnorm_weight);
 
@@ -180,8 +136,8 @@ private:
     int mKAlphaReductionsLeft;
 
     // Per Flow Information
-    typedef std::tr1::unordered_map<ObjectPair, FlowInfo, ObjectPair::Hasher> FlowMap;
-    FlowMap mFlows;
+    CSFQFlowTable mFlows;
+    Time mLastIdleSweep;
     // Flow Summary Information
     double mTotalActiveWeight;
     double mTotalUsedWeight[NUM_DOWNSTREAM];
@@ -55,6 +55,7 @@
 #include "ODPFlowScheduler.hpp"
 #include "RegionODPFlowScheduler.hpp"
 #include "CSFQODPFlowScheduler.hpp"
+#include "ServerWeightCache.hpp"
 
 #include <sirikata/core/odp/DelegateService.hpp>
 
@@ -71,11 +72,11 @@ namespace Sirikata
 
 class ForwarderServerMessageRouter : public Router<Message*> {
   public:
-    ForwarderServerMessageRouter(ForwarderServiceQueue* svc_queues, ForwarderServiceQueue::ServiceID service_id)
+    ForwarderServerMessageRouter(ForwarderServiceQueue* svc_queues, ForwarderServiceQueue::ServiceID service_id, bool flow_controlled)
             : mForwarderServiceQueue(svc_queues),
               mServiceID(service_id)
     {
-        mForwarderServiceQueue->addService(service_id);
+        mForwarderServiceQueue->addService(service_id, 0, flow_controlled);
     }
 
     WARN_UNUSED
@@ -112,7 +113,9 @@ Forwarder::Forwarder(SpaceContext* ctx)
                  std::tr1::bind(&Forwarder::updateServerWeights, this),
                  "Forwarder::updateServerWeights",
                  Duration::milliseconds((int64)10)),
+             mServerWeights(new ServerWeightCache(ctx)),
              mReceivedMessages(Sirikata::SizedResourceMonitor(GetOptionValue<uint32>(FORWARDER_RECEIVE_QUEUE_SIZE))),
+             mCreditWindow(GetOptionValue<uint32>(FORWARDER_CREDIT_WINDOW)),
              mTimeSeriesPoller(
                  ctx->mainStrand,
                  std::tr1::bind(&Forwarder::reportStats, this),
@@ -122,9 +125,11 @@ Forwarder::Forwarder(SpaceContext* ctx)
              mTimeSeriesForwardedPerSecondName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".forwarded.remote"),
              mForwardedPerSecond(0),
              mTimeSeriesDroppedPerSecondName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".dropped.forwarder"),
-             mDroppedPerSecond(0)
+             mDroppedPerSecond(0),
+             mTimeSeriesCreditStallsPerSecondName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".forwarder.credit-stalls"),
+             mTimeSeriesCreditShedPerSecondName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".dropped.credit-stalled")
 {
-    mNullServerIDOSegCallback=std::tr1::bind(&Forwarder::routeObjectMessageToServerNoReturn, this, std::tr1::placeholders::_1, std::tr1::placeholders::_2,std::tr1::placeholders:: _3, NullServerID);
+    mNullServerIDOSegCallback=std::tr1::bind(&Forwarder::routeObjectMessageToServerNoReturn, this, std::tr1::placeholders::_1, std::tr1::placeholders::_2,std::tr1::placeholders:: _3, std::tr1::placeholders::_4, NullServerID);
     mOutgoingMessages = new ForwarderServiceQueue(mContext->id(), GetOptionValue<uint32>(FORWARDER_SEND_QUEUE_SIZE), (ForwarderServiceQueue::Listener*)this);
 
     // Messages destined for objects are subscribed to here so we can easily pick them
@@ -136,7 +141,8 @@ Forwarder::Forwarder(SpaceContext* ctx)
     // NOTE: See addODPServerMessageService(loc); in initialize.  We need loc
     // for it so we can't do it here.
     mOSegCacheUpdateRouter = createServerMessageService("oseg-cache-update");
-    mForwarderWeightRouter = createServerMessageService("forwarder-weights");
+    // Weight updates carry flow control credits, so they can't wait for them
+    mForwarderWeightRouter = createServerMessageService("forwarder-weights", false);
 }
 
   //Don't need to do anything special for destructor
@@ -154,6 +160,7 @@ Forwarder::Forwarder(SpaceContext* ctx)
 
       delete mOutgoingMessages;
       delete mOSegLookups;
+      delete mServerWeights;
   }
 
   /*
@@ -166,6 +173,8 @@ void Forwarder::initialize(ObjectSegmentation* oseg, ServerMessageQueue* smq, Se
     mOSegLookups = new OSegLookupQueue(mContext->mainStrand, oseg);
     mServerMessageQueue = smq;
     mServerMessageReceiver = smr;
+
+    mContext->cseg()->addListener(mServerWeights);
 }
 
 void Forwarder::setODPService(ODP::DelegateService* odp) {
@@ -198,6 +207,8 @@ void Forwarder::start() {
 void Forwarder::stop() {
     mServerWeightPoller.stop();
     mTimeSeriesPoller.stop();
+    // The segmentation service is destroyed before we are
+    mContext->cseg()->removeListener(mServerWeights);
 }
 
 void Forwarder::reportStats() {
@@ -215,6 +226,14 @@ void Forwarder::reportStats() {
         mDroppedPerSecond.read() / since_last_seconds
     );
     mDroppedPerSecond = 0;
+    mContext->timeSeries->report(
+        mTimeSeriesCreditStallsPerSecondName,
+        mOutgoingMessages->takeCreditStalls() / since_last_seconds
+    );
+    mContext->timeSeries->report(
+        mTimeSeriesCreditShedPerSecondName,
+        mOutgoingMessages->takeCreditSheds() / since_last_seconds
+    );
 }
 
 // -- Object Connection Management - Object connections are available locally,
@@ -290,7 +309,7 @@ ODPFlowScheduler* Forwarder::createODPFlowScheduler(LocationService* loc, Server
 
     if (flow_sched_type == "region") {
         new_flow_scheduler =
-            new RegionODPFlowScheduler(mContext, mOutgoingMessages, remote_server, mServiceIDMap[ODP_SERVER_MESSAGE_SERVICE], max_size);
+            new RegionODPFlowScheduler(mContext, mOutgoingMessages, remote_server, mServiceIDMap[ODP_SERVER_MESSAGE_SERVICE], max_size, mServerWeights);
     }
     else if (flow_sched_type == "csfq") {
         new_flow_scheduler =
@@ -332,6 +351,19 @@ void Forwarder::updateServerWeights() {
         weight_update.set_receiver_total_weight( receiver_total_weight );
         weight_update.set_receiver_capacity( receiver_capacity );
 
+        // Return credits for everything we've consumed from that server
+        if (mCreditWindow > 0) {
+            weight_update.set_credit_window(mCreditWindow);
+            boost::lock_guard<boost::mutex> lock(mReceivedMessagesMutex);
+            ConsumedByServer::iterator consumed_it = mConsumed.find(serv_id);
+            if (consumed_it != mConsumed.end()) {
+                for(ConsumedByPort::iterator port_it = consumed_it->second.begin(); port_it != consumed_it->second.end(); port_it++) {
+                    weight_update.add_credit_port(port_it->first);
+                    weight_update.add_credit_consumed(port_it->second);
+                }
+            }
+        }
+
         SILOG(forwarder,insane,"Sending weights: " << mContext->id() << " -> " << serv_id <<
             " odp_total_weight: " << odp_total_weight <<
             " odp_sender_used_weight: " << odp_sender_used_weight <<
@@ -362,12 +394,16 @@ void Forwarder::updateServerWeights() {
 }
 
 Router<Message*>* Forwarder::createServerMessageService(const String& name) {
+    return createServerMessageService(name, true);
+}
+
+Router<Message*>* Forwarder::createServerMessageService(const String& name, bool flow_controlled) {
     ServiceMap::iterator it = mServiceIDMap.find(name);
     assert(it == mServiceIDMap.end());
 
     ForwarderServiceQueue::ServiceID svc_id = mServiceIDSource++;
     mServiceIDMap[name] = svc_id;
-    return new ForwarderServerMessageRouter(mOutgoingMessages, svc_id);
+    return new ForwarderServerMessageRouter(mOutgoingMessages, svc_id, flow_controlled);
 }
 
 void Forwarder::forwarderServiceMessageReady(ServerID dest_server) {
@@ -382,14 +418,14 @@ void Forwarder::forwarderServiceMessageReady(ServerID dest_server) {
 // -- messages.  Sources include object hosts and other space servers.
 
 // --- From object hosts
-void Forwarder::routeObjectHostMessage(Sirikata::Protocol::Object::ObjectMessage* obj_msg) {
+void Forwarder::routeObjectHostMessage(Sirikata::Protocol::Object::ObjectMessage* obj_msg, const ObjectMessageBytesPtr& obj_msg_bytes) {
     // Messages destined for the space skip the object message queue and just get dispatched
     if (obj_msg->dest_object() == UUID::null()) {
         dispatchMessage(obj_msg);
         return;
     }
 
-    bool forwarded = forward(obj_msg);
+    bool forwarded = forward(obj_msg, obj_msg_bytes);
     if (!forwarded) {
         mDroppedPerSecond++;
         TIMESTAMP(obj_msg, Trace::DROPPED_DURING_FORWARDING);
@@ -413,8 +449,11 @@ void Forwarder::receiveMessage(Message* msg) {
 }
 
 void Forwarder::receiveObjectRoutingMessage(Message* msg) {
+    // Keep the payload so that if we pass the message along it goes out
+    // exactly as it came in
+    ObjectMessageBytesPtr obj_msg_bytes(new std::string(msg->payload()));
     Sirikata::Protocol::Object::ObjectMessage* obj_msg = new Sirikata::Protocol::Object::ObjectMessage();
-    bool parsed = parsePBJMessage(obj_msg, msg->payload());
+    bool parsed = parsePBJMessage(obj_msg, *obj_msg_bytes);
     if (!parsed) {
         LOG_INVALID_MESSAGE(forwarder, error, msg->payload());
         delete obj_msg;
@@ -434,7 +473,7 @@ void Forwarder::receiveObjectRoutingMessage(Message* msg) {
 
 
     // Otherwise, try to forward it
-    bool forward_success = forward(obj_msg, msg->source_server());
+    bool forward_success = forward(obj_msg, obj_msg_bytes, msg->source_server());
 
     if (!forward_success) {
         mDroppedPerSecond++;
@@ -473,6 +512,16 @@ void Forwarder::receiveWeightUpdateMessage(Message* msg) {
         weight_update.server_pair_used_weight()
     );
 
+    ForwarderServiceQueue::ConsumedList consumed;
+    int32 num_credits = std::min(weight_update.credit_port_size(), weight_update.credit_consumed_size());
+    for(int32 i = 0; i < num_credits; i++)
+        consumed.push_back( std::make_pair((uint16)weight_update.credit_port(i), weight_update.credit_consumed(i)) );
+    mOutgoingMessages->updateCredits(
+        source,
+        weight_update.has_credit_window() ? weight_update.credit_window() : 0,
+        consumed
+    );
+
     ODPFlowScheduler* serv_flow_sched = NULL;
     {
         boost::lock_guard<boost::recursive_mutex> lck(mODPRouterMapMutex);
@@ -501,7 +550,7 @@ void Forwarder::receiveWeightUpdateMessage(Message* msg) {
 // -- Real Routing - Given an object message, from any source, decide where it
 // -- needs to go and send it out in that direction.
 
-bool Forwarder::forward(Sirikata::Protocol::Object::ObjectMessage* msg, ServerID forwardFrom)
+bool Forwarder::forward(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes, ServerID forwardFrom)
 {
     TIMESTAMP_START(tstamp, msg);
     TIMESTAMP_END(tstamp, Trace::FORWARDING_STARTED);
@@ -515,15 +564,15 @@ bool Forwarder::forward(Sirikata::Protocol::Object::ObjectMessage* msg, ServerID
     TIMESTAMP_END(tstamp, Trace::OSEG_LOOKUP_STARTED);
 
     bool accepted = mOSegLookups->lookup(
-        msg,
-        (forwardFrom==NullServerID?mNullServerIDOSegCallback:std::tr1::bind(&Forwarder::routeObjectMessageToServerNoReturn, this, std::tr1::placeholders::_1, std::tr1::placeholders::_2,std::tr1::placeholders:: _3, forwardFrom))
+        msg, msg_bytes,
+        (forwardFrom==NullServerID?mNullServerIDOSegCallback:std::tr1::bind(&Forwarder::routeObjectMessageToServerNoReturn, this, std::tr1::placeholders::_1, std::tr1::placeholders::_2,std::tr1::placeholders:: _3, std::tr1::placeholders::_4, forwardFrom))
     );
 
     return accepted;
 }
 
 WARN_UNUSED
-bool Forwarder::tryCacheForward(Sirikata::Protocol::Object::ObjectMessage* msg) {
+bool Forwarder::tryCacheForward(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes) {
     TIMESTAMP_START(tstamp, msg);
 
     TIMESTAMP_END(tstamp, Trace::OSEG_CACHE_CHECK_STARTED);
@@ -536,15 +585,15 @@ bool Forwarder::tryCacheForward(Sirikata::Protocol::Object::ObjectMessage* msg)
         return false;
 
     // Use normal routing mechanism if we have a non-local dest
-    bool send_success = routeObjectMessageToServer(msg, destserver, OSegLookupQueue::ResolvedFromCache, NullServerID);
+    bool send_success = routeObjectMessageToServer(msg, msg_bytes, destserver, OSegLookupQueue::ResolvedFromCache, NullServerID);
     return true; // If we got here, the cache was successful, we just dropped it.
 }
 
-void Forwarder::routeObjectMessageToServerNoReturn(Sirikata::Protocol::Object::ObjectMessage* obj_msg, const OSegEntry &dest_serv, OSegLookupQueue::ResolvedFrom resolved_from, ServerID forwardFrom) {
-    (void) routeObjectMessageToServer(obj_msg, dest_serv, resolved_from, forwardFrom);
+void Forwarder::routeObjectMessageToServerNoReturn(Sirikata::Protocol::Object::ObjectMessage* obj_msg, const ObjectMessageBytesPtr& obj_msg_bytes, const OSegEntry &dest_serv, OSegLookupQueue::ResolvedFrom resolved_from, ServerID forwardFrom) {
+    (void) routeObjectMessageToServer(obj_msg, obj_msg_bytes, dest_serv, resolved_from, forwardFrom);
 }
 
-bool Forwarder::routeObjectMessageToServer(Sirikata::Protocol::Object::ObjectMessage* obj_msg, const OSegEntry &dest_serv, OSegLookupQueue::ResolvedFrom resolved_from, ServerID forwardFrom)
+bool Forwarder::routeObjectMessageToServer(Sirikata::Protocol::Object::ObjectMessage* obj_msg, const ObjectMessageBytesPtr& obj_msg_bytes, const OSegEntry &dest_serv, OSegLookupQueue::ResolvedFrom resolved_from, ServerID forwardFrom)
 {
     Trace::MessagePath mp = (resolved_from == OSegLookupQueue::ResolvedFromCache)
         ? Trace::OSEG_CACHE_LOOKUP_FINISHED
@@ -592,7 +641,7 @@ bool Forwarder::routeObjectMessageToServer(Sirikata::Protocol::Object::ObjectMes
   if (source_object_data.isNull()) {
       source_object_data=OSegEntry(mContext->id(),1.0);//FIXME dumb default: RADIUS of reforwarded messages are 1.0
   }
-  bool send_success = flow_sched->push(obj_msg,source_object_data,dest_serv);
+  bool send_success = flow_sched->push(obj_msg,obj_msg_bytes,source_object_data,dest_serv);
   if (!send_success) {
       mDroppedPerSecond++;
       TIMESTAMP(obj_msg, Trace::DROPPED_AT_SPACE_ENQUEUED);
@@ -662,10 +711,13 @@ void Forwarder::serverMessageReceived(Message* msg) {
 
     // Routing, check if we can route immediately.
     if (msg->dest_port() == SERVER_PORT_OBJECT_MESSAGE_ROUTING) {
+        ObjectMessageBytesPtr obj_msg_bytes(new std::string(msg->payload()));
         Sirikata::Protocol::Object::ObjectMessage* obj_msg = new Sirikata::Protocol::Object::ObjectMessage();
-        bool parsed = parsePBJMessage(obj_msg, msg->payload());
+        bool parsed = parsePBJMessage(obj_msg, *obj_msg_bytes);
         if (!parsed) {
             LOG_INVALID_MESSAGE(forwarder, error, msg->payload());
+            // Dropped, but the sender still needs its credits back
+            messageConsumed(msg);
             delete obj_msg;
             delete msg;
             return;
@@ -675,7 +727,8 @@ void Forwarder::serverMessageReceived(Message* msg) {
         // handling OH messages.  We should probably merge them....
 
         // Local
-        if (mLocalForwarder->tryForward(obj_msg)) {
+        if (mLocalForwarder->tryForward(obj_msg, obj_msg_bytes)) {
+            messageConsumed(msg);
             delete msg;
             return;
         }
@@ -684,7 +737,8 @@ void Forwarder::serverMessageReceived(Message* msg) {
         // 4. Try to shortcut them main thread. Use forwarder to try to forward
         // using the cache. FIXME when we do this, we skip over some checks that
         // happen during the full forwarding
-        if (tryCacheForward(obj_msg)) {
+        if (tryCacheForward(obj_msg, obj_msg_bytes)) {
+            messageConsumed(msg);
             delete msg;
             return;
         }
@@ -699,6 +753,9 @@ void Forwarder::serverMessageReceived(Message* msg) {
         boost::lock_guard<boost::mutex> lock(mReceivedMessagesMutex);
         got_empty = mReceivedMessages.probablyEmpty();
         push_success = mReceivedMessages.push(msg, false);
+        // Dropped messages still need their credits returned
+        if (!push_success)
+            messageConsumedLocked(msg);
     }
 
     if (!push_success) {
@@ -710,6 +767,26 @@ void Forwarder::serverMessageReceived(Message* msg) {
         scheduleProcessReceivedServerMessages();
 }
 
+void Forwarder::messageConsumed(const Message* msg) {
+    boost::lock_guard<boost::mutex> lock(mReceivedMessagesMutex);
+    messageConsumedLocked(msg);
+}
+
+void Forwarder::messageConsumedLocked(const Message* msg) {
+    // Weight updates aren't flow controlled, see the constructor
+    if (msg->dest_port() == SERVER_PORT_FORWARDER_WEIGHT_UPDATE)
+        return;
+    mConsumed[msg->source_server()][msg->dest_port()] += msg->serializedSize();
+}
+
+void Forwarder::onSpaceNetworkConnected(ServerID sid) {
+    mOutgoingMessages->resetCredits(sid);
+}
+
+void Forwarder::onSpaceNetworkDisconnected(ServerID sid) {
+    mOutgoingMessages->resetCredits(sid);
+}
+
 void Forwarder::scheduleProcessReceivedServerMessages() {
     mContext->mainStrand->post(
         std::tr1::bind(&Forwarder::processReceivedServerMessages, this),
@@ -729,6 +806,7 @@ void Forwarder::processReceivedServerMessages() {
         while(!mReceivedMessages.probablyEmpty() && pulled < MAX_RECEIVED_MESSAGES_PROCESSED) {
             bool popped = mReceivedMessages.pop( messages[pulled] );
             if (!popped) break;
+            messageConsumedLocked(messages[pulled]);
             pulled++;
         }
         got_empty = mReceivedMessages.probablyEmpty();
@@ -37,6 +37,7 @@
 #include <sirikata/space/SpaceContext.hpp>
 #include <sirikata/space/ServerMessage.hpp>
 #include <sirikata/space/SpaceNetwork.hpp>
+#include <sirikata/core/util/UUIDFlatMap.hpp>
 
 #include <sirikata/core/queue/Queue.hpp>
 #include <sirikata/core/queue/FairQueue.hpp>
@@ -66,6 +67,7 @@ namespace Trace {
   class OSegLookupQueue;
 class ForwarderServiceQueue;
 class ODPFlowScheduler;
+class ServerWeightCache;
 class LocationService;
 class LocalForwarder;
 
@@ -79,6 +81,7 @@ class Forwarder : public ServerMessageDispatcher,
                     public ServerMessageQueue::Sender,
                   public ServerMessageReceiver::Listener,
                   private ForwarderServiceQueue::Listener,
+                  public SpaceNetworkConnectionListener,
                   public Service
 {
 private:
@@ -105,7 +108,7 @@ private:
       uint64 id;
       ObjectConnection* conn;
     };
-    typedef std::tr1::unordered_map<UUID, UniqueObjConn, UUID::Hasher> ObjectConnectionMap;
+    typedef UUIDFlatMap<UniqueObjConn> ObjectConnectionMap;
     ObjectConnectionMap mObjectConnections;
     OSegLookupQueue::LookupCallback mNullServerIDOSegCallback;
     typedef std::vector<ServerID> ListServersUpdate;
@@ -126,6 +129,9 @@ private:
     ODPRouterMap mODPRouters;
     Poller mServerWeightPoller; // For updating ServerMessageQueue, remote
                                 // ServerMessageReceiver with per-server weights
+    // Region weights between this server and each remote server, shared by
+    // the RegionODPFlowSchedulers
+    ServerWeightCache* mServerWeights;
 
     // Note: This is kinda stupid, but we need to protect this thread safe queue
     // with another lock because we don't have a sized thread safe queue with
@@ -133,12 +139,25 @@ private:
     boost::mutex mReceivedMessagesMutex;
     Sirikata::SizedThreadSafeQueue<Message*> mReceivedMessages;
 
+    // Flow control credits we grant other servers: the total bytes of their
+    // messages taken out of our queues, by source server and destination
+    // port. Reported back with weight updates. Protected by
+    // mReceivedMessagesMutex.
+    typedef std::map<uint16, uint64> ConsumedByPort;
+    typedef std::tr1::unordered_map<ServerID, ConsumedByPort> ConsumedByServer;
+    ConsumedByServer mConsumed;
+    // Window granted to each other server, per service. 0 disables flow
+    // control.
+    uint32 mCreditWindow;
+
     Poller mTimeSeriesPoller;
     Time mLastStatsTime;
     const String mTimeSeriesForwardedPerSecondName;
     AtomicValue<uint32> mForwardedPerSecond;
     const String mTimeSeriesDroppedPerSecondName;
     AtomicValue<uint32> mDroppedPerSecond;
+    const String mTimeSeriesCreditStallsPerSecondName;
+    const String mTimeSeriesCreditShedPerSecondName;
 
     // -- Boiler plate stuff - initialization, destruction, methods to satisfy interfaces
   public:
@@ -173,12 +192,15 @@ private:
     // -- Public routing interface
   public:
     virtual Router<Message*>* createServerMessageService(const String& name);
+  private:
+    Router<Message*>* createServerMessageService(const String& name, bool flow_controlled);
+  public:
 
     // Used only by Server.  Called from networking thready to try to forward
     // quickly (avoiding going through OSeg Lookup Queue) by checking OSeg
-    // cache.
+    // cache. msg_bytes are the bytes msg was parsed from, if any.
     WARN_UNUSED
-    bool tryCacheForward(Sirikata::Protocol::Object::ObjectMessage* msg);
+    bool tryCacheForward(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes);
 
     // -- Real routing interface + implementation
 
@@ -186,8 +208,9 @@ private:
     // --- Inputs
   public:
     // Received from OH networking, needs forwarding decision.  Forwards or
-    // drops -- ownership is given to Forwarder either way
-    void routeObjectHostMessage(Sirikata::Protocol::Object::ObjectMessage* obj_msg);
+    // drops -- ownership is given to Forwarder either way. obj_msg_bytes are
+    // the bytes obj_msg was received as, and are what gets forwarded.
+    void routeObjectHostMessage(Sirikata::Protocol::Object::ObjectMessage* obj_msg, const ObjectMessageBytesPtr& obj_msg_bytes);
   private:
     // Received from other space server, needs forwarding decision
     void receiveMessage(Message* msg);
@@ -200,15 +223,17 @@ private:
 
     /** Try to forward a message to get it closer to the destination object.
      *  This checks if we have a direct connection to the object, then does an
-     *  OSeg lookup if necessary.
+     *  OSeg lookup if necessary. msg_bytes are the bytes msg was parsed from,
+     *  which are sent on in place of reserializing msg, or NULL if msg was
+     *  built locally.
      */
     WARN_UNUSED
-    bool forward(Sirikata::Protocol::Object::ObjectMessage* msg, ServerID forwardFrom = NullServerID);
+    bool forward(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes, ServerID forwardFrom = NullServerID);
 
     // This version is provided if you already know which server the message should be sent to
-    void routeObjectMessageToServerNoReturn(Sirikata::Protocol::Object::ObjectMessage* msg, const OSegEntry& dest_serv, OSegLookupQueue::ResolvedFrom resolved_from, ServerID forwardFrom = NullServerID);
+    void routeObjectMessageToServerNoReturn(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes, const OSegEntry& dest_serv, OSegLookupQueue::ResolvedFrom resolved_from, ServerID forwardFrom = NullServerID);
     WARN_UNUSED
-    bool routeObjectMessageToServer(Sirikata::Protocol::Object::ObjectMessage* msg, const OSegEntry& dest_serv, OSegLookupQueue::ResolvedFrom resolved_from, ServerID forwardFrom = NullServerID);
+    bool routeObjectMessageToServer(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes, const OSegEntry& dest_serv, OSegLookupQueue::ResolvedFrom resolved_from, ServerID forwardFrom = NullServerID);
 
     // Dispatches a message destined for the space server itself
     void dispatchMessage(Sirikata::Protocol::Object::ObjectMessage* msg) const;
@@ -227,9 +252,20 @@ private:
     void scheduleProcessReceivedServerMessages();
     void processReceivedServerMessages();
 
+    // Credit a received message as consumed. The locked version requires
+    // mReceivedMessagesMutex.
+    void messageConsumed(const Message* msg);
+    void messageConsumedLocked(const Message* msg);
+
     // ForwarderServiceQueue::Listener Interface (passed on to ServerMessageQueue)
     virtual void forwarderServiceMessageReady(ServerID dest_server);
 
+    // SpaceNetworkConnectionListener Interface. Messages in flight when a
+    // connection comes or goes may never be reported as consumed, so these
+    // reset the flow control credits for the server.
+    virtual void onSpaceNetworkConnected(ServerID sid);
+    virtual void onSpaceNetworkDisconnected(ServerID sid);
+
 
     // -- Object Connection Management used by Server
   public:
@@ -39,7 +39,9 @@ namespace Sirikata {
 ForwarderServiceQueue::ForwarderServiceQueue(ServerID this_server, uint32 size, Listener* listener)
         : mThisServer(this_server),
           mQueueSize(size),
-          mListener(listener)
+          mListener(listener),
+          mCreditStalls(0),
+          mCreditSheds(0)
 {
 }
 
@@ -51,8 +53,10 @@ ForwarderServiceQueue::~ForwarderServiceQueue() {
     }
 }
 
-void ForwarderServiceQueue::addService(ServiceID svc, MessageQueueCreator creator) {
+void ForwarderServiceQueue::addService(ServiceID svc, MessageQueueCreator creator, bool flow_controlled) {
     mQueueCreators[svc] = creator;
+    if (!flow_controlled)
+        mUncontrolledServices.insert(svc);
 }
 
 Message* ForwarderServiceQueue::front(ServerID sid) {
@@ -65,7 +69,12 @@ Message* ForwarderServiceQueue::front(ServerID sid) {
 Message* ForwarderServiceQueue::pop(ServerID sid) {
     boost::lock_guard<boost::mutex> lock(mMutex);
 
-    return getServerFairQueue(sid)->pop();
+    OutgoingFairQueue* ofq = getServerFairQueue(sid);
+    ServiceID svc;
+    Message* msg = ofq->pop(&svc);
+    if (msg != NULL)
+        chargeCredits(sid, svc, msg, ofq);
+    return msg;
 }
 
 bool ForwarderServiceQueue::empty(ServerID sid) {
@@ -85,6 +94,8 @@ QueueEnum::PushResult ForwarderServiceQueue::push(ServiceID svc, Message* msg) {
         boost::lock_guard<boost::mutex> lock(mMutex);
         OutgoingFairQueue* ofq = checkServiceQueue(getServerFairQueue(msg->dest_server()), svc);
         success = ofq->push(svc, msg);
+        if (success != QueueEnum::PushSucceeded && creditStalled(dest_server, svc))
+            mCreditSheds++;
     }
     if (success == QueueEnum::PushSucceeded)
         mListener->forwarderServiceMessageReady(dest_server);
@@ -112,6 +123,146 @@ uint32 ForwarderServiceQueue::size(ServerID sid, ServiceID svc) {
     return checkServiceQueue(getServerFairQueue(sid), svc)->size(svc);
 }
 
+void ForwarderServiceQueue::updateCredits(ServerID sid, uint64 window, const ConsumedList& consumed) {
+    bool unstalled = false;
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+
+        ServerCredits& credits = mCredits[sid];
+        credits.window = window;
+
+        for(ConsumedList::const_iterator it = consumed.begin(); it != consumed.end(); it++) {
+            PortCredits& port = credits.ports[it->first];
+            // Without a base to compare to, e.g. because we restarted or the
+            // connection was reset, or if the totals went backwards because
+            // the remote server restarted, we can't tell how much of what's
+            // outstanding was consumed. Assume all of it so it can't leak
+            // from the window, and count from these totals from now on.
+            if (!port.synced || it->second < port.consumed) {
+                port.synced = true;
+                port.consumed = it->second;
+                if (port.charged) {
+                    ServiceCredits& svc_credits = credits.services[port.svc];
+                    svc_credits.acked = svc_credits.sent;
+                    svc_credits.idleUpdates = 0;
+                }
+                continue;
+            }
+
+            uint64 delta = it->second - port.consumed;
+            port.consumed = it->second;
+            if (delta == 0 || !port.charged) continue;
+            ServiceCredits& svc_credits = credits.services[port.svc];
+            svc_credits.acked = std::min(svc_credits.acked + delta, svc_credits.sent);
+            svc_credits.idleUpdates = 0;
+        }
+
+        // If a stalled service hasn't made progress in a long time, whatever
+        // it has outstanding was probably lost, e.g. with a connection that
+        // closed, and will never be credited.
+        for(std::tr1::unordered_map<ServiceID, ServiceCredits>::iterator svc_it = credits.services.begin(); svc_it != credits.services.end(); svc_it++) {
+            ServiceCredits& svc_credits = svc_it->second;
+            if (svc_credits.stalled && ++svc_credits.idleUpdates > MaxIdleCreditUpdates) {
+                svc_credits.acked = svc_credits.sent;
+                svc_credits.idleUpdates = 0;
+            }
+        }
+
+        unstalled = enableUnstalled(sid, credits);
+    }
+
+    // The re-enabled queues may have been holding messages
+    if (unstalled)
+        mListener->forwarderServiceMessageReady(sid);
+}
+
+void ForwarderServiceQueue::resetCredits(ServerID sid) {
+    bool unstalled = false;
+    {
+        boost::lock_guard<boost::mutex> lock(mMutex);
+
+        ServerCreditsMap::iterator it = mCredits.find(sid);
+        if (it == mCredits.end())
+            return;
+        ServerCredits& credits = it->second;
+
+        for(std::tr1::unordered_map<ServiceID, ServiceCredits>::iterator svc_it = credits.services.begin(); svc_it != credits.services.end(); svc_it++) {
+            svc_it->second.acked = svc_it->second.sent;
+            svc_it->second.idleUpdates = 0;
+        }
+        for(std::tr1::unordered_map<uint16, PortCredits>::iterator port_it = credits.ports.begin(); port_it != credits.ports.end(); port_it++)
+            port_it->second.synced = false;
+
+        unstalled = enableUnstalled(sid, credits);
+    }
+
+    if (unstalled)
+        mListener->forwarderServiceMessageReady(sid);
+}
+
+bool ForwarderServiceQueue::enableUnstalled(ServerID sid, ServerCredits& credits) {
+    // Nothing can be stalled if we've never sent to the server
+    ServerQueueMap::iterator queue_it = mQueues.find(sid);
+    if (queue_it == mQueues.end())
+        return false;
+    OutgoingFairQueue* ofq = queue_it->second;
+
+    bool unstalled = false;
+    for(std::tr1::unordered_map<ServiceID, ServiceCredits>::iterator svc_it = credits.services.begin(); svc_it != credits.services.end(); svc_it++) {
+        ServiceCredits& svc_credits = svc_it->second;
+        if (svc_credits.stalled && !creditStalled(sid, svc_it->first)) {
+            svc_credits.stalled = false;
+            ofq->enableQueue(svc_it->first);
+            unstalled = true;
+        }
+    }
+    return unstalled;
+}
+
+uint32 ForwarderServiceQueue::takeCreditStalls() {
+    uint32 result = mCreditStalls.read();
+    mCreditStalls -= result;
+    return result;
+}
+
+uint32 ForwarderServiceQueue::takeCreditSheds() {
+    uint32 result = mCreditSheds.read();
+    mCreditSheds -= result;
+    return result;
+}
+
+bool ForwarderServiceQueue::creditStalled(ServerID sid, ServiceID svc) {
+    ServerCreditsMap::iterator it = mCredits.find(sid);
+    if (it == mCredits.end() || it->second.window == 0)
+        return false;
+    std::tr1::unordered_map<ServiceID, ServiceCredits>::iterator svc_it = it->second.services.find(svc);
+    if (svc_it == it->second.services.end())
+        return false;
+    const ServiceCredits& svc_credits = svc_it->second;
+    return svc_credits.sent >= svc_credits.acked + it->second.window;
+}
+
+void ForwarderServiceQueue::chargeCredits(ServerID sid, ServiceID svc, const Message* msg, OutgoingFairQueue* ofq) {
+    if (mUncontrolledServices.find(svc) != mUncontrolledServices.end())
+        return;
+
+    // Charged even while flow control is off so the counts line up with the
+    // remote server's if it gets turned on.
+    ServerCredits& credits = mCredits[sid];
+    ServiceCredits& svc_credits = credits.services[svc];
+    svc_credits.sent += msg->serializedSize();
+    PortCredits& port = credits.ports[msg->dest_port()];
+    port.svc = svc;
+    port.charged = true;
+
+    if (!svc_credits.stalled && creditStalled(sid, svc)) {
+        svc_credits.stalled = true;
+        svc_credits.idleUpdates = 0;
+        ofq->disableQueue(svc);
+        mCreditStalls++;
+    }
+}
+
 
 ForwarderServiceQueue::OutgoingFairQueue* ForwarderServiceQueue::getServerFairQueue(ServerID sid) {
     ServerQueueMap::iterator it = mQueues.find(sid);
@@ -36,14 +36,25 @@
 #include <sirikata/core/util/Platform.hpp>
 #include <sirikata/core/queue/FairQueue.hpp>
 #include <sirikata/space/ServerMessage.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
 #include <boost/thread.hpp>
 
+class ForwarderServiceQueueTest;
+
 namespace Sirikata {
 
 /** Fairly distributes inter-space node bandwidth between services, e.g. object
  *  message routing, PINTO, Loc, etc.  Messages are broken down by destination
  *  server, then by service.  The entire ForwarderServiceQueue is a set of fair
  *  queues over services, grouped by destination server.
+ *
+ *  Each (destination server, service) queue is also flow controlled by
+ *  credits from the destination: once a service has a window's worth of
+ *  bytes outstanding (sent, but not yet taken out of the destination's
+ *  receive queue) its queue stops sending and messages back up here, where
+ *  they are queued or shed by the service's own queue, until the destination
+ *  reports it has consumed some of them. Destinations grant the window, so
+ *  flow control is off until they report one.
  */
 class ForwarderServiceQueue {
   public:
@@ -61,10 +72,42 @@ class ForwarderServiceQueue {
         virtual void forwarderServiceMessageReady(ServerID dest_server) = 0;
     };
 
+    // Bytes consumed by a remote server, per destination port
+    typedef std::vector< std::pair<uint16, uint64> > ConsumedList;
+
     ForwarderServiceQueue(ServerID this_server, uint32 size, Listener* listener);
     ~ForwarderServiceQueue();
 
-    void addService(ServiceID svc, MessageQueueCreator creator = 0);
+    /** Add a service.
+     *  \param svc the service's ID
+     *  \param creator creates the input queues for the service, or empty to
+     *         use plain queues
+     *  \param flow_controlled whether the service is subject to credit flow
+     *         control. Services carrying the credits themselves must not be.
+     */
+    void addService(ServiceID svc, MessageQueueCreator creator = 0, bool flow_controlled = true);
+
+    /** Handle a credit update from a remote server.
+     *  \param sid the remote server
+     *  \param window the window it grants for each service, or 0 to disable
+     *         flow control
+     *  \param consumed the total number of bytes the remote server has
+     *         consumed for each destination port
+     */
+    void updateCredits(ServerID sid, uint64 window, const ConsumedList& consumed);
+    /** Forget what's outstanding to a remote server, e.g. because the
+     *  connection to it was lost or replaced and whatever was in flight may
+     *  never be reported as consumed. The next credit update from it is used
+     *  as a new starting point instead of being credited.
+     */
+    void resetCredits(ServerID sid);
+
+    /** Number of times a service ran out of credits, since the last call. */
+    uint32 takeCreditStalls();
+    /** Number of messages refused while their service was out of credits,
+     *  since the last call.
+     */
+    uint32 takeCreditSheds();
 
     Message* front(ServerID sid);
     Message* pop(ServerID sid);
@@ -73,18 +116,66 @@ class ForwarderServiceQueue {
     friend class Forwarder;
     friend class ForwarderServerMessageRouter;
     friend class ODPFlowScheduler;
+    friend class ::ForwarderServiceQueueTest;
 
     typedef FairQueue<Message, ServiceID, MessageQueue> OutgoingFairQueue;
     typedef std::tr1::unordered_map<ServerID, OutgoingFairQueue*> ServerQueueMap;
     typedef std::tr1::unordered_map<ServiceID, MessageQueueCreator> MessageQueueCreatorMap;
 
+    // Credit state for one (server, service) pair
+    struct ServiceCredits {
+        ServiceCredits()
+         : sent(0), acked(0), stalled(false), idleUpdates(0)
+        {}
+
+        uint64 sent; // Bytes
+        uint64 acked; // Bytes, never more than sent
+        bool stalled;
+        // Credit updates received while stalled without any progress
+        uint32 idleUpdates;
+    };
+    // Credits are reported by destination port, since that's all the remote
+    // server knows about each message. We track which service last sent to
+    // each port to charge the credits back to it.
+    struct PortCredits {
+        PortCredits()
+         : consumed(0), svc(0), charged(false), synced(false)
+        {}
+
+        uint64 consumed;
+        ServiceID svc;
+        bool charged; // Whether svc is valid, i.e. we've sent on this port
+        bool synced; // Whether consumed is a valid base for the remote totals
+    };
+    struct ServerCredits {
+        ServerCredits()
+         : window(0)
+        {}
+
+        uint64 window;
+        std::tr1::unordered_map<ServiceID, ServiceCredits> services;
+        std::tr1::unordered_map<uint16, PortCredits> ports;
+    };
+    typedef std::tr1::unordered_map<ServerID, ServerCredits> ServerCreditsMap;
+
     ServerID mThisServer;
     MessageQueueCreatorMap mQueueCreators;
+    std::set<ServiceID> mUncontrolledServices;
     ServerQueueMap mQueues;
     uint32 mQueueSize;
+    // Number of credit updates a stalled service can go without progress
+    // before we assume what's outstanding was lost and clear it. Weight
+    // updates, which carry the credits, are sent about every 10ms.
+    static const uint32 MaxIdleCreditUpdates = 100;
     Listener* mListener;
     boost::mutex mMutex;
 
+    // Protected by mMutex
+    ServerCreditsMap mCredits;
+
+    AtomicValue<uint32> mCreditStalls;
+    AtomicValue<uint32> mCreditSheds;
+
     // Normal push
     QueueEnum::PushResult push(ServiceID svc, Message* msg);
     // Use prePush to indicate you need to push to the queue.  This has to be
@@ -98,8 +189,18 @@ class ForwarderServiceQueue {
 
     uint32 size(ServerID sid, ServiceID svc);
 
+    // Whether svc is currently out of credits for sid. Must hold mMutex.
+    bool creditStalled(ServerID sid, ServiceID svc);
+    // Re-enables the queues of any services to sid that are no longer out of
+    // credits, returning whether there were any. Must hold mMutex.
+    bool enableUnstalled(ServerID sid, ServerCredits& credits);
+
     // Utilities
 
+    // Charges a message popped for sending against its service's
+    // credits. Must hold mMutex.
+    void chargeCredits(ServerID sid, ServiceID svc, const Message* msg, OutgoingFairQueue* ofq);
+
     // Gets the FairQueue over services for the specified server.
     OutgoingFairQueue* getServerFairQueue(ServerID sid);
     // This is just a sanity check -- verifies ofq has an input queue for svc_id
@@ -66,7 +66,7 @@ void LocalForwarder::removeActiveConnection(const UUID& objid) {
     mActiveConnections.erase(it);
 }
 
-bool LocalForwarder::tryForward(Sirikata::Protocol::Object::ObjectMessage* msg) {
+bool LocalForwarder::tryForward(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes) {
     ObjectConnection* conn = NULL;
     {
         boost::lock_guard<boost::mutex> lock(mMutex);
@@ -97,7 +97,7 @@ bool LocalForwarder::tryForward(Sirikata::Protocol::Object::ObjectMessage* msg)
     // If a stop was requested, don't try to forward.
     if (mContext->stopped()) return false;
 
-    bool send_success = conn->send(msg);
+    bool send_success = conn->send(msg, msg_bytes);
     if (!send_success) {
         mNumDropped++;
         TIMESTAMP_END(tstamp, Trace::DROPPED_AT_FORWARDED_LOCALLY);
@@ -68,9 +68,11 @@ class LocalForwarder : public PollingService {
      *  code.  If forwarded, the LocalForwarder retains ownership of
      *  the message.
      *  \param msg the message to try to forward
+     *  \param msg_bytes the bytes msg was parsed from, sent in place of
+     *                   reserializing msg. NULL if msg was built locally.
      *  \returns true if the message was forwarded, false otherwise
      */
-    bool tryForward(Sirikata::Protocol::Object::ObjectMessage* msg);
+    bool tryForward(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes = ObjectMessageBytesPtr());
   private:
 
     virtual void poll();
@@ -0,0 +1,164 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "MigrationEventQueue.hpp"
+
+namespace Sirikata {
+
+void MigrationEventQueue::ObjectInfo::setCrossing(const Time& cross, const Time& now, const Duration& precopy_window) {
+    crossing = cross;
+
+    bool out_of_window = crossing - precopy_window > now;
+    bool expired = precopied && !(now < precopyExpires);
+    if (precopyChecked && (out_of_window || expired)) {
+        precopyChecked = false;
+        precopied = false;
+    }
+
+    if (precopy_window == Duration::zero() || (precopyChecked && !precopied))
+        nextEvent = crossing;
+    else if (precopied)
+        nextEvent = std::min(crossing, precopyExpires);
+    else
+        nextEvent = crossing - precopy_window;
+}
+
+bool MigrationEventQueue::ObjectInfo::precopyDue(const Time& now, const Duration& precopy_window) const {
+    return precopy_window != Duration::zero() && !precopyChecked && !(now < crossing - precopy_window);
+}
+
+void MigrationEventQueue::ObjectInfo::setPrecopy(ServerID dest, const Time& expires) {
+    precopyChecked = true;
+    precopied = (dest != NullServerID);
+    precopyDest = dest;
+    precopyCrossing = crossing;
+    precopyExpires = expires;
+}
+
+void MigrationEventQueue::ObjectInfo::checkPrecopyDest(ServerID dest) {
+    if (precopyChecked && dest != precopyDest) {
+        precopyChecked = false;
+        precopied = false;
+    }
+}
+
+MigrationEventQueue::MigrationEventQueue()
+{
+}
+
+const MigrationEventQueue::ObjectInfo* MigrationEventQueue::find(const UUID& id) const {
+    UUIDFlatMap<uint32>::const_iterator it = mPositions.find(id);
+    if (it == mPositions.end()) return NULL;
+    return &(mHeap[it->second].info);
+}
+
+void MigrationEventQueue::insert(const ObjectInfo& info) {
+    assert(!contains(info.objid));
+    mHeap.push_back(Node(info));
+    mPositions[info.objid] = mHeap.size() - 1;
+    siftUp(mHeap.size() - 1);
+}
+
+void MigrationEventQueue::update(const ObjectInfo& info) {
+    UUIDFlatMap<uint32>::iterator it = mPositions.find(info.objid);
+    assert(it != mPositions.end());
+    uint32 idx = it->second;
+    Node& node = mHeap[idx];
+    node.info = info;
+    if (info.nextEvent < node.key) {
+        node.key = info.nextEvent;
+        siftUp(idx);
+    }
+    // Otherwise leave it where it is, see settleFront()
+}
+
+void MigrationEventQueue::erase(const UUID& id) {
+    UUIDFlatMap<uint32>::iterator it = mPositions.find(id);
+    if (it == mPositions.end()) return;
+    uint32 idx = it->second;
+    mPositions.erase(it);
+    removeAt(idx);
+}
+
+const Time& MigrationEventQueue::nextEventTime() {
+    settleFront();
+    return mHeap[0].key;
+}
+
+bool MigrationEventQueue::popDue(const Time& t, ObjectInfo* out) {
+    if (mHeap.empty()) return false;
+    settleFront();
+    if (!(mHeap[0].key < t)) return false;
+
+    *out = mHeap[0].info;
+    mPositions.erase(out->objid);
+    removeAt(0);
+    return true;
+}
+
+void MigrationEventQueue::objects(std::vector<UUID>* ids_out) const {
+    ids_out->reserve(ids_out->size() + mHeap.size());
+    for(std::vector<Node>::const_iterator it = mHeap.begin(); it != mHeap.end(); it++)
+        ids_out->push_back(it->info.objid);
+}
+
+void MigrationEventQueue::settleFront() {
+    // Each object is sifted at most once for any number of updates which
+    // pushed its event later.
+    while(!mHeap.empty() && mHeap[0].key < mHeap[0].info.nextEvent) {
+        mHeap[0].key = mHeap[0].info.nextEvent;
+        siftDown(0);
+    }
+}
+
+void MigrationEventQueue::place(uint32 idx, const Node& node) {
+    mHeap[idx] = node;
+    mPositions[node.info.objid] = idx;
+}
+
+void MigrationEventQueue::siftUp(uint32 idx) {
+    Node node = mHeap[idx];
+    while(idx > 0) {
+        uint32 parent = (idx - 1) / Arity;
+        if (!(node.key < mHeap[parent].key)) break;
+        place(idx, mHeap[parent]);
+        idx = parent;
+    }
+    place(idx, node);
+}
+
+void MigrationEventQueue::siftDown(uint32 idx) {
+    Node node = mHeap[idx];
+    uint32 sz = mHeap.size();
+    while(true) {
+        uint32 first_child = idx * Arity + 1;
+        if (first_child >= sz) break;
+        uint32 last_child = std::min(first_child + Arity, sz);
+        uint32 best = first_child;
+        for(uint32 c = first_child + 1; c < last_child; c++)
+            if (mHeap[c].key < mHeap[best].key) best = c;
+        if (!(mHeap[best].key < node.key)) break;
+        place(idx, mHeap[best]);
+        idx = best;
+    }
+    place(idx, node);
+}
+
+void MigrationEventQueue::removeAt(uint32 idx) {
+    uint32 last = mHeap.size() - 1;
+    if (idx != last) {
+        Node moved = mHeap[last];
+        mHeap.pop_back();
+        place(idx, moved);
+        if (idx > 0 && moved.key < mHeap[(idx - 1) / Arity].key)
+            siftUp(idx);
+        else
+            siftDown(idx);
+    }
+    else {
+        mHeap.pop_back();
+    }
+}
+
+} // namespace Sirikata
@@ -0,0 +1,131 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_MIGRATION_EVENT_QUEUE_HPP_
+#define _SIRIKATA_MIGRATION_EVENT_QUEUE_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/UUIDFlatMap.hpp>
+
+namespace Sirikata {
+
+/** The objects MigrationMonitor is watching, ordered by when each needs to be
+ *  looked at next. This is a 4-ary heap in a flat array with an index from
+ *  object ID to heap position.
+ *
+ *  Moving an object's event later, which is what most location updates do, is
+ *  applied lazily: the object keeps its old place in the heap and is only
+ *  moved once that place reaches the front. An object updated many times
+ *  between events is therefore only sifted down once.
+ */
+class MigrationEventQueue {
+public:
+    struct ObjectInfo {
+        ObjectInfo(const UUID& id, const Time& cross, const Time& next)
+         : objid(id),
+           crossing(cross),
+           nextEvent(next),
+           precopyChecked(false),
+           precopied(false),
+           precopyDest(NullServerID),
+           precopyCrossing(Time::null()),
+           precopyExpires(Time::null())
+        {}
+
+        /** Set the crossing as computed at now and work out nextEvent from
+         *  it. Pre-copy state that no longer applies is forgotten first: once
+         *  the crossing moves back out of the pre-copy window, or once the
+         *  destination's copy has expired.
+         */
+        void setCrossing(const Time& cross, const Time& now, const Duration& precopy_window);
+        /** Whether the object is in its pre-copy window and hasn't been
+         *  looked at for a pre-copy yet.
+         */
+        bool precopyDue(const Time& now, const Duration& precopy_window) const;
+        /** Record a pre-copy for the current crossing to dest, which relies on
+         *  it until expires. NullServerID records that there was nowhere to
+         *  send one. Applied to nextEvent by the next setCrossing().
+         */
+        void setPrecopy(ServerID dest, const Time& expires);
+        /** Forget the pre-copy if the object is now expected to end up
+         *  somewhere other than where it was sent. Applied to nextEvent by the
+         *  next setCrossing().
+         */
+        void checkPrecopyDest(ServerID dest);
+
+        UUID objid;
+        // When the object is expected to leave the server's region
+        Time crossing;
+        // When the object needs to be looked at next: its crossing, the start
+        // of the pre-copy window before it, or when a pre-copy expires
+        Time nextEvent;
+        // Whether we've looked for somewhere to pre-copy the object to for the
+        // current crossing, and whether we actually sent it there
+        bool precopyChecked;
+        bool precopied;
+        // Where the pre-copy went, the crossing it was made for, and when
+        // the sender stops relying on it
+        ServerID precopyDest;
+        Time precopyCrossing;
+        Time precopyExpires;
+    };
+
+    MigrationEventQueue();
+
+    bool empty() const { return mHeap.empty(); }
+    size_t size() const { return mHeap.size(); }
+
+    bool contains(const UUID& id) const {
+        return mPositions.find(id) != mPositions.end();
+    }
+    /** Get an object's info, or NULL if it isn't in the queue. Use update() to
+     *  change it.
+     */
+    const ObjectInfo* find(const UUID& id) const;
+
+    void insert(const ObjectInfo& info);
+    /** Replace the info for info.objid, which must already be in the queue. */
+    void update(const ObjectInfo& info);
+    void erase(const UUID& id);
+
+    /** Get the time of the earliest event. The queue must not be empty. */
+    const Time& nextEventTime();
+
+    /** Remove the object with the earliest event if that event is before t.
+     *  \param out the removed object's info
+     *  \returns true if an object was removed
+     */
+    bool popDue(const Time& t, ObjectInfo* out);
+
+    /** Get the IDs of all objects in the queue. */
+    void objects(std::vector<UUID>* ids_out) const;
+
+private:
+    static const uint32 Arity = 4;
+
+    struct Node {
+        Node(const ObjectInfo& _info)
+         : key(_info.nextEvent),
+           info(_info)
+        {}
+
+        // Position in the heap, which is never later than info.nextEvent
+        Time key;
+        ObjectInfo info;
+    };
+
+    // Make sure the front of the heap has an up to date key
+    void settleFront();
+    void siftUp(uint32 idx);
+    void siftDown(uint32 idx);
+    void place(uint32 idx, const Node& node);
+    void removeAt(uint32 idx);
+
+    std::vector<Node> mHeap;
+    UUIDFlatMap<uint32> mPositions;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_MIGRATION_EVENT_QUEUE_HPP_
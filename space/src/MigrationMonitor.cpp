@@ -37,7 +37,7 @@
 #endif
 namespace Sirikata {
 
-MigrationMonitor::MigrationMonitor(SpaceContext* ctx, LocationService* locservice, CoordinateSegmentation* cseg, MigrationCallback cb)
+MigrationMonitor::MigrationMonitor(SpaceContext* ctx, LocationService* locservice, CoordinateSegmentation* cseg, MigrationCallback cb, MigrationCallback precopy_cb, const Duration& precopy_window, const Duration& precopy_lifetime)
  : mContext(ctx),
    mLocService(locservice),
    mCSeg(cseg),
@@ -49,12 +49,15 @@ MigrationMonitor::MigrationMonitor(SpaceContext* ctx, LocationService* locservic
        )
    ),
    mMinEventTime(Time::null()),
-   mCB(cb)
+   mCB(cb),
+   mPrecopyCB(precopy_cb),
+   mPrecopyWindow(precopy_cb ? precopy_window : Duration::zero()),
+   mPrecopyLifetime(precopy_lifetime)
 {
     mLocService->addListener(this, false);
     mCSeg->addListener(this);
 
-    mBoundingRegions = mCSeg->serverRegion( mLocService->context()->id() );
+    mRegionIndex.reset( mCSeg->serverRegion( mLocService->context()->id() ) );
 }
 
 MigrationMonitor::~MigrationMonitor() {
@@ -66,13 +69,11 @@ void MigrationMonitor::waitForNextEvent() {
     if (mObjectInfo.empty())
         return;
 
-    ObjectInfoByNextEvent::iterator first_it = mObjectInfo.get<nextevent>().begin();
-    const ObjectInfo& earliest_event = *first_it;
-
-    if (earliest_event.nextEvent == mMinEventTime)
+    Time next_event = mObjectInfo.nextEventTime();
+    if (next_event == mMinEventTime)
         return;
 
-    mMinEventTime = earliest_event.nextEvent;
+    mMinEventTime = next_event;
 
     Time now = mContext->simTime();
     Duration tdiff =
@@ -82,48 +83,67 @@ void MigrationMonitor::waitForNextEvent() {
 }
 
 void MigrationMonitor::service() {
-    std::set<UUID> considered;
+    std::vector<ObjectInfo> considered;
+    typedef std::map<ServerID, std::vector<UUID> > ObjectsByServer;
+    ObjectsByServer migrations;
+    ObjectsByServer precopies;
 
     Time curt = mLocService->context()->simTime();
-    for(ObjectInfoByNextEvent::iterator it = mObjectInfo.get<nextevent>().begin();
-        it != mObjectInfo.get<nextevent>().end() && it->nextEvent < curt;
-        it++) {
+    // Due objects are taken out of the queue while we look at them and put
+    // back with new event times below.
+    ObjectInfo info(UUID::null(), Time::null(), Time::null());
+    while(mObjectInfo.popDue(curt, &info)) {
+        considered.push_back(info);
 
         // Removals posted by a location update might not have been processed yet.
         // Double check that the object is still available.
-        if (!mLocService->contains(it->objid))
+        if (!mLocService->contains(info.objid))
             continue;
 
-        considered.insert(it->objid);
+        if (info.crossing >= curt) {
+            // Only woken up for the pre-copy, or because the last one
+            // expired, which this drops.
+            ObjectInfo& cur = considered.back();
+            cur.setCrossing(cur.crossing, curt, mPrecopyWindow);
+            if (cur.precopyDue(curt, mPrecopyWindow)) {
+                // Record the pre-copy before handing it off so the next event
+                // times computed below skip past the pre-copy window
+                ServerID dest = precopyDestination(cur.objid, mLocService->location(cur.objid), cur.crossing);
+                cur.setPrecopy(dest, curt + mPrecopyLifetime);
+                if (dest != NullServerID)
+                    precopies[dest].push_back(cur.objid);
+            }
+            continue;
+        }
 
-        Vector3f obj_pos = mLocService->currentPosition(it->objid);
+        Vector3f obj_pos = mLocService->currentPosition(info.objid);
 
         // NOTE: its possible the object wanders out of the region covered by *all* servers,
         // which is not properly handled by Loc yet.  Therefore we have secondary check which
         // ensures the object has moved into *some other server's* region as well as out of ours.
         if (!mCSeg->region().degenerate() && mCSeg->region().contains(obj_pos, 0.0f))
-            mCB(it->objid);
+            migrations[mCSeg->lookup(obj_pos)].push_back(info.objid);
 
         // NOTE: Objects stay in the index until they are removed by an actual migration --
-        // i.e. the Server may reject this MigrationMonitor's suggestion.  Updates to the
-        // next event happen after this loop to avoid iterator invalidation.  The updates
-        // also takes care of static objects, which have long periods until their next event,
-        // but which are forced to be considered periodically
+        // i.e. the Server may reject this MigrationMonitor's suggestion.  The
+        // reinsertion below also takes care of static objects, which have long periods
+        // until their next event, but which are forced to be considered periodically
     }
 
+    for(ObjectsByServer::iterator it = precopies.begin(); it != precopies.end(); it++)
+        mPrecopyCB(it->first, it->second);
+    for(ObjectsByServer::iterator it = migrations.begin(); it != migrations.end(); it++)
+        mCB(it->first, it->second);
+
     // Update events for all objects we considered
-    ObjectInfoByID& by_id = mObjectInfo.get<objid>();
-    for(std::set<UUID>::iterator it = considered.begin(); it != considered.end(); it++) {
+    for(std::vector<ObjectInfo>::iterator it = considered.begin(); it != considered.end(); it++) {
         // Since mCB (called above) might migrate the object and remove it, we need to make sure
         // we still have it.  FIXME Strand->wrap which uses post() instead of dispatch() would
-        // resolve this
-        if (!mLocService->contains(*it))
-            continue;
-
-        by_id.modify(
-            by_id.find(*it),
-            std::tr1::bind(&MigrationMonitor::changeNextEventTime, std::tr1::placeholders::_1, computeNextEventTime(*it, mLocService->location(*it)))
-        );
+        // resolve this.  Objects which are gone keep their old times until
+        // their removal is processed.
+        if (mLocService->contains(it->objid))
+            updatePrecopyAndCrossing(&(*it), mLocService->location(it->objid), curt);
+        mObjectInfo.insert(*it);
     }
 
     waitForNextEvent();
@@ -134,88 +154,70 @@ bool MigrationMonitor::onThisServer(const Vector3f& pos) const {
 }
 
 bool MigrationMonitor::inRegion(const Vector3f& pos) const {
-    for(BoundingBoxList::const_iterator it = mBoundingRegions.begin(); it != mBoundingRegions.end(); it++) {
-        BoundingBox3f bb = *it;
-        if (bb.degenerate()) return true;
-        if (bb.contains(pos, 0.0f)) return true;
-    }
+    return mRegionIndex.contains(pos);
+}
 
-    return false;
+namespace {
+// Objects whose crossing is this far off are treated as static and looked at
+// again after this long.
+const float32 FarCrossingSeconds = 100.f;
+// Limit on the number of adjacent boxes an object is followed through
+const uint32 MaxBoxesCrossed = 8;
 }
 
 Time MigrationMonitor::computeNextEventTime(const UUID& obj, const TimedMotionVector3f& newloc) {
     Time curt = mLocService->context()->simTime();
+    Duration far_crossing = Duration::seconds(FarCrossingSeconds); // Effectively infinite time
+
+    // Unbounded regions cover the whole world, so objects never leave
+    if (mRegionIndex.unbounded())
+        return curt + far_crossing;
 
     // Short cut: if its static, only verify it is in the server's boundaries
     if (newloc.velocity().lengthSquared() == 0.f) {
         if (inRegion(newloc.position()))
-            return curt + Duration::seconds(100); // Effectively infinite time
+            return curt + far_crossing;
         else
             return curt; // For some reason its out of the region, force the check on the next round
     }
 
-    // Figure out which block its currently in
+    // Otherwise, figure out when it leaves. If it crosses more boxes than we
+    // follow, this just wakes us up early
     Vector3f curpos = newloc.position(curt);
-    BoundingBox3f curbox;
-    bool foundbox = false;
-    bool degenerate = false;
-    for(BoundingBoxList::const_iterator it = mBoundingRegions.begin(); it != mBoundingRegions.end(); it++) {
-        BoundingBox3f bb = *it;
-        if (bb.degenerate()) {
-            degenerate = true;
-            break;
-        }
-        if (bb.contains(curpos, 0.0f)) {
-            curbox = bb;
-            foundbox = true;
-            break;
-        }
-    }
-
-    if (!foundbox && !degenerate)
+    float32 time_to_exit = mRegionIndex.timeToExit(curpos, newloc.velocity(), FarCrossingSeconds, MaxBoxesCrossed);
+    if (time_to_exit == 0.f)
         return curt; // Couldn't find the bounding box its in, must not be any, force check on next round
-
-
-    // Otherwise, we can now compute when an edge will be hit
-
-    // For degenerate bboxes, they are covering the whole world.  Return a long
-    // time from now
-    if (degenerate)
-        return curt + Duration::seconds(100); // Effectively infinite time
-
-    Vector3f curdir = newloc.velocity();
-
-    Vector3f to_min = curbox.min() - curpos;
-    Vector3f to_max = curbox.max() - curpos;
-
-    // Uggh, component-wise divide would be nice...
-    Vector3f time_to_min( to_min.x / curdir.x, to_min.y / curdir.y, to_min.z / curdir.z );
-    Vector3f time_to_max( to_max.x / curdir.x, to_max.y / curdir.y, to_max.z / curdir.z );
-
-    // For each dim, one should be negative (backward), one positive (forward).  Use max to pick forward direction
-    Vector3f time_to_hit = time_to_min.max(time_to_max);
-
-    // Take care of zeroes in velocity -- if velocity is too small, set time to hit extremely large
-    if (fabs(curdir.x) < 0.00001f) time_to_hit.x = 100000.f;
-    if (fabs(curdir.y) < 0.00001f) time_to_hit.y = 100000.f;
-    if (fabs(curdir.z) < 0.00001f) time_to_hit.z = 100000.f;
-
-    // And choose the minimum of those times
-    float32 time_to_first_hit = std::min( std::min( time_to_hit.x, time_to_hit.y ), time_to_hit.z );
-    if (time_to_first_hit >= 100000.f) {
+    if (time_to_exit >= FarCrossingSeconds) {
         // Despite having non-zero velocity, this thing is moving really slowly.  Treat it the same way we treat static objects
-        return curt + Duration::seconds(100); // Effectively infinite time
+        return curt + far_crossing;
     }
 
-    assert(time_to_first_hit >= 0.f); // And at least one of them *must* be positive, or something is wrong with bbox
-    // And convert to seconds
-    Duration to_first_hit = Duration::seconds(time_to_first_hit);
-    return curt + to_first_hit;
+    return curt + Duration::seconds(time_to_exit);
+}
+
+ServerID MigrationMonitor::precopyDestination(const UUID& obj, const TimedMotionVector3f& loc, const Time& crossing) {
+    // Guess where it'll end up by looking just past where it leaves our region
+    Vector3f exit_pos = loc.position(crossing + Duration::milliseconds((int64)100));
+    ServerID dest = mCSeg->lookup(exit_pos);
+    return (dest == mLocService->context()->id()) ? NullServerID : dest;
 }
 
-// Helper for multi_index modify method
-void MigrationMonitor::changeNextEventTime(ObjectInfo& objinfo, const Time& newt) {
-    objinfo.nextEvent = newt;
+void MigrationMonitor::updatePrecopyAndCrossing(ObjectInfo* info, const TimedMotionVector3f& newloc, const Time& now) {
+    Time crossing = computeNextEventTime(info->objid, newloc);
+    // A pre-copy only helps if the object still goes where it was sent
+    if (info->precopyChecked)
+        info->checkPrecopyDest(precopyDestination(info->objid, newloc, crossing));
+    info->setCrossing(crossing, now, mPrecopyWindow);
+}
+
+void MigrationMonitor::updateNextEventTime(const UUID& obj, const TimedMotionVector3f& newloc) {
+    const ObjectInfo* cur = mObjectInfo.find(obj);
+    // The object may already have been removed
+    if (cur == NULL) return;
+
+    ObjectInfo info(*cur);
+    updatePrecopyAndCrossing(&info, newloc, mLocService->context()->simTime());
+    mObjectInfo.update(info);
 }
 
 /** LocationServiceListener Interface. */
@@ -228,9 +230,11 @@ void MigrationMonitor::changeNextEventTime(ObjectInfo& objinfo, const Time& newt
 }
 
 void MigrationMonitor::handleLocalObjectAdded(const UUID& uuid, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds) {
-    assert( mObjectInfo.get<objid>().find(uuid) == mObjectInfo.get<objid>().end());
+    assert(!mObjectInfo.contains(uuid));
 
-    mObjectInfo.insert( ObjectInfo(uuid, computeNextEventTime(uuid, loc)) );
+    ObjectInfo info(uuid, Time::null(), Time::null());
+    info.setCrossing(computeNextEventTime(uuid, loc), mLocService->context()->simTime(), mPrecopyWindow);
+    mObjectInfo.insert(info);
     waitForNextEvent();
 }
 
@@ -242,25 +246,32 @@ void MigrationMonitor::localObjectRemoved(const UUID& uuid, bool agg) {
 }
 
 void MigrationMonitor::handleLocalObjectRemoved(const UUID& uuid) {
-    mObjectInfo.get<objid>().erase(uuid);
+    mObjectInfo.erase(uuid);
     waitForNextEvent();
 }
 
-void MigrationMonitor::localLocationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval) {
+void MigrationMonitor::locationUpdateBatch(const LocationUpdateBatchEntry* begin, const LocationUpdateBatchEntry* end) {
+    LocationUpdateList updates;
+    for(const LocationUpdateBatchEntry* entry = begin; entry != end; entry++) {
+        if (!entry->local || !(entry->fields & LocationUpdateBatchEntry::LOCATION))
+            continue;
+        updates.push_back(std::make_pair(entry->uuid, mLocService->location(entry->uuid)));
+    }
+    if (updates.empty())
+        return;
+
     mStrand->post(
-        std::tr1::bind(&MigrationMonitor::handleLocalLocationUpdated, this, uuid, newval),
-        "MigrationMonitor::handleLocalLocationUpdated"
+        std::tr1::bind(&MigrationMonitor::handleLocalLocationsUpdated, this, updates),
+        "MigrationMonitor::handleLocalLocationsUpdated"
     );
 }
 
-void MigrationMonitor::handleLocalLocationUpdated(const UUID& uuid, const TimedMotionVector3f& newval) {
-    assert( mObjectInfo.get<objid>().find(uuid) != mObjectInfo.get<objid>().end());
-
-    ObjectInfoByID& by_id = mObjectInfo.get<objid>();
-    by_id.modify(
-        by_id.find(uuid),
-        std::tr1::bind(&MigrationMonitor::changeNextEventTime, std::tr1::placeholders::_1, computeNextEventTime(uuid, newval))
-    );
+void MigrationMonitor::handleLocalLocationsUpdated(const LocationUpdateList& updates) {
+    // Updates which move an object's event later are cheap, see
+    // MigrationEventQueue, so a batch mostly made of objects moving within
+    // the region doesn't reshuffle the queue.
+    for(LocationUpdateList::const_iterator it = updates.begin(); it != updates.end(); it++)
+        updateNextEventTime(it->first, it->second);
 
     waitForNextEvent();
 }
@@ -277,21 +288,15 @@ void MigrationMonitor::updatedSegmentation(CoordinateSegmentation* cseg, const s
 void MigrationMonitor::handleUpdatedSegmentation(CoordinateSegmentation* cseg, const std::vector<SegmentationInfo>& new_segmentation) {
     for(std::vector<SegmentationInfo>::const_iterator it = new_segmentation.begin(); it != new_segmentation.end(); it++) {
         if (it->server == mLocService->context()->id()) {
-            mBoundingRegions = it->region;
+            mRegionIndex.reset(it->region);
 
             // Recalculate *all* object potential update times
-            ObjectInfoByID& by_id = mObjectInfo.get<objid>();
-            for(ObjectInfoByID::iterator obj_it = by_id.begin(); obj_it != by_id.end(); obj_it++) {
-                by_id.modify(
-                    obj_it,
-                    std::tr1::bind(&MigrationMonitor::changeNextEventTime,
-                        std::tr1::placeholders::_1,
-                        computeNextEventTime(obj_it->objid, mLocService->location(obj_it->objid))
-                    )
-                );
-            }
+            std::vector<UUID> objects;
+            mObjectInfo.objects(&objects);
+            for(std::vector<UUID>::iterator obj_it = objects.begin(); obj_it != objects.end(); obj_it++)
+                updateNextEventTime(*obj_it, mLocService->location(*obj_it));
 
-            return;
+            break;
         }
     }
 
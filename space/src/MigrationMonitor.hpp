@@ -37,9 +37,8 @@
 #include <sirikata/space/LocationService.hpp>
 #include <sirikata/space/CoordinateSegmentation.hpp>
 
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/member.hpp>
-#include <boost/multi_index/ordered_index.hpp>
+#include "MigrationEventQueue.hpp"
+#include "RegionBVH.hpp"
 
 namespace Sirikata {
 
@@ -47,19 +46,32 @@ namespace Sirikata {
  *  this server and determines when they have left the server, or
  *  more generally, when they should begin to migrate to another
  *  server.
+ *
+ *  Objects found in the same pass are reported together, grouped by the
+ *  server they're moving to, so a boundary change which moves many objects
+ *  at once can be handled in bulk.
  */
 class MigrationMonitor : public LocationServiceListener, public CoordinateSegmentation::Listener {
 public:
-    typedef std::tr1::function<void(const UUID&)> MigrationCallback;
+    typedef std::tr1::function<void(ServerID, const std::vector<UUID>&)> MigrationCallback;
 
-    /** Create a new MigrationMonitor.  The MigrationCallback is called any time a migration is detected.  Note that
+    /** Create a new MigrationMonitor.  The MigrationCallback is called any time migrations are detected.  Note that
      *  it may be called from a thread other than the main thread, so it should be thread safe.
      *  \param ctx SpaceContext for this simulation
      *  \param locservice location service for this server
      *  \param cseg coordinate segmentation used for this server
-     *  \param cb callback to be invoked when a migration is detected
+     *  \param cb callback to be invoked with the objects moving to each server when migrations are detected
+     *  \param precopy_cb if non-empty, invoked with objects expected to
+     *         migrate to a server within precopy_window, once per object
+     *  \param precopy_window how long before an object is expected to leave
+     *         the server precopy_cb should be invoked
+     *  \param precopy_lifetime how long the caller relies on a pre-copy
+     *         after it's made. The object is pre-copied again after this if
+     *         it's still expected to migrate.
      */
-    MigrationMonitor(SpaceContext* ctx, LocationService* locservice, CoordinateSegmentation* cseg, MigrationCallback cb);
+    MigrationMonitor(SpaceContext* ctx, LocationService* locservice, CoordinateSegmentation* cseg, MigrationCallback cb,
+        MigrationCallback precopy_cb = MigrationCallback(), const Duration& precopy_window = Duration::zero(),
+        const Duration& precopy_lifetime = Duration::zero());
     ~MigrationMonitor();
 
     // Indicates whether the given position is on this server, useful to check if object should be
@@ -71,12 +83,17 @@ private:
     /** LocationServiceListener Interface. */
   virtual void localObjectAdded(const UUID& uuid, bool agg, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const BoundingSphere3f& bounds, const String& mesh, const String& physics, const String& zernike);
     virtual void localObjectRemoved(const UUID& uuid, bool agg);
-    virtual void localLocationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval);
+    // Location updates are taken in batches so each tick's worth of updates
+    // only takes one trip to our strand.
+    virtual bool batchedUpdates() const { return true; }
+    virtual void locationUpdateBatch(const LocationUpdateBatchEntry* begin, const LocationUpdateBatchEntry* end);
+
+    typedef std::vector< std::pair<UUID, TimedMotionVector3f> > LocationUpdateList;
 
     // Handlers for location events we care about.  These are handled in our internal strand
     void handleLocalObjectAdded(const UUID& uuid, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds);
     void handleLocalObjectRemoved(const UUID& uuid);
-    void handleLocalLocationUpdated(const UUID& uuid, const TimedMotionVector3f& newval);
+    void handleLocalLocationsUpdated(const LocationUpdateList& updates);
 
     /** CoordinateSegmentation::Listener Interface. */
     virtual void updatedSegmentation(CoordinateSegmentation* cseg, const std::vector<SegmentationInfo>& new_segmentation);
@@ -91,41 +108,27 @@ private:
 
     bool inRegion(const Vector3f& pos) const;
 
+    // Solves for when an object moving with newloc's velocity leaves the
+    // region, following it through any adjacent boxes of the region.
     Time computeNextEventTime(const UUID& obj, const TimedMotionVector3f& newloc);
 
     SpaceContext* mContext;
     LocationService* mLocService;
     CoordinateSegmentation* mCSeg;
-    BoundingBoxList mBoundingRegions;
-
-    struct ObjectInfo {
-        ObjectInfo(UUID id, Time next)
-         : objid(id),
-           nextEvent(next)
-        {}
-
-        UUID objid;
-        Time nextEvent;
-    };
-
-
-    // Tags used by ObjectInfoSet
-    struct objid {};
-    struct nextevent {};
 
-    typedef boost::multi_index_container<
-        ObjectInfo,
-        boost::multi_index::indexed_by<
-            boost::multi_index::ordered_unique< boost::multi_index::tag<objid>, BOOST_MULTI_INDEX_MEMBER(ObjectInfo,UUID,objid) >,
-            boost::multi_index::ordered_non_unique< boost::multi_index::tag<nextevent>, BOOST_MULTI_INDEX_MEMBER(ObjectInfo,Time,nextEvent) >
-        >
-    > ObjectInfoSet;
-    typedef ObjectInfoSet::index<objid>::type ObjectInfoByID;
-    typedef ObjectInfoSet::index<nextevent>::type ObjectInfoByNextEvent;
+    typedef MigrationEventQueue::ObjectInfo ObjectInfo;
 
-    static void changeNextEventTime(ObjectInfo& objinfo, const Time& newt);
+    // The server an object leaving at crossing should be pre-copied to, or
+    // NullServerID if it doesn't look like it's going anywhere else
+    ServerID precopyDestination(const UUID& obj, const TimedMotionVector3f& loc, const Time& crossing);
+    // Recompute an object's crossing from its current location, dropping its
+    // pre-copy if it's now headed elsewhere
+    void updatePrecopyAndCrossing(ObjectInfo* info, const TimedMotionVector3f& newloc, const Time& now);
+    void updateNextEventTime(const UUID& obj, const TimedMotionVector3f& newloc);
 
-    ObjectInfoSet mObjectInfo;
+    // The boxes making up this server's region
+    RegionBVH mRegionIndex;
+    MigrationEventQueue mObjectInfo;
 
     Network::IOStrand* mStrand;
     Network::IOTimerPtr mTimer;
@@ -133,6 +136,10 @@ private:
     Time mMinEventTime;
 
     MigrationCallback mCB;
+    MigrationCallback mPrecopyCB;
+    // Zero when pre-copying is disabled
+    Duration mPrecopyWindow;
+    Duration mPrecopyLifetime;
 };
 
 } // namespace Sirikata
@@ -90,8 +90,9 @@ public:
     virtual bool empty() const = 0;
     virtual uint32 size() const = 0;
 
-    // ODP push interface. Note: Must be thread safe!
-    virtual bool push(Sirikata::Protocol::Object::ObjectMessage* msg, const OSegEntry& sourceObjectData, const OSegEntry& dstObjectData) = 0;
+    // ODP push interface. Note: Must be thread safe! msg_bytes are the bytes
+    // msg was parsed from, or NULL if it was built locally.
+    virtual bool push(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes, const OSegEntry& sourceObjectData, const OSegEntry& dstObjectData) = 0;
 
     // Get the sum of the weights of active queues.
     virtual float totalActiveWeight() = 0;
@@ -126,7 +127,21 @@ protected:
         mParent->notifyPushFront(mDestServer, mServiceID);
     }
 
-    Message* createMessageFromODP(Sirikata::Protocol::Object::ObjectMessage* obj_msg, ServerID dest_serv) {
+    // Wraps an ODP message for the trip to dest_serv. Messages we're passing
+    // along still have the bytes they arrived as, and nothing on the way
+    // through the forwarder changes them, so those go out as is. Only locally
+    // built messages need to be serialized.
+    Message* createMessageFromODP(Sirikata::Protocol::Object::ObjectMessage* obj_msg, const ObjectMessageBytesPtr& obj_msg_bytes, ServerID dest_serv) {
+        if (obj_msg_bytes) {
+            return new Message(
+                mContext->id(),
+                SERVER_PORT_OBJECT_MESSAGE_ROUTING,
+                dest_serv,
+                SERVER_PORT_OBJECT_MESSAGE_ROUTING,
+                obj_msg,
+                *obj_msg_bytes
+            );
+        }
         Message* svr_obj_msg = new Message(
             mContext->id(),
             SERVER_PORT_OBJECT_MESSAGE_ROUTING,
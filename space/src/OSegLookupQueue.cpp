@@ -56,6 +56,11 @@ void OSegLookupQueue::OSegLookupList::push_back(const OSegLookup& lu) {
     OSegLookupVector::push_back(lu);
 }
 
+void OSegLookupQueue::OSegLookupList::swap(OSegLookupList& other) {
+    OSegLookupVector::swap(other);
+    std::swap(mTotalSize, other.mTotalSize);
+}
+
 OSegLookupQueue::OSegLookupList::iterator OSegLookupQueue::OSegLookupList::begin(){
     return OSegLookupVector::begin();
 }
@@ -82,10 +87,10 @@ OSegEntry OSegLookupQueue::cacheLookup(const UUID& destid) const {
     return mOSeg->cacheLookup(destid);
 }
 
-bool OSegLookupQueue::lookup(Sirikata::Protocol::Object::ObjectMessage* msg, const LookupCallback& cb)
+bool OSegLookupQueue::lookup(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes, const LookupCallback& cb)
 {
   UUID dest_obj = msg->dest_object();
-  size_t cursize = msg->ByteSize();
+  size_t cursize = msg_bytes ? msg_bytes->size() : msg->ByteSize();
 
   //if already looking up, do not call lookup on mOSeg;
   LookupMap::const_iterator it = mLookups.find(dest_obj);
@@ -96,6 +101,7 @@ bool OSegLookupQueue::lookup(Sirikata::Protocol::Object::ObjectMessage* msg, con
     mTotalSize += cursize;
     OSegLookup lu;
     lu.msg = msg;
+    lu.msg_bytes = msg_bytes;
     lu.cb = cb;
     lu.size = cursize;
     mLookups[dest_obj].push_back(lu);
@@ -106,7 +112,7 @@ bool OSegLookupQueue::lookup(Sirikata::Protocol::Object::ObjectMessage* msg, con
   OSegEntry destServer= mOSeg->cacheLookup(dest_obj);
   if (destServer.notNull())
   {
-    cb(msg, destServer, ResolvedFromCache);
+    cb(msg, msg_bytes, destServer, ResolvedFromCache);
     return true;
   }
 
@@ -124,7 +130,7 @@ bool OSegLookupQueue::lookup(Sirikata::Protocol::Object::ObjectMessage* msg, con
   destServer = mOSeg->lookup(dest_obj);
   // If we already have a server, handle the callback right away
   if (destServer.notNull()) {
-    cb(msg, destServer, ResolvedFromCache);
+    cb(msg, msg_bytes, destServer, ResolvedFromCache);
     return true;
   }
 
@@ -132,6 +138,7 @@ bool OSegLookupQueue::lookup(Sirikata::Protocol::Object::ObjectMessage* msg, con
   mTotalSize += cursize;
   OSegLookup lu;
   lu.msg = msg;
+  lu.msg_bytes = msg_bytes;
   lu.cb = cb;
   lu.size = cursize;
   mLookups[dest_obj].push_back(lu);
@@ -151,12 +158,17 @@ void OSegLookupQueue::handleLookupCompleted(const UUID& id, const OSegEntry& des
     if (iterQueueMap == mLookups.end())
         return;
 
-    for (int s=0; s < (signed) ((iterQueueMap->second).size()); ++ s) {
-        const OSegLookup& lu = (iterQueueMap->second[s]);
+    // Take the list out of the map first since callbacks may start new
+    // lookups, which can move the map's entries.
+    OSegLookupList lookups;
+    lookups.swap(iterQueueMap->second);
+    mLookups.erase(iterQueueMap);
+
+    for (int s=0; s < (signed) lookups.size(); ++ s) {
+        const OSegLookup& lu = lookups[s];
         mTotalSize -= lu.size;
-        lu.cb(lu.msg, dest, ResolvedFromServer);
+        lu.cb(lu.msg, lu.msg_bytes, dest, ResolvedFromServer);
     }
-    mLookups.erase(iterQueueMap);
 }
 
 } // namespace Sirikata
@@ -36,6 +36,7 @@
 #include <sirikata/core/util/Platform.hpp>
 #include <sirikata/space/ServerMessage.hpp>
 #include <sirikata/space/ObjectSegmentation.hpp>
+#include <sirikata/core/util/UUIDFlatMap.hpp>
 
 namespace Sirikata {
 
@@ -52,15 +53,17 @@ public:
         ResolvedFromServer
     };
 
-    /** Callback type for lookups, taking the message the lookup was performed on, the
-     *  ServerID the OSeg returned, and an enum indicating how the lookup was resolved.
+    /** Callback type for lookups, taking the message the lookup was performed on and
+     *  the bytes it was parsed from (if any), the ServerID the OSeg returned, and an
+     *  enum indicating how the lookup was resolved.
      *  If you need additional information it must be curried via bind().
      */
-    typedef std::tr1::function<void(Sirikata::Protocol::Object::ObjectMessage*, const OSegEntry&, ResolvedFrom)> LookupCallback;
+    typedef std::tr1::function<void(Sirikata::Protocol::Object::ObjectMessage*, const ObjectMessageBytesPtr&, const OSegEntry&, ResolvedFrom)> LookupCallback;
 
 private:
     struct OSegLookup {
         Sirikata::Protocol::Object::ObjectMessage* msg;
+        ObjectMessageBytesPtr msg_bytes;
         LookupCallback cb;
         uint32 size;
     };
@@ -76,11 +79,12 @@ private:
         size_t size() const;
         OSegLookup& operator[] (size_t where);
         void push_back(const OSegLookup& lu);
+        void swap(OSegLookupList& other);
         OSegLookupVector::iterator begin();
         OSegLookupVector::iterator end();
     };
 
-    typedef std::tr1::unordered_map<UUID, OSegLookupList, UUID::Hasher> LookupMap;
+    typedef UUIDFlatMap<OSegLookupList> LookupMap;
 
 
     Network::IOStrand* mNetworkStrand;
@@ -116,10 +120,12 @@ public:
      *  Note that if the request is accepted, the message is owned by the OSegLookupQueue until
      *  the callback is invoked, at which time control is passed back to the caller.
      *  \param msg the ObjectMessage to perform the lookup for
+     *  \param msg_bytes the bytes msg was parsed from, or NULL if it was built
+     *                   locally. These are handed back to the callback.
      *  \param cb the callback to invoke when the lookup is complete
      *  \returns true if the lookup was accepted, false if it was rejected (due to the push predicate).
      */
-    bool lookup(Sirikata::Protocol::Object::ObjectMessage* msg, const LookupCallback& cb);
+    bool lookup(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes, const LookupCallback& cb);
 };
 
 } // namespace Sirikata
@@ -51,11 +51,11 @@ uint64 ObjectConnection::sessionID() const {
     return mSessionSeqno;
 }
 
-bool ObjectConnection::send(Sirikata::Protocol::Object::ObjectMessage* msg) {
+bool ObjectConnection::send(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes) {
     if (!mEnabled)
         return false;
 
-    return mConnectionManager->send(mOHConnection, msg);
+    return mConnectionManager->send(mOHConnection, msg, msg_bytes);
 }
 
 void ObjectConnection::enable() {
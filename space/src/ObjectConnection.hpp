@@ -56,8 +56,9 @@ public:
     /// ObjectHostConnectionID, uniquely identifies the connection.
     uint64 sessionID() const;
 
+    // msg_bytes, if set, are sent in place of serializing msg
     WARN_UNUSED
-    bool send(Sirikata::Protocol::Object::ObjectMessage* msg);
+    bool send(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes = ObjectMessageBytesPtr());
 
     void enable();
 
@@ -70,9 +70,13 @@
 
 #define FORWARDER_SEND_QUEUE_SIZE "forwarder.send-queue-size"
 #define FORWARDER_RECEIVE_QUEUE_SIZE "forwarder.receive-queue-size"
+#define FORWARDER_CREDIT_WINDOW "forwarder.credit-window"
 
 #define OSEG_LOOKUP_QUEUE_SIZE     "oseg_lookup_queue_size"
 
+#define MIGRATION_BATCH_SIZE       "migration-batch-size"
+#define MIGRATION_PRECOPY_WINDOW   "migration-precopy-window"
+
 #define OPT_PROX                   "prox"
 #define OPT_PROX_OPTIONS           "prox-options"
 
@@ -37,6 +37,27 @@
 
 namespace Sirikata {
 
+/** Approximates exp(-x) for x >= 0 to within 1e-7 relative error, without a
+ *  libm call. Results below the normal double range are flushed to 0. Good
+ *  enough for the decay factor of rate estimators which are updated on every
+ *  packet.
+ */
+inline double approxExpNegative(double x) {
+    // exp(-x) = 2^-y with y = x*log2(e). Split y = n + f with f in
+    // [-0.5,0.5], evaluate 2^-f = exp(-f*ln2) with a short polynomial and
+    // apply 2^-n directly to the exponent bits.
+    double y = x * 1.4426950408889634;
+    if (y >= 1022.0)
+        return 0.0;
+    int32 n = (int32)(y + 0.5);
+    double u = (y - n) * 0.6931471805599453;
+    double p = 1.0 + u*(-1.0 + u*(1.0/2 + u*(-1.0/6 + u*(1.0/24 + u*(-1.0/120 + u*(1.0/720 + u*(-1.0/5040)))))));
+    uint64 scale_bits = (uint64)(1023 - n) << 52;
+    double scale;
+    std::memcpy(&scale, &scale_bits, sizeof(scale));
+    return p * scale;
+}
+
 /** Exponential weighted average rate estimator. */
 class RateEstimator {
 public:
@@ -68,20 +89,29 @@ public:
     }
 
     double estimate_rate(const Time& t, uint32 len, double K) {
+        return update(t, len, K, false);
+    }
+
+    /** As estimate_rate, but using approxExpNegative for the decay factor. */
+    double estimate_rate_approx(const Time& t, uint32 len, double K) {
+        return update(t, len, K, true);
+    }
+private:
+    double update(const Time& t, uint32 len, double K, bool approx) {
         Duration diff = t - _t;
         double dt = diff.toSeconds();
         if (dt<1.0e-9) {
             _backlog += len;
             return _value;
         }
-        double blend = exp(-dt/K);
+        double blend = approx ? approxExpNegative(dt/K) : exp(-dt/K);
         uint32 new_bytes = len + _backlog;
         _value=_value*blend+(1-blend)*new_bytes/dt;
         _t = t;
         _backlog = 0;
         return _value;
     }
-private:
+
     double _value;
     Time _t;
     uint32 _backlog;
@@ -0,0 +1,175 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "RegionBVH.hpp"
+
+namespace Sirikata {
+
+namespace {
+
+// Nodes with this many boxes or fewer are leaves. Servers usually have one or
+// a handful of boxes, which then take a single leaf.
+const uint32 MaxLeafBoxes = 4;
+
+struct CenterLess {
+    CenterLess(int axis) : mAxis(axis) {}
+    bool operator()(const BoundingBox3f& lhs, const BoundingBox3f& rhs) const {
+        return lhs.center()[mAxis] < rhs.center()[mAxis];
+    }
+    int mAxis;
+};
+
+// Time for a point at pos moving with velocity dir to leave box, or max_time
+// if that's longer
+float32 timeToExitBox(const BoundingBox3f& box, const Vector3f& pos, const Vector3f& dir, float32 max_time) {
+    Vector3f bmin = box.min(), bmax = box.max();
+    float32 result = max_time;
+    for(int i = 0; i < 3; i++) {
+        // Take care of zeroes in velocity -- if velocity is too small, it
+        // never leaves through this pair of faces
+        if (fabs(dir[i]) < 0.00001f) continue;
+        // The face we're moving toward
+        float32 t = ((dir[i] > 0.f ? bmax[i] : bmin[i]) - pos[i]) / dir[i];
+        result = std::min(result, std::max(t, 0.f));
+    }
+    return result;
+}
+
+bool nodeContains(const float32* mn, const float32* mx, const Vector3f& pos) {
+    return
+        pos.x >= mn[0] && pos.x <= mx[0] &&
+        pos.y >= mn[1] && pos.y <= mx[1] &&
+        pos.z >= mn[2] && pos.z <= mx[2];
+}
+
+}
+
+RegionBVH::RegionBVH()
+ : mUnbounded(false)
+{
+}
+
+RegionBVH::RegionBVH(const BoundingBoxList& boxes)
+ : mUnbounded(false)
+{
+    reset(boxes);
+}
+
+void RegionBVH::reset(const BoundingBoxList& boxes) {
+    mNodes.clear();
+    mBoxes.clear();
+    mUnbounded = false;
+
+    for(BoundingBoxList::const_iterator it = boxes.begin(); it != boxes.end(); it++) {
+        if (it->degenerate()) {
+            mUnbounded = true;
+            mBoxes.clear();
+            return;
+        }
+        mBoxes.push_back(*it);
+    }
+
+    if (mBoxes.empty()) return;
+
+    mNodes.reserve(2 * (mBoxes.size() / MaxLeafBoxes + 1));
+    mNodes.push_back(Node());
+    build(0, 0, mBoxes.size());
+}
+
+void RegionBVH::build(uint32 node_idx, uint32 start, uint32 end) {
+    BoundingBox3f bounds = mBoxes[start];
+    BoundingBox3f centers(bounds.center(), bounds.center());
+    for(uint32 i = start+1; i < end; i++) {
+        bounds.mergeIn(mBoxes[i]);
+        centers.mergeIn(mBoxes[i].center());
+    }
+
+    Node& node = mNodes[node_idx];
+    Vector3f bmin = bounds.min(), bmax = bounds.max();
+    for(int i = 0; i < 3; i++) {
+        node.min[i] = bmin[i];
+        node.max[i] = bmax[i];
+    }
+
+    if (end - start <= MaxLeafBoxes) {
+        node.first = start;
+        node.count = end - start;
+        return;
+    }
+
+    // Median split along the axis the box centers are most spread out on.
+    // Region boxes come from a partitioning of space, so they don't overlap
+    // and this keeps siblings mostly disjoint.
+    const Vector3f& spread = centers.across();
+    int axis = 0;
+    if (spread.y > spread[axis]) axis = 1;
+    if (spread.z > spread[axis]) axis = 2;
+    uint32 mid = (start + end) / 2;
+    std::nth_element(mBoxes.begin() + start, mBoxes.begin() + mid, mBoxes.begin() + end, CenterLess(axis));
+
+    uint32 left = mNodes.size();
+    mNodes.push_back(Node());
+    mNodes.push_back(Node());
+    // node may have been invalidated by the push_backs
+    mNodes[node_idx].first = left;
+    mNodes[node_idx].count = 0;
+
+    build(left, start, mid);
+    build(left+1, mid, end);
+}
+
+int32 RegionBVH::find(const Vector3f& pos) const {
+    if (mNodes.empty()) return -1;
+
+    // Depth is logarithmic in the number of boxes, which is far below this.
+    uint32 stack[64];
+    uint32 sp = 0;
+    stack[sp++] = 0;
+    while(sp > 0) {
+        const Node& node = mNodes[stack[--sp]];
+        if (!nodeContains(node.min, node.max, pos))
+            continue;
+
+        if (node.count == 0) {
+            stack[sp++] = node.first;
+            stack[sp++] = node.first+1;
+            continue;
+        }
+
+        for(uint32 i = node.first; i < node.first + node.count; i++)
+            if (mBoxes[i].contains(pos, 0.0f))
+                return (int32)i;
+    }
+    return -1;
+}
+
+float32 RegionBVH::timeToExit(const Vector3f& pos, const Vector3f& vel, float32 max_time, uint32 max_boxes) const {
+    if (mUnbounded)
+        return max_time;
+
+    int32 box = find(pos);
+    if (box < 0)
+        return 0.f;
+    if (vel.lengthSquared() == 0.f)
+        return max_time;
+
+    // When the edge we hit is shared with another of our boxes the point is
+    // still in the region, so follow it into that box.
+    // Distance past the edge we look for the next box in
+    float32 nudge = 0.001f / vel.length();
+    float32 time_to_exit = 0.f;
+    for(uint32 crossed = 0; crossed < max_boxes; crossed++) {
+        time_to_exit += timeToExitBox(mBoxes[box], pos + vel * time_to_exit, vel, max_time);
+        if (time_to_exit >= max_time)
+            return max_time;
+
+        int32 next_box = find(pos + vel * (time_to_exit + nudge));
+        if (next_box < 0 || next_box == box)
+            break;
+        box = next_box;
+    }
+    return time_to_exit;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,74 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_REGION_BVH_HPP_
+#define _SIRIKATA_REGION_BVH_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+
+namespace Sirikata {
+
+/** A bounding volume hierarchy over the boxes making up a server's region, so
+ *  finding the box containing a point doesn't require checking every box. A
+ *  degenerate box in the list means the region covers the entire world, as
+ *  with CoordinateSegmentation::serverRegion().
+ */
+class RegionBVH {
+public:
+    RegionBVH();
+    explicit RegionBVH(const BoundingBoxList& boxes);
+
+    /** Rebuild the hierarchy over a new set of boxes. */
+    void reset(const BoundingBoxList& boxes);
+
+    /** True if the region covers the entire world. */
+    bool unbounded() const { return mUnbounded; }
+
+    /** Find a box containing pos.
+     *  \returns the box's index, which is only valid for box(), or -1 if no
+     *           box contains pos. Always -1 if the region is unbounded.
+     */
+    int32 find(const Vector3f& pos) const;
+
+    /** Get a box found with find(). */
+    const BoundingBox3f& box(int32 idx) const { return mBoxes[idx]; }
+
+    /** Returns true if pos is in the region. */
+    bool contains(const Vector3f& pos) const {
+        return mUnbounded || find(pos) >= 0;
+    }
+
+    /** Find how long a point starting at pos and moving with velocity vel
+     *  stays in the region, following it through adjacent boxes.
+     *  \param max_time the longest time of interest. If the point stays in the
+     *         region at least this long, max_time is returned.
+     *  \param max_boxes the most boxes to follow the point through. If it
+     *         crosses more, the time it leaves the last one is returned, which
+     *         is earlier than it actually leaves the region.
+     *  \returns the time in seconds, or 0 if pos isn't in the region. Always
+     *           max_time if the region is unbounded.
+     */
+    float32 timeToExit(const Vector3f& pos, const Vector3f& vel, float32 max_time, uint32 max_boxes) const;
+
+private:
+    // Interior nodes (count == 0) have children at first and first+1. Leaves
+    // cover boxes [first, first+count).
+    struct Node {
+        float32 min[3];
+        uint32 first;
+        float32 max[3];
+        uint32 count;
+    };
+
+    void build(uint32 node_idx, uint32 start, uint32 end);
+
+    std::vector<Node> mNodes;
+    // Boxes in leaf order
+    BoundingBoxList mBoxes;
+    bool mUnbounded;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_REGION_BVH_HPP_
@@ -31,15 +31,16 @@
  */
 
 #include "RegionODPFlowScheduler.hpp"
-#include <sirikata/space/CoordinateSegmentation.hpp>
+#include "ServerWeightCache.hpp"
 
 namespace Sirikata {
 
-RegionODPFlowScheduler::RegionODPFlowScheduler(SpaceContext* ctx, ForwarderServiceQueue* parent, ServerID sid, uint32 serv_id, uint32 max_size)
+RegionODPFlowScheduler::RegionODPFlowScheduler(SpaceContext* ctx, ForwarderServiceQueue* parent, ServerID sid, uint32 serv_id, uint32 max_size, ServerWeightCache* weights)
  : ODPFlowScheduler(ctx, parent, sid, serv_id),
    mQueueBuffer(),
    mQueue(Sirikata::SizedResourceMonitor(max_size)),
-   mNeedsNotification(true)
+   mNeedsNotification(true),
+   mServerWeights(weights)
 {
 }
 
@@ -47,8 +48,8 @@ RegionODPFlowScheduler::~RegionODPFlowScheduler() {
 }
 
 // ODP push interface
-bool RegionODPFlowScheduler::push(Sirikata::Protocol::Object::ObjectMessage* msg, const OSegEntry&, const OSegEntry&) {
-    Message* serv_msg = createMessageFromODP(msg, mDestServer);
+bool RegionODPFlowScheduler::push(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes, const OSegEntry&, const OSegEntry&) {
+    Message* serv_msg = createMessageFromODP(msg, msg_bytes, mDestServer);
     if (!mQueue.push(serv_msg, false)) {
         delete serv_msg;
         return false;
@@ -112,27 +113,21 @@ RegionODPFlowScheduler::Type RegionODPFlowScheduler::pop() {
 
 // Get the sum of the weights of active queues.
 float RegionODPFlowScheduler::totalActiveWeight() {
-    BoundingBox3f source_bbox = mContext->cseg()->serverRegion(mContext->id())[0];
-    BoundingBox3f dest_bbox = mContext->cseg()->serverRegion(mDestServer)[0];
-    return mWeightCalculator->weight(source_bbox, dest_bbox);
+    return mServerWeights->weight(mDestServer);
 }
 
 // Get the total used weight of active queues.  If all flows are saturating,
 // this should equal totalActiveWeights, otherwise it will be smaller.
 float RegionODPFlowScheduler::totalSenderUsedWeight() {
     // No flow tracking, so we just give the entire server weight
-    BoundingBox3f source_bbox = mContext->cseg()->serverRegion(mContext->id())[0];
-    BoundingBox3f dest_bbox = mContext->cseg()->serverRegion(mDestServer)[0];
-    return mWeightCalculator->weight(source_bbox, dest_bbox);
+    return mServerWeights->weight(mDestServer);
 }
 
 // Get the total used weight of active queues.  If all flows are saturating,
 // this should equal totalActiveWeights, otherwise it will be smaller.
 float RegionODPFlowScheduler::totalReceiverUsedWeight() {
     // No flow tracking, so we just give the entire server weight
-    BoundingBox3f source_bbox = mContext->cseg()->serverRegion(mContext->id())[0];
-    BoundingBox3f dest_bbox = mContext->cseg()->serverRegion(mDestServer)[0];
-    return mWeightCalculator->weight(source_bbox, dest_bbox);
+    return mServerWeights->weight(mDestServer);
 }
 
 } // namespace Sirikata
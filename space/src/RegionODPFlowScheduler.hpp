@@ -39,13 +39,15 @@
 
 namespace Sirikata {
 
+class ServerWeightCache;
+
 /** RegionODPFlowScheduler doesn't collect any real statistics about ODP flows.
  *  Instead, it uses a simple FIFO queue for packets and just reports
  *  region-to-region weights.
  */
 class RegionODPFlowScheduler : public ODPFlowScheduler {
 public:
-    RegionODPFlowScheduler(SpaceContext* ctx, ForwarderServiceQueue* parent, ServerID sid, uint32 serv_id, uint32 max_size);
+    RegionODPFlowScheduler(SpaceContext* ctx, ForwarderServiceQueue* parent, ServerID sid, uint32 serv_id, uint32 max_size, ServerWeightCache* weights);
     virtual ~RegionODPFlowScheduler();
 
     // Interface: AbstractQueue<Message*>
@@ -56,7 +58,7 @@ public:
     virtual uint32 size() const { return mQueue.getResourceMonitor().filledSize(); }
 
     // ODP push interface
-    virtual bool push(Sirikata::Protocol::Object::ObjectMessage* msg, const OSegEntry&, const OSegEntry&);
+    virtual bool push(Sirikata::Protocol::Object::ObjectMessage* msg, const ObjectMessageBytesPtr& msg_bytes, const OSegEntry&, const OSegEntry&);
     // Get the sum of the weights of active queues.
     virtual float totalActiveWeight();
     // Get the total used weight of active queues.  If all flows are saturating,
@@ -72,6 +74,7 @@ private:
     mutable Message* mQueueBuffer;
     mutable Sirikata::SizedThreadSafeQueue<Message*> mQueue;
     mutable Sirikata::AtomicValue<bool> mNeedsNotification;
+    ServerWeightCache* mServerWeights;
 }; // class RegionODPFlowScheduler
 
 } // namespace Sirikata
@@ -33,6 +33,7 @@
 #include <sirikata/space/SpaceNetwork.hpp>
 #include "Server.hpp"
 #include <sirikata/space/Proximity.hpp>
+#include <sirikata/space/MigrationDataClientRegistry.hpp>
 #include <sirikata/space/CoordinateSegmentation.hpp>
 #include <sirikata/space/ServerMessage.hpp>
 #include <sirikata/core/trace/Trace.hpp>
@@ -41,6 +42,7 @@
 #include "Forwarder.hpp"
 #include "LocalForwarder.hpp"
 #include "MigrationMonitor.hpp"
+#include "Options.hpp"
 
 #include <sirikata/space/ObjectSegmentation.hpp>
 
@@ -73,6 +75,16 @@ void fillVersionInfo(Sirikata::Protocol::Session::IVersionInfo vers_info, SpaceC
 void logVersionInfo(Sirikata::Protocol::Session::VersionInfo vers_info) {
     SPACE_LOG(info, "Object host connection " << (vers_info.has_name() ? vers_info.name() : "(unknown)") << " version " << (vers_info.has_version() ? vers_info.version() : "(unknown)") << " (" << (vers_info.has_vcs_version() ? vers_info.vcs_version() : "") << ")");
 }
+
+// Objects can change course after being pre-copied, so the sender only relies
+// on a pre-copy for a few windows. The receiver holds on to them for longer so
+// it always has the state the sender relies on.
+Duration precopySenderLifetime(const Duration& window) {
+    return window * 4;
+}
+Duration precopyReceiverLifetime(const Duration& window) {
+    return window * 8;
+}
 } // namespace
 
 
@@ -93,6 +105,8 @@ Server::Server(SpaceContext* ctx, Authenticator* auth, Forwarder* forwarder, Loc
    mMigrationSendRunning(false),
    mShutdownRequested(false),
    mObjectHostConnectionManager(NULL),
+   mBatchMigratedOSeg(false),
+   mMigratedOSegAckTo(NullServerID),
    mRouteObjectMessage(Sirikata::SizedResourceMonitor(GetOptionValue<size_t>("route-object-message-buffer"))),
    mTimeSeriesObjects(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".objects")
 {
@@ -104,16 +118,27 @@ Server::Server(SpaceContext* ctx, Authenticator* auth, Forwarder* forwarder, Loc
 
     mMigrateServerMessageService = mForwarder->createServerMessageService("migrate");
 
+    mMigrationBatchSize = std::max((uint32)1, GetOptionValue<uint32>(MIGRATION_BATCH_SIZE));
+    mPrecopyWindow = GetOptionValue<Duration>(MIGRATION_PRECOPY_WINDOW);
+
     mForwarder->registerMessageRecipient(SERVER_PORT_MIGRATION, this);
+    mForwarder->registerMessageRecipient(SERVER_PORT_BULK_MIGRATION, this);
     mForwarder->setODPService(this);
 
       mOSeg->setWriteListener((OSegWriteListener*)this);
 
+      MigrationMonitor::MigrationCallback precopy_cb;
+      if (mPrecopyWindow > Duration::zero()) {
+          precopy_cb = mContext->mainStrand->wrap(
+              std::tr1::bind(&Server::handlePrecopyEvent, this, _1, _2)
+          );
+      }
       mMigrationMonitor = new MigrationMonitor(
           mContext, mLocationService, mCSeg,
           mContext->mainStrand->wrap(
-              std::tr1::bind(&Server::handleMigrationEvent, this, std::tr1::placeholders::_1)
-          )
+              std::tr1::bind(&Server::handleMigrationEvent, this, _1, _2)
+          ),
+          precopy_cb, mPrecopyWindow, precopySenderLifetime(mPrecopyWindow)
       );
 
     // Forwarder::setODPService creates the ODP SST datagram layer allowing us
@@ -179,6 +204,7 @@ Server::~Server()
     delete mMigrateServerMessageService;
 
     mForwarder->unregisterMessageRecipient(SERVER_PORT_MIGRATION, this);
+    mForwarder->unregisterMessageRecipient(SERVER_PORT_BULK_MIGRATION, this);
 
     SPACE_LOG(debug, "mObjects.size=" << mObjects.size());
 
@@ -306,7 +332,7 @@ void Server::sendSessionMessageWithRetry(const ObjectHostConnectionID& conn, Sir
     }
 }
 
-bool Server::onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id, const ShortObjectHostConnectionID short_conn_id, Sirikata::Protocol::Object::ObjectMessage* obj_msg) {
+bool Server::onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id, const ShortObjectHostConnectionID short_conn_id, Sirikata::Protocol::Object::ObjectMessage* obj_msg, const ObjectMessageBytesPtr& obj_msg_bytes) {
     // NOTE that we do forwarding even before the
 
     static UUID spaceID = UUID::null();
@@ -343,13 +369,13 @@ bool Server::onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id,
     // to ship it over a connection.  This checks both the source
     // and dest objects, guaranteeing that the appropriate connections
     // exist for both.
-    if (mLocalForwarder->tryForward(obj_msg))
+    if (mLocalForwarder->tryForward(obj_msg, obj_msg_bytes))
         return true;
 
     // 4. Try to shortcut them main thread. Use forwarder to try to forward
     // using the cache. FIXME when we do this, we skip over some checks that
     // happen during the full forwarding
-    if (mForwarder->tryCacheForward(obj_msg))
+    if (mForwarder->tryCacheForward(obj_msg, obj_msg_bytes))
         return true;
 
     // 5. Otherwise, we're going to have to ship this to the main thread, either
@@ -360,7 +386,7 @@ bool Server::onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id,
     {
         boost::lock_guard<boost::mutex> lock(mRouteObjectMessageMutex);
         hit_empty = (mRouteObjectMessage.probablyEmpty());
-        push_for_processing_success = mRouteObjectMessage.push(ConnectionIDObjectMessagePair(conn_id,obj_msg),false);
+        push_for_processing_success = mRouteObjectMessage.push(ConnectionIDObjectMessagePair(conn_id,obj_msg,obj_msg_bytes),false);
     }
     if (!push_for_processing_success) {
         TIMESTAMP(obj_msg, Trace::SPACE_DROPPED_AT_MAIN_STRAND_CROSSING);
@@ -482,7 +508,7 @@ bool Server::handleSingleObjectHostMessageRouting() {
 
 
     // Finally, if we've passed all these tests, then everything looks good and we can route it
-    mForwarder->routeObjectHostMessage(front.obj_msg);
+    mForwarder->routeObjectHostMessage(front.obj_msg, front.obj_msg_bytes);
     return true;
 }
 
@@ -897,18 +923,80 @@ void Server::receiveMessage(Message* msg)
             delete mig_msg;
         }
         else {
-            const UUID obj_id = mig_msg->object();
-
-            SILOG(space,detailed,"Received server migration message for " << obj_id.toString() << " from server " << mig_msg->source_server());
-
-            mObjectMigrations[obj_id] = mig_msg;
-            // Try to handle this migration if all the info is available
-            handleMigration(obj_id);
+            receiveMigration(mig_msg);
+        }
+        delete msg;
+    }
+    else if (msg->dest_port() == SERVER_PORT_BULK_MIGRATION) {
+        Sirikata::Protocol::Migration::BulkMigrationMessage bulk_msg;
+        bool parsed = parsePBJMessage(&bulk_msg, msg->payload());
+
+        if (parsed) {
+            SILOG(space,detailed,"Received " << (bulk_msg.precopy() ? "pre-copy" : "migration") << " of " << bulk_msg.migrations_size() << " objects from server " << bulk_msg.source_server());
+
+            if (bulk_msg.precopy()) {
+                // Drop anything that was pre-copied but never migrated here
+                Time expired = mContext->simTime() - precopyReceiverLifetime(mPrecopyWindow);
+                for(PrecopiedStateMap::iterator it = mPrecopiedMigrations.begin(); it != mPrecopiedMigrations.end(); ) {
+                    if (it->second.t < expired)
+                        mPrecopiedMigrations.erase(it++);
+                    else
+                        it++;
+                }
+
+                for(int32 i = 0; i < bulk_msg.migrations_size(); i++)
+                    receivePrecopy(bulk_msg.migrations(i));
+            }
+            else {
+                // Objects which can finish migrating right away get their
+                // OSeg entries committed together
+                mBatchMigratedOSeg = true;
+                for(int32 i = 0; i < bulk_msg.migrations_size(); i++)
+                    receiveMigration(new Sirikata::Protocol::Migration::MigrationMessage(bulk_msg.migrations(i)));
+                mBatchMigratedOSeg = false;
+                flushMigratedOSegEntries();
+            }
         }
         delete msg;
     }
 }
 
+void Server::receiveMigration(Sirikata::Protocol::Migration::MigrationMessage* mig_msg) {
+    const UUID obj_id = mig_msg->object();
+
+    SILOG(space,detailed,"Received server migration message for " << obj_id.toString() << " from server " << mig_msg->source_server());
+
+    // Fill in the state the source server left out because it sent it ahead
+    // of time
+    if (mig_msg->precopied()) {
+        PrecopiedStateMap::iterator pre_it = mPrecopiedMigrations.find(obj_id);
+        if (pre_it != mPrecopiedMigrations.end()) {
+            if (!pre_it->second.mesh.empty())
+                mig_msg->set_mesh(pre_it->second.mesh);
+            if (!pre_it->second.physics.empty())
+                mig_msg->set_physics(pre_it->second.physics);
+            mPrecopiedMigrations.erase(pre_it);
+        }
+        else {
+            SILOG(space,error,"Missing pre-copied state for migration of " << obj_id.toString());
+        }
+    }
+    else {
+        mPrecopiedMigrations.erase(obj_id);
+    }
+
+    mObjectMigrations[obj_id] = mig_msg;
+    // Try to handle this migration if all the info is available
+    handleMigration(obj_id);
+}
+
+void Server::receivePrecopy(const Sirikata::Protocol::Migration::MigrationMessage& mig_msg) {
+    PrecopiedState& state = mPrecopiedMigrations[mig_msg.object()];
+    state.t = mContext->simTime();
+    state.mesh = mig_msg.has_mesh() ? mig_msg.mesh() : "";
+    state.physics = mig_msg.has_physics() ? mig_msg.physics() : "";
+}
+
 //handleMigration to this server.
 void Server::handleMigration(const UUID& obj_id)
 {
@@ -968,22 +1056,14 @@ void Server::handleMigration(const UUID& obj_id)
 
     //update our oseg to show that we know that we have this object now.
     ServerID idOSegAckTo = (ServerID)migrate_msg->source_server();
-    mOSeg->addMigratedObject(obj_id, obj_bounds.radius(), idOSegAckTo, true);//true states to send an ack message to idOSegAckTo
+    addMigratedOSegEntry(obj_id, obj_bounds.radius(), idOSegAckTo);
+
+    if (migrate_msg->has_migration_start())
+        CONTEXT_SPACETRACE(objectMigrationPause, obj_id, idOSegAckTo, mContext->id(), mContext->simTime() - migrate_msg->migration_start());
 
 
     // Handle any data packed into the migration message for space components
-    for(int32 i = 0; i < migrate_msg->client_data_size(); i++) {
-        Sirikata::Protocol::Migration::MigrationClientData client_data = migrate_msg->client_data(i);
-        std::string tag = client_data.key();
-        // FIXME these should live in a map, how do we deal with ordering constraints?
-        if (tag == "prox") {
-            assert( tag == mProximity->migrationClientTag() );
-            mProximity->receiveMigrationData(obj_id, /* FIXME */NullServerID, mContext->id(), client_data.data());
-        }
-        else {
-            SILOG(space,error,"Got unknown tag for client migration data");
-        }
-    }
+    mContext->migrationDataClients()->receiveMigrationData(obj_id, (ServerID)migrate_msg->source_server(), mContext->id(), *migrate_msg);
 
     // Stage this connection with the forwarder, don't enable until ack is received
     mForwarder->addObjectConnection(obj_id, obj_conn);
@@ -1021,7 +1101,69 @@ void Server::stop() {
     mShutdownRequested = true;
 }
 
-void Server::handleMigrationEvent(const UUID& obj_id) {
+void Server::fillMigrationState(Sirikata::Protocol::Migration::IMigrationMessage& migrate_msg, const UUID& obj_id) {
+    migrate_msg.set_source_server(mContext->id());
+    migrate_msg.set_object(obj_id);
+    Sirikata::Protocol::ITimedMotionVector migrate_loc = migrate_msg.mutable_loc();
+    TimedMotionVector3f obj_loc = mLocationService->location(obj_id);
+    migrate_loc.set_t( obj_loc.updateTime() );
+    migrate_loc.set_position( obj_loc.position() );
+    migrate_loc.set_velocity( obj_loc.velocity() );
+    Sirikata::Protocol::ITimedMotionQuaternion migrate_orient = migrate_msg.mutable_orientation();
+    TimedMotionQuaternion obj_orient = mLocationService->orientation(obj_id);
+    migrate_orient.set_t( obj_orient.updateTime() );
+    migrate_orient.set_position( obj_orient.position() );
+    migrate_orient.set_velocity( obj_orient.velocity() );
+    migrate_msg.set_bounds( mLocationService->bounds(obj_id) );
+}
+
+void Server::fillMigrationMessage(Sirikata::Protocol::Migration::IMigrationMessage& migrate_msg, const UUID& obj_id, ServerID new_server_id) {
+    fillMigrationState(migrate_msg, obj_id);
+    migrate_msg.set_migration_start(mContext->simTime());
+
+    const String& obj_mesh = mLocationService->mesh(obj_id);
+    const String& obj_phy = mLocationService->physics(obj_id);
+
+    // Leave out state the destination already has, as long as it hasn't
+    // changed since it was sent and it won't have been discarded yet
+    bool precopied = false;
+    PrecopiedObjectMap::iterator pre_it = mPrecopiedObjects.find(obj_id);
+    if (pre_it != mPrecopiedObjects.end()) {
+        precopied =
+            pre_it->second.server == new_server_id &&
+            mContext->simTime() - pre_it->second.t < precopySenderLifetime(mPrecopyWindow) &&
+            pre_it->second.mesh == obj_mesh &&
+            pre_it->second.physics == obj_phy;
+        mPrecopiedObjects.erase(pre_it);
+    }
+
+    if (precopied) {
+        migrate_msg.set_precopied(true);
+    }
+    else {
+        if (obj_mesh.size() > 0)
+            migrate_msg.set_mesh( obj_mesh );
+        if (obj_phy.size() > 0)
+            migrate_msg.set_physics( obj_phy );
+    }
+
+    // Let space components package up their state
+    mContext->migrationDataClients()->generateMigrationData(obj_id, mContext->id(), new_server_id, migrate_msg);
+}
+
+void Server::queueBulkMigrationMessage(ServerID dest, Sirikata::Protocol::Migration::BulkMigrationMessage& bulk_msg) {
+    bulk_msg.set_source_server(mContext->id());
+    Message* bulk_msg_packet = new Message(
+        mContext->id(),
+        SERVER_PORT_BULK_MIGRATION,
+        dest,
+        SERVER_PORT_BULK_MIGRATION,
+        serializePBJMessage(bulk_msg)
+    );
+    mMigrateMessages.push(bulk_msg_packet);
+}
+
+void Server::handleMigrationEvent(ServerID dest, const std::vector<UUID>& objs) {
     // * wrap up state and send message to other server
     //     to reinstantiate the object there
     // * delete object on this side
@@ -1029,9 +1171,22 @@ void Server::handleMigrationEvent(const UUID& obj_id) {
     // Make sure we aren't getting an out of date event
     // FIXME
 
-    if (mOSeg->clearToMigrate(obj_id)) //needs to check whether migration to this server has finished before can begin migrating to another server.
-    {
-        ObjectConnection* obj_conn = mObjects[obj_id];
+    // Objects are batched up per destination. dest is the MigrationMonitor's
+    // guess, but CSeg gets the final say for each object below.
+    typedef std::map<ServerID, Sirikata::Protocol::Migration::BulkMigrationMessage> BulkMigrationMap;
+    BulkMigrationMap bulk_msgs;
+    ObjectSegmentation::OSegEntryList oseg_migrations;
+
+    for(std::vector<UUID>::const_iterator obj_it = objs.begin(); obj_it != objs.end(); obj_it++) {
+        const UUID& obj_id = *obj_it;
+
+        if (!mOSeg->clearToMigrate(obj_id)) //needs to check whether migration to this server has finished before can begin migrating to another server.
+            continue;
+
+        ObjectConnectionMap::iterator conn_it = mObjects.find(obj_id);
+        if (conn_it == mObjects.end())
+            continue;
+        ObjectConnection* obj_conn = conn_it->second;
 
         Vector3f obj_pos = mLocationService->currentPosition(obj_id);
         ServerID new_server_id = mCSeg->lookup(obj_pos);
@@ -1039,55 +1194,31 @@ void Server::handleMigrationEvent(const UUID& obj_id) {
         // FIXME should be this
         //assert(new_server_id != mContext->id());
         // but I'm getting inconsistencies, so we have to just trust CSeg to have the final say
-        if (new_server_id != mContext->id()) {
-
-            SILOG(space,detailed,"Starting migration of " << obj_id.toString() << " from " << mContext->id() << " to " << new_server_id);
+        if (new_server_id == mContext->id())
+            continue;
 
-            Sirikata::Protocol::Session::Container session_msg;
-            if (obj_conn->sessionID() != 0) session_msg.set_seqno(obj_conn->sessionID());
-            Sirikata::Protocol::Session::IInitiateMigration init_migration_msg = session_msg.mutable_init_migration();
-            init_migration_msg.set_new_server( (uint64)new_server_id );
-            Sirikata::Protocol::Object::ObjectMessage* init_migr_obj_msg = createObjectMessage(
-                mContext->id(),
-                UUID::null(), OBJECT_PORT_SESSION,
-                obj_id, OBJECT_PORT_SESSION,
-                serializePBJMessage(session_msg)
-            );
-            // Sent directly via object host connection manager because ObjectConnection is disappearing
-            sendSessionMessageWithRetry(obj_conn->connID(), init_migr_obj_msg, Duration::seconds(0.05));
-            BoundingSphere3f obj_bounds=mLocationService->bounds(obj_id);
-            mOSeg->migrateObject(obj_id,OSegEntry(new_server_id,obj_bounds.radius()));
+        SILOG(space,detailed,"Starting migration of " << obj_id.toString() << " from " << mContext->id() << " to " << new_server_id);
 
-            // Send out the migrate message
+        Sirikata::Protocol::Session::Container session_msg;
+        if (obj_conn->sessionID() != 0) session_msg.set_seqno(obj_conn->sessionID());
+        Sirikata::Protocol::Session::IInitiateMigration init_migration_msg = session_msg.mutable_init_migration();
+        init_migration_msg.set_new_server( (uint64)new_server_id );
+        Sirikata::Protocol::Object::ObjectMessage* init_migr_obj_msg = createObjectMessage(
+            mContext->id(),
+            UUID::null(), OBJECT_PORT_SESSION,
+            obj_id, OBJECT_PORT_SESSION,
+            serializePBJMessage(session_msg)
+        );
+        // Sent directly via object host connection manager because ObjectConnection is disappearing
+        sendSessionMessageWithRetry(obj_conn->connID(), init_migr_obj_msg, Duration::seconds(0.05));
+        BoundingSphere3f obj_bounds=mLocationService->bounds(obj_id);
+        oseg_migrations.push_back( std::make_pair(obj_id, OSegEntry(new_server_id,obj_bounds.radius())) );
+
+        // Package up the migrate message, either on its own or as part of
+        // the batch for its destination
+        if (mMigrationBatchSize == 1) {
             Sirikata::Protocol::Migration::MigrationMessage migrate_msg;
-            migrate_msg.set_source_server(mContext->id());
-            migrate_msg.set_object(obj_id);
-            Sirikata::Protocol::ITimedMotionVector migrate_loc = migrate_msg.mutable_loc();
-            TimedMotionVector3f obj_loc = mLocationService->location(obj_id);
-            migrate_loc.set_t( obj_loc.updateTime() );
-            migrate_loc.set_position( obj_loc.position() );
-            migrate_loc.set_velocity( obj_loc.velocity() );
-            Sirikata::Protocol::ITimedMotionQuaternion migrate_orient = migrate_msg.mutable_orientation();
-            TimedMotionQuaternion obj_orient = mLocationService->orientation(obj_id);
-            migrate_orient.set_t( obj_orient.updateTime() );
-            migrate_orient.set_position( obj_orient.position() );
-            migrate_orient.set_velocity( obj_orient.velocity() );
-            migrate_msg.set_bounds( obj_bounds );
-            String obj_mesh = mLocationService->mesh(obj_id);
-            if (obj_mesh.size() > 0)
-                migrate_msg.set_mesh( obj_mesh );
-
-            // FIXME we should allow components to package up state here
-            // FIXME we should generate these from some map instead of directly
-            std::string prox_data = mProximity->generateMigrationData(obj_id, mContext->id(), new_server_id);
-            if (!prox_data.empty()) {
-                Sirikata::Protocol::Migration::IMigrationClientData client_data = migrate_msg.add_client_data();
-                client_data.set_key( mProximity->migrationClientTag() );
-                client_data.set_data( prox_data );
-            }
-
-            // Stop tracking the object locally
-            //            mLocationService->removeLocalObject(obj_id);
+            fillMigrationMessage(migrate_msg, obj_id, new_server_id);
             Message* migrate_msg_packet = new Message(
                 mContext->id(),
                 SERVER_PORT_MIGRATION,
@@ -1096,40 +1227,101 @@ void Server::handleMigrationEvent(const UUID& obj_id) {
                 serializePBJMessage(migrate_msg)
             );
             mMigrateMessages.push(migrate_msg_packet);
+        }
+        else {
+            BulkMigrationMap::iterator bulk_it = bulk_msgs.find(new_server_id);
+            if (bulk_it == bulk_msgs.end())
+                bulk_it = bulk_msgs.insert( BulkMigrationMap::value_type(new_server_id, Sirikata::Protocol::Migration::BulkMigrationMessage()) ).first;
+            Sirikata::Protocol::Migration::IMigrationMessage migrate_msg = bulk_it->second.add_migrations();
+            fillMigrationMessage(migrate_msg, obj_id, new_server_id);
+            if ((uint32)bulk_it->second.migrations_size() >= mMigrationBatchSize) {
+                queueBulkMigrationMessage(new_server_id, bulk_it->second);
+                bulk_msgs.erase(bulk_it);
+            }
+        }
 
-            // Stop Forwarder from delivering via this Object's
-            // connection, destroy said connection
+        // Stop Forwarder from delivering via this Object's
+        // connection, destroy said connection
 
-            //bftm: candidate for multiple obj connections
+        //bftm: candidate for multiple obj connections
 
-            //end bftm change
-            //  mMigratingConnections[obj_id] = mForwarder->getObjectConnection(obj_id);
-            MigratingObjectConnectionsData mocd;
+        //end bftm change
+        //  mMigratingConnections[obj_id] = mForwarder->getObjectConnection(obj_id);
+        MigratingObjectConnectionsData mocd;
 
-            mocd.obj_conner           =   mForwarder->getObjectConnection(obj_id, mocd.uniqueConnId);
-            Duration migrateStartDur  =                 mMigrationTimer.elapsed();
-            mocd.milliseconds         =          migrateStartDur.toMilliseconds();
-            mocd.migratingTo          =                             new_server_id;
-            mocd.loc                  =        mLocationService->location(obj_id);
-            mocd.bnds                 =          mLocationService->bounds(obj_id);
-            mocd.serviceConnection    =                                      true;
+        mocd.obj_conner           =   mForwarder->getObjectConnection(obj_id, mocd.uniqueConnId);
+        Duration migrateStartDur  =                 mMigrationTimer.elapsed();
+        mocd.milliseconds         =          migrateStartDur.toMilliseconds();
+        mocd.migratingTo          =                             new_server_id;
+        mocd.loc                  =        mLocationService->location(obj_id);
+        mocd.bnds                 =                                obj_bounds;
+        mocd.serviceConnection    =                                      true;
 
-            mMigratingConnections[obj_id] = mocd;
+        mMigratingConnections[obj_id] = mocd;
 
 
 
-            // Stop tracking the object locally
-            mLocationService->removeLocalObject(obj_id);
+        // Stop tracking the object locally
+        mLocationService->removeLocalObject(obj_id);
 
-            mLocalForwarder->removeActiveConnection(obj_id);
-            mObjects.erase(obj_id);
-            mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
-            ObjectReference obj(obj_id);
+        mLocalForwarder->removeActiveConnection(obj_id);
+        mObjects.erase(obj_id);
+        ObjectReference obj(obj_id);
+
+        mObjectSessionManager->removeSession(obj);
+    }
+    mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+
+    for(BulkMigrationMap::iterator bulk_it = bulk_msgs.begin(); bulk_it != bulk_msgs.end(); bulk_it++)
+        queueBulkMigrationMessage(bulk_it->first, bulk_it->second);
+
+    if (!oseg_migrations.empty())
+        mOSeg->migrateObjects(oseg_migrations);
+
+    startSendMigrationMessages();
+}
 
-            mObjectSessionManager->removeSession(obj);
+void Server::handlePrecopyEvent(ServerID dest, const std::vector<UUID>& objs) {
+    Time now = mContext->simTime();
+
+    // Forget pre-copies for objects that never ended up migrating
+    Time expired = now - precopySenderLifetime(mPrecopyWindow);
+    for(PrecopiedObjectMap::iterator it = mPrecopiedObjects.begin(); it != mPrecopiedObjects.end(); ) {
+        if (it->second.t < expired)
+            mPrecopiedObjects.erase(it++);
+        else
+            it++;
+    }
+
+    std::vector<UUID>::const_iterator obj_it = objs.begin();
+    while(obj_it != objs.end()) {
+        Sirikata::Protocol::Migration::BulkMigrationMessage bulk_msg;
+        bulk_msg.set_precopy(true);
+        for(; obj_it != objs.end() && (uint32)bulk_msg.migrations_size() < mMigrationBatchSize; obj_it++) {
+            const UUID& obj_id = *obj_it;
+            if (mObjects.find(obj_id) == mObjects.end() || !mLocationService->contains(obj_id))
+                continue;
+
+            // Proximity state isn't copied since generating it tears down the
+            // object's query; only the bulky, rarely changing state goes early.
+            Sirikata::Protocol::Migration::IMigrationMessage precopy_msg = bulk_msg.add_migrations();
+            fillMigrationState(precopy_msg, obj_id);
+            PrecopiedObject& precopied = mPrecopiedObjects[obj_id];
+            precopied.server = dest;
+            precopied.t = now;
+            precopied.mesh = mLocationService->mesh(obj_id);
+            precopied.physics = mLocationService->physics(obj_id);
+            if (!precopied.mesh.empty())
+                precopy_msg.set_mesh(precopied.mesh);
+            if (!precopied.physics.empty())
+                precopy_msg.set_physics(precopied.physics);
         }
+        if (bulk_msg.migrations_size() > 0)
+            queueBulkMigrationMessage(dest, bulk_msg);
     }
 
+    SILOG(space,detailed,"Pre-copying " << objs.size() << " objects to server " << dest);
+
     startSendMigrationMessages();
 }
 
@@ -1166,6 +1358,26 @@ void Server::trySendMigrationMessages() {
     );
 }
 
+void Server::addMigratedOSegEntry(const UUID& obj_id, float radius, ServerID ack_to) {
+    if (!mBatchMigratedOSeg) {
+        mOSeg->addMigratedObject(obj_id, radius, ack_to, true);//true states to send an ack message to ack_to
+        return;
+    }
+
+    // A batch is acked to a single server, which should always be the
+    // sender of the bulk message.
+    if (!mMigratedOSegEntries.empty() && mMigratedOSegAckTo != ack_to)
+        flushMigratedOSegEntries();
+    mMigratedOSegAckTo = ack_to;
+    mMigratedOSegEntries.push_back( std::make_pair(obj_id, OSegEntry(mContext->id(), radius)) );
+}
+
+void Server::flushMigratedOSegEntries() {
+    if (mMigratedOSegEntries.empty()) return;
+    mOSeg->addMigratedObjects(mMigratedOSegEntries, mMigratedOSegAckTo, true);
+    mMigratedOSegEntries.clear();
+}
+
 /*
   This function migrates an object to this server that was in the process of migrating away from this server (except the killconn message hasn't come yet.
 
@@ -1222,23 +1434,15 @@ void Server::processAlreadyMigrating(const UUID& obj_id)
 
     //update our oseg to show that we know that we have this object now.
     OSegEntry idOSegAckTo ((ServerID)migrate_msg->source_server(),migrate_msg->bounds().radius());
-    mOSeg->addMigratedObject(obj_id, idOSegAckTo.radius(), idOSegAckTo.server(), true);//true states to send an ack message to idOSegAckTo
+    addMigratedOSegEntry(obj_id, idOSegAckTo.radius(), idOSegAckTo.server());
+
+    if (migrate_msg->has_migration_start())
+        CONTEXT_SPACETRACE(objectMigrationPause, obj_id, idOSegAckTo.server(), mContext->id(), mContext->simTime() - migrate_msg->migration_start());
 
 
 
     // Handle any data packed into the migration message for space components
-    for(int32 i = 0; i < migrate_msg->client_data_size(); i++) {
-        Sirikata::Protocol::Migration::MigrationClientData client_data = migrate_msg->client_data(i);
-        std::string tag = client_data.key();
-        // FIXME these should live in a map, how do we deal with ordering constraints?
-        if (tag == "prox") {
-            assert( tag == mProximity->migrationClientTag() );
-            mProximity->receiveMigrationData(obj_id, /* FIXME */NullServerID, mContext->id(), client_data.data());
-        }
-        else {
-            SILOG(space,error,"Got unknown tag for client migration data");
-        }
-    }
+    mContext->migrationDataClients()->receiveMigrationData(obj_id, (ServerID)migrate_msg->source_server(), mContext->id(), *migrate_msg);
 
 
     //remove the forwarding connection that already exists for that object
@@ -117,14 +117,24 @@ private:
     // before using the forwarder to do routing.  Operates in the
     // network strand to allow for fast forwarding, see
     // handleObjectHostMessageRouting for continuation in main strand
-    virtual bool onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id, const ShortObjectHostConnectionID short_conn_id, Sirikata::Protocol::Object::ObjectMessage*);
+    virtual bool onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id, const ShortObjectHostConnectionID short_conn_id, Sirikata::Protocol::Object::ObjectMessage*, const ObjectMessageBytesPtr&);
     // Disconnection events, forwarded to
     // handleObjectHostConnectionClosed in main strand
     virtual void onObjectHostDisconnected(const ObjectHostConnectionID& conn_id, const ShortObjectHostConnectionID short_conn_id);
 
 
-    // Handle a migration event generated by the MigrationMonitor
-    void handleMigrationEvent(const UUID& objid);
+    // Handle a migration event generated by the MigrationMonitor for objects
+    // which should move to dest
+    void handleMigrationEvent(ServerID dest, const std::vector<UUID>& objs);
+    // Handle a pre-copy event generated by the MigrationMonitor, sending
+    // state for objs that is expected to be needed by dest soon
+    void handlePrecopyEvent(ServerID dest, const std::vector<UUID>& objs);
+    // Fill in the parts of a migration message every migration carries
+    void fillMigrationState(Sirikata::Protocol::Migration::IMigrationMessage& migrate_msg, const UUID& obj_id);
+    // Fill in the rest of migration message for an object migrating to dest
+    void fillMigrationMessage(Sirikata::Protocol::Migration::IMigrationMessage& migrate_msg, const UUID& obj_id, ServerID dest);
+    // Queue a BulkMigrationMessage to be sent to dest
+    void queueBulkMigrationMessage(ServerID dest, Sirikata::Protocol::Migration::BulkMigrationMessage& bulk_msg);
 
     // Starts the process of trying to send migration messages, or continues one if it's already running.
     void startSendMigrationMessages();
@@ -169,6 +179,10 @@ private:
     // Handle Migrate message from object
     void handleMigrate(const ObjectHostConnectionID& oh_conn_id, const Sirikata::Protocol::Object::ObjectMessage& container, const Sirikata::Protocol::Session::Connect& migrate_msg, uint64 seqno);
 
+    // Handle a parsed migration message from another server, taking ownership of it
+    void receiveMigration(Sirikata::Protocol::Migration::MigrationMessage* mig_msg);
+    // Store pre-copied state to be used when the object actually migrates
+    void receivePrecopy(const Sirikata::Protocol::Migration::MigrationMessage& mig_msg);
     // Performs actual migration after all the necessary information is available.
     void handleMigration(const UUID& obj_id);
 
@@ -183,6 +197,12 @@ private:
     bool checkAlreadyMigrating(const UUID& obj_id);
     void processAlreadyMigrating(const UUID& obj_id);
 
+    // Record in OSeg that an object migrated here from ack_to. While a bulk
+    // migration is being handled, entries are collected and committed
+    // together by flushMigratedOSegEntries.
+    void addMigratedOSegEntry(const UUID& obj_id, float radius, ServerID ack_to);
+    void flushMigratedOSegEntries();
+
     void newStream(int err, SST::Stream<SpaceObjectReference>::Ptr s);
 
 
@@ -252,6 +272,38 @@ private:
     MigConnectionsMap mMigratingConnections;//bftm add
     Timer mMigrationTimer;
 
+    // Maximum number of objects sent in a single BulkMigrationMessage. At 1
+    // every object gets its own MigrationMessage.
+    uint32 mMigrationBatchSize;
+    // How far ahead of migrations mesh and physics are pre-copied, or zero
+    // to disable pre-copying.
+    Duration mPrecopyWindow;
+
+    // OSeg entries for objects that migrated here, collected while handling
+    // a BulkMigrationMessage so they can be committed at once.
+    bool mBatchMigratedOSeg;
+    ServerID mMigratedOSegAckTo;
+    ObjectSegmentation::OSegEntryList mMigratedOSegEntries;
+
+    // State pre-copied to another server, on the sending side. Only used if
+    // the object still matches it when it migrates.
+    struct PrecopiedObject {
+        ServerID server;
+        Time t;
+        String mesh;
+        String physics;
+    };
+    typedef std::tr1::unordered_map<UUID, PrecopiedObject, UUID::Hasher> PrecopiedObjectMap;
+    PrecopiedObjectMap mPrecopiedObjects;
+    // State pre-copied from another server, on the receiving side.
+    struct PrecopiedState {
+        Time t;
+        String mesh;
+        String physics;
+    };
+    typedef std::tr1::unordered_map<UUID, PrecopiedState, UUID::Hasher> PrecopiedStateMap;
+    PrecopiedStateMap mPrecopiedMigrations;
+
     struct StoredConnection
     {
       ObjectHostConnectionID    conn_id;
@@ -266,9 +318,11 @@ private:
     struct ConnectionIDObjectMessagePair{
         ObjectHostConnectionID conn_id;
         Sirikata::Protocol::Object::ObjectMessage* obj_msg;
-        ConnectionIDObjectMessagePair(ObjectHostConnectionID conn_id, Sirikata::Protocol::Object::ObjectMessage*msg) {
+        ObjectMessageBytesPtr obj_msg_bytes;
+        ConnectionIDObjectMessagePair(ObjectHostConnectionID conn_id, Sirikata::Protocol::Object::ObjectMessage*msg, const ObjectMessageBytesPtr& msg_bytes = ObjectMessageBytesPtr()) {
             this->conn_id=conn_id;
             this->obj_msg=msg;
+            this->obj_msg_bytes=msg_bytes;
         }
         size_t size() const{
             return 1;
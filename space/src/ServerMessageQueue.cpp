@@ -80,10 +80,12 @@ uint32 ServerMessageQueue::trySend(const ServerID& dest, const Message* msg) {
     if (strm_out==NULL) {
         return 0;
     }
-    Network::Chunk serialized;
-    msg->serialize(&serialized);
-    uint32 packet_size = serialized.size();
-    bool sent_success = strm_out->send(serialized);
+    // The payload goes to the network straight from the message, after its
+    // serialized header
+    std::string header;
+    msg->serializeHeader(&header);
+    uint32 packet_size = header.size() + msg->payload().size();
+    bool sent_success = strm_out->send(MemoryReference(header), MemoryReference(msg->payload()));
 
     if (sent_success) {
         TIMESTAMP_PAYLOAD(msg, Trace::SPACE_TO_SPACE_HIT_NETWORK);
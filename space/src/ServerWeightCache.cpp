@@ -0,0 +1,69 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "ServerWeightCache.hpp"
+#include <sirikata/core/options/CommonOptions.hpp>
+
+namespace Sirikata {
+
+ServerWeightCache::ServerWeightCache(SpaceContext* ctx)
+ : mContext(ctx),
+   mWeightCalculator(
+       RegionWeightCalculatorFactory::getSingleton().getConstructor(GetOptionValue<String>(OPT_REGION_WEIGHT))(GetOptionValue<String>(OPT_REGION_WEIGHT_ARGS))
+   ),
+   mLocalRegionValid(false)
+{
+}
+
+ServerWeightCache::~ServerWeightCache() {
+    delete mWeightCalculator;
+}
+
+BoundingBox3f ServerWeightCache::region(ServerID sid) {
+    return mContext->cseg()->serverRegion(sid)[0];
+}
+
+double ServerWeightCache::weight(ServerID dest) {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+
+    EntryMap::iterator it = mEntries.find(dest);
+    if (it != mEntries.end())
+        return it->second.weight;
+
+    if (!mLocalRegionValid) {
+        mLocalRegion = region(mContext->id());
+        mLocalRegionValid = true;
+    }
+    Entry entry;
+    entry.region = region(dest);
+    entry.weight = mWeightCalculator->weight(mLocalRegion, entry.region);
+    mEntries[dest] = entry;
+    return entry.weight;
+}
+
+void ServerWeightCache::updatedSegmentation(CoordinateSegmentation* cseg, const std::vector<SegmentationInfo>& new_segmentation) {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+
+    // Only weights involving a server whose region actually changed need to
+    // be recomputed. If our own region changed, that's all of them.
+    for(std::vector<SegmentationInfo>::const_iterator seg_it = new_segmentation.begin(); seg_it != new_segmentation.end(); seg_it++) {
+        if (seg_it->region.empty())
+            continue;
+        const BoundingBox3f& new_region = seg_it->region[0];
+
+        if (seg_it->server == mContext->id()) {
+            if (mLocalRegionValid && mLocalRegion != new_region) {
+                mEntries.clear();
+                mLocalRegionValid = false;
+            }
+            continue;
+        }
+
+        EntryMap::iterator it = mEntries.find(seg_it->server);
+        if (it != mEntries.end() && it->second.region != new_region)
+            mEntries.erase(it);
+    }
+}
+
+} // namespace Sirikata
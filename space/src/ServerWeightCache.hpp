@@ -0,0 +1,57 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SERVER_WEIGHT_CACHE_HPP_
+#define _SIRIKATA_SERVER_WEIGHT_CACHE_HPP_
+
+#include <sirikata/space/SpaceContext.hpp>
+#include <sirikata/space/CoordinateSegmentation.hpp>
+#include <sirikata/core/util/RegionWeightCalculator.hpp>
+
+namespace Sirikata {
+
+/** Caches the region weight between this server and each remote server, as
+ *  computed by the configured RegionWeightCalculator over the servers'
+ *  regions. The forwarder asks for these weights for every remote server
+ *  several times per weight update, but they only change when the
+ *  segmentation does, so each is integrated once and kept until one of the
+ *  two regions it covers changes.
+ *
+ *  This needs to be registered as a CoordinateSegmentation::Listener to see
+ *  those changes.
+ */
+class ServerWeightCache : public CoordinateSegmentation::Listener {
+public:
+    ServerWeightCache(SpaceContext* ctx);
+    virtual ~ServerWeightCache();
+
+    /** Get the weight of traffic from this server's region to dest's. */
+    double weight(ServerID dest);
+
+    // CoordinateSegmentation::Listener Interface
+    virtual void updatedSegmentation(CoordinateSegmentation* cseg, const std::vector<SegmentationInfo>& new_segmentation);
+
+private:
+    // The box weights are computed over. Like the rest of the forwarder, this
+    // only uses the first box of a server's region.
+    BoundingBox3f region(ServerID sid);
+
+    struct Entry {
+        BoundingBox3f region;
+        double weight;
+    };
+    typedef std::tr1::unordered_map<ServerID, Entry> EntryMap;
+
+    SpaceContext* mContext;
+    RegionWeightCalculator* mWeightCalculator;
+
+    boost::mutex mMutex;
+    bool mLocalRegionValid;
+    BoundingBox3f mLocalRegion;
+    EntryMap mEntries;
+}; // class ServerWeightCache
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SERVER_WEIGHT_CACHE_HPP_
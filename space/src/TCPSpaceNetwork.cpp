@@ -56,6 +56,7 @@ TCPSpaceNetwork::RemoteStream::RemoteStream(TCPSpaceNetwork* parent, Sirikata::N
           initiator(init),
           connected(false),
           shutting_down(false),
+          intro_received(false),
           receive_queue( CountResourceMonitor(16) ),
           paused(false)
 {
@@ -153,6 +154,10 @@ ServerID TCPSpaceNetwork::TCPSendStream::id() const {
 }
 
 bool TCPSpaceNetwork::TCPSendStream::send(const Chunk& data) {
+    return send(MemoryReference(data), MemoryReference::null());
+}
+
+bool TCPSpaceNetwork::TCPSendStream::send(MemoryReference first, MemoryReference second) {
     if (!session)
         return false;
 
@@ -163,7 +168,7 @@ bool TCPSpaceNetwork::TCPSendStream::send(const Chunk& data) {
     bool success = (
         remote_stream->connected &&
         !remote_stream->shutting_down &&
-        remote_stream->stream->send(data, ReliableOrdered));
+        remote_stream->stream->send(first, second, ReliableOrdered));
 
     if (!success)
         remote_stream->stream->requestReadySendCallback();
@@ -440,8 +445,10 @@ void TCPSpaceNetwork::newStreamCallback(Sirikata::Network::Stream* newStream,
 
     IndirectTCPReceiveStream ind_recv_stream( new TCPReceiveStream*(NULL) );
 
+    // Connection events change the shared connection state, so make sure
+    // they're handled on our strand even if the stream runs on another one.
     setCallbacks(
-        std::tr1::bind(&TCPSpaceNetwork::connectionCallback, this, weak_remote_stream, _1, _2),
+        mIOStrand->wrap(std::tr1::bind(&TCPSpaceNetwork::connectionCallback, this, weak_remote_stream, _1, _2)),
         std::tr1::bind(&TCPSpaceNetwork::bytesReceivedCallback, this, weak_remote_stream, ind_recv_stream, _1, _2),
         std::tr1::bind(&TCPSpaceNetwork::readySendCallback, this, weak_remote_stream)
     );
@@ -472,6 +479,8 @@ void TCPSpaceNetwork::connectionCallback(RemoteStreamWPtr wstream, const Sirikat
         remote_stream->connected = true;
         // Add to list of connections and notify listeners of connection
         handleConnectedStream(remote_stream);
+        // Just in case the receive stream got paused
+        remote_stream->stream->readyRead();
     }
     else {
         TCPNET_LOG(error,"Unhandled send stream connection status: " << (int)status << " -- " << reason);
@@ -490,35 +499,24 @@ void TCPSpaceNetwork::bytesReceivedCallback(RemoteStreamWPtr wstream, IndirectTC
     // If the stream hasn't been marked as connected, this *should* be
     // the initial header
     if (remote_stream->connected == false) {
-        assert( *ind_recv_strm == NULL );
         // The stream might already be closing.  If so, just ignore this data.
         if (remote_stream->shutting_down)
             return;
 
-        // Remove from the list of pending connections
-        TCPNET_LOG(info,"Parsing endpoint information for incomplete remote-initiated remote stream.");
-        Address4 source_addr = remote_stream->network_endpoint;
-        RemoteNetStreamMap::iterator it = mPendingStreams.find(source_addr);
-        if (it == mPendingStreams.end()) {
-            TCPNET_LOG(error,"Address for connection not found in pending receive buffers"); // FIXME print addr
-        }
-        else {
-            mPendingStreams.erase(it);
-        }
-
-        // Parse the header indicating the remote ID
-        Sirikata::Protocol::Server::ServerIntro intro;
-        bool parsed = parsePBJMessage(&intro, data);
-        if (!parsed) {
-            LOG_INVALID_MESSAGE(tcpnetwork, error, data);
+        // Data following the intro has to wait until the intro has been
+        // handled. handleIntro pokes the stream with readyRead() once it's
+        // done, which will redeliver it.
+        if (remote_stream->intro_received) {
+            pause();
             return;
         }
 
-        TCPNET_LOG(info,"Parsed remote endpoint information from " << intro.id());
-        remote_stream->logical_endpoint = intro.id();
-        remote_stream->connected = true;
-        TCPReceiveStream* recv_strm = handleConnectedStream(remote_stream);
-        *ind_recv_strm = recv_strm;
+        remote_stream->intro_received = true;
+        // When the stream shares our strand this runs immediately.
+        mIOStrand->dispatch(
+            std::tr1::bind(&TCPSpaceNetwork::handleIntro, this, remote_stream, ind_recv_strm, data),
+            "TCPSpaceNetwork::handleIntro"
+        );
     }
     else {
         TCPNET_LOG(insane,"Handling regular received data from " << remote_stream->logical_endpoint << ".");
@@ -540,6 +538,48 @@ void TCPSpaceNetwork::bytesReceivedCallback(RemoteStreamWPtr wstream, IndirectTC
     }
 }
 
+void TCPSpaceNetwork::handleIntro(RemoteStreamPtr remote_stream, IndirectTCPReceiveStream ind_recv_strm, Chunk data) {
+    assert( *ind_recv_strm == NULL );
+    // The stream might have started closing while we were waiting.
+    if (remote_stream->shutting_down)
+        return;
+
+    // Remove from the list of pending connections
+    TCPNET_LOG(info,"Parsing endpoint information for incomplete remote-initiated remote stream.");
+    Address4 source_addr = remote_stream->network_endpoint;
+    RemoteNetStreamMap::iterator it = mPendingStreams.find(source_addr);
+    if (it == mPendingStreams.end()) {
+        TCPNET_LOG(error,"Address for connection not found in pending receive buffers"); // FIXME print addr
+    }
+    else {
+        mPendingStreams.erase(it);
+    }
+
+    // Parse the header indicating the remote ID
+    Sirikata::Protocol::Server::ServerIntro intro;
+    bool parsed = parsePBJMessage(&intro, data);
+    if (!parsed) {
+        LOG_INVALID_MESSAGE(tcpnetwork, error, data);
+        // Treat the next message as the intro instead, releasing it if it
+        // was held back while we were busy with this one.
+        remote_stream->intro_received = false;
+        remote_stream->stream->readyRead();
+        return;
+    }
+
+    TCPNET_LOG(info,"Parsed remote endpoint information from " << intro.id());
+    remote_stream->logical_endpoint = intro.id();
+    TCPReceiveStream* recv_strm = handleConnectedStream(remote_stream);
+    // Only mark the stream connected once the receive stream is available to
+    // the stream's strand, which may be checking connected concurrently.
+    *ind_recv_strm = recv_strm;
+    remote_stream->connected = true;
+    // Only now release any data that was held back behind the intro. Poking
+    // the stream any earlier could redeliver it while connected is still
+    // false, pausing the stream again with nothing left to resume it.
+    remote_stream->stream->readyRead();
+}
+
 void TCPSpaceNetwork::readySendCallback(RemoteStreamWPtr wstream) {
     RemoteStreamPtr remote_stream(wstream);
     if (!remote_stream)
@@ -705,10 +745,9 @@ TCPSpaceNetwork::TCPReceiveStream* TCPSpaceNetwork::handleConnectedStream(Remote
     TCPReceiveStream* receive_stream = getNewReceiveStream(remote_id);
     TCPSendStream* send_stream = getNewSendStream(remote_id);
 
-    // And poke the stream in both directions -- since we're now ready to send
-    // and just in case the receive stream got paused
+    // And poke the stream for sending since we're now ready. Callers poke the
+    // receive side once they've marked the stream connected.
     mSendListener->networkReadyToSend(remote_id);
-    remote_stream->stream->readyRead();
     return receive_stream;
 }
 
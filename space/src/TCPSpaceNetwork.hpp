@@ -38,6 +38,7 @@
 #include <sirikata/core/network/Stream.hpp>
 #include <sirikata/core/network/StreamListener.hpp>
 #include <sirikata/core/util/PluginManager.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
 #include <sirikata/core/queue/SizedThreadSafeQueue.hpp>
 #include <sirikata/core/queue/CountResourceMonitor.hpp>
 
@@ -72,17 +73,23 @@ class TCPSpaceNetwork : public SpaceNetwork {
 
         Initiator initiator;
 
-        bool connected; // Indicates if the initial header specifying
+        Sirikata::AtomicValue<bool> connected; // Indicates if the initial header specifying
                         // the remote endpoint has been sent or
                         // received (depending on which side initiated
                         // the connection). If this is true then this
                         // connection should be in the map of
                         // connections and it should be safe to send
-                        // data on it.
+                        // data on it. Read on the stream's
+                        // strand while the network strand sets it.
         bool shutting_down; // Inidicates if this connection is
                             // currently being shutdown. Will be true
                             // if another stream to the same endpoint
                             // was preferred over this one.
+        Sirikata::AtomicValue<bool> intro_received; // Indicates the initial
+                             // header arrived from the remote endpoint. It
+                             // may still be waiting to be handled on the
+                             // network strand, in which case connected is
+                             // still false.
         typedef Sirikata::SizedThreadSafeQueue<Chunk*,CountResourceMonitor> SizedChunkReceiveQueue;
         SizedChunkReceiveQueue receive_queue; // Note: This can't be a single
                                               // front item or the receive queue
@@ -139,6 +146,7 @@ class TCPSpaceNetwork : public SpaceNetwork {
 
         virtual ServerID id() const;
         virtual bool send(const Chunk&);
+        virtual bool send(MemoryReference first, MemoryReference second);
 
     private:
         ServerID logical_endpoint;
@@ -243,7 +251,8 @@ class TCPSpaceNetwork : public SpaceNetwork {
     void finishOpenConnection(const ServerID& dest, ServerID resolved_dest, Address4 addr);
 
     // Add stream to system, possibly resolving conflicting sets of
-    // streams. Return corresponding TCPReceiveStream*
+    // streams. Return corresponding TCPReceiveStream*. Callers should poke
+    // the stream with readyRead() once they've marked it connected.
     TCPReceiveStream* handleConnectedStream(RemoteStreamPtr source_stream);
     // Mark a send stream as disconnected
     void handleDisconnectedStream(const RemoteStreamPtr& wstream);
@@ -290,6 +299,11 @@ class TCPSpaceNetwork : public SpaceNetwork {
     // which is cleaned up separately.)
     typedef std::tr1::shared_ptr<TCPReceiveStream*> IndirectTCPReceiveStream;
     void bytesReceivedCallback(RemoteStreamWPtr wstream, IndirectTCPReceiveStream ind_recv_strm, Chunk& data, const Sirikata::Network::Stream::PauseReceiveCallback& pause);
+    // Accepted streams may deliver data on their own strand (e.g. when the
+    // listener spreads connections over several reactors), but the intro
+    // message updates shared connection state, so it is always handled here,
+    // on mIOStrand.
+    void handleIntro(RemoteStreamPtr remote_stream, IndirectTCPReceiveStream ind_recv_strm, Chunk data);
     void readySendCallback(RemoteStreamWPtr wstream);
 
 public:
@@ -39,6 +39,7 @@
 
 #include <sirikata/space/ObjectHostSession.hpp>
 #include <sirikata/space/ObjectSessionManager.hpp>
+#include <sirikata/space/MigrationDataClientRegistry.hpp>
 #include <sirikata/space/Authenticator.hpp>
 
 #include <sirikata/space/SpaceNetwork.hpp>
@@ -200,6 +201,7 @@ int main(int argc, char** argv) {
 
     ObjectHostSessionManager* oh_sess_mgr = new ObjectHostSessionManager(space_context);
     ObjectSessionManager* obj_sess_mgr = new ObjectSessionManager(space_context);
+    MigrationDataClientRegistry* migration_data_clients = new MigrationDataClientRegistry(space_context);
 
     String auth_type = GetOptionValue<String>(SPACE_OPT_AUTH);
     String auth_opts = GetOptionValue<String>(SPACE_OPT_AUTH_OPTIONS);
@@ -210,6 +212,7 @@ int main(int argc, char** argv) {
 
 
     Forwarder* forwarder = new Forwarder(space_context);
+    gNetwork->addListener((SpaceNetworkConnectionListener*)forwarder);
 
 
     String cseg_type = GetOptionValue<String>(CSEG);
@@ -400,8 +403,10 @@ int main(int argc, char** argv) {
     delete oseg;
     delete oseg_cache;
     delete loc_service;
+    gNetwork->removeListener((SpaceNetworkConnectionListener*)forwarder);
     delete forwarder;
 
+    delete migration_data_clients;
     delete obj_sess_mgr;
     delete oh_sess_mgr;
 
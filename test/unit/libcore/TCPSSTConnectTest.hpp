@@ -267,7 +267,7 @@ public:
 
     Sirikata::PluginManager plugins;
 
-    SstTest():mCount(0),mDisconCount(0),mEndCount(0),ENDSTRING("T end"),mAbortTest(false) {
+    SstTest(const String& listenOptions=String()):mCount(0),mDisconCount(0),mEndCount(0),ENDSTRING("T end"),mAbortTest(false) {
         plugins.load( "tcpsst" );
 
         uint32 randport = 3000 + (uint32)(Sirikata::Task::LocalTime::now().raw() % 20000);
@@ -276,7 +276,7 @@ public:
         mServicePool = new IOServicePool("SstTest", 4);
         mServiceStrand = mServicePool->service()->createStrand("SstTest");
 
-        mListener = StreamListenerFactory::getSingleton().getDefaultConstructor()(mServiceStrand,StreamListenerFactory::getSingleton().getDefaultOptionParser()(String()));
+        mListener = StreamListenerFactory::getSingleton().getDefaultConstructor()(mServiceStrand,StreamListenerFactory::getSingleton().getDefaultOptionParser()(listenOptions));
         using std::tr1::placeholders::_1;
         using std::tr1::placeholders::_2;
         mListener->listen(Address("127.0.0.1",mPort),std::tr1::bind(&SstTest::listenerNewStreamCallback,this,0,_1,_2));
@@ -528,15 +528,23 @@ public:
             SstTest zero;//no fragmentation
             zero.doConnectSend("0");
         }
+        {
+            SstTest deflate("--compression=deflate");//compressed frames
+            deflate.doConnectSend("0","--compression=deflate --compression-min-size=16");
+        }
+        {
+            SstTest reactors("--io-reactors=2");//accepted streams on their own reactors
+            reactors.doConnectSend("0");
+        }
         
     }
-    void doConnectSend (std::string fragmentLevel="0" )
+    void doConnectSend (std::string fragmentLevel="0", std::string extraOptions="" )
     {
         dedStreams.clear();
         Stream*z=NULL;
         bool doSubstreams=true;
         {
-            Stream *r=StreamFactory::getSingleton().getDefaultConstructor()(mServiceStrand,StreamFactory::getSingleton().getDefaultOptionParser()(String("--websocket-draft-76=false --test-fragment-packet-level=")+fragmentLevel));
+            Stream *r=StreamFactory::getSingleton().getDefaultConstructor()(mServiceStrand,StreamFactory::getSingleton().getDefaultOptionParser()(String("--websocket-draft-76=false --test-fragment-packet-level=")+fragmentLevel+" "+extraOptions));
             simpleConnect(r,Address("127.0.0.1",mPort));
             runRoutine(r);
             if (doSubstreams) {
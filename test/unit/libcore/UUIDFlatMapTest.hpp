@@ -0,0 +1,123 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/util/UUIDFlatMap.hpp>
+#include <map>
+
+class UUIDFlatMapTest : public CxxTest::TestSuite
+{
+    typedef Sirikata::UUID UUID;
+    typedef Sirikata::UUIDFlatMap<int> IntMap;
+    typedef std::map<UUID, int> RefMap;
+
+    void checkSame(const IntMap& map, const RefMap& ref) {
+        TS_ASSERT_EQUALS(map.size(), ref.size());
+        for(RefMap::const_iterator it = ref.begin(); it != ref.end(); it++) {
+            IntMap::const_iterator found = map.find(it->first);
+            TS_ASSERT(found != map.end());
+            if (found != map.end())
+                TS_ASSERT_EQUALS(found->second, it->second);
+        }
+        size_t iterated = 0;
+        for(IntMap::const_iterator it = map.begin(); it != map.end(); it++) {
+            TS_ASSERT(ref.find(it->first) != ref.end());
+            iterated++;
+        }
+        TS_ASSERT_EQUALS(iterated, ref.size());
+    }
+public:
+
+    void testInsertFind() {
+        IntMap map;
+        TS_ASSERT(map.empty());
+
+        UUID a = UUID::random(), b = UUID::random();
+        TS_ASSERT(map.insert(IntMap::value_type(a, 1)).second);
+        TS_ASSERT(!map.insert(IntMap::value_type(a, 2)).second);
+        map[b] = 3;
+
+        TS_ASSERT_EQUALS(map.size(), 2);
+        TS_ASSERT_EQUALS(map.find(a)->second, 1);
+        TS_ASSERT_EQUALS(map[b], 3);
+        TS_ASSERT_EQUALS(map.count(UUID::random()), 0);
+        TS_ASSERT(map.find(UUID::null()) == map.end());
+    }
+
+    void testEraseReuse() {
+        IntMap map;
+        UUID a = UUID::random();
+        map[a] = 1;
+        TS_ASSERT_EQUALS(map.erase(a), 1);
+        TS_ASSERT_EQUALS(map.erase(a), 0);
+        TS_ASSERT(map.empty());
+        TS_ASSERT(map.find(a) == map.end());
+
+        map[a] = 2;
+        TS_ASSERT_EQUALS(map[a], 2);
+        TS_ASSERT_EQUALS(map.size(), 1);
+    }
+
+    void testMatchesStdMap() {
+        // Enough churn to force growth and tombstone cleanup
+        IntMap map;
+        RefMap ref;
+        std::vector<UUID> ids;
+        for(int i = 0; i < 2000; i++)
+            ids.push_back(UUID::random());
+        for(int i = 0; i < 20000; i++) {
+            const UUID& id = ids[rand() % ids.size()];
+            if (rand() % 3 == 0) {
+                TS_ASSERT_EQUALS(map.erase(id), ref.erase(id));
+            }
+            else {
+                map[id] = i;
+                ref[id] = i;
+            }
+        }
+        checkSame(map, ref);
+    }
+
+    void testEraseWhileIterating() {
+        IntMap map;
+        RefMap ref;
+        for(int i = 0; i < 500; i++) {
+            UUID id = UUID::random();
+            map[id] = i;
+            if (i % 2 == 0) ref[id] = i;
+        }
+        for(IntMap::iterator it = map.begin(); it != map.end(); ) {
+            IntMap::iterator cur = it++;
+            if (cur->second % 2 != 0)
+                map.erase(cur);
+        }
+        checkSame(map, ref);
+    }
+
+    void testCopySwapClear() {
+        IntMap map;
+        RefMap ref;
+        for(int i = 0; i < 100; i++) {
+            UUID id = UUID::random();
+            map[id] = i;
+            ref[id] = i;
+        }
+
+        IntMap copy(map);
+        checkSame(copy, ref);
+
+        IntMap other;
+        other.swap(copy);
+        checkSame(other, ref);
+        TS_ASSERT(copy.empty());
+
+        map.clear();
+        TS_ASSERT(map.empty());
+        TS_ASSERT(map.begin() == map.end());
+        checkSame(other, ref);
+
+        map = other;
+        checkSame(map, ref);
+    }
+};
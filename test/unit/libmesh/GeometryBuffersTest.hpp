@@ -0,0 +1,97 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/mesh/GeometryBuffers.hpp>
+
+using namespace Sirikata;
+using namespace Sirikata::Mesh;
+
+class GeometryBuffersTest : public CxxTest::TestSuite
+{
+public:
+
+    void testIndexListStays16Bit() {
+        IndexList l;
+        l.push_back(0);
+        l.push_back(65535);
+
+        TS_ASSERT(!l.is32Bit());
+        TS_ASSERT_EQUALS(l.size(), 2u);
+        TS_ASSERT_EQUALS(l[1], 65535u);
+        TS_ASSERT_EQUALS(l.byteSize(), 4u);
+    }
+
+    void testIndexListWidens() {
+        IndexList l;
+        l.push_back(1);
+        l.push_back(2);
+        l.push_back(70000);
+
+        TS_ASSERT(l.is32Bit());
+        TS_ASSERT_EQUALS(l.size(), 3u);
+        TS_ASSERT_EQUALS(l[0], 1u);
+        TS_ASSERT_EQUALS(l[2], 70000u);
+        TS_ASSERT_EQUALS(l.maxIndex(), 70000u);
+
+        l.set(2, 3);
+        TS_ASSERT(l.narrow());
+        TS_ASSERT(!l.is32Bit());
+        TS_ASSERT_EQUALS(l[2], 3u);
+    }
+
+    void testIndexListAppendOffset() {
+        IndexList a, b;
+        a.push_back(0);
+        b.push_back(0);
+        b.push_back(10);
+
+        // Offset pushes the appended indices past 16-bits
+        a.append(b, 65530);
+        TS_ASSERT(a.is32Bit());
+        TS_ASSERT_EQUALS(a.size(), 3u);
+        TS_ASSERT_EQUALS(a[0], 0u);
+        TS_ASSERT_EQUALS(a[1], 65530u);
+        TS_ASSERT_EQUALS(a[2], 65540u);
+
+        // Mixed widths compare by value
+        IndexList c;
+        c.push_back(0); c.push_back(65530); c.push_back(65540);
+        TS_ASSERT(a == c);
+        c.set(0, 1);
+        TS_ASSERT(a != c);
+    }
+
+    void testPositionBoundsAndTransform() {
+        std::vector<Vector3f> pos;
+        pos.push_back(Vector3f(1, 0, 0));
+        pos.push_back(Vector3f(0, -2, 0));
+        pos.push_back(Vector3f(0, 0, 100));
+
+        std::vector<bool> mask(3, true);
+        mask[2] = false;
+
+        PositionArrays arrays;
+        arrays.assign(pos, mask);
+        TS_ASSERT_EQUALS(arrays.size(), 2u);
+
+        arrays.transform(Matrix4x4f::translate(Vector3f(1, 1, 1)));
+
+        BoundingBox3f3f bounds;
+        double radius;
+        arrays.computeBounds(&bounds, &radius);
+        TS_ASSERT_EQUALS(bounds.min(), Vector3f(1, -1, 1));
+        TS_ASSERT_EQUALS(bounds.max(), Vector3f(2, 1, 1));
+        TS_ASSERT_DELTA(radius, sqrt(6.0), 1e-5);
+    }
+
+    void testPositionBoundsEmpty() {
+        PositionArrays arrays;
+        BoundingBox3f3f bounds;
+        double radius = 1.;
+        arrays.computeBounds(&bounds, &radius);
+        TS_ASSERT(bounds == BoundingBox3f3f::null());
+        TS_ASSERT_EQUALS(radius, 0.);
+    }
+};
@@ -0,0 +1,131 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/mesh/Meshdata.hpp>
+#include <sirikata/mesh/Raytrace.hpp>
+
+using namespace Sirikata;
+using namespace Sirikata::Mesh;
+
+class MeshBVHTest : public CxxTest::TestSuite
+{
+    // A bumpy n x n grid in the xy plane, instanced once at the origin and
+    // once shifted up by 5 in z.
+    MeshdataPtr makeGrid(uint32 n) {
+        SubMeshGeometry geo;
+        for(uint32 y = 0; y <= n; y++)
+            for(uint32 x = 0; x <= n; x++)
+                geo.positions.push_back(Vector3f(x, y, .25f * sin(x * .7f) * cos(y * .3f)));
+        SubMeshGeometry::Primitive prim;
+        prim.primitiveType = SubMeshGeometry::Primitive::TRIANGLES;
+        prim.materialId = 0;
+        for(uint32 y = 0; y < n; y++) {
+            for(uint32 x = 0; x < n; x++) {
+                uint32 a = y*(n+1)+x, b = a+1, c = a+n+1, d = c+1;
+                prim.indices.push_back(a); prim.indices.push_back(b); prim.indices.push_back(d);
+                prim.indices.push_back(a); prim.indices.push_back(d); prim.indices.push_back(c);
+            }
+        }
+        geo.primitives.push_back(prim);
+
+        MeshdataPtr md(new Meshdata());
+        md->geometry.push_back(geo);
+        md->globalTransform = Matrix4x4f::identity();
+        md->nodes.push_back(Node(Matrix4x4f::identity()));
+        md->nodes.push_back(Node(0, Matrix4x4f::translate(Vector3f(0, 0, 5))));
+        md->nodes[0].children.push_back(1);
+        md->rootNodes.push_back(0);
+        for(NodeIndex ni = 0; ni < 2; ni++) {
+            GeometryInstance geoinst;
+            geoinst.geometryIndex = 0;
+            geoinst.parentNode = ni;
+            md->instances.push_back(geoinst);
+        }
+        return md;
+    }
+
+    // Reference result: test every triangle.
+    bool bruteForce(MeshdataPtr md, const Matrix4x4f& xform, const Vector3f& start, const Vector3f& dir, float32* t_out) {
+        bool hit = false;
+        float32 t = 1000000.f;
+        Meshdata::GeometryInstanceIterator geoinst_it = md->getGeometryInstanceIterator();
+        uint32 geoinst_idx;
+        Matrix4x4f geoinst_xform;
+        while(geoinst_it.next(&geoinst_idx, &geoinst_xform)) {
+            const SubMeshGeometry& geo = md->geometry[ md->instances[geoinst_idx].geometryIndex ];
+            Matrix4x4f full = xform * geoinst_xform;
+            const IndexList& idx = geo.primitives[0].indices;
+            for(uint32 i = 0; i + 2 < idx.size(); i += 3) {
+                Vector3f v0 = full * geo.positions[idx[i]];
+                Vector3f e1 = full * geo.positions[idx[i+1]] - v0;
+                Vector3f e2 = full * geo.positions[idx[i+2]] - v0;
+                Vector3f p = dir.cross(e2);
+                float32 det = e1.dot(p);
+                if (fabs(det) < 1e-12f) continue;
+                Vector3f tv = start - v0;
+                float32 u = tv.dot(p) / det;
+                Vector3f q = tv.cross(e1);
+                float32 v = dir.dot(q) / det;
+                float32 tt = e2.dot(q) / det;
+                if (u < 0 || v < 0 || u + v > 1 || tt < 0 || tt > t) continue;
+                t = tt;
+                hit = true;
+            }
+        }
+        *t_out = t;
+        return hit;
+    }
+
+public:
+
+    void testBuild() {
+        MeshdataPtr md = makeGrid(20);
+        MeshBVHPtr bvh = md->getBVH();
+        TS_ASSERT_EQUALS(bvh->numTriangles(), 2u * 2u * 20u * 20u);
+        TS_ASSERT(bvh->numNodes() > 1u);
+        TS_ASSERT(bvh->bounds().min().z < 0.f);
+        TS_ASSERT(bvh->bounds().max().z > 5.f);
+        // Cached until invalidated
+        TS_ASSERT(md->getBVH() == bvh);
+        md->invalidateBVH();
+        TS_ASSERT(md->getBVH() != bvh);
+        // Copies don't share the cache
+        Meshdata copy(*md);
+        TS_ASSERT(copy.getBVH() != md->getBVH());
+    }
+
+    void testMatchesBruteForce() {
+        MeshdataPtr md = makeGrid(20);
+        Matrix4x4f xform = Matrix4x4f::translate(Vector3f(3, -2, 1)) * Matrix4x4f::scale(2.f);
+
+        std::vector<Vector3f> starts, dirs;
+        for(uint32 i = 0; i < 200; i++) {
+            starts.push_back(Vector3f(-5.f + (i % 17) * 3.f, -6.f + (i % 13) * 4.f, 30.f - (i % 3) * 12.f));
+            dirs.push_back(Vector3f((i % 7) * .3f - 1.f, (i % 5) * .4f - .8f, -1.f));
+        }
+
+        uint32 expected_hits = 0;
+        for(uint32 i = 0; i < starts.size(); i++) {
+            float32 expected_t, t;
+            bool expected = bruteForce(md, xform, starts[i], dirs[i], &expected_t);
+            if (expected) expected_hits++;
+            Vector3f hit_pos;
+            TS_ASSERT_EQUALS(Raytrace(md, xform, starts[i], dirs[i], &t, &hit_pos), expected);
+            if (expected)
+                TS_ASSERT_DELTA(t, expected_t, 1e-3f);
+        }
+        TS_ASSERT(expected_hits > 0);
+
+        std::vector<float32> ts;
+        std::vector<bool> hits;
+        TS_ASSERT_EQUALS(Raytrace(md, xform, starts, dirs, &ts, &hits), expected_hits);
+        for(uint32 i = 0; i < starts.size(); i++) {
+            float32 expected_t;
+            TS_ASSERT_EQUALS(hits[i], bruteForce(md, xform, starts[i], dirs[i], &expected_t));
+            if (hits[i])
+                TS_ASSERT_DELTA(ts[i], expected_t, 1e-3f);
+        }
+    }
+};
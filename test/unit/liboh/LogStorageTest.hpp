@@ -0,0 +1,160 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include "StorageTestBase.hpp"
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+class LogStorageTest : public CxxTest::TestSuite
+{
+    static const String dbfile;
+    static const String compactfile;
+    StorageTestBase _base;
+
+    // Options are shared between instances, so always give all of them
+    static String args(const String& db, uint64 compact_min_size) {
+        return
+            String("--db=") + db +
+            " --compact-min-size=" + boost::lexical_cast<String>(compact_min_size) +
+            " --compact-ratio=2";
+    }
+public:
+    LogStorageTest()
+     : _base("oh-logstore", "log", args(dbfile, 16777216))
+    {
+    }
+
+    void setUp() {_base.setUp(); }
+    void tearDown() {_base.tearDown(); }
+
+    void testSetupTeardown() {_base.testSetupTeardown(); }
+    void testSingleWrite() {_base.testSingleWrite(); }
+    void testSingleRead() {_base.testSingleRead(); }
+    void testSingleInvalidRead() {_base.testSingleInvalidRead(); }
+    void testSingleCompare() {_base.testSingleCompare(); }
+    void testSingleInvalidCompare() {_base.testSingleInvalidCompare(); }
+    void testSingleErase() {_base.testSingleErase(); }
+
+    void testMultiWrite() {_base.testMultiWrite(); }
+    void testMultiRead() {_base.testMultiRead(); }
+    void testMultiInvalidRead() {_base.testMultiInvalidRead(); }
+    void testMultiSomeInvalidRead() {_base.testMultiSomeInvalidRead(); }
+    void testMultiErase() {_base.testMultiErase(); }
+
+    void testAtomicWrite() {_base.testAtomicWrite(); }
+    void testAtomicWriteErase() {_base.testAtomicWriteErase(); }
+
+    void testRangeRead() {_base.testRangeRead(); }
+    void testCount() {_base.testCount(); }
+    void testRangeErase() {_base.testRangeErase(); }
+
+    void testAllTransaction() {_base.testAllTransaction(); }
+
+    void testRollback() {_base.testRollback(); }
+
+    // Compare with SQLiteStorageTest::testThroughput
+    void testThroughput() {_base.testThroughput(); }
+
+    void testPersistence() {_base.testPersistence(); }
+
+    void testPartialTailRecord() {
+        // A record that was only partly written when the process died is
+        // dropped, and records written after restarting aren't lost behind it.
+        _base.writeAndWait(0, "tail:a", "abcde");
+        _base.tearDown();
+
+        uint64 valid_size = boost::filesystem::file_size(dbfile);
+        {
+            // The header promises a 64 byte payload but only 4 bytes follow
+            const char partial[] = { 64, 0, 0, 0, 1, 2, 3, 4, 'p', 'a', 'r', 't' };
+            std::ofstream log(dbfile.c_str(), std::ios::binary | std::ios::app);
+            log.write(partial, sizeof(partial));
+        }
+
+        _base.setUp();
+        _base.checkValue(0, "tail:a", "abcde");
+        TS_ASSERT_EQUALS(boost::filesystem::file_size(dbfile), valid_size);
+
+        _base.writeAndWait(0, "tail:b", "fghij");
+        _base.restart();
+        _base.checkValue(0, "tail:a", "abcde");
+        _base.checkValue(0, "tail:b", "fghij");
+
+        _base.eraseAndWait(0, "tail:a");
+        _base.eraseAndWait(0, "tail:b");
+    }
+
+    void testCorruptTailRecord() {
+        // Each write is its own record, so corrupting the last byte of the log
+        // only invalidates the second one.
+        _base.writeAndWait(0, "corrupt:a", "abcde");
+        _base.writeAndWait(0, "corrupt:b", "fghij");
+        _base.tearDown();
+
+        uint64 size = boost::filesystem::file_size(dbfile);
+        {
+            std::fstream log(dbfile.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+            log.seekg(size - 1);
+            char last = log.get();
+            log.seekp(size - 1);
+            log.put(last ^ 0x7F);
+        }
+
+        _base.setUp();
+        _base.checkValue(0, "corrupt:a", "abcde");
+        _base.checkMissing(0, "corrupt:b");
+        TS_ASSERT_LESS_THAN(boost::filesystem::file_size(dbfile), size);
+
+        _base.writeAndWait(0, "corrupt:c", "klmno");
+        _base.restart();
+        _base.checkValue(0, "corrupt:a", "abcde");
+        _base.checkMissing(0, "corrupt:b");
+        _base.checkValue(0, "corrupt:c", "klmno");
+
+        _base.eraseAndWait(0, "corrupt:a");
+        _base.eraseAndWait(0, "corrupt:c");
+    }
+
+    void testCompaction() {
+        // Compact whenever the log is twice the size of the live data, so
+        // compactions keep overlapping with commits.
+        _base.tearDown();
+        boost::filesystem::remove(compactfile);
+        _base.setArgs(args(compactfile, 0));
+        _base.setUp();
+
+        const int32 nkeys = 10, nwrites = 500;
+        uint64 written = 0;
+        for(int32 i = 0; i < nwrites; i++) {
+            String key = "compact:" + boost::lexical_cast<String>(i % nkeys);
+            String value = boost::lexical_cast<String>(i);
+            _base.writeAndWait(i % 2, key, value);
+            written += key.size() + value.size();
+        }
+        _base.eraseAndWait(0, "compact:0");
+
+        // Compaction finishes in the background, so give it a moment
+        uint64 size = boost::filesystem::file_size(compactfile);
+        for(int32 i = 0; i < 100 && size > written / 4; i++) {
+            Timer::sleep(Duration::milliseconds(50));
+            size = boost::filesystem::file_size(compactfile);
+        }
+        TS_ASSERT_LESS_THAN(size, written / 4);
+
+        _base.restart();
+        _base.checkMissing(0, "compact:0");
+        for(int32 i = nwrites - nkeys + 1; i < nwrites; i++)
+            _base.checkValue(i % 2, "compact:" + boost::lexical_cast<String>(i % nkeys), boost::lexical_cast<String>(i));
+
+        _base.tearDown();
+        _base.setArgs(args(dbfile, 16777216));
+        _base.setUp();
+        boost::filesystem::remove(compactfile);
+        boost::filesystem::remove(compactfile + ".lock");
+    }
+};
+
+const String LogStorageTest::dbfile("test.log");
+const String LogStorageTest::compactfile("compact-test.log");
@@ -72,6 +72,41 @@ public:
     void testAllTransaction() {_base.testAllTransaction(); }
 
     void testRollback() {_base.testRollback(); }
+
+    void testThroughput() {_base.testThroughput(); }
 };
 
 const String SQLiteStorageTest::dbfile("test.db");
+
+// Same tests, but with the options for high write loads: write-ahead
+// logging, memory mapped I/O and a longer group commit window.
+class SQLiteWALStorageTest : public CxxTest::TestSuite
+{
+    static const String dbfile;
+    StorageTestBase _base;
+public:
+    SQLiteWALStorageTest()
+     : _base("oh-sqlite", "sqlite", String("--db=") + dbfile + " --wal=true --mmap-size=16777216 --group-commit-window=20ms")
+    {
+    }
+
+    void setUp() {_base.setUp(); }
+    void tearDown() {_base.tearDown(); }
+
+    void testSingleWrite() {_base.testSingleWrite(); }
+    void testSingleRead() {_base.testSingleRead(); }
+    void testSingleErase() {_base.testSingleErase(); }
+
+    void testAtomicWrite() {_base.testAtomicWrite(); }
+    void testAtomicWriteErase() {_base.testAtomicWriteErase(); }
+
+    void testRangeRead() {_base.testRangeRead(); }
+    void testCount() {_base.testCount(); }
+    void testRangeErase() {_base.testRangeErase(); }
+
+    void testRollback() {_base.testRollback(); }
+
+    void testThroughput() {_base.testThroughput(); }
+};
+
+const String SQLiteWALStorageTest::dbfile("test_wal.db");
@@ -35,6 +35,7 @@
 
 #include <cxxtest/TestSuite.h>
 #include <sirikata/oh/Storage.hpp>
+#include <boost/lexical_cast.hpp>
 
 class StorageTestBase
 {
@@ -67,6 +68,9 @@ protected:
     // CV notifies the main thread as each callback finishes.
     boost::mutex _mutex;
     boost::condition_variable _cond;
+    // Number of requests still outstanding, for tests which submit many at
+    // once.
+    int32 _outstanding;
 
 public:
     StorageTestBase(String plugin, String type, String args)
@@ -80,7 +84,8 @@ public:
        _ohSSTConnMgr(NULL),
        _mainStrand(NULL),
        _work(NULL),
-       _ctx(NULL)
+       _ctx(NULL),
+       _outstanding(0)
     {}
 
     void setUp() {
@@ -192,6 +197,90 @@ public:
         _cond.wait(lock);
     }
 
+    void checkOutstanding(Result expected_result, Result result, ReadSet* rs) {
+        boost::unique_lock<boost::mutex> lock(_mutex);
+        TS_ASSERT_EQUALS(expected_result, result);
+        delete rs;
+        if (--_outstanding == 0)
+            _cond.notify_one();
+    }
+
+    void waitForOutstanding(boost::unique_lock<boost::mutex>& lock) {
+        while(_outstanding > 0)
+            _cond.wait(lock);
+    }
+
+    void checkOutstandingValues(Result expected_result, ReadSet expected, Result result, ReadSet* rs) {
+        boost::unique_lock<boost::mutex> lock(_mutex);
+        checkReadValuesImpl(expected_result, expected, result, rs);
+        delete rs;
+        if (--_outstanding == 0)
+            _cond.notify_one();
+    }
+
+    // Stops the storage and starts it again, e.g. to check what it recovers.
+    void restart() {
+        tearDown();
+        setUp();
+    }
+
+    // Arguments used the next time the storage is created
+    void setArgs(const String& args) {
+        _args = args;
+    }
+
+    // Single operations which wait for their result, for tests that are more
+    // interested in the resulting state than in each operation.
+    void writeAndWait(int32 bucket, const String& key, const String& value) {
+        using std::tr1::placeholders::_1;
+        using std::tr1::placeholders::_2;
+
+        boost::unique_lock<boost::mutex> lock(_mutex);
+        ++_outstanding;
+        _storage->write(_buckets[bucket], key, value,
+            std::tr1::bind(&StorageTestBase::checkOutstandingValues, this, OH::Storage::SUCCESS, ReadSet(), _1, _2)
+        );
+        waitForOutstanding(lock);
+    }
+
+    void eraseAndWait(int32 bucket, const String& key) {
+        using std::tr1::placeholders::_1;
+        using std::tr1::placeholders::_2;
+
+        boost::unique_lock<boost::mutex> lock(_mutex);
+        ++_outstanding;
+        _storage->erase(_buckets[bucket], key,
+            std::tr1::bind(&StorageTestBase::checkOutstandingValues, this, OH::Storage::SUCCESS, ReadSet(), _1, _2)
+        );
+        waitForOutstanding(lock);
+    }
+
+    void checkValue(int32 bucket, const String& key, const String& value) {
+        using std::tr1::placeholders::_1;
+        using std::tr1::placeholders::_2;
+
+        ReadSet rs;
+        rs[key] = value;
+        boost::unique_lock<boost::mutex> lock(_mutex);
+        ++_outstanding;
+        _storage->read(_buckets[bucket], key,
+            std::tr1::bind(&StorageTestBase::checkOutstandingValues, this, OH::Storage::SUCCESS, rs, _1, _2)
+        );
+        waitForOutstanding(lock);
+    }
+
+    void checkMissing(int32 bucket, const String& key) {
+        using std::tr1::placeholders::_1;
+        using std::tr1::placeholders::_2;
+
+        boost::unique_lock<boost::mutex> lock(_mutex);
+        ++_outstanding;
+        _storage->read(_buckets[bucket], key,
+            std::tr1::bind(&StorageTestBase::checkOutstandingValues, this, OH::Storage::TRANSACTION_ERROR, ReadSet(), _1, _2)
+        );
+        waitForOutstanding(lock);
+    }
+
     void testSetupTeardown() {
         TS_ASSERT(_storage);
     }
@@ -627,6 +716,66 @@ public:
         verifyRollbackData("baz", "baz");
     }
 
+    void testPersistence() {
+        writeAndWait(0, "persist:a", "abcde");
+        writeAndWait(0, "persist:b", "fghij");
+        writeAndWait(1, "persist:a", "klmno");
+        eraseAndWait(0, "persist:b");
+        writeAndWait(0, "persist:a", "pqrst");
+
+        restart();
+
+        checkValue(0, "persist:a", "pqrst");
+        checkMissing(0, "persist:b");
+        checkValue(1, "persist:a", "klmno");
+
+        eraseAndWait(0, "persist:a");
+        eraseAndWait(1, "persist:a");
+    }
+
+    // Submits a batch of independent single-key requests all at once, as lots
+    // of objects persisting their state would, and reports how many the
+    // storage completes per second. Implementations which can combine
+    // transactions will do much better than ones committing each separately.
+    void testThroughput(int32 num_ops = 2000) {
+        using std::tr1::placeholders::_1;
+        using std::tr1::placeholders::_2;
+
+        boost::unique_lock<boost::mutex> lock(_mutex);
+
+        Time write_start = Timer::now();
+        for(int32 i = 0; i < num_ops; i++) {
+            _storage->write(_buckets[i % 2], "throughput-" + boost::lexical_cast<String>(i), "abcdefghijklmnopqrstuvwxyz",
+                std::tr1::bind(&StorageTestBase::checkOutstanding, this, OH::Storage::SUCCESS, _1, _2)
+            );
+            ++_outstanding;
+        }
+        waitForOutstanding(lock);
+        Duration write_time = Timer::now() - write_start;
+
+        Time read_start = Timer::now();
+        for(int32 i = 0; i < num_ops; i++) {
+            _storage->read(_buckets[i % 2], "throughput-" + boost::lexical_cast<String>(i),
+                std::tr1::bind(&StorageTestBase::checkOutstanding, this, OH::Storage::SUCCESS, _1, _2)
+            );
+            ++_outstanding;
+        }
+        waitForOutstanding(lock);
+        Duration read_time = Timer::now() - read_start;
+
+        std::cout << std::endl << _type << " " << _args << ": "
+                  << num_ops / write_time.seconds() << " writes/s, "
+                  << num_ops / read_time.seconds() << " reads/s" << std::endl;
+
+        for(int i = 0; i < 2; i++) {
+            _storage->rangeErase(_buckets[i], "throughput-", "throughput-~",
+                std::tr1::bind(&StorageTestBase::checkOutstanding, this, OH::Storage::SUCCESS, _1, _2)
+            );
+            ++_outstanding;
+        }
+        waitForOutstanding(lock);
+    }
+
 };
 
 const OH::Storage::Bucket StorageTestBase::_buckets[2] = {
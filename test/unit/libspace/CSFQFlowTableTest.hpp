@@ -0,0 +1,268 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include "../../../space/src/CSFQFlowTable.hpp"
+
+using namespace Sirikata;
+
+class CSFQFlowTableTest : public CxxTest::TestSuite
+{
+    typedef CSFQFlowTable::Flow Flow;
+    typedef std::pair<UUID, UUID> FlowKey;
+
+    struct FlowKeyHash {
+        size_t operator()(const FlowKey& k) const {
+            return (size_t)CSFQFlowTable::pairHash(k.first, k.second);
+        }
+    };
+
+    // What we expect each flow to hold. The weight is written through the
+    // pointer insert returns, so it also tells us flows keep their data when
+    // the table moves them.
+    struct Expected {
+        Time lastActive;
+        double weight;
+    };
+    typedef std::tr1::unordered_map<FlowKey, Expected, FlowKeyHash> ReferenceMap;
+
+    Time at(int64 ms) {
+        return Time::null() + Duration::milliseconds(ms);
+    }
+
+    // Inserts (or touches) a flow in both the table and the reference
+    void touch(CSFQFlowTable& table, ReferenceMap& ref, const FlowKey& key, const Time& t) {
+        bool added = false;
+        Flow* flow = table.insert(key.first, key.second, t, &added);
+        ReferenceMap::iterator ref_it = ref.find(key);
+        TS_ASSERT_EQUALS(added, ref_it == ref.end());
+        TS_ASSERT(flow != NULL);
+        if (flow == NULL) return;
+        TS_ASSERT_EQUALS(flow->source, key.first);
+        TS_ASSERT_EQUALS(flow->dest, key.second);
+        if (added) {
+            TS_ASSERT_EQUALS(flow->weight, 0.0);
+            TS_ASSERT_EQUALS(flow->lastActive, t);
+            Expected& expected = ref[key];
+            expected.weight = 0;
+            expected.lastActive = t;
+            ref_it = ref.find(key);
+        }
+        flow->lastActive = t;
+        flow->weight += 1.0;
+        ref_it->second.lastActive = t;
+        ref_it->second.weight += 1.0;
+    }
+
+    void checkSame(CSFQFlowTable& table, ReferenceMap& ref) {
+        TS_ASSERT_EQUALS(table.size(), ref.size());
+        TS_ASSERT_EQUALS(table.empty(), ref.empty());
+        for(ReferenceMap::iterator it = ref.begin(); it != ref.end(); it++) {
+            Flow* flow = table.find(it->first.first, it->first.second);
+            TS_ASSERT(flow != NULL);
+            if (flow == NULL) continue;
+            TS_ASSERT_EQUALS(flow->lastActive, it->second.lastActive);
+            TS_ASSERT_EQUALS(flow->weight, it->second.weight);
+        }
+
+        // Walking the slots finds exactly the reference's flows
+        uint32 walked = 0;
+        for(uint32 idx = 0; idx < table.capacity(); idx++) {
+            const Flow* flow = table.flowAt(idx);
+            if (flow == NULL) continue;
+            walked++;
+            TS_ASSERT(ref.find(FlowKey(flow->source, flow->dest)) != ref.end());
+        }
+        TS_ASSERT_EQUALS(walked, ref.size());
+        // And the table stays sparse enough to probe quickly
+        TS_ASSERT_LESS_THAN_EQUALS(table.size() * 4, table.capacity() * 3);
+    }
+
+public:
+    void setUp() {
+        srand(5);
+    }
+
+    void testEmpty() {
+        CSFQFlowTable table;
+        TS_ASSERT(table.empty());
+        TS_ASSERT(table.capacity() > 0);
+        TS_ASSERT(table.find(UUID::random(), UUID::random()) == NULL);
+        for(uint32 idx = 0; idx < table.capacity(); idx++)
+            TS_ASSERT(table.flowAt(idx) == NULL);
+
+        CSFQFlowTable::Removed removed;
+        table.removeIdle(at(1000), &removed);
+        TS_ASSERT_EQUALS(removed.count, 0u);
+        TS_ASSERT(table.empty());
+    }
+
+    void testPairIsOrdered() {
+        CSFQFlowTable table;
+        UUID a = UUID::random(), b = UUID::random();
+        bool added = false;
+        table.insert(a, b, at(0), &added);
+        TS_ASSERT(added);
+        TS_ASSERT(table.find(a, b) != NULL);
+        TS_ASSERT(table.find(b, a) == NULL);
+        table.insert(b, a, at(0), &added);
+        TS_ASSERT(added);
+        TS_ASSERT_EQUALS(table.size(), 2u);
+        TS_ASSERT(table.find(a, b) != table.find(b, a));
+
+        table.insert(a, b, at(1), &added);
+        TS_ASSERT(!added);
+        TS_ASSERT_EQUALS(table.size(), 2u);
+    }
+
+    void testInsertAndFindMatchReference() {
+        CSFQFlowTable table;
+        ReferenceMap ref;
+
+        // Few enough sources and destinations that pairs repeat, and sharing
+        // a source or destination doesn't mean sharing a flow
+        std::vector<UUID> ids;
+        for(uint32 i = 0; i < 80; i++)
+            ids.push_back(UUID::random());
+
+        for(uint32 i = 0; i < 20000; i++) {
+            FlowKey key(ids[rand() % ids.size()], ids[rand() % ids.size()]);
+            touch(table, ref, key, at(i));
+            if (i % 1000 == 0)
+                checkSame(table, ref);
+
+            // Misses are misses
+            UUID other = UUID::random();
+            TS_ASSERT(table.find(key.first, other) == NULL);
+            TS_ASSERT(table.find(other, key.second) == NULL);
+        }
+        checkSame(table, ref);
+        TS_ASSERT(ref.size() > 3000);
+
+        table.clear();
+        TS_ASSERT(table.empty());
+        TS_ASSERT(table.find(ref.begin()->first.first, ref.begin()->first.second) == NULL);
+    }
+
+    void testRehashMovesFlows() {
+        CSFQFlowTable table;
+        ReferenceMap ref;
+        UUID source = UUID::random();
+
+        FlowKey first(source, UUID::random());
+        touch(table, ref, first, at(0));
+        const Flow* before = table.find(first.first, first.second);
+        uint32 capacity = table.capacity();
+
+        // Grow the table until it has to rehash
+        while(table.capacity() == capacity)
+            touch(table, ref, FlowKey(source, UUID::random()), at(1));
+        checkSame(table, ref);
+
+        // The flow is still there with its data, but in new storage, so the
+        // pointer we had before is no good anymore
+        const Flow* after = table.find(first.first, first.second);
+        TS_ASSERT(after != NULL);
+        TS_ASSERT(after != before);
+        bool in_table = false;
+        for(uint32 idx = 0; idx < table.capacity(); idx++)
+            in_table = in_table || (table.flowAt(idx) == after);
+        TS_ASSERT(in_table);
+
+        // Re-inserting hands back the moved flow rather than a new one
+        bool added = true;
+        TS_ASSERT_EQUALS(table.insert(first.first, first.second, at(2), &added), after);
+        TS_ASSERT(!added);
+    }
+
+    void testRemoveIdle() {
+        CSFQFlowTable table;
+        ReferenceMap ref;
+
+        std::vector<FlowKey> keys;
+        for(uint32 i = 0; i < 2000; i++) {
+            FlowKey key(UUID::random(), UUID::random());
+            keys.push_back(key);
+            touch(table, ref, key, at(rand() % 1000));
+            Flow* flow = table.find(key.first, key.second);
+            flow->usedWeight[CSFQFlowTable::SENDER] = 2.0;
+            flow->usedWeight[CSFQFlowTable::RECEIVER] = 3.0;
+        }
+        uint32 grown_capacity = table.capacity();
+
+        for(int64 cutoff = 100; cutoff <= 1000; cutoff += 100) {
+            // What should come out
+            uint32 expected_count = 0;
+            double expected_weight = 0;
+            for(ReferenceMap::iterator it = ref.begin(); it != ref.end(); ) {
+                if (it->second.lastActive < at(cutoff)) {
+                    expected_count++;
+                    expected_weight += it->second.weight;
+                    it = ref.erase(it);
+                }
+                else {
+                    it++;
+                }
+            }
+
+            CSFQFlowTable::Removed removed;
+            table.removeIdle(at(cutoff), &removed);
+            TS_ASSERT_EQUALS(removed.count, expected_count);
+            TS_ASSERT_DELTA(removed.weight, expected_weight, 1e-9);
+            TS_ASSERT_DELTA(removed.usedWeight[CSFQFlowTable::SENDER], 2.0 * expected_count, 1e-9);
+            TS_ASSERT_DELTA(removed.usedWeight[CSFQFlowTable::RECEIVER], 3.0 * expected_count, 1e-9);
+            TS_ASSERT_EQUALS(removed.rate, 0.0);
+
+            // Survivors are still reachable after the rebuild, even the ones
+            // whose probe sequences ran through removed slots
+            checkSame(table, ref);
+            for(uint32 i = 0; i < keys.size(); i++) {
+                bool present = ref.find(keys[i]) != ref.end();
+                TS_ASSERT_EQUALS(table.find(keys[i].first, keys[i].second) != NULL, present);
+            }
+        }
+        TS_ASSERT(table.empty());
+        // And the table shrank back down
+        TS_ASSERT(table.capacity() < grown_capacity);
+
+        // It's still usable afterwards
+        touch(table, ref, keys[0], at(2000));
+        checkSame(table, ref);
+    }
+
+    void testApproxExpNegative() {
+        // Within 1e-7 relative error everywhere exp(-x) is a normal double,
+        // including the points where the 2^-n split switches n.
+        double worst = 0;
+        for(double x = 0; x < 700; x += 0.0137) {
+            double expected = exp(-x);
+            double err = fabs(approxExpNegative(x) - expected) / expected;
+            worst = std::max(worst, err);
+        }
+        for(int32 n = 0; n < 1000; n++) {
+            double x = (n + 0.5) * 0.6931471805599453;
+            double expected = exp(-x);
+            worst = std::max(worst, fabs(approxExpNegative(x) - expected) / expected);
+        }
+        TS_ASSERT_LESS_THAN(worst, 1e-7);
+
+        TS_ASSERT_EQUALS(approxExpNegative(0.0), 1.0);
+        // Tiny results flush to zero rather than wrapping the exponent
+        TS_ASSERT_EQUALS(approxExpNegative(1000.0), 0.0);
+        TS_ASSERT_EQUALS(approxExpNegative(1e300), 0.0);
+    }
+
+    void testApproxRateEstimator() {
+        // The approximate decay tracks the exact one
+        RateEstimator exact(0.0, Time::null()), approx(0.0, Time::null());
+        const double K = 0.5;
+        for(int64 us = 0; us < 5000000; us += 1 + rand() % 20000) {
+            Time t = Time::null() + Duration::microseconds(us);
+            uint32 len = rand() % 1500;
+            double e = exact.estimate_rate(t, len, K);
+            double a = approx.estimate_rate_approx(t, len, K);
+            TS_ASSERT_DELTA(a, e, 1e-5 * std::max(1.0, e));
+        }
+    }
+};
@@ -0,0 +1,222 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include "../../../space/src/ForwarderServiceQueue.hpp"
+
+using namespace Sirikata;
+
+class ForwarderServiceQueueTest : public CxxTest::TestSuite,
+                                  public ForwarderServiceQueue::Listener
+{
+    enum {
+        LocalServer = 1,
+        RemoteServer = 2,
+        ControlledPort = 10,
+        UncontrolledPort = 11,
+        ControlledService = 0,
+        UncontrolledService = 1
+    };
+
+    ForwarderServiceQueue* mQueue;
+    uint32 mReadyCount;
+    // Size of every message we send, in bytes
+    uint64 mMessageSize;
+
+    Message* makeMessage(uint16 port) {
+        return new Message(LocalServer, port, RemoteServer, port, String(100, 'x'));
+    }
+
+    // Pushes count messages on the given service and port
+    void push(ForwarderServiceQueue::ServiceID svc, uint16 port, uint32 count) {
+        for(uint32 i = 0; i < count; i++) {
+            Message* msg = makeMessage(port);
+            TS_ASSERT_EQUALS(mQueue->push(svc, msg), QueueEnum::PushSucceeded);
+        }
+    }
+
+    // Pops everything that can currently be sent and returns the count
+    uint32 drain() {
+        uint32 count = 0;
+        while(Message* msg = mQueue->pop(RemoteServer)) {
+            delete msg;
+            count++;
+        }
+        return count;
+    }
+
+    void report(uint64 window, uint64 consumed) {
+        ForwarderServiceQueue::ConsumedList list;
+        list.push_back( std::make_pair((uint16)ControlledPort, consumed) );
+        mQueue->updateCredits(RemoteServer, window, list);
+    }
+
+public:
+    void setUp() {
+        mReadyCount = 0;
+        mQueue = new ForwarderServiceQueue(LocalServer, 1024*1024, this);
+        mQueue->addService(ControlledService);
+        mQueue->addService(UncontrolledService, 0, false);
+
+        Message* msg = makeMessage(ControlledPort);
+        mMessageSize = msg->serializedSize();
+        delete msg;
+    }
+
+    void tearDown() {
+        // Turn off flow control so nothing is left queued
+        mQueue->updateCredits(RemoteServer, 0, ForwarderServiceQueue::ConsumedList());
+        drain();
+        delete mQueue;
+    }
+
+    virtual void forwarderServiceMessageReady(ServerID dest_server) {
+        TS_ASSERT_EQUALS(dest_server, RemoteServer);
+        mReadyCount++;
+    }
+
+    void testNoWindow() {
+        // Until the remote server grants a window nothing stalls
+        push(ControlledService, ControlledPort, 100);
+        TS_ASSERT_EQUALS(drain(), 100u);
+        TS_ASSERT_EQUALS(mQueue->takeCreditStalls(), 0u);
+    }
+
+    void testStallAndUnstall() {
+        // Start with a known base for the port
+        report(5*mMessageSize, 0);
+        push(ControlledService, ControlledPort, 20);
+
+        // Only a window's worth gets out
+        TS_ASSERT_EQUALS(drain(), 5u);
+        TS_ASSERT_EQUALS(mQueue->takeCreditStalls(), 1u);
+
+        // Crediting some of it lets exactly that much more out
+        mReadyCount = 0;
+        report(5*mMessageSize, 2*mMessageSize);
+        TS_ASSERT_EQUALS(mReadyCount, 1u);
+        TS_ASSERT_EQUALS(drain(), 2u);
+        TS_ASSERT_EQUALS(mQueue->takeCreditStalls(), 1u);
+
+        // Repeated totals don't credit anything
+        mReadyCount = 0;
+        report(5*mMessageSize, 2*mMessageSize);
+        TS_ASSERT_EQUALS(mReadyCount, 0u);
+        TS_ASSERT_EQUALS(drain(), 0u);
+
+        // Crediting everything sent lets another full window out
+        report(5*mMessageSize, 7*mMessageSize);
+        TS_ASSERT_EQUALS(drain(), 5u);
+
+        // And turning flow control off releases the rest
+        report(0, 7*mMessageSize);
+        TS_ASSERT_EQUALS(drain(), 8u);
+    }
+
+    void testUncontrolledService() {
+        report(5*mMessageSize, 0);
+        push(UncontrolledService, UncontrolledPort, 20);
+        TS_ASSERT_EQUALS(drain(), 20u);
+        TS_ASSERT_EQUALS(mQueue->takeCreditStalls(), 0u);
+    }
+
+    void testShedWhileStalled() {
+        report(5*mMessageSize, 0);
+        push(ControlledService, ControlledPort, 5);
+        TS_ASSERT_EQUALS(drain(), 5u);
+
+        // Fill up the service's queue behind the stall
+        uint32 pushed = 0;
+        while(true) {
+            Message* msg = makeMessage(ControlledPort);
+            if (mQueue->push(ControlledService, msg) != QueueEnum::PushSucceeded) {
+                delete msg;
+                break;
+            }
+            pushed++;
+        }
+        TS_ASSERT(pushed > 0);
+        TS_ASSERT_EQUALS(mQueue->takeCreditSheds(), 1u);
+    }
+
+    void testFirstReportResyncs() {
+        // We charge a port before ever hearing about it, e.g. because we
+        // restarted, and the first report carries the remote server's total
+        // from before that.
+        mQueue->updateCredits(RemoteServer, 5*mMessageSize, ForwarderServiceQueue::ConsumedList());
+        push(ControlledService, ControlledPort, 20);
+        TS_ASSERT_EQUALS(drain(), 5u);
+
+        // It resyncs instead of crediting the whole total
+        report(5*mMessageSize, 1000*mMessageSize);
+        TS_ASSERT_EQUALS(drain(), 5u);
+        // And later reports count from it
+        report(5*mMessageSize, 1001*mMessageSize);
+        TS_ASSERT_EQUALS(drain(), 1u);
+    }
+
+    void testRegressedTotalsResync() {
+        report(5*mMessageSize, 0);
+        push(ControlledService, ControlledPort, 30);
+        TS_ASSERT_EQUALS(drain(), 5u);
+        report(5*mMessageSize, 3*mMessageSize);
+        TS_ASSERT_EQUALS(drain(), 3u);
+
+        // The remote server restarted and lost track of what it had consumed,
+        // so everything outstanding is cleared
+        mReadyCount = 0;
+        report(5*mMessageSize, mMessageSize);
+        TS_ASSERT_EQUALS(mReadyCount, 1u);
+        TS_ASSERT_EQUALS(drain(), 5u);
+
+        // New totals count from the regressed one
+        report(5*mMessageSize, 3*mMessageSize);
+        TS_ASSERT_EQUALS(drain(), 2u);
+    }
+
+    void testResetCredits() {
+        report(5*mMessageSize, 0);
+        push(ControlledService, ControlledPort, 20);
+        TS_ASSERT_EQUALS(drain(), 5u);
+
+        // A lost connection clears what's outstanding
+        mReadyCount = 0;
+        mQueue->resetCredits(RemoteServer);
+        TS_ASSERT_EQUALS(mReadyCount, 1u);
+        TS_ASSERT_EQUALS(drain(), 5u);
+
+        // And the next report is only used as a new base
+        report(5*mMessageSize, 4*mMessageSize);
+        TS_ASSERT_EQUALS(drain(), 5u);
+        report(5*mMessageSize, 5*mMessageSize);
+        TS_ASSERT_EQUALS(drain(), 1u);
+
+        // Resetting a server we've never sent to is harmless
+        mQueue->resetCredits(RemoteServer + 1);
+    }
+
+    void testIdleStallResyncs() {
+        report(5*mMessageSize, 0);
+        push(ControlledService, ControlledPort, 20);
+        TS_ASSERT_EQUALS(drain(), 5u);
+
+        // Reports without progress eventually give up on what's outstanding
+        for(uint32 i = 0; i < ForwarderServiceQueue::MaxIdleCreditUpdates; i++) {
+            report(5*mMessageSize, 0);
+            TS_ASSERT_EQUALS(drain(), 0u);
+        }
+        report(5*mMessageSize, 0);
+        TS_ASSERT_EQUALS(drain(), 5u);
+
+        // Progress restarts the count
+        for(uint32 i = 0; i < ForwarderServiceQueue::MaxIdleCreditUpdates - 1; i++)
+            report(5*mMessageSize, 0);
+        report(5*mMessageSize, mMessageSize);
+        TS_ASSERT_EQUALS(drain(), 1u);
+        for(uint32 i = 0; i < ForwarderServiceQueue::MaxIdleCreditUpdates - 1; i++) {
+            report(5*mMessageSize, mMessageSize);
+            TS_ASSERT_EQUALS(drain(), 0u);
+        }
+    }
+};
@@ -0,0 +1,311 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include "../../../space/src/MigrationEventQueue.hpp"
+
+using namespace Sirikata;
+
+class MigrationEventQueueTest : public CxxTest::TestSuite
+{
+    typedef MigrationEventQueue::ObjectInfo ObjectInfo;
+    typedef std::map<UUID, ObjectInfo> ReferenceMap;
+
+    // Event times are unique so the order objects come out in is well defined
+    std::set<int64> mUsedTimes;
+
+    Time uniqueTime(int64 range) {
+        int64 us;
+        do {
+            us = (int64)(rand() % range);
+        } while(!mUsedTimes.insert(us).second);
+        return Time::null() + Duration::microseconds(us);
+    }
+
+    ObjectInfo makeInfo(const UUID& id, const Time& next) {
+        ObjectInfo info(id, next + Duration::seconds(1.f), next);
+        info.precopied = (rand() % 2) == 0;
+        return info;
+    }
+
+    // The object with the earliest event in the reference
+    ReferenceMap::iterator earliest(ReferenceMap& ref) {
+        ReferenceMap::iterator best = ref.begin();
+        for(ReferenceMap::iterator it = ref.begin(); it != ref.end(); it++)
+            if (it->second.nextEvent < best->second.nextEvent)
+                best = it;
+        return best;
+    }
+
+    void checkSame(MigrationEventQueue& queue, ReferenceMap& ref) {
+        TS_ASSERT_EQUALS(queue.size(), ref.size());
+        TS_ASSERT_EQUALS(queue.empty(), ref.empty());
+        if (!ref.empty())
+            TS_ASSERT_EQUALS(queue.nextEventTime(), earliest(ref)->second.nextEvent);
+
+        std::vector<UUID> ids;
+        queue.objects(&ids);
+        TS_ASSERT_EQUALS(ids.size(), ref.size());
+        for(uint32 i = 0; i < ids.size(); i++)
+            TS_ASSERT(ref.find(ids[i]) != ref.end());
+
+        for(ReferenceMap::iterator it = ref.begin(); it != ref.end(); it++) {
+            TS_ASSERT(queue.contains(it->first));
+            const ObjectInfo* info = queue.find(it->first);
+            TS_ASSERT(info != NULL);
+            if (info == NULL) continue;
+            TS_ASSERT_EQUALS(info->objid, it->second.objid);
+            TS_ASSERT_EQUALS(info->crossing, it->second.crossing);
+            TS_ASSERT_EQUALS(info->nextEvent, it->second.nextEvent);
+            TS_ASSERT_EQUALS(info->precopied, it->second.precopied);
+        }
+    }
+
+    // Pops everything due before t from both and checks they match
+    void popDue(MigrationEventQueue& queue, ReferenceMap& ref, const Time& t) {
+        ObjectInfo popped(UUID::null(), Time::null(), Time::null());
+        while(!ref.empty() && earliest(ref)->second.nextEvent < t) {
+            ReferenceMap::iterator expected = earliest(ref);
+            TS_ASSERT(queue.popDue(t, &popped));
+            TS_ASSERT_EQUALS(popped.objid, expected->first);
+            TS_ASSERT_EQUALS(popped.nextEvent, expected->second.nextEvent);
+            ref.erase(expected);
+        }
+        TS_ASSERT(!queue.popDue(t, &popped));
+    }
+
+public:
+    void setUp() {
+        srand(7);
+        mUsedTimes.clear();
+    }
+
+    void testEmpty() {
+        MigrationEventQueue queue;
+        TS_ASSERT(queue.empty());
+        ObjectInfo popped(UUID::null(), Time::null(), Time::null());
+        TS_ASSERT(!queue.popDue(Time::null() + Duration::seconds(1000.f), &popped));
+        TS_ASSERT(queue.find(UUID::random()) == NULL);
+        // Erasing something that isn't there is harmless
+        queue.erase(UUID::random());
+        TS_ASSERT(queue.empty());
+    }
+
+    void testPopsInOrder() {
+        MigrationEventQueue queue;
+        ReferenceMap ref;
+        for(uint32 i = 0; i < 500; i++) {
+            ObjectInfo info = makeInfo(UUID::random(), uniqueTime(1000000));
+            queue.insert(info);
+            ref.insert(std::make_pair(info.objid, info));
+        }
+        checkSame(queue, ref);
+
+        // Nothing is due before the earliest event, and it's due just after
+        Time first = queue.nextEventTime();
+        ObjectInfo popped(UUID::null(), Time::null(), Time::null());
+        TS_ASSERT(!queue.popDue(first, &popped));
+        popDue(queue, ref, first + Duration::microseconds(1));
+
+        for(int64 t = 100000; t <= 1000000; t += 100000)
+            popDue(queue, ref, Time::null() + Duration::microseconds(t));
+        TS_ASSERT(queue.empty());
+    }
+
+    void testUpdates() {
+        // Updates in both directions, including many deferred ones which
+        // push an object later without moving it in the heap.
+        MigrationEventQueue queue;
+        ReferenceMap ref;
+        std::vector<UUID> ids;
+        for(uint32 i = 0; i < 300; i++) {
+            ObjectInfo info = makeInfo(UUID::random(), uniqueTime(1000000));
+            ids.push_back(info.objid);
+            queue.insert(info);
+            ref.insert(std::make_pair(info.objid, info));
+        }
+
+        for(uint32 round = 0; round < 20; round++) {
+            for(uint32 i = 0; i < 200; i++) {
+                const UUID& id = ids[rand() % ids.size()];
+                ReferenceMap::iterator ref_it = ref.find(id);
+                if (ref_it == ref.end()) continue;
+
+                Time next;
+                if (rand() % 4 == 0) {
+                    // Earlier, which has to move the object up right away
+                    next = uniqueTime(1000000);
+                }
+                else {
+                    // Later, which is applied lazily
+                    next = uniqueTime(4000000);
+                    if (next < ref_it->second.nextEvent) continue;
+                }
+                ObjectInfo info = makeInfo(id, next);
+                queue.update(info);
+                ref_it->second = info;
+            }
+            checkSame(queue, ref);
+
+            // Keep the heap churning
+            popDue(queue, ref, queue.nextEventTime() + Duration::microseconds(20000));
+            checkSame(queue, ref);
+        }
+
+        popDue(queue, ref, Time::null() + Duration::seconds(1000.f));
+        TS_ASSERT(queue.empty());
+    }
+
+    void testPrecopyAfterStaticObjectStartsMoving() {
+        const Duration window = Duration::seconds(5.f);
+        const Duration lifetime = Duration::seconds(20.f);
+        const ServerID dest = 2;
+        MigrationEventQueue queue;
+        Time now = Time::null();
+
+        // A static object is treated as leaving far in the future, so it's
+        // woken up at the start of that crossing's pre-copy window
+        ObjectInfo info(UUID::random(), Time::null(), Time::null());
+        info.setCrossing(now + Duration::seconds(100.f), now, window);
+        TS_ASSERT_EQUALS(info.nextEvent, now + Duration::seconds(95.f));
+        queue.insert(info);
+
+        // There's nowhere to pre-copy it to since it isn't moving
+        now = now + Duration::seconds(96.f);
+        TS_ASSERT(queue.popDue(now, &info));
+        TS_ASSERT(info.precopyDue(now, window));
+        info.setPrecopy(NullServerID, now + lifetime);
+        TS_ASSERT(!info.precopied);
+        // Its next far off crossing is out of the window, so it gets looked at
+        // again before that one
+        info.setCrossing(now + Duration::seconds(100.f), now, window);
+        TS_ASSERT(!info.precopyChecked);
+        TS_ASSERT_EQUALS(info.nextEvent, now + Duration::seconds(95.f));
+        queue.insert(info);
+
+        // It starts moving and will leave in 3 seconds, which is due right away
+        now = now + Duration::seconds(10.f);
+        info.setCrossing(now + Duration::seconds(3.f), now, window);
+        queue.update(info);
+        TS_ASSERT(queue.popDue(now + Duration::microseconds(1), &info));
+        TS_ASSERT(info.precopyDue(now, window));
+        info.setPrecopy(dest, now + lifetime);
+        TS_ASSERT(info.precopied);
+        TS_ASSERT_EQUALS(info.precopyDest, dest);
+        TS_ASSERT_EQUALS(info.precopyCrossing, now + Duration::seconds(3.f));
+
+        // And isn't looked at again until it actually leaves
+        info.setCrossing(now + Duration::seconds(3.f), now, window);
+        TS_ASSERT(!info.precopyDue(now, window));
+        TS_ASSERT_EQUALS(info.nextEvent, now + Duration::seconds(3.f));
+    }
+
+    void testPrecopyForgotten() {
+        const Duration window = Duration::seconds(5.f);
+        const Duration lifetime = Duration::seconds(20.f);
+        Time now = Time::null() + Duration::seconds(1000.f);
+
+        ObjectInfo info(UUID::random(), Time::null(), Time::null());
+        info.setCrossing(now + Duration::seconds(2.f), now, window);
+        info.setPrecopy(2, now + lifetime);
+
+        // Heading somewhere else drops it, so it's due again
+        ObjectInfo moved(info);
+        moved.checkPrecopyDest(3);
+        moved.setCrossing(now + Duration::seconds(2.f), now, window);
+        TS_ASSERT(!moved.precopied);
+        TS_ASSERT(moved.precopyDue(now, window));
+        // Still heading to the same place keeps it
+        ObjectInfo same(info);
+        same.checkPrecopyDest(2);
+        same.setCrossing(now + Duration::seconds(2.f), now, window);
+        TS_ASSERT(same.precopied);
+
+        // So does slowing down within the window, but slowing down past it
+        // doesn't
+        ObjectInfo slower(info);
+        slower.setCrossing(now + Duration::seconds(4.f), now, window);
+        TS_ASSERT(slower.precopied);
+        slower.setCrossing(now + Duration::seconds(30.f), now, window);
+        TS_ASSERT(!slower.precopied);
+        TS_ASSERT_EQUALS(slower.nextEvent, now + Duration::seconds(25.f));
+
+        // A crossing that keeps getting pushed back is woken up when the
+        // sender stops relying on the pre-copy, and then it's dropped
+        ObjectInfo lingering(info);
+        Time later = now;
+        for(int i = 0; i < 4; i++) {
+            later = later + Duration::seconds(4.f);
+            lingering.setCrossing(later + Duration::seconds(4.5f), later, window);
+        }
+        TS_ASSERT(lingering.precopied);
+        TS_ASSERT_EQUALS(lingering.nextEvent, now + lifetime);
+        later = now + lifetime;
+        lingering.setCrossing(later + Duration::seconds(2.f), later, window);
+        TS_ASSERT(!lingering.precopied);
+        TS_ASSERT(lingering.precopyDue(later, window));
+
+        // Without a pre-copy window the crossing is all that matters
+        ObjectInfo disabled(UUID::random(), Time::null(), Time::null());
+        disabled.setCrossing(now + Duration::seconds(2.f), now, Duration::zero());
+        TS_ASSERT_EQUALS(disabled.nextEvent, now + Duration::seconds(2.f));
+        TS_ASSERT(!disabled.precopyDue(now, Duration::zero()));
+    }
+
+    void testNoPrecopyDestinationInWindow() {
+        // An object leaving soon with nowhere to pre-copy it to is only
+        // looked at once for it, rather than every time it's woken
+        const Duration window = Duration::seconds(5.f);
+        Time now = Time::null() + Duration::seconds(10.f);
+        ObjectInfo info(UUID::random(), Time::null(), Time::null());
+        info.setCrossing(now + Duration::seconds(2.f), now, window);
+        TS_ASSERT(info.precopyDue(now, window));
+        info.setPrecopy(NullServerID, now + Duration::seconds(20.f));
+        info.setCrossing(now + Duration::seconds(2.f), now, window);
+        TS_ASSERT(!info.precopyDue(now, window));
+        TS_ASSERT_EQUALS(info.nextEvent, now + Duration::seconds(2.f));
+
+        // Until it turns out it is going somewhere else
+        info.checkPrecopyDest(4);
+        info.setCrossing(now + Duration::seconds(2.f), now, window);
+        TS_ASSERT(info.precopyDue(now, window));
+    }
+
+    void testMixedOperations() {
+        MigrationEventQueue queue;
+        ReferenceMap ref;
+        std::vector<UUID> ids;
+        int64 now = 0;
+        for(uint32 i = 0; i < 5000; i++) {
+            int op = rand() % 10;
+            if (op < 4 || ref.empty()) {
+                ObjectInfo info = makeInfo(UUID::random(), uniqueTime(now + 1000000));
+                ids.push_back(info.objid);
+                queue.insert(info);
+                ref.insert(std::make_pair(info.objid, info));
+            }
+            else if (op < 7) {
+                const UUID& id = ids[rand() % ids.size()];
+                ReferenceMap::iterator ref_it = ref.find(id);
+                if (ref_it == ref.end()) continue;
+                ObjectInfo info = makeInfo(id, uniqueTime(now + 2000000));
+                queue.update(info);
+                ref_it->second = info;
+            }
+            else if (op < 8) {
+                const UUID& id = ids[rand() % ids.size()];
+                queue.erase(id);
+                ref.erase(id);
+            }
+            else {
+                now += 10000;
+                popDue(queue, ref, Time::null() + Duration::microseconds(now));
+            }
+
+            if (i % 500 == 0)
+                checkSame(queue, ref);
+        }
+        checkSame(queue, ref);
+    }
+};
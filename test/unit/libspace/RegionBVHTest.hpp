@@ -0,0 +1,174 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include "../../../space/src/RegionBVH.hpp"
+
+using namespace Sirikata;
+
+class RegionBVHTest : public CxxTest::TestSuite
+{
+    static float32 randFloat(float32 lo, float32 hi) {
+        return lo + (hi - lo) * (rand() / (float32)RAND_MAX);
+    }
+
+    // A 6x6x6 grid of 10 unit boxes with some left out, so the region has
+    // holes and boxes share faces with their neighbors.
+    BoundingBoxList makeBoxes() {
+        BoundingBoxList boxes;
+        for(int x = 0; x < 6; x++) {
+            for(int y = 0; y < 6; y++) {
+                for(int z = 0; z < 6; z++) {
+                    if (rand() % 4 == 0) continue;
+                    Vector3f mn(x * 10.f, y * 10.f, z * 10.f);
+                    boxes.push_back(BoundingBox3f(mn, mn + Vector3f(10.f, 10.f, 10.f)));
+                }
+            }
+        }
+        return boxes;
+    }
+
+    static bool bruteContains(const BoundingBoxList& boxes, const Vector3f& pos) {
+        for(uint32 i = 0; i < boxes.size(); i++)
+            if (boxes[i].contains(pos, 0.0f))
+                return true;
+        return false;
+    }
+
+    // Times the path pos + vel*t is in box, which are empty if t_out < t_in
+    static void pathInBox(const BoundingBox3f& box, const Vector3f& pos, const Vector3f& vel, float32* t_in, float32* t_out) {
+        *t_in = -1e30f;
+        *t_out = 1e30f;
+        for(int i = 0; i < 3; i++) {
+            if (vel[i] == 0.f) {
+                if (pos[i] < box.min()[i] || pos[i] > box.max()[i])
+                    *t_out = -1e30f;
+                continue;
+            }
+            float32 t1 = (box.min()[i] - pos[i]) / vel[i];
+            float32 t2 = (box.max()[i] - pos[i]) / vel[i];
+            *t_in = std::max(*t_in, std::min(t1, t2));
+            *t_out = std::min(*t_out, std::max(t1, t2));
+        }
+    }
+
+    // Reference time to leave the region: keep extending the time we're in
+    // the region by any box the path is in at that time, allowing for
+    // rounding where adjacent boxes meet.
+    static float32 bruteTimeToExit(const BoundingBoxList& boxes, const Vector3f& pos, const Vector3f& vel, float32 max_time) {
+        if (!bruteContains(boxes, pos))
+            return 0.f;
+        float32 slop = .001f / vel.length();
+        float32 t = 0.f;
+        bool extended = true;
+        while(extended && t < max_time) {
+            extended = false;
+            for(uint32 i = 0; i < boxes.size(); i++) {
+                float32 t_in, t_out;
+                pathInBox(boxes[i], pos, vel, &t_in, &t_out);
+                if (t_in <= t + slop && t_out > t) {
+                    t = t_out;
+                    extended = true;
+                }
+            }
+        }
+        return std::min(t, max_time);
+    }
+
+public:
+    void setUp() {
+        srand(11);
+    }
+
+    void testEmpty() {
+        RegionBVH bvh;
+        TS_ASSERT(!bvh.unbounded());
+        TS_ASSERT_EQUALS(bvh.find(Vector3f(0, 0, 0)), -1);
+        TS_ASSERT(!bvh.contains(Vector3f(0, 0, 0)));
+        TS_ASSERT_EQUALS(bvh.timeToExit(Vector3f(0, 0, 0), Vector3f(1, 0, 0), 100.f, 8), 0.f);
+    }
+
+    void testUnbounded() {
+        BoundingBoxList boxes;
+        boxes.push_back(BoundingBox3f(Vector3f(0, 0, 0), Vector3f(1, 1, 1)));
+        boxes.push_back(BoundingBox3f(Vector3f(5, 5, 5), Vector3f(5, 5, 5)));
+        RegionBVH bvh(boxes);
+        TS_ASSERT(bvh.unbounded());
+        TS_ASSERT_EQUALS(bvh.find(Vector3f(.5f, .5f, .5f)), -1);
+        TS_ASSERT(bvh.contains(Vector3f(1000, 1000, 1000)));
+        TS_ASSERT_EQUALS(bvh.timeToExit(Vector3f(0, 0, 0), Vector3f(1, 0, 0), 100.f, 8), 100.f);
+
+        // Resetting to a bounded region clears it
+        boxes.pop_back();
+        bvh.reset(boxes);
+        TS_ASSERT(!bvh.unbounded());
+        TS_ASSERT(!bvh.contains(Vector3f(1000, 1000, 1000)));
+    }
+
+    void testFindMatchesBruteForce() {
+        BoundingBoxList boxes = makeBoxes();
+        RegionBVH bvh(boxes);
+
+        uint32 found = 0;
+        for(uint32 i = 0; i < 20000; i++) {
+            Vector3f pos(randFloat(-5.f, 65.f), randFloat(-5.f, 65.f), randFloat(-5.f, 65.f));
+            int32 idx = bvh.find(pos);
+            TS_ASSERT_EQUALS(idx >= 0, bruteContains(boxes, pos));
+            TS_ASSERT_EQUALS(bvh.contains(pos), bruteContains(boxes, pos));
+            if (idx >= 0) {
+                TS_ASSERT(bvh.box(idx).contains(pos, 0.0f));
+                found++;
+            }
+        }
+        // Make sure we actually tested both cases
+        TS_ASSERT(found > 1000);
+        TS_ASSERT(found < 19000);
+    }
+
+    void testTimeToExit() {
+        BoundingBoxList boxes = makeBoxes();
+        RegionBVH bvh(boxes);
+        const float32 max_time = 100.f;
+
+        uint32 inside = 0;
+        for(uint32 i = 0; i < 2000; i++) {
+            Vector3f pos(randFloat(0.f, 60.f), randFloat(0.f, 60.f), randFloat(0.f, 60.f));
+            Vector3f vel(randFloat(-1.f, 1.f), randFloat(-1.f, 1.f), randFloat(-1.f, 1.f));
+            vel = vel.normal() * randFloat(.5f, 2.f);
+
+            // Following every box it crosses gives the actual exit
+            float32 expected = bruteTimeToExit(boxes, pos, vel, max_time);
+            float32 t = bvh.timeToExit(pos, vel, max_time, 1000);
+            TS_ASSERT_DELTA(t, expected, .01f);
+
+            // Following fewer boxes can only wake us up early
+            float32 t_first = bvh.timeToExit(pos, vel, max_time, 1);
+            TS_ASSERT_LESS_THAN_EQUALS(t_first, t);
+            int32 start = bvh.find(pos);
+            if (start >= 0) {
+                // And with one, it's when we leave the starting box
+                float32 t_in, t_out;
+                pathInBox(bvh.box(start), pos, vel, &t_in, &t_out);
+                TS_ASSERT_DELTA(t_first, t_out, .001f);
+                inside++;
+            }
+        }
+        TS_ASSERT(inside > 500);
+    }
+
+    void testTimeToExitSlowAndStatic() {
+        BoundingBoxList boxes;
+        boxes.push_back(BoundingBox3f(Vector3f(0, 0, 0), Vector3f(10, 10, 10)));
+        boxes.push_back(BoundingBox3f(Vector3f(10, 0, 0), Vector3f(20, 10, 10)));
+        RegionBVH bvh(boxes);
+
+        // Crossing into the adjacent box
+        TS_ASSERT_DELTA(bvh.timeToExit(Vector3f(5, 5, 5), Vector3f(1, 0, 0), 100.f, 8), 15.f, .01f);
+        // Limited by max_time
+        TS_ASSERT_EQUALS(bvh.timeToExit(Vector3f(5, 5, 5), Vector3f(.01f, 0, 0), 100.f, 8), 100.f);
+        TS_ASSERT_EQUALS(bvh.timeToExit(Vector3f(5, 5, 5), Vector3f(0, 0, 0), 100.f, 8), 100.f);
+        // Outside the region
+        TS_ASSERT_EQUALS(bvh.timeToExit(Vector3f(25, 5, 5), Vector3f(-1, 0, 0), 100.f, 8), 0.f);
+    }
+};
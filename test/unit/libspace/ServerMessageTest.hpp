@@ -0,0 +1,324 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/space/ServerMessage.hpp>
+
+using namespace Sirikata;
+
+class ServerMessageTest : public CxxTest::TestSuite
+{
+    enum {
+        SourceServer = 3,
+        SourcePort = 13,
+        DestServer = 5,
+        DestPort = 17,
+        // Field numbers and wire types, for building messages by hand
+        PayloadField = 7,
+        UnknownField = 20,
+        WireVarint = 0,
+        Wire64Bit = 1,
+        WireLengthDelimited = 2,
+        Wire32Bit = 5
+    };
+
+    static void appendVarint(std::string* out, uint64 val) {
+        while(val >= 0x80) {
+            out->push_back((char)((val & 0x7F) | 0x80));
+            val >>= 7;
+        }
+        out->push_back((char)val);
+    }
+
+    static void appendTag(std::string* out, uint32 field, uint32 wire_type) {
+        appendVarint(out, (field << 3) | wire_type);
+    }
+
+    static void appendBytesField(std::string* out, uint32 field, const std::string& data) {
+        appendTag(out, field, WireLengthDelimited);
+        appendVarint(out, data.size());
+        out->append(data);
+    }
+
+    static std::string toString(const Network::Chunk& chunk) {
+        return chunk.empty() ? std::string() : std::string((const char*)&chunk[0], chunk.size());
+    }
+
+    static std::string randomPayload(uint32 size) {
+        std::string payload(size, '\0');
+        for(uint32 i = 0; i < size; i++)
+            payload[i] = (char)(rand() % 256);
+        return payload;
+    }
+
+    // The header of a message with no payload, i.e. just the routing fields
+    static std::string headerOnly(const Message& msg) {
+        Message copy(msg.source_server(), msg.source_port(), msg.dest_server(), msg.dest_port());
+        TS_ASSERT(copy.ParseFromString(wireBytes(msg)));
+        copy.set_payload(std::string());
+        std::string header;
+        TS_ASSERT(copy.serializeHeader(&header));
+        return header;
+    }
+
+    static std::string wireBytes(const Message& msg) {
+        Network::Chunk chunk;
+        TS_ASSERT(msg.serialize(&chunk));
+        return toString(chunk);
+    }
+
+    // Parses data into a fresh message, returning NULL if it fails
+    static Message* parse(const std::string& data) {
+        Message* msg = new Message(0, 0, 0, 0);
+        if (!msg->ParseFromString(data)) {
+            delete msg;
+            return NULL;
+        }
+        return msg;
+    }
+
+    void checkSameHeader(const Message& a, const Message& b) {
+        TS_ASSERT_EQUALS(a.source_server(), b.source_server());
+        TS_ASSERT_EQUALS(a.source_port(), b.source_port());
+        TS_ASSERT_EQUALS(a.dest_server(), b.dest_server());
+        TS_ASSERT_EQUALS(a.dest_port(), b.dest_port());
+        TS_ASSERT_EQUALS(a.id(), b.id());
+        TS_ASSERT_EQUALS(a.payload_id(), b.payload_id());
+    }
+
+    // Sending the header and payload separately has to put the same bytes on
+    // the wire as serializing the whole message.
+    void checkSplitMatchesWhole(const Message& msg) {
+        std::string header;
+        TS_ASSERT(msg.serializeHeader(&header));
+        std::string whole = wireBytes(msg);
+        TS_ASSERT_EQUALS(whole, header + msg.payload());
+        TS_ASSERT_EQUALS(msg.serializedSize(), whole.size());
+    }
+
+public:
+    void setUp() {
+        srand(13);
+    }
+
+    void testRoundTrip() {
+        // Sizes on either side of where the payload length needs more varint
+        // bytes
+        uint32 sizes[] = { 1, 2, 127, 128, 129, 300, 16383, 16384, 70000 };
+        for(uint32 i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+            Message msg(SourceServer, SourcePort, DestServer, DestPort, randomPayload(sizes[i]));
+            checkSplitMatchesWhole(msg);
+
+            Network::Chunk chunk;
+            TS_ASSERT(msg.serialize(&chunk));
+            Message* parsed = Message::deserialize(chunk);
+            TS_ASSERT(parsed != NULL);
+            if (parsed == NULL) continue;
+            checkSameHeader(*parsed, msg);
+            TS_ASSERT_EQUALS(parsed->payload(), msg.payload());
+            TS_ASSERT_EQUALS(parsed->serializedSize(), chunk.size());
+            // And it comes back out exactly the same
+            checkSplitMatchesWhole(*parsed);
+            TS_ASSERT_EQUALS(wireBytes(*parsed), toString(chunk));
+            delete parsed;
+        }
+    }
+
+    void testEmptyPayload() {
+        Message msg(SourceServer, SourcePort, DestServer, DestPort);
+        checkSplitMatchesWhole(msg);
+        // No payload field at all rather than an empty one
+        std::string header;
+        TS_ASSERT(msg.serializeHeader(&header));
+        TS_ASSERT_EQUALS(header, wireBytes(msg));
+
+        Message* parsed = parse(wireBytes(msg));
+        TS_ASSERT(parsed != NULL);
+        if (parsed == NULL) return;
+        checkSameHeader(*parsed, msg);
+        TS_ASSERT(parsed->payload().empty());
+        checkSplitMatchesWhole(*parsed);
+        delete parsed;
+
+        // An explicitly empty payload field parses the same way
+        parsed = parse(header + std::string(1, (char)((PayloadField << 3) | WireLengthDelimited)) + std::string(1, '\0'));
+        TS_ASSERT(parsed != NULL);
+        if (parsed == NULL) return;
+        checkSameHeader(*parsed, msg);
+        TS_ASSERT(parsed->payload().empty());
+        TS_ASSERT_EQUALS(wireBytes(*parsed), header);
+        delete parsed;
+    }
+
+    void testObjectMessageBytes() {
+        // Wrapping an object message's received bytes gives the same message
+        // as serializing it, payload ID included
+        Sirikata::Protocol::Object::ObjectMessage* obj_msg = createObjectMessage(
+            SourceServer, UUID::random(), 7, UUID::random(), 9, randomPayload(500)
+        );
+        std::string obj_bytes = serializePBJMessage(*obj_msg);
+
+        Message serialized(SourceServer, SourcePort, DestServer, DestPort, obj_msg);
+        Message forwarded(SourceServer, SourcePort, DestServer, DestPort, obj_msg, obj_bytes);
+        TS_ASSERT_EQUALS(forwarded.payload(), obj_bytes);
+        TS_ASSERT_EQUALS(forwarded.payload(), serialized.payload());
+        TS_ASSERT_EQUALS(forwarded.payload_id(), obj_msg->unique());
+        TS_ASSERT_EQUALS(forwarded.payload_id(), serialized.payload_id());
+        checkSplitMatchesWhole(forwarded);
+
+        // The bytes are used as is, not regenerated from the message
+        std::string odd_bytes = obj_bytes;
+        appendBytesField(&odd_bytes, UnknownField, "kept");
+        Message passed_along(SourceServer, SourcePort, DestServer, DestPort, obj_msg, odd_bytes);
+        TS_ASSERT_EQUALS(passed_along.payload(), odd_bytes);
+        delete obj_msg;
+    }
+
+    void testPayloadNotLast() {
+        // Other serializers may put fields after the payload or add ones we
+        // don't know about. These take the full parse instead.
+        Message msg(SourceServer, SourcePort, DestServer, DestPort, randomPayload(200));
+        std::string header = headerOnly(msg);
+
+        std::string trailing_unknown = header;
+        appendBytesField(&trailing_unknown, PayloadField, msg.payload());
+        appendBytesField(&trailing_unknown, UnknownField, "extra");
+
+        std::string payload_first;
+        appendBytesField(&payload_first, PayloadField, msg.payload());
+        payload_first += header;
+
+        std::string* cases[] = { &trailing_unknown, &payload_first };
+        for(uint32 i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+            Message* parsed = parse(*cases[i]);
+            TS_ASSERT(parsed != NULL);
+            if (parsed == NULL) continue;
+            checkSameHeader(*parsed, msg);
+            TS_ASSERT_EQUALS(parsed->payload(), msg.payload());
+            // Re-serializing puts it back in the usual order
+            checkSplitMatchesWhole(*parsed);
+            TS_ASSERT_EQUALS(wireBytes(*parsed), wireBytes(msg));
+            delete parsed;
+        }
+    }
+
+    void testUnknownFieldsBeforePayload() {
+        // Every wire type we know how to skip, ahead of a trailing payload
+        Message msg(SourceServer, SourcePort, DestServer, DestPort, randomPayload(50));
+        std::string data = headerOnly(msg);
+        appendTag(&data, UnknownField, WireVarint);
+        appendVarint(&data, 1ULL << 40);
+        appendTag(&data, UnknownField + 1, Wire64Bit);
+        data.append(8, 'a');
+        appendTag(&data, UnknownField + 2, Wire32Bit);
+        data.append(4, 'b');
+        appendBytesField(&data, UnknownField + 3, "skipped");
+        appendBytesField(&data, PayloadField, msg.payload());
+
+        Message* parsed = parse(data);
+        TS_ASSERT(parsed != NULL);
+        if (parsed == NULL) return;
+        checkSameHeader(*parsed, msg);
+        TS_ASSERT_EQUALS(parsed->payload(), msg.payload());
+        checkSplitMatchesWhole(*parsed);
+        delete parsed;
+    }
+
+    void testDuplicatePayload() {
+        // The last copy wins, as with any other field, and only that one is
+        // sent on.
+        Message msg(SourceServer, SourcePort, DestServer, DestPort, randomPayload(100));
+        std::string header = headerOnly(msg);
+        std::string data = header;
+        appendBytesField(&data, PayloadField, randomPayload(30));
+        appendBytesField(&data, PayloadField, msg.payload());
+
+        Message* parsed = parse(data);
+        TS_ASSERT(parsed != NULL);
+        if (parsed == NULL) return;
+        checkSameHeader(*parsed, msg);
+        TS_ASSERT_EQUALS(parsed->payload(), msg.payload());
+        checkSplitMatchesWhole(*parsed);
+        TS_ASSERT_EQUALS(wireBytes(*parsed), wireBytes(msg));
+        delete parsed;
+
+        // A copy with the wrong wire type can't sneak into the header either
+        data = header;
+        appendTag(&data, PayloadField, WireVarint);
+        appendVarint(&data, 12345);
+        appendBytesField(&data, PayloadField, msg.payload());
+        parsed = parse(data);
+        if (parsed != NULL) {
+            checkSameHeader(*parsed, msg);
+            TS_ASSERT_EQUALS(parsed->payload(), msg.payload());
+            TS_ASSERT_EQUALS(wireBytes(*parsed), wireBytes(msg));
+            delete parsed;
+        }
+    }
+
+    void testTruncated() {
+        Message msg(SourceServer, SourcePort, DestServer, DestPort, randomPayload(300));
+        std::string data = wireBytes(msg);
+        std::string header = headerOnly(msg);
+
+        // Cutting the message off anywhere in the payload field fails rather
+        // than handing back part of the payload
+        for(uint32 len = header.size() + 1; len < data.size(); len++)
+            TS_ASSERT(parse(data.substr(0, len)) == NULL);
+        // And cutting into the header is never accepted as a full message
+        for(uint32 len = 0; len < header.size(); len++) {
+            Message* parsed = parse(data.substr(0, len));
+            if (parsed != NULL) {
+                TS_ASSERT(parsed->payload().empty());
+                delete parsed;
+            }
+        }
+
+        // Varints which never end, in a tag and in a length
+        std::string bad_tag = header;
+        bad_tag.push_back((char)0x80);
+        TS_ASSERT(parse(bad_tag) == NULL);
+        std::string bad_len = header;
+        appendTag(&bad_len, PayloadField, WireLengthDelimited);
+        bad_len.append(3, (char)0xFF);
+        TS_ASSERT(parse(bad_len) == NULL);
+        std::string long_varint = header;
+        appendTag(&long_varint, UnknownField, WireVarint);
+        long_varint.append(11, (char)0xFF);
+        long_varint.push_back(0);
+        TS_ASSERT(parse(long_varint) == NULL);
+
+        // Lengths past the end of the data
+        std::string bad_bytes = header;
+        appendTag(&bad_bytes, UnknownField, WireLengthDelimited);
+        appendVarint(&bad_bytes, 1000);
+        bad_bytes.append(10, 'x');
+        TS_ASSERT(parse(bad_bytes) == NULL);
+    }
+
+    void testFixedFieldsPastEnd() {
+        Message msg(SourceServer, SourcePort, DestServer, DestPort, randomPayload(20));
+        std::string header = headerOnly(msg);
+
+        for(uint32 have = 0; have < 8; have++) {
+            std::string data = header;
+            appendTag(&data, UnknownField, Wire64Bit);
+            data.append(have, 'a');
+            TS_ASSERT(parse(data) == NULL);
+        }
+        for(uint32 have = 0; have < 4; have++) {
+            std::string data = header;
+            appendTag(&data, UnknownField, Wire32Bit);
+            data.append(have, 'b');
+            TS_ASSERT(parse(data) == NULL);
+        }
+
+        // A fixed field which would swallow the start of the payload
+        std::string data = header;
+        appendTag(&data, UnknownField, Wire64Bit);
+        data.append(3, 'a');
+        appendBytesField(&data, PayloadField, "xy");
+        TS_ASSERT(parse(data) == NULL);
+    }
+};
@@ -40,6 +40,7 @@ void usage() {
     printf("   --help will print this help message\n");
     printf("   --list will print the list of filters\n");
     printf(" Example: meshtool --load=/path/to/file.dae\n");
+    printf(" Example: meshtool --load=/path/to/file.dae --save=\"--filename=/path/to/file.sirimesh --format=binarymodels\"\n");
 }
 
 int main(int argc, char** argv) {
@@ -63,6 +64,7 @@ int main(int argc, char** argv) {
     PluginManager plugins;
     plugins.loadList("colladamodels");
     plugins.loadList("mesh-billboard");
+    plugins.loadList("mesh-binary");
     plugins.loadList("common-filters");
     plugins.loadList("nvtt");
 